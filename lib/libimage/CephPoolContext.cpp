@@ -49,6 +49,7 @@
 
 #include "CephPoolContext.h"
 #include <stdlib.h>
+#include "Metrics.h"
 
 
 CephPoolContext::CephPoolContext (std::string pool) : Context(), pool_name(pool) {
@@ -73,6 +74,8 @@ CephPoolContext::CephPoolContext (std::string pool) : Context(), pool_name(pool)
     } else {
         conf_file.assign(conf);
     }
+
+    mergingGap = DEFAULT_OBJECT_MERGING_GAP;
 }
 
 bool CephPoolContext::connection() {
@@ -123,6 +126,7 @@ bool CephPoolContext::connection() {
 }
 
 int CephPoolContext::read(uint8_t* data, int offset, int size, std::string name) {
+    MetricsTimer timer ( Metrics::getStage ( "storage_read", "backend", getTypeStr() ) );
    
     LOGGER_DEBUG("Ceph read : " << size << " bytes (from the " << offset << " one) in the object " << name);
 
@@ -164,6 +168,30 @@ int CephPoolContext::read(uint8_t* data, int offset, int size, std::string name)
 }
 
 
+bool CephPoolContext::getSize(std::string name, long& size, bool& exists) {
+    if (! connected) {
+        LOGGER_ERROR("Try to stat using the unconnected ceph pool context " << pool_name);
+        return false;
+    }
+
+    uint64_t psize;
+    time_t pmtime;
+    int ret = rados_stat(io_ctx, name.c_str(), &psize, &pmtime);
+    if (ret == -ENOENT) {
+        exists = false;
+        return true;
+    }
+    if (ret < 0) {
+        LOGGER_ERROR ( "Unable to stat the Ceph object " << name );
+        LOGGER_ERROR (strerror(-ret));
+        return false;
+    }
+
+    exists = true;
+    size = psize;
+    return true;
+}
+
 bool CephPoolContext::write(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("Ceph write : " << size << " bytes (from the " << offset << " one) in the writing buffer " << name);
 
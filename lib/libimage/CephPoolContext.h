@@ -192,6 +192,14 @@ public:
      */
     int read(uint8_t* data, int offset, int size, std::string name);
 
+    /**
+     * \~french
+     * \brief Récupère la taille d'un objet Ceph
+     * \~english
+     * \brief Get the size of a Ceph object
+     */
+    bool getSize(std::string name, long& size, bool& exists);
+
     /**
      * \~french
      * \brief Écrit de la donnée dans un objet Ceph
@@ -49,6 +49,7 @@
 
 #include "Context.h"
 #include <string.h>
+#include <algorithm>
 
 namespace ContextType {
 
@@ -68,3 +69,108 @@ std::string toString ( eContextType ct ) {
 }
 
 }
+
+/**
+ * \~french \brief Ordonne les portions selon leur position dans l'objet
+ * \~english \brief Sort parts by position in the object
+ */
+struct ContextRangeOrder {
+    std::vector<ContextRange>* ranges;
+    ContextRangeOrder(std::vector<ContextRange>* r) : ranges(r) {}
+    bool operator() (int a, int b) {
+        return ranges->at(a).offset < ranges->at(b).offset;
+    }
+};
+
+int Context::readRanges(std::vector<ContextRange>& ranges, std::string name) {
+    return readGroupedRanges(ranges, name, NULL);
+}
+
+uint8_t* Context::readSlices(std::vector<ContextRange>& ranges, std::string name) {
+    uint8_t* slab = NULL;
+    readGroupedRanges(ranges, name, &slab);
+    return slab;
+}
+
+int Context::readGroupedRanges(std::vector<ContextRange>& ranges, std::string name, uint8_t** slab) {
+
+    std::vector<int> order;
+    for (unsigned int i = 0; i < ranges.size(); i++) {
+        ranges.at(i).readSize = -1;
+        if (ranges.at(i).size > 0) order.push_back(i);
+        else ranges.at(i).readSize = 0;
+    }
+    std::sort(order.begin(), order.end(), ContextRangeOrder(&ranges));
+
+    // Lectures à effectuer : portions [groups[g], groups[g+1]) de l'ordre, on agrège les portions suivantes tant qu'elles sont assez proches
+    std::vector<int> groups;
+    std::vector<int> starts, ends;
+    size_t slabSize = 0;
+    unsigned int i = 0;
+    while (i < order.size()) {
+        int start = ranges.at(order.at(i)).offset;
+        int end = start + ranges.at(order.at(i)).size;
+        unsigned int j = i + 1;
+        while (j < order.size() && ranges.at(order.at(j)).offset <= end + mergingGap) {
+            end = std::max(end, ranges.at(order.at(j)).offset + ranges.at(order.at(j)).size);
+            j++;
+        }
+        groups.push_back(i);
+        starts.push_back(start);
+        ends.push_back(end);
+        slabSize += end - start;
+        i = j;
+    }
+    groups.push_back(order.size());
+
+    if (slab != NULL) {
+        // Les lectures sont faites directement dans un buffer unique, les portions y pointent
+        *slab = (slabSize > 0) ? new uint8_t[slabSize] : NULL;
+    }
+
+    size_t slabPosition = 0;
+    for (unsigned int g = 0; g < starts.size(); g++) {
+        int start = starts.at(g), end = ends.at(g);
+        int first = groups.at(g), last = groups.at(g + 1);
+
+        if (slab != NULL) {
+            uint8_t* buffer = *slab + slabPosition;
+            slabPosition += end - start;
+            if (last - first > 1) {
+                LOGGER_DEBUG("Merged reading of " << (last - first) << " parts (" << (end - start) << " bytes from " << start << ") in the object " << name);
+            }
+            int got = read(buffer, start, end - start, name);
+            for (int k = first; k < last; k++) {
+                ContextRange& r = ranges.at(order.at(k));
+                r.data = buffer + (r.offset - start);
+                if (got < 0) continue;
+                int available = got - (r.offset - start);
+                r.readSize = std::max(0, std::min(available, r.size));
+            }
+        } else if (last - first == 1) {
+            // Portion isolée : lecture directe dans le buffer de destination
+            ContextRange& r = ranges.at(order.at(first));
+            r.readSize = read(r.data, r.offset, r.size, name);
+        } else {
+            LOGGER_DEBUG("Merged reading of " << (last - first) << " parts (" << (end - start) << " bytes from " << start << ") in the object " << name);
+            uint8_t* buffer = new uint8_t[end - start];
+            int got = read(buffer, start, end - start, name);
+            for (int k = first; k < last; k++) {
+                ContextRange& r = ranges.at(order.at(k));
+                if (got < 0) {
+                    r.readSize = -1;
+                    continue;
+                }
+                int available = got - (r.offset - start);
+                if (available < 0) available = 0;
+                r.readSize = std::min(available, r.size);
+                if (r.readSize > 0) {
+                    memcpy(r.data, buffer + (r.offset - start), r.readSize);
+                }
+            }
+            delete[] buffer;
+        }
+    }
+
+    return starts.size();
+}
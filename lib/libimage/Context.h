@@ -49,6 +49,7 @@
 #define CONTEXT_H
 
 #include <map>
+#include <vector>
 #include <stdint.h>// pour uint8_t
 #include "Logger.h"
 #include <string.h>
@@ -84,6 +85,44 @@ std::string toString ( eContextType ct );
 
 }
 
+/**
+ * \~french \brief Écart de fusion des lectures par défaut pour les stockages objet, où chaque lecture est une requête
+ * \~english \brief Default reading merging gap for object storages, where each reading is a request
+ */
+#define DEFAULT_OBJECT_MERGING_GAP 65536
+
+/**
+ * \~french \brief Portion d'un objet à lire
+ * \details Utilisée pour la lecture groupée de plusieurs portions d'un même objet (Context::readRanges)
+ * \~english \brief Part of an object to read
+ * \details Used for grouped reading of several parts of the same object (Context::readRanges)
+ */
+struct ContextRange {
+    /**
+     * \~french \brief Position de la portion dans l'objet
+     * \~english \brief Part's position in the object
+     */
+    int offset;
+    /**
+     * \~french \brief Taille de la portion
+     * \~english \brief Part's size
+     */
+    int size;
+    /**
+     * \~french \brief Buffer de destination, d'au moins #size octets, fourni par l'appelant
+     * \~english \brief Destination buffer, at least #size bytes, provided by the caller
+     */
+    uint8_t* data;
+    /**
+     * \~french \brief Taille effectivement lue, négative en cas d'erreur
+     * \~english \brief Real read size, negative if an error occured
+     */
+    int readSize;
+
+    ContextRange () : offset(0), size(0), data(NULL), readSize(-1) {}
+    ContextRange (int o, int s, uint8_t* d) : offset(o), size(s), data(d), readSize(-1) {}
+};
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -111,11 +150,25 @@ protected:
      */
     int attempts;
 
+    /**
+     * \~french \brief Écart maximal (en octets) entre deux portions d'un objet pour qu'elles soient lues en une seule fois
+     * \details Les octets entre les deux portions sont lus puis ignorés. Cela vaut le coup lorsque le coût d'une lecture (requête HTTP, appel système) est grand devant celui du transfert.
+     * \~english \brief Max gap (in bytes) between two parts of an object to read them at once
+     * \details Bytes between the two parts are read then ignored. It's worth when a reading cost (HTTP request, system call) is big compared to transfer cost.
+     */
+    int mergingGap;
+
     /**
      * \~french \brief Crée un objet Context
      * \~english \brief Create a Context object
      */
-    Context () : connected(false), attempts(1) {  }
+    Context () : connected(false), attempts(1), mergingGap(0) {  }
+
+    /**
+     * \~french \brief Lecture groupée des portions, dans les buffers fournis ou dans un buffer unique alloué si slab n'est pas NULL
+     * \~english \brief Grouped reading of parts, in provided buffers or in a single allocated buffer if slab is not NULL
+     */
+    int readGroupedRanges(std::vector<ContextRange>& ranges, std::string name, uint8_t** slab);
 
 public:
 
@@ -129,6 +182,23 @@ public:
         attempts = a;
     }
 
+    /**
+     * \~french \brief Modifie l'écart maximal de fusion des lectures
+     * \~english \brief Change reading merging max gap
+     */
+    void setMergingGap (int g) {
+        if (g < 0) g = 0;
+        mergingGap = g;
+    }
+
+    /**
+     * \~french \brief Retourne l'écart maximal de fusion des lectures
+     * \~english \brief Return reading merging max gap
+     */
+    int getMergingGap () {
+        return mergingGap;
+    }
+
     /**
      * \~french \brief Connecte le contexte
      * \~english \brief Connect the context
@@ -170,6 +240,48 @@ public:
      */
     virtual int read(uint8_t* data, int offset, int size, std::string name) = 0;
 
+    /**
+     * \~french \brief Récupère la taille d'un objet
+     * \param[in] name Nom de l'objet
+     * \param[out] size Taille de l'objet en octets
+     * \param[out] exists Faux si l'objet n'existe pas
+     * \return Faux si le stockage n'a pas pu être interrogé
+     * \~english \brief Get the size of an object
+     * \param[in] name Object's name
+     * \param[out] size Object's size in bytes
+     * \param[out] exists False if the object does not exist
+     * \return False if the storage could not be queried
+     */
+    virtual bool getSize(std::string name, long& size, bool& exists) = 0;
+
+    /**
+     * \~french \brief Récupère plusieurs portions d'un même objet, en fusionnant les lectures proches
+     * \details Les portions sont triées par position. Celles séparées de moins de #mergingGap octets sont lues en une seule fois (une seule requête pour un stockage objet), puis découpées en mémoire dans les buffers fournis.
+     * \param[in,out] ranges Portions à lire. La taille effectivement lue de chaque portion est renseignée
+     * \param[in] name Nom de l'objet que l'on veut lire
+     * \return Nombre de lectures effectuées
+     * \~english \brief Get several parts of the same object, merging close readings
+     * \details Parts are sorted by position. Those separated by less than #mergingGap bytes are read at once (only one request for an object storage), then sliced in memory into provided buffers.
+     * \param[in,out] ranges Parts to read. Real read size of each part is filled
+     * \param[in] name Object's name we want to read
+     * \return Performed readings number
+     */
+    virtual int readRanges(std::vector<ContextRange>& ranges, std::string name);
+
+    /**
+     * \~french \brief Récupère plusieurs portions d'un même objet dans un unique buffer, en fusionnant les lectures proches
+     * \details Les lectures sont regroupées comme pour #readRanges, mais faites directement dans le buffer retourné, sans recopie : le buffer de destination de chaque portion n'est pas fourni, il est renseigné et pointe dans le buffer retourné.
+     * \param[in,out] ranges Portions à lire. Le buffer et la taille effectivement lue de chaque portion sont renseignés
+     * \param[in] name Nom de l'objet que l'on veut lire
+     * \return Buffer contenant toutes les portions, à libérer par l'appelant (delete[]), NULL s'il n'y a rien à lire
+     * \~english \brief Get several parts of the same object in a single buffer, merging close readings
+     * \details Readings are grouped as for #readRanges, but directly done in the returned buffer, without copy : each part's destination buffer is not provided, it is filled and points in the returned buffer.
+     * \param[in,out] ranges Parts to read. Buffer and real read size of each part are filled
+     * \param[in] name Object's name we want to read
+     * \return Buffer containing all parts, to free by the caller (delete[]), NULL if nothing to read
+     */
+    uint8_t* readSlices(std::vector<ContextRange>& ranges, std::string name);
+
     /**
      * \~french \brief Écrit de la donnée dans l'objet
      * \param[in] data Buffer contenant la donnée à écrire
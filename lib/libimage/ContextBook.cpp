@@ -56,7 +56,7 @@
 #include "S3Context.h"
 #endif
 
-ContextBook::ContextBook(){}
+ContextBook::ContextBook() : mergingGap(-1), previous(NULL) {}
 
 Context * ContextBook::addContext(ContextType::eContextType type,std::string tray)
 {
@@ -69,6 +69,10 @@ Context * ContextBook::addContext(ContextType::eContextType type,std::string tra
         //le contenant est déjà existant et donc connecté
         return it->second;
 
+    } else if ( previous != NULL && previous->book.find(key) != previous->book.end() ) {
+        //le contenant est connecté dans l'annuaire prêteur, on l'emprunte
+        return previous->book.find(key)->second;
+
     } else {
         //ce contenant n'est pas encore connecté, on va créer la connexion
         //
@@ -102,6 +106,8 @@ Context * ContextBook::addContext(ContextType::eContextType type,std::string tra
         }
 
 
+        if (mergingGap >= 0) ctx->setMergingGap(mergingGap);
+
         //LOGGER_DEBUG("On insère ce contexte " << ctx->toString() );
         book.insert(make_pair(key,ctx));
 
@@ -132,7 +138,33 @@ ContextBook::~ContextBook()
     }
 }
 
+void ContextBook::setPrevious(ContextBook* book){
+    previous = book;
+}
+
+void ContextBook::transferTo(ContextBook* other){
+    std::map<std::pair<ContextType::eContextType,std::string>,Context*>::iterator it;
+    for (it=book.begin(); it!=book.end(); ++it) {
+        if ( ! other->book.insert(*it).second ) {
+            // Ne peut arriver que si le contexte a été créé dans l'autre annuaire sans être emprunté
+            delete it->second;
+        }
+    }
+    book.clear();
+    previous = NULL;
+}
+
 int ContextBook::size(){
   return book.size();
 }
 
+void ContextBook::setMergingGap(int g){
+    mergingGap = g;
+    if (mergingGap < 0) return;
+
+    std::map<std::pair<ContextType::eContextType,std::string>,Context*>::iterator it;
+    for (it=book.begin(); it!=book.end(); ++it) {
+        it->second->setMergingGap(mergingGap);
+    }
+}
+
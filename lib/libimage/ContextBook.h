@@ -69,6 +69,21 @@ private:
     //std::map<std::string, Context*> book;
     std::map<std::pair<ContextType::eContextType,std::string>,Context*> book;
 
+    /**
+     * \~french \brief Écart maximal entre deux portions lues ensemble, appliqué à tous les contextes
+     * \details Négatif si chaque contexte conserve la valeur par défaut de son type de stockage
+     * \~english \brief Maximal gap between two parts read together, applied to all contexts
+     * \details Negative if each context keeps its storage type default value
+     */
+    int mergingGap;
+
+    /**
+     * \~french \brief Annuaire dont les contextes sont empruntés plutôt que recréés
+     * \details Les contextes empruntés ne sont ni ajoutés à cet annuaire, ni détruits avec lui
+     * \~english \brief Book whose contexts are borrowed rather than created again
+     * \details Borrowed contexts are neither added to this book nor destroyed with it
+     */
+    ContextBook* previous;
 
 public:
 
@@ -140,13 +155,47 @@ public:
      */
     int size();
 
+    /**
+     * \~french
+     * \brief Définit l'écart de fusion des lectures de tous les contextes, présents et à venir
+     * \param[in] g Écart en octets, négatif pour conserver les valeurs par défaut
+     * \~english
+     * \brief Define reading merging gap for all contexts, present and future
+     * \param[in] g Gap in bytes, negative to keep default values
+     */
+    void setMergingGap(int g);
+
+    /**
+     * \~french
+     * \brief Définit l'annuaire dont les contextes existants sont empruntés
+     * \details Utilisé lors d'un rechargement : la nouvelle configuration réutilise les contextes connectés de l'ancienne sans modifier son annuaire, tant qu'elle n'est pas validée.
+     * \param[in] book Annuaire prêteur, NULL pour ne plus emprunter
+     * \~english
+     * \brief Define the book whose existing contexts are borrowed
+     * \details Used during a reload : new configuration reuses connected contexts of the old one without modifying its book, as long as it is not validated.
+     * \param[in] book Lending book, NULL to stop borrowing
+     */
+    void setPrevious(ContextBook* book);
+
+    /**
+     * \~french
+     * \brief Transfère les contextes créés par cet annuaire dans un autre
+     * \details Cet annuaire est vide après l'appel et n'emprunte plus de contexte.
+     * \param[in] book Annuaire destinataire
+     * \~english
+     * \brief Move contexts created by this book into another one
+     * \details This book is empty after the call and no longer borrows contexts.
+     * \param[in] book Receiving book
+     */
+    void transferTo(ContextBook* book);
+
     /**
      * \~french
      * \brief Destructeur
      * \~english
      * \brief Destructor
      */
-    ~ContextBook();
+    virtual ~ContextBook();
 
 };
 
@@ -44,5 +44,117 @@
  */
 
 #include "CurlPool.h"
+#include "Metrics.h"
 
 std::map<pthread_t, CURL*> CurlPool::pool;
+pthread_mutex_t CurlPool::mutex = PTHREAD_MUTEX_INITIALIZER;
+CURLSH* CurlPool::share = NULL;
+pthread_mutex_t CurlPool::shareLocks[CURL_LOCK_DATA_LAST];
+uint64_t CurlPool::requestsCount = 0;
+uint64_t CurlPool::connectionsCount = 0;
+
+void CurlPool::lockShare ( CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr ) {
+    pthread_mutex_lock ( &shareLocks[data] );
+}
+
+void CurlPool::unlockShare ( CURL* handle, curl_lock_data data, void* userptr ) {
+    pthread_mutex_unlock ( &shareLocks[data] );
+}
+
+void CurlPool::configureCurlEnv ( CURL* curl ) {
+    curl_easy_setopt ( curl, CURLOPT_SHARE, share );
+    curl_easy_setopt ( curl, CURLOPT_NOSIGNAL, 1L );
+    curl_easy_setopt ( curl, CURLOPT_TCP_KEEPALIVE, 1L );
+#if LIBCURL_VERSION_NUM >= 0x072f00
+    // HTTP/2 négocié via ALPN en HTTPS, HTTP/1.1 sinon
+    curl_easy_setopt ( curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS );
+#endif
+    // Pas de CURLOPT_PIPEWAIT : chaque poignée est utilisée par un thread différent, une requête attendant
+    // une connexion occupée par un autre thread (en HTTP/1.1 notamment) resterait bloquée
+}
+
+CURL* CurlPool::getCurlEnv() {
+    pthread_t i = pthread_self();
+
+    pthread_mutex_lock ( &mutex );
+
+    if ( share == NULL ) {
+        for ( int l = 0; l < CURL_LOCK_DATA_LAST; l++ ) {
+            pthread_mutex_init ( &shareLocks[l], NULL );
+        }
+        share = curl_share_init();
+        curl_share_setopt ( share, CURLSHOPT_LOCKFUNC, lockShare );
+        curl_share_setopt ( share, CURLSHOPT_UNLOCKFUNC, unlockShare );
+        curl_share_setopt ( share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS );
+        curl_share_setopt ( share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION );
+#if LIBCURL_VERSION_NUM >= 0x073900
+        curl_share_setopt ( share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT );
+#endif
+    }
+
+    CURL* c;
+    std::map<pthread_t, CURL*>::iterator it = pool.find ( i );
+    if ( it == pool.end() ) {
+        c = curl_easy_init();
+        pool.insert ( std::pair<pthread_t, CURL*>(i,c) );
+        Metrics::getGauge ( "rok4_curl_handles", "" )->set ( pool.size() );
+    } else {
+        c = it->second;
+    }
+
+    pthread_mutex_unlock ( &mutex );
+
+    // La remise à zéro conserve les connexions ouvertes, les sessions TLS et le cache DNS
+    curl_easy_reset ( c );
+    configureCurlEnv ( c );
+
+    return c;
+}
+
+void CurlPool::countRequest ( CURL* curl ) {
+    long newConnections = 0;
+    curl_easy_getinfo ( curl, CURLINFO_NUM_CONNECTS, &newConnections );
+    __sync_fetch_and_add ( &requestsCount, 1 );
+    Metrics::count ( "rok4_curl_requests_total", "" );
+    if ( newConnections > 0 ) {
+        __sync_fetch_and_add ( &connectionsCount, newConnections );
+        Metrics::count ( "rok4_curl_connections_total", "", newConnections );
+    }
+}
+
+double CurlPool::getConnectionsPer1000Requests() {
+    uint64_t requests = __sync_fetch_and_add ( &requestsCount, 0 );
+    uint64_t connections = __sync_fetch_and_add ( &connectionsCount, 0 );
+    if ( requests == 0 ) return 0.;
+    return 1000. * ( double ) connections / ( double ) requests;
+}
+
+void CurlPool::printNumCurls () {
+    pthread_mutex_lock ( &mutex );
+    LOGGER_INFO ( "Nombre de contextes curl : " << pool.size() );
+    pthread_mutex_unlock ( &mutex );
+    LOGGER_INFO ( "Requêtes curl : " << requestsCount << ", nouvelles connexions (poignées de main TLS en HTTPS) : " << connectionsCount
+                  << ", soit " << getConnectionsPer1000Requests() << " pour 1000 tuiles" );
+}
+
+void CurlPool::cleanCurlPool () {
+    pthread_mutex_lock ( &mutex );
+    std::map<pthread_t, CURL*>::iterator it;
+    for (it = pool.begin(); it != pool.end(); ++it) {
+        curl_easy_cleanup(it->second);
+    }
+    pool.clear();
+    Metrics::getGauge ( "rok4_curl_handles", "" )->set ( 0 );
+
+    if ( share != NULL ) {
+        curl_share_cleanup ( share );
+        share = NULL;
+        for ( int l = 0; l < CURL_LOCK_DATA_LAST; l++ ) {
+            pthread_mutex_destroy ( &shareLocks[l] );
+        }
+    }
+
+    requestsCount = 0;
+    connectionsCount = 0;
+    pthread_mutex_unlock ( &mutex );
+}
@@ -51,6 +51,7 @@
 #include <map>
 #include <string.h>
 #include <sstream>
+#include <pthread.h>
 #include <curl/curl.h>
 
 
@@ -59,6 +60,17 @@
  * \~french
  * \brief Création d'un pool
  * \details Cette classe est prévue pour être utilisée sans instance
+ *
+ * Chaque thread dispose de son propre objet Curl. Tous les objets partagent, via un objet de partage Curl, le cache DNS, les sessions TLS et le cache de connexions : une connexion ouverte vers un stockage objet par un thread peut être réutilisée par les autres, ce qui évite de refaire les poignées de main TCP et TLS à chaque tuile.
+ *
+ * Lorsque la version de Curl le permet, on négocie HTTP/2 avec les serveurs qui le supportent (via ALPN) afin de multiplexer les requêtes sur une même connexion.
+ * \~english
+ * \brief Pool creation
+ * \details This class is intended to be used without instance
+ *
+ * Each thread owns its own curl object. All objects share, through a curl share object, the DNS cache, the TLS sessions and the connection cache : a connection opened to an object storage by a thread can be reused by the others, avoiding TCP and TLS handshakes for each tile.
+ *
+ * When curl version allows it, HTTP/2 is negotiated with the servers which support it (with ALPN), to multiplex requests on the same connection.
  */
 class CurlPool {  
 
@@ -72,6 +84,58 @@ private:
      */
     static std::map<pthread_t, CURL*> pool;
 
+    /**
+     * \~french \brief Protège l'accès concurrent à l'annuaire
+     * \~english \brief Protect concurrent access to the book
+     */
+    static pthread_mutex_t mutex;
+
+    /**
+     * \~french \brief Objet de partage (DNS, sessions TLS, connexions) entre tous les objets Curl de l'annuaire
+     * \~english \brief Share object (DNS, TLS sessions, connections) between all curl objects in the book
+     */
+    static CURLSH* share;
+
+    /**
+     * \~french \brief Verrous utilisés par l'objet de partage, un par type de donnée partagée
+     * \~english \brief Locks used by share object, one per shared data type
+     */
+    static pthread_mutex_t shareLocks[CURL_LOCK_DATA_LAST];
+
+    /**
+     * \~french \brief Nombre de requêtes effectuées par les objets de l'annuaire
+     * \~english \brief Number of requests performed by pool's objects
+     */
+    static uint64_t requestsCount;
+
+    /**
+     * \~french \brief Nombre de nouvelles connexions ouvertes par les objets de l'annuaire
+     * \details Pour des URL en HTTPS, chaque nouvelle connexion correspond à une poignée de main TLS
+     * \~english \brief Number of new connections opened by pool's objects
+     * \details For HTTPS URL, each new connection means a TLS handshake
+     */
+    static uint64_t connectionsCount;
+
+    /**
+     * \~french \brief Fonction de verrouillage pour l'objet de partage
+     * \~english \brief Lock function for the share object
+     */
+    static void lockShare ( CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr );
+
+    /**
+     * \~french \brief Fonction de déverrouillage pour l'objet de partage
+     * \~english \brief Unlock function for the share object
+     */
+    static void unlockShare ( CURL* handle, curl_lock_data data, void* userptr );
+
+    /**
+     * \~french \brief Applique les options persistantes à un objet Curl
+     * \details Objet de partage, HTTP/2 si disponible, maintien des connexions TCP. Ces options sont réappliquées après chaque remise à zéro de l'objet
+     * \~english \brief Apply persistent options to a curl object
+     * \details Share object, HTTP/2 if available, TCP keep alive. These options are applied again after each reset
+     */
+    static void configureCurlEnv ( CURL* curl );
+
     /**
      * \~french
      * \brief Constructeur
@@ -92,43 +156,41 @@ public:
 
     /**
      * \~french \brief Retourne un objet Curl propre au thread appelant
-     * \details Si il n'existe pas encore d'objet curl pour ce tread, on le crée et on l'initialise
+     * \details Si il n'existe pas encore d'objet curl pour ce tread, on le crée et on l'initialise. Sinon, il est remis à zéro, mais conserve ses connexions ouvertes et les options persistantes.
      * \~english \brief Get the curl object specific to the calling thread
-     * \details If curl object doesn't exist for this thread, it is created and initialized
+     * \details If curl object doesn't exist for this thread, it is created and initialized. Otherwise, it is reset, but keeps its opened connections and persistent options
+     */
+    static CURL* getCurlEnv();
+
+    /**
+     * \~french \brief Comptabilise une requête effectuée avec un objet de l'annuaire
+     * \details On récupère le nombre de nouvelles connexions ouvertes pour cette requête (0 si une connexion a été réutilisée). Les requêtes et les connexions sont aussi comptées dans les métriques (rok4_curl_requests_total et rok4_curl_connections_total), pour suivre en production le ratio de #getConnectionsPer1000Requests
+     * \param[in] curl Objet Curl venant d'effectuer une requête
+     * \~english \brief Account a request performed with a pool's object
+     * \details We get the number of new connections opened for this request (0 if a connection has been reused). Requests and connections are also counted in metrics (rok4_curl_requests_total and rok4_curl_connections_total), to follow in production the #getConnectionsPer1000Requests ratio
+     * \param[in] curl Curl object which has just performed a request
      */
-    static CURL* getCurlEnv() {
-        pthread_t i = pthread_self();
+    static void countRequest ( CURL* curl );
 
-        std::map<pthread_t, CURL*>::iterator it = pool.find ( i );
-        if ( it == pool.end() ) {
-            CURL* c = curl_easy_init();
-            pool.insert ( std::pair<pthread_t, CURL*>(i,c) );
-            return c;
-        } else {
-            curl_easy_reset(it->second);
-            return it->second;
-        }
-    }
+    /**
+     * \~french \brief Nombre de nouvelles connexions (poignées de main TLS en HTTPS) pour 1000 requêtes
+     * \~english \brief Number of new connections (TLS handshakes with HTTPS) per 1000 requests
+     */
+    static double getConnectionsPer1000Requests();
 
     /**
-     * \~french \brief Affiche le nombre d'objet curl dans l'annuaire
-     * \~english \brief Print the number of curl objects in the book
+     * \~french \brief Affiche le nombre d'objet curl dans l'annuaire et les statistiques de connexion
+     * \~english \brief Print the number of curl objects in the book and connection statistics
      */
-    static void printNumCurls () {
-        LOGGER_INFO("Nombre de contextes curl : " << pool.size());
-    }
+    static void printNumCurls ();
 
     /**
      * \~french \brief Nettoie tous les objets curl dans l'annuaire et le vide
+     * \details L'objet de partage est également détruit, ainsi que les statistiques de connexion
      * \~english \brief Clean all curl objects in the book and empty it
+     * \details Share object is destroyed too, and connection statistics
      */
-    static void cleanCurlPool () {
-        std::map<pthread_t, CURL*>::iterator it;
-        for (it = pool.begin(); it != pool.end(); ++it) {
-            curl_easy_cleanup(it->second);
-        }
-        pool.clear();
-    }
+    static void cleanCurlPool ();
 
 };
 
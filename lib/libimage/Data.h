@@ -378,6 +378,98 @@ public:
     }
 };
 
+/**
+ * Buffer partagé par plusieurs sources de données, libéré avec la dernière d'entre elles.
+ */
+class SharedBuffer {
+private:
+    uint8_t* data;
+    volatile int references;
+
+    /** Destructeur, appelé par le dernier release() **/
+    ~SharedBuffer() {
+        delete[] data;
+    }
+
+public:
+    /**
+     * Constructeur : le buffer (alloué par new[]) est confié à l'objet, qui a une première référence.
+     */
+    SharedBuffer ( uint8_t* dat ) : data ( dat ), references ( 1 ) {}
+
+    uint8_t* getData() {
+        return data;
+    }
+
+    void acquire() {
+        __sync_fetch_and_add ( &references, 1 );
+    }
+
+    /** Rend une référence, le buffer est libéré avec la dernière **/
+    void release() {
+        if ( __sync_sub_and_fetch ( &references, 1 ) == 0 ) delete this;
+    }
+};
+
+/**
+ * Classe d'une source de données pointant dans un buffer partagé, sans recopie.
+ */
+class SliceDataSource : public DataSource {
+private:
+    SharedBuffer* buffer;
+    const uint8_t* data;
+    size_t dataSize;
+    std::string type;
+    std::string encoding;
+public:
+    /**
+     * Constructeur : la source garde une référence sur le buffer, dans lequel pointe dat.
+     */
+    SliceDataSource ( SharedBuffer* buf, const uint8_t *dat, size_t dataS, std::string t, std::string e ) :
+        buffer ( buf ), data ( dat ), dataSize ( dataS ), type ( t ), encoding ( e ) {
+        buffer->acquire();
+    }
+
+    /** Destructeur **/
+    virtual ~SliceDataSource() {
+        buffer->release();
+    }
+
+    /** Implémentation de l'interface DataSource **/
+    const uint8_t* getData ( size_t &size ) {
+        size = dataSize;
+        return data;
+    }
+
+    /**
+     * Le buffer, partagé, n'est libéré qu'à la destruction
+     * @return false
+     */
+    bool releaseData() {
+        return false;
+    }
+
+    /** @return le type du dataStream */
+    std::string getType() {
+        return type;
+    }
+
+    /** @return le status du dataStream */
+    int getHttpStatus() {
+        return 200;
+    }
+
+    /** @return l'encodage du dataStream */
+    std::string getEncoding() {
+        return encoding;
+    }
+
+    /** @return le taille du dataStream */
+    unsigned int getLength() {
+        return 0;
+    }
+};
+
 /**
  * Classe d'un flux de données brutes.
  */
@@ -59,16 +59,20 @@
 /********************************************** DecimatedImage ************************************************/
 
 template <typename T>
-int DecimatedImage::_getline ( T* buffer, int line ) {
+int DecimatedImage::_getSampledLine ( T* buffer, int line, int offset, int step, int number ) {
     
     // Initialisation de tous les pixels de la ligne avec la valeur de nodata
-    for ( int i = 0; i < width * channels; i++ ) {
+    for ( int i = 0; i < number * channels; i++ ) {
         buffer[i]= ( T ) nodata[i%channels];
     }
     
-    if ( numberX == 0 ) {
+    // Pixels demandés provenant de l'image source
+    int first;
+    int n = sampledColumns ( offset, step, number, imageOffsetX, imageOffsetX + numberX - 1, &first );
+
+    if ( n == 0 ) {
         // On est à gauche ou à droite de l'image source
-        return width*channels;
+        return number*channels;
     }
     
     // Ordonnée du centre de la ligne demandée
@@ -78,58 +82,67 @@ int DecimatedImage::_getline ( T* buffer, int line ) {
 
     if ( src_ligne < 0 || src_ligne >= sourceImage->getHeight() ) {
         // On est au dessus ou en dessous de l'image source
-        return width*channels;
+        return number*channels;
     }
     
-    T* buffer_t = new T[sourceImage->getWidth() * sourceImage->getChannels()];
-    sourceImage->getline ( buffer_t, src_ligne );
-    
-    T* pix_src = buffer_t + sourceOffsetX * sourceImage->getChannels();
-    T* pix_dst = buffer + imageOffsetX * channels;
+    // Colonne dans l'image source du premier pixel demandé, et pas dans l'image source
+    int src_offset = sourceOffsetX + ( offset + first * step - imageOffsetX ) * ratioX;
+    int src_step = step * ratioX;
+
+    T* pix_dst = buffer + first * channels;
     
     if ( sourceImage->getMask() == NULL ) {
-        for (int i = 0; i < numberX; i++) {
-            memcpy(pix_dst, pix_src, channels*sizeof ( T ));
-            pix_src += ratioX * sourceImage->getChannels();
-            pix_dst += channels;
+        if ( sourceImage->getSampledLine ( pix_dst, src_ligne, src_offset, src_step, n ) == 0 ) {
+            return 0;
         }
     } else {
 
-        uint8_t* buffer_m = new uint8_t[sourceImage->getMask()->getWidth()];
-        sourceImage->getMask()->getline ( buffer_m, src_ligne );
-        
-        uint8_t* pix_src_mask = buffer_m + sourceOffsetX;
-        for (int i = 0; i < numberX; i++) {
-            if (*pix_src_mask) {
-                memcpy(pix_dst, pix_src, channels*sizeof ( T ));
+        maskBuffer.resize ( n );
+        if ( sourceImage->getSampledLine ( pix_dst, src_ligne, src_offset, src_step, n ) == 0 ||
+             sourceImage->getMask()->getSampledLine ( &maskBuffer[0], src_ligne, src_offset, src_step, n ) == 0 ) {
+            return 0;
+        }
+
+        // Les pixels qui ne sont pas de la donnée reprennent la valeur de non-donnée
+        for (int i = 0; i < n; i++) {
+            if ( ! maskBuffer[i] ) {
+                for ( int c = 0; c < channels; c++ ) {
+                    pix_dst[c] = ( T ) nodata[c];
+                }
             }
-            pix_src += ratioX * sourceImage->getChannels();
-            pix_src_mask += ratioX;
             pix_dst += channels;
         }
-
-        delete [] buffer_m;
     }
     
-    delete [] buffer_t;
-    
-    return width*channels;
+    return number*channels;
 }
 
 
 /* Implementation de getline pour les uint8_t */
 int DecimatedImage::getline ( uint8_t* buffer, int line ) {
-    return _getline ( buffer, line );
+    return _getSampledLine ( buffer, line, 0, 1, width );
 }
 
 /* Implementation de getline pour les float */
 int DecimatedImage::getline ( uint16_t* buffer, int line ) {
-    return _getline ( buffer, line );
+    return _getSampledLine ( buffer, line, 0, 1, width );
 }
 
 /* Implementation de getline pour les float */
 int DecimatedImage::getline ( float* buffer, int line ) {
-    return _getline ( buffer, line );
+    return _getSampledLine ( buffer, line, 0, 1, width );
+}
+
+int DecimatedImage::getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int DecimatedImage::getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int DecimatedImage::getSampledLine ( float* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
 }
 
 DecimatedImage::DecimatedImage ( int width, int height, int channels, double resx, double resy, BoundingBox<double> bbox,
@@ -159,6 +172,8 @@ DecimatedImage::DecimatedImage ( int width, int height, int channels, double res
         // On est à gauche ou à droite de l'image source
         // Tous les pixels de l'image décimée sont à côté de l'image source. Pourquoi pas, on aura une image de nodata
         numberX = 0;
+        imageOffsetX = 0;
+        sourceOffsetX = 0;
     } else {
     
         // On va chercher le premier pixel de l'image source qui est utilisé
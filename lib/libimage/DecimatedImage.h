@@ -112,16 +112,25 @@ private:
      */
     int imageOffsetX;
 
+    /**
+     * \~french \brief Masque de la ligne source échantillonnée, réutilisé d'une ligne à l'autre
+     * \~english \brief Sampled source line's mask, reused from one line to another
+     */
+    std::vector<uint8_t> maskBuffer;
+
     /** \~french
-     * \brief Retourne une ligne, flottante ou entière
-     * \details Lorsque l'on veut récupérer une ligne d'une image décimée, on ne garde que un pixel tous les #ratioX de l'image source
+     * \brief Retourne une ligne sous-échantillonnée, flottante ou entière
+     * \details Lorsque l'on veut récupérer une ligne d'une image décimée, on ne garde que un pixel tous les #ratioX de l'image source. Seuls ces pixels sont demandés à l'image source (et à son masque), écrits directement dans le buffer de sortie : une ligne entière est ainsi l'échantillonnage de pas 1 d'une image décimée, et l'échantillonnage de pas N d'une image décimée est celui de pas N * #ratioX de l'image source.
      *
-     * \param[in] buffer Tableau contenant au moins width*channels valeurs
+     * \param[in] buffer Tableau contenant au moins number*channels valeurs
      * \param[in] line Indice de la ligne à retourner (0 <= line < height)
+     * \param[in] offset Colonne du premier pixel retourné
+     * \param[in] step Pas entre deux colonnes retournées
+     * \param[in] number Nombre de pixels retournés
      * \return taille utile du buffer, 0 si erreur
      */
     template<typename T>
-    int _getline ( T* buffer, int line );
+    int _getSampledLine ( T* buffer, int line, int offset, int step, int number );
 
 protected:
 
@@ -191,6 +200,10 @@ public:
     int getline ( uint16_t* buffer, int line );
     int getline ( float* buffer, int line );
 
+    int getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( float* buffer, int line, int offset, int step, int number );
+
     /**
      * \~french
      * \brief Destructeur par défaut
@@ -38,6 +38,9 @@
 
 #include "Decoder.h"
 #include <setjmp.h>
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
 #include "Logger.h"
 
 #include "jpeglib.h"
@@ -92,22 +95,20 @@ my_error_exit ( j_common_ptr cinfo ) {
 }
 
 
-const uint8_t* JpegDecoder::decode ( DataSource* source, size_t &size ) {
-    size = 0;
-    if ( !source ) return 0;
-
-    size_t encSize;
-    const uint8_t* encData = source->getData ( encSize );
-
-    if ( !encData ) return 0;
+/*
+ * Décodage JPEG, dans le buffer fourni ou dans un buffer alloué à la taille de l'image (buffer nul).
+ * En entrée, size est la taille du buffer fourni, en sortie le nombre d'octets décodés.
+ */
+static uint8_t* decodeJpeg ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t &size ) {
 
     struct jpeg_decompress_struct cinfo;
     struct my_error_mgr jerr;
+    struct jpeg_source_mgr src;
 
     // Initialisation de cinfo
     jpeg_create_decompress ( &cinfo );
 
-    cinfo.src = new jpeg_source_mgr;
+    cinfo.src = &src;
     cinfo.src->init_source = init_source;
     cinfo.src->fill_input_buffer = fill_input_buffer;
     cinfo.src->skip_input_data = skip_input_data;
@@ -121,58 +122,56 @@ const uint8_t* JpegDecoder::decode ( DataSource* source, size_t &size ) {
     cinfo.err = jpeg_std_error ( &jerr.pub );
     jerr.pub.error_exit = my_error_exit;
 
+    uint8_t* volatile allocated = 0;
+
     // Initialisation du contexte retourne par setjmp pour my_error_exit
     if ( setjmp ( jerr.setjmp_buffer ) ) {
-        delete cinfo.src;
         jpeg_destroy_decompress ( &cinfo );
+        delete[] allocated;
+        size = 0;
         return 0;
     }
 
-    uint8_t* raw_data = 0;
-
-    // Lecture
-    if ( jpeg_read_header ( &cinfo, TRUE ) == JPEG_HEADER_OK ) {
-
-        int linesize = cinfo.image_width * cinfo.num_components;
-        size = linesize * cinfo.image_height;
-        raw_data = new uint8_t[size];
+    if ( jpeg_read_header ( &cinfo, TRUE ) != JPEG_HEADER_OK ) {
+        LOGGER_ERROR ( "Erreur de lecture en tete jpeg" );
+        jpeg_destroy_decompress ( &cinfo );
+        size = 0;
+        return 0;
+    }
 
-        // TODO: définir J_COLOR_SPACE out_color_space en fonction du nombre de canal ?
-        // Vérifier que le jpeg monocanal marche ???
+    int linesize = cinfo.image_width * cinfo.num_components;
+    int lines = cinfo.image_height;
+    if ( buffer ) {
+        // On s'arrête à la dernière ligne utile
+        lines = std::min ( lines, ( int ) ( size / linesize ) );
+    } else {
+        allocated = new uint8_t[linesize * lines];
+        buffer = allocated;
+    }
 
-        jpeg_start_decompress ( &cinfo );
-        while ( cinfo.output_scanline < cinfo.image_height ) {
-            uint8_t *line = raw_data + cinfo.output_scanline * linesize;
+    // TODO: définir J_COLOR_SPACE out_color_space en fonction du nombre de canal ?
+    // Vérifier que le jpeg monocanal marche ???
 
-            if ( jpeg_read_scanlines ( &cinfo, &line, 1 ) < 1 ) {
-                jpeg_finish_decompress ( &cinfo );
-                delete cinfo.src;
-                jpeg_destroy_decompress ( &cinfo );
-                LOGGER_ERROR ( "Probleme lecture tuile Jpeg" );
-                delete[] raw_data;
-                size = 0;
-                return 0;
-            }
+    jpeg_start_decompress ( &cinfo );
+    while ( ( int ) cinfo.output_scanline < lines ) {
+        uint8_t *line = buffer + cinfo.output_scanline * linesize;
 
+        if ( jpeg_read_scanlines ( &cinfo, &line, 1 ) < 1 ) {
+            jpeg_destroy_decompress ( &cinfo );
+            LOGGER_ERROR ( "Probleme lecture tuile Jpeg" );
+            delete[] allocated;
+            size = 0;
+            return 0;
         }
+    }
 
-        jpeg_finish_decompress ( &cinfo );
-    } else
-        LOGGER_ERROR ( "Erreur de lecture en tete jpeg" );
-
-
-    // Destruction de cinfo
-    delete cinfo.src;
+    // Destruction de cinfo, sans lire les éventuelles lignes inutiles
     jpeg_destroy_decompress ( &cinfo );
-    return raw_data;
+    size = linesize * lines;
+    return buffer;
 }
 
-/**
- * Decodage de donnee PNG
- */
-const uint8_t* PngDecoder::decode ( DataSource* source, size_t &size ) {
-
-//      LOGGER(DEBUG) << (intptr_t) source << std::endl;
+const uint8_t* JpegDecoder::decode ( DataSource* source, size_t &size ) {
     size = 0;
     if ( !source ) return 0;
 
@@ -181,31 +180,142 @@ const uint8_t* PngDecoder::decode ( DataSource* source, size_t &size ) {
 
     if ( !encData ) return 0;
 
-    // Initialisation du flux
+    return decodeJpeg ( encData, encSize, 0, size );
+}
+
+size_t JpegDecoder::decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size ) {
+    if ( ! decodeJpeg ( encData, encSize, buffer, size ) ) return 0;
+    return size;
+}
+
+/*
+ * Flux zlib et buffer de travail propres à chaque thread, réinitialisés pour chaque tuile plutôt que recréés
+ */
+struct InflateContext {
     z_stream zstream;
-    zstream.zalloc = Z_NULL;
-    zstream.zfree = Z_NULL;
-    zstream.opaque = Z_NULL;
-    zstream.data_type = Z_BINARY;
+    std::vector<uint8_t> rows;
+};
+
+static pthread_key_t inflateKey;
+static pthread_once_t inflateKeyOnce = PTHREAD_ONCE_INIT;
+
+static void deleteInflateContext ( void* context ) {
+    inflateEnd ( & ( ( InflateContext* ) context )->zstream );
+    delete ( InflateContext* ) context;
+}
+
+static void createInflateKey() {
+    pthread_key_create ( &inflateKey, deleteInflateContext );
+}
+
+static InflateContext* getInflateContext ( const char* format ) {
+    pthread_once ( &inflateKeyOnce, createInflateKey );
+    InflateContext* context = ( InflateContext* ) pthread_getspecific ( inflateKey );
+    if ( context ) {
+        if ( inflateReset ( &context->zstream ) == Z_OK ) return context;
+        LOGGER_ERROR ( "Decompression " << format << " : echec de la reinitialisation du flux" );
+        return 0;
+    }
+
+    context = new InflateContext;
+    context->zstream.zalloc = Z_NULL;
+    context->zstream.zfree = Z_NULL;
+    context->zstream.opaque = Z_NULL;
+    context->zstream.next_in = Z_NULL;
+    context->zstream.avail_in = 0;
     int zinit;
-    if ( ( zinit=inflateInit ( &zstream ) ) != Z_OK ) {
+    if ( ( zinit=inflateInit ( &context->zstream ) ) != Z_OK ) {
         if ( zinit==Z_MEM_ERROR )
-            LOGGER_ERROR ( "Decompression PNG : pas assez de memoire" );
+            LOGGER_ERROR ( "Decompression " << format << " : pas assez de memoire" );
         else if ( zinit==Z_VERSION_ERROR )
-            LOGGER_ERROR ( "Decompression PNG : versions de zlib incompatibles" );
+            LOGGER_ERROR ( "Decompression " << format << " : versions de zlib incompatibles" );
         else if ( zinit==Z_STREAM_ERROR )
-            LOGGER_ERROR ( "Decompression PNG : parametres invalides" );
+            LOGGER_ERROR ( "Decompression " << format << " : parametres invalides" );
         else
-            LOGGER_ERROR ( "Decompression PNG : echec" );
+            LOGGER_ERROR ( "Decompression " << format << " : echec" );
+        delete context;
         return 0;
     }
+    pthread_setspecific ( inflateKey, context );
+    return context;
+}
 
-    int height = bswap_32 ( * ( ( const uint32_t* ) ( encData + 16 ) ) );
-    int width = bswap_32 ( * ( ( const uint32_t* ) ( encData + 20 ) ) );
-    // TODO: vérifier cohérence header...
-    int channels;
+/*
+ * Annule le filtre PNG d'une ligne (bpp : octets par pixel). La ligne précédente, déjà décodée, est nulle pour la première ligne.
+ */
+static bool unfilterPngLine ( uint8_t filter, const uint8_t* in, const uint8_t* prior, uint8_t* out, int linesize, int bpp ) {
+    switch ( filter ) {
+    case 0: // None
+        memcpy ( out, in, linesize );
+        break;
+    case 1: // Sub
+        memcpy ( out, in, bpp );
+        for ( int i = bpp; i < linesize; i++ ) out[i] = in[i] + out[i - bpp];
+        break;
+    case 2: // Up
+        if ( prior ) {
+            for ( int i = 0; i < linesize; i++ ) out[i] = in[i] + prior[i];
+        } else {
+            memcpy ( out, in, linesize );
+        }
+        break;
+    case 3: // Average
+        for ( int i = 0; i < linesize; i++ ) {
+            int a = ( i >= bpp ) ? out[i - bpp] : 0;
+            int b = prior ? prior[i] : 0;
+            out[i] = in[i] + ( ( a + b ) >> 1 );
+        }
+        break;
+    case 4: // Paeth
+        for ( int i = 0; i < linesize; i++ ) {
+            int a = ( i >= bpp ) ? out[i - bpp] : 0;
+            int b = prior ? prior[i] : 0;
+            int c = ( prior && i >= bpp ) ? prior[i - bpp] : 0;
+            int p = a + b - c;
+            int pa = abs ( p - a ), pb = abs ( p - b ), pc = abs ( p - c );
+            out[i] = in[i] + ( ( pa <= pb && pa <= pc ) ? a : ( pb <= pc ? b : c ) );
+        }
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
 
-//      TODO if(encData[24] != 8) ERROR
+/*
+ * Passe au chunk IDAT suivant (à partir de pos) et le donne en entrée du flux zlib. Faux s'il n'y en a plus.
+ */
+static bool nextPngIdat ( const uint8_t* encData, size_t encSize, size_t& pos, z_stream& zstream ) {
+    while ( pos + 8 <= encSize ) {
+        size_t length = bswap_32 ( * ( ( const uint32_t* ) ( encData + pos ) ) );
+        const uint8_t* type = encData + pos + 4;
+        size_t data = pos + 8;
+        pos = data + length + 4; // données + crc
+        if ( !memcmp ( type, "IDAT", 4 ) ) {
+            zstream.next_in = ( uint8_t* ) ( encData + data );
+            zstream.avail_in = std::min ( length, encSize - data );
+            return true;
+        }
+        if ( !memcmp ( type, "IEND", 4 ) ) return false;
+    }
+    return false;
+}
+
+/*
+ * Décodage PNG, dans le buffer fourni ou dans un buffer alloué à la taille de l'image (buffer nul).
+ * En entrée, size est la taille du buffer fourni, en sortie le nombre d'octets décodés.
+ */
+static uint8_t* decodePng ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t &size ) {
+
+    if ( encSize < 33 || memcmp ( encData + 12, "IHDR", 4 ) ) {
+        LOGGER_ERROR ( "Decompression PNG : en-tete invalide" );
+        size = 0;
+        return 0;
+    }
+
+    int width = bswap_32 ( * ( ( const uint32_t* ) ( encData + 16 ) ) );
+    int height = bswap_32 ( * ( ( const uint32_t* ) ( encData + 20 ) ) );
+    int channels;
 
     switch ( encData[25] ) {
     case 0: // Gray
@@ -214,58 +324,106 @@ const uint8_t* PngDecoder::decode ( DataSource* source, size_t &size ) {
     case 2: //RGB
         channels = 3;
         break;
-    case 3: // Palette
-        channels = 0; //ERROR
-        return 0;
-        break;
     case 4: // Gray + Alpha
         channels = 2;
         break;
     case 6: //RGBA
         channels = 4;
         break;
-    default:; // TODO ERROR;
+    default: // Palette
+        LOGGER_ERROR ( "Decompression PNG : type de couleur non gere " << ( int ) encData[25] );
+        size = 0;
+        return 0;
+    }
+    if ( encData[24] != 8 || encData[28] != 0 ) {
+        LOGGER_ERROR ( "Decompression PNG : seules les images 8 bits non entrelacees sont gerees" );
+        size = 0;
+        return 0;
     }
 
-    uint8_t* raw_data = new uint8_t[height * width * channels];
+    InflateContext* context = getInflateContext ( "PNG" );
+    if ( ! context ) {
+        size = 0;
+        return 0;
+    }
+    z_stream& zstream = context->zstream;
+
     int linesize = width * channels;
+    int lines = height;
+    uint8_t* allocated = 0;
+    if ( buffer ) {
+        // On s'arrête à la dernière ligne utile
+        lines = std::min ( lines, ( int ) ( size / linesize ) );
+    } else {
+        allocated = new uint8_t[linesize * lines];
+        buffer = allocated;
+    }
 
-    zstream.next_in = ( uint8_t* ) ( encData + 41 ); // 41 = 33 header + 8(chunk idat)
-    zstream.avail_in = encSize - 57;     // 57 = 41 + 4(crc) + 12(IEND)
-
-    // Decompression du flux ligne par ligne
-    uint8_t tmp;
-    for ( int h = 0; h < height; h++ ) {
-        zstream.next_out = &tmp;
-        zstream.avail_out = 1;
-        // Decompression 1er octet de la ligne (=0 dans le cache)
-        if ( inflate ( &zstream, Z_SYNC_FLUSH ) != Z_OK ) {
-            LOGGER_ERROR ( "Decompression PNG : probleme png decompression au debut de la ligne " << h );
-            delete[] raw_data;
+    // Les lignes filtrées (précédées de l'octet de filtre) sont décompressées par paquets d'environ 64 Ko, puis défiltrées directement dans le buffer
+    int packLines = std::max ( 1, std::min ( lines, 65536 / ( linesize + 1 ) ) );
+    context->rows.resize ( packLines * ( linesize + 1 ) );
+
+    size_t pos = 33;
+    zstream.avail_in = 0;
+
+    for ( int h = 0; h < lines; h += packLines ) {
+        int n = std::min ( packLines, lines - h );
+        zstream.next_out = &context->rows[0];
+        zstream.avail_out = n * ( linesize + 1 );
+
+        while ( zstream.avail_out > 0 ) {
+            if ( zstream.avail_in == 0 && ! nextPngIdat ( encData, encSize, pos, zstream ) ) break;
+            int err = inflate ( &zstream, Z_NO_FLUSH );
+            if ( err == Z_STREAM_END ) break;
+            if ( err != Z_OK && ! ( err == Z_BUF_ERROR && zstream.avail_in == 0 ) ) {
+                LOGGER_ERROR ( "Decompression PNG : probleme png decompression a partir de la ligne " << h << " " << err );
+                delete[] allocated;
+                size = 0;
+                return 0;
+            }
+        }
+        if ( zstream.avail_out > 0 ) {
+            LOGGER_ERROR ( "Decompression PNG : donnees tronquees a partir de la ligne " << h );
+            delete[] allocated;
+            size = 0;
             return 0;
         }
-        // Decompression des pixels de la ligne
-        zstream.next_out = ( uint8_t* ) ( raw_data + h*linesize );
-        zstream.avail_out = linesize * sizeof ( uint8_t );
-        if ( int err = inflate ( &zstream, Z_SYNC_FLUSH ) ) {
-
-            if ( err == Z_STREAM_END && h == height-1 ) break; // fin du fichier OK.
 
-            LOGGER_ERROR ( "Decompression PNG : probleme png decompression des pixels de la ligne " << h << " " << err );
-            delete[] raw_data;
-            return 0;
+        for ( int i = 0; i < n; i++ ) {
+            const uint8_t* in = &context->rows[i * ( linesize + 1 )];
+            uint8_t* out = buffer + ( h + i ) * linesize;
+            if ( ! unfilterPngLine ( in[0], in + 1, ( h + i ) ? out - linesize : 0, out, linesize, channels ) ) {
+                LOGGER_ERROR ( "Decompression PNG : type de filtre inconnu " << ( int ) in[0] << " a la ligne " << h + i );
+                delete[] allocated;
+                size = 0;
+                return 0;
+            }
         }
     }
-    // Destruction du flux
-    if ( inflateEnd ( &zstream ) !=Z_OK ) {
-        LOGGER_ERROR ( "Decompression PNG : probleme de liberation du flux" );
-        delete[] raw_data;
-        return 0;
-    }
 
-    size = width * height * channels;
+    size = linesize * lines;
+    return buffer;
+}
 
-    return raw_data;
+/**
+ * Decodage de donnee PNG
+ */
+const uint8_t* PngDecoder::decode ( DataSource* source, size_t &size ) {
+
+    size = 0;
+    if ( !source ) return 0;
+
+    size_t encSize;
+    const uint8_t* encData = source->getData ( encSize );
+
+    if ( !encData ) return 0;
+
+    return decodePng ( encData, encSize, 0, size );
+}
+
+size_t PngDecoder::decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size ) {
+    if ( ! decodePng ( encData, encSize, buffer, size ) ) return 0;
+    return size;
 }
 
 /**
@@ -289,6 +447,19 @@ const uint8_t* PackBitsDecoder::decode ( DataSource* source, size_t& size ) {
     return raw_data;
 }
 
+size_t PackBitsDecoder::decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size ) {
+    // Le décodeur PackBits alloue son buffer : on recopie la partie utile
+    pkbDecoder decoder;
+    size_t rawSize;
+    uint8_t* raw_data = decoder.decode ( encData,encSize,rawSize );
+    if ( !raw_data ) return 0;
+
+    size = std::min ( size, rawSize );
+    memcpy ( buffer, raw_data, size );
+    delete[] raw_data;
+    return size;
+}
+
 /**
  * Decodage de donnee LZW
  */
@@ -310,6 +481,19 @@ const uint8_t* LzwDecoder::decode ( DataSource* source, size_t& size ) {
     return raw_data;
 }
 
+size_t LzwDecoder::decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size ) {
+    // Le décodeur LZW alloue son buffer : on recopie la partie utile
+    lzwDecoder decoder ( 12 );
+    size_t rawSize;
+    uint8_t* raw_data = decoder.decode ( encData,encSize,rawSize );
+    if ( !raw_data ) return 0;
+
+    size = std::min ( size, rawSize );
+    memcpy ( buffer, raw_data, size );
+    delete[] raw_data;
+    return size;
+}
+
 
 /**
  * Decodage de donnee DEFLATE
@@ -324,24 +508,9 @@ const uint8_t* DeflateDecoder::decode ( DataSource* source, size_t &size ) {
 
     if ( !encData ) return 0;
 
-    // Initialisation du flux
-    z_stream zstream;
-    zstream.zalloc = Z_NULL;
-    zstream.zfree = Z_NULL;
-    zstream.opaque = Z_NULL;
-    zstream.data_type = Z_BINARY;
-    int zinit;
-    if ( ( zinit=inflateInit ( &zstream ) ) != Z_OK ) {
-        if ( zinit==Z_MEM_ERROR )
-            LOGGER_ERROR ( "Decompression DEFLATE : pas assez de memoire" );
-        else if ( zinit==Z_VERSION_ERROR )
-            LOGGER_ERROR ( "Decompression DEFLATE : versions de zlib incompatibles" );
-        else if ( zinit==Z_STREAM_ERROR )
-            LOGGER_ERROR ( "Decompression DEFLATE : parametres invalides" );
-        else
-            LOGGER_ERROR ( "Decompression DEFLATE : echec" );
-        return 0;
-    }
+    InflateContext* context = getInflateContext ( "DEFLATE" );
+    if ( ! context ) return 0;
+    z_stream& zstream = context->zstream;
 
     size_t rawSize = encSize * 2;
     uint8_t* raw_data = new uint8_t[rawSize];
@@ -371,15 +540,93 @@ const uint8_t* DeflateDecoder::decode ( DataSource* source, size_t &size ) {
         }
     }
 
-    // Destruction du flux
-    if ( inflateEnd ( &zstream ) !=Z_OK ) {
-        LOGGER_ERROR ( "Decompression DEFLATE : probleme de liberation du flux" );
+    size = rawSize - zstream.avail_out;
+
+    return raw_data;
+}
+
+size_t DeflateDecoder::decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size ) {
+
+    InflateContext* context = getInflateContext ( "DEFLATE" );
+    if ( ! context ) return 0;
+    z_stream& zstream = context->zstream;
+
+    zstream.next_in = ( uint8_t* ) ( encData );
+    zstream.avail_in = encSize;
+    zstream.next_out = buffer;
+    zstream.avail_out = size;
+
+    // Decompression du flux, jusqu'à ce que le buffer soit plein
+    while ( zstream.avail_out != 0 ) {
+        int err = inflate ( &zstream, Z_SYNC_FLUSH );
+        if ( err == Z_STREAM_END ) break; // fin du fichier OK.
+        if ( err == Z_BUF_ERROR && zstream.avail_in == 0 ) break; // données épuisées
+        if ( err != Z_OK ) {
+            LOGGER_ERROR ( "Decompression DEFLATE : probleme deflate decompression " << err );
+            return 0;
+        }
+    }
+
+    return size - zstream.avail_out;
+}
+
+
+/**
+ * Decodage de donnee GZIP
+ */
+const uint8_t* GzipDecoder::decode ( DataSource* source, size_t &size ) {
+
+    size = 0;
+    if ( !source ) return 0;
+
+    size_t encSize;
+    const uint8_t* encData = source->getData ( encSize );
+
+    if ( !encData ) return 0;
+
+    // Initialisation du flux, avec en-tête gzip
+    z_stream zstream;
+    zstream.zalloc = Z_NULL;
+    zstream.zfree = Z_NULL;
+    zstream.opaque = Z_NULL;
+    zstream.next_in = Z_NULL;
+    zstream.avail_in = 0;
+    if ( inflateInit2 ( &zstream, 16 + MAX_WBITS ) != Z_OK ) {
+        LOGGER_ERROR ( "Decompression GZIP : echec de l'initialisation du flux" );
+        return 0;
+    }
+
+    size_t rawSize = encSize * 4;
+    uint8_t* raw_data = new uint8_t[rawSize];
+
+    zstream.next_in = ( uint8_t* ) ( encData );
+    zstream.avail_in = encSize;
+    zstream.next_out = raw_data;
+    zstream.avail_out = rawSize;
+
+    // Decompression du flux jusqu'a sa fin, le tampon de sortie est agrandi au besoin
+    int err;
+    while ( ( err = inflate ( &zstream, Z_NO_FLUSH ) ) != Z_STREAM_END ) {
+        if ( ( err == Z_OK || err == Z_BUF_ERROR ) && zstream.avail_out == 0 ) {
+            uint8_t* tmp = new uint8_t[rawSize * 2];
+            memcpy ( tmp, raw_data, rawSize );
+            delete[] raw_data;
+            raw_data = tmp;
+            zstream.next_out = raw_data + rawSize;
+            zstream.avail_out = rawSize;
+            rawSize *= 2;
+            continue;
+        }
+        if ( err == Z_OK ) continue;
+
+        LOGGER_ERROR ( "Decompression GZIP : flux invalide ou tronque " << err );
+        inflateEnd ( &zstream );
         delete[] raw_data;
-        size = 0;
         return 0;
     }
 
     size = rawSize - zstream.avail_out;
+    inflateEnd ( &zstream );
 
     return raw_data;
 }
@@ -45,25 +45,68 @@
 #include "Data.h"
 #include "Image.h"
 #include "Utils.h"
+#include "Metrics.h"
 
+/**
+ * \~french
+ * \brief Décodeurs des tuiles
+ * \details Chaque décodeur propose deux décodages :
+ * \li decode ( DataSource*, size_t& ) : toute la tuile, dans un buffer alloué par le décodeur (à détruire par l'appelant)
+ * \li decode ( encData, encSize, buffer, size ) : les size premiers octets de la tuile, directement dans le buffer fourni par l'appelant. Le décodage s'arrête dès que le buffer est plein (dernière ligne utile atteinte), il retourne le nombre d'octets décodés, 0 en cas d'erreur
+ *
+ * Les décodages PNG et DEFLATE réutilisent un flux zlib propre à chaque thread, plutôt que d'en initialiser un par tuile.
+ * \~english
+ * \brief Tiles decoders
+ * \details Each decoder offers two decodings : the whole tile, in a buffer allocated by the decoder, or the size first bytes of the tile, straight into a buffer provided by the caller. The latter stops as soon as the buffer is full (last useful line reached) and returns the number of decoded bytes, 0 if error. PNG and DEFLATE decodings reuse a per thread zlib stream, instead of initializing one per tile.
+ */
 struct JpegDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static size_t decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size );
+    static const char* getName() { return "jpeg"; }
 };
 
+/**
+ * \~french \brief Décodage PNG, 8 bits par canal, non entrelacé, avec tous les types de filtre
+ * \~english \brief PNG decoding, 8 bits per sample, not interlaced, with all filter types
+ */
 struct PngDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static size_t decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size );
+    static const char* getName() { return "png"; }
 };
 
 struct LzwDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static size_t decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size );
+    static const char* getName() { return "lzw"; }
 };
 
 struct DeflateDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static size_t decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size );
+    static const char* getName() { return "deflate"; }
+};
+
+/**
+ * \~french \brief Décompression d'un flux gzip (tuiles vecteur précompressées)
+ * \~english \brief Gzip stream decompression (precompressed vector tiles)
+ */
+struct GzipDecoder {
+    static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static const char* getName() { return "gzip"; }
+    /**
+     * \~french \brief Les données commencent-elles par la signature gzip
+     * \~english \brief Do data start with gzip magic number
+     */
+    static bool isGzip ( const uint8_t* data, size_t size ) {
+        return size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+    }
 };
 
 struct PackBitsDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static size_t decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size );
+    static const char* getName() { return "packbits"; }
 };
 
 struct InvalidDecoder {
@@ -71,6 +114,10 @@ struct InvalidDecoder {
         size = 0;
         return 0;
     }
+    static size_t decode ( const uint8_t* encData, size_t encSize, uint8_t* buffer, size_t size ) {
+        return 0;
+    }
+    static const char* getName() { return "invalid"; }
 };
 
 
@@ -85,8 +132,14 @@ private:
     DataSource* encData;
     const uint8_t* decData;
     size_t decSize;
+    /**
+     * \~french \brief Nombre d'octets utiles de la tuile décodée, 0 pour la tuile entière
+     * \details Le décodage s'arrête après la dernière ligne utile
+     * \~english \brief Useful bytes count of the decoded tile, 0 for the whole tile
+     */
+    size_t neededSize;
 public:
-    DataSourceDecoder ( DataSource* encData ) : encData ( encData ), decData ( 0 ), decSize ( 0 ) {}
+    DataSourceDecoder ( DataSource* encData, size_t neededSize = 0 ) : encData ( encData ), decData ( 0 ), decSize ( 0 ), neededSize ( neededSize ) {}
 
     ~DataSourceDecoder() {
         if ( decData )
@@ -96,7 +149,20 @@ public:
 
     const uint8_t* getData ( size_t &size ) {
         if ( !decData && encData ) {
-            decData = Decoder::decode ( encData, decSize );
+            MetricsTimer timer ( Metrics::getStage ( "decode", "format", Decoder::getName() ) );
+            if ( neededSize ) {
+                size_t encSize;
+                const uint8_t* enc = encData->getData ( encSize );
+                uint8_t* buffer = new uint8_t[neededSize];
+                decSize = ( enc ? Decoder::decode ( enc, encSize, buffer, neededSize ) : 0 );
+                if ( decSize ) {
+                    decData = buffer;
+                } else {
+                    delete[] buffer;
+                }
+            } else {
+                decData = Decoder::decode ( encData, decSize );
+            }
             if ( !decData ) {
                 delete encData;
                 encData = 0;
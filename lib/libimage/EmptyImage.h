@@ -100,6 +100,10 @@ public:
         return width * channels;
     };
 
+    virtual bool isConstant() {
+        return true;
+    }
+
     virtual ~EmptyImage() {
         delete[] color;
     };
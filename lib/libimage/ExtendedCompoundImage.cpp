@@ -59,11 +59,11 @@
 /********************************************** ExtendedCompoundImage ************************************************/
 
 template <typename T>
-int ExtendedCompoundImage::_getline ( T* buffer, int line ) {
+int ExtendedCompoundImage::_getSampledLine ( T* buffer, int line, int offset, int step, int number ) {
     int i;
 
     // Initialisation de tous les pixels de la ligne avec la valeur de nodata
-    for ( i=0; i<width*channels; i++ ) {
+    for ( i=0; i<number*channels; i++ ) {
         buffer[i]= ( T ) nodata[i%channels];
     }
 
@@ -83,51 +83,66 @@ int ExtendedCompoundImage::_getline ( T* buffer, int line ) {
         }
 
         // c0 : indice de la 1ere colonne dans l'ExtendedCompoundImage de son intersection avec l'image courante
-        int c0 = c0s[i];
         // c1 : indice de la derniere colonne dans l'ExtendedCompoundImage de son intersection avec l'image courante
-        int c1 = c1s[i];
-
         // c2 : indice de de la 1ere colonne de l'ExtendedCompoundImage dans l'image courante
-        int c2 = c2s[i];
 
-        T* buffer_t = new T[sourceImages[i]->getWidth() * sourceImages[i]->getChannels()];
+        // Pixels demandés dans l'intersection : à partir de first, n pixels
+        int first;
+        int n = sampledColumns ( offset, step, number, c0s[i], c1s[i], &first );
+        if ( n == 0 ) {
+            continue;
+        }
 
-        sourceImages[i]->getline ( buffer_t,lineInSource );
+        // Colonne dans l'image courante du premier pixel demandé
+        int offsetInSource = offset + first * step - c0s[i] + c2s[i];
 
         if ( getMask ( i ) == NULL ) {
-            memcpy ( &buffer[c0*channels], &buffer_t[c2*channels], ( c1 + 1 - c0) *channels*sizeof ( T ) );
+            sourceImages[i]->getSampledLine ( &buffer[first*channels], lineInSource, offsetInSource, step, n );
         } else {
 
-            uint8_t* buffer_m = new uint8_t[getMask ( i )->getWidth()];
-            getMask ( i )->getline ( buffer_m,lineInSource );
+            sampleBuffer.resize ( n * channels * sizeof ( T ) );
+            maskBuffer.resize ( n );
+            T* buffer_t = ( T* ) &sampleBuffer[0];
 
-            for ( int j=0; j < c1 - c0 + 1; j++ ) {
-                if ( buffer_m[c2+j] ) {
-                    memcpy ( &buffer[ ( c0 + j ) *channels],&buffer_t[ ( c2+j ) *channels],sizeof ( T ) *channels );
+            sourceImages[i]->getSampledLine ( buffer_t, lineInSource, offsetInSource, step, n );
+            getMask ( i )->getSampledLine ( &maskBuffer[0], lineInSource, offsetInSource, step, n );
+
+            for ( int j = 0; j < n; j++ ) {
+                if ( maskBuffer[j] ) {
+                    memcpy ( &buffer[ ( first + j ) *channels],&buffer_t[ j *channels],sizeof ( T ) *channels );
                 }
             }
-
-            delete [] buffer_m;
         }
-        delete [] buffer_t;
     }
-    return width*channels*sizeof ( T );
+    return number*channels;
 }
 
 
 /* Implementation de getline pour les uint8_t */
 int ExtendedCompoundImage::getline ( uint8_t* buffer, int line ) {
-    return _getline ( buffer, line );
+    return _getSampledLine ( buffer, line, 0, 1, width );
 }
 
 /* Implementation de getline pour les float */
 int ExtendedCompoundImage::getline ( uint16_t* buffer, int line ) {
-    return _getline ( buffer, line );
+    return _getSampledLine ( buffer, line, 0, 1, width );
 }
 
 /* Implementation de getline pour les float */
 int ExtendedCompoundImage::getline ( float* buffer, int line ) {
-    return _getline ( buffer, line );
+    return _getSampledLine ( buffer, line, 0, 1, width );
+}
+
+int ExtendedCompoundImage::getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int ExtendedCompoundImage::getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int ExtendedCompoundImage::getSampledLine ( float* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
 }
 
 bool ExtendedCompoundImage::addMirrors ( int mirrorSize ) {
@@ -354,9 +369,9 @@ ExtendedCompoundImage* ExtendedCompoundImageFactory::createExtendedCompoundImage
 
 /********************************************** ExtendedCompoundMask *************************************************/
 
-int ExtendedCompoundMask::_getline ( uint8_t* buffer, int line ) {
+int ExtendedCompoundMask::_getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number ) {
 
-    memset ( buffer,0,width );
+    memset ( buffer,0,number );
 
     for ( uint i = ECI->getMirrorsNumber(); i < ECI->getImages()->size(); i++ ) {
         
@@ -376,29 +391,35 @@ int ExtendedCompoundMask::_getline ( uint8_t* buffer, int line ) {
         if ( ECI->getImages()->at ( i )->getXmin() >= getXmax() || ECI->getImages()->at ( i )->getXmax() <= getXmin() ) {
             continue;
         }
+
+        // Pixels demandés dans l'intersection avec l'image courante : à partir de first, n pixels
+        int first;
+        int n = sampledColumns ( offset, step, number, c0, c1, &first );
+        if ( n == 0 ) {
+            continue;
+        }
  
         if ( ECI->getMask ( i ) == NULL ) {
-            memset ( &buffer[c0], 255, c1 - c0 + 1 );
+            memset ( &buffer[first], 255, n );
         } else {
             // Récupération du masque de l'image courante de l'ECI.
-            uint8_t* buffer_m = new uint8_t[ECI->getMask ( i )->getWidth()];
-            ECI->getMask ( i )->getline ( buffer_m,lineInSource );
+            maskBuffer.resize ( n );
+            ECI->getMask ( i )->getSampledLine ( &maskBuffer[0], lineInSource, offset + first * step - c0 + c2, step, n );
             // On ajoute au masque actuel (on écrase si la valeur est différente de 0)
-            for ( int j = 0; j < c1 - c0 + 1; j++ ) {
-                if ( buffer_m[c2+j] ) {
-                    memcpy ( &buffer[c0+j],&buffer_m[c2+j],1 );
+            for ( int j = 0; j < n; j++ ) {
+                if ( maskBuffer[j] ) {
+                    buffer[first+j] = maskBuffer[j];
                 }
             }
-            delete [] buffer_m;
         }
     }
 
-    return width;
+    return number;
 }
 
 /* Implementation de getline pour les uint8_t */
 int ExtendedCompoundMask::getline ( uint8_t* buffer, int line ) {
-    return _getline ( buffer, line );
+    return _getSampledLine ( buffer, line, 0, 1, width );
 }
 
 /* Implementation de getline pour les float */
@@ -418,3 +439,23 @@ int ExtendedCompoundMask::getline ( float* buffer, int line ) {
     delete [] buffer_t;
     return width*channels;
 }
+
+int ExtendedCompoundMask::getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int ExtendedCompoundMask::getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number ) {
+    uint8_t* buffer_t = new uint8_t[number];
+    _getSampledLine ( buffer_t, line, offset, step, number );
+    convert ( buffer,buffer_t,number );
+    delete [] buffer_t;
+    return number;
+}
+
+int ExtendedCompoundMask::getSampledLine ( float* buffer, int line, int offset, int step, int number ) {
+    uint8_t* buffer_t = new uint8_t[number];
+    _getSampledLine ( buffer_t, line, offset, step, number );
+    convert ( buffer,buffer_t,number );
+    delete [] buffer_t;
+    return number;
+}
@@ -138,20 +138,36 @@ private:
      */
     int* nodata;
 
+    /**
+     * \~french \brief Pixels échantillonnés d'une image source masquée, réutilisé d'une ligne à l'autre
+     * \~english \brief Sampled pixels of a masked source image, reused from one line to another
+     */
+    std::vector<uint8_t> sampleBuffer;
+    /**
+     * \~french \brief Masque échantillonné d'une image source, réutilisé d'une ligne à l'autre
+     * \~english \brief Sampled mask of a source image, reused from one line to another
+     */
+    std::vector<uint8_t> maskBuffer;
+
     /** \~french
-     * \brief Retourne une ligne, flottante ou entière
+     * \brief Retourne une ligne sous-échantillonnée, flottante ou entière
      * \details Lorsque l'on veut récupérer une ligne d'une image composée, on va se reporter sur toutes les images source.
      *
      * \image html eci_getline.png
      *
-     * On lit en parallèle de chaque image source l'éventuel masque qui lui est associé. Ainsi, si un pixel n'est pas réellement de la donnée, on évite d'écraser les données du dessous. Si il n'y a pas de masque, on considère l'image source comme pleine (ne contient pas de non-donnée).
+     * On lit en parallèle de chaque image source l'éventuel masque qui lui est associé. Ainsi, si un pixel n'est pas réellement de la donnée, on évite d'écraser les données du dessous. Si il n'y a pas de masque, on considère l'image source comme pleine (ne contient pas de non-donnée) et ses pixels sont écrits directement dans le buffer de sortie.
+     *
+     * Seuls les pixels demandés sont lus dans les images sources : une ligne entière est l'échantillonnage de pas 1.
      *
-     * \param[in] buffer Tableau contenant au moins width*channels valeurs
+     * \param[in] buffer Tableau contenant au moins number*channels valeurs
      * \param[in] line Indice de la ligne à retourner (0 <= line < height)
+     * \param[in] offset Colonne du premier pixel retourné
+     * \param[in] step Pas entre deux colonnes retournées
+     * \param[in] number Nombre de pixels retournés
      * \return taille utile du buffer, 0 si erreur
      */
     template<typename T>
-    int _getline ( T* buffer, int line );
+    int _getSampledLine ( T* buffer, int line, int offset, int step, int number );
     
     /** \~french
      * \brief Calcule les offsets pour chaque image source
@@ -345,6 +361,10 @@ public:
     int getline ( float* buffer, int line );
     int getline ( uint16_t* buffer, int line );
 
+    int getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( float* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number );
+
     /**
      * \~french
      * \brief Destructeur par défaut
@@ -453,14 +473,23 @@ private:
      */
     ExtendedCompoundImage* ECI;
 
+    /**
+     * \~french \brief Masque échantillonné d'une image source, réutilisé d'une ligne à l'autre
+     * \~english \brief Sampled mask of a source image, reused from one line to another
+     */
+    std::vector<uint8_t> maskBuffer;
+
     /** \~french
-     * \brief Retourne une ligne entière
-     * \details Lors ce que l'on veut récupérer une ligne d'un masque composé, on va se reporter sur tous les masques des images source de l'image composée associée. Si une des images sources n'a pas de masque, on considère que celle-ci est pleine (ne contient pas de non-donnée).
-     * \param[out] buffer Tableau contenant au moins width*channels valeurs
+     * \brief Retourne une ligne sous-échantillonnée
+     * \details Lors ce que l'on veut récupérer une ligne d'un masque composé, on va se reporter sur tous les masques des images source de l'image composée associée. Si une des images sources n'a pas de masque, on considère que celle-ci est pleine (ne contient pas de non-donnée). Seuls les pixels demandés sont lus dans les masques sources.
+     * \param[out] buffer Tableau contenant au moins number valeurs
      * \param[in] line Indice de la ligne à retourner (0 <= line < height)
+     * \param[in] offset Colonne du premier pixel retourné
+     * \param[in] step Pas entre deux colonnes retournées
+     * \param[in] number Nombre de pixels retournés
      * \return taille utile du buffer, 0 si erreur
      */
-    int _getline ( uint8_t* buffer, int line );
+    int _getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number );
 
 public:
     /** \~french
@@ -480,6 +509,10 @@ public:
     int getline ( float* buffer, int line );
     int getline ( uint16_t* buffer, int line );
 
+    int getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( float* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number );
+
     /**
      * \~french
      * \brief Destructeur par défaut
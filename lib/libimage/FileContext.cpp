@@ -52,6 +52,8 @@
 #include <cstdio>
 #include <errno.h>
 #include <time.h>
+#include <cstring>
+#include "Metrics.h"
 
 using namespace std;
 
@@ -63,6 +65,7 @@ bool FileContext::connection() {
 }
 
 int FileContext::read(uint8_t* data, int offset, int size, std::string name) {
+    MetricsTimer timer ( Metrics::getStage ( "storage_read", "backend", getTypeStr() ) );
     std::string fullName = root_dir + name;
     LOGGER_DEBUG("File read : " << size << " bytes (from the " << offset << " one) in the file " << fullName);
 
@@ -87,6 +90,21 @@ int FileContext::read(uint8_t* data, int offset, int size, std::string name) {
     return read_size;
 }
 
+bool FileContext::getSize(std::string name, long& size, bool& exists) {
+    std::string fullName = root_dir + name;
+    struct stat st;
+    if ( stat ( fullName.c_str(), &st ) != 0 ) {
+        if ( errno == ENOENT ) {
+            exists = false;
+            return true;
+        }
+        LOGGER_ERROR ( "Impossible d'interroger le fichier " << fullName << " : " << strerror ( errno ) );
+        return false;
+    }
+    exists = true;
+    size = st.st_size;
+    return true;
+}
 
 bool FileContext::write(uint8_t* data, int offset, int size, std::string name) {
     std::string fullName = root_dir + name;
@@ -102,6 +102,7 @@ public:
 
 
     int read(uint8_t* data, int offset, int size, std::string name);
+    bool getSize(std::string name, long& size, bool& exists);
     bool write(uint8_t* data, int offset, int size, std::string name);
     bool writeFull(uint8_t* data, int size, std::string name);
 
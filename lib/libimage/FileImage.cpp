@@ -186,7 +186,8 @@ FileImage::FileImage (
 
     Image ( width,height,channels,resx,resy,bbox ),
     sampleformat ( sampleformat ), bitspersample ( bitspersample ), photometric ( photometric ), compression ( compression ),
-    esType(esType) {
+    esType(esType),
+    windowX ( 0 ), windowY ( 0 ), windowWidth ( width ), windowHeight ( height ), reduction ( 0 ), resolutionsCount ( 1 ), restricted ( false ) {
 
     filename = new char[IMAGE_MAX_FILENAME_LENGTH];
     strcpy ( filename,name );
@@ -194,3 +195,80 @@ FileImage::FileImage (
     converter = NULL;
 }
 
+bool FileImage::computeReadingWindow ( BoundingBox<double> area, double wantedResx, double wantedResy ) {
+
+    if ( converter ) {
+        LOGGER_WARN ( "Reading of the image " << filename << " cannot be restricted once a converter is added" );
+        return false;
+    }
+
+    if ( restricted ) {
+        // La restriction a déjà été faite, les informations de l'image ne sont plus celles de la pleine résolution
+        LOGGER_DEBUG ( "Reading of the image " << filename << " is already restricted" );
+        return false;
+    }
+
+    /******************** NIVEAU DE RÉSOLUTION *****************/
+
+    // On écarte autant de niveaux que possible, tant que la résolution obtenue reste au moins aussi fine que celle voulue
+    int r = 0;
+    if ( wantedResx > 0 && wantedResy > 0 ) {
+        while ( r + 1 < resolutionsCount &&
+                resx * ( 1 << ( r + 1 ) ) <= wantedResx * 1.001 &&
+                resy * ( 1 << ( r + 1 ) ) <= wantedResy * 1.001 ) {
+            r++;
+        }
+    }
+    int factor = 1 << r;
+
+    /************************ ZONE UTILE ***********************/
+
+    int c0 = 0, l0 = 0, c1 = width, l1 = height;
+
+    if ( bbox.intersects ( area ) ) {
+        c0 = __max ( 0, ( int ) floor ( ( area.xmin - bbox.xmin ) / resx ) );
+        c1 = __min ( width, ( int ) ceil ( ( area.xmax - bbox.xmin ) / resx ) );
+        l0 = __max ( 0, ( int ) floor ( ( bbox.ymax - area.ymax ) / resy ) );
+        l1 = __min ( height, ( int ) ceil ( ( bbox.ymax - area.ymin ) / resy ) );
+    }
+
+    if ( c1 <= c0 || l1 <= l0 ) {
+        c0 = 0; l0 = 0; c1 = width; l1 = height;
+    }
+
+    // Alignement sur la réduction : un pixel réduit couvre exactement factor x factor pixels pleine résolution
+    c0 -= c0 % factor;
+    l0 -= l0 % factor;
+
+    int newWidth = ( c1 - c0 + factor - 1 ) / factor;
+    int newHeight = ( l1 - l0 + factor - 1 ) / factor;
+
+    if ( r == 0 && newWidth == width && newHeight == height ) {
+        return false;
+    }
+
+    /***************** MISE À JOUR DE L'IMAGE ******************/
+
+    windowX = c0;
+    windowY = l0;
+    windowWidth = __min ( newWidth * factor, width - c0 );
+    windowHeight = __min ( newHeight * factor, height - l0 );
+    reduction = r;
+    restricted = true;
+
+    BoundingBox<double> newBbox (
+        bbox.xmin + c0 * resx, bbox.ymax - ( l0 + newHeight * factor ) * resy,
+        bbox.xmin + ( c0 + newWidth * factor ) * resx, bbox.ymax - l0 * resy
+    );
+
+    LOGGER_DEBUG ( "Image " << filename << " : decode " << windowWidth << "x" << windowHeight << " from (" << c0 << "," << l0 << ") with reduction " << r << " -> " << newWidth << "x" << newHeight );
+
+    width = newWidth;
+    height = newHeight;
+    resx *= factor;
+    resy *= factor;
+    bbox = newBbox;
+
+    return true;
+}
+
@@ -126,6 +126,65 @@ protected:
      */
     PixelConverter* converter;
 
+    /**
+     * \~french \brief Colonne pleine résolution du premier pixel à décoder
+     * \~english \brief Full resolution column of the first pixel to decode
+     */
+    int windowX;
+    /**
+     * \~french \brief Ligne pleine résolution du premier pixel à décoder
+     * \~english \brief Full resolution line of the first pixel to decode
+     */
+    int windowY;
+    /**
+     * \~french \brief Largeur pleine résolution de la zone à décoder
+     * \~english \brief Full resolution width of the area to decode
+     */
+    int windowWidth;
+    /**
+     * \~french \brief Hauteur pleine résolution de la zone à décoder
+     * \~english \brief Full resolution height of the area to decode
+     */
+    int windowHeight;
+    /**
+     * \~french \brief Nombre de niveaux de résolution écartés au décodage
+     * \details Les dimensions et résolutions de l'image sont celles de la pleine résolution divisées par 2^reduction
+     * \~english \brief Number of discarded resolution levels when decoding
+     * \details Image's dimensions and resolutions are the full resolution ones divided by 2^reduction
+     */
+    int reduction;
+    /**
+     * \~french \brief Nombre de niveaux de résolution que le format sait décoder, pleine résolution comprise
+     * \details Vaut 1 pour les formats qui ne savent décoder que la pleine résolution.
+     * \~english \brief Number of resolution levels the format can decode, full resolution included
+     * \details 1 for formats which can only decode the full resolution.
+     */
+    int resolutionsCount;
+    /**
+     * \~french \brief La zone ou le niveau de résolution à décoder a déjà été restreint
+     * \details Les dimensions, l'emprise et les résolutions de l'image ne sont alors plus celles du fichier, une nouvelle restriction est refusée.
+     * \~english \brief Area or resolution level to decode has already been restricted
+     * \details Image's dimensions, bounding box and resolutions are then no longer the file's ones, a new restriction is refused.
+     */
+    bool restricted;
+
+    /** \~french
+     * \brief Calcule la zone et le niveau de résolution à décoder
+     * \details La zone pleine résolution est alignée sur la réduction choisie, de sorte que chaque pixel réduit corresponde exactement à 2^reduction pixels pleine résolution. Met à jour les dimensions, l'emprise et les résolutions de l'image.
+     * \param[in] area zone utile, dans le système de coordonnées de l'image
+     * \param[in] wantedResx résolution en X souhaitée
+     * \param[in] wantedResy résolution en Y souhaitée
+     * \return Vrai si la zone a été restreinte ou la résolution réduite, faux si l'image est lue telle quelle ou a déjà été restreinte
+     ** \~english
+     * \brief Compute area and resolution level to decode
+     * \details Full resolution area is aligned on the chosen reduction, each reduced pixel matching exactly 2^reduction full resolution pixels. Image's dimensions, bounding box and resolutions are updated.
+     * \param[in] area useful area, in the image's coordinates system
+     * \param[in] wantedResx wanted X wise resolution
+     * \param[in] wantedResy wanted Y wise resolution
+     * \return True if the area was restricted or the resolution reduced, false if the image is read as it is or was already restricted
+     */
+    bool computeReadingWindow ( BoundingBox<double> area, double wantedResx, double wantedResy );
+
     /** \~french
      * \brief Crée un objet FileImage à partir de tous ses éléments constitutifs
      * \details Ce constructeur n'est appelé que par les constructeurs des classes filles
@@ -396,6 +455,30 @@ public:
         return converter->youCan();
     }
 
+    /**
+     * \~french
+     * \brief Restreint la lecture à une zone et, si le format le permet, à une résolution dégradée
+     * \details Les formats capables de décoder une sous-partie ou une version réduite de l'image (JPEG, JPEG2000) en profitent pour ne décoder que le nécessaire. L'image prend alors les dimensions, l'emprise et les résolutions de ce qui sera réellement lu. La résolution obtenue n'est jamais plus grossière que celle demandée. Par défaut, rien n'est fait.
+     *
+     * Doit être appelée avant toute lecture et avant l'ajout d'un convertisseur.
+     * \param[in] area zone utile, dans le système de coordonnées de l'image
+     * \param[in] wantedResx résolution en X des données que l'on va produire à partir de cette image
+     * \param[in] wantedResy résolution en Y des données que l'on va produire à partir de cette image
+     * \return Vrai si l'image est utilisable (restreinte ou non), faux en cas d'erreur
+     * \~english
+     * \brief Restrict reading to an area and, when the format allows it, to a reduced resolution
+     * \details Formats able to decode a part or a reduced version of the image (JPEG, JPEG2000) use it to decode only what is needed. The image then takes the dimensions, bounding box and resolutions of what will really be read. Obtained resolution is never coarser than the wanted one. Nothing is done by default.
+     *
+     * Have to be called before any reading and before adding a converter.
+     * \param[in] area useful area, in the image's coordinates system
+     * \param[in] wantedResx X wise resolution of data produced from this image
+     * \param[in] wantedResy Y wise resolution of data produced from this image
+     * \return True if the image is usable (restricted or not), false if error
+     */
+    virtual bool restrictReading ( BoundingBox<double> area, double wantedResx, double wantedResy ) {
+        return true;
+    }
+
     /**
      * \~french
      * \brief Destructeur par défaut
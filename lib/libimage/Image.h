@@ -146,6 +146,87 @@ protected:
         resy= ( bbox.ymax - bbox.ymin ) /double ( height );
     }
 
+    /**
+     * \~french
+     * \brief Recopie un pixel sur step, à partir d'une ligne entrelacée
+     * \param[out] to pixels échantillonnés, contigus
+     * \param[in] from premier pixel à recopier
+     * \param[in] spp nombre de canaux par pixel
+     * \param[in] step pas entre deux pixels recopiés
+     * \param[in] number nombre de pixels à recopier
+     * \~english
+     * \brief Copy one pixel in step, from an interleaved line
+     * \param[out] to sampled pixels, contiguous
+     * \param[in] from first pixel to copy
+     * \param[in] spp number of samples per pixel
+     * \param[in] step step between two copied pixels
+     * \param[in] number number of pixels to copy
+     */
+    template<typename T>
+    static void samplePixels ( T* to, const T* from, int spp, int step, int number ) {
+        if ( step == 1 ) {
+            memcpy ( to, from, number * spp * sizeof ( T ) );
+            return;
+        }
+        for ( int i = 0; i < number; i++ ) {
+            for ( int c = 0; c < spp; c++ ) {
+                to[c] = from[c];
+            }
+            to += spp;
+            from += step * spp;
+        }
+    }
+
+    /**
+     * \~french
+     * \brief Pixels d'une ligne sous-échantillonnée compris dans un intervalle de colonnes
+     * \param[in] offset colonne du premier pixel échantillonné
+     * \param[in] step pas entre deux pixels échantillonnés
+     * \param[in] number nombre de pixels échantillonnés
+     * \param[in] c0 première colonne de l'intervalle
+     * \param[in] c1 dernière colonne de l'intervalle
+     * \param[out] first indice du premier pixel échantillonné dans l'intervalle
+     * \return nombre de pixels échantillonnés dans l'intervalle
+     * \~english
+     * \brief Pixels of a sampled line included in a columns range
+     * \param[in] offset column of the first sampled pixel
+     * \param[in] step step between two sampled pixels
+     * \param[in] number number of sampled pixels
+     * \param[in] c0 first column of the range
+     * \param[in] c1 last column of the range
+     * \param[out] first indice of the first sampled pixel in the range
+     * \return number of sampled pixels in the range
+     */
+    static int sampledColumns ( int offset, int step, int number, int c0, int c1, int* first ) {
+        if ( c1 < offset || c1 < c0 ) {
+            return 0;
+        }
+        *first = ( offset < c0 ? ( c0 - offset + step - 1 ) / step : 0 );
+        int last = __min ( number - 1, ( c1 - offset ) / step );
+        return __max ( 0, last - *first + 1 );
+    }
+
+    /**
+     * \~french
+     * \brief Ligne sous-échantillonnée, par lecture de la ligne entière
+     * \details Implémentation par défaut de #getSampledLine, pour les images qui ne savent pas faire mieux.
+     * \~english
+     * \brief Sampled line, reading the whole line
+     * \details Default #getSampledLine implementation, for images which cannot do better.
+     */
+    template<typename T>
+    int _getSampledLine ( T* buffer, int line, int offset, int step, int number ) {
+        int spp = getChannels();
+        T* full = new T[width * spp];
+        if ( getline ( full, line ) == 0 ) {
+            delete [] full;
+            return 0;
+        }
+        samplePixels ( buffer, full + offset * spp, spp, step, number );
+        delete [] full;
+        return number * spp;
+    }
+
 public:
     
     /**
@@ -700,6 +781,66 @@ public:
      */
     virtual int getline ( float *buffer, int line ) = 0;
 
+    /**
+     * \~french
+     * \brief Retourne une ligne sous-échantillonnée, en entier 8 bits
+     * \details Seuls les pixels des colonnes offset, offset + step, ..., offset + (number - 1) * step sont retournés, de manière contiguë. Les canaux sont entrelacés et les conversions sont celles de #getline. Les images qui le peuvent ne lisent ni ne décodent les pixels écartés : c'est ce qu'utilisent les images décimées. Par défaut, la ligne est lue entièrement puis échantillonnée.
+     * \param[in,out] buffer Tableau contenant au moins 'number * channels' entier sur 8 bits
+     * \param[in] line Indice de la ligne à retourner (0 <= line < height)
+     * \param[in] offset Colonne du premier pixel retourné
+     * \param[in] step Pas entre deux colonnes retournées (au moins 1)
+     * \param[in] number Nombre de pixels retournés (offset + (number - 1) * step < width)
+     * \return taille utile du buffer, 0 si erreur
+     * \~english
+     * \brief Return a sampled line, 8-bit integers
+     * \details Only pixels of columns offset, offset + step, ..., offset + (number - 1) * step are returned, contiguously. Samples are interleaved and conversions are the #getline ones. Images able to do it neither read nor decode discarded pixels : decimated images use it. By default, the whole line is read then sampled.
+     * \param[in,out] buffer Array of at least 'number * channels' 8-bit integers
+     * \param[in] line Line indice (0 <= line < height)
+     * \param[in] offset Column of the first returned pixel
+     * \param[in] step Step between two returned columns (at least 1)
+     * \param[in] number Number of returned pixels (offset + (number - 1) * step < width)
+     * \return buffer's useful size, 0 if error
+     */
+    virtual int getSampledLine ( uint8_t *buffer, int line, int offset, int step, int number ) {
+        return _getSampledLine ( buffer, line, offset, step, number );
+    }
+
+    /**
+     * \~french
+     * \brief Retourne une ligne sous-échantillonnée, en entier 16 bits
+     * \details Voir la version 8 bits.
+     * \~english
+     * \brief Return a sampled line, 16-bit integers
+     * \details See 8-bit version.
+     */
+    virtual int getSampledLine ( uint16_t *buffer, int line, int offset, int step, int number ) {
+        return _getSampledLine ( buffer, line, offset, step, number );
+    }
+
+    /**
+     * \~french
+     * \brief Retourne une ligne sous-échantillonnée, en flottant 32 bits
+     * \details Voir la version 8 bits.
+     * \~english
+     * \brief Return a sampled line, 32-bit floats
+     * \details See 8-bit version.
+     */
+    virtual int getSampledLine ( float *buffer, int line, int offset, int step, int number ) {
+        return _getSampledLine ( buffer, line, offset, step, number );
+    }
+
+    /**
+     * \~french
+     * \brief L'image est-elle uniforme, de la valeur de non-donnée
+     * \details Une telle image peut être remplacée par une image vide de mêmes dimensions, et sa version encodée réutilisée.
+     * \~english
+     * \brief Is the image uniform, with the nodata value
+     * \details Such an image can be replaced by an empty image with same dimensions, and its encoded version reused.
+     */
+    virtual bool isConstant() {
+        return false;
+    }
+
     /**
      * \~french
      * \brief Destructeur par défaut
@@ -38,18 +38,24 @@
 #include "JPEGEncoder.h"
 #include <assert.h>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// Taille du bloc de sortie de la libjpeg
+#define JPEG_OUTPUT_BLOCK_SIZE 65536
 
 /** Constructeur */
-JPEGEncoder::JPEGEncoder ( Image* image ) : image ( image ), status ( -1 ) {
+JPEGEncoder::JPEGEncoder ( Image* image, const JpegOptions& options ) : image ( image ), status ( -1 ), linebuffer ( NULL ), block ( JPEG_OUTPUT_BLOCK_SIZE ), pendingPos ( 0 ) {
     cinfo.err = jpeg_std_error ( &jerr );
     jpeg_create_compress ( &cinfo );
-    cinfo.dest = new jpeg_destination_mgr;
+    cinfo.client_data = this;
+    cinfo.dest = &dest;
 
-    cinfo.dest->init_destination = init_destination;
-    cinfo.dest->empty_output_buffer = empty_output_buffer;
-    cinfo.dest->term_destination = term_destination;
-    cinfo.dest->next_output_byte = 0;
-    cinfo.dest->free_in_buffer = 0;
+    dest.init_destination = init_destination;
+    dest.empty_output_buffer = empty_output_buffer;
+    dest.term_destination = term_destination;
+    dest.next_output_byte = &block[0];
+    dest.free_in_buffer = block.size();
 
     cinfo.image_width = image->getWidth();
     cinfo.image_height = image->getHeight();
@@ -59,12 +65,47 @@ JPEGEncoder::JPEGEncoder ( Image* image ) : image ( image ), status ( -1 ) {
     else if ( image->getChannels() == 4 ) cinfo.in_color_space = JCS_EXT_RGBX;
     else cinfo.in_color_space = JCS_UNKNOWN;
 
-
     jpeg_set_defaults ( &cinfo );
+    options.apply ( &cinfo );
+}
 
-    bufferLimit = std::max ( 1024, ( ( image->getWidth() * image->getChannels() ) / 2 ) );
+boolean JPEGEncoder::empty_output_buffer ( jpeg_compress_struct *cinfo ) {
+    // Le bloc est plein : il passe entièrement dans les données en attente
+    JPEGEncoder* encoder = ( JPEGEncoder* ) cinfo->client_data;
+    encoder->pending.insert ( encoder->pending.end(), encoder->block.begin(), encoder->block.end() );
+    cinfo->dest->next_output_byte = &encoder->block[0];
+    cinfo->dest->free_in_buffer = encoder->block.size();
+    return true;
+}
 
-    linebuffer = new uint8_t[image->getWidth() *image->getChannels()];
+void JPEGEncoder::flushBlock() {
+    pending.insert ( pending.end(), block.begin(), block.end() - dest.free_in_buffer );
+    dest.next_output_byte = &block[0];
+    dest.free_in_buffer = block.size();
+}
+
+void JPEGEncoder::encodeStep() {
+    if ( status < 0 ) {
+        // Première étape : on initialise la compression (écrit l'en-tête)
+        jpeg_start_compress ( &cinfo, true );
+        // On compresse une ligne de MCU à la fois : c'est l'unité de travail de la libjpeg
+        rows.resize ( cinfo.max_v_samp_factor * DCTSIZE );
+        linebuffer = new uint8_t[rows.size() * image->getWidth() * image->getChannels()];
+        for ( unsigned int i = 0; i < rows.size(); i++ ) {
+            rows[i] = linebuffer + i * image->getWidth() * image->getChannels();
+        }
+        status = 0;
+    } else if ( cinfo.next_scanline < cinfo.image_height ) {
+        int number = std::min ( ( int ) rows.size(), ( int ) ( cinfo.image_height - cinfo.next_scanline ) );
+        for ( int i = 0; i < number; i++ ) {
+            image->getline ( rows[i], cinfo.next_scanline + i );
+        }
+        jpeg_write_scanlines ( &cinfo, &rows[0], number );
+    } else {
+        jpeg_finish_compress ( &cinfo );
+        status = 1;
+    }
+    flushBlock();
 }
 
 /**
@@ -72,32 +113,25 @@ JPEGEncoder::JPEGEncoder ( Image* image ) : image ( image ), status ( -1 ) {
 */
 
 size_t JPEGEncoder::read ( uint8_t *buffer, size_t size ) {
-    if ( size < 1024 ) {
-        return 0;
-    }
-
-    // On initialise le buffer d'écriture de la libjpeg
-    cinfo.dest->next_output_byte = buffer;
-    cinfo.dest->free_in_buffer = size;
-    // Première passe : on initialise la compression (écrit déjà quelques données)
-    if ( status < 0 && cinfo.dest->free_in_buffer >= bufferLimit ) {
-        jpeg_start_compress ( &cinfo, true );
-        status = 0;
-    }
-    while ( cinfo.next_scanline < cinfo.image_height && cinfo.dest->free_in_buffer >= bufferLimit ) {
-        image->getline ( linebuffer, cinfo.next_scanline );
-        if ( jpeg_write_scanlines ( &cinfo, &linebuffer, 1 ) < 1 ) break;
-    }
-    if ( status == 0 && cinfo.next_scanline >= cinfo.image_height && cinfo.dest->free_in_buffer >= bufferLimit/10 ) {
-        jpeg_finish_compress ( &cinfo );
-        status = 1;
+    size_t pos = 0;
+    while ( pos < size ) {
+        if ( pendingPos < pending.size() ) {
+            size_t n = std::min ( size - pos, pending.size() - pendingPos );
+            memcpy ( buffer + pos, &pending[pendingPos], n );
+            pos += n;
+            pendingPos += n;
+            continue;
+        }
+        if ( status == 1 ) break;
+        pending.clear();
+        pendingPos = 0;
+        encodeStep();
     }
-    return ( size - cinfo.dest->free_in_buffer );
+    return pos;
 }
 
 /** Destructeur */
 JPEGEncoder::~JPEGEncoder() {
-    delete cinfo.dest;
     jpeg_destroy_compress ( &cinfo );
     delete[] linebuffer;
     delete image;
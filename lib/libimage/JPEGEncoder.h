@@ -40,33 +40,83 @@
 
 #include "Data.h"
 #include "Image.h"
+#include "JpegOptions.h"
 #include "jpeglib.h"
+#include <vector>
 
-/** D */
+/**
+ * \~french \brief Encodage JPEG d'une image, au fil de la lecture
+ * \details Les lignes sont lues et compressées par paquets d'une ligne de MCU (8 ou 16 lignes). Les données compressées sont accumulées dans un tampon interne, vidé par les lectures successives : la taille du buffer de lecture est libre et la compression n'est jamais suspendue.
+ * \~english \brief JPEG encoding of an image, while reading
+ * \details Lines are read and compressed by packs of one MCU row (8 or 16 lines). Compressed data are accumulated in an internal buffer, emptied by successive reads : read buffer size is free and compression is never suspended.
+ */
 class JPEGEncoder : public DataStream {
 private:
     Image *image;
 
+    /**
+     * \~french \brief État de la compression : -1 non commencée, 0 en cours, 1 terminée
+     * \~english \brief Compression status : -1 not started, 0 in progress, 1 finished
+     */
     int status;
-    int bufferLimit;
+
+    /**
+     * \~french \brief Lignes de l'image à compresser ensemble
+     * \~english \brief Image's lines to compress together
+     */
     uint8_t *linebuffer;
+    /**
+     * \~french \brief Pointeurs sur les lignes de #linebuffer
+     * \~english \brief Pointers to #linebuffer lines
+     */
+    std::vector<JSAMPROW> rows;
+
+    /**
+     * \~french \brief Bloc de sortie de la libjpeg
+     * \~english \brief libjpeg output block
+     */
+    std::vector<uint8_t> block;
+    /**
+     * \~french \brief Données compressées pas encore lues, à partir de #pendingPos
+     * \~english \brief Compressed data not yet read, from #pendingPos
+     */
+    std::vector<uint8_t> pending;
+    size_t pendingPos;
 
     struct jpeg_compress_struct cinfo;
     struct jpeg_error_mgr jerr;
+    struct jpeg_destination_mgr dest;
 
     static void init_destination ( jpeg_compress_struct *cinfo ) {
         return;
     }
-    static boolean empty_output_buffer ( jpeg_compress_struct *cinfo ) {
-        return false;
-    }
+    static boolean empty_output_buffer ( jpeg_compress_struct *cinfo );
     static void term_destination ( jpeg_compress_struct *cinfo ) {
         return;
     }
 
+    /**
+     * \~french \brief Ajoute le contenu du bloc de sortie aux données en attente et le vide
+     * \~english \brief Add output block content to pending data and empty it
+     */
+    void flushBlock();
+
+    /**
+     * \~french \brief Avance la compression d'une étape : début, paquet de lignes ou fin
+     * \~english \brief Move compression forward by one step : start, pack of lines or end
+     */
+    void encodeStep();
+
 public:
-    /** D */
-    JPEGEncoder ( Image* image );
+    /**
+     * \~french \brief Crée un encodeur JPEG
+     * \param[in] image image à encoder, détruite avec l'encodeur
+     * \param[in] options paramètres de la compression
+     * \~english \brief Create a JPEG encoder
+     * \param[in] image image to encode, deleted with the encoder
+     * \param[in] options compression parameters
+     */
+    JPEGEncoder ( Image* image, const JpegOptions& options = JpegOptions() );
 
     /** D */
     ~JPEGEncoder();
@@ -77,7 +127,7 @@ public:
     size_t read ( uint8_t *buffer, size_t size );
 
     bool eof() {
-        return ( cinfo.next_scanline >= cinfo.image_height );
+        return ( status == 1 && pendingPos >= pending.size() );
     }
 
     std::string getType() {
@@ -98,5 +148,3 @@ public:
 };
 
 #endif
-
-
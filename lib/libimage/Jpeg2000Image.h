@@ -78,6 +78,7 @@
 class Jpeg2000Image : public FileImage {
 
 protected:
+
     /** \~french
      * \brief Crée un objet Jpeg2000Image à partir de tous ses éléments constitutifs
      * \details Ce constructeur est protégé afin de n'être appelé que par l'usine Jpeg2000ImageFactory, qui fera différents tests et calculs.
@@ -211,6 +212,9 @@ public:
      */
     void print() {
         FileImage::print();
+        if ( reduction != 0 || windowWidth != width || windowHeight != height ) {
+            LOGGER_INFO ( "\t- Decoded window : " << windowWidth << "x" << windowHeight << " from (" << windowX << "," << windowY << "), reduction " << reduction );
+        }
     }
 };
 
@@ -0,0 +1,96 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file JpegOptions.cpp
+ * \~french
+ * \brief Implémentation de la classe JpegOptions, paramètres de la compression JPEG
+ * \~english
+ * \brief Implement the JpegOptions class, JPEG compression parameters
+ */
+
+#include "JpegOptions.h"
+#include <sstream>
+
+bool JpegOptions::setQuality ( int q ) {
+    if ( q < 1 || q > 100 ) return false;
+    quality = q;
+    return true;
+}
+
+bool JpegOptions::setSubsampling ( std::string s ) {
+    if ( s == "4:2:0" || s == "420" ) {
+        hSampling = 2;
+        vSampling = 2;
+    } else if ( s == "4:2:2" || s == "422" ) {
+        hSampling = 2;
+        vSampling = 1;
+    } else if ( s == "4:4:4" || s == "444" ) {
+        hSampling = 1;
+        vSampling = 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool JpegOptions::setDct ( std::string s ) {
+    if ( s == "islow" ) dct = JDCT_ISLOW;
+    else if ( s == "ifast" ) dct = JDCT_IFAST;
+    else if ( s == "float" ) dct = JDCT_FLOAT;
+    else return false;
+    return true;
+}
+
+void JpegOptions::apply ( jpeg_compress_struct* cinfo ) const {
+    jpeg_set_quality ( cinfo, quality, true );
+    // La chrominance (composantes 1 et 2) garde un facteur 1 : seul celui de la luminance change
+    if ( cinfo->jpeg_color_space == JCS_YCbCr ) {
+        cinfo->comp_info[0].h_samp_factor = hSampling;
+        cinfo->comp_info[0].v_samp_factor = vSampling;
+    }
+    cinfo->dct_method = dct;
+    cinfo->optimize_coding = optimize;
+}
+
+std::string JpegOptions::toString() const {
+    std::ostringstream oss;
+    oss << "quality " << quality << ", subsampling " << ( hSampling == 2 ? ( vSampling == 2 ? "4:2:0" : "4:2:2" ) : "4:4:4" )
+        << ", dct " << ( dct == JDCT_ISLOW ? "islow" : ( dct == JDCT_IFAST ? "ifast" : "float" ) )
+        << ( optimize ? ", optimized Huffman tables" : "" );
+    return oss.str();
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file JpegOptions.h
+ * \~french
+ * \brief Définition de la classe JpegOptions, paramètres de la compression JPEG
+ * \~english
+ * \brief Define the JpegOptions class, JPEG compression parameters
+ */
+
+#ifndef JPEGOPTIONS_H
+#define JPEGOPTIONS_H
+
+#include <cstdio>
+#include <string>
+#include "jpeglib.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Paramètres de la compression JPEG
+ * \details Permet de choisir, par couche ou par pyramide, le compromis entre le temps de calcul et la taille des images :
+ * \li la qualité, de 1 à 100
+ * \li le sous-échantillonnage de la chrominance : 4:2:0, 4:2:2 ou 4:4:4 (sans effet sur une image en niveaux de gris)
+ * \li la méthode de calcul de la DCT : islow (entière précise), ifast (entière rapide, moins précise) ou float
+ * \li l'optimisation des tables de Huffman (images plus petites, mais encodage plus long)
+ *
+ * Les valeurs par défaut sont celles de la libjpeg : qualité 75, 4:2:0, islow et tables standards.
+ * \~english
+ * \brief JPEG compression parameters
+ * \details Allow to choose, by layer or by pyramid, the tradeoff between computing time and images' size : quality (1 to 100), chroma subsampling (4:2:0, 4:2:2 or 4:4:4), DCT method (islow, ifast or float) and Huffman tables optimisation. Default values are libjpeg's ones : quality 75, 4:2:0, islow and standard tables.
+ */
+class JpegOptions {
+
+private:
+    /**
+     * \~french \brief Qualité, de 1 à 100
+     * \~english \brief Quality, from 1 to 100
+     */
+    int quality;
+
+    /**
+     * \~french \brief Facteurs d'échantillonnage horizontal et vertical de la luminance, par rapport à la chrominance
+     * \details 2 et 2 pour du 4:2:0, 2 et 1 pour du 4:2:2, 1 et 1 pour du 4:4:4
+     * \~english \brief Horizontal and vertical sampling factors of luminance, relative to chrominance
+     */
+    int hSampling, vSampling;
+
+    /**
+     * \~french \brief Méthode de calcul de la DCT
+     * \~english \brief DCT method
+     */
+    J_DCT_METHOD dct;
+
+    /**
+     * \~french \brief Optimisation des tables de Huffman
+     * \~english \brief Huffman tables optimisation
+     */
+    bool optimize;
+
+public:
+    /**
+     * \~french \brief Crée des paramètres par défaut
+     * \~english \brief Create default parameters
+     */
+    JpegOptions() : quality ( 75 ), hSampling ( 2 ), vSampling ( 2 ), dct ( JDCT_ISLOW ), optimize ( false ) {}
+
+    /**
+     * \~french \brief Définit la qualité
+     * \param[in] q qualité, de 1 à 100
+     * \return faux si la valeur n'est pas valide
+     * \~english \brief Set quality
+     * \param[in] q quality, from 1 to 100
+     * \return false if the value is not valid
+     */
+    bool setQuality ( int q );
+
+    /**
+     * \~french \brief Définit le sous-échantillonnage de la chrominance
+     * \param[in] s 4:2:0, 4:2:2 ou 4:4:4 (ou 420, 422, 444)
+     * \return faux si la valeur n'est pas valide
+     * \~english \brief Set chroma subsampling
+     * \param[in] s 4:2:0, 4:2:2 or 4:4:4 (or 420, 422, 444)
+     * \return false if the value is not valid
+     */
+    bool setSubsampling ( std::string s );
+
+    /**
+     * \~french \brief Définit la méthode de calcul de la DCT
+     * \param[in] s islow, ifast ou float
+     * \return faux si la valeur n'est pas valide
+     * \~english \brief Set DCT method
+     * \param[in] s islow, ifast or float
+     * \return false if the value is not valid
+     */
+    bool setDct ( std::string s );
+
+    /**
+     * \~french \brief Active ou non l'optimisation des tables de Huffman
+     * \~english \brief Enable or not Huffman tables optimisation
+     */
+    void setOptimize ( bool o ) {
+        optimize = o;
+    }
+
+    int getQuality() const {
+        return quality;
+    }
+    int getHorizontalSampling() const {
+        return hSampling;
+    }
+    int getVerticalSampling() const {
+        return vSampling;
+    }
+
+    /**
+     * \~french \brief Applique les paramètres à une compression
+     * \details Doit être appelée après jpeg_set_defaults. Le sous-échantillonnage ne s'applique que si l'image est encodée en YCbCr.
+     * \param[in,out] cinfo structure de compression de la libjpeg
+     * \~english \brief Apply parameters to a compression
+     * \details Have to be called after jpeg_set_defaults. Subsampling is applied only if image is encoded in YCbCr.
+     * \param[in,out] cinfo libjpeg compression structure
+     */
+    void apply ( jpeg_compress_struct* cinfo ) const;
+
+    /**
+     * \~french \brief Description des paramètres, pour les logs
+     * \~english \brief Parameters' description, for logs
+     */
+    std::string toString() const;
+};
+
+#endif // JPEGOPTIONS_H
@@ -77,12 +77,14 @@ LibjpegImage* LibjpegImageFactory::createLibjpegImageToRead ( char* filename, Bo
 
     jpeg_read_header(&cinfo, TRUE);
 
-    jpeg_start_decompress(&cinfo);
-
-    int width = cinfo.output_width;
-    int height = cinfo.output_height;
+    int width = cinfo.image_width;
+    int height = cinfo.image_height;
     int channels = cinfo.num_components;
 
+    // Seul l'en-tête est lu : l'image sera décodée à la première lecture
+    jpeg_destroy_decompress(&cinfo);
+    fclose ( file );
+
     Photometric::ePhotometric ph;
     if (channels == 3) {
         ph = Photometric::RGB;
@@ -105,32 +107,11 @@ LibjpegImage* LibjpegImageFactory::createLibjpegImageToRead ( char* filename, Bo
         resy = 1.;
     }
 
-    /************** LECTURE DE L'IMAGE EN ENTIER ***************/
-
-    unsigned char** data = new unsigned char*[height];
-    for (int i = 0; i < height; ++i)
-    {
-        data[i] = new unsigned char[width * channels];
-    }
-    unsigned char** ptr = data;
-
-    while (cinfo.output_scanline < height) {
-        jpeg_read_scanlines(&cinfo, ptr, 1);
-        ptr ++;
-    }
-
-
-    jpeg_finish_decompress(&cinfo);
-    jpeg_destroy_decompress(&cinfo);
-
-    fclose ( file );
-
     /******************** CRÉATION DE L'OBJET ******************/
     
     return new LibjpegImage (
         width, height, resx, resy, channels, bbox, filename,
-        SampleFormat::UINT, 8, ph, Compression::JPEG,
-        data
+        SampleFormat::UINT, 8, ph, Compression::JPEG
     );
     
 }
@@ -140,13 +121,100 @@ LibjpegImage* LibjpegImageFactory::createLibjpegImageToRead ( char* filename, Bo
 
 LibjpegImage::LibjpegImage (
     int width,int height, double resx, double resy, int channels, BoundingBox<double> bbox, char* name,
-    SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression,
-    unsigned char** data ) :
+    SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression ) :
 
     FileImage ( width, height, resx, resy, channels, bbox, name, sampleformat, bitspersample, photometric, compression, ExtraSample::ALPHA_UNASSOC ),
 
-    data(data) {
-        
+    data ( NULL ) {
+
+    // libjpeg sait décoder directement au 1/2, 1/4 et 1/8 (mise à l'échelle de la DCT)
+    resolutionsCount = 4;
+}
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ---------------------------------------- ZONE DE LECTURE --------------------------------------- */
+
+bool LibjpegImage::restrictReading ( BoundingBox<double> area, double wantedResx, double wantedResy ) {
+    if ( data ) {
+        // L'image a déjà été décodée, on la garde telle quelle
+        return true;
+    }
+    computeReadingWindow ( area, wantedResx, wantedResy );
+    return true;
+}
+
+bool LibjpegImage::decode () {
+
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+
+    FILE *file = fopen ( filename, "rb" );
+    if ( !file ) {
+        LOGGER_ERROR ( "Unable to open the file (to read) " << filename );
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+
+    // Réduction par la DCT : on obtient directement l'image au 1/2^reduction
+    int factor = 1 << reduction;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = factor;
+
+    jpeg_start_decompress(&cinfo);
+
+    // Première ligne et première colonne de la zone utile, à la résolution décodée
+    int firstLine = windowY / factor;
+    int firstColumn = windowX / factor;
+
+    if ( firstColumn + width > ( int ) cinfo.output_width || firstLine + height > ( int ) cinfo.output_height ) {
+        LOGGER_ERROR ( "Decoded dimensions of the JPEG image " << filename << " are not the expected ones" );
+        jpeg_destroy_decompress(&cinfo);
+        fclose ( file );
+        return false;
+    }
+
+#ifdef LIBJPEG_TURBO_VERSION
+    // Seules les colonnes et les lignes utiles sont décodées. La zone décodée commence sur un bloc : on décale la lecture en conséquence
+    if ( firstColumn != 0 || width != ( int ) cinfo.output_width ) {
+        JDIMENSION xoffset = firstColumn;
+        JDIMENSION cropWidth = width;
+        jpeg_crop_scanline(&cinfo, &xoffset, &cropWidth);
+        firstColumn -= xoffset;
+    }
+    if ( firstLine > 0 ) {
+        jpeg_skip_scanlines(&cinfo, firstLine);
+    }
+#else
+    JSAMPLE* skipped = new JSAMPLE[cinfo.output_width * channels];
+    while ( ( int ) cinfo.output_scanline < firstLine ) {
+        jpeg_read_scanlines(&cinfo, &skipped, 1);
+    }
+    delete[] skipped;
+#endif
+
+    JSAMPLE* scanline = new JSAMPLE[cinfo.output_width * channels];
+
+    data = new unsigned char*[height];
+    for (int i = 0; i < height; ++i) {
+        jpeg_read_scanlines(&cinfo, &scanline, 1);
+        data[i] = new unsigned char[width * channels];
+        memcpy ( data[i], scanline + firstColumn * channels, width * channels );
+    }
+
+    delete[] scanline;
+
+    // Les lignes sous la zone utile ne sont pas décodées
+    jpeg_abort_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    fclose ( file );
+
+    return true;
 }
 
 /* ------------------------------------------------------------------------------------------------ */
@@ -155,6 +223,11 @@ LibjpegImage::LibjpegImage (
 template<typename T>
 int LibjpegImage::_getline ( T* buffer, int line ) {
 
+    if ( ! data && ! decode() ) {
+        LOGGER_ERROR ( "Cannot read line " << line << " from JPEG image " << filename );
+        return 0;
+    }
+
     T buffertmp[width * channels];
 
     for (int x = 0;  x < width * channels; x++) {
@@ -237,5 +310,38 @@ int LibjpegImage::getline ( float* buffer, int line ) {
     return 0;
 }
 
+template<typename T>
+int LibjpegImage::_getSampledLine ( T* buffer, int line, int offset, int step, int number ) {
+
+    if ( converter ) {
+        // Les données doivent être converties : on passe par la ligne entière
+        return Image::_getSampledLine ( buffer, line, offset, step, number );
+    }
+
+    if ( ! data && ! decode() ) {
+        LOGGER_ERROR ( "Cannot read line " << line << " from JPEG image " << filename );
+        return 0;
+    }
+
+    unsigned char* pix = data[line] + offset * channels;
+    for (int i = 0; i < number; i++) {
+        for (int j = 0; j < channels; j++) {
+            buffer[i*channels + j] = pix[j];
+        }
+        pix += step * channels;
+    }
+
+    return number * channels;
+}
+
+int LibjpegImage::getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
 
+int LibjpegImage::getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
 
+int LibjpegImage::getSampledLine ( float* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
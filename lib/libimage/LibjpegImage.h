@@ -69,8 +69,10 @@
  * Cette classe va utiliser la librairie libjpeg afin de lire les données et de récupérer les informations sur les images. L'utilisation de la librairie permet de lire des JPEG ayant une palette, ayant un canal (gris) sur 1, 2 ou 4 bits. La conversion sera faite à la volée au moment de la lecture, afin de récupérer une ligne dans un format lisible par la libimage (entier sur 8 bits, gris ou rgb, avec ou sans alpha non associé).
  *
  * Si l'image gère la transparence, l'alpha est forcément non-associé aux autres canaux (spécifications JPEG). Il n'y a donc pas besoin de préciser #associatedalpha.
+ *
+ * Seul l'en-tête est lu à la création. L'image est décodée à la première lecture, en se limitant à la zone utile et en utilisant la réduction par DCT de libjpeg (1/2, 1/4 ou 1/8) selon la résolution nécessaire, tels que définis par #restrictReading.
  * 
- * \todo Lire au fur et à mesure l'image JPEG et ne pas la charger intégralement en mémoire lors de la création de l'objet LibjpegImage.
+ * \todo Lire au fur et à mesure l'image JPEG et ne pas la décoder intégralement en mémoire à la première lecture.
  */
 class LibjpegImage : public FileImage {
 
@@ -79,11 +81,20 @@ class LibjpegImage : public FileImage {
 private:
 
     /**
-     * \~french \brief Stockage de l'image entière, décompressée
-     * \~english \brief Full uncompressed image storage
+     * \~french \brief Stockage de l'image entière, décompressée, NULL tant que l'image n'a pas été lue
+     * \~english \brief Full uncompressed image storage, NULL while image is not read
      */
     unsigned char** data;
 
+    /** \~french
+     * \brief Décode la zone utile de l'image, au niveau de résolution voulu
+     * \return faux en cas d'erreur
+     ** \~english
+     * \brief Decode the image's useful area, at the wanted resolution level
+     * \return false if error
+     */
+    bool decode ();
+
     /** \~french
      * \brief Retourne une ligne, flottante ou entière
      * \param[out] buffer Tableau contenant au moins width*channels valeurs
@@ -93,6 +104,19 @@ private:
     template<typename T>
     int _getline ( T* buffer, int line );    
 
+    /** \~french
+     * \brief Retourne une ligne sous-échantillonnée, flottante ou entière
+     * \details Sans conversion, les pixels sont pris directement dans l'image décodée.
+     * \param[out] buffer Tableau contenant au moins number*channels valeurs
+     * \param[in] line Indice de la ligne à retourner (0 <= line < height)
+     * \param[in] offset Colonne du premier pixel retourné
+     * \param[in] step Pas entre deux colonnes retournées
+     * \param[in] number Nombre de pixels retournés
+     * \return taille utile du buffer, 0 si erreur
+     */
+    template<typename T>
+    int _getSampledLine ( T* buffer, int line, int offset, int step, int number );
+
 protected:
     /** \~french
      * \brief Crée un objet LibjpegImage à partir de tous ses éléments constitutifs
@@ -108,7 +132,6 @@ protected:
      * \param[in] bitspersample nombre de bits par canal
      * \param[in] photometric photométrie des données
      * \param[in] compression compression des données
-     * \param[in] pngData image complète, dans un tableau
      ** \~english
      * \brief Create a LibjpegImage object, from all attributes
      * \param[in] width image width, in pixel
@@ -122,12 +145,10 @@ protected:
      * \param[in] bitspersample number of bits per sample
      * \param[in] photometric data photometric
      * \param[in] compression data compression
-     * \param[in] pngData whole image, in an array
      */
     LibjpegImage (
         int width, int height, double resx, double resy, int channels, BoundingBox< double > bbox, char* name,
-        SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression,
-        unsigned char** data
+        SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression
     );
 
 public:
@@ -146,6 +167,12 @@ public:
     int getline ( uint16_t* buffer, int line );
     int getline ( float* buffer, int line );
 
+    int getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( float* buffer, int line, int offset, int step, int number );
+
+    bool restrictReading ( BoundingBox<double> area, double wantedResx, double wantedResy );
+
     /**
      * \~french
      * \brief Ecrit une image JPEG, à partir d'une image source
@@ -237,16 +264,18 @@ public:
     /**
      * \~french
      * \brief Destructeur par défaut
-     * \details Suppression du buffer de lecture #row_pointers
+     * \details Suppression du buffer de lecture #data
      * \~english
      * \brief Default destructor
-     * \details We remove read buffer #row_pointers
+     * \details We remove read buffer #data
      */
     ~LibjpegImage() {
         /* cleanup heap allocation */
-        for (int y = 0; y < height; y++)
-            delete[] data[y];
-        delete[] data;
+        if ( data ) {
+            for (int y = 0; y < height; y++)
+                delete[] data[y];
+            delete[] data;
+        }
     }
 
     /** \~french
@@ -81,7 +81,7 @@ static kdu_message_formatter pretty_cerr(&cerr_message);
 /* ----- Pour la lecture ----- */
 LibkakaduImage* LibkakaduImageFactory::createLibkakaduImageToRead ( char* filename, BoundingBox< double > bbox, double resx, double resy ) {
     
-    int width = 0, height = 0, bitspersample = 0, channels = 0, rowsperstrip = 0;
+    int width = 0, height = 0, bitspersample = 0, channels = 0, resolutions = 1;
     SampleFormat::eSampleFormat sf = SampleFormat::UINT;
     Photometric::ePhotometric ph = Photometric::UNKNOWN;
 
@@ -119,6 +119,8 @@ LibkakaduImage* LibkakaduImageFactory::createLibkakaduImageToRead ( char* filena
     codestream.get_dims(0,dims,true);
     width = dims.size.get_x();
     height = dims.size.get_y();
+    // Nombre de niveaux de résolution disponibles, pour pouvoir décoder une version réduite
+    resolutions = codestream.get_min_dwt_levels() + 1;
     
     for (int i = 0; i < channels; i++) {
         codestream.get_dims(i,dims,true);
@@ -165,16 +167,6 @@ LibkakaduImage* LibkakaduImageFactory::createLibkakaduImageToRead ( char* filena
             return NULL;
     }
     
-    /******************* RPS INTELLIGENT ***********************/
-    
-    if (width <= 10000) {
-        rowsperstrip = 256;
-    } else if (width <= 20000) {
-        rowsperstrip = 192;
-    } else {
-        rowsperstrip = 128;
-    }
-    
     /********************** CONTROLES **************************/
 
     if ( ! LibkakaduImage::canRead ( bitspersample, sf ) ) {
@@ -208,7 +200,7 @@ LibkakaduImage* LibkakaduImageFactory::createLibkakaduImageToRead ( char* filena
     LibkakaduImage* o_LibkakaduImage = new LibkakaduImage (
         width, height, resx, resy, channels, bbox, filename,
         sf, bitspersample, ph, Compression::JPEG2000,
-        rowsperstrip
+        resolutions
     );
     if(!o_LibkakaduImage->init()){
         LOGGER_ERROR("Failed to itialise kakadu image object.");
@@ -225,13 +217,49 @@ LibkakaduImage* LibkakaduImageFactory::createLibkakaduImageToRead ( char* filena
 LibkakaduImage::LibkakaduImage (
     int width, int height, double resx, double resy, int channels, BoundingBox<double> bbox, char* name,
     SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression,
-    int rps ) :
+    int resolutions ) :
 
     Jpeg2000Image ( width, height, resx, resy, channels, bbox, name, sampleformat, bitspersample, photometric, compression ),
-    rowsperstrip(rps)
+    strip_buffer(NULL)
     
 {    
+    resolutionsCount = resolutions;
+    computeRowsPerStrip();
+}
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ---------------------------------------- ZONE DE LECTURE --------------------------------------- */
+
+void LibkakaduImage::computeRowsPerStrip () {
+    /******************* RPS INTELLIGENT ***********************/
+    
+    if (width <= 10000) {
+        rowsperstrip = 256;
+    } else if (width <= 20000) {
+        rowsperstrip = 192;
+    } else {
+        rowsperstrip = 128;
+    }
+}
+
+bool LibkakaduImage::restrictReading ( BoundingBox<double> area, double wantedResx, double wantedResy ) {
+    if ( ! computeReadingWindow ( area, wantedResx, wantedResy ) ) {
+        return true;
+    }
+
+    // Les dimensions ont changé : on redimensionne le buffer de lecture
+    computeRowsPerStrip();
+    delete[] strip_buffer;
+    try {
+        strip_buffer = new uint8_t[rowsperstrip * width * pixelSize];
+    } catch (std::bad_alloc e) {
+        LOGGER_ERROR("Memory allocation error while creating strip buffer.");
+        strip_buffer = NULL;
+        return false;
+    }
+    current_strip = -1;
 
+    return true;
 }
 
 
@@ -311,23 +339,27 @@ bool LibkakaduImage::init() {
 template<typename T>
 void LibkakaduImage::_loadstrip() {
 
-    int C0 = 0;
+    int factor = 1 << reduction;
     int L0 = rowsperstrip * current_strip;
     int nBandSpace = pixelSize / channels; // taille en octet d'un canal
     int NLines = __min(rowsperstrip, height - rowsperstrip * current_strip);
     
     int max_layers = 0;
-    int discard_levels = 0;
+    int discard_levels = reduction;
     
     kdu_dims dims, mdims;
     // Position de l'origine en coord fichier (cad pleine resolution)
-    dims.pos=kdu_coords(C0, L0);
+    dims.pos=kdu_coords(windowX, windowY + L0 * factor);
     // Taille de la zone en coord fichier (cad pleine resolution)
-    dims.size=kdu_coords(width,NLines);
+    dims.size=kdu_coords(windowWidth, __min(NLines * factor, windowY + windowHeight - dims.pos.y));
     
-    m_codestream.map_region(0,dims,mdims);
+    // La zone est restreinte en pleine résolution, puis convertie dans les coordonnées du niveau de résolution lu
+    m_codestream.apply_input_restrictions(0,channels,discard_levels,max_layers,&dims,KDU_WANT_OUTPUT_COMPONENTS);
     
-    m_codestream.apply_input_restrictions(0,channels,discard_levels,max_layers,&mdims,KDU_WANT_OUTPUT_COMPONENTS);
+    m_codestream.map_region(0,dims,mdims);
+    // Selon l'alignement de l'origine, la zone réduite peut déborder d'un pixel de notre tampon
+    mdims.size.x = __min(mdims.size.x, width);
+    mdims.size.y = __min(mdims.size.y, NLines);
     
     kdu_dims *comp_dims = new kdu_dims[channels];
     for (int n = 0; n < channels; n++) {
@@ -377,7 +409,11 @@ void LibkakaduImage::_loadstrip() {
 
 template<typename T>
 int LibkakaduImage::_getline ( T* buffer, int line ) {
-    
+
+    if ( line < 0 || line >= height ) {
+        LOGGER_ERROR ( "Line " << line << " is out of the JPEG2000 image " << filename << " (height " << height << ")" );
+        return 0;
+    }
 
     if ( line / rowsperstrip != current_strip ) {
         current_strip = line / rowsperstrip;
@@ -388,7 +424,7 @@ int LibkakaduImage::_getline ( T* buffer, int line ) {
         } else if (sizeof(T) == 2) {
             // Mettre les données sur des uint16_t -> lire le jpeg2000 en kdu_uint16            
             _loadstrip<kdu_uint16>();
-        } else if (sizeof(T) == 1) {
+        } else if (sizeof(T) == 4) {
             // Mettre les données sur des float -> lire le jpeg2000 en float            
             _loadstrip<float>();
         }
@@ -416,14 +452,14 @@ int LibkakaduImage::getline ( uint8_t* buffer, int line ) {
         /* On ne convertit pas les entiers 16 bits en entier sur 8 bits (aucun intérêt)
          * On va copier le buffer entier 16 bits sur le buffer entier, de même taille en octet (2 fois plus grand en "nombre de cases")*/
         uint16_t int16line[width * getChannels()];
-        _getline ( int16line, line );
+        if ( ! _getline ( int16line, line ) ) return 0;
         memcpy ( buffer, int16line, width * getPixelSize() );
         return width * getPixelSize();
     } else if ( bitspersample == 32 && sampleformat == SampleFormat::FLOAT ) { // float
         /* On ne convertit pas les nombres flottants en entier sur 8 bits (aucun intérêt)
          * On va copier le buffer flottant sur le buffer entier, de même taille en octet (4 fois plus grand en "nombre de cases")*/
         float floatline[width * getChannels()];
-        _getline ( floatline, line );
+        if ( ! _getline ( floatline, line ) ) return 0;
         memcpy ( buffer, floatline, width * getPixelSize() );
         return width * getPixelSize();
     }
@@ -436,7 +472,10 @@ int LibkakaduImage::getline ( uint16_t* buffer, int line ) {
     if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
         // On veut la ligne en entier 16 bits mais l'image lue est sur 8 bits : on convertit
         uint8_t* buffer_t = new uint8_t[width * getChannels()];
-        _getline ( buffer_t,line );
+        if ( ! _getline ( buffer_t,line ) ) {
+            delete [] buffer_t;
+            return 0;
+        }
         convert ( buffer, buffer_t, width * getChannels() );
         delete [] buffer_t;
         return width * getChannels();
@@ -446,7 +485,7 @@ int LibkakaduImage::getline ( uint16_t* buffer, int line ) {
         /* On ne convertit pas les nombres flottants en entier sur 16 bits (aucun intérêt)
         * On va copier le buffer flottant sur le buffer entier 16 bits, de même taille en octet (2 fois plus grand en "nombre de cases")*/
         float floatline[width * channels];
-        _getline ( floatline, line );
+        if ( ! _getline ( floatline, line ) ) return 0;
         memcpy ( buffer, floatline, width*pixelSize );
         return width*pixelSize;
     }
@@ -457,14 +496,20 @@ int LibkakaduImage::getline ( float* buffer, int line ) {
     if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
         // On veut la ligne en flottant pour un réechantillonnage par exemple mais l'image lue est sur des entiers
         uint8_t* buffer_t = new uint8_t[width * getChannels()];
-        _getline ( buffer_t,line );
+        if ( ! _getline ( buffer_t,line ) ) {
+            delete [] buffer_t;
+            return 0;
+        }
         convert ( buffer, buffer_t, width * getChannels() );
         delete [] buffer_t;
         return width * getChannels();
     } else if ( bitspersample == 16 && sampleformat == SampleFormat::UINT ) { // uint16
         // On veut la ligne en flottant pour un réechantillonnage par exemple mais l'image lue est sur des entiers
         uint16_t* buffer_t = new uint16_t[width * getChannels()];
-        _getline ( buffer_t,line );
+        if ( ! _getline ( buffer_t,line ) ) {
+            delete [] buffer_t;
+            return 0;
+        }
         convert ( buffer, buffer_t, width * getChannels() );
         delete [] buffer_t;
         return width * getChannels();   
@@ -474,3 +519,38 @@ int LibkakaduImage::getline ( float* buffer, int line ) {
     return 0;
 }
 
+template<typename T>
+int LibkakaduImage::_getSampledLine ( T* buffer, int line, int offset, int step, int number ) {
+
+    if ( converter || 8 * ( int ) sizeof ( T ) != bitspersample ) {
+        // Les données doivent être converties : on passe par la ligne entière
+        return Image::_getSampledLine ( buffer, line, offset, step, number );
+    }
+
+    if ( line < 0 || line >= height ) {
+        LOGGER_ERROR ( "Line " << line << " is out of the JPEG2000 image " << filename << " (height " << height << ")" );
+        return 0;
+    }
+
+    if ( line / rowsperstrip != current_strip ) {
+        current_strip = line / rowsperstrip;
+        _loadstrip<T>();
+    }
+
+    samplePixels ( buffer, ( T* ) ( strip_buffer + ( line%rowsperstrip ) * width * pixelSize + offset * pixelSize ), channels, step, number );
+
+    return number * channels;
+}
+
+int LibkakaduImage::getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int LibkakaduImage::getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int LibkakaduImage::getSampledLine ( float* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
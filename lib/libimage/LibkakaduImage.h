@@ -67,7 +67,7 @@
  * \brief Manipulation d'une image JPEG2000, avec la librarie kakadu
  * \details Une image JPEG2000 est une vraie image dans ce sens où elle est rattachée à un fichier, pour la lecture de données au format JPEG2000. La librairie utilisée est kakadu (propriétaire, doit donc être préalablement installée et localisée).
  * 
- * \todo Lire au fur et à mesure l'image JPEG2000 et ne pas la charger intégralement en mémoire lors de la création de l'objet LibkakaduImage.
+ * Les données sont décodées par bandes de #rowsperstrip lignes, en restreignant le décodage à la zone utile et au niveau de résolution nécessaire, tels que définis par #restrictReading.
  */
 class LibkakaduImage : public Jpeg2000Image {
     
@@ -141,6 +141,23 @@ private:
      */
     template<typename T>
     void _loadstrip ( );
+
+    /** \~french
+     * \brief Retourne une ligne sous-échantillonnée, flottante ou entière
+     * \details Sans conversion, les pixels sont pris directement dans la bande en mémoire.
+     ** \~english
+     * \brief Returns a sampled line. Values can be floating point numbers or integers
+     * \details Without conversion, pixels are directly taken from the strip in memory.
+     */
+    template<typename T>
+    int _getSampledLine ( T* buffer, int line, int offset, int step, int number );
+
+    /** \~french
+     * \brief Calcule la hauteur des bandes en fonction de la largeur à décoder
+     ** \~english
+     * \brief Compute strips' height from the width to decode
+     */
+    void computeRowsPerStrip ();
     
     
 
@@ -160,9 +177,7 @@ protected:
      * \param[in] bitspersample nombre de bits par canal
      * \param[in] photometric photométrie des données
      * \param[in] compression compression des données
-     * \param[in] kduData image complète, dans un tableau
-     * \param[in] decompressor décompresseur de bandes de kakadu, pour charger l'image par bandes
-     * \param[in] rowsperstrip taille de la bufferisation des données, en nombre de lignes
+     * \param[in] resolutions nombre de niveaux de résolution dans le fichier
      ** \~english
      * \brief Create a LibkakaduImage object, from all attributes
      * \param[in] width image width, in pixel
@@ -176,12 +191,10 @@ protected:
      * \param[in] bitspersample number of bits per sample
      * \param[in] photometric data photometric
      * \param[in] compression data compression
-     * \param[in] kduData whole image, in an array
-     * \param[in] decompressor kakadu stripe decompressor, to load image stripe by stripe
-     * \param[in] rowsperstrip data buffering size, in line number
+     * \param[in] resolutions number of resolution levels in the file
      */
     LibkakaduImage (
-        int width, int height, double resx, double resy, int channels, BoundingBox< double > bbox, char* name, SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression, int rps
+        int width, int height, double resx, double resy, int channels, BoundingBox< double > bbox, char* name, SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression, int resolutions
     );
     
     /** \~french
@@ -209,6 +222,12 @@ public:
     int getline ( uint8_t* buffer, int line );
     int getline ( uint16_t* buffer, int line );
     int getline ( float* buffer, int line );
+
+    int getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( float* buffer, int line, int offset, int step, int number );
+
+    bool restrictReading ( BoundingBox<double> area, double wantedResx, double wantedResy );
     
     /**
      * \~french
@@ -234,7 +253,7 @@ public:
     void print() {
         LOGGER_INFO ( "" );
         LOGGER_INFO ( "---------- LibkakaduImage ------------" );
-        FileImage::print();
+        Jpeg2000Image::print();
         LOGGER_INFO ( "" );
     }
 
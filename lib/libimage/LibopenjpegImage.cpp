@@ -54,6 +54,7 @@
 #include <ctype.h>
 
 #include "LibopenjpegImage.h"
+#include "Jpeg2000_library_config.h"
 #include "Logger.h"
 #include "Utils.h"
 
@@ -103,21 +104,97 @@ static void info_callback ( const char *msg, void *client_data ) {
     LOGGER_DEBUG ( msg );
 }
 
+/* ------------------------------------------------------------------------------------------------ */
+/* --------------------------------------- FLUX OPENJPEG ------------------------------------------ */
+
+#if defined(OPJ_VERSION_MAJOR) && ( OPJ_VERSION_MAJOR > 2 || ( OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 2 ) )
+#define OPJ_HAS_THREADS
+// Depuis la version 2.2, opj_set_decode_area et opj_decode peuvent être appelés plusieurs fois avec le même décodeur
+#define OPJ_HAS_REPEATED_DECODE
+#endif
+
+/**
+ * \~french \brief Ouvre le fichier JPEG2000 et en lit l'en-tête
+ * \details Le décodeur est configuré avec la réduction de résolution voulue et, si la version d'openjpeg le permet, en multi-thread. En cas de succès, l'appelant est responsable de la destruction des trois objets retournés.
+ * \param[in] filename chemin du fichier image
+ * \param[in] format format du flux JPEG2000
+ * \param[in] reduce nombre de niveaux de résolution à écarter
+ * \param[out] codec décodeur
+ * \param[out] stream flux de lecture
+ * \param[out] image image dont l'en-tête a été lu
+ * \return faux en cas d'erreur
+ * \~english \brief Open the JPEG2000 file and read its header
+ * \details Decoder is configured with the wanted resolution reduction and, if openjpeg's version allows it, multi-threaded. If success, caller have to destroy the three returned objects.
+ * \param[in] filename path to image file
+ * \param[in] format JPEG2000 stream format
+ * \param[in] reduce number of resolution levels to discard
+ * \param[out] codec decoder
+ * \param[out] stream reading stream
+ * \param[out] image image whose header is read
+ * \return false if error
+ */
+static bool openCodestream ( char* filename, OPJ_CODEC_FORMAT format, int reduce, opj_codec_t** codec, opj_stream_t** stream, opj_image_t** image ) {
+
+    opj_dparameters_t parameters;
+    opj_set_default_decoder_parameters ( &parameters );
+    strncpy ( parameters.infile, filename, IMAGE_MAX_FILENAME_LENGTH * sizeof ( char ) );
+    parameters.cp_reduce = reduce;
+
+    *codec = opj_create_decompress ( format );
+    *stream = NULL;
+    *image = NULL;
+
+    /* catch events using our callbacks and give a local context */
+    opj_set_info_handler ( *codec, info_callback,00 );
+    opj_set_warning_handler ( *codec, warning_callback,00 );
+    opj_set_error_handler ( *codec, error_callback,00 );
+
+    /* Setup the decoder decoding parameters using user parameters */
+    if ( !opj_setup_decoder ( *codec, &parameters ) ) {
+        LOGGER_ERROR ( "Unable to setup the decoder for the JPEG2000 file " << filename );
+        opj_destroy_codec ( *codec );
+        return false;
+    }
+
+#ifdef OPJ_HAS_THREADS
+    if ( opj_has_thread_support() ) {
+        int threads = atoi ( OPJ_THREADING );
+        if ( threads <= 0 ) threads = opj_get_num_cpus();
+        if ( threads > 1 && ! opj_codec_set_threads ( *codec, threads ) ) {
+            LOGGER_WARN ( "Unable to use " << threads << " threads to decode the JPEG2000 file " << filename );
+        }
+    }
+#endif
+
+    *stream = opj_stream_create_default_file_stream ( filename,1 );
+    if ( ! *stream ) {
+        LOGGER_ERROR ( "Unable to create the stream (to read) for the JPEG2000 file " << filename );
+        opj_destroy_codec ( *codec );
+        return false;
+    }
+
+    /* Read the main header of the codestream and if necessary the JP2 boxes*/
+    if ( ! opj_read_header ( *stream, *codec, image ) ) {
+        LOGGER_ERROR ( "Unable to read the header for the JPEG2000 file " << filename );
+        opj_stream_destroy ( *stream );
+        opj_destroy_codec ( *codec );
+        opj_image_destroy ( *image );
+        return false;
+    }
+
+    return true;
+}
+
 /* ------------------------------------------------------------------------------------------------ */
 /* -------------------------------------------- USINES -------------------------------------------- */
 
 /* ----- Pour la lecture ----- */
 LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char* filename, BoundingBox< double > bbox, double resx, double resy ) {
 
-    // Set decoding parameters to default values
-    opj_dparameters_t parameters;                   /* decompression parameters */
     opj_image_t* image = NULL;
     opj_stream_t *l_stream = NULL;                          /* Stream */
     opj_codec_t* l_codec = NULL;                            /* Handle to a decompressor */
-    opj_codestream_index_t* cstr_index = NULL;
-
-    opj_set_default_decoder_parameters ( &parameters );
-    strncpy ( parameters.infile, filename, IMAGE_MAX_FILENAME_LENGTH * sizeof ( char ) );
+    OPJ_CODEC_FORMAT format;
 
     /************** INITIALISATION DES OBJETS OPENJPEG *********/
 
@@ -144,10 +221,10 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
 
     // Format MAGIC Code
     if ( memcmp ( magic_code, JP2_RFC3745_MAGIC, 12 ) == 0 || memcmp ( magic_code, JP2_MAGIC, 4 ) == 0 ) {
-        l_codec = opj_create_decompress ( OPJ_CODEC_JP2 );
+        format = OPJ_CODEC_JP2;
         LOGGER_DEBUG ( "Ok, use format JP2 !" );
     } else if ( memcmp ( magic_code, J2K_CODESTREAM_MAGIC, 4 ) == 0 ) {
-        l_codec = opj_create_decompress ( OPJ_CODEC_J2K );
+        format = OPJ_CODEC_J2K;
         LOGGER_DEBUG ( "Ok, use format J2K !" );
     } else {
         LOGGER_ERROR ( "Unhandled format for the JPEG2000 file " << filename );
@@ -158,31 +235,8 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
     // Nettoyage
     free ( magic_code );
 
-    /* catch events using our callbacks and give a local context */
-    opj_set_info_handler ( l_codec, info_callback,00 );
-    opj_set_warning_handler ( l_codec, warning_callback,00 );
-    opj_set_error_handler ( l_codec, error_callback,00 );
-
-    /* Setup the decoder decoding parameters using user parameters */
-    if ( !opj_setup_decoder ( l_codec, &parameters ) ) {
-        LOGGER_ERROR ( "Unable to setup the decoder for the JPEG2000 file " << filename );
-        opj_destroy_codec ( l_codec );
-        return NULL;
-    }
-
-    l_stream = opj_stream_create_default_file_stream ( filename,1 );
-    if ( !l_stream ) {
-        std::fclose ( file );
-        LOGGER_ERROR ( "Unable to create the stream (to read) for the JPEG2000 file " << filename );
-        return NULL;
-    }
-
-    /* Read the main header of the codestream and if necessary the JP2 boxes*/
-    if ( ! opj_read_header ( l_stream, l_codec, &image ) ) {
-        LOGGER_ERROR ( "Unable to read the header for the JPEG2000 file " << filename );
-        opj_stream_destroy ( l_stream );
-        opj_destroy_codec ( l_codec );
-        opj_image_destroy ( image );
+    // Seul l'en-tête est lu ici, le décodage se fera par bande lors de la lecture des lignes
+    if ( ! openCodestream ( filename, format, 0, &l_codec, &l_stream, &image ) ) {
         return NULL;
     }
     
@@ -195,19 +249,37 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
     int channels = image->numcomps;
     SampleFormat::eSampleFormat sf = SampleFormat::UINT;
     Photometric::ePhotometric ph = toROK4Photometric ( image->color_space , channels);
-    if ( ph == Photometric::UNKNOWN ) {
-        LOGGER_ERROR ( "Unhandled color space (" << image->color_space << ") in the JPEG2000 image " << filename );
-        return NULL;
-    }
 
     // On vérifie que toutes les composantes ont bien les mêmes carctéristiques
+    bool sameComponents = true;
     for ( int i = 1; i < channels; i++ ) {
         if ( bitspersample != image->comps[i].prec || width != image->comps[i].w || height != image->comps[i].h ) {
-            LOGGER_ERROR ( "All components have to be the same in the JPEG image " << filename );
-            return NULL;
+            sameComponents = false;
         }
     }
 
+    // Nombre de niveaux de résolution disponibles, pour pouvoir décoder une version réduite
+    int resolutions = 1;
+    opj_codestream_info_v2_t* cstr_info = opj_get_cstr_info ( l_codec );
+    if ( cstr_info ) {
+        resolutions = cstr_info->m_default_tile_info.tccp_info[0].numresolutions;
+        opj_destroy_cstr_info ( &cstr_info );
+    }
+
+    opj_destroy_codec ( l_codec );
+    opj_stream_destroy ( l_stream );
+    opj_image_destroy ( image );
+
+    if ( ph == Photometric::UNKNOWN ) {
+        LOGGER_ERROR ( "Unhandled color space in the JPEG2000 image " << filename );
+        return NULL;
+    }
+
+    if ( ! sameComponents ) {
+        LOGGER_ERROR ( "All components have to be the same in the JPEG image " << filename );
+        return NULL;
+    }
+
     /********************** CONTROLES **************************/
 
     if ( ! LibopenjpegImage::canRead ( bitspersample, sf ) ) {
@@ -226,27 +298,13 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
         resx = 1.;
         resy = 1.;
     }
-    
-    /************** LECTURE DE L'IMAGE EN ENTIER ***************/
-
-    /* Get the decoded image */
-    if ( ! ( opj_decode ( l_codec, l_stream, image ) && opj_end_decompress ( l_codec, l_stream ) ) ) {
-        LOGGER_ERROR ( "Unable to decode JPEG2000 file " << filename );
-        opj_destroy_codec ( l_codec );
-        opj_stream_destroy ( l_stream );
-        opj_image_destroy ( image );
-        return NULL;
-    }
-
-    opj_destroy_codec ( l_codec );
-    opj_stream_destroy ( l_stream );
 
     /******************** CRÉATION DE L'OBJET ******************/
 
     return new LibopenjpegImage (
         width, height, resx, resy, channels, bbox, filename,
         sf, bitspersample, ph, Compression::JPEG2000,
-        image
+        format, resolutions
     );
 
 }
@@ -257,26 +315,164 @@ LibopenjpegImage* LibopenjpegImageFactory::createLibopenjpegImageToRead ( char*
 LibopenjpegImage::LibopenjpegImage (
     int width,int height, double resx, double resy, int channels, BoundingBox<double> bbox, char* name,
     SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression,
-    opj_image_t *jp2ptr ) :
+    OPJ_CODEC_FORMAT format, int resolutions ) :
 
     Jpeg2000Image ( width, height, resx, resy, channels, bbox, name, sampleformat, bitspersample, photometric, compression ),
 
-    jp2image ( jp2ptr ) {
+    codecFormat ( format ), codec ( NULL ), stream ( NULL ), strip_image ( NULL ), current_strip ( -1 ), decodedAreas ( 0 ) {
 
+#ifdef OPJ_HAS_REPEATED_DECODE
+    reusableCodec = true;
+#else
+    reusableCodec = false;
+#endif
+
+    resolutionsCount = resolutions;
+    computeRowsPerStrip();
+}
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ---------------------------------------- ZONE DE LECTURE --------------------------------------- */
+
+void LibopenjpegImage::computeRowsPerStrip () {
+    // Les données décodées sont stockées sur 32 bits par canal : on limite la hauteur des bandes pour les images larges
+    if ( width <= 10000 ) {
+        rowsperstrip = 256;
+    } else if ( width <= 20000 ) {
+        rowsperstrip = 192;
+    } else {
+        rowsperstrip = 128;
+    }
+}
+
+bool LibopenjpegImage::restrictReading ( BoundingBox<double> area, double wantedResx, double wantedResy ) {
+    if ( computeReadingWindow ( area, wantedResx, wantedResy ) ) {
+        computeRowsPerStrip();
+        // Le niveau de résolution est fixé à l'ouverture du décodeur
+        closeCodestream();
+    }
+    return true;
 }
 
 /* ------------------------------------------------------------------------------------------------ */
 /* ------------------------------------------- LECTURE -------------------------------------------- */
 
+bool LibopenjpegImage::openCodestream () {
+    closeCodestream();
+    if ( ! ::openCodestream ( filename, codecFormat, reduction, &codec, &stream, &strip_image ) ) {
+        codec = NULL;
+        stream = NULL;
+        strip_image = NULL;
+        return false;
+    }
+    return true;
+}
+
+void LibopenjpegImage::closeCodestream () {
+    if ( codec ) opj_destroy_codec ( codec );
+    if ( stream ) opj_stream_destroy ( stream );
+    if ( strip_image ) opj_image_destroy ( strip_image );
+    codec = NULL;
+    stream = NULL;
+    strip_image = NULL;
+    current_strip = -1;
+    decodedAreas = 0;
+}
+
+bool LibopenjpegImage::decodeArea ( int y0, int y1 ) {
+    // La zone est exprimée dans la grille de référence, dont l'origine est celle de l'image
+    if ( ! opj_set_decode_area ( codec, strip_image,
+                                 strip_image->x0 + windowX, strip_image->y0 + y0,
+                                 strip_image->x0 + windowX + windowWidth, strip_image->y0 + y1 ) ) {
+        return false;
+    }
+
+    return opj_decode ( codec, stream, strip_image );
+}
+
+bool LibopenjpegImage::decodeStrip ( int strip ) {
+
+    current_strip = -1;
+
+    int factor = 1 << reduction;
+    int firstLine = strip * rowsperstrip;
+    int nbLines = __min ( rowsperstrip, height - firstLine );
+
+    // Zone à décoder, en pixels pleine résolution
+    int y0 = windowY + firstLine * factor;
+    int y1 = __min ( windowY + windowHeight, y0 + nbLines * factor );
+
+    // Le décodeur et le flux restent ouverts d'une bande à l'autre : l'en-tête n'est lu qu'une fois
+    if ( ! codec || ( decodedAreas > 0 && ! reusableCodec ) ) {
+        if ( ! openCodestream() ) return false;
+    }
+
+    bool ok = decodeArea ( y0, y1 );
+
+    if ( ! ok && decodedAreas > 0 ) {
+        // Cette version d'openjpeg ne sait pas redécoder une zone de ce flux : on rouvre le flux pour chaque bande
+        LOGGER_DEBUG ( "Cannot decode several areas with the same decoder for the JPEG2000 file " << filename << ", the codestream will be opened for each strip" );
+        reusableCodec = false;
+        ok = ( openCodestream() && decodeArea ( y0, y1 ) );
+    }
+
+    if ( ! ok ) {
+        LOGGER_ERROR ( "Unable to decode JPEG2000 file " << filename << " (lines " << y0 << " to " << y1 << ")" );
+        closeCodestream();
+        return false;
+    }
+
+    decodedAreas++;
+    current_strip = strip;
+
+    return true;
+}
+
+bool LibopenjpegImage::loadLine ( int line, int& stripLine ) {
+
+    if ( line < 0 || line >= height ) {
+        LOGGER_ERROR ( "Line " << line << " is out of the JPEG2000 image " << filename << " (height " << height << ")" );
+        return false;
+    }
+
+    if ( line / rowsperstrip != current_strip ) {
+        // La bande contenant la ligne n'est pas en mémoire
+        if ( ! decodeStrip ( line / rowsperstrip ) ) {
+            LOGGER_ERROR ( "Cannot read line " << line << " from JPEG2000 image " << filename );
+            return false;
+        }
+    }
+
+    // Selon l'alignement de l'origine de l'image sur la grille réduite, la bande décodée peut avoir une ligne de moins que prévu :
+    // on reprend alors la dernière. Au-delà, la bande ne correspond pas à la zone demandée.
+    stripLine = line - current_strip * rowsperstrip;
+    int decodedHeight = strip_image->comps[0].h;
+    if ( stripLine >= decodedHeight ) {
+        if ( stripLine > decodedHeight || decodedHeight == 0 ) {
+            LOGGER_ERROR ( "Line " << line << " is not in the decoded strip (" << decodedHeight << " lines) of the JPEG2000 image " << filename );
+            return false;
+        }
+        stripLine = decodedHeight - 1;
+    }
+
+    return true;
+}
+
 template<typename T>
 int LibopenjpegImage::_getline ( T* buffer, int line ) {
 
+    int stripLine;
+    if ( ! loadLine ( line, stripLine ) ) return 0;
+
     T buffertmp[width * channels];
 
+    // La largeur décodée peut différer d'un pixel de la nôtre selon l'alignement de l'origine de l'image
+    int decodedWidth = strip_image->comps[0].w;
+
     for (int i = 0; i < width; i++) {
-        int index = width * line + i;
+        int index = decodedWidth * stripLine + __min ( i, decodedWidth - 1 );
         for (int j = 0; j < channels; j++) {
-            buffertmp[i*channels + j] = jp2image->comps[j].data[index];
+            buffertmp[i*channels + j] = strip_image->comps[j].data[index];
         }
     }
 
@@ -299,14 +495,14 @@ int LibopenjpegImage::getline ( uint8_t* buffer, int line ) {
         /* On ne convertit pas les entiers 16 bits en entier sur 8 bits (aucun intérêt)
          * On va copier le buffer entier 16 bits sur le buffer entier, de même taille en octet (2 fois plus grand en "nombre de cases")*/
         uint16_t int16line[width * getChannels()];
-        _getline ( int16line, line );
+        if ( ! _getline ( int16line, line ) ) return 0;
         memcpy ( buffer, int16line, width * getPixelSize() );
         return width * getPixelSize();
     } else if ( bitspersample == 32 && sampleformat == SampleFormat::FLOAT ) { // float
         /* On ne convertit pas les nombres flottants en entier sur 8 bits (aucun intérêt)
          * On va copier le buffer flottant sur le buffer entier, de même taille en octet (4 fois plus grand en "nombre de cases")*/
         float floatline[width * getChannels()];
-        _getline ( floatline, line );
+        if ( ! _getline ( floatline, line ) ) return 0;
         memcpy ( buffer, floatline, width * getPixelSize() );
         return width * getPixelSize();
     }
@@ -317,7 +513,10 @@ int LibopenjpegImage::getline ( uint16_t* buffer, int line ) {
     if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
         // On veut la ligne en entier 16 bits mais l'image lue est sur 8 bits : on convertit
         uint8_t* buffer_t = new uint8_t[width * getChannels()];
-        _getline ( buffer_t,line );
+        if ( ! _getline ( buffer_t,line ) ) {
+            delete [] buffer_t;
+            return 0;
+        }
         convert ( buffer, buffer_t, width * getChannels() );
         delete [] buffer_t;
         return width * getChannels();
@@ -327,7 +526,7 @@ int LibopenjpegImage::getline ( uint16_t* buffer, int line ) {
         /* On ne convertit pas les nombres flottants en entier sur 16 bits (aucun intérêt)
         * On va copier le buffer flottant sur le buffer entier 16 bits, de même taille en octet (2 fois plus grand en "nombre de cases")*/
         float floatline[width * channels];
-        _getline ( floatline, line );
+        if ( ! _getline ( floatline, line ) ) return 0;
         memcpy ( buffer, floatline, width*pixelSize );
         return width*pixelSize;
     }
@@ -337,14 +536,20 @@ int LibopenjpegImage::getline ( float* buffer, int line ) {
     if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
         // On veut la ligne en flottant pour un réechantillonnage par exemple mais l'image lue est sur des entiers
         uint8_t* buffer_t = new uint8_t[width * getChannels()];
-        _getline ( buffer_t,line );
+        if ( ! _getline ( buffer_t,line ) ) {
+            delete [] buffer_t;
+            return 0;
+        }
         convert ( buffer, buffer_t, width * getChannels() );
         delete [] buffer_t;
         return width * getChannels();
     } else if ( bitspersample == 16 && sampleformat == SampleFormat::UINT ) { // uint16
         // On veut la ligne en flottant pour un réechantillonnage par exemple mais l'image lue est sur des entiers
         uint16_t* buffer_t = new uint16_t[width * getChannels()];
-        _getline ( buffer_t,line );
+        if ( ! _getline ( buffer_t,line ) ) {
+            delete [] buffer_t;
+            return 0;
+        }
         convert ( buffer, buffer_t, width * getChannels() );
         delete [] buffer_t;
         return width * getChannels();   
@@ -353,6 +558,41 @@ int LibopenjpegImage::getline ( float* buffer, int line ) {
     }
 }
 
+template<typename T>
+int LibopenjpegImage::_getSampledLine ( T* buffer, int line, int offset, int step, int number ) {
+
+    if ( converter || 8 * ( int ) sizeof ( T ) < bitspersample ) {
+        // Les données doivent être converties : on passe par la ligne entière
+        return Image::_getSampledLine ( buffer, line, offset, step, number );
+    }
+
+    int stripLine;
+    if ( ! loadLine ( line, stripLine ) ) return 0;
+
+    int decodedWidth = strip_image->comps[0].w;
+
+    for (int i = 0; i < number; i++) {
+        int index = decodedWidth * stripLine + __min ( offset + i * step, decodedWidth - 1 );
+        for (int j = 0; j < channels; j++) {
+            buffer[i*channels + j] = strip_image->comps[j].data[index];
+        }
+    }
+
+    return number * channels;
+}
+
+int LibopenjpegImage::getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int LibopenjpegImage::getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int LibopenjpegImage::getSampledLine ( float* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
 
 
 
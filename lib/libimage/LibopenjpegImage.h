@@ -68,8 +68,10 @@
  * \~french
  * \brief Manipulation d'une image JPEG2000, avec la librarie openjpeg
  * \details Une image JPEG2000 est une vraie image dans ce sens où elle est rattachée à un fichier, pour la lecture de données au format JPEG2000. La librairie utilisée est openjpeg (open source et intégrée statiquement dans le projet ROK4).
- * 
- * \todo Lire au fur et à mesure l'image JPEG2000 et ne pas la charger intégralement en mémoire lors de la création de l'objet LibopenjpegImage.
+ *
+ * Seul l'en-tête est lu à la création. Les données sont décodées au fur et à mesure, par bandes de #rowsperstrip lignes, en ne demandant à openjpeg que la zone utile (opj_set_decode_area) et le niveau de résolution nécessaire (cp_reduce), tels que définis par #restrictReading. Une seule bande est gardée en mémoire.
+ *
+ * Le décodeur et le flux sont ouverts une seule fois et réutilisés pour toutes les bandes (openjpeg 2.2 et plus). Si la version d'openjpeg ne permet pas de décoder plusieurs zones avec le même décodeur, le flux est rouvert pour chaque bande.
  */
 class LibopenjpegImage : public Jpeg2000Image {
     
@@ -78,10 +80,116 @@ friend class LibopenjpegImageFactory;
 private:
 
     /**
-     * \~french \brief Stockage de l'image entière, décompressée
-     * \~english \brief Full uncompressed image storage
+     * \~french \brief Format du flux JPEG2000 (JP2 ou J2K)
+     * \~english \brief JPEG2000 stream format (JP2 or J2K)
+     */
+    OPJ_CODEC_FORMAT codecFormat;
+
+    /**
+     * \~french \brief Nombre de lignes (à la résolution lue) décodées à la fois
+     * \~english \brief Number of lines (at read resolution) decoded at once
+     */
+    int rowsperstrip;
+
+    /**
+     * \~french \brief Décodeur openjpeg, gardé ouvert d'une bande à l'autre
+     * \~english \brief Openjpeg decoder, kept open between strips
+     */
+    opj_codec_t* codec;
+
+    /**
+     * \~french \brief Flux de lecture du fichier, associé à #codec
+     * \~english \brief File reading stream, used by #codec
+     */
+    opj_stream_t* stream;
+
+    /**
+     * \~french \brief Bande décompressée en mémoire
+     * \~english \brief Uncompressed strip in memory
      */
-    opj_image_t* jp2image;
+    opj_image_t* strip_image;
+
+    /**
+     * \~french \brief Indice de la bande en mémoire dans #strip_image
+     * \~english \brief Memorized strip indice, in #strip_image
+     */
+    int current_strip;
+
+    /**
+     * \~french \brief Nombre de zones décodées depuis l'ouverture de #codec
+     * \~english \brief Number of areas decoded since #codec opening
+     */
+    int decodedAreas;
+
+    /**
+     * \~french \brief Le décodeur peut-il décoder plusieurs zones successives
+     * \~english \brief Can the decoder decode several successive areas
+     */
+    bool reusableCodec;
+
+    /** \~french
+     * \brief Ouvre le flux et le décodeur, au niveau de résolution #reduction, et lit l'en-tête
+     * \details Le décodeur précédent est fermé.
+     * \return faux en cas d'erreur
+     ** \~english
+     * \brief Open stream and decoder, at resolution level #reduction, and read header
+     * \details Previous decoder is closed.
+     * \return false if error
+     */
+    bool openCodestream ();
+
+    /** \~french
+     * \brief Ferme le flux et le décodeur, et libère la bande en mémoire
+     ** \~english
+     * \brief Close stream and decoder, and free strip in memory
+     */
+    void closeCodestream ();
+
+    /** \~french
+     * \brief Décode une zone de la fenêtre de lecture avec le décodeur ouvert
+     * \param[in] y0 première ligne de la zone, en pixels pleine résolution dans l'image
+     * \param[in] y1 ligne suivant la dernière ligne de la zone, en pixels pleine résolution dans l'image
+     * \return faux en cas d'erreur
+     ** \~english
+     * \brief Decode an area of the reading window with the opened decoder
+     * \param[in] y0 area's first line, full resolution pixels in the image
+     * \param[in] y1 line after area's last line, full resolution pixels in the image
+     * \return false if error
+     */
+    bool decodeArea ( int y0, int y1 );
+
+    /** \~french
+     * \brief Charge la bande contenant une ligne
+     * \param[in] line Indice de la ligne voulue
+     * \param[out] stripLine Indice de la ligne dans la bande décodée
+     * \return faux si la ligne est hors de l'image ou en cas d'erreur de décodage
+     ** \~english
+     * \brief Load the strip containing a line
+     * \param[in] line Wanted line indice
+     * \param[out] stripLine Line indice in the decoded strip
+     * \return false if line is out of image or if decoding error
+     */
+    bool loadLine ( int line, int& stripLine );
+
+    /** \~french
+     * \brief Calcule la hauteur des bandes en fonction de la largeur à décoder
+     ** \~english
+     * \brief Compute strips' height from the width to decode
+     */
+    void computeRowsPerStrip ();
+
+    /** \~french
+     * \brief Décode une bande de l'image
+     * \details Seule la zone correspondant à la bande est décodée, au niveau de résolution voulu. Le décodeur ouvert est réutilisé.
+     * \param[in] strip indice de la bande à décoder
+     * \return faux en cas d'erreur
+     ** \~english
+     * \brief Decode an image's strip
+     * \details Only the strip's area is decoded, at the wanted resolution level. Opened decoder is reused.
+     * \param[in] strip indice of the strip to decode
+     * \return false if error
+     */
+    bool decodeStrip ( int strip );
 
     /** \~french
      * \brief Retourne une ligne, flottante ou entière
@@ -92,6 +200,19 @@ private:
     template<typename T>
     int _getline ( T* buffer, int line );
 
+    /** \~french
+     * \brief Retourne une ligne sous-échantillonnée, flottante ou entière
+     * \details Sans conversion, les pixels sont pris directement dans la bande décodée.
+     * \param[out] buffer Tableau contenant au moins number*channels valeurs
+     * \param[in] line Indice de la ligne à retourner (0 <= line < height)
+     * \param[in] offset Colonne du premier pixel retourné
+     * \param[in] step Pas entre deux colonnes retournées
+     * \param[in] number Nombre de pixels retournés
+     * \return taille utile du buffer, 0 si erreur
+     */
+    template<typename T>
+    int _getSampledLine ( T* buffer, int line, int offset, int step, int number );
+
 protected:
    
     /** \~french
@@ -108,7 +229,8 @@ protected:
      * \param[in] bitspersample nombre de bits par canal
      * \param[in] photometric photométrie des données
      * \param[in] compression compression des données
-     * \param[in] jp2ptr pointeur vers l'image JPEG2000
+     * \param[in] format format du flux JPEG2000
+     * \param[in] resolutions nombre de niveaux de résolution dans le fichier
      ** \~english
      * \brief Create a LibopenjpegImage object, from all attributes
      * \param[in] width image width, in pixel
@@ -122,12 +244,13 @@ protected:
      * \param[in] bitspersample number of bits per sample
      * \param[in] photometric data photometric
      * \param[in] compression data compression
-     * \param[in] jp2ptr JPEG2000 image's pointer
+     * \param[in] format JPEG2000 stream format
+     * \param[in] resolutions number of resolution levels in the file
      */
     LibopenjpegImage (
         int width, int height, double resx, double resy, int channels, BoundingBox< double > bbox, char* name,
         SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric, Compression::eCompression compression,
-        opj_image_t* jp2ptr
+        OPJ_CODEC_FORMAT format, int resolutions
     );
 
 public:
@@ -145,17 +268,23 @@ public:
     int getline ( uint8_t* buffer, int line );
     int getline ( uint16_t* buffer, int line );
     int getline ( float* buffer, int line );
+
+    int getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( float* buffer, int line, int offset, int step, int number );
+
+    bool restrictReading ( BoundingBox<double> area, double wantedResx, double wantedResy );
     
     /**
      * \~french
      * \brief Destructeur par défaut
-     * \details Suppression du buffer de lecture #m_data
+     * \details Fermeture du décodeur et suppression de la bande en mémoire #strip_image
      * \~english
      * \brief Default destructor
-     * \details We remove read buffer #m_data
+     * \details We close decoder and remove strip in memory #strip_image
      */
     ~LibopenjpegImage() {
-        opj_image_destroy(jp2image);
+        closeCodestream();
     }
 
     /** \~french
@@ -166,8 +295,8 @@ public:
     void print() {
         LOGGER_INFO ( "" );
         LOGGER_INFO ( "---------- LibopenjpegImage ------------" );
-        FileImage::print();
-        //LOGGER_INFO ( "\t- info sup : " << info sup );
+        Jpeg2000Image::print();
+        LOGGER_INFO ( "\t- Rows per strip : " << rowsperstrip );
         LOGGER_INFO ( "" );
     }
 
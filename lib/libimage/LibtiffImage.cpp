@@ -182,44 +182,142 @@ static uint16_t fromROK4ExtraSample ( ExtraSample::eExtraSample es ) {
 /* ----- Pour la lecture ----- */
 LibtiffImage* LibtiffImageFactory::createLibtiffImageToRead ( char* filename, BoundingBox< double > bbox, double resx, double resy ) {
 
-    int width=0, height=0, channels=0, planarconfig=0, bitspersample=0, sf=0, ph=0, comp=0, rowsperstrip=0;
     TIFF* tif = TIFFOpen ( filename, "r" );
-    
-    
-    /************** RECUPERATION DES INFORMATIONS **************/
 
     if ( tif == NULL ) {
         LOGGER_ERROR ( "Unable to open TIFF (to read) " << filename );
         return NULL;
     }
-    
+
+    return createLibtiffImageFromTiff ( tif, filename, bbox, resx, resy );
+}
+
+/* ----- Pour la lecture d'un TIFF en mémoire ----- */
+
+/**
+ * \~french \brief TIFF en mémoire, parcouru par la libtiff via les fonctions ci-dessous
+ * \~english \brief In memory TIFF, browsed by libtiff with functions below
+ */
+struct TiffMemory {
+    uint8_t* data;
+    toff_t size;
+    toff_t pos;
+};
+
+static tsize_t tiffMemoryRead ( thandle_t handle, tdata_t buffer, tsize_t size ) {
+    TiffMemory* mem = ( TiffMemory* ) handle;
+    if ( mem->pos >= mem->size ) return 0;
+    if ( ( toff_t ) size > mem->size - mem->pos ) size = mem->size - mem->pos;
+    memcpy ( buffer, mem->data + mem->pos, size );
+    mem->pos += size;
+    return size;
+}
+
+static tsize_t tiffMemoryWrite ( thandle_t handle, tdata_t buffer, tsize_t size ) {
+    return 0;
+}
+
+static toff_t tiffMemorySeek ( thandle_t handle, toff_t offset, int whence ) {
+    TiffMemory* mem = ( TiffMemory* ) handle;
+    switch ( whence ) {
+    case SEEK_SET :
+        mem->pos = offset;
+        break;
+    case SEEK_CUR :
+        mem->pos += offset;
+        break;
+    case SEEK_END :
+        mem->pos = mem->size + offset;
+        break;
+    }
+    return mem->pos;
+}
+
+static int tiffMemoryClose ( thandle_t handle ) {
+    TiffMemory* mem = ( TiffMemory* ) handle;
+    delete[] mem->data;
+    delete mem;
+    return 0;
+}
+
+static toff_t tiffMemorySize ( thandle_t handle ) {
+    return ( ( TiffMemory* ) handle )->size;
+}
+
+static int tiffMemoryMap ( thandle_t handle, tdata_t* base, toff_t* size ) {
+    return 0;
+}
+
+static void tiffMemoryUnmap ( thandle_t handle, tdata_t base, toff_t size ) {
+}
+
+LibtiffImage* LibtiffImageFactory::createLibtiffImageToReadFromBuffer ( RawDataStream* rawStream, BoundingBox< double > bbox, double resx, double resy ) {
+
+    char name[] = "in memory TIFF";
+
+    TiffMemory* mem = new TiffMemory();
+    mem->size = rawStream->getSize();
+    mem->pos = 0;
+    mem->data = new uint8_t[mem->size];
+    if ( rawStream->read ( mem->data, mem->size ) != mem->size ) {
+        LOGGER_ERROR ( "Unable to read the whole stream for " << name );
+        tiffMemoryClose ( mem );
+        return NULL;
+    }
+
+    // Le mode "m" désactive le mapping, les données sont déjà en mémoire
+    TIFF* tif = TIFFClientOpen ( name, "rm", ( thandle_t ) mem,
+        tiffMemoryRead, tiffMemoryWrite, tiffMemorySeek, tiffMemoryClose, tiffMemorySize, tiffMemoryMap, tiffMemoryUnmap
+    );
+
+    if ( tif == NULL ) {
+        LOGGER_ERROR ( "Unable to open TIFF (to read) " << name );
+        tiffMemoryClose ( mem );
+        return NULL;
+    }
+
+    return createLibtiffImageFromTiff ( tif, name, bbox, resx, resy );
+}
+
+LibtiffImage* LibtiffImageFactory::createLibtiffImageFromTiff ( TIFF* tif, char* filename, BoundingBox< double > bbox, double resx, double resy ) {
+
+    int width=0, height=0, channels=0, planarconfig=0, bitspersample=0, sf=0, ph=0, comp=0, rowsperstrip=0;
+
+    /************** RECUPERATION DES INFORMATIONS **************/
+
     if ( TIFFGetField ( tif, TIFFTAG_IMAGEWIDTH, &width ) < 1 ) {
         LOGGER_ERROR ( "Unable to read pixel width for file " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
 
     if ( TIFFGetField ( tif, TIFFTAG_IMAGELENGTH, &height ) < 1 ) {
         LOGGER_ERROR ( "Unable to read pixel height for file " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
 
     if ( TIFFGetField ( tif, TIFFTAG_SAMPLESPERPIXEL,&channels ) < 1 ) {
         LOGGER_ERROR ( "Unable to read number of samples per pixel for file " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
 
     if ( TIFFGetField ( tif, TIFFTAG_PLANARCONFIG,&planarconfig ) < 1 ) {
         LOGGER_ERROR ( "Unable to read planar configuration for file " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
 
     if ( planarconfig != PLANARCONFIG_CONTIG && channels != 1 ) {
         LOGGER_ERROR ( "Planar configuration have to be 'PLANARCONFIG_CONTIG' for file " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
 
     if ( TIFFGetField ( tif, TIFFTAG_BITSPERSAMPLE,&bitspersample ) < 1 ) {
         LOGGER_ERROR ( "Unable to read number of bits per sample for file " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
 
@@ -234,27 +332,32 @@ LibtiffImage* LibtiffImageFactory::createLibtiffImageToRead ( char* filename, Bo
             sf = SAMPLEFORMAT_UINT;
         } else {
             LOGGER_ERROR ( "Unable to determine sample format from the number of bits per sample (" << bitspersample << ") for file " << filename );
+            TIFFClose ( tif );
             return NULL;
         }
     }
 
     if ( TIFFGetField ( tif, TIFFTAG_PHOTOMETRIC,&ph ) < 1 ) {
         LOGGER_ERROR ( "Unable to read photometric for file " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
     
     if (toROK4Photometric ( ph ) == 0) {
         LOGGER_ERROR ( "Not handled photometric (PALETTE ?) for file " << filename );
+        TIFFClose ( tif );
         return NULL;            
     }
 
     if ( TIFFGetField ( tif, TIFFTAG_COMPRESSION,&comp ) < 1 ) {
         LOGGER_ERROR ( "Unable to read compression for file " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
 
     if ( TIFFGetField ( tif, TIFFTAG_ROWSPERSTRIP,&rowsperstrip ) < 1 ) {
         LOGGER_ERROR ( "Unable to read number of rows per strip for file " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
 
@@ -275,12 +378,14 @@ LibtiffImage* LibtiffImageFactory::createLibtiffImageToRead ( char* filename, Bo
     if ( ! LibtiffImage::canRead ( bitspersample, toROK4SampleFormat ( sf ) ) ) {
         LOGGER_ERROR ( "Not supported sample type : " << SampleFormat::toString ( toROK4SampleFormat ( sf ) ) << " and " << bitspersample << " bits per sample" );
         LOGGER_ERROR ( "\t for the image to read : " << filename );
+        TIFFClose ( tif );
         return NULL;
     }
 
     if ( resx > 0 && resy > 0 ) {
         if (! Image::dimensionsAreConsistent(resx, resy, width, height, bbox)) {
             LOGGER_ERROR ( "Resolutions, bounding box and real dimensions for image '" << filename << "' are not consistent" );
+            TIFFClose ( tif );
             return NULL;
         }
     } else {
@@ -486,25 +591,35 @@ LibtiffImage::LibtiffImage (
 /* ------------------------------------------------------------------------------------------------ */
 /* ------------------------------------------- LECTURE -------------------------------------------- */
 
+bool LibtiffImage::loadStrip ( int line ) {
+
+    if ( line / rowsperstrip == current_strip ) {
+        return true;
+    }
+
+    // Les données n'ont pas encore été lue depuis l'image (strip pas en mémoire).
+    current_strip = line / rowsperstrip;
+    int size = TIFFReadEncodedStrip ( tif, current_strip, strip_buffer, -1 );
+    if ( size < 0 ) {
+        LOGGER_ERROR ( "Cannot read strip number " << current_strip << " of image " << filename );
+        return false;
+    }
+
+    if (oneTo8bits == 1) {
+        OneBitConverter::minwhiteToGray(oneTo8bits_buffer, strip_buffer, size);
+    } else if (oneTo8bits == 2) {
+        OneBitConverter::minblackToGray(oneTo8bits_buffer, strip_buffer, size);
+    }
+
+    return true;
+}
+
 template<typename T>
 int LibtiffImage::_getline ( T* buffer, int line ) {
     // buffer doit déjà être alloué, et assez grand, en tenant compte de la conversion
     
-    if ( line / rowsperstrip != current_strip ) {
-        
-        // Les données n'ont pas encore été lue depuis l'image (strip pas en mémoire).
-        current_strip = line / rowsperstrip;
-        int size = TIFFReadEncodedStrip ( tif, current_strip, strip_buffer, -1 );
-        if ( size < 0 ) {
-            LOGGER_ERROR ( "Cannot read strip number " << current_strip << " of image " << filename );
-            return 0;
-        }
-        
-        if (oneTo8bits == 1) {
-            OneBitConverter::minwhiteToGray(oneTo8bits_buffer, strip_buffer, size);
-        } else if (oneTo8bits == 2) {
-            OneBitConverter::minblackToGray(oneTo8bits_buffer, strip_buffer, size);
-        }
+    if ( ! loadStrip ( line ) ) {
+        return 0;
     }
     
 
@@ -598,6 +713,36 @@ int LibtiffImage::getline ( float* buffer, int line ) {
     return 0;
 }
 
+template<typename T>
+int LibtiffImage::_getSampledLine ( T* buffer, int line, int offset, int step, int number ) {
+
+    if ( converter || esType == ExtraSample::ALPHA_ASSOC || 8 * ( int ) sizeof ( T ) != bitspersample ) {
+        // Les données doivent être transformées : on passe par la ligne entière
+        return Image::_getSampledLine ( buffer, line, offset, step, number );
+    }
+
+    if ( ! loadStrip ( line ) ) {
+        return 0;
+    }
+
+    uint8_t* strip = ( oneTo8bits ? oneTo8bits_buffer : strip_buffer );
+    samplePixels ( buffer, ( T* ) ( strip + ( line%rowsperstrip ) * width * pixelSize + offset * pixelSize ), channels, step, number );
+
+    return number * channels;
+}
+
+int LibtiffImage::getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int LibtiffImage::getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
+int LibtiffImage::getSampledLine ( float* buffer, int line, int offset, int step, int number ) {
+    return _getSampledLine ( buffer, line, offset, step, number );
+}
+
 /* ------------------------------------------------------------------------------------------------ */
 /* ------------------------------------------- ECRITURE ------------------------------------------- */
 
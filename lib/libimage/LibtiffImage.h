@@ -57,6 +57,7 @@
 #include <string.h>
 #include "Format.h"
 #include "FileImage.h"
+#include "Data.h"
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -128,6 +129,30 @@ private:
     template<typename T>
     int _getline ( T* buffer, int line );
 
+    /** \~french
+     * \brief Charge en mémoire le strip contenant la ligne
+     * \param[in] line Indice de la ligne voulue
+     * \return faux en cas d'erreur de lecture
+     ** \~english
+     * \brief Load in memory the strip containing the line
+     * \param[in] line Wanted line indice
+     * \return false if reading error
+     */
+    bool loadStrip ( int line );
+
+    /** \~french
+     * \brief Retourne une ligne sous-échantillonnée, flottante ou entière
+     * \details Lorsque les données n'ont pas à être transformées (ni conversion, ni alpha associé), les pixels sont pris directement dans le strip en mémoire, sans recopier la ligne entière.
+     * \param[out] buffer Tableau contenant au moins number*channels valeurs
+     * \param[in] line Indice de la ligne à retourner (0 <= line < height)
+     * \param[in] offset Colonne du premier pixel retourné
+     * \param[in] step Pas entre deux colonnes retournées
+     * \param[in] number Nombre de pixels retournés
+     * \return taille utile du buffer, 0 si erreur
+     */
+    template<typename T>
+    int _getSampledLine ( T* buffer, int line, int offset, int step, int number );
+
 protected:
     /** \~french
      * \brief Crée un objet LibtiffImage à partir de tous ses éléments constitutifs
@@ -233,6 +258,10 @@ public:
     int getline ( uint16_t *buffer, int line );
     int getline ( float* buffer, int line );
 
+    int getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number );
+    int getSampledLine ( float* buffer, int line, int offset, int step, int number );
+
     /**
      * \~french
      * \brief Ecrit une image TIFF, à partir d'une image source
@@ -354,6 +383,25 @@ public:
      */
     LibtiffImage* createLibtiffImageToRead ( char* filename, BoundingBox<double> bbox, double resx, double resy );
 
+    /** \~french
+     * \brief Crée un objet LibtiffImage, pour la lecture d'un TIFF en mémoire
+     * \details Le flux est entièrement lu et copié, il peut être détruit dès le retour de la fonction. Les données sont libérées avec l'image. Emprise et résolutions sont gérées comme pour la lecture d'un fichier.
+     * \param[in] rawStream flux contenant le TIFF complet
+     * \param[in] bbox emprise rectangulaire de l'image
+     * \param[in] resx résolution dans le sens des X.
+     * \param[in] resy résolution dans le sens des Y.
+     * \return un pointeur d'objet LibtiffImage, NULL en cas d'erreur
+     ** \~english
+     * \brief Create an LibtiffImage object, to read an in memory TIFF
+     * \details Stream is fully read and copied, it can be destroyed as soon as the function returns. Data are freed with the image. Bbox and resolutions are handled as for a file reading.
+     * \param[in] rawStream stream containing the whole TIFF
+     * \param[in] bbox bounding box
+     * \param[in] resx X wise resolution.
+     * \param[in] resy Y wise resolution.
+     * \return a LibtiffImage object pointer, NULL if error
+     */
+    LibtiffImage* createLibtiffImageToReadFromBuffer ( RawDataStream* rawStream, BoundingBox<double> bbox, double resx, double resy );
+
     /** \~french
      * \brief Crée un objet LibtiffImage, pour l'écriture
      * \details Toutes les méta-informations sur l'image doivent être précisées pour écrire l'en-tête TIFF.
@@ -397,6 +445,20 @@ public:
         SampleFormat::eSampleFormat sampleformat, int bitspersample, Photometric::ePhotometric photometric,
         Compression::eCompression compression, uint16_t rowsperstrip = 16
     );
+
+private:
+    /** \~french
+     * \brief Crée un objet LibtiffImage à partir d'un TIFF ouvert en lecture
+     * \details Les en-têtes sont lus et contrôlés. En cas d'erreur, le TIFF est fermé.
+     * \param[in] tif TIFF ouvert en lecture
+     * \param[in] filename nom de l'image, pour les messages et l'objet créé
+     ** \~english
+     * \brief Create an LibtiffImage object from a TIFF opened for reading
+     * \details Headers are read and checked. If error, TIFF is closed.
+     * \param[in] tif TIFF opened for reading
+     * \param[in] filename image's name, for messages and created object
+     */
+    LibtiffImage* createLibtiffImageFromTiff ( TIFF* tif, char* filename, BoundingBox<double> bbox, double resx, double resy );
 };
 
 #endif
@@ -38,63 +38,143 @@
 #include "Line.h"
 #include <tgmath.h>
 
+/* ------------------------------------------------------------------------------------------------ */
+/* --------------------------------- FUSION D'UN PIXEL -------------------------------------------- */
+/* ------------------------------------------------------------------------------------------------ */
+
+// Couleurs prémultipliées : dessus + dessous * ( 1 - alpha du dessus ), alpha compris
+static inline void blendPixel ( float* pix, const float* pixAb ) {
+    float t = 1. - pixAb[3];
+    pix[0] = pixAb[0] + pix[0] * t;
+    pix[1] = pixAb[1] + pix[1] * t;
+    pix[2] = pixAb[2] + pix[2] * t;
+    pix[3] = pixAb[3] + pix[3] * t;
+}
+
+// Le produit des couleurs prémultipliées est la couleur prémultipliée du produit
+static inline void multiplyPixel ( float* pix, const float* pixAb, float coeff ) {
+    pix[0] = pix[0] * pixAb[0] / coeff;
+    pix[1] = pix[1] * pixAb[1] / coeff;
+    pix[2] = pix[2] * pixAb[2] / coeff;
+    pix[3] *= pixAb[3];
+}
+
 /* ------------------------------------------------------------------------------------------------ */
 /* --------------------------------- DÉFINITION DES FONCTIONS ------------------------------------- */
 /* ------------------------------------------------------------------------------------------------ */
 
+#ifdef __SSE2__
+
+/**
+ * \~french
+ * \brief Masques de non-donnée de 4 pixels consécutifs, chacun étendu aux 4 flottants du pixel
+ * \return vrai si aucun des 4 pixels n'est de la donnée
+ */
+static inline bool nodataMasks ( const uint8_t* mask, __m128* nodata ) {
+    int32_t bytes;
+    memcpy ( &bytes, mask, 4 );
+    if ( bytes == 0 ) return true;
+
+    __m128i m = _mm_cmpeq_epi8 ( _mm_cvtsi32_si128 ( bytes ), _mm_setzero_si128() );
+    m = _mm_unpacklo_epi8 ( m, m );
+    m = _mm_unpacklo_epi16 ( m, m );
+    nodata[0] = _mm_castsi128_ps ( _mm_shuffle_epi32 ( m, _MM_SHUFFLE ( 0,0,0,0 ) ) );
+    nodata[1] = _mm_castsi128_ps ( _mm_shuffle_epi32 ( m, _MM_SHUFFLE ( 1,1,1,1 ) ) );
+    nodata[2] = _mm_castsi128_ps ( _mm_shuffle_epi32 ( m, _MM_SHUFFLE ( 2,2,2,2 ) ) );
+    nodata[3] = _mm_castsi128_ps ( _mm_shuffle_epi32 ( m, _MM_SHUFFLE ( 3,3,3,3 ) ) );
+    return false;
+}
+
+// Garde le pixel courant là où le dessus n'est pas de la donnée
+static inline __m128 selectPixel ( __m128 nodata, __m128 current, __m128 merged ) {
+    return _mm_or_ps ( _mm_and_ps ( nodata, current ), _mm_andnot_ps ( nodata, merged ) );
+}
+
 void Line::alphaBlending ( Line* above ) {
-    // Initialisation des pointeurs courants sur les pixels et l'alpha (final et above)
-    float* pix = samples;
-    float* al = alpha;
-    float* pixAb = above->samples;
-    float* alAb = above->alpha;
-    for ( int i = 0; i < width; i++, pix += 3, pixAb += 3, al++, alAb++ ) {
-        if ( *alAb == 0. || ! above->mask[i] ) {
-            // Le pixel de la ligne du dessus est transparent, ou n'est pas de la donnée, il ne change donc pas le pixel du dessous.
-            continue;
-        }
+    const __m128 one = _mm_set1_ps ( 1. );
+    __m128 nodata[4];
+    int i = 0;
 
-        if ( *al == 0. ) {
-            // Le pixel de la ligne du dessous est complètement transparent, le résultat est donc égal au pixel du dessus
-            *al = *alAb;
-            memcpy(pix, pixAb, 3*sizeof(float));
-            continue;
-        }
+    for ( ; i + 4 <= width; i += 4 ) {
+        if ( nodataMasks ( above->mask + i, nodata ) ) continue;
 
-        float a = *alAb + *al * ( 1. - *alAb );
+        for ( int k = 0; k < 4; k++ ) {
+            float* pix = pixels + 4* ( i+k );
+            __m128 ab = _mm_loadu_ps ( above->pixels + 4* ( i+k ) );
+            __m128 cur = _mm_loadu_ps ( pix );
+            __m128 t = _mm_sub_ps ( one, _mm_shuffle_ps ( ab, ab, _MM_SHUFFLE ( 3,3,3,3 ) ) );
+            _mm_storeu_ps ( pix, selectPixel ( nodata[k], cur, _mm_add_ps ( ab, _mm_mul_ps ( cur, t ) ) ) );
+        }
+    }
 
-        pix[0] = ( *alAb * pixAb[0] + *al * pix[0] * ( 1 - *alAb ) ) / a;
-        pix[1] = ( *alAb * pixAb[1] + *al * pix[1] * ( 1 - *alAb ) ) / a;
-        pix[2] = ( *alAb * pixAb[2] + *al * pix[2] * ( 1 - *alAb ) ) / a;
-        *al = a;
+    for ( ; i < width; i++ ) {
+        if ( above->mask[i] ) blendPixel ( pixels + 4*i, above->pixels + 4*i );
     }
 }
 
 void Line::useMask ( Line* above ) {
-    float* pix = samples;
-    float* pixAb = above->samples;
-    for ( int i = 0; i < width; i++, pix += 3, pixAb += 3 ) {
-        if ( above->mask[i] ) {
-            alpha[i] = above->alpha[i];
-            memcpy(pix, pixAb, 3 * sizeof(float));
+    __m128 nodata[4];
+    int i = 0;
+
+    for ( ; i + 4 <= width; i += 4 ) {
+        if ( nodataMasks ( above->mask + i, nodata ) ) continue;
+
+        for ( int k = 0; k < 4; k++ ) {
+            float* pix = pixels + 4* ( i+k );
+            _mm_storeu_ps ( pix, selectPixel ( nodata[k], _mm_loadu_ps ( pix ), _mm_loadu_ps ( above->pixels + 4* ( i+k ) ) ) );
         }
     }
+
+    for ( ; i < width; i++ ) {
+        if ( above->mask[i] ) memcpy ( pixels + 4*i, above->pixels + 4*i, 4*sizeof ( float ) );
+    }
 }
 
 void Line::multiply ( Line* above ) {
-    for ( int i = 0; i < width; i++ ) {
-        if ( ! above->mask[i] ) {
-            // Le pixel de la ligne du dessus n'est pas de la donnée, il ne change donc pas le pixel du dessous.
-            continue;
+    // L'alpha n'est pas ramené à la valeur maximale d'un canal
+    const __m128 div = _mm_set_ps ( 1., coeff, coeff, coeff );
+    __m128 nodata[4];
+    int i = 0;
+
+    for ( ; i + 4 <= width; i += 4 ) {
+        if ( nodataMasks ( above->mask + i, nodata ) ) continue;
+
+        for ( int k = 0; k < 4; k++ ) {
+            float* pix = pixels + 4* ( i+k );
+            __m128 cur = _mm_loadu_ps ( pix );
+            __m128 merged = _mm_div_ps ( _mm_mul_ps ( cur, _mm_loadu_ps ( above->pixels + 4* ( i+k ) ) ), div );
+            _mm_storeu_ps ( pix, selectPixel ( nodata[k], cur, merged ) );
         }
+    }
+
+    for ( ; i < width; i++ ) {
+        if ( above->mask[i] ) multiplyPixel ( pixels + 4*i, above->pixels + 4*i, coeff );
+    }
+}
+
+#else // Version non SSE
+
+void Line::alphaBlending ( Line* above ) {
+    for ( int i = 0; i < width; i++ ) {
+        // Le pixel de la ligne du dessus n'est pas de la donnée, il ne change donc pas le pixel du dessous.
+        if ( above->mask[i] ) blendPixel ( pixels + 4*i, above->pixels + 4*i );
+    }
+}
 
-        alpha[i] *= above->alpha[i];
-        samples[3*i] = samples[3*i] * above->samples[3*i] / coeff;
-        samples[3*i+1] = samples[3*i+1] * above->samples[3*i+1] / coeff;
-        samples[3*i+2] = samples[3*i+2] * above->samples[3*i+2] / coeff;
+void Line::useMask ( Line* above ) {
+    for ( int i = 0; i < width; i++ ) {
+        if ( above->mask[i] ) memcpy ( pixels + 4*i, above->pixels + 4*i, 4*sizeof ( float ) );
     }
 }
 
+void Line::multiply ( Line* above ) {
+    for ( int i = 0; i < width; i++ ) {
+        if ( above->mask[i] ) multiplyPixel ( pixels + 4*i, above->pixels + 4*i, coeff );
+    }
+}
+
+#endif
+
 
 /* --------------------------------- SPÉCIALISATION DE TEMPLATE ----------------------------------- */
 
@@ -106,42 +186,31 @@ void Line::store ( uint8_t* imageIn, uint8_t* maskIn, int srcSpp, uint8_t* trans
     switch ( srcSpp ) {
     case 1:
         for ( int i = 0; i < width; i++ ) {
-            if ( imageIn[i] == transparent[0] && imageIn[i] == transparent[1] && imageIn[i] == transparent[2] ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = 1.0;
-            }
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = (float) imageIn[i];
+            float a = ( imageIn[i] == transparent[0] && imageIn[i] == transparent[1] && imageIn[i] == transparent[2] ) ? 0. : 1.;
+            setPixel ( i, imageIn[i], imageIn[i], imageIn[i], a );
         }
         break;
     case 2:
         for ( int i = 0; i < width; i++ ) {
+            float a;
             if ( imageIn[2*i] == transparent[0] && imageIn[2*i] == transparent[1] && imageIn[2*i] == transparent[2] ) {
-                alpha[i] = 0.0;
+                a = 0.0;
             } else {
-                alpha[i] = ( float ) imageIn[2*i+1] / 255.;
+                a = ( float ) imageIn[2*i+1] / 255.;
             }
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = (float) imageIn[2*i];
+            setPixel ( i, imageIn[2*i], imageIn[2*i], imageIn[2*i], a );
         }
         break;
     case 3:
-        convert( samples, imageIn, 3*width );
         for ( int i = 0; i < width; i++ ) {
-            if ( ! memcmp ( imageIn+3*i, transparent, 3 ) ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = 1.0;
-            }
+            float a = memcmp ( imageIn+3*i, transparent, 3 ) ? 1. : 0.;
+            setPixel ( i, imageIn[3*i], imageIn[3*i+1], imageIn[3*i+2], a );
         }
         break;
     case 4:
         for ( int i = 0; i < width; i++ ) {
-            convert( samples+i*3, imageIn+i*4, 3 );
-            if ( ! memcmp ( imageIn+4*i, transparent, 3 ) ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = ( float ) imageIn[i*4+3] / 255.;
-            }
+            float a = memcmp ( imageIn+4*i, transparent, 3 ) ? ( float ) imageIn[i*4+3] / 255. : 0.;
+            setPixel ( i, imageIn[4*i], imageIn[4*i+1], imageIn[4*i+2], a );
         }
         break;
     }
@@ -153,27 +222,41 @@ void Line::store ( uint8_t* imageIn, uint8_t* maskIn, int srcSpp ) {
     switch ( srcSpp ) {
     case 1:
         for ( int i = 0; i < width; i++ ) {
-            alpha[i] = 1.0;
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = (float) imageIn[i];
+            setPixel ( i, imageIn[i], imageIn[i], imageIn[i], 1. );
         }
         break;
     case 2:
         for ( int i = 0; i < width; i++ ) {
-            alpha[i] = ( float ) imageIn[2*i+1] / 255.;
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = (float) imageIn[2*i];
+            setPixel ( i, imageIn[2*i], imageIn[2*i], imageIn[2*i], ( float ) imageIn[2*i+1] / 255. );
         }
         break;
     case 3:
-        convert( samples, imageIn, 3*width );
         for ( int i = 0; i < width; i++ ) {
-            alpha[i] = 1.0;
+            setPixel ( i, imageIn[3*i], imageIn[3*i+1], imageIn[3*i+2], 1. );
         }
         break;
     case 4:
+#ifdef __SSE2__
+    {
+        // Un pixel par registre : [r,g,b,a] * [a,a,a,1] / 255
+        const __m128i z = _mm_setzero_si128();
+        const __m128 one = _mm_set1_ps ( 1. );
+        const __m128 max = _mm_set1_ps ( 255. );
+        const __m128 colors = _mm_castsi128_ps ( _mm_set_epi32 ( 0, -1, -1, -1 ) );
         for ( int i = 0; i < width; i++ ) {
-            convert( samples+i*3, imageIn+i*4, 3 );
-            alpha[i] = ( float ) imageIn[i*4+3] / 255.;
+            int32_t bytes;
+            memcpy ( &bytes, imageIn + 4*i, 4 );
+            __m128 v = _mm_cvtepi32_ps ( _mm_unpacklo_epi16 ( _mm_unpacklo_epi8 ( _mm_cvtsi32_si128 ( bytes ), z ), z ) );
+            __m128 a = _mm_shuffle_ps ( v, v, _MM_SHUFFLE ( 3,3,3,3 ) );
+            __m128 factors = _mm_or_ps ( _mm_and_ps ( colors, a ), _mm_andnot_ps ( colors, one ) );
+            _mm_storeu_ps ( pixels + 4*i, _mm_div_ps ( _mm_mul_ps ( v, factors ), max ) );
         }
+    }
+#else
+        for ( int i = 0; i < width; i++ ) {
+            setPixel ( i, imageIn[4*i], imageIn[4*i+1], imageIn[4*i+2], ( float ) imageIn[i*4+3] / 255. );
+        }
+#endif
         break;
     }
 }
@@ -186,42 +269,31 @@ void Line::store ( uint16_t* imageIn, uint8_t* maskIn, int srcSpp, uint16_t* tra
     switch ( srcSpp ) {
     case 1:
         for ( int i = 0; i < width; i++ ) {
-            if ( imageIn[i] == transparent[0] && imageIn[i] == transparent[1] && imageIn[i] == transparent[2] ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = 1.0;
-            }
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = (float) imageIn[i];
+            float a = ( imageIn[i] == transparent[0] && imageIn[i] == transparent[1] && imageIn[i] == transparent[2] ) ? 0. : 1.;
+            setPixel ( i, imageIn[i], imageIn[i], imageIn[i], a );
         }
         break;
     case 2:
         for ( int i = 0; i < width; i++ ) {
+            float a;
             if ( imageIn[2*i] == transparent[0] && imageIn[2*i] == transparent[1] && imageIn[2*i] == transparent[2] ) {
-                alpha[i] = 0.0;
+                a = 0.0;
             } else {
-                alpha[i] = ( float ) imageIn[2*i+1] / 65535.;
+                a = ( float ) imageIn[2*i+1] / 65535.;
             }
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = (float) imageIn[2*i];
+            setPixel ( i, imageIn[2*i], imageIn[2*i], imageIn[2*i], a );
         }
         break;
     case 3:
-        convert( samples, imageIn, 3*width );
         for ( int i = 0; i < width; i++ ) {
-            if ( ! memcmp ( imageIn+3*i, transparent, 3*sizeof(uint16_t) ) ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = 1.0;
-            }
+            float a = memcmp ( imageIn+3*i, transparent, 3*sizeof(uint16_t) ) ? 1. : 0.;
+            setPixel ( i, imageIn[3*i], imageIn[3*i+1], imageIn[3*i+2], a );
         }
         break;
     case 4:
         for ( int i = 0; i < width; i++ ) {
-            convert( samples+i*3, imageIn+i*4, 3 );
-            if ( ! memcmp ( imageIn+4*i, transparent, 3*sizeof(uint16_t) ) ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = ( float ) imageIn[i*4+3] / 65535.;
-            }
+            float a = memcmp ( imageIn+4*i, transparent, 3*sizeof(uint16_t) ) ? ( float ) imageIn[i*4+3] / 65535. : 0.;
+            setPixel ( i, imageIn[4*i], imageIn[4*i+1], imageIn[4*i+2], a );
         }
         break;
     }
@@ -234,26 +306,22 @@ void Line::store ( uint16_t* imageIn, uint8_t* maskIn, int srcSpp ) {
     switch ( srcSpp ) {
     case 1:
         for ( int i = 0; i < width; i++ ) {
-            alpha[i] = 1.0;
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = (float) imageIn[i];
+            setPixel ( i, imageIn[i], imageIn[i], imageIn[i], 1. );
         }
         break;
     case 2:
         for ( int i = 0; i < width; i++ ) {
-            alpha[i] = ( float ) imageIn[2*i+1] / 65535.;
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = (float) imageIn[2*i];
+            setPixel ( i, imageIn[2*i], imageIn[2*i], imageIn[2*i], ( float ) imageIn[2*i+1] / 65535. );
         }
         break;
     case 3:
-        convert( samples, imageIn, 3*width );
         for ( int i = 0; i < width; i++ ) {
-            alpha[i] = 1.0;
+            setPixel ( i, imageIn[3*i], imageIn[3*i+1], imageIn[3*i+2], 1. );
         }
         break;
     case 4:
         for ( int i = 0; i < width; i++ ) {
-            convert( samples+i*3, imageIn+i*4, 3 );
-            alpha[i] = ( float ) imageIn[i*4+3] / 65535.;
+            setPixel ( i, imageIn[4*i], imageIn[4*i+1], imageIn[4*i+2], ( float ) imageIn[i*4+3] / 65535. );
         }
         break;
     }
@@ -262,51 +330,40 @@ void Line::store ( uint16_t* imageIn, uint8_t* maskIn, int srcSpp ) {
 
 // -------------- FLOAT
 
+// Une couleur est transparente si elle est égale (ou relativement proche à 0.1% près) à la valeur de transparence
+static inline bool isTransparent ( const float* color, const float* transparent ) {
+    return ! memcmp ( color, transparent, 3*sizeof ( float ) )
+        || ( fabsf ( ( color[0]-transparent[0] ) /transparent[0] ) <0.001 && fabsf ( ( color[1]-transparent[1] ) /transparent[1] ) <0.001 && fabsf ( ( color[2]-transparent[2] ) /transparent[2] ) <0.001 );
+}
+
+// En niveau de gris, seul le premier canal de la valeur de transparence sert à la comparaison relative
+static inline bool isTransparent ( float gray, const float* transparent ) {
+    float color[3] = {gray, gray, gray};
+    return ! memcmp ( color, transparent, 3*sizeof ( float ) ) || fabsf ( ( gray-*transparent ) / ( *transparent ) ) <0.001;
+}
+
 template <>
 void Line::store ( float* imageIn, uint8_t* maskIn, int srcSpp, float* transparent ) {
     memcpy ( mask, maskIn, width );
     switch ( srcSpp ) {
     case 1:
         for ( int i = 0; i < width; i++ ) {
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = imageIn[i];
-            //if ( ! memcmp ( samples+3*i, transparent, 3*sizeof ( float ) ) ) {
-	    if ( ! memcmp ( samples+3*i, transparent, 3*sizeof ( float ) ) || fabsf((*(samples+3*i)-*transparent)/(*transparent))<0.001 ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = 1.0;
-            }
+            setPixel ( i, imageIn[i], imageIn[i], imageIn[i], isTransparent ( imageIn[i], transparent ) ? 0. : 1. );
         }
         break;
     case 2:
         for ( int i = 0; i < width; i++ ) {
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = imageIn[2*i];
-            if ( ! memcmp ( samples+3*i, transparent, 3*sizeof ( float ) ) || fabsf((*(samples+3*i)-*transparent)/(*transparent))<0.001 ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = imageIn[2*i+1];
-            }
+            setPixel ( i, imageIn[2*i], imageIn[2*i], imageIn[2*i], isTransparent ( imageIn[2*i], transparent ) ? 0. : imageIn[2*i+1] );
         }
         break;
     case 3:
-        memcpy ( samples, imageIn, sizeof ( float ) *3*width );
         for ( int i = 0; i < width; i++ ) {
-            if ( ! memcmp ( samples+3*i, transparent, 3*sizeof ( float ) )
-	      || (fabsf((*(samples+3*i)-*transparent)/(*transparent))<0.001 && fabsf((*(samples+3*i+1)-*(transparent+1))/(*(transparent+1))<0.001) && fabsf((*(samples+3*i+2)-*(transparent+2))/(*(transparent+2)))<0.001 ) ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = 1.0;
-            }
+            setPixel ( i, imageIn[3*i], imageIn[3*i+1], imageIn[3*i+2], isTransparent ( imageIn+3*i, transparent ) ? 0. : 1. );
         }
         break;
     case 4:
         for ( int i = 0; i < width; i++ ) {
-            memcpy ( samples+i*3, imageIn+i*4, sizeof ( float ) *3 );
-            if ( ! memcmp ( samples+3*i, transparent, 3*sizeof ( float ) )
-	      || (fabsf((*(samples+3*i)-*transparent)/(*transparent))<0.001 && fabsf((*(samples+3*i+1)-*(transparent+1))/(*(transparent+1))<0.001) && fabsf((*(samples+3*i+2)-*(transparent+2))/(*(transparent+2)))<0.001 ) ) {
-                alpha[i] = 0.0;
-            } else {
-                alpha[i] = imageIn[i*4+3];
-            }
+            setPixel ( i, imageIn[4*i], imageIn[4*i+1], imageIn[4*i+2], isTransparent ( imageIn+4*i, transparent ) ? 0. : imageIn[i*4+3] );
         }
         break;
     }
@@ -318,26 +375,22 @@ void Line::store ( float* imageIn, uint8_t* maskIn, int srcSpp ) {
     switch ( srcSpp ) {
     case 1:
         for ( int i = 0; i < width; i++ ) {
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = imageIn[i];
-            alpha[i] = 1.0;
+            setPixel ( i, imageIn[i], imageIn[i], imageIn[i], 1. );
         }
         break;
     case 2:
         for ( int i = 0; i < width; i++ ) {
-            samples[3*i] = samples[3*i+1] = samples[3*i+2] = imageIn[2*i];
-            alpha[i] = imageIn[2*i+1];
+            setPixel ( i, imageIn[2*i], imageIn[2*i], imageIn[2*i], imageIn[2*i+1] );
         }
         break;
     case 3:
-        memcpy ( samples, imageIn, sizeof ( float ) *3*width );
         for ( int i = 0; i < width; i++ ) {
-            alpha[i] = 1.0;
+            setPixel ( i, imageIn[3*i], imageIn[3*i+1], imageIn[3*i+2], 1. );
         }
         break;
     case 4:
         for ( int i = 0; i < width; i++ ) {
-            memcpy ( samples+i*3,imageIn+i*4,sizeof ( float ) *3 );
-            alpha[i] = imageIn[i*4+3];
+            setPixel ( i, imageIn[4*i], imageIn[4*i+1], imageIn[4*i+2], imageIn[i*4+3] );
         }
         break;
     }
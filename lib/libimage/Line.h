@@ -54,7 +54,7 @@
 /** \~ \author Institut national de l'information géographique et forestière
  ** \~french
  * \brief Représentation d'une ligne flottante
- * \details Cette classe stocke une ligne d'image sur 4 canaux, 3 pour la couleur et un canal alpha non-associé (pas prémultiplié aux couleurs). Ce fonctionnement est toujours le même, que les canaux sources soient entiers ou flottants. En stockant toujours les informations dans ce format de travail, on va faciliter les calculs de fusion de plusieurs lignes, dont les caractéristiques étaient différentes. Le formattage final sera également facilité.
+ * \details Cette classe stocke une ligne d'image sur 4 canaux entrelacés, 3 pour la couleur et un canal alpha associé : les couleurs sont prémultipliées par l'alpha. Ce fonctionnement est toujours le même, que les canaux sources soient entiers ou flottants. En stockant toujours les informations dans ce format de travail, on va faciliter les calculs de fusion de plusieurs lignes, dont les caractéristiques étaient différentes. Le formattage final sera également facilité.
  *
  * Cette classe gère les données, que ce soit comme sources ou comme sortie, sur :
  * \li 1 canal : niveau de gris
@@ -62,7 +62,9 @@
  * \li 3 canaux : vraie couleur
  * \li 4 canaux : vraie couleur + alpha non-associé
  *
- * La classe travaille toujours sur des flottant, quel que soit le format de base des images lues. Cela permet de faire des calculs flottant, et de ne caster qu'au moment de l'écriture.
+ * La classe travaille toujours sur des flottant, quel que soit le format de base des images lues. Cela permet de faire des calculs flottant, et de ne caster qu'au moment de l'écriture. La prémultiplication n'est faite qu'au stockage (#store) et n'est défaite qu'à l'écriture (#write), pour les sorties avec alpha.
+ *
+ * Un pixel occupant 4 flottants, les fusions traitent un pixel par registre SSE2, sans branchement ni division : la formule de l'alpha-blending sur des couleurs prémultipliées est la même pour les couleurs et l'alpha.
  *
  * Les données peuvent possédé un masque associé, auquel cas il sera stocké en parallèle des données. Quelque soit le mode de fusion utilisé par la suite, on tiendra toujours compte de ce masque.
  *
@@ -73,23 +75,18 @@
  *
  * \todo Travailler sur un nombre de canaux variable (pour l'instant, systématiquement 4, que ce soit en entier ou en flottant).
  * \todo Les modes de fusion DARKEN et LIGHTEN ne sont pas implémentés.
- * \todo Un pixel correspond toujours à 4 flottants (3 canaux + 1 alpha). Il doit être possible d'utiliser des fonctions SSE pour optimiser les calculs
- ** \~french
+ ** \~english
  * \brief Represent an image line, with float
+ * \details Line is stored with 4 interleaved samples : 3 colors premultiplied by the associated alpha, and alpha. Premultiplication is done when storing and undone when writing, for outputs with alpha.
  */
 class Line {
 
 public:
     /**
-     * \~french \brief Canaux de couleur, sans tenir compte de l'alpha
-     * \~english \brief Color's samples, ignoring alpha
-     */
-    float* samples;
-    /**
-     * \~french \brief Valeurs d'alpha, entre 0 et 1
-     * \~english \brief Alpha values, between 0 and 1
+     * \~french \brief Pixels : rouge, vert et bleu prémultipliés par l'alpha, puis l'alpha (entre 0 et 1)
+     * \~english \brief Pixels : red, green and blue premultiplied by alpha, then alpha (between 0 and 1)
      */
-    float* alpha;
+    float* pixels;
     /**
      * \~french \brief Masque associé aux données
      * \details \li 0 = non-donnée
@@ -126,12 +123,8 @@ public:
      * \param[in] width line's width, in pixel
      */
     Line ( int width, int samplesize ) : width ( width ) {
-        if (samplesize == 1) coeff = 255.; //cas uint8_t
-        else if (samplesize == 4) coeff = 1.; //cas float
-        else LOGGER_ERROR("Sample size is unknown for the line");
-        
-        samples = new float[3*width];
-        alpha = new float[width];
+        coeff = getCoeff ( samplesize );
+        pixels = new float[4*width];
         mask = new uint8_t[width];
     }
 
@@ -154,10 +147,8 @@ public:
      */
     template<typename T>
     Line ( T* imageIn, uint8_t* maskIn, int srcSpp, int width, T* transparent ) : width ( width ) {
-        if (sizeof(T) == 1) coeff = 255.; //cas uint8_t
-        else coeff = 1.;
-        samples = new float[3*width];
-        alpha = new float[width];
+        coeff = getCoeff ( sizeof ( T ) );
+        pixels = new float[4*width];
         mask = new uint8_t[width];
         store ( imageIn, maskIn, srcSpp, transparent );
     }
@@ -177,10 +168,8 @@ public:
      */
     template<typename T>
     Line ( T* imageIn, uint8_t* maskIn, int srcSpp, int width ) : width ( width ) {
-        if (sizeof(T) == 1) coeff = 255.; //cas uint8_t
-        else coeff = 1.;
-        samples = new float[3*width];
-        alpha = new float[width];
+        coeff = getCoeff ( sizeof ( T ) );
+        pixels = new float[4*width];
         mask = new uint8_t[width];
         store ( imageIn, maskIn, srcSpp );
     }
@@ -240,7 +229,7 @@ public:
     /** \~french
      * \brief Fusionne deux lignes par transparence (alpha blending)
      * \details La ligne courante est fusionnée avec une ligne par dessus, et le résultat est stocké dans la ligne courante.
-     * Rappelons que les valeurs de transparence ne sont pas prémultipliée sur les canaux (en entrée et en sortie).
+     * Les couleurs étant prémultipliées, le pixel résultant vaut dessus + dessous * ( 1 - alpha du dessus ), pour les couleurs comme pour l'alpha.
      * \image html merge_transparency.png
      * \param[in] above ligne du dessus, avec laquelle fusionner
      ** \~english
@@ -286,41 +275,88 @@ public:
      * \details Desallocate memory used by the Line object.
      */
     virtual ~Line() {
-        delete[] alpha;
-        delete[] samples;
+        delete[] pixels;
         delete[] mask;
     }
+
+private:
+
+    /**
+     * \~french \brief Valeur maximale d'un canal, selon la taille d'un canal en octets
+     * \~english \brief Sample's maximal value, according to sample size in bytes
+     */
+    static float getCoeff ( int samplesize ) {
+        if ( samplesize == 1 ) return 255.; //cas uint8_t
+        if ( samplesize == 2 ) return 65535.; //cas uint16_t
+        if ( samplesize != 4 ) LOGGER_ERROR ( "Sample size is unknown for the line" );
+        return 1.; //cas float
+    }
+
+    /**
+     * \~french \brief Stocke le pixel d'indice i en prémultipliant ses couleurs par l'alpha
+     * \~english \brief Store pixel at index i, premultiplying colors by alpha
+     */
+    inline void setPixel ( int i, float r, float g, float b, float a ) {
+        float* p = pixels + 4*i;
+        if ( a == 0. ) {
+            // Pas de couleur, même infinie ou NaN, sous un pixel transparent
+            memset ( p, 0, 4*sizeof ( float ) );
+            return;
+        }
+        p[0] = r * a;
+        p[1] = g * a;
+        p[2] = b * a;
+        p[3] = a;
+    }
 };
 
 /* -------------------------------------FONCTIONS TEMPLATE ---------------------------------------- */
 
 template<typename T>
 void Line::write ( T* buffer, int outChannels ) {
+    // Sans alpha en sortie, on compose sur du noir : ce sont les couleurs prémultipliées.
+    // Avec alpha, on revient à des couleurs non associées. Les calculs pouvant donner 199.99998 pour 200, on arrondit alors pour les entiers.
+    const float round = ( coeff == 1. ) ? 0. : 0.5;
+    const float* p = pixels;
     switch ( outChannels ) {
     case 1:
-        for ( int i = 0; i < width; i++ ) {
-            buffer[i] = ( T ) ( 0.2125*samples[3*i] + 0.7154*samples[3*i+1] + 0.0721*samples[3*i+2] ) * alpha[i];
+        for ( int i = 0; i < width; i++, p += 4 ) {
+            buffer[i] = ( T ) ( 0.2125*p[0] + 0.7154*p[1] + 0.0721*p[2] );
         }
         break;
     case 2:
-        for ( int i = 0; i < width; i++ ) {
-            buffer[2*i] = ( T ) ( 0.2125*samples[3*i] + 0.7154*samples[3*i+1] + 0.0721*samples[3*i+2] );
-            buffer[2*i+1] = ( T ) ( alpha[i]*coeff );
+        for ( int i = 0; i < width; i++, p += 4 ) {
+            if ( p[3] == 0. ) {
+                buffer[2*i] = buffer[2*i+1] = 0;
+                continue;
+            }
+            buffer[2*i] = ( T ) ( ( 0.2125*p[0] + 0.7154*p[1] + 0.0721*p[2] ) / p[3] + round );
+            buffer[2*i+1] = ( T ) ( p[3]*coeff + round );
         }
         break;
     case 3:
-        for ( int i = 0; i < width; i++ ) {
-            buffer[3*i] =  ( T ) (alpha[i] * samples[3*i]);
-            buffer[3*i+1] = ( T ) (alpha[i] * samples[3*i+1]);
-            buffer[3*i+2] = ( T ) (alpha[i] * samples[3*i+2]);
+        for ( int i = 0; i < width; i++, p += 4 ) {
+            buffer[3*i] = ( T ) p[0];
+            buffer[3*i+1] = ( T ) p[1];
+            buffer[3*i+2] = ( T ) p[2];
         }
         break;
     case 4:
-        for ( int i = 0; i < width; i++ ) {
-            buffer[4*i] = ( T ) (samples[3*i]);
-            buffer[4*i+1] = ( T ) (samples[3*i+1]);
-            buffer[4*i+2] = ( T ) (samples[3*i+2]);
-            buffer[4*i+3] = ( T ) ( alpha[i]*coeff );
+        for ( int i = 0; i < width; i++, p += 4 ) {
+            if ( p[3] == 1. ) {
+                buffer[4*i] = ( T ) p[0];
+                buffer[4*i+1] = ( T ) p[1];
+                buffer[4*i+2] = ( T ) p[2];
+                buffer[4*i+3] = ( T ) coeff;
+            } else if ( p[3] == 0. ) {
+                memset ( buffer + 4*i, 0, 4*sizeof ( T ) );
+            } else {
+                float inv = 1. / p[3];
+                buffer[4*i] = ( T ) ( p[0]*inv + round );
+                buffer[4*i+1] = ( T ) ( p[1]*inv + round );
+                buffer[4*i+2] = ( T ) ( p[2]*inv + round );
+                buffer[4*i+3] = ( T ) ( p[3]*coeff + round );
+            }
         }
         break;
     }
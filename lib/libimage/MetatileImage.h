@@ -0,0 +1,211 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file MetatileImage.h
+ ** \~french
+ * \brief Définition des classes Metatile et MetatileImage
+ * \details
+ * \li Metatile : image source lue une seule fois en mémoire, pour en extraire plusieurs tuiles
+ * \li MetatileImage : tuile extraite d'une Metatile
+ ** \~english
+ * \brief Define classes Metatile and MetatileImage
+ * \details
+ * \li Metatile : source image read once in memory, to extract several tiles
+ * \li MetatileImage : tile extracted from a Metatile
+ */
+
+#ifndef METATILE_IMAGE_H
+#define METATILE_IMAGE_H
+
+#include "Image.h"
+#include <cstring>
+#include <stdint.h>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Image lue entièrement en mémoire, pour être découpée en tuiles
+ * \details Une image calculée (réechantillonnée, reprojetée, fusionnée...) ne peut être lue que ligne par ligne. Pour en extraire plusieurs tuiles sans la recalculer, elle est lue une seule fois dans un buffer, au premier accès et dans le type demandé.
+ *
+ * L'objet est propriétaire de l'image source. Il doit être détruit après les tuiles MetatileImage qui en sont extraites.
+ * \~english
+ * \brief Image fully read in memory, to be cut into tiles
+ * \details A computed image (resampled, reprojected, merged...) can only be read line by line. To extract several tiles without computing it again, it is read once in a buffer, at first access and with requested type.
+ *
+ * The object owns the source image. It have to be destroyed after MetatileImage tiles extracted from it.
+ */
+class Metatile {
+
+private:
+    /**
+     * \~french \brief Image source, lue une seule fois
+     * \~english \brief Source image, read once
+     */
+    Image* image;
+
+    /**
+     * \~french \brief Contenu de l'image source, selon le type demandé (NULL si pas encore lu)
+     * \~english \brief Source image content, according to requested type (NULL if not read yet)
+     */
+    uint8_t* data8;
+    uint16_t* data16;
+    float* data32;
+
+    template<typename T>
+    T* read ( T*& data ) {
+        if ( data == NULL ) {
+            int lineSize = image->getWidth() * image->getChannels();
+            data = new T[ ( size_t ) lineSize * image->getHeight()];
+            for ( int l = 0; l < image->getHeight(); l++ ) {
+                if ( image->getline ( data + ( size_t ) l * lineSize, l ) == 0 ) {
+                    memset ( data + ( size_t ) l * lineSize, 0, lineSize * sizeof ( T ) );
+                }
+            }
+        }
+        return data;
+    }
+
+    const uint8_t* getData ( uint8_t* ) { return read ( data8 ); }
+    const uint16_t* getData ( uint16_t* ) { return read ( data16 ); }
+    const float* getData ( float* ) { return read ( data32 ); }
+
+public:
+    /**
+     * \~french
+     * \brief Crée une métatuile à partir de l'image la couvrant
+     * \param[in] image image source, dont la métatuile devient propriétaire
+     * \~english
+     * \brief Create a metatile from the image covering it
+     * \param[in] image source image, owned by the metatile
+     */
+    Metatile ( Image* image ) : image ( image ), data8 ( NULL ), data16 ( NULL ), data32 ( NULL ) {}
+
+    Image* getImage() {
+        return image;
+    }
+
+    /**
+     * \~french
+     * \brief Copie une partie de ligne de l'image source
+     * \param[out] buffer Tableau contenant au moins width*channels valeurs
+     * \param[in] line indice de la ligne dans l'image source
+     * \param[in] offset indice du premier pixel copié
+     * \param[in] width nombre de pixels copiés
+     * \~english
+     * \brief Copy part of source image's line
+     * \param[out] buffer Array with at least width*channels values
+     * \param[in] line line's indice in source image
+     * \param[in] offset first copied pixel's indice
+     * \param[in] width copied pixels' number
+     */
+    template<typename T>
+    int getline ( T* buffer, int line, int offset, int width ) {
+        const T* data = getData ( buffer );
+        int channels = image->getChannels();
+        memcpy ( buffer, data + ( ( size_t ) line * image->getWidth() + offset ) * channels, width * channels * sizeof ( T ) );
+        return width * channels;
+    }
+
+    ~Metatile() {
+        delete image;
+        delete[] data8;
+        delete[] data16;
+        delete[] data32;
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Tuile extraite d'une métatuile
+ * \details La tuile n'est pas propriétaire de la métatuile, partagée avec les autres tuiles extraites.
+ * \~english
+ * \brief Tile extracted from a metatile
+ * \details Tile doesn't own the metatile, shared with other extracted tiles.
+ */
+class MetatileImage : public Image {
+
+private:
+    Metatile* metatile;
+    /**
+     * \~french \brief Position du coin supérieur gauche de la tuile dans la métatuile, en pixel
+     * \~english \brief Tile's upper left corner position in the metatile, in pixel
+     */
+    int offsetX, offsetY;
+
+public:
+    /**
+     * \~french
+     * \brief Crée une tuile à partir de sa position dans la métatuile
+     * \param[in] metatile métatuile source
+     * \param[in] offsetX colonne du pixel supérieur gauche de la tuile dans la métatuile
+     * \param[in] offsetY ligne du pixel supérieur gauche de la tuile dans la métatuile
+     * \param[in] width largeur de la tuile en pixel
+     * \param[in] height hauteur de la tuile en pixel
+     * \param[in] bbox emprise de la tuile
+     * \~english
+     * \brief Create a tile from its position in the metatile
+     * \param[in] metatile source metatile
+     * \param[in] offsetX column of tile's upper left pixel in the metatile
+     * \param[in] offsetY row of tile's upper left pixel in the metatile
+     * \param[in] width tile's width in pixel
+     * \param[in] height tile's height in pixel
+     * \param[in] bbox tile's bounding box
+     */
+    MetatileImage ( Metatile* metatile, int offsetX, int offsetY, int width, int height, BoundingBox<double> bbox ) :
+        Image ( width, height, metatile->getImage()->getChannels(), bbox ),
+        metatile ( metatile ), offsetX ( offsetX ), offsetY ( offsetY ) {
+        setCRS ( metatile->getImage()->getCRS() );
+    }
+
+    int getline ( uint8_t* buffer, int line ) {
+        return metatile->getline ( buffer, offsetY + line, offsetX, width );
+    }
+
+    int getline ( uint16_t* buffer, int line ) {
+        return metatile->getline ( buffer, offsetY + line, offsetX, width );
+    }
+
+    int getline ( float* buffer, int line ) {
+        return metatile->getline ( buffer, offsetY + line, offsetX, width );
+    }
+
+    virtual ~MetatileImage() {}
+};
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file Metrics.cpp
+ ** \~french
+ * \brief Implémentation des classes Metrics et MetricsHistogram
+ ** \~english
+ * \brief Implement classes Metrics and MetricsHistogram
+ */
+
+#include "Metrics.h"
+#include "Logger.h"
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ----------------------------------------- HISTOGRAMME ------------------------------------------ */
+
+MetricsHistogram::MetricsHistogram() : sum ( 0 ) {
+    memset ( buckets, 0, sizeof ( buckets ) );
+}
+
+uint64_t MetricsHistogram::getBucketBound ( int index ) {
+    if ( index == 0 ) return 16;
+    if ( index >= METRICS_BUCKETS - 1 ) return 0;
+    int octave = 4 + ( index - 1 ) / 2;
+    int half = ( index - 1 ) % 2;
+    return ( ( uint64_t ) 1 << octave ) + ( half + 1 ) * ( ( uint64_t ) 1 << ( octave - 1 ) );
+}
+
+void MetricsHistogram::print ( std::string& out, const std::string& name, const std::string& labels ) {
+    char line[64];
+    std::string prefix = labels.empty() ? "" : labels + ",";
+
+    // Le total est la somme des intervalles lus, pour rester cohérent même si des durées sont enregistrées pendant l'export
+    uint64_t cumulative = 0;
+    for ( int i = 0; i < METRICS_BUCKETS; i++ ) {
+        cumulative += __atomic_load_n ( &buckets[i], __ATOMIC_RELAXED );
+        uint64_t bound = getBucketBound ( i );
+        if ( bound == 0 ) {
+            snprintf ( line, sizeof ( line ), "+Inf\"} %lu\n", ( unsigned long ) cumulative );
+        } else {
+            snprintf ( line, sizeof ( line ), "%.6f\"} %lu\n", bound / 1000000., ( unsigned long ) cumulative );
+        }
+        out += name + "_bucket{" + prefix + "le=\"" + line;
+    }
+
+    snprintf ( line, sizeof ( line ), " %.6f\n", __atomic_load_n ( &sum, __ATOMIC_RELAXED ) / 1000000. );
+    out += name + "_sum{" + labels + "}" + line;
+    snprintf ( line, sizeof ( line ), " %lu\n", ( unsigned long ) cumulative );
+    out += name + "_count{" + labels + "}" + line;
+}
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ------------------------------------------ REGISTRE -------------------------------------------- */
+
+namespace {
+
+enum eMetricKind {
+    HISTOGRAM,
+    COUNTER,
+    GAUGE
+};
+
+/**
+ * Case du registre : le nom et les étiquettes ne changent plus une fois la case publiée
+ */
+struct MetricsEntry {
+    std::string name;
+    std::string labels;
+    eMetricKind kind;
+    MetricsHistogram* histogram;
+    MetricsCounter* counter;
+    MetricsGauge* gauge;
+};
+
+MetricsEntry* table[METRICS_TABLE_SIZE];
+
+/** Le registre plein n'est signalé qu'une fois */
+int fullReported = 0;
+
+uint64_t hashKey ( const char* name, const std::string& labels ) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for ( const char* c = name; *c; c++ ) {
+        h ^= ( uint8_t ) *c;
+        h *= 1099511628211ULL;
+    }
+    h ^= 0xff;
+    h *= 1099511628211ULL;
+    for ( size_t i = 0; i < labels.size(); i++ ) {
+        h ^= ( uint8_t ) labels[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+MetricsEntry* findOrCreate ( const char* name, const std::string& labels, eMetricKind kind ) {
+    uint64_t h = hashKey ( name, labels );
+    MetricsEntry* created = NULL;
+
+    for ( int i = 0; i < METRICS_TABLE_SIZE; i++ ) {
+        MetricsEntry** slot = &table[ ( h + i ) & ( METRICS_TABLE_SIZE - 1 )];
+        MetricsEntry* entry = __atomic_load_n ( slot, __ATOMIC_ACQUIRE );
+
+        if ( entry == NULL ) {
+            if ( created == NULL ) {
+                created = new MetricsEntry();
+                created->name = name;
+                created->labels = labels;
+                created->kind = kind;
+                created->histogram = ( kind == HISTOGRAM ) ? new MetricsHistogram() : NULL;
+                created->counter = ( kind == COUNTER ) ? new MetricsCounter() : NULL;
+                created->gauge = ( kind == GAUGE ) ? new MetricsGauge() : NULL;
+            }
+            if ( __atomic_compare_exchange_n ( slot, &entry, created, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+                return created;
+            }
+            // Un autre thread a rempli la case entre temps : entry contient maintenant sa métrique
+        }
+
+        if ( entry->kind == kind && entry->name == name && entry->labels == labels ) {
+            if ( created ) {
+                delete created->histogram;
+                delete created->counter;
+                delete created->gauge;
+                delete created;
+            }
+            return entry;
+        }
+    }
+
+    if ( created ) {
+        delete created->histogram;
+        delete created->counter;
+        delete created->gauge;
+        delete created;
+    }
+
+    if ( __atomic_exchange_n ( &fullReported, 1, __ATOMIC_RELAXED ) == 0 ) {
+        LOGGER_WARN ( "Metrics registry is full (" << METRICS_TABLE_SIZE << " metrics), new ones are ignored" );
+    }
+    return NULL;
+}
+
+bool compareEntries ( MetricsEntry* a, MetricsEntry* b ) {
+    if ( a->name != b->name ) return a->name < b->name;
+    return a->labels < b->labels;
+}
+
+}
+
+std::string Metrics::label ( const char* name, const std::string& value ) {
+    std::string l = name;
+    l += "=\"";
+    for ( size_t i = 0; i < value.size(); i++ ) {
+        if ( value[i] == '\\' ) l += "\\\\";
+        else if ( value[i] == '"' ) l += "\\\"";
+        else if ( value[i] == '\n' ) l += "\\n";
+        else l += value[i];
+    }
+    l += "\"";
+    return l;
+}
+
+MetricsHistogram* Metrics::getHistogram ( const char* name, const std::string& labels ) {
+    MetricsEntry* entry = findOrCreate ( name, labels, HISTOGRAM );
+    return entry ? entry->histogram : NULL;
+}
+
+MetricsCounter* Metrics::getCounter ( const char* name, const std::string& labels ) {
+    MetricsEntry* entry = findOrCreate ( name, labels, COUNTER );
+    return entry ? entry->counter : NULL;
+}
+
+MetricsGauge* Metrics::getGauge ( const char* name, const std::string& labels ) {
+    MetricsEntry* entry = findOrCreate ( name, labels, GAUGE );
+    return entry ? entry->gauge : NULL;
+}
+
+MetricsHistogram* Metrics::getStage ( const char* stage, const char* key, const std::string& value ) {
+    return getHistogram ( "rok4_stage_duration_seconds", label ( "stage", stage ) + "," + label ( key, value ) );
+}
+
+std::string Metrics::toPrometheus() {
+
+    std::vector<MetricsEntry*> entries;
+    for ( int i = 0; i < METRICS_TABLE_SIZE; i++ ) {
+        MetricsEntry* entry = __atomic_load_n ( &table[i], __ATOMIC_ACQUIRE );
+        if ( entry ) entries.push_back ( entry );
+    }
+
+    // Les échantillons d'une même métrique doivent se suivre
+    std::sort ( entries.begin(), entries.end(), compareEntries );
+
+    std::string out;
+    std::string currentName;
+    char value[32];
+
+    for ( unsigned int i = 0; i < entries.size(); i++ ) {
+        MetricsEntry* entry = entries.at ( i );
+
+        if ( entry->name != currentName ) {
+            currentName = entry->name;
+            out += "# TYPE " + currentName + ( entry->kind == HISTOGRAM ? " histogram\n" : ( entry->kind == GAUGE ? " gauge\n" : " counter\n" ) );
+        }
+
+        if ( entry->kind == HISTOGRAM ) {
+            entry->histogram->print ( out, entry->name, entry->labels );
+        } else if ( entry->kind == GAUGE ) {
+            snprintf ( value, sizeof ( value ), " %ld\n", ( long ) entry->gauge->get() );
+            out += entry->name + "{" + entry->labels + "}" + value;
+        } else {
+            snprintf ( value, sizeof ( value ), " %lu\n", ( unsigned long ) entry->counter->get() );
+            out += entry->name + "{" + entry->labels + "}" + value;
+        }
+    }
+
+    return out;
+}
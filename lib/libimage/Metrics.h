@@ -0,0 +1,307 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file Metrics.h
+ ** \~french
+ * \brief Définition des classes Metrics, MetricsHistogram, MetricsCounter et MetricsTimer
+ ** \~english
+ * \brief Define classes Metrics, MetricsHistogram, MetricsCounter and MetricsTimer
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <string>
+#include <time.h>
+
+/**
+ * \~french \brief Nombre d'intervalles d'un histogramme
+ * \details Le premier contient les durées inférieures à 16 µs, puis chaque octave est coupée en deux jusqu'à 2^26 µs (environ 67 s), le dernier contient le reste
+ * \~english \brief Histogram buckets number
+ */
+#define METRICS_BUCKETS 46
+
+/**
+ * \~french \brief Nombre maximal de métriques (couple nom / étiquettes) enregistrées
+ * \~english \brief Max registered metrics number (name / labels pair)
+ */
+#define METRICS_TABLE_SIZE 4096
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Histogramme de durées, à intervalles logarithmiques
+ * \details Les intervalles ont une précision relative constante (deux intervalles par octave), à la manière des histogrammes HDR. L'enregistrement d'une durée se fait sans verrou (incréments atomiques).
+ * \~english
+ * \brief Durations histogram, with logarithmic buckets
+ * \details Buckets have a constant relative precision (two buckets per octave), like HDR histograms. A duration is recorded without lock (atomic increments).
+ */
+class MetricsHistogram {
+
+private:
+
+    /**
+     * \~french \brief Nombre de durées dans chaque intervalle
+     * \~english \brief Durations count in each bucket
+     */
+    uint64_t buckets[METRICS_BUCKETS];
+
+    /**
+     * \~french \brief Somme des durées, en microsecondes
+     * \~english \brief Durations sum, in microseconds
+     */
+    uint64_t sum;
+
+public:
+
+    MetricsHistogram();
+
+    /**
+     * \~french \brief Indice de l'intervalle contenant une durée
+     * \param[in] microseconds durée en microsecondes
+     * \~english \brief Index of the bucket containing a duration
+     * \param[in] microseconds duration in microseconds
+     */
+    static int getBucketIndex ( uint64_t microseconds ) {
+        if ( microseconds < 16 ) return 0;
+        int msb = 63 - __builtin_clzll ( microseconds );
+        int index = 1 + ( msb - 4 ) * 2 + ( ( microseconds >> ( msb - 1 ) ) & 1 );
+        return ( index < METRICS_BUCKETS - 1 ) ? index : METRICS_BUCKETS - 1;
+    }
+
+    /**
+     * \~french \brief Borne supérieure (exclue) d'un intervalle, en microsecondes
+     * \details 0 pour le dernier intervalle, qui n'est pas borné
+     * \~english \brief Bucket upper (excluded) bound, in microseconds
+     * \details 0 for the last bucket, without bound
+     */
+    static uint64_t getBucketBound ( int index );
+
+    /**
+     * \~french \brief Enregistre une durée
+     * \param[in] microseconds durée en microsecondes
+     * \~english \brief Record a duration
+     * \param[in] microseconds duration in microseconds
+     */
+    void record ( uint64_t microseconds ) {
+        __atomic_add_fetch ( &buckets[getBucketIndex ( microseconds )], 1, __ATOMIC_RELAXED );
+        __atomic_add_fetch ( &sum, microseconds, __ATOMIC_RELAXED );
+    }
+
+    /**
+     * \~french \brief Écrit l'histogramme au format texte Prometheus
+     * \param[in,out] out flux de sortie
+     * \param[in] name nom de la métrique
+     * \param[in] labels étiquettes déjà formatées, séparées par des virgules
+     * \~english \brief Write histogram with Prometheus text format
+     * \param[in,out] out output stream
+     * \param[in] name metric's name
+     * \param[in] labels formatted labels, separated with commas
+     */
+    void print ( std::string& out, const std::string& name, const std::string& labels );
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Compteur, incrémenté sans verrou
+ * \~english
+ * \brief Counter, incremented without lock
+ */
+class MetricsCounter {
+
+private:
+
+    uint64_t value;
+
+public:
+
+    MetricsCounter() : value ( 0 ) {}
+
+    void add ( uint64_t v = 1 ) {
+        __atomic_add_fetch ( &value, v, __ATOMIC_RELAXED );
+    }
+
+    uint64_t get() {
+        return __atomic_load_n ( &value, __ATOMIC_RELAXED );
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Jauge, valeur instantanée pouvant diminuer
+ * \~english
+ * \brief Gauge, instant value which can decrease
+ */
+class MetricsGauge {
+
+private:
+
+    int64_t value;
+
+public:
+
+    MetricsGauge() : value ( 0 ) {}
+
+    void set ( int64_t v ) {
+        __atomic_store_n ( &value, v, __ATOMIC_RELAXED );
+    }
+
+    void add ( int64_t v ) {
+        __atomic_add_fetch ( &value, v, __ATOMIC_RELAXED );
+    }
+
+    int64_t get() {
+        return __atomic_load_n ( &value, __ATOMIC_RELAXED );
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Registre des métriques du serveur
+ * \details Cette classe est prévue pour être utilisée sans instance
+ *
+ * Une métrique est identifiée par son nom et ses étiquettes (couche, service, opération, stockage, étape de traitement...). Elle est créée au premier accès et n'est jamais supprimée. Le registre est une table de hachage à adressage ouvert, dont les cases sont remplies par échange atomique : ni la recherche ni l'ajout ne prennent de verrou, et le coût d'une mesure reste de l'ordre de la centaine de nanosecondes.
+ *
+ * Les métriques sont exposées au format texte de Prometheus.
+ * \~english
+ * \brief Server's metrics registry
+ * \details This class is intended to be used without instance
+ *
+ * A metric is identified by its name and its labels (layer, service, operation, storage, processing stage...). It is created on first access and never removed. Registry is an open addressing hash table, whose slots are filled with atomic exchange : neither lookup nor insertion take a lock, and a measure cost stays around a hundred nanoseconds.
+ *
+ * Metrics are exposed with the Prometheus text format.
+ */
+class Metrics {
+
+public:
+
+    /**
+     * \~french \brief Instant courant, en microsecondes (horloge monotone)
+     * \~english \brief Current time, in microseconds (monotonic clock)
+     */
+    static uint64_t now() {
+        timespec ts;
+        clock_gettime ( CLOCK_MONOTONIC, &ts );
+        return ( uint64_t ) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    /**
+     * \~french \brief Formate une étiquette, en échappant la valeur
+     * \~english \brief Format a label, escaping the value
+     */
+    static std::string label ( const char* name, const std::string& value );
+
+    /**
+     * \~french \brief Histogramme d'un nom et d'étiquettes, créé si besoin
+     * \return NULL si le registre est plein
+     * \~english \brief Histogram for a name and labels, created if needed
+     * \return NULL if registry is full
+     */
+    static MetricsHistogram* getHistogram ( const char* name, const std::string& labels );
+
+    /**
+     * \~french \brief Compteur d'un nom et d'étiquettes, créé si besoin
+     * \return NULL si le registre est plein
+     * \~english \brief Counter for a name and labels, created if needed
+     * \return NULL if registry is full
+     */
+    static MetricsCounter* getCounter ( const char* name, const std::string& labels );
+
+    /**
+     * \~french \brief Jauge d'un nom et d'étiquettes, créée si besoin
+     * \return NULL si le registre est plein
+     * \~english \brief Gauge for a name and labels, created if needed
+     * \return NULL if registry is full
+     */
+    static MetricsGauge* getGauge ( const char* name, const std::string& labels );
+
+    /**
+     * \~french \brief Histogramme de durée d'une étape de traitement
+     * \details Métrique rok4_stage_duration_seconds, avec les étiquettes stage et key
+     * \param[in] stage étape (storage_read, tile_read, decode, level_tile, getmap_build, encode, send)
+     * \param[in] key nom de la seconde étiquette (backend, format, layer...)
+     * \param[in] value valeur de la seconde étiquette
+     * \~english \brief Processing stage duration histogram
+     * \details Metric rok4_stage_duration_seconds, with labels stage and key
+     */
+    static MetricsHistogram* getStage ( const char* stage, const char* key, const std::string& value );
+
+    /**
+     * \~french \brief Ajoute à un compteur
+     * \~english \brief Add to a counter
+     */
+    static void count ( const char* name, const std::string& labels, uint64_t value = 1 ) {
+        MetricsCounter* c = getCounter ( name, labels );
+        if ( c ) c->add ( value );
+    }
+
+    /**
+     * \~french \brief Toutes les métriques au format texte Prometheus (version 0.0.4)
+     * \~english \brief All metrics with Prometheus text format (version 0.0.4)
+     */
+    static std::string toPrometheus();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Mesure la durée de vie de l'objet et l'enregistre dans un histogramme
+ * \~english
+ * \brief Measure the object's lifetime and record it in an histogram
+ */
+class MetricsTimer {
+
+private:
+
+    MetricsHistogram* histogram;
+    uint64_t start;
+
+public:
+
+    MetricsTimer ( MetricsHistogram* h ) : histogram ( h ), start ( Metrics::now() ) {}
+
+    ~MetricsTimer() {
+        if ( histogram ) histogram->record ( Metrics::now() - start );
+    }
+};
+
+#endif
@@ -524,61 +524,55 @@ boolean Rok4Image::memorizeRawTiles ( int tilesLine )
         return false;
     }
 
-    // On va maintenant décompresser chaque tuile pour la stocker au format brut dans le buffer memorizedTiles
+    // On va maintenant décompresser chaque tuile directement dans le buffer memorizedTiles, au format brut
     for (size_t i = 0; i < tileWidthwise; i++) {
         // Pour avoir l'offset de lecture de la tuile à décoder dans le buffer total, on utilise l'offset dans la dalle, 
         // en déduisant l'offset de la première tuile (qui correspond au 0 de notre buffer total)
-        RawDataSource* encDS = new RawDataSource ( enc_data + tilesOffset[firstTileIndex + i] - firstTileOffset, tilesByteCounts[firstTileIndex + i]);
+        const uint8_t* tile_data = enc_data + tilesOffset[firstTileIndex + i] - firstTileOffset;
+        size_t tile_size = tilesByteCounts[firstTileIndex + i];
+        uint8_t* raw_tile = memorizedTiles + i * rawTileSize;
 
-        DataSource* decDS;
         size_t tmpSize;
 
         if ( compression == Compression::NONE ) {
-            decDS = encDS;
+            tmpSize = std::min ( tile_size, ( size_t ) rawTileSize );
+            memcpy ( raw_tile, tile_data, tmpSize );
         }
         else if ( compression == Compression::JPEG ) {
-            decDS = new DataSourceDecoder<JpegDecoder> ( encDS );
+            tmpSize = JpegDecoder::decode ( tile_data, tile_size, raw_tile, rawTileSize );
         }
         else if ( compression == Compression::LZW ) {
-            decDS = new DataSourceDecoder<LzwDecoder> ( encDS );
+            tmpSize = LzwDecoder::decode ( tile_data, tile_size, raw_tile, rawTileSize );
         }
         else if ( compression == Compression::PACKBITS ) {
-            decDS = new DataSourceDecoder<PackBitsDecoder> ( encDS );
+            tmpSize = PackBitsDecoder::decode ( tile_data, tile_size, raw_tile, rawTileSize );
         }
         else if ( compression == Compression::DEFLATE || compression == Compression::PNG ) {
             /* Avec une telle compression dans l'en-tête TIFF, on peut avoir :
              *       - des tuiles compressée en deflate (format "officiel")
              *       - des tuiles en PNG, format propre à ROK4
              * Pour distinguer les deux cas (pas le même décodeur), on va tester la présence d'un en-tête PNG */
-            const uint8_t* header = encDS->getData(tmpSize);
-            if (header == NULL) {
-                LOGGER_ERROR ( "Cannot read header to discrimine PNG and DEFLATE" );
-                return false;
-            }
-            if (memcmp(PNG_HEADER, header, 8)) {
-                decDS = new DataSourceDecoder<DeflateDecoder> ( encDS );
-            } else {
+            if (tile_size >= 8 && ! memcmp(PNG_HEADER, tile_data, 8)) {
                 compression = Compression::PNG;
-                decDS = new DataSourceDecoder<PngDecoder> ( encDS );
+                tmpSize = PngDecoder::decode ( tile_data, tile_size, raw_tile, rawTileSize );
+            } else {
+                tmpSize = DeflateDecoder::decode ( tile_data, tile_size, raw_tile, rawTileSize );
             }
         }
         else {
             LOGGER_ERROR ( "Unhandled compression : " << compression );
+            delete totalDS;
             return false;
         }
 
-        const uint8_t* dec_data = decDS->getData(tmpSize);
-        
-        if (! dec_data || tmpSize == 0) {
+        if (tmpSize == 0) {
             LOGGER_ERROR("Unable to decompress tile " << i << " of tiles- line " << tilesLine);
+            delete totalDS;
             return false;
         } else if (tmpSize != rawTileSize) {
             LOGGER_WARN("Raw tile size should have been " << rawTileSize << ", and not " << tmpSize);
+            memset ( raw_tile + tmpSize, 0, rawTileSize - tmpSize );
         }
-
-        memcpy(memorizedTiles + i * rawTileSize, dec_data, rawTileSize );
-
-        delete decDS;
     }
 
     delete totalDS;
@@ -818,7 +812,7 @@ int Rok4Image::writeImage ( Image* pIn, bool crop )
     return 0;
 }
 
-int Rok4Image::writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory )
+int Rok4Image::writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory, bool compress )
 {
 
     if (! isVector) {
@@ -844,7 +838,7 @@ int Rok4Image::writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory
             sprintf (pbfpath, "%s/%d/%d.pbf", rootDirectory, ulTileCol + col, ulTileRow + row);
             LOGGER_DEBUG("Slabization of pbf tile " << pbfpath);
 
-            if (! writeTile(row * tileWidthwise + col, pbfpath)) {
+            if (! writeTile(row * tileWidthwise + col, pbfpath, compress)) {
                 LOGGER_ERROR("Error writting PBF tile " << pbfpath);
                 return -1;
             }
@@ -865,6 +859,50 @@ int Rok4Image::writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory
     return 0;
 }
 
+int Rok4Image::writePbfTiles ( const std::vector<const uint8_t*>& tiles, const std::vector<size_t>& sizes, bool compress )
+{
+
+    if (! isVector) {
+        LOGGER_ERROR("Write PBF tiles in a slab is possible only for vector ROK4 slabs");
+        return -1;
+    }
+
+    if ( tiles.size() != ( size_t ) tilesNumber || sizes.size() != ( size_t ) tilesNumber ) {
+        LOGGER_ERROR("PBF tiles number (" << tiles.size() << ") have to be the slab's one (" << tilesNumber << ") for " << name);
+        return -1;
+    }
+
+    if (! writeHeader()) {
+        LOGGER_ERROR("Cannot write the ROK4 images header for " << name);
+        return -1;
+    }
+
+    if (! prepareBuffers()) {
+        LOGGER_ERROR("Cannot initialize buffers for " << name);
+        return -1;
+    }
+
+    for ( int i = 0; i < tilesNumber; i++ ) {
+        // Une tuile absente est précisée dans la dalle avec une taille nulle
+        if (! writePbfTile(i, tiles[i], tiles[i] ? sizes[i] : 0, compress)) {
+            LOGGER_ERROR("Error writting PBF tile " << i << " in " << name);
+            return -1;
+        }
+    }
+
+    if (! writeFinal()) {
+        LOGGER_ERROR("Cannot close the ROK4 images (write index) for " << name);
+        return -1;
+    }
+
+    if (! cleanBuffers()) {
+        LOGGER_ERROR("Cannot clean buffers for " << name);
+        return -1;
+    }
+
+    return 0;
+}
+
 bool Rok4Image::writeHeader()
 {
     if (! context->openToWrite(name)) {
@@ -971,8 +1009,8 @@ bool Rok4Image::writeHeader()
             * ( ( uint16_t* ) ( p ) ) = TIFFTAG_YCBCRSUBSAMPLING;
             * ( ( uint16_t* ) ( p + 2 ) ) = TIFF_SHORT;
             * ( ( uint32_t* ) ( p + 4 ) ) = 2;
-            * ( ( uint16_t* ) ( p + 8 ) ) = 2;
-            * ( ( uint16_t* ) ( p + 10 ) )  = 2;
+            * ( ( uint16_t* ) ( p + 8 ) ) = jpegOptions.getHorizontalSampling();
+            * ( ( uint16_t* ) ( p + 10 ) )  = jpegOptions.getVerticalSampling();
             p += 12;
         }
     }
@@ -1001,7 +1039,6 @@ bool Rok4Image::prepareBuffers()
         int quality = 0;
         if ( compression == Compression::PNG) quality = 5;
         if ( compression == Compression::DEFLATE ) quality = 6;
-        if ( compression == Compression::JPEG ) quality = 75;
 
         // variables initalizations
 
@@ -1038,7 +1075,7 @@ bool Rok4Image::prepareBuffers()
             cinfo.in_color_space = JCS_RGB;
 
             jpeg_set_defaults ( &cinfo );
-            jpeg_set_quality ( &cinfo, quality, true );
+            jpegOptions.apply ( &cinfo );
         }
     }
 
@@ -1134,14 +1171,8 @@ bool Rok4Image::writeTile( int tileInd, uint8_t* data, bool crop )
 }
 
 // Vector write tile in a slab
-bool Rok4Image::writeTile( int tileInd, char* pbfpath )
+bool Rok4Image::writeTile( int tileInd, char* pbfpath, bool compress )
 {
-    
-    if ( tileInd > tilesNumber || tileInd < 0 ) {
-        LOGGER_ERROR ( "Unvalid tile's indice to write (" << tileInd << "). Have to be between 0 and " << tilesNumber-1 );
-        return false;
-    }
-
     std::ifstream::pos_type data_size;
     std::vector<char> data;
     std::ifstream ifs(pbfpath, std::ios::binary|std::ios::ate);
@@ -1173,6 +1204,47 @@ bool Rok4Image::writeTile( int tileInd, char* pbfpath )
         if ( data_size == 0 ) return false;
     }
 
+    return writePbfTile ( tileInd, ( uint8_t* ) data.data(), data_size, compress );
+}
+
+bool Rok4Image::writePbfTile( int tileInd, const uint8_t* data, size_t data_size, bool compress )
+{
+    if ( tileInd > tilesNumber || tileInd < 0 ) {
+        LOGGER_ERROR ( "Unvalid tile's indice to write (" << tileInd << "). Have to be between 0 and " << tilesNumber-1 );
+        return false;
+    }
+
+    std::vector<char> gzdata;
+
+    if ( data_size > 0 && compress && ! ( data_size >= 2 && data[0] == 0x1f && data[1] == 0x8b ) ) {
+        // Compression gzip, pour que le serveur puisse transmettre la tuile telle quelle
+        z_stream zstream;
+        zstream.zalloc = Z_NULL;
+        zstream.zfree = Z_NULL;
+        zstream.opaque = Z_NULL;
+        if ( deflateInit2 ( &zstream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+            LOGGER_ERROR("Cannot initialize gzip compression for PBF tile " << tileInd);
+            return false;
+        }
+
+        gzdata.resize ( deflateBound ( &zstream, data_size ) );
+        zstream.next_in = ( Bytef* ) data;
+        zstream.avail_in = data_size;
+        zstream.next_out = ( Bytef* ) gzdata.data();
+        zstream.avail_out = gzdata.size();
+        int zret = deflate ( &zstream, Z_FINISH );
+        gzdata.resize ( gzdata.size() - zstream.avail_out );
+        deflateEnd ( &zstream );
+
+        if ( zret != Z_STREAM_END ) {
+            LOGGER_ERROR("Cannot gzip compress PBF tile " << tileInd);
+            return false;
+        }
+
+        data = ( uint8_t* ) gzdata.data();
+        data_size = gzdata.size();
+    }
+
     if ( tilesNumber == 1 ) {
 
         uint8_t* uint32tab = new uint8_t[sizeof( uint32_t )];
@@ -1185,7 +1257,7 @@ bool Rok4Image::writeTile( int tileInd, char* pbfpath )
     tilesOffset[tileInd] = position;
     tilesByteCounts[tileInd] = data_size;
 
-    boolean ret = context->write((uint8_t*) data.data(), position, data_size, std::string(name));
+    boolean ret = context->write(( uint8_t* ) data, position, data_size, std::string(name));
 
     if (! ret) {
         LOGGER_ERROR("Impossible to write the tile " << tileInd);
@@ -1314,18 +1386,21 @@ size_t Rok4Image::computeJpegTile ( uint8_t *buffer, uint8_t *data, bool crop )
     cinfo.dest->free_in_buffer = 2*rawTileSize;
     jpeg_start_compress ( &cinfo, true );
 
-    int numLine = 0;
-
-    while ( numLine < tileHeight ) {
+    // Toute la tuile est en mémoire : les lignes sont données ensemble à la libjpeg
+    JSAMPROW lines[tileHeight];
+    for ( int numLine = 0; numLine < tileHeight; numLine++ ) {
         if ( numLine % JPEG_BLOC_SIZE == 0 && crop ) {
             int l = std::min ( JPEG_BLOC_SIZE,tileHeight-numLine );
             emptyWhiteBlock ( data + numLine*rawTileLineSize, l );
         }
+        lines[numLine] = data + numLine*rawTileLineSize;
+    }
 
-        uint8_t* line = data + numLine*rawTileLineSize;
-
-        if ( jpeg_write_scanlines ( &cinfo, &line, 1 ) != 1 ) return 0;
-        numLine++;
+    int numLine = 0;
+    while ( numLine < tileHeight ) {
+        int written = jpeg_write_scanlines ( &cinfo, lines + numLine, tileHeight - numLine );
+        if ( written < 1 ) return 0;
+        numLine += written;
     }
 
     jpeg_finish_compress ( &cinfo );
@@ -58,6 +58,7 @@
 #include "Format.h"
 #include "zlib.h"
 #include <jpeglib.h>
+#include "JpegOptions.h"
 #include "FileImage.h"
 #include "Context.h"
 #include "StoreDataSource.h"
@@ -409,6 +410,12 @@ private:
      * \~english \brief Error structure used by libjpeg
      */
     struct jpeg_error_mgr jerr;
+    /**
+     * \~french \brief Paramètres de la compression JPEG
+     * \details Pour la compression JPEG uniquement
+     * \~english \brief JPEG compression parameters
+     */
+    JpegOptions jpegOptions;
 
 
     /**
@@ -431,13 +438,31 @@ private:
      * \param[in] tileInd indice de la tuile à écrire
      * \param[in] data données brutes (sans compression) à écrire
      * \param[in] pbfpath chemin vers la tuile PBF à écrire dans la dalle
+     * \param[in] compress la tuile doit-elle être compressée en gzip (si elle ne l'est pas déjà)
      * \return VRAI en cas de succès, FAUX sinon
      * \~english \brief Write a vector ROK4 slab's tile
      * \param[in] tileInd tile indice
      * \param[in] pbfpath path to PBF tile to write in the slab
+     * \param[in] compress have the tile to be gzip compressed (if not already)
      * \return TRUE if success, FALSE otherwise
      */
-    bool writeTile( int tileInd, char* pbfpath ) ;
+    bool writeTile( int tileInd, char* pbfpath, bool compress = false ) ;
+
+    /**
+     * \~french \brief Écrit une tuile PBF en mémoire dans la dalle ROK4 vecteur
+     * \param[in] tileInd indice de la tuile à écrire
+     * \param[in] data données de la tuile PBF
+     * \param[in] size taille de la tuile PBF, 0 pour une tuile absente
+     * \param[in] compress la tuile doit-elle être compressée en gzip (si elle ne l'est pas déjà)
+     * \return VRAI en cas de succès, FAUX sinon
+     * \~english \brief Write a PBF tile in memory in the vector ROK4 slab
+     * \param[in] tileInd tile indice
+     * \param[in] data PBF tile's data
+     * \param[in] size PBF tile's size, 0 for a missing tile
+     * \param[in] compress have the tile to be gzip compressed (if not already)
+     * \return TRUE if success, FALSE otherwise
+     */
+    bool writePbfTile( int tileInd, const uint8_t* data, size_t size, bool compress = false ) ;
 
 protected:
     /** \~french
@@ -639,6 +664,18 @@ public:
 
     /**************************** Pour l'écriture ****************************/
 
+    /**
+     * \~french
+     * \brief Définit les paramètres de la compression JPEG
+     * \details À appeler avant l'écriture de l'image. Par défaut, ce sont ceux de la libjpeg (qualité 75, 4:2:0).
+     * \~english
+     * \brief Set JPEG compression parameters
+     * \details To call before image writing. Default ones are libjpeg's ones (quality 75, 4:2:0).
+     */
+    void setJpegOptions ( const JpegOptions& options ) {
+        jpegOptions = options;
+    }
+
     /**
      * \~french
      * \brief Ecrit une image ROK4, à partir d'une image source
@@ -667,9 +704,28 @@ public:
      * \param[in] ulTileCol Indice de colonne de la tuile supérieure gauche
      * \param[in] ulTileRow Indice de ligne de la tuile supérieure gauche
      * \param[in] rootDirectory Dossier contenant les tuiles PBF
+     * \param[in] compress Les tuiles doivent-elles être stockées compressées en gzip
      * \return 0 en cas de succes, -1 sinon
      */
-    int writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory );
+    int writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory, bool compress = false );
+
+    /**
+     * \~french
+     * \brief Ecrit une dalle ROK4 vecteur, à partir des tuiles PBF déjà en mémoire
+     * \details Les tuiles sont fournies ligne par ligne, depuis celle en haut à gauche. Une tuile absente a un pointeur nul.
+     * \param[in] tiles Données des tuiles PBF, autant que de tuiles dans la dalle
+     * \param[in] sizes Tailles des tuiles PBF
+     * \param[in] compress Les tuiles doivent-elles être stockées compressées en gzip
+     * \return 0 en cas de succes, -1 sinon
+     * \~english
+     * \brief Write a vector ROK4 slab, from PBF tiles already in memory
+     * \details Tiles are provided row by row, from the upper left one. A missing tile has a null pointer.
+     * \param[in] tiles PBF tiles' data, as many as slab's tiles
+     * \param[in] sizes PBF tiles' sizes
+     * \param[in] compress Have tiles to be gzip compressed
+     * \return 0 if success, -1 otherwise
+     */
+    int writePbfTiles ( const std::vector<const uint8_t*>& tiles, const std::vector<size_t>& sizes, bool compress = false );
 
     /**
      * \~french
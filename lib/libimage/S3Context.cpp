@@ -52,8 +52,10 @@
 #include <curl/curl.h>
 #include <sys/stat.h>
 #include <openssl/hmac.h>
+#include <openssl/sha.h>
 #include <time.h>
 #include "CurlPool.h"
+#include "Metrics.h"
 
 S3Context::S3Context (std::string b) : Context(), ssl_no_verify(false), bucket_name(b) {
 
@@ -93,6 +95,23 @@ S3Context::S3Context (std::string b) : Context(), ssl_no_verify(false), bucket_n
     if(getenv( ROK4_SSL_NO_VERIFY ) != NULL){
         ssl_no_verify=true;
     }
+
+    char* sv = getenv (ROK4_S3_SIGNATURE_VERSION);
+    signature_v4 = (sv != NULL && strcmp(sv, "4") == 0);
+
+    char* r = getenv (ROK4_S3_REGION);
+    if (r == NULL) {
+        region.assign("us-east-1");
+    } else {
+        region.assign(r);
+    }
+
+    host_header = "Host: " + host;
+
+    mergingGap = DEFAULT_OBJECT_MERGING_GAP;
+
+    pthread_mutex_init(&signing_mutex, NULL);
+    signing_time = 0;
 }
 
 
@@ -169,7 +188,185 @@ static const char mon_name[][4] = {
     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
 };
 
+/**
+ * \~french \brief Empreinte SHA256 du contenu vide, en hexadécimal
+ * \~english \brief SHA256 hash of empty payload, hexadecimal
+ */
+static const std::string empty_payload_hash = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+
+/**
+ * \~french \brief Conversion d'un buffer binaire en chaîne hexadécimale (minuscules)
+ * \~english \brief Convert a binary buffer to hexadecimal string (lower case)
+ */
+static std::string toHex(const unsigned char* bytes, int length) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(2 * length);
+    for (int i = 0; i < length; i++) {
+        hex += digits[bytes[i] >> 4];
+        hex += digits[bytes[i] & 0x0f];
+    }
+    return hex;
+}
+
+/**
+ * \~french \brief Empreinte SHA256 hexadécimale d'un buffer
+ * \~english \brief SHA256 hexadecimal hash of a buffer
+ */
+static std::string sha256Hex(const unsigned char* data, size_t length) {
+    unsigned char md[SHA256_DIGEST_LENGTH];
+    SHA256(data, length, md);
+    return toHex(md, SHA256_DIGEST_LENGTH);
+}
+
+/**
+ * \~french \brief HMAC-SHA256, résultat binaire
+ * \~english \brief HMAC-SHA256, binary result
+ */
+static std::string hmacSha256(const std::string& key, const std::string& data) {
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int mdLength = 0;
+    HMAC(EVP_sha256(), key.c_str(), key.length(), (const unsigned char*) data.c_str(), data.length(), md, &mdLength);
+    return std::string((char*) md, mdLength);
+}
+
+/**
+ * \~french \brief Encodage URI d'un chemin, tel qu'attendu par la requête canonique V4 (les '/' sont conservés)
+ * \~english \brief URI encoding of a path, as expected by V4 canonical request ('/' are kept)
+ */
+static std::string uriEncodePath(const std::string& path) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string encoded;
+    encoded.reserve(path.length());
+    for (size_t i = 0; i < path.length(); i++) {
+        unsigned char c = path[i];
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '_' || c == '.' || c == '~' || c == '/') {
+            encoded += c;
+        } else {
+            encoded += '%';
+            encoded += digits[c >> 4];
+            encoded += digits[c & 0x0f];
+        }
+    }
+    return encoded;
+}
+
+std::string S3Context::getSigningKeyV4(std::string day) {
+    if (day != signing_key_day) {
+        std::string kDate = hmacSha256("AWS4" + secret_key, day);
+        std::string kRegion = hmacSha256(kDate, region);
+        std::string kService = hmacSha256(kRegion, "s3");
+        signing_key = hmacSha256(kService, "aws4_request");
+        signing_key_day = day;
+    }
+    return signing_key;
+}
+
+std::string S3Context::signV4(std::string verb, std::string resource, std::string range, std::string payload_hash, std::string amz_date) {
+
+    std::string day = amz_date.substr(0, 8);
+    std::string scope = day + "/" + region + "/s3/aws4_request";
+
+    std::string signedHeaders;
+    std::string canonicalHeaders = "host:" + host + "\n";
+    if (range != "") {
+        canonicalHeaders += "range:" + range + "\n";
+        signedHeaders = "host;range;x-amz-content-sha256;x-amz-date";
+    } else {
+        signedHeaders = "host;x-amz-content-sha256;x-amz-date";
+    }
+    canonicalHeaders += "x-amz-content-sha256:" + payload_hash + "\n";
+    canonicalHeaders += "x-amz-date:" + amz_date + "\n";
+
+    std::string canonicalRequest = verb + "\n" + uriEncodePath(resource) + "\n\n" + canonicalHeaders + "\n" + signedHeaders + "\n" + payload_hash;
+
+    std::string stringToSign = "AWS4-HMAC-SHA256\n" + amz_date + "\n" + scope + "\n" +
+        sha256Hex((const unsigned char*) canonicalRequest.c_str(), canonicalRequest.length());
+
+    std::string signature = hmacSha256(getSigningKeyV4(day), stringToSign);
+
+    return "AWS4-HMAC-SHA256 Credential=" + key + "/" + scope + ", SignedHeaders=" + signedHeaders +
+        ", Signature=" + toHex((const unsigned char*) signature.c_str(), signature.length());
+}
+
+std::string S3Context::getAuthorizationHeaderV4(std::string verb, std::string resource, std::string range, std::string payload_hash, std::string amz_date) {
+    pthread_mutex_lock(&signing_mutex);
+    std::string authorization = signV4(verb, resource, range, payload_hash, amz_date);
+    pthread_mutex_unlock(&signing_mutex);
+    return authorization;
+}
+
+void S3Context::getSigningMaterial(std::string verb, std::string resource, std::string payload_hash, std::string& date, std::string& authorization) {
+
+    time_t current;
+    time(&current);
+
+    pthread_mutex_lock(&signing_mutex);
+
+    if (current != signing_time) {
+        // Nouvelle seconde : on reformate la date et les signatures précédentes ne sont plus valables
+        struct tm ptm;
+        gmtime_r ( &current, &ptm );
+
+        char gmt_time[40];
+        if (signature_v4) {
+            strftime(gmt_time, 40, "%Y%m%dT%H%M%SZ", &ptm);
+        } else {
+            sprintf(
+                gmt_time, "%s, %d %s %d %.2d:%.2d:%.2d GMT",
+                wday_name[ptm.tm_wday], ptm.tm_mday, mon_name[ptm.tm_mon], 1900 + ptm.tm_year,
+                ptm.tm_hour, ptm.tm_min, ptm.tm_sec
+            );
+        }
+
+        signing_time = current;
+        signing_date.assign(gmt_time);
+        signatures.clear();
+    }
+
+    date = signing_date;
+
+    std::string cacheKey = verb + resource + payload_hash;
+    std::map<std::string, std::string>::iterator it = signatures.find(cacheKey);
+    if (it != signatures.end()) {
+        authorization = it->second;
+    } else {
+        if (signature_v4) {
+            authorization = signV4(verb, resource, "", payload_hash, signing_date);
+        } else {
+            std::string stringToSign = verb + "\n\napplication/octet-stream\n" + signing_date + "\n" + resource;
+            authorization = "AWS " + key + ":" + getAuthorizationHeader(stringToSign);
+        }
+        signatures.insert(std::pair<std::string, std::string>(cacheKey, authorization));
+    }
+
+    pthread_mutex_unlock(&signing_mutex);
+}
+
+struct curl_slist* S3Context::appendSigningHeaders(struct curl_slist* list, std::string verb, std::string resource, std::string payload_hash) {
+
+    std::string date, authorization;
+    getSigningMaterial(verb, resource, payload_hash, date, authorization);
+
+    if (signature_v4) {
+        std::string d = "x-amz-date: " + date;
+        list = curl_slist_append(list, d.c_str());
+        std::string h = "x-amz-content-sha256: " + payload_hash;
+        list = curl_slist_append(list, h.c_str());
+    } else {
+        std::string d = "Date: " + date;
+        list = curl_slist_append(list, d.c_str());
+    }
+
+    std::string auth = "Authorization: " + authorization;
+    list = curl_slist_append(list, auth.c_str());
+
+    return list;
+}
+
 int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
+    MetricsTimer timer ( Metrics::getStage ( "storage_read", "backend", getTypeStr() ) );
 
     LOGGER_DEBUG("S3 read : " << size << " bytes (from the " << offset << " one) in the object " << name);
 
@@ -188,22 +385,7 @@ int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
 
     std::string fullUrl = url + "/" + bucket_name + "/" + name;
 
-    time_t current;
-
-    time(&current);
-    struct tm * ptm = gmtime ( &current );
-
-    static char gmt_time[40];
-    sprintf(
-        gmt_time, "%s, %d %s %d %.2d:%.2d:%.2d GMT",
-        wday_name[ptm->tm_wday], ptm->tm_mday, mon_name[ptm->tm_mon], 1900 + ptm->tm_year,
-        ptm->tm_hour, ptm->tm_min, ptm->tm_sec
-    );
-
-    std::string content_type = "application/octet-stream";
     std::string resource = "/" + bucket_name + "/" + name;
-    std::string stringToSign = "GET\n\n" + content_type + "\n" + std::string(gmt_time) + "\n" + resource;
-    std::string signature = getAuthorizationHeader(stringToSign);
 
     // Constitution du header
 
@@ -211,25 +393,11 @@ int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
     sprintf(range, "Range: bytes=%d-%d", offset, lastBytes);
     list = curl_slist_append(list, range);
 
-    char hd_host[256];
-    sprintf(hd_host, "Host: %s", host.c_str());
-    list = curl_slist_append(list, hd_host);
-
-    char d[100];
-    sprintf(d, "Date: %s", gmt_time);
-    list = curl_slist_append(list, d);
-
-    char ct[50];
-    sprintf(ct, "Content-Type: %s", content_type.c_str());
-    list = curl_slist_append(list, ct);
-
-    std::string ex = "Expect:";
-    list = curl_slist_append(list, ex.c_str());
+    list = curl_slist_append(list, host_header.c_str());
+    list = curl_slist_append(list, "Content-Type: application/octet-stream");
+    list = curl_slist_append(list, "Expect:");
 
-    char auth[512];
-    sprintf(auth, "Authorization: AWS %s:%s", key.c_str(), signature.c_str());
-
-    list = curl_slist_append(list, auth);
+    list = appendSigningHeaders(list, "GET", resource, empty_payload_hash);
 
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
     curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
@@ -245,7 +413,7 @@ int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("S3 READ END (" << size << ") " << pthread_self());
     
     curl_slist_free_all(list);
-    //delete[] gmt_time;
+    CurlPool::countRequest(curl);
 
     if( CURLE_OK != res) {
         LOGGER_ERROR("Cannot read data from S3 : " << size << " bytes (from the " << offset << " one) in the object " << name);
@@ -267,6 +435,68 @@ int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
     return chunk.size;
 }
 
+bool S3Context::getSize(std::string name, long& size, bool& exists) {
+    LOGGER_DEBUG("S3 size of the object " << name);
+
+    CURLcode res;
+    struct curl_slist *list = NULL;
+
+    CURL* curl = CurlPool::getCurlEnv();
+
+    std::string fullUrl = url + "/" + bucket_name + "/" + name;
+
+    std::string resource = "/" + bucket_name + "/" + name;
+
+    list = curl_slist_append(list, host_header.c_str());
+    list = appendSigningHeaders(list, "HEAD", resource, empty_payload_hash);
+
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+    curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    if(ssl_no_verify){
+      curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    }
+
+    res = curl_easy_perform(curl);
+
+    curl_slist_free_all(list);
+    CurlPool::countRequest(curl);
+
+    if( CURLE_OK != res) {
+        LOGGER_ERROR("Cannot get size of the S3 object " << name);
+        LOGGER_ERROR(curl_easy_strerror(res));
+        return false;
+    }
+
+    long http_code = 0;
+    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+    if (http_code == 404) {
+        exists = false;
+        return true;
+    }
+    if (http_code < 200 || http_code > 299) {
+        LOGGER_ERROR("Cannot get size of the S3 object " << name);
+        LOGGER_ERROR("Response HTTP code : " << http_code);
+        return false;
+    }
+
+#if LIBCURL_VERSION_NUM >= 0x073700
+    curl_off_t length = -1;
+    curl_easy_getinfo (curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+#else
+    double length = -1;
+    curl_easy_getinfo (curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &length);
+#endif
+    if (length < 0) {
+        LOGGER_ERROR("No content length for the S3 object " << name);
+        return false;
+    }
+
+    exists = true;
+    size = (long) length;
+    return true;
+}
+
 bool S3Context::write(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("S3 write : " << size << " bytes (from the " << offset << " one) in the writing buffer " << name);
 
@@ -359,47 +589,25 @@ bool S3Context::closeToWrite(std::string name) {
 
     std::string fullUrl = url + "/" + bucket_name + "/" + name;
 
-    time_t current;
-
-    time(&current);
-    struct tm * ptm = gmtime ( &current );
-
-    static char gmt_time[40];
-    sprintf(
-        gmt_time, "%s, %d %s %d %.2d:%.2d:%.2d GMT",
-        wday_name[ptm->tm_wday], ptm->tm_mday, mon_name[ptm->tm_mon], 1900 + ptm->tm_year,
-        ptm->tm_hour, ptm->tm_min, ptm->tm_sec
-    );
-
-    std::string content_type = "application/octet-stream";
     std::string resource = "/" + bucket_name + "/" + name;
-    std::string stringToSign = "PUT\n\n" + content_type + "\n" + std::string(gmt_time) + "\n" + resource;
-    std::string signature = getAuthorizationHeader(stringToSign);
-
-    // Constitution du header
 
-    char host[256];
-    sprintf(host, "Host: %s", url.c_str());
-    list = curl_slist_append(list, host);
+    std::string payload_hash = empty_payload_hash;
+    if (signature_v4) {
+        payload_hash = sha256Hex((const unsigned char*) &((*(it1->second))[0]), it1->second->size());
+    }
 
-    char d[100];
-    sprintf(d, "Date: %s", gmt_time);
-    list = curl_slist_append(list, d);
+    // Constitution du header
 
-    char ct[50];
-    sprintf(ct, "Content-Type: %s", content_type.c_str());
-    list = curl_slist_append(list, ct);
+    list = curl_slist_append(list, host_header.c_str());
+    list = curl_slist_append(list, "Content-Type: application/octet-stream");
 
     char cl[50];
     sprintf(cl, "Content-Length: %d",(int)it1->second->size());
     list = curl_slist_append(list, cl);
 
-    std::string ex = "Expect:";
-    list = curl_slist_append(list, ex.c_str());
+    list = curl_slist_append(list, "Expect:");
 
-    char auth[512];
-    sprintf(auth, "Authorization: AWS %s:%s", key.c_str(), signature.c_str());
-    list = curl_slist_append(list, auth);
+    list = appendSigningHeaders(list, "PUT", resource, payload_hash);
 
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
     curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
@@ -412,7 +620,7 @@ bool S3Context::closeToWrite(std::string name) {
 
     res = curl_easy_perform(curl);
     curl_slist_free_all(list);
-
+    CurlPool::countRequest(curl);
 
     if( CURLE_OK != res) {
         LOGGER_ERROR ( "Unable to flush " << it1->second->size() << " bytes in the object " << name );
@@ -51,6 +51,8 @@
 #define S3_CONTEXT_H
 
 #include <curl/curl.h>
+#include <pthread.h>
+#include <time.h>
 #include "Logger.h"
 #include "Context.h"
 #include "LibcurlStruct.h"
@@ -58,6 +60,8 @@
 #define ROK4_S3_URL "ROK4_S3_URL"
 #define ROK4_S3_KEY "ROK4_S3_KEY"
 #define ROK4_S3_SECRETKEY "ROK4_S3_SECRETKEY"
+#define ROK4_S3_SIGNATURE_VERSION "ROK4_S3_SIGNATURE_VERSION"
+#define ROK4_S3_REGION "ROK4_S3_REGION"
 
 #ifndef ROK4_SSL_NO_VERIFY
 #define ROK4_SSL_NO_VERIFY "ROK4_SSL_NO_VERIFY"
@@ -106,12 +110,114 @@ private:
      */
     bool ssl_no_verify;
 
+    /**
+     * \~french \brief Signe-t-on les requêtes avec la version 4 de l'algorithme AWS (sinon version 2)
+     * \~english \brief Do we sign requests with AWS algorithm version 4 (version 2 otherwise)
+     */
+    bool signature_v4;
+
+    /**
+     * \~french \brief Région S3, utilisée par la signature V4
+     * \~english \brief S3 region, used by V4 signature
+     */
+    std::string region;
+
+    /**
+     * \~french \brief Jour (AAAAMMJJ) pour lequel la clé de signature V4 en cache est valable
+     * \~english \brief Day (YYYYMMDD) for which the cached V4 signing key is valid
+     */
+    std::string signing_key_day;
+
+    /**
+     * \~french \brief Clé de signature V4 dérivée (binaire), pour le jour #signing_key_day, la région et le service S3
+     * \details Elle résulte d'une chaîne de 4 HMAC-SHA256 qu'il est inutile de refaire pour chaque requête
+     * \~english \brief Derived V4 signing key (binary), for the day #signing_key_day, the region and the S3 service
+     * \details It results from a chain of 4 HMAC-SHA256 we don't need to compute for each request
+     */
+    std::string signing_key;
+
+    /**
+     * \~french \brief En-tête HTTP Host, constant pour le contexte
+     * \~english \brief HTTP header Host, constant for the context
+     */
+    std::string host_header;
+
+    /**
+     * \~french \brief Protège le cache de signature
+     * \~english \brief Protect signature cache
+     */
+    pthread_mutex_t signing_mutex;
+
+    /**
+     * \~french \brief Seconde pour laquelle la date et les signatures en cache sont valables
+     * \~english \brief Second for which cached date and signatures are valid
+     */
+    time_t signing_time;
+
+    /**
+     * \~french \brief Date correspondant à #signing_time
+     * \details Au format HTTP pour la signature V2, au format ISO 8601 basique (AAAAMMJJTHHMMSSZ) pour la signature V4
+     * \~english \brief Date matching #signing_time
+     * \details HTTP format for V2 signature, basic ISO 8601 format (YYYYMMDDTHHMMSSZ) for V4 signature
+     */
+    std::string signing_date;
+
+    /**
+     * \~french \brief En-têtes d'autorisation calculés pendant la seconde #signing_time
+     * \details La clé est la méthode HTTP, la ressource et l'empreinte du contenu. Un même objet (une dalle) étant souvent lu plusieurs fois de suite (en-tête puis tuile), on évite de refaire le calcul HMAC.
+     * \~english \brief Authorization headers computed during the second #signing_time
+     * \details Key is HTTP method, resource and payload hash. The same object (a slab) is often read several times in a row (header then tile), we avoid to compute HMAC again
+     */
+    std::map<std::string, std::string> signatures;
+
     /**
      * \~french \brief Calcule la signature à partir du header
      * \~english \brief Calculate header's signature
      */
     std::string getAuthorizationHeader(std::string toSign);
 
+    /**
+     * \~french \brief Retourne la clé de signature V4 pour le jour fourni
+     * \details La clé n'est recalculée que lors d'un changement de jour. Le verrou #signing_mutex doit être détenu.
+     * \param[in] day Jour, au format AAAAMMJJ
+     * \~english \brief Return V4 signing key for the provided day
+     * \details Key is computed again only when day changes. Lock #signing_mutex have to be owned.
+     * \param[in] day Day, YYYYMMDD format
+     */
+    std::string getSigningKeyV4(std::string day);
+
+    /**
+     * \~french \brief Calcule la valeur de l'en-tête d'autorisation V4
+     * \details Le verrou #signing_mutex doit être détenu.
+     * \~english \brief Compute V4 authorization header value
+     * \details Lock #signing_mutex have to be owned.
+     */
+    std::string signV4(std::string verb, std::string resource, std::string range, std::string payload_hash, std::string amz_date);
+
+    /**
+     * \~french \brief Fournit la date et l'autorisation pour une requête
+     * \details La date n'est formatée qu'une fois par seconde, et les autorisations sont mises en cache pour la seconde courante
+     * \param[in] verb Méthode HTTP
+     * \param[in] resource Ressource demandée (bucket et objet)
+     * \param[in] payload_hash Empreinte SHA256 (hexadécimale) du contenu envoyé, utilisée par la signature V4
+     * \param[out] date Date à mettre dans l'en-tête (Date en V2, x-amz-date en V4)
+     * \param[out] authorization Valeur de l'en-tête Authorization
+     * \~english \brief Provide date and authorization for a request
+     * \details Date is formatted once per second, and authorizations are cached for the current second
+     * \param[in] verb HTTP method
+     * \param[in] resource Asked resource (bucket and object)
+     * \param[in] payload_hash SHA256 hash (hexadecimal) of sent content, used by V4 signature
+     * \param[out] date Date to put in header (Date with V2, x-amz-date with V4)
+     * \param[out] authorization Authorization header value
+     */
+    void getSigningMaterial(std::string verb, std::string resource, std::string payload_hash, std::string& date, std::string& authorization);
+
+    /**
+     * \~french \brief Ajoute à la liste les en-têtes de date et d'autorisation d'une requête
+     * \~english \brief Add to the list date and authorization headers of a request
+     */
+    struct curl_slist* appendSigningHeaders(struct curl_slist* list, std::string verb, std::string resource, std::string payload_hash);
+
 public:
 
     /**
@@ -124,6 +230,8 @@ public:
      * <TR><TD>key</TD><TD>ROK4_S3_KEY</TD><TD>KEY</TD>
      * <TR><TD>secret_key</TD><TD>ROK4_S3_SECRETKEY</TD><TD>SECRETKEY</TD>
      * <TR><TD>ssl_no_verify</TD><TD>ROK4_SSL_NO_VERIFY</TD><TD>false</TD>
+     * <TR><TD>signature_v4</TD><TD>ROK4_S3_SIGNATURE_VERSION (2 ou 4)</TD><TD>false (version 2)</TD>
+     * <TR><TD>region</TD><TD>ROK4_S3_REGION</TD><TD>us-east-1</TD>
      * </TABLE>
      * \param[in] b Bucket avec lequel on veut communiquer
      * \~english
@@ -135,6 +243,8 @@ public:
      * <TR><TD>key</TD><TD>ROK4_S3_KEY</TD><TD>KEY</TD>
      * <TR><TD>secret_key</TD><TD>ROK4_S3_SECRETKEY</TD><TD>SECRETKEY</TD>
      * <TR><TD>ssl_no_verify</TD><TD>ROK4_SSL_NO_VERIFY</TD><TD>false</TD>
+     * <TR><TD>signature_v4</TD><TD>ROK4_S3_SIGNATURE_VERSION (2 or 4)</TD><TD>false (version 2)</TD>
+     * <TR><TD>region</TD><TD>ROK4_S3_REGION</TD><TD>us-east-1</TD>
      * </TABLE>
      * \param[in] b Bucket to use
      */
@@ -161,6 +271,14 @@ public:
      */
     int read(uint8_t* data, int offset, int size, std::string name);
 
+    /**
+     * \~french
+     * \brief Récupère la taille d'un objet S3
+     * \~english
+     * \brief Get the size of an S3 object
+     */
+    bool getSize(std::string name, long& size, bool& exists);
+
     /**
      * \~french
      * \brief Écrit de la donnée dans un objet S3
@@ -186,12 +304,33 @@ public:
 
     std::string getPath(std::string racine,int x,int y,int pathDepth);
 
+    /**
+     * \~french
+     * \brief Calcule l'en-tête d'autorisation AWS signature V4
+     * \details La clé dérivée du jour est mise en cache. Seuls les en-têtes host, x-amz-content-sha256, x-amz-date (et range s'il est fourni) sont signés.
+     * \param[in] verb Méthode HTTP
+     * \param[in] resource Chemin de la ressource (/bucket/objet)
+     * \param[in] range Valeur de l'en-tête Range à signer, vide pour ne pas le signer
+     * \param[in] payload_hash Empreinte SHA256 hexadécimale du contenu
+     * \param[in] amz_date Date de la requête, au format AAAAMMJJTHHMMSSZ
+     * \~english
+     * \brief Compute AWS signature V4 authorization header
+     * \details Day derived key is cached. Only headers host, x-amz-content-sha256, x-amz-date (and range if provided) are signed.
+     * \param[in] verb HTTP method
+     * \param[in] resource Resource path (/bucket/object)
+     * \param[in] range Range header value to sign, empty not to sign it
+     * \param[in] payload_hash SHA256 hexadecimal hash of content
+     * \param[in] amz_date Request date, YYYYMMDDTHHMMSSZ format
+     */
+    std::string getAuthorizationHeaderV4(std::string verb, std::string resource, std::string range, std::string payload_hash, std::string amz_date);
+
     virtual void print() {
         LOGGER_INFO ( "------ S3 Context -------" );
         LOGGER_INFO ( "\t- URL = " << url );
         LOGGER_INFO ( "\t- Key = " << key );
         LOGGER_INFO ( "\t- Secrete Key = " << secret_key );
         LOGGER_INFO ( "\t- Bucket name = " << bucket_name );
+        LOGGER_INFO ( "\t- Signature = " << (signature_v4 ? "V4, region " + region : "V2") );
     }
 
     virtual std::string toString() {
@@ -223,6 +362,7 @@ public:
     
     virtual ~S3Context() {
         closeConnection();
+        pthread_mutex_destroy(&signing_mutex);
     }
 };
 
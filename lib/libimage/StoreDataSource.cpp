@@ -55,9 +55,7 @@
 #include <cstdio>
 #include <errno.h>
 #include "Rok4Image.h"
-
-// Taille maximum d'une tuile WMTS
-#define MAX_TILE_SIZE 1048576
+#include "Metrics.h"
 
 StoreDataSource::StoreDataSource (std::string n, const uint32_t o, const uint32_t s, std::string type, Context* c, std::string encoding ) :
     name ( n ), posoff(o), possize(s), maxsize(0), headerIndexSize(0), type (type), encoding( encoding ), context(c)
@@ -77,6 +75,53 @@ StoreDataSource::StoreDataSource (std::string n, const uint32_t po, const uint32
     alreadyTried = false;
 }
 
+bool StoreDataSource::readHeaderIndex ( Context* c, std::string& name, uint8_t* indexheader, const uint32_t hisize ) {
+
+    int realSize = c->read(indexheader, 0, hisize, name);
+
+    if ( realSize < 0) {
+        LOGGER_ERROR ( "Erreur lors de la lecture du header et de l'index dans l'objet/fichier " << name );
+        return false;
+    }
+
+    if ( realSize < ROK4_IMAGE_HEADER_SIZE ) {
+
+        // Dans le cas d'un header de type objet lien, on verifie d'abord que la signature concernée est bien presente dans le header de l'objet
+        if ( strncmp((char*) indexheader, ROK4_SYMLINK_SIGNATURE, ROK4_SYMLINK_SIGNATURE_SIZE) != 0 ) {
+            LOGGER_ERROR ( "Erreur lors de la lecture du header, l'objet " << name << " ne correspond pas à un objet lien " );
+            return false;
+        }
+
+        // On est dans le cas d'un objet symbolique
+        std::string originalName (name);
+        char tmpName[realSize-ROK4_SYMLINK_SIGNATURE_SIZE+1];
+        memcpy((uint8_t*) tmpName, indexheader+ROK4_SYMLINK_SIGNATURE_SIZE,realSize-ROK4_SYMLINK_SIGNATURE_SIZE);
+        tmpName[realSize-ROK4_SYMLINK_SIGNATURE_SIZE] = '\0';
+        name = std::string (tmpName);
+
+        LOGGER_DEBUG ( "Dalle symbolique détectée : " << originalName << " référence une autre dalle symbolique " << name );
+
+        realSize = c->read(indexheader, 0, hisize, name);
+
+        if ( realSize < 0) {
+            LOGGER_ERROR ( "Erreur lors de la lecture du header et de l'index dans l'objet/fichier " << name );
+            return false;
+        }
+        if ( realSize < ROK4_IMAGE_HEADER_SIZE ) {
+            LOGGER_ERROR ( "Erreur lors de la lecture : une dalle symbolique " << originalName << " référence une autre dalle symbolique " << name );
+            return false;
+        }
+    }
+
+    // Un index tronqué laisserait des positions et tailles de tuiles non lues
+    if ( realSize < ( int ) hisize ) {
+        LOGGER_ERROR ( "En-tête et index incomplets (" << realSize << " octets sur " << hisize << ") dans l'objet/fichier " << name );
+        return false;
+    }
+
+    return true;
+}
+
 /*
  * Fonction retournant les données de la tuile
  * Le fichier/objet ne doit etre lu qu une seule fois
@@ -90,6 +135,9 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
 
     alreadyTried = true;
 
+    // Durée de lecture d'une tuile, index compris
+    MetricsTimer timer ( Metrics::getStage ( "tile_read", "backend", context->getTypeStr() ) );
+
     // il se peut que le contexte ne soit pas connecté, auquel cas on sort directement sans donnée
     if (! context->isConnected()) {
         data = NULL;
@@ -108,49 +156,15 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
         }
         tile_size = tileSize;
         size = tileSize;
+        Metrics::count ( "rok4_tile_read_bytes_total", Metrics::label ( "backend", context->getTypeStr() ), size );
     } else {
 
         uint8_t* indexheader = new uint8_t[headerIndexSize];
-        int realSize = context->read(indexheader, 0, headerIndexSize, name);
-
-        if ( realSize < 0) {
-            LOGGER_ERROR ( "Erreur lors de la lecture du header et de l'index dans l'objet/fichier " << name );
+        if (! readHeaderIndex(context, name, indexheader, headerIndexSize)) {
             delete[] indexheader;
             return NULL;
         }
 
-        if ( realSize < ROK4_IMAGE_HEADER_SIZE ) {
-
-            // Dans le cas d'un header de type objet lien, on verifie d'abord que la signature concernée est bien presente dans le header de l'objet
-            if ( strncmp((char*) indexheader, ROK4_SYMLINK_SIGNATURE, ROK4_SYMLINK_SIGNATURE_SIZE) != 0 ) {
-                LOGGER_ERROR ( "Erreur lors de la lecture du header, l'objet " << name << " ne correspond pas à un objet lien " );
-                delete[] indexheader;
-                return NULL;
-            }
-
-            // On est dans le cas d'un objet symbolique
-            std::string originalName (name);
-            char tmpName[realSize-ROK4_SYMLINK_SIGNATURE_SIZE+1];
-            memcpy((uint8_t*) tmpName, indexheader+ROK4_SYMLINK_SIGNATURE_SIZE,realSize-ROK4_SYMLINK_SIGNATURE_SIZE);
-            tmpName[realSize-ROK4_SYMLINK_SIGNATURE_SIZE] = '\0';
-            name = std::string (tmpName);
-
-            LOGGER_DEBUG ( "Dalle symbolique détectée : " << originalName << " référence une autre dalle symbolique " << name );
-
-            int realSize = context->read(indexheader, 0, headerIndexSize, name);
-
-            if ( realSize < 0) {
-                LOGGER_ERROR ( "Erreur lors de la lecture du header et de l'index dans l'objet/fichier " << name );
-                delete[] indexheader;
-                return NULL;
-            }
-            if ( realSize < ROK4_IMAGE_HEADER_SIZE ) {
-                LOGGER_ERROR ( "Erreur lors de la lecture : une dalle symbolique " << originalName << " référence une autre dalle symbolique " << name );
-                delete[] indexheader;
-                return NULL;
-            }
-        }
-
         // On est dans le cas d'une dalle
         uint32_t tileOffset = *((uint32_t*) (indexheader + posoff ));
         uint32_t tileSize = *((uint32_t*) (indexheader + possize ));
@@ -185,6 +199,7 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
 
         tile_size = tileSize;
         size = tileSize;
+        Metrics::count ( "rok4_tile_read_bytes_total", Metrics::label ( "backend", context->getTypeStr() ), size );
     }
 
     return data;
@@ -57,6 +57,9 @@
 #include <stdlib.h>
 #include <string>
 
+// Taille maximum d'une tuile WMTS
+#define MAX_TILE_SIZE 1048576
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -214,6 +217,25 @@ public:
      */
     virtual const uint8_t* getData ( size_t &tile_size );
 
+    /** \~french
+     * \brief Lit l'en-tête et l'index des tuiles d'une dalle
+     * \details Une dalle symbolique (objet lien) est suivie : le nom est alors remplacé par celui de la dalle référencée.
+     * \param[in] c Contexte de stockage de la dalle
+     * \param[in,out] name Nom de la dalle, puis de la dalle effectivement lue
+     * \param[out] indexheader Buffer d'au moins hisize octets
+     * \param[in] hisize Taille de l'en-tête et de l'index
+     * \return Faux en cas d'erreur de lecture ou si l'en-tête et l'index sont incomplets
+     ** \~english
+     * \brief Read slab's header and tiles' index
+     * \details A symbolic slab (link object) is followed : the name is then replaced with the referenced slab's one.
+     * \param[in] c Slab's storage context
+     * \param[in,out] name Slab's name, then really read slab's name
+     * \param[out] indexheader Buffer, at least hisize bytes
+     * \param[in] hisize Header and index size
+     * \return False if a reading error occured or if header and index are incomplete
+     */
+    static bool readHeaderIndex ( Context* c, std::string& name, uint8_t* indexheader, const uint32_t hisize );
+
 
     /**
      * \~french \brief Supprime la donnée mémorisée (#data)
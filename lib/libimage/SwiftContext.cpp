@@ -52,6 +52,7 @@
 #include <curl/curl.h>
 #include <sys/stat.h>
 #include "CurlPool.h"
+#include "Metrics.h"
 #include <time.h>
 
 
@@ -93,6 +94,7 @@ SwiftContext::SwiftContext (std::string cont) : Context(), ssl_no_verify(false),
         ssl_no_verify=true;
     }
 
+    mergingGap = DEFAULT_OBJECT_MERGING_GAP;
 }
 
 bool SwiftContext::connection() {
@@ -287,6 +289,7 @@ bool SwiftContext::connection() {
 }
 
 int SwiftContext::read(uint8_t* data, int offset, int size, std::string name) {
+    MetricsTimer timer ( Metrics::getStage ( "storage_read", "backend", getTypeStr() ) );
 
     if (! connected) {
         LOGGER_ERROR("Impossible de lire via un contexte non connecté");
@@ -334,6 +337,7 @@ int SwiftContext::read(uint8_t* data, int offset, int size, std::string name) {
         LOGGER_DEBUG("SWIFT READ END (" << size << ") " << pthread_self());
         
         curl_slist_free_all(list);
+        CurlPool::countRequest(curl);
 
         if( CURLE_OK != res) {
             LOGGER_ERROR("Cannot read data from Swift : " << size << " bytes (from the " << offset << " one) in the object " << name);
@@ -375,6 +379,94 @@ int SwiftContext::read(uint8_t* data, int offset, int size, std::string name) {
     return -1;
 }
 
+bool SwiftContext::getSize(std::string name, long& size, bool& exists) {
+    if (! connected) {
+        LOGGER_ERROR("Impossible d'interroger un objet via un contexte non connecté");
+        return false;
+    }
+
+    LOGGER_DEBUG("Swift size of the object " << name);
+
+    int attempt = 1;
+    bool reconnection = false;
+    while (attempt <= attempts) {
+
+        CURLcode res;
+        struct curl_slist *list = NULL;
+
+        CURL* curl = CurlPool::getCurlEnv();
+
+        std::string fullUrl = public_url + "/" + container_name + "/" + name;
+
+        list = curl_slist_append(list, token.c_str());
+
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+        curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+        if(ssl_no_verify){
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        }
+
+        res = curl_easy_perform(curl);
+
+        curl_slist_free_all(list);
+        CurlPool::countRequest(curl);
+
+        if( CURLE_OK != res) {
+            LOGGER_ERROR("Cannot get size of the Swift object " << name);
+            LOGGER_ERROR(curl_easy_strerror(res));
+            return false;
+        }
+
+        long http_code = 0;
+        curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+        // Même reconnexion que pour une lecture, l'authentification pouvant avoir expiré
+        if ( ! reconnection && (http_code == 403 || http_code == 401 || http_code == 400) ) {
+            connected = false;
+            reconnection = true;
+            token = "";
+            use_token_from_file = false;
+            if (! connection()) {
+                LOGGER_ERROR("Reconnection attempt failed.");
+                return false;
+            }
+            continue;
+        }
+
+        if (http_code == 404) {
+            exists = false;
+            return true;
+        }
+
+        if (http_code < 200 || http_code > 299) {
+            LOGGER_ERROR ( "Try " << attempt << " failed" );
+            LOGGER_ERROR("Response HTTP code : " << http_code);
+            attempt++;
+            continue;
+        }
+
+#if LIBCURL_VERSION_NUM >= 0x073700
+        curl_off_t length = -1;
+        curl_easy_getinfo (curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+#else
+        double length = -1;
+        curl_easy_getinfo (curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &length);
+#endif
+        if (length < 0) {
+            LOGGER_ERROR("No content length for the Swift object " << name);
+            return false;
+        }
+
+        exists = true;
+        size = (long) length;
+        return true;
+    }
+
+    LOGGER_ERROR ( "Unable to get size of the Swift object " << name << " after " << attempts << " tries" );
+    return false;
+}
+
 bool SwiftContext::write(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("Swift write : " << size << " bytes (from the " << offset << " one) in the writing buffer " << name);
 
@@ -480,6 +572,7 @@ bool SwiftContext::closeToWrite(std::string name) {
 
         res = curl_easy_perform(curl);
         curl_slist_free_all(list);
+        CurlPool::countRequest(curl);
 
         if( CURLE_OK != res) {
             LOGGER_ERROR ( "Unable to flush " << it1->second->size() << " bytes in the Swift object " << name );
@@ -191,6 +191,14 @@ public:
      */
     int read(uint8_t* data, int offset, int size, std::string name);
 
+    /**
+     * \~french
+     * \brief Récupère la taille d'un objet Swift
+     * \~english
+     * \brief Get the size of a Swift object
+     */
+    bool getSize(std::string name, long& size, bool& exists);
+
     /**
      * \~french
      * \brief Écrit de la donnée dans un objet Swift
@@ -58,7 +58,39 @@ using namespace std;
 #include <cstdlib>
 #include <iostream>
 #include <string.h>
-#include <queue>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <limits>
+#include <cmath>
+
+/**
+ * \~french \brief Taille maximale par défaut, en octets, d'une bande d'image chargée en mémoire
+ * \~english \brief Default maximal size, in bytes, of an image band loaded in memory
+ */
+#define NODATA_BAND_MEMORY 67108864
+
+/**
+ * \~french \brief Composante sans plage frontière
+ * \~english \brief Component without boundary run
+ */
+#define NO_BOUNDARY 0xFFFFFFFF
+
+/**
+ * \~french \brief Valeur d'un canal comparée à la couleur cible
+ * \details Les flottants sont tronqués à l'entier, comme l'a toujours fait la comparaison de la couleur cible
+ * \~english \brief Sample value compared to the target color
+ * \details Floats are truncated to integer, as target color comparison always did
+ */
+template<typename T>
+inline T targetComparable ( T v ) {
+    return v;
+}
+
+template<>
+inline float targetComparable<float> ( float v ) {
+    return std::trunc ( v );
+}
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -78,7 +110,13 @@ using namespace std;
  *
  * Pour identifier les pixels de nodata, on peut utiliser l'option "touche les bords" (#touchEdges) ou non en plus de la valeur cible.
  *
- * On dit qu'un pixel "touche le bord" dès lors que l'on peut relier le pixel au bord en ne passant que par des pixels dont la couleur est celle cible. Techniquement, on commence par les bord puis on se propage vers l'intérieur de l'image.
+ * On dit qu'un pixel "touche le bord" dès lors que l'on peut relier le pixel au bord en ne passant que par des pixels dont la couleur est celle cible. Techniquement, on identifie les composantes connexes (4-connexité) de pixels de la couleur cible, et on garde celles qui touchent un bord.
+ *
+ * L'image n'est jamais chargée entièrement en mémoire : elle est lue deux fois, par bandes d'au plus #bandHeight lignes.
+ * \li Première passe : chaque ligne est découpée en plages (runs) de pixels consécutifs de la couleur cible. Les plages de deux lignes successives d'une bande qui se recouvrent sont fusionnées dans une structure union-find propre à la bande. Une composante qui ne touche ni la première ni la dernière ligne de la bande est alors complète. Les plages de ces deux lignes frontières sont reportées dans une seconde structure union-find, commune à toute l'image, qui relie les bandes entre elles. Seules les étiquettes de la bande courante et celles des lignes frontières sont conservées.
+ * \li Deuxième passe : chaque bande est chargée, ses plages sont étiquetées de la même manière, et on sait pour chacune d'elle si elle appartient à une composante touchant un bord, soit dans la bande, soit grâce aux lignes frontières. Les changements de couleur et le masque sont écrits plage par plage, puis les lignes de la bande sont écrites.
+ *
+ * Pour les images flottantes, comme pour les entières, un pixel est de la couleur cible si la partie entière (troncature vers zéro) de chacun de ses canaux est dans l'intervalle [targetValue - tolerance, targetValue + tolerance] : une valeur -99999.5 correspond donc à la cible -99999.
  *
  * \~ \image html manageNodata.png \~french
  *
@@ -164,68 +202,204 @@ private:
     bool newNodataValue;
 
     /**
-     * \~french \brief Identifie les pixels de nodata
-     * \details Les pixels de nodata potentiels sont ceux qui ont la valeur #targetValue. Deux méthodes sont disponibles :
-     * \li Tous les pixels qui ont cette valeur sont du nodata
-     * \li Seuls les pixels qui ont cette valeur et qui "touchent le bord" sont du nodata
-     *
-     * Pour cette deuxième méthode, plus lourde, nous allons procéder comme suit. On identifie les pixels du bord dont la couleur est #targetValue, et on les ajoute dans une pile (on stocke la position en 1 dimension dans l'image). On remplit en parallèle le masque de donnée, pour mémoriser les pixels identifié comme nodata.
-     *
-     * Itérativement, tant que la pile n'est pas vide, on en prend la tête et on considère les 4 pixels autour. Si ils sont de la couleur #dataValue et qu'ils n'ont pas déjà été traités (on le sait grâce au masque), on les ajoute à la pile. Ainsi de suite jusqu'à vider la pile.
-     *
-     * Dans les deux acs, on remplit un buffer qui servira de masque afin de, au choix :
-     * \li changer la valeur de nodata
-     * \li changer la valeur des mixels de données qui ont la valeur #targetValue (réserver une couleur aux pixels de nodata)
-     * \li écrire le masque dans un fichier
-     *
-     * \param[in] IM image à analyser
-     * \param[out] MSK masque à remplir
-     *
-     * \return VRAI si l'image contient au moins 1 pixel de nodata, FAUX si elle n'en contient pas
+     * \~french \brief Bornes inférieures, par canal, des valeurs considérées comme la couleur cible
+     * \details Déduites de #targetValue et de #tolerance
+     * \~english \brief Lower bounds, per sample, of values considered as target color
+     */
+    T *targetMin;
+    /**
+     * \~french \brief Bornes supérieures, par canal, des valeurs considérées comme la couleur cible
+     * \details Déduites de #targetValue et de #tolerance
+     * \~english \brief Upper bounds, per sample, of values considered as target color
+     */
+    T *targetMax;
+
+    /**
+     * \~french \brief Plage horizontale de pixels de la couleur cible
+     * \~english \brief Horizontal run of target color pixels
+     */
+    struct Run {
+        /**
+         * \~french \brief Première colonne de la plage
+         * \~english \brief First column of the run
+         */
+        uint32_t start;
+        /**
+         * \~french \brief Colonne suivant la dernière colonne de la plage
+         * \~english \brief Column after the last column of the run
+         */
+        uint32_t end;
+        /**
+         * \~french \brief Étiquette de la plage, dans l'ordre de parcours de l'image
+         * \~english \brief Run's label, in image's scan order
+         */
+        uint32_t id;
+    };
+
+    /**
+     * \~french \brief Nombre maximal de lignes d'une bande
+     * \details 0 pour une hauteur calculée à partir de la taille d'une ligne, pour que la bande chargée en deuxième passe occupe au plus #NODATA_BAND_MEMORY octets
+     * \~english \brief Maximal number of lines in a band
+     * \details 0 for a height computed from line's size, so that the band loaded in the second pass uses #NODATA_BAND_MEMORY bytes at most
+     */
+    uint32_t bandHeight;
+
+    /**
+     * \~french \brief Parent de chaque plage de la bande courante dans la structure union-find
+     * \details Une racine est toujours la plus petite étiquette de sa composante.
+     * \~english \brief Parent of each run of the current band in the union-find structure
+     * \details A root is always the smallest label of its component.
+     */
+    std::vector<uint32_t> runParents;
+
+    /**
+     * \~french \brief Pour chaque racine de la bande courante, la composante touche-t-elle un bord ?
+     * \~english \brief For each root of the current band, does the component touch an edge ?
+     */
+    std::vector<uint8_t> runTouchEdges;
+
+    /**
+     * \~french \brief Pour chaque racine de la bande courante, étiquette d'une plage frontière de la composante, #NO_BOUNDARY si elle n'en a pas
+     * \~english \brief For each root of the current band, label of a boundary run in the component, #NO_BOUNDARY if it has none
+     */
+    std::vector<uint32_t> rootBoundaries;
+
+    /**
+     * \~french \brief Parent de chaque plage frontière (première ou dernière ligne d'une bande) dans la structure union-find de l'image
+     * \~english \brief Parent of each boundary run (band's first or last line) in the image's union-find structure
+     */
+    std::vector<uint32_t> boundaryParents;
+
+    /**
+     * \~french \brief Pour chaque racine des plages frontières, la composante touche-t-elle un bord ?
+     * \~english \brief For each boundary runs' root, does the component touch an edge ?
+     */
+    std::vector<uint8_t> boundaryTouchEdges;
+
+    /**
+     * \~french \brief Plages de la dernière ligne de la bande précédente, étiquetées dans #boundaryParents
+     * \~english \brief Previous band's last line runs, labelled in #boundaryParents
+     */
+    std::vector<Run> previousBoundary;
+
+    /**
+     * \~french \brief Étiquette de la prochaine plage frontière
+     * \~english \brief Next boundary run's label
+     */
+    uint32_t nextBoundary;
+
+    /**
+     * \~french \brief Identifie les pixels d'une ligne ayant la couleur cible
+     * \details Un pixel est considéré comme de la couleur cible si chacun de ses canaux, tronqué à l'entier pour les flottants, est dans l'intervalle [#targetMin, #targetMax]. La comparaison est faite canal par canal sur toute la ligne, sans branchement, pour être vectorisée par le compilateur.
+     * \param[in] line ligne de l'image
+     * \param[out] flags tableau de #width valeurs, 1 si le pixel est de la couleur cible, 0 sinon
      *
-     * \~english \brief Identify nodata pixels
-     * \param[in] IM image to analyze
-     * \param[out] MSK mask to fill
-     * \return TRUE if the image sontains 1 nodata pixel or more, FALSE otherwise
+     * \~english \brief Identify target color pixels in a line
+     * \details Float samples are truncated to integer before comparison. Comparison is done sample by sample on the whole line, without branching, to be vectorized by the compiler.
+     * \param[in] line image's line
+     * \param[out] flags #width values array, 1 if pixel has the target color, 0 otherwise
      */
-    bool identifyNodataPixels ( T* IM, uint8_t* MSK );
+    void flagTargetPixels ( T* line, uint8_t* flags );
 
     /**
-     * \~french \brief Détermine si un pixel contient la valeur cible
-     * \details Un pixel est considéré comme de la couleur cible s'il appartient à l'intervalle définit par #targetValue et #tolerance
-     * \param[in] pix pixel à tester
-     * \return
+     * \~french \brief Découpe une ligne en plages de pixels de la couleur cible
+     * \param[in] flags indicateurs calculés par #flagTargetPixels
+     * \param[out] runs plages de la ligne, de gauche à droite
+     * \param[in] firstId étiquette de la première plage de la ligne
      *
-     * \~english \brief Determine target value pixel
-     * \param[in] pix pixel to test
+     * \~english \brief Split a line into target color runs
+     * \param[in] flags indicators computed by #flagTargetPixels
+     * \param[out] runs line's runs, from left to right
+     * \param[in] firstId label of the line's first run
+     */
+    void extractRuns ( uint8_t* flags, std::vector<Run>& runs, uint32_t firstId );
+
+    /**
+     * \~french \brief Retourne la racine d'une plage dans une structure union-find
+     * \~english \brief Return run's root in an union-find structure
      */
-    inline bool isTargetValue ( T* pix );
+    inline uint32_t findRoot ( std::vector<uint32_t>& parents, uint32_t id );
 
     /**
-     * \~french \brief Change la couleur des pixels de nodata
-     * \details Les pixels de nodata ont déjà été identifiés. Reste à en changer la valeur par #nodataValue.
+     * \~french \brief Réunit les composantes de deux plages dans une structure union-find
+     * \details La plus petite racine devient la racine commune, et hérite de l'information "touche un bord"
+     * \~english \brief Merge components of two runs in an union-find structure
+     */
+    inline void unite ( std::vector<uint32_t>& parents, std::vector<uint8_t>& touch, uint32_t a, uint32_t b );
+
+    /**
+     * \~french \brief Ajoute une ligne à la bande courante
+     * \details Les plages de la ligne sont étiquetées à la suite de celles de la bande et réunies avec celles de la ligne précédente de la bande qu'elles recouvrent (4-connexité).
+     * \param[in] flags indicateurs de la ligne, calculés par #flagTargetPixels
+     * \param[in] l indice de la ligne dans l'image
+     * \param[in] previous plages de la ligne précédente dans la bande, vide pour la première ligne
+     * \param[out] current plages de la ligne
      *
-     * \param[in,out] IM image à modifier
-     * \param[in] MSK masque à utiliser
+     * \~english \brief Add a line to the current band
+     * \details Line's runs are labelled after the band's ones and merged with the overlapping runs of the previous line in the band (4-connectivity).
+     * \param[in] flags line's indicators, computed by #flagTargetPixels
+     * \param[in] l line's indice in the image
+     * \param[in] previous previous line's runs in the band, empty for the first line
+     * \param[out] current line's runs
+     */
+    void addBandLine ( uint8_t* flags, uint32_t l, const std::vector<Run>& previous, std::vector<Run>& current );
+
+    /**
+     * \~french \brief Relie les composantes de la bande courante aux plages frontières
+     * \details Les plages des première et dernière lignes de la bande reçoivent, dans l'ordre, les étiquettes frontières suivantes. En première passe, les plages frontières d'une même composante de la bande sont réunies, ainsi que celles de la première ligne avec celles de la dernière ligne de la bande précédente qu'elles recouvrent. En deuxième passe, les étiquettes sont seulement retrouvées.
+     * \param[in] first plages de la première ligne de la bande
+     * \param[in] last plages de la dernière ligne de la bande
+     * \param[in] oneLine la bande n'a qu'une ligne (#first et #last sont alors les mêmes plages)
+     * \param[in] firstPass vrai en première passe
      *
-     * \~english \brief Switch color of nodata pixels
-     * \param[in,out] IM image to modify
-     * \param[in] MSK mask to use
+     * \~english \brief Link the current band's components to boundary runs
+     * \details Runs of the band's first and last lines get, in order, the next boundary labels. In the first pass, boundary runs of the same band's component are merged, so as first line's runs with the overlapping previous band's last line runs. In the second pass, labels are only found again.
+     * \param[in] first band's first line runs
+     * \param[in] last band's last line runs
+     * \param[in] oneLine band has only one line (#first and #last are then the same runs)
+     * \param[in] firstPass true in the first pass
      */
-    void changeNodataValue ( T* IM, uint8_t* MSK );
+    void linkBand ( const std::vector<Run>& first, const std::vector<Run>& last, bool oneLine, bool firstPass );
 
     /**
-     * \~french \brief Change la couleur des pixels de donnée
-     * \details Les pixels de nodata ont déjà été identifiés. Il se peut que des pixels de données soit de la couleur #targetValue et qu'on veuille la changer (réserver une couleur aux pixels de nodata). On parcourt l'image et on change la valeur de ces derniers par #dataValue.
+     * \~french \brief La composante d'une plage de la bande courante touche-t-elle un bord ?
+     * \details Valide en deuxième passe, une fois la bande reliée par #linkBand
+     * \~english \brief Does the current band's run component touch an edge ?
+     * \details Valid in the second pass, once the band linked by #linkBand
+     */
+    inline bool touchesEdges ( uint32_t id );
+
+    /**
+     * \~french \brief Identifie les composantes de pixels de la couleur cible touchant les bords
+     * \details Première passe, en lecture seule, sur l'image. Voir la description de la classe.
+     * \param[in] sourceImage image à analyser
+     * \param[in] rows hauteur des bandes
+     * \param[out] containNodata l'image contient-elle au moins un pixel de nodata ?
+     * \return faux en cas d'erreur de lecture
      *
-     * \param[in,out] IM image à modifier
-     * \param[in] MSK masque à utiliser
+     * \~english \brief Identify target color pixels' components which touch edges
+     * \details First pass, read only, on the image. See class description.
+     * \param[in] sourceImage image to analyze
+     * \param[in] rows bands' height
+     * \param[out] containNodata does the image contain at least one nodata pixel ?
+     * \return false if reading error
+     */
+    bool labelRuns ( FileImage* sourceImage, uint32_t rows, bool& containNodata );
+
+    /**
+     * \~french \brief Remplit une plage d'une ligne avec une couleur
+     * \details La couleur est écrite une fois puis recopiée par blocs de taille doublant à chaque copie.
+     * \param[in,out] line ligne à modifier
+     * \param[in] run plage à remplir
+     * \param[in] color couleur à écrire
      *
-     * \~english \brief Switch color of data pixels
-     * \param[in,out] IM image to modify
-     * \param[in] MSK mask to use
+     * \~english \brief Fill a line's run with a color
+     * \details Color is written once then copied by blocks whose size doubles at each copy.
+     * \param[in,out] line line to modify
+     * \param[in] run run to fill
+     * \param[in] color color to write
      */
-    void changeDataValue ( T* IM, uint8_t* MSK );
+    void fillRun ( T* line, const Run& run, T* color );
 
 public:
 
@@ -259,11 +433,15 @@ public:
         delete[] targetValue;
         delete[] nodataValue;
         delete[] dataValue;
+        delete[] targetMin;
+        delete[] targetMax;
     }
 
     /** \~french
      * \brief Fonction de traitement du manager, effectuant les modification de l'image
      * \details Elle utilise les booléens #removeTargetValue et #newNodataValue pour déterminer le travail à faire. Si le travail consisite simplement à identifier le nodata et écrire un maque (pas de modification à apporter à l'image), l'image ne sera pas réecrite, même si un chemin différent pour la sortie est fourni.
+     *
+     * L'image en sortie peut être celle en entrée : elle est alors écrite dans un fichier temporaire, renommé à la fin du traitement.
      * \param[in] input chemin de l'image à modifier
      * \param[in] output chemin de l'image de sortie
      * \param[in] outputMask chemin du masque de sortie
@@ -278,6 +456,19 @@ public:
      */
     bool treatNodata ( char* inputImage, char* outputImage, char* outputMask = 0 );
 
+    /** \~french
+     * \brief Précise le nombre maximal de lignes traitées à la fois
+     * \details Borne la mémoire utilisée. Par défaut (0), la hauteur est déduite de la taille d'une ligne.
+     * \param[in] rows hauteur maximale des bandes, 0 pour une hauteur automatique
+     ** \~english
+     * \brief Set the maximal number of lines treated at once
+     * \details Bounds used memory. By default (0), height is deduced from line's size.
+     * \param[in] rows bands' maximal height, 0 for an automatic height
+     */
+    void setBandHeight ( uint32_t rows ) {
+        bandHeight = rows;
+    }
+
 };
 
 
@@ -292,16 +483,26 @@ public:
 
 template<typename T>
 TiffNodataManager<T>::TiffNodataManager ( uint16 channels, int* tv, bool touchEdges, int* dv, int* nv, int t ) :
-    maxChannels ( channels ), touchEdges ( touchEdges ), tolerance ( t ) {
+    maxChannels ( channels ), tolerance ( t ), touchEdges ( touchEdges ), bandHeight ( 0 ) {
 
     targetValue = new T[channels];
     dataValue = new T[channels];
     nodataValue = new T[channels];
+    targetMin = new T[channels];
+    targetMax = new T[channels];
 
     for ( int i = 0; i < channels; i++ ) {
         targetValue[i] = ( T ) tv[i];
         dataValue[i] = ( T ) dv[i];
         nodataValue[i] = ( T ) nv[i];
+
+        // Intervalle de tolérance, ramené aux valeurs représentables par le type des canaux
+        double min = ( double ) tv[i] - tolerance;
+        double max = ( double ) tv[i] + tolerance;
+        if ( min < ( double ) std::numeric_limits<T>::lowest() ) min = std::numeric_limits<T>::lowest();
+        if ( max > ( double ) std::numeric_limits<T>::max() ) max = std::numeric_limits<T>::max();
+        targetMin[i] = ( T ) min;
+        targetMax[i] = ( T ) max;
     }
 
     if ( memcmp ( tv,nv,channels*sizeof ( int ) ) ) {
@@ -349,227 +550,409 @@ bool TiffNodataManager<T>::treatNodata ( char* inputImage, char* outputImage, ch
     if ( samplesperpixel > maxChannels )  {
         LOGGER_ERROR ( "The nodata manager is not adapted (samplesperpixel have to be " << maxChannels <<
                        " or less) for the image " << inputImage << " (" << samplesperpixel << ")" );
+        delete sourceImage;
         return false;
     }
 
-    /*************** Chargement de l'image ***************/
-
-    T *IM = (T*) malloc (width * height * samplesperpixel * sizeof(T));
-    if ( IM == NULL ) {
-        LOGGER_ERROR ( "Cannot allocate a buffer of size " << width * height * samplesperpixel * sizeof(T) << " bytes" );
-        return false;
-    }
-
-    LOGGER_DEBUG("We load input image into memory : " << width * height * samplesperpixel * sizeof(T) / 1024 << " kilobytes");
-    for ( int h = 0; h < height; h++ ) {
-        sourceImage->getline(IM + width*samplesperpixel*h, h);
+    // Hauteur des bandes, pour borner la mémoire utilisée
+    uint32_t rows = bandHeight;
+    if ( rows == 0 ) {
+        rows = NODATA_BAND_MEMORY / ( width * samplesperpixel * sizeof ( T ) );
     }
+    if ( rows < 1 ) rows = 1;
+    if ( rows > height ) rows = height;
 
-    delete sourceImage;
-
-    LOGGER_DEBUG("Premier pixel : " << (int)IM[0] << "," << (int)IM[1] << "," << (int)IM[2]);
+    /****************** Première passe *******************/
 
-    /************* Calcul du masque de données ***********/
-
-    uint8_t *MSK = new uint8_t[width * height];
+    // Sans "touche les bords", tout pixel de la couleur cible est du nodata : la première passe ne sert qu'à savoir si le masque doit être écrit
+    bool containNodata = true;
+    if ( touchEdges || outputMask ) {
+        if ( ! labelRuns ( sourceImage, rows, containNodata ) ) {
+            LOGGER_ERROR ( "Cannot identify nodata pixels in the image " << inputImage );
+            delete sourceImage;
+            return false;
+        }
+    }
 
-    bool containNodata = identifyNodataPixels ( IM, MSK );
+    /****************** Deuxième passe *******************/
 
-    /*************** Modification des pixels *************/
+    /* On ne réécrit l'image que si on la modifie. Si seule l'écriture du masque nous intéressait, on ne réecrit pas l'image,
+     * même si un chemin d'image différent est fourni pour la sortie */
+    bool writeImage = ( removeTargetValue || newNodataValue );
+    bool writeMask = ( outputMask && containNodata );
 
-    if ( removeTargetValue ) {
-        LOGGER_DEBUG("The 'targetValue' data pixels are replaced by 'dataValue' pixels");
-        changeDataValue ( IM, MSK );
+    if ( ! writeImage && strcmp ( inputImage, outputImage ) ) {
+        LOGGER_INFO ( "The image have not be modified, the file '" << outputImage <<"' is not written" );
     }
-
-    if ( newNodataValue ) {
-        LOGGER_DEBUG("Nodata pixels which touch edges are replaced by 'nodataValue' pixels");
-        changeNodataValue ( IM, MSK );
+    if ( outputMask && ! containNodata ) {
+        LOGGER_INFO ( "The image contains only data, the mask '" << outputMask <<"' is not written" );
     }
 
-    /**************** Ecriture de l'images ****************/
+    if ( ! writeImage && ! writeMask ) {
+        delete sourceImage;
+        boundaryParents.clear();
+        boundaryTouchEdges.clear();
+        return true;
+    }
 
-    /* Seulement si on a modifié l'image. Si seule l'écriture du masque nous intéressait, on ne réecrit pas l'image,
-     * même si un chemin d'image différent est fourni pour la sortie */
-    if ( removeTargetValue || newNodataValue ) {
+    // L'image est lue pendant qu'on écrit la sortie : si c'est le même fichier, on passe par un fichier temporaire
+    std::string outputPath ( outputImage );
+    if ( writeImage && ! strcmp ( inputImage, outputImage ) ) {
+        outputPath += ".tmp.tif";
+    }
 
-        FileImage* destImage = FIF.createImageToWrite(
-            outputImage, BoundingBox<double>(0,0,0,0), -1, -1, width, height,
+    FileImage* destImage = NULL;
+    if ( writeImage ) {
+        destImage = FIF.createImageToWrite(
+            (char*) outputPath.c_str(), BoundingBox<double>(0,0,0,0), -1, -1, width, height,
             samplesperpixel, sampleformat, bitspersample, photometric, compression
         );
 
         if ( destImage == NULL )  {
-            LOGGER_ERROR ( "Cannot create the output image "<< outputImage );
+            LOGGER_ERROR ( "Cannot create the output image "<< outputPath );
+            delete sourceImage;
             return false;
         }
-        
-        LOGGER_DEBUG("We write the output image " << outputImage);
-        destImage->writeImage(IM);
+    }
 
-        delete destImage;
+    FileImage* destMask = NULL;
+    if ( writeMask ) {
+        destMask = FIF.createImageToWrite(
+            outputMask, BoundingBox<double>(0,0,0,0), -1, -1, width, height,
+            1, SampleFormat::UINT, 8, Photometric::MASK, Compression::DEFLATE
+        );
 
-    } else {
-        if ( memcmp ( inputImage, outputImage, sizeof ( outputImage ) ) )
-            LOGGER_INFO ( "The image have not be modified, the file '" << outputImage <<"' is not written" );
+        if ( destMask == NULL )  {
+            LOGGER_ERROR ( "Cannot create the output mask "<< outputMask );
+            delete sourceImage;
+            delete destImage;
+            return false;
+        }
     }
 
-    /**************** Ecriture du masque ? ****************/
-    if ( outputMask ) {
-        if (containNodata) {
-            FileImage* destMask = FIF.createImageToWrite(
-                outputMask, BoundingBox<double>(0,0,0,0), -1, -1, width, height,
-                1, SampleFormat::UINT, 8, Photometric::MASK, Compression::DEFLATE
-            );
-
-            if ( destMask == NULL )  {
-                LOGGER_ERROR ( "Cannot create the output mask "<< outputMask );
-                return false;
+    LOGGER_DEBUG ( "Nodata treatment, by bands of " << rows << " lines" );
+
+    // Avec "touche les bords", la bande entière doit être étiquetée avant de savoir quelles plages sont du nodata
+    uint32_t loadedRows = touchEdges ? rows : 1;
+    T* band = new T[loadedRows * width * samplesperpixel];
+    uint8_t* flags = new uint8_t[width];
+    uint8_t* maskLine = new uint8_t[width];
+    std::vector<std::vector<Run> > bandRuns ( loadedRows );
+    std::vector<Run> none;
+    nextBoundary = 0;
+    bool ok = true;
+
+    for ( uint32_t l0 = 0; l0 < height && ok; l0 += loadedRows ) {
+
+        uint32_t n = __min ( loadedRows, height - l0 );
+        runParents.clear();
+        runTouchEdges.clear();
+
+        for ( uint32_t r = 0; r < n; r++ ) {
+            T* line = band + r * width * samplesperpixel;
+            if ( sourceImage->getline ( line, l0 + r ) == 0 ) {
+                LOGGER_ERROR ( "Cannot read line " << l0 + r << " of the image " << inputImage );
+                ok = false;
+                break;
+            }
+            flagTargetPixels ( line, flags );
+            if ( touchEdges ) {
+                addBandLine ( flags, l0 + r, ( r == 0 ) ? none : bandRuns[r - 1], bandRuns[r] );
+            } else {
+                extractRuns ( flags, bandRuns[r], 0 );
             }
+        }
+        if ( ! ok ) break;
+
+        if ( touchEdges ) linkBand ( bandRuns[0], bandRuns[n - 1], n == 1, false );
+
+        for ( uint32_t r = 0; r < n; r++ ) {
+            T* line = band + r * width * samplesperpixel;
+            std::vector<Run>& runs = bandRuns[r];
 
-            LOGGER_DEBUG("We write the output mask " << outputMask);
-            destMask->writeImage(MSK);
+            if ( writeMask ) memset ( maskLine, 255, width );
 
-            delete destMask;
-        } else {
-            LOGGER_INFO ( "The image contains only data, the mask '" << outputMask <<"' is not written" );
+            for ( unsigned int i = 0; i < runs.size(); i++ ) {
+                bool nodata = ( ! touchEdges || touchesEdges ( runs[i].id ) );
+
+                if ( nodata ) {
+                    if ( newNodataValue ) fillRun ( line, runs[i], nodataValue );
+                    if ( writeMask ) memset ( maskLine + runs[i].start, 0, runs[i].end - runs[i].start );
+                } else if ( removeTargetValue ) {
+                    fillRun ( line, runs[i], dataValue );
+                }
+            }
+
+            if ( writeImage && destImage->writeLine ( line, l0 + r ) < 0 ) {
+                LOGGER_ERROR ( "Cannot write line " << l0 + r << " of the image " << outputPath );
+                ok = false;
+            }
+            if ( writeMask && destMask->writeLine ( maskLine, l0 + r ) < 0 ) {
+                LOGGER_ERROR ( "Cannot write line " << l0 + r << " of the mask " << outputMask );
+                ok = false;
+            }
         }
     }
 
-    free(IM);
-    delete[] MSK;
+    delete[] band;
+    delete[] flags;
+    delete[] maskLine;
+    delete sourceImage;
+    delete destImage;
+    delete destMask;
+
+    runParents.clear();
+    runTouchEdges.clear();
+    rootBoundaries.clear();
+    boundaryParents.clear();
+    boundaryTouchEdges.clear();
+    previousBoundary.clear();
+
+    if ( ok && outputPath != outputImage ) {
+        if ( rename ( outputPath.c_str(), outputImage ) != 0 ) {
+            LOGGER_ERROR ( "Cannot replace the image " << outputImage << " by the treated one " << outputPath );
+            ok = false;
+        }
+    }
 
-    return true;
+    return ok;
 }
 
 template<typename T>
-inline bool TiffNodataManager<T>::isTargetValue ( T* pix ) {
-    int pixint;
-    int tvint;
-    for ( int i = 0; i < samplesperpixel; i++ ) {
-        pixint = ( int ) pix[i];
-        tvint = ( int ) targetValue[i];
-        if ( pixint < tvint - tolerance || pixint > tvint + tolerance ) {
-            return false;
+void TiffNodataManager<T>::flagTargetPixels ( T* line, uint8_t* flags ) {
+
+    memset ( flags, 1, width );
+
+    for ( int c = 0; c < samplesperpixel; c++ ) {
+        T* sample = line + c;
+        T min = targetMin[c];
+        T max = targetMax[c];
+        for ( uint32_t i = 0; i < width; i++ ) {
+            T v = targetComparable<T> ( sample[i * samplesperpixel] );
+            flags[i] &= ( uint8_t ) ( ( v >= min ) & ( v <= max ) );
         }
     }
-    return true;
 }
 
 template<typename T>
-bool TiffNodataManager<T>::identifyNodataPixels ( T* IM, uint8_t* MSK ) {
+void TiffNodataManager<T>::extractRuns ( uint8_t* flags, std::vector<Run>& runs, uint32_t firstId ) {
+
+    runs.clear();
+
+    uint32_t i = 0;
+    while ( i < width ) {
+        // On saute les pixels de donnée, en testant 8 indicateurs à la fois
+        while ( i + 8 <= width ) {
+            uint64_t block;
+            memcpy ( &block, flags + i, 8 );
+            if ( block ) break;
+            i += 8;
+        }
+        while ( i < width && ! flags[i] ) i++;
+        if ( i == width ) break;
+
+        Run run;
+        run.start = i;
+        while ( i < width && flags[i] ) i++;
+        run.end = i;
+        run.id = firstId + runs.size();
+        runs.push_back ( run );
+    }
+}
 
-    LOGGER_DEBUG ( "Identify nodata pixels..." );
-    memset ( MSK, 255, width * height );
+template<typename T>
+inline uint32_t TiffNodataManager<T>::findRoot ( std::vector<uint32_t>& parents, uint32_t id ) {
+    while ( parents[id] != id ) {
+        // Compression de chemin par division
+        parents[id] = parents[parents[id]];
+        id = parents[id];
+    }
+    return id;
+}
+
+template<typename T>
+inline void TiffNodataManager<T>::unite ( std::vector<uint32_t>& parents, std::vector<uint8_t>& touch, uint32_t a, uint32_t b ) {
+    uint32_t ra = findRoot ( parents, a );
+    uint32_t rb = findRoot ( parents, b );
+    if ( ra == rb ) return;
+    if ( rb < ra ) {
+        uint32_t tmp = ra;
+        ra = rb;
+        rb = tmp;
+    }
+    parents[rb] = ra;
+    touch[ra] |= touch[rb];
+}
 
-    bool containNodata = false;
+template<typename T>
+void TiffNodataManager<T>::addBandLine ( uint8_t* flags, uint32_t l, const std::vector<Run>& previous, std::vector<Run>& current ) {
 
-    if ( touchEdges ) {
-        LOGGER_DEBUG ( "\t...which touch edges" );
-        // On utilise la couleur targetValue et on part des bords
-        queue<unsigned long long> Q;
+    extractRuns ( flags, current, runParents.size() );
 
-        // Initialisation : we identify front pixels which are 'targetValue'
-        for ( unsigned long long pos = 0; pos < width; pos++ ) { // top
-            if ( isTargetValue ( IM + samplesperpixel * pos ) ) {
-                Q.push ( pos );
-                MSK[pos] = 0;
-            }
-        }
-        for ( unsigned long long pos = width* ( height-1 ); pos < width*height; pos++ ) { // bottom
-            if ( isTargetValue ( IM + samplesperpixel * pos ) ) {
-                Q.push ( pos );
-                MSK[pos] = 0;
-            }
+    bool edgeLine = ( l == 0 || l == height - 1 );
+    for ( unsigned int r = 0; r < current.size(); r++ ) {
+        runParents.push_back ( current[r].id );
+        runTouchEdges.push_back ( edgeLine || current[r].start == 0 || current[r].end == width );
+    }
+
+    // Les plages qui se recouvrent entre les deux lignes appartiennent à la même composante (4-connexité)
+    unsigned int p = 0;
+    for ( unsigned int r = 0; r < current.size(); r++ ) {
+        while ( p < previous.size() && previous[p].end <= current[r].start ) p++;
+        for ( unsigned int q = p; q < previous.size() && previous[q].start < current[r].end; q++ ) {
+            unite ( runParents, runTouchEdges, current[r].id, previous[q].id );
         }
-        for ( unsigned long long pos = 0; pos < width*height; pos += width ) { // left
-            if ( isTargetValue ( IM + samplesperpixel * pos ) ) {
-                Q.push ( pos );
-                MSK[pos] = 0;
+    }
+}
+
+template<typename T>
+void TiffNodataManager<T>::linkBand ( const std::vector<Run>& first, const std::vector<Run>& last, bool oneLine, bool firstPass ) {
+
+    rootBoundaries.assign ( runParents.size(), NO_BOUNDARY );
+
+    // Étiquettes frontières, dans l'ordre : première ligne, puis dernière ligne si la bande en a plusieurs
+    std::vector<Run> firstBoundary ( first );
+    std::vector<Run> lastBoundary ( last );
+    const std::vector<Run>* lines[2] = { &first, &last };
+    std::vector<Run>* boundaries[2] = { &firstBoundary, &lastBoundary };
+    int nbLines = oneLine ? 1 : 2;
+
+    for ( int b = 0; b < nbLines; b++ ) {
+        for ( unsigned int r = 0; r < lines[b]->size(); r++ ) {
+            uint32_t gid = nextBoundary++;
+            ( *boundaries[b] ) [r].id = gid;
+
+            uint32_t root = findRoot ( runParents, ( *lines[b] ) [r].id );
+            if ( firstPass ) {
+                boundaryParents.push_back ( gid );
+                boundaryTouchEdges.push_back ( runTouchEdges[root] );
+                if ( rootBoundaries[root] != NO_BOUNDARY ) {
+                    unite ( boundaryParents, boundaryTouchEdges, rootBoundaries[root], gid );
+                }
             }
+            if ( rootBoundaries[root] == NO_BOUNDARY ) rootBoundaries[root] = gid;
         }
-        for ( unsigned long long pos = width -1; pos < width*height; pos+= width ) { // right
-            if ( isTargetValue ( IM + samplesperpixel * pos ) ) {
-                Q.push ( pos );
-                MSK[pos] = 0;
+    }
+    if ( nbLines == 1 ) lastBoundary = firstBoundary;
+
+    if ( firstPass ) {
+        // Les plages de la première ligne qui recouvrent celles de la dernière ligne de la bande précédente appartiennent à la même composante
+        unsigned int p = 0;
+        for ( unsigned int r = 0; r < firstBoundary.size(); r++ ) {
+            while ( p < previousBoundary.size() && previousBoundary[p].end <= firstBoundary[r].start ) p++;
+            for ( unsigned int q = p; q < previousBoundary.size() && previousBoundary[q].start < firstBoundary[r].end; q++ ) {
+                unite ( boundaryParents, boundaryTouchEdges, firstBoundary[r].id, previousBoundary[q].id );
             }
         }
+        previousBoundary.swap ( lastBoundary );
+    }
+}
 
-        if ( Q.empty() ) {
-            // No nodata pixel identified, nothing to do
-            return false;
+template<typename T>
+inline bool TiffNodataManager<T>::touchesEdges ( uint32_t id ) {
+    uint32_t root = findRoot ( runParents, id );
+    if ( runTouchEdges[root] ) return true;
+    if ( rootBoundaries[root] == NO_BOUNDARY ) return false;
+    return boundaryTouchEdges[findRoot ( boundaryParents, rootBoundaries[root] )];
+}
+
+template<typename T>
+bool TiffNodataManager<T>::labelRuns ( FileImage* sourceImage, uint32_t rows, bool& containNodata ) {
+
+    LOGGER_DEBUG ( "Identify nodata pixels..." );
+
+    boundaryParents.clear();
+    boundaryTouchEdges.clear();
+    previousBoundary.clear();
+    nextBoundary = 0;
+    containNodata = false;
+
+    T* line = new T[width * samplesperpixel];
+    uint8_t* flags = new uint8_t[width];
+    std::vector<Run> first, previous, current, none;
+    bool ok = true;
+
+    for ( uint32_t l = 0; l < height; l++ ) {
+
+        if ( sourceImage->getline ( line, l ) == 0 ) {
+            LOGGER_ERROR ( "Cannot read line " << l );
+            ok = false;
+            break;
         }
 
-        containNodata = true;
-
-        // while there are 'targetValue' pixels which can propagate, we do it
-        while ( !Q.empty() ) {
-            unsigned long long pos = Q.front();
-            Q.pop();
-            unsigned long long newpos;
-            if ( pos % width > 0 ) {
-                newpos = pos - 1;
-                if ( MSK[newpos] && isTargetValue ( IM + newpos*samplesperpixel ) ) {
-                    MSK[newpos] = 0;
-                    Q.push ( newpos );
-                }
-            }
-            if ( pos % width < width - 1 ) {
-                newpos = pos + 1;
-                if ( MSK[newpos] && isTargetValue ( IM + newpos*samplesperpixel ) ) {
-                    MSK[newpos] = 0;
-                    Q.push ( newpos );
-                }
-            }
-            if ( pos / width > 0 ) {
-                newpos = pos - width;
-                if ( MSK[newpos] && isTargetValue ( IM + newpos*samplesperpixel ) ) {
-                    MSK[newpos] = 0;
-                    Q.push ( newpos );
-                }
-            }
-            if ( pos / width < height - 1 ) {
-                newpos = pos + width;
-                if ( MSK[newpos] && isTargetValue ( IM + newpos*samplesperpixel ) ) {
-                    MSK[newpos] = 0;
-                    Q.push ( newpos );
-                }
+        flagTargetPixels ( line, flags );
+
+        if ( ! touchEdges ) {
+            // Tous les pixels de la couleur targetValue sont à considérer comme du nodata : un seul suffit
+            extractRuns ( flags, current, 0 );
+            if ( ! current.empty() ) {
+                containNodata = true;
+                break;
             }
+            continue;
         }
 
-    } else {
-        LOGGER_DEBUG ( "\t..., all pixels in 'target color'" );
-        // Tous les pixels de la couleur targetValue sont à considérer comme du nodata
+        // Seules les étiquettes de la bande courante sont gardées
+        bool firstLine = ( l % rows == 0 );
+        bool lastLine = ( l % rows == rows - 1 || l == height - 1 );
+        if ( firstLine ) {
+            runParents.clear();
+            runTouchEdges.clear();
+        }
 
-        for ( unsigned long long i = 0; i < width * height; i++ ) {
+        addBandLine ( flags, l, firstLine ? none : previous, current );
+        if ( firstLine ) first = current;
 
-            if ( isTargetValue ( IM+i*samplesperpixel ) ) {
-                containNodata = true;
-                MSK[i] = 0;
+        if ( lastLine ) {
+            linkBand ( first, current, firstLine, true );
+            // Une composante sans plage frontière est complète : elle ne sera plus modifiée
+            for ( uint32_t id = 0; id < runParents.size() && ! containNodata; id++ ) {
+                if ( runParents[id] == id && runTouchEdges[id] && rootBoundaries[id] == NO_BOUNDARY ) containNodata = true;
             }
         }
 
+        previous.swap ( current );
     }
 
-    return containNodata;
-}
+    delete[] line;
+    delete[] flags;
 
-template<typename T>
-void TiffNodataManager<T>::changeNodataValue ( T* IM, uint8_t* MSK ) {
+    runParents.clear();
+    runTouchEdges.clear();
+    rootBoundaries.clear();
+    previousBoundary.clear();
 
-    for ( int i = 0; i < width * height; i ++ ) {
-        if ( ! MSK[i] ) {
-            memcpy ( IM+i*samplesperpixel,nodataValue,samplesperpixel*sizeof ( T ) );
-        }
+    if ( ! ok ) return false;
+
+    if ( ! touchEdges ) {
+        LOGGER_DEBUG ( "\t..., all pixels in 'target color'" );
+        return true;
+    }
+
+    LOGGER_DEBUG ( "\t...which touch edges : " << boundaryParents.size() << " boundary runs" );
+
+    // Les racines étant les plus petites étiquettes, un parcours croissant suffit à faire pointer chaque plage frontière sur sa racine
+    for ( uint32_t id = 0; id < boundaryParents.size(); id++ ) {
+        boundaryParents[id] = boundaryParents[boundaryParents[id]];
+        if ( boundaryTouchEdges[boundaryParents[id]] ) containNodata = true;
     }
+
+    return true;
 }
 
 template<typename T>
-void TiffNodataManager<T>::changeDataValue ( T* IM, uint8_t* MSK ) {
+void TiffNodataManager<T>::fillRun ( T* line, const Run& run, T* color ) {
 
-    for ( int i = 0; i < width * height; i ++ ) {
-        if ( MSK[i] && isTargetValue ( IM+i*samplesperpixel ) ) {
-            memcpy ( IM+i*samplesperpixel,dataValue,samplesperpixel*sizeof ( T ) );
-        }
+    T* dst = line + run.start * samplesperpixel;
+    size_t total = ( run.end - run.start ) * samplesperpixel;
+    size_t done = samplesperpixel;
+
+    memcpy ( dst, color, samplesperpixel * sizeof ( T ) );
+
+    while ( done < total ) {
+        size_t n = ( done < total - done ) ? done : total - done;
+        memcpy ( dst + done, dst, n * sizeof ( T ) );
+        done += n;
     }
 }
 
@@ -696,6 +696,207 @@ inline void dot_prod ( int C, int K, float* to, const float* from, const float*
     }
 }
 
+
+/**
+ * \brief Sous-échantillonnage 2x2 d'un pixel, avec masques : version pixel par pixel
+ * \details Voir #merge4. Traite les pixels en sortie de begin (inclus) à end (exclus).
+ */
+inline void merge4_pixels ( uint8_t* to, uint8_t* toMask, const uint8_t* from1, const uint8_t* mask1,
+                            const uint8_t* from2, const uint8_t* mask2, int begin, int end, int channels, const uint8_t* gamma ) {
+    const uint8_t* m1 = mask1 + 2*begin;
+    const uint8_t* m2 = mask2 + 2*begin;
+    const uint8_t* f1 = from1 + 2*begin*channels;
+    const uint8_t* f2 = from2 + 2*begin*channels;
+    uint8_t* t = to + begin*channels;
+
+    for ( int i = begin; i < end; i++, m1 += 2, m2 += 2, f1 += 2*channels, f2 += 2*channels, t += channels ) {
+        int nbData = ( m1[0] != 0 ) + ( m1[1] != 0 ) + ( m2[0] != 0 ) + ( m2[1] != 0 );
+        if ( nbData < 2 ) continue;
+
+        toMask[i] = 255;
+        for ( int c = 0; c < channels; c++ ) {
+            int sum = 0;
+            if ( m1[0] ) sum += f1[c];
+            if ( m1[1] ) sum += f1[channels + c];
+            if ( m2[0] ) sum += f2[c];
+            if ( m2[1] ) sum += f2[channels + c];
+            t[c] = gamma[sum*4/nbData];
+        }
+    }
+}
+
+inline void merge4_pixels ( float* to, uint8_t* toMask, const float* from1, const uint8_t* mask1,
+                            const float* from2, const uint8_t* mask2, int begin, int end, int channels ) {
+    const uint8_t* m1 = mask1 + 2*begin;
+    const uint8_t* m2 = mask2 + 2*begin;
+    const float* f1 = from1 + 2*begin*channels;
+    const float* f2 = from2 + 2*begin*channels;
+    float* t = to + begin*channels;
+
+    for ( int i = begin; i < end; i++, m1 += 2, m2 += 2, f1 += 2*channels, f2 += 2*channels, t += channels ) {
+        int nbData = ( m1[0] != 0 ) + ( m1[1] != 0 ) + ( m2[0] != 0 ) + ( m2[1] != 0 );
+        if ( nbData < 2 ) continue;
+
+        toMask[i] = 255;
+        for ( int c = 0; c < channels; c++ ) {
+            // Même ordre d'addition que la somme flottante d'origine, pour un résultat identique au bit près
+            float sum = 0.;
+            if ( m1[0] ) sum += f1[c];
+            if ( m1[1] ) sum += f1[channels + c];
+            if ( m2[0] ) sum += f2[c];
+            if ( m2[1] ) sum += f2[channels + c];
+            t[c] = sum / ( float ) nbData;
+        }
+    }
+}
+
+/**
+ * \brief Sous-échantillonnage 2x2 de deux lignes, avec masques de donnée
+ * \details Chaque pixel en sortie est la moyenne des pixels de donnée (masque non nul) du carré de 2x2 pixels source correspondant. Il n'est écrit, et son masque mis à 255, que si au moins deux de ces pixels sont de la donnée : sinon, le pixel et le masque en sortie ne sont pas modifiés.
+ *
+ * En entiers sur 8 bits, la moyenne multipliée par 4 (de 0 à 1020) indexe une table de gamma. En flottant, les pixels sont sommés dans l'ordre (ligne 1 puis ligne 2, gauche puis droite) avant la division.
+ *
+ * En SSE2, les masques sont testés par blocs : un bloc entièrement de donnée est sommé dans les registres, un bloc entièrement vide est sauté, les autres sont traités pixel par pixel. Le résultat est le même, au bit près, que la version pixel par pixel.
+ *
+ * @param to Ligne en sortie (width pixels)
+ * @param toMask Masque de la ligne en sortie
+ * @param from1 Première ligne source (2 * width pixels)
+ * @param mask1 Masque de la première ligne source
+ * @param from2 Seconde ligne source (2 * width pixels)
+ * @param mask2 Masque de la seconde ligne source
+ * @param width Nombre de pixels en sortie
+ * @param channels Nombre de canaux par pixel
+ * @param gamma Table de gamma, de 1021 valeurs (entiers sur 8 bits uniquement)
+ */
+
+#ifdef __SSE2__
+
+inline void merge4 ( uint8_t* to, uint8_t* toMask, const uint8_t* from1, const uint8_t* mask1,
+                     const uint8_t* from2, const uint8_t* mask2, int width, int channels, const uint8_t* gamma ) {
+    __m128i z = _mm_setzero_si128();
+    // Sommes verticales des 16 pixels source d'un bloc, 4 canaux au plus
+    uint16_t sums[64] __attribute__ ( ( aligned ( 16 ) ) );
+
+    int i = 0;
+    // Blocs de 8 pixels en sortie
+    for ( ; i + 8 <= width; i += 8 ) {
+        __m128i n1 = _mm_cmpeq_epi8 ( _mm_loadu_si128 ( ( const __m128i* ) ( mask1 + 2*i ) ), z );
+        __m128i n2 = _mm_cmpeq_epi8 ( _mm_loadu_si128 ( ( const __m128i* ) ( mask2 + 2*i ) ), z );
+
+        if ( _mm_movemask_epi8 ( _mm_and_si128 ( n1, n2 ) ) == 0xFFFF ) continue; // Aucune donnée
+        if ( _mm_movemask_epi8 ( _mm_or_si128 ( n1, n2 ) ) != 0 ) {
+            // Bloc partiellement masqué
+            merge4_pixels ( to, toMask, from1, mask1, from2, mask2, i, i + 8, channels, gamma );
+            continue;
+        }
+
+        const uint8_t* f1 = from1 + 2*i*channels;
+        const uint8_t* f2 = from2 + 2*i*channels;
+        for ( int k = 0; k < channels; k++ ) {
+            __m128i a = _mm_loadu_si128 ( ( const __m128i* ) ( f1 + 16*k ) );
+            __m128i b = _mm_loadu_si128 ( ( const __m128i* ) ( f2 + 16*k ) );
+            _mm_store_si128 ( ( __m128i* ) ( sums + 16*k ), _mm_add_epi16 ( _mm_unpacklo_epi8 ( a, z ), _mm_unpacklo_epi8 ( b, z ) ) );
+            _mm_store_si128 ( ( __m128i* ) ( sums + 16*k + 8 ), _mm_add_epi16 ( _mm_unpackhi_epi8 ( a, z ), _mm_unpackhi_epi8 ( b, z ) ) );
+        }
+
+        // 4 pixels de donnée : la moyenne multipliée par 4 est la somme
+        uint8_t* out = to + i*channels;
+        for ( int s = 0; s < 8*channels; s += channels ) {
+            for ( int c = 0; c < channels; c++ ) {
+                out[s + c] = gamma[sums[2*s + c] + sums[2*s + channels + c]];
+            }
+        }
+        memset ( toMask + i, 255, 8 );
+    }
+
+    merge4_pixels ( to, toMask, from1, mask1, from2, mask2, i, width, channels, gamma );
+}
+
+// Canaux pairs et impairs de 4 pixels source consécutifs (dans a puis b)
+template<int C>
+inline void merge4_split ( __m128 a, __m128 b, __m128& even, __m128& odd ) {
+    switch ( C ) {
+    case 1:
+        even = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 2,0,2,0 ) );
+        odd = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 3,1,3,1 ) );
+        break;
+    case 2:
+        even = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 1,0,1,0 ) );
+        odd = _mm_shuffle_ps ( a, b, _MM_SHUFFLE ( 3,2,3,2 ) );
+        break;
+    case 4:
+        even = a;
+        odd = b;
+        break;
+    }
+}
+
+template<int C>
+inline void merge4 ( float* to, uint8_t* toMask, const float* from1, const uint8_t* mask1,
+                     const float* from2, const uint8_t* mask2, int width ) {
+    __m128i z = _mm_setzero_si128();
+    __m128 zero = _mm_setzero_ps();
+    // Division par 4 exacte par multiplication
+    __m128 quarter = _mm_set1_ps ( 0.25 );
+
+    int i = 0;
+    // Blocs de 4 pixels en sortie
+    for ( ; i + 4 <= width; i += 4 ) {
+        __m128i n1 = _mm_cmpeq_epi8 ( _mm_loadl_epi64 ( ( const __m128i* ) ( mask1 + 2*i ) ), z );
+        __m128i n2 = _mm_cmpeq_epi8 ( _mm_loadl_epi64 ( ( const __m128i* ) ( mask2 + 2*i ) ), z );
+
+        if ( ( _mm_movemask_epi8 ( _mm_and_si128 ( n1, n2 ) ) & 0xFF ) == 0xFF ) continue; // Aucune donnée
+        if ( _mm_movemask_epi8 ( _mm_or_si128 ( n1, n2 ) ) & 0xFF ) {
+            // Bloc partiellement masqué
+            merge4_pixels ( to, toMask, from1, mask1, from2, mask2, i, i + 4, C );
+            continue;
+        }
+
+        const float* f1 = from1 + 2*i*C;
+        const float* f2 = from2 + 2*i*C;
+        for ( int k = 0; k < C; k++ ) {
+            __m128 e1, o1, e2, o2;
+            merge4_split<C> ( _mm_loadu_ps ( f1 + 8*k ), _mm_loadu_ps ( f1 + 8*k + 4 ), e1, o1 );
+            merge4_split<C> ( _mm_loadu_ps ( f2 + 8*k ), _mm_loadu_ps ( f2 + 8*k + 4 ), e2, o2 );
+            // Même ordre d'addition que la version pixel par pixel, partant de 0
+            __m128 sum = _mm_add_ps ( _mm_add_ps ( _mm_add_ps ( _mm_add_ps ( zero, e1 ), o1 ), e2 ), o2 );
+            _mm_storeu_ps ( to + i*C + 4*k, _mm_mul_ps ( sum, quarter ) );
+        }
+        memset ( toMask + i, 255, 4 );
+    }
+
+    merge4_pixels ( to, toMask, from1, mask1, from2, mask2, i, width, C );
+}
+
+inline void merge4 ( float* to, uint8_t* toMask, const float* from1, const uint8_t* mask1,
+                     const float* from2, const uint8_t* mask2, int width, int channels ) {
+    switch ( channels ) {
+    case 1:
+        merge4<1> ( to, toMask, from1, mask1, from2, mask2, width );
+        break;
+    case 2:
+        merge4<2> ( to, toMask, from1, mask1, from2, mask2, width );
+        break;
+    case 4:
+        merge4<4> ( to, toMask, from1, mask1, from2, mask2, width );
+        break;
+    default:
+        merge4_pixels ( to, toMask, from1, mask1, from2, mask2, 0, width, channels );
+    }
+}
+
+#else // Version non SSE
+
+inline void merge4 ( uint8_t* to, uint8_t* toMask, const uint8_t* from1, const uint8_t* mask1,
+                     const uint8_t* from2, const uint8_t* mask2, int width, int channels, const uint8_t* gamma ) {
+    merge4_pixels ( to, toMask, from1, mask1, from2, mask2, 0, width, channels, gamma );
+}
+
+inline void merge4 ( float* to, uint8_t* toMask, const float* from1, const uint8_t* mask1,
+                     const float* from2, const uint8_t* mask2, int width, int channels ) {
+    merge4_pixels ( to, toMask, from1, mask1, from2, mask2, 0, width, channels );
+}
 #endif
 
 
+#endif
@@ -0,0 +1,121 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DecimatedImage.h"
+#include "ExtendedCompoundImage.h"
+#include "../cppunit/PatternImage.h"
+#include <sys/time.h>
+#include <vector>
+
+#include <iostream>
+using namespace std;
+
+/**
+ * Mesure de DecimatedImage face à la lecture historique de lignes entières, hors de la suite de tests par défaut (variable BENCHMARK).
+ * Les durées sont affichées sur la sortie d'erreur.
+ */
+class CppUnitDecimatedImageBenchmark : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitDecimatedImageBenchmark );
+
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+protected:
+
+    // Lecture historique : ligne source entière, allouée à chaque appel, puis sélection d'un pixel sur ratio
+    void referenceDecimated ( ExtendedCompoundImage* eci, uint8_t* buffer, int line, int ratio, int number ) {
+        int channels = eci->getChannels();
+        uint8_t* buffer_t = new uint8_t[eci->getWidth() * channels];
+        uint8_t* buffer_m = new uint8_t[eci->getWidth()];
+        eci->getline ( buffer_t, line * ratio );
+        ( ( Image* ) eci )->getMask()->getline ( buffer_m, line * ratio );
+        for ( int i = 0; i < number; i++ ) {
+            if ( buffer_m[i * ratio] ) memcpy ( buffer + i * channels, buffer_t + i * ratio * channels, channels );
+        }
+        delete [] buffer_t;
+        delete [] buffer_m;
+    }
+
+    void performance() {
+        int nodata[3] = { 0, 0, 0 };
+        const int size = 2048;
+        cerr << " -= DecimatedImage =-" << endl;
+
+        for ( int ratio = 2; ratio <= 16; ratio *= 2 ) {
+            // 4 images sources de size x size pixels, dont 2 masquées, côte à côte
+            std::vector<Image*> images;
+            for ( int i = 0; i < 4; i++ ) {
+                double xmin = ( i % 2 ) * size, ymax = 2 * size - ( i / 2 ) * size;
+                PatternImage* img = new PatternImage ( size, size, 3, BoundingBox<double> ( xmin, ymax - size, xmin + size, ymax ), false, i );
+                if ( i % 2 ) img->setMask ( new PatternImage ( size, size, 1, img->getBbox(), true, i ) );
+                images.push_back ( img );
+            }
+            ExtendedCompoundImageFactory ECIF;
+            ExtendedCompoundImage* eci = ECIF.createExtendedCompoundImage ( images, nodata, 0 );
+            eci->setMask ( new ExtendedCompoundMask ( eci ) );
+
+            int w = 2 * size / ratio;
+            double half = ratio / 2. - 0.5;
+            DecimatedImageFactory DIF;
+            DecimatedImage* di = DIF.createDecimatedImage ( eci, BoundingBox<double> ( -half, -half, 2 * size - half, 2 * size - half ), ratio, ratio, nodata );
+
+            uint8_t line[w * 3];
+            timeval BEGIN, NOW;
+
+            gettimeofday ( &BEGIN, NULL );
+            for ( int l = 0; l < w; l++ ) referenceDecimated ( eci, line, l, ratio, w );
+            gettimeofday ( &NOW, NULL );
+            double tr = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+
+            gettimeofday ( &BEGIN, NULL );
+            for ( int l = 0; l < w; l++ ) di->getline ( line, l );
+            gettimeofday ( &NOW, NULL );
+            double tm = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+
+            cerr << tr << "s -> " << tm << "s : " << w << " (x" << w << ") lines, ratio " << ratio << endl;
+            delete di;
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitDecimatedImageBenchmark );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitDecimatedImageBenchmark , "CppUnitDecimatedImageBenchmark" );
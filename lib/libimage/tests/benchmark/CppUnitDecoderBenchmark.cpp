@@ -0,0 +1,116 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "Decoder.h"
+#include "Data.h"
+#include "../cppunit/DecoderReference.h"
+#include <sys/time.h>
+#include <cstring>
+#include <vector>
+
+#include <iostream>
+using namespace std;
+using namespace DecoderReference;
+
+/**
+ * Mesure des durées de décodage PNG et DEFLATE, hors de la suite de tests par défaut (variable BENCHMARK).
+ * Les durées sont affichées sur la sortie d'erreur.
+ */
+class CppUnitDecoderBenchmark : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitDecoderBenchmark );
+
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    void setUp() {};
+
+    void tearDown() {};
+
+    void performance() {
+        const int width = 256, height = 256, channels = 3, loops = 500;
+        std::vector<uint8_t> raw = pattern ( width, height, channels );
+        std::vector<uint8_t> png = encodePng ( raw, width, height, channels, std::vector<int> ( 1, 1 ) );
+        std::vector<uint8_t> zip = encodeDeflate ( raw );
+        std::vector<uint8_t> buffer ( raw.size() );
+        cerr << " -= Decoder =-" << endl;
+
+        const char* names[2] = { "PNG", "DEFLATE" };
+        for ( int t = 0; t < 2; t++ ) {
+            std::vector<uint8_t>& enc = ( t ? zip : png );
+            timeval BEGIN, NOW;
+
+            // Décodage de la tuile entière dans un buffer alloué, puis recopie
+            gettimeofday ( &BEGIN, NULL );
+            for ( int i = 0; i < loops; i++ ) {
+                size_t size;
+                RawDataSource* source = new RawDataSource ( &enc[0], enc.size() );
+                const uint8_t* decoded = ( t ? DeflateDecoder::decode ( source, size ) : PngDecoder::decode ( source, size ) );
+                memcpy ( &buffer[0], decoded, size );
+                delete[] decoded;
+                delete source;
+            }
+            gettimeofday ( &NOW, NULL );
+            double ta = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+
+            // Décodage dans le buffer
+            gettimeofday ( &BEGIN, NULL );
+            for ( int i = 0; i < loops; i++ ) {
+                if ( t ) DeflateDecoder::decode ( &enc[0], enc.size(), &buffer[0], buffer.size() );
+                else PngDecoder::decode ( &enc[0], enc.size(), &buffer[0], buffer.size() );
+            }
+            gettimeofday ( &NOW, NULL );
+            double tb = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+
+            // Décodage des 64 premières lignes seulement
+            gettimeofday ( &BEGIN, NULL );
+            for ( int i = 0; i < loops; i++ ) {
+                if ( t ) DeflateDecoder::decode ( &enc[0], enc.size(), &buffer[0], 64 * width * channels );
+                else PngDecoder::decode ( &enc[0], enc.size(), &buffer[0], 64 * width * channels );
+            }
+            gettimeofday ( &NOW, NULL );
+            double tp = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+
+            cerr << names[t] << " : " << ta << "s -> " << tb << "s (" << tp << "s for 64 lines) : " << loops << " tiles " << width << "x" << height << endl;
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitDecoderBenchmark );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitDecoderBenchmark , "CppUnitDecoderBenchmark" );
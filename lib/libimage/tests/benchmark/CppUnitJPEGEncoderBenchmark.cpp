@@ -0,0 +1,104 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "JPEGEncoder.h"
+#include "../cppunit/OrthoImage.h"
+#include <sys/time.h>
+#include <vector>
+
+#include <iostream>
+using namespace std;
+
+/**
+ * Mesure du débit de JPEGEncoder et de la taille des tuiles pour chaque combinaison d'options, hors de la suite de tests par défaut (variable BENCHMARK).
+ * Les durées sont affichées sur la sortie d'erreur.
+ */
+class CppUnitJPEGEncoderBenchmark : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitJPEGEncoderBenchmark );
+
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+protected:
+
+    void performance() {
+        const int nbTiles = 200;
+        cerr << " -= JPEGEncoder (" << nbTiles << " tiles 256x256 RGB) =-" << endl;
+
+        const char* subsamplings[2] = { "4:2:0", "4:4:4" };
+        const char* dcts[3] = { "islow", "ifast", "float" };
+        for ( int quality = 75; quality <= 90; quality += 15 ) {
+            for ( int s = 0; s < 2; s++ ) {
+                for ( int d = 0; d < 3; d++ ) {
+                    for ( int optimize = 0; optimize <= 1; optimize++ ) {
+                        JpegOptions options;
+                        options.setQuality ( quality );
+                        options.setSubsampling ( subsamplings[s] );
+                        options.setDct ( dcts[d] );
+                        options.setOptimize ( optimize );
+
+                        // Les images sont créées hors de la mesure
+                        std::vector<Image*> tiles;
+                        for ( int i = 0; i < nbTiles; i++ ) tiles.push_back ( new OrthoImage ( 256, 256, 3, i % 8 ) );
+
+                        size_t size = 0;
+                        uint8_t buffer[1 << 16];
+                        timeval BEGIN, NOW;
+                        gettimeofday ( &BEGIN, NULL );
+                        for ( int i = 0; i < nbTiles; i++ ) {
+                            JPEGEncoder encoder ( tiles[i], options );
+                            while ( ! encoder.eof() ) size += encoder.read ( buffer, 1 << 16 );
+                        }
+                        gettimeofday ( &NOW, NULL );
+                        double t = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+
+                        cerr << t << "s, " << ( nbTiles * 256. * 256. * 3. / 1048576. ) / t << " Mo/s, " << size / nbTiles << " bytes per tile : "
+                             << options.toString() << endl;
+                    }
+                }
+            }
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitJPEGEncoderBenchmark );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitJPEGEncoderBenchmark , "CppUnitJPEGEncoderBenchmark" );
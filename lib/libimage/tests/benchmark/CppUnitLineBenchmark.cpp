@@ -0,0 +1,125 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "Line.h"
+#include "../cppunit/LineReference.h"
+#include <sys/time.h>
+#include <cstdlib>
+
+#include <iostream>
+using namespace std;
+using namespace LineReference;
+
+/**
+ * Mesure de Line (alpha prémultiplié) face à sa version précédente, hors de la suite de tests par défaut (variable BENCHMARK).
+ * Les durées sont affichées sur la sortie d'erreur.
+ */
+class CppUnitLineBenchmark : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitLineBenchmark );
+
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+
+public:
+    void setUp() {};
+
+protected:
+
+    RgbaLayers data;
+
+    template<typename L>
+    double chrono ( L& work, L& above, int mode, bool full, int nb_iteration ) {
+        uint8_t out[4*width];
+        timeval BEGIN, NOW;
+        gettimeofday ( &BEGIN, NULL );
+        for ( int i = 0; i < nb_iteration; i++ ) {
+            if ( full ) {
+                data.mergeLine ( work, above, out, mode, 3 );
+            } else if ( mode == 0 ) {
+                work.alphaBlending ( &above );
+            } else if ( mode == 1 ) {
+                work.multiply ( &above );
+            } else {
+                work.useMask ( &above );
+            }
+        }
+        gettimeofday ( &NOW, NULL );
+        double time = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+        return time;
+    }
+
+    void performance() {
+        int nb_iteration = 2000;
+        const char* modes[3] = {"alphaBlending", "multiply", "useMask"};
+        Line work ( width, 1 ), above ( width, 1 );
+        StraightLine refWork ( width ), refAbove ( width );
+        data.fill();
+        work.store ( data.images[0], data.masks[0], 4 );
+        above.store ( data.images[1], data.masks[1], 4 );
+        refWork.store ( data.images[0], data.masks[0], 4 );
+        refAbove.store ( data.images[1], data.masks[1], 4 );
+
+        // Multiplications répétées par du blanc opaque, pour ne pas tendre vers des flottants dénormalisés
+        uint8_t white[4*width];
+        memset ( white, 255, 4*width );
+
+        cerr << " -= Line merging : straight alpha -> premultiplied alpha =-" << endl;
+        for ( int mode = 0; mode < 3; mode++ ) {
+            if ( mode == 1 ) {
+                above.store ( white, data.masks[1], 4 );
+                refAbove.store ( white, data.masks[1], 4 );
+            }
+            double tr = chrono ( refWork, refAbove, mode, false, nb_iteration );
+            double tn = chrono ( work, above, mode, false, nb_iteration );
+            cerr << tr << "s -> " << tn << "s : " << nb_iteration << " (x" << width << ") " << modes[mode] << endl;
+        }
+        for ( int mode = 0; mode < 3; mode++ ) {
+            double tr = chrono ( refWork, refAbove, mode, true, nb_iteration / 10 );
+            double tn = chrono ( work, above, mode, true, nb_iteration / 10 );
+            cerr << tr << "s -> " << tn << "s : " << nb_iteration / 10 << " (x" << width << ") " << modes[mode]
+                 << " of " << layers << " RGBA layers, with store and write" << endl;
+        }
+        cerr << endl;
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitLineBenchmark );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitLineBenchmark , "CppUnitLineBenchmark" );
@@ -0,0 +1,117 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "Utils.h"
+#include "../cppunit/Merge4Reference.h"
+#include <sys/time.h>
+#include <cstdlib>
+
+#include <iostream>
+using namespace std;
+using namespace Merge4Reference;
+
+/**
+ * Mesure de merge4 face à la boucle historique de merge4tiff, hors de la suite de tests par défaut (variable BENCHMARK).
+ * Les durées sont affichées sur la sortie d'erreur.
+ */
+class CppUnitMerge4Benchmark : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitMerge4Benchmark );
+
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+
+public:
+    void setUp() {
+        initGamma ( gamma );
+    };
+
+protected:
+
+    uint8_t gamma[1024];
+
+    template<typename T>
+    double chrono ( bool ref, T* to, uint8_t* toMask, const T* from, const uint8_t* mask, int width, int channels, int nb_iteration ) {
+        timeval BEGIN, NOW;
+        gettimeofday ( &BEGIN, NULL );
+        for ( int i = 0; i < nb_iteration; i++ ) {
+            if ( ref ) reference ( to, toMask, from, mask, from + 2*width*channels, mask, width, channels, gamma );
+            else merge ( to, toMask, from, mask, from + 2*width*channels, mask, width, channels, gamma );
+        }
+        gettimeofday ( &NOW, NULL );
+        double time = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+        return time;
+    }
+
+    template<typename T>
+    void performance ( const char* type ) {
+        const int width = 2048;
+        int nb_iteration = 2000;
+        T* from = new T[4*width*4];
+        T* to = new T[width*4];
+        uint8_t mask[2*width];
+        uint8_t toMask[width];
+        for ( int i = 0; i < 4*width*4; i++ ) from[i] = rand() %256;
+
+        cerr << " -= merge4 " << type << " =-" << endl;
+        for ( int full = 1; full >= 0; full-- ) {
+            // Masque plein ou avec 10% de pixels de non-donnée, groupés
+            for ( int i = 0; i < 2*width; i++ ) mask[i] = ( full || ( i / 50 ) % 10 ) ? 255 : 0;
+            for ( int channels = 1; channels <= 4; channels++ ) {
+                double tr = chrono ( true, to, toMask, from, mask, width, channels, nb_iteration );
+                double tm = chrono ( false, to, toMask, from, mask, width, channels, nb_iteration );
+                cerr << tr << "s -> " << tm << "s : " << nb_iteration << " (x" << width << ") lines, " << channels << " channel(s), "
+                     << ( full ? "full mask" : "partial mask" ) << endl;
+            }
+        }
+        cerr << endl;
+
+        delete[] from;
+        delete[] to;
+    }
+
+    void performance() {
+        performance<uint8_t> ( "uint8" );
+        performance<float> ( "float" );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitMerge4Benchmark );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitMerge4Benchmark , "CppUnitMerge4Benchmark" );
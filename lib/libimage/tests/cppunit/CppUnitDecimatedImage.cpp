@@ -0,0 +1,197 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DecimatedImage.h"
+#include "ExtendedCompoundImage.h"
+#include "PatternImage.h"
+#include <cstdlib>
+#include <vector>
+
+#include <iostream>
+using namespace std;
+
+class CppUnitDecimatedImage : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitDecimatedImage );
+
+    CPPUNIT_TEST ( test_decimated );
+    CPPUNIT_TEST ( test_sampled );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+protected:
+
+    // Image composée d'images sources de 1 à 3 canaux, dont certaines masquées, qui se chevauchent
+    ExtendedCompoundImage* createCompound ( int channels, int* nodata, int nbImages, int size ) {
+        std::vector<Image*> images;
+        for ( int i = 0; i < nbImages; i++ ) {
+            int w = size / 2 + rand() % size;
+            int h = size / 2 + rand() % size;
+            double xmin = rand() % size;
+            double ymax = 1000. - rand() % size;
+            PatternImage* img = new PatternImage ( w, h, channels, BoundingBox<double> ( xmin, ymax - h, xmin + w, ymax ), false, i );
+            if ( rand() % 2 ) {
+                img->setMask ( new PatternImage ( w, h, 1, img->getBbox(), true, i ) );
+            }
+            images.push_back ( img );
+        }
+
+        ExtendedCompoundImageFactory ECIF;
+        ExtendedCompoundImage* eci = ECIF.createExtendedCompoundImage ( images, nodata, 0 );
+        eci->setMask ( new ExtendedCompoundMask ( eci ) );
+        return eci;
+    }
+
+    // Composition historique, pixel par pixel, référence des résultats
+    void referenceCompound ( ExtendedCompoundImage* eci, uint8_t* buffer, uint8_t* mask, int line, int* nodata ) {
+        int channels = eci->getChannels();
+        for ( int i = 0; i < eci->getWidth() * channels; i++ ) buffer[i] = nodata[i % channels];
+        memset ( mask, 0, eci->getWidth() );
+
+        for ( uint i = 0; i < eci->getImages()->size(); i++ ) {
+            Image* img = eci->getImages()->at ( i );
+            int ol, c0, c1, c2;
+            eci->getOffsets ( i, &ol, &c0, &c1, &c2 );
+            if ( line - ol < 0 || line - ol >= img->getHeight() ) continue;
+
+            uint8_t data[img->getWidth() * channels];
+            uint8_t dataMask[img->getWidth()];
+            img->getline ( data, line - ol );
+            if ( img->getMask() ) img->getMask()->getline ( dataMask, line - ol );
+            else memset ( dataMask, 255, img->getWidth() );
+
+            for ( int c = c0; c <= c1; c++ ) {
+                if ( dataMask[c - c0 + c2] ) {
+                    memcpy ( buffer + c * channels, data + ( c - c0 + c2 ) * channels, channels );
+                    mask[c] = 255;
+                }
+            }
+        }
+    }
+
+    void test_decimated() {
+        int nodata[3] = { 1, 2, 3 };
+        for ( int t = 0; t < 20; t++ ) {
+            int channels = 1 + rand() % 3;
+            ExtendedCompoundImage* eci = createCompound ( channels, nodata, 1 + rand() % 4, 100 );
+
+            // Décimation de facteur r, dont les centres de pixels sont alignés sur ceux de l'image composée et qui déborde de celle ci
+            int r = 2 + rand() % 4;
+            double xc = eci->getXmin() + 0.5 + ( rand() % ( 3 * r ) ) - r;
+            double yc = eci->getYmax() - 0.5 - ( rand() % ( 3 * r ) ) + r;
+            int w = ( eci->getWidth() + 2 * r ) / r;
+            int h = ( eci->getHeight() + 2 * r ) / r;
+            BoundingBox<double> bb ( xc - r / 2., yc + r / 2. - h * r, xc - r / 2. + w * r, yc + r / 2. );
+
+            DecimatedImageFactory DIF;
+            DecimatedImage* di = DIF.createDecimatedImage ( eci, bb, r, r, nodata );
+            CPPUNIT_ASSERT_MESSAGE ( "Decimated image creation", di != NULL );
+
+            uint8_t line[w * channels];
+            uint8_t ref[eci->getWidth() * channels];
+            uint8_t refMask[eci->getWidth()];
+
+            for ( int l = 0; l < h; l++ ) {
+                di->getline ( line, l );
+
+                int srcLine = eci->y2l ( bb.ymax - ( l + 0.5 ) * r );
+                if ( srcLine >= 0 && srcLine < eci->getHeight() ) referenceCompound ( eci, ref, refMask, srcLine, nodata );
+
+                for ( int c = 0; c < w; c++ ) {
+                    int srcCol = eci->x2c ( bb.xmin + ( c + 0.5 ) * r );
+                    bool data = ( srcLine >= 0 && srcLine < eci->getHeight() && srcCol >= 0 && srcCol < eci->getWidth() && refMask[srcCol] );
+                    for ( int s = 0; s < channels; s++ ) {
+                        int expected = ( data ? ref[srcCol * channels + s] : nodata[s] );
+                        CPPUNIT_ASSERT_EQUAL_MESSAGE ( "Decimated pixel", expected, ( int ) line[c * channels + s] );
+                    }
+                }
+            }
+
+            delete di;
+        }
+    }
+
+    // Une lecture échantillonnée doit être la sélection des pixels de la ligne entière, en 8 bits comme en flottant
+    void check_sampled ( Image* img ) {
+        int width = img->getWidth();
+        int channels = img->getChannels();
+        uint8_t full[width * channels];
+        uint8_t sampled[width * channels];
+        float sampledf[width * channels];
+
+        for ( int l = 0; l < img->getHeight(); l++ ) {
+            img->getline ( full, l );
+            int step = 1 + rand() % 7;
+            int offset = rand() % width;
+            int number = 1 + rand() % ( ( width - 1 - offset ) / step + 1 );
+
+            img->getSampledLine ( sampled, l, offset, step, number );
+            img->getSampledLine ( sampledf, l, offset, step, number );
+            for ( int i = 0; i < number; i++ ) {
+                for ( int s = 0; s < channels; s++ ) {
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE ( "Sampled pixel", full[ ( offset + i * step ) * channels + s], sampled[i * channels + s] );
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE ( "Sampled float pixel", ( float ) full[ ( offset + i * step ) * channels + s], sampledf[i * channels + s] );
+                }
+            }
+        }
+    }
+
+    void test_sampled() {
+        int nodata[3] = { 10, 20, 30 };
+        for ( int t = 0; t < 20; t++ ) {
+            ExtendedCompoundImage* eci = createCompound ( 1 + rand() % 3, nodata, 1 + rand() % 4, 100 );
+            check_sampled ( eci );
+            check_sampled ( ( ( Image* ) eci )->getMask() );
+
+            int r = 2 + rand() % 3;
+            double xc = eci->getXmin() + 0.5;
+            double yc = eci->getYmax() - 0.5;
+            int w = eci->getWidth() / r;
+            int h = eci->getHeight() / r;
+            DecimatedImageFactory DIF;
+            DecimatedImage* di = DIF.createDecimatedImage ( eci, BoundingBox<double> ( xc - r / 2., yc + r / 2. - h * r, xc - r / 2. + w * r, yc + r / 2. ), r, r, nodata );
+            check_sampled ( di );
+
+            delete di;
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitDecimatedImage );
@@ -0,0 +1,150 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "Decoder.h"
+#include "Data.h"
+#include "DecoderReference.h"
+#include <cstring>
+#include <vector>
+
+#include <iostream>
+using namespace std;
+using namespace DecoderReference;
+
+class CppUnitDecoder : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitDecoder );
+
+    CPPUNIT_TEST ( test_png );
+    CPPUNIT_TEST ( test_partial );
+    CPPUNIT_TEST ( test_deflate );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    void setUp() {};
+
+    void tearDown() {};
+
+    void test_png() {
+        const int width = 61, height = 37;
+        for ( int channels = 1; channels <= 4; channels++ ) {
+            std::vector<uint8_t> raw = pattern ( width, height, channels );
+            for ( int f = 0; f <= 5; f++ ) {
+                // Un seul filtre pour toute la tuile (0 à 4), ou tous les filtres en alternance (5)
+                std::vector<int> filters;
+                if ( f < 5 ) filters.push_back ( f );
+                else for ( int i = 0; i < 5; i++ ) filters.push_back ( ( i * 3 ) % 5 );
+                std::vector<uint8_t> png = encodePng ( raw, width, height, channels, filters );
+
+                size_t size;
+                RawDataSource* source = new RawDataSource ( &png[0], png.size() );
+                DataSourceDecoder<PngDecoder> decoder ( source );
+                const uint8_t* decoded = decoder.getData ( size );
+                CPPUNIT_ASSERT_MESSAGE ( "PNG decoding", decoded != NULL );
+                CPPUNIT_ASSERT_EQUAL_MESSAGE ( "PNG decoded size", raw.size(), size );
+                CPPUNIT_ASSERT_MESSAGE ( "PNG decoded pixels", memcmp ( decoded, &raw[0], size ) == 0 );
+
+                std::vector<uint8_t> buffer ( raw.size() );
+                CPPUNIT_ASSERT_EQUAL_MESSAGE ( "PNG decoded size in buffer", raw.size(), PngDecoder::decode ( &png[0], png.size(), &buffer[0], buffer.size() ) );
+                CPPUNIT_ASSERT_MESSAGE ( "PNG decoded pixels in buffer", buffer == raw );
+            }
+        }
+
+        // Palette non gérée
+        std::vector<uint8_t> raw = pattern ( width, height, 1 );
+        std::vector<uint8_t> png = encodePng ( raw, width, height, 1, std::vector<int> ( 1, 0 ) );
+        png[25] = 3;
+        std::vector<uint8_t> buffer ( raw.size() );
+        CPPUNIT_ASSERT_EQUAL_MESSAGE ( "PNG palette refused", ( size_t ) 0, PngDecoder::decode ( &png[0], png.size(), &buffer[0], buffer.size() ) );
+    }
+
+    void test_partial() {
+        const int width = 256, height = 256, channels = 3;
+        int linesize = width * channels;
+        std::vector<uint8_t> raw = pattern ( width, height, channels );
+        std::vector<int> filters;
+        for ( int i = 0; i < 5; i++ ) filters.push_back ( i );
+        std::vector<uint8_t> png = encodePng ( raw, width, height, channels, filters );
+        std::vector<uint8_t> zip = encodeDeflate ( raw );
+
+        int lines[4] = { 1, 17, 100, 255 };
+        for ( int i = 0; i < 4; i++ ) {
+            // Le buffer n'est pas un multiple de la taille d'une ligne : seules les lignes complètes sont décodées en PNG
+            size_t needed = lines[i] * linesize + 5;
+            std::vector<uint8_t> buffer ( needed + 16, 0xAB );
+
+            CPPUNIT_ASSERT_EQUAL_MESSAGE ( "PNG partial size", ( size_t ) lines[i] * linesize, PngDecoder::decode ( &png[0], png.size(), &buffer[0], needed ) );
+            CPPUNIT_ASSERT_MESSAGE ( "PNG partial pixels", memcmp ( &buffer[0], &raw[0], lines[i] * linesize ) == 0 );
+            CPPUNIT_ASSERT_EQUAL_MESSAGE ( "PNG partial stop", ( uint8_t ) 0xAB, buffer[lines[i] * linesize] );
+
+            CPPUNIT_ASSERT_EQUAL_MESSAGE ( "DEFLATE partial size", needed, DeflateDecoder::decode ( &zip[0], zip.size(), &buffer[0], needed ) );
+            CPPUNIT_ASSERT_MESSAGE ( "DEFLATE partial pixels", memcmp ( &buffer[0], &raw[0], needed ) == 0 );
+            CPPUNIT_ASSERT_EQUAL_MESSAGE ( "DEFLATE partial stop", ( uint8_t ) 0xAB, buffer[needed] );
+
+            // Même chose à travers une source de données
+            DataSourceDecoder<PngDecoder> decoder ( new RawDataSource ( &png[0], png.size() ), lines[i] * linesize );
+            size_t size;
+            const uint8_t* decoded = decoder.getData ( size );
+            CPPUNIT_ASSERT_EQUAL_MESSAGE ( "PNG partial data source size", ( size_t ) lines[i] * linesize, size );
+            CPPUNIT_ASSERT_MESSAGE ( "PNG partial data source pixels", memcmp ( decoded, &raw[0], size ) == 0 );
+        }
+    }
+
+    void test_deflate() {
+        std::vector<uint8_t> raw = pattern ( 256, 256, 4 );
+        std::vector<uint8_t> zip = encodeDeflate ( raw );
+
+        size_t size;
+        DataSourceDecoder<DeflateDecoder> decoder ( new RawDataSource ( &zip[0], zip.size() ) );
+        const uint8_t* decoded = decoder.getData ( size );
+        CPPUNIT_ASSERT_MESSAGE ( "DEFLATE decoding", decoded != NULL );
+        CPPUNIT_ASSERT_EQUAL_MESSAGE ( "DEFLATE decoded size", raw.size(), size );
+        CPPUNIT_ASSERT_MESSAGE ( "DEFLATE decoded pixels", memcmp ( decoded, &raw[0], size ) == 0 );
+
+        // Buffer plus grand que la tuile : la fin du flux arrête le décodage
+        std::vector<uint8_t> buffer ( raw.size() + 100 );
+        CPPUNIT_ASSERT_EQUAL_MESSAGE ( "DEFLATE decoded size in buffer", raw.size(), DeflateDecoder::decode ( &zip[0], zip.size(), &buffer[0], buffer.size() ) );
+        CPPUNIT_ASSERT_MESSAGE ( "DEFLATE decoded pixels in buffer", memcmp ( &buffer[0], &raw[0], raw.size() ) == 0 );
+
+        // Flux corrompu
+        zip[0] = 0;
+        CPPUNIT_ASSERT_EQUAL_MESSAGE ( "DEFLATE corrupted", ( size_t ) 0, DeflateDecoder::decode ( &zip[0], zip.size(), &buffer[0], buffer.size() ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitDecoder );
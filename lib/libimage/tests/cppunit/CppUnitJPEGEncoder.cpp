@@ -0,0 +1,196 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "JPEGEncoder.h"
+#include "OrthoImage.h"
+#include <cstdlib>
+#include <vector>
+
+#include <iostream>
+using namespace std;
+
+class CppUnitJPEGEncoder : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitJPEGEncoder );
+
+    CPPUNIT_TEST ( test_default );
+    CPPUNIT_TEST ( test_options );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+protected:
+
+    // Lit tout le flux, par morceaux de taille donnée
+    std::vector<uint8_t> encode ( Image* image, const JpegOptions& options, size_t chunk ) {
+        JPEGEncoder encoder ( image, options );
+        std::vector<uint8_t> out;
+        uint8_t buffer[chunk];
+        while ( ! encoder.eof() ) {
+            size_t size = encoder.read ( buffer, chunk );
+            CPPUNIT_ASSERT_MESSAGE ( "Empty read before end of stream", size > 0 );
+            out.insert ( out.end(), buffer, buffer + size );
+        }
+        return out;
+    }
+
+    // Compression historique, ligne à ligne, avec les paramètres par défaut de la libjpeg
+    std::vector<uint8_t> reference ( Image* image ) {
+        jpeg_compress_struct cinfo;
+        jpeg_error_mgr jerr;
+        cinfo.err = jpeg_std_error ( &jerr );
+        jpeg_create_compress ( &cinfo );
+        unsigned char* mem = NULL;
+        unsigned long memSize = 0;
+        jpeg_mem_dest ( &cinfo, &mem, &memSize );
+        cinfo.image_width = image->getWidth();
+        cinfo.image_height = image->getHeight();
+        cinfo.input_components = image->getChannels();
+        cinfo.in_color_space = ( image->getChannels() == 1 ? JCS_GRAYSCALE : ( image->getChannels() == 3 ? JCS_RGB : JCS_EXT_RGBX ) );
+        jpeg_set_defaults ( &cinfo );
+        jpeg_start_compress ( &cinfo, true );
+        uint8_t line[image->getWidth() * image->getChannels()];
+        JSAMPROW row = line;
+        while ( cinfo.next_scanline < cinfo.image_height ) {
+            image->getline ( line, cinfo.next_scanline );
+            jpeg_write_scanlines ( &cinfo, &row, 1 );
+        }
+        jpeg_finish_compress ( &cinfo );
+        std::vector<uint8_t> out ( mem, mem + memSize );
+        jpeg_destroy_compress ( &cinfo );
+        free ( mem );
+        return out;
+    }
+
+    // Décode l'image et retourne l'écart moyen aux valeurs d'origine
+    double decodeError ( std::vector<uint8_t>& jpeg, Image* image, int* hSampling, int* vSampling ) {
+        jpeg_decompress_struct dinfo;
+        jpeg_error_mgr jerr;
+        dinfo.err = jpeg_std_error ( &jerr );
+        jpeg_create_decompress ( &dinfo );
+        jpeg_mem_src ( &dinfo, &jpeg[0], jpeg.size() );
+        jpeg_read_header ( &dinfo, true );
+        *hSampling = dinfo.comp_info[0].h_samp_factor;
+        *vSampling = dinfo.comp_info[0].v_samp_factor;
+        if ( image->getChannels() == 4 ) dinfo.out_color_space = JCS_EXT_RGBX;
+        jpeg_start_decompress ( &dinfo );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) dinfo.output_width, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) dinfo.output_height, image->getHeight() );
+
+        int channels = image->getChannels();
+        uint8_t decoded[image->getWidth() * channels];
+        uint8_t original[image->getWidth() * channels];
+        JSAMPROW row = decoded;
+        double error = 0;
+        while ( dinfo.output_scanline < dinfo.output_height ) {
+            int l = dinfo.output_scanline;
+            jpeg_read_scanlines ( &dinfo, &row, 1 );
+            image->getline ( original, l );
+            // Le canal X d'une image RGBX n'est pas encodé
+            for ( int i = 0; i < image->getWidth() * channels; i++ ) {
+                if ( channels != 4 || i % 4 != 3 ) error += abs ( decoded[i] - original[i] );
+            }
+        }
+        jpeg_finish_decompress ( &dinfo );
+        jpeg_destroy_decompress ( &dinfo );
+        return error / ( image->getWidth() * image->getHeight() * ( channels == 4 ? 3 : channels ) );
+    }
+
+    void test_default() {
+        int sizes[3][2] = { { 256, 256 }, { 333, 77 }, { 1000, 3 } };
+        for ( int s = 0; s < 3; s++ ) {
+            for ( int channels = 1; channels <= 4; channels++ ) {
+                if ( channels == 2 ) continue;
+                OrthoImage* image = new OrthoImage ( sizes[s][0], sizes[s][1], channels, s );
+                std::vector<uint8_t> ref = reference ( image );
+                // Les paramètres par défaut donnent le même flux que la compression historique, quelle que soit la taille des lectures
+                size_t chunks[3] = { 7, 1000, 1 << 20 };
+                for ( int c = 0; c < 3; c++ ) {
+                    JpegOptions options;
+                    std::vector<uint8_t> out = encode ( new OrthoImage ( sizes[s][0], sizes[s][1], channels, s ), options, chunks[c] );
+                    CPPUNIT_ASSERT_MESSAGE ( "Default JPEG stream differs from libjpeg's one", out == ref );
+                }
+                delete image;
+            }
+        }
+    }
+
+    void test_options() {
+        JpegOptions options;
+        CPPUNIT_ASSERT ( ! options.setQuality ( 0 ) );
+        CPPUNIT_ASSERT ( ! options.setQuality ( 101 ) );
+        CPPUNIT_ASSERT ( ! options.setSubsampling ( "4:1:1" ) );
+        CPPUNIT_ASSERT ( ! options.setDct ( "fastest" ) );
+
+        OrthoImage* image = new OrthoImage ( 256, 256, 3, 0 );
+        const char* subsamplings[3] = { "4:2:0", "4:2:2", "4:4:4" };
+        int expected[3][2] = { { 2, 2 }, { 2, 1 }, { 1, 1 } };
+        const char* dcts[3] = { "islow", "ifast", "float" };
+
+        for ( int s = 0; s < 3; s++ ) {
+            for ( int d = 0; d < 3; d++ ) {
+                size_t previousSize = 0;
+                for ( int quality = 50; quality <= 95; quality += 15 ) {
+                    CPPUNIT_ASSERT ( options.setQuality ( quality ) );
+                    CPPUNIT_ASSERT ( options.setSubsampling ( subsamplings[s] ) );
+                    CPPUNIT_ASSERT ( options.setDct ( dcts[d] ) );
+                    options.setOptimize ( false );
+                    std::vector<uint8_t> out = encode ( new OrthoImage ( 256, 256, 3, 0 ), options, 4096 );
+                    options.setOptimize ( true );
+                    std::vector<uint8_t> optimized = encode ( new OrthoImage ( 256, 256, 3, 0 ), options, 4096 );
+
+                    int h, v;
+                    double error = decodeError ( out, image, &h, &v );
+                    CPPUNIT_ASSERT_EQUAL ( expected[s][0], h );
+                    CPPUNIT_ASSERT_EQUAL ( expected[s][1], v );
+                    CPPUNIT_ASSERT_MESSAGE ( "Decoded JPEG too far from the original image", error < 8. );
+                    // Des tables optimisées ne changent pas les pixels, seulement la taille
+                    CPPUNIT_ASSERT_EQUAL ( error, decodeError ( optimized, image, &h, &v ) );
+                    CPPUNIT_ASSERT ( optimized.size() <= out.size() );
+                    // La taille croît avec la qualité
+                    CPPUNIT_ASSERT ( out.size() > previousSize );
+                    previousSize = out.size();
+                }
+            }
+        }
+        delete image;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitJPEGEncoder );
@@ -0,0 +1,290 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "Jpeg2000Image.h"
+#include "Jpeg2000_library_config.h"
+#include "BoundingBox.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+#ifdef KDU_USE
+#include "kdu_file_io.h"
+#include "kdu_params.h"
+#include "kdu_stripe_compressor.h"
+#else
+#include "openjpeg.h"
+#endif
+
+/**
+ * Lecture d'images JPEG2000 (openjpeg ou kakadu selon la compilation) : image complète, fenêtre de lecture et niveau de résolution réduit
+ */
+class CppUnitJpeg2000Image : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitJpeg2000Image );
+
+    CPPUNIT_TEST ( test_full );
+    CPPUNIT_TEST ( test_window );
+    CPPUNIT_TEST ( test_reduced_window );
+    CPPUNIT_TEST ( test_restrict_twice );
+    CPPUNIT_TEST ( test_out_of_range );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    static const int width = 300;
+    static const int height = 600;
+    static const int channels = 3;
+    // Deux niveaux de décomposition : trois niveaux de résolution disponibles
+    static const int levels = 2;
+
+    char filename[64];
+    std::vector<uint8_t> raw;
+
+    void setUp() {
+        raw.resize ( width * height * channels );
+        for ( int l = 0; l < height; l++ )
+            for ( int c = 0; c < width; c++ )
+                for ( int s = 0; s < channels; s++ )
+                    raw[ ( l * width + c ) * channels + s] = ( ( l / 4 ) * 37 + ( c / 3 ) * 11 + s * 53 + ( ( l * c ) % 7 ) ) % 256;
+
+        strcpy ( filename, "/tmp/CppUnitJpeg2000ImageXXXXXX" );
+        int fd = mkstemp ( filename );
+        CPPUNIT_ASSERT_MESSAGE ( "Cannot create temporary file", fd >= 0 );
+        close ( fd );
+        CPPUNIT_ASSERT_MESSAGE ( "Cannot write JPEG2000 file", writeJ2K ( filename ) );
+    };
+
+    void tearDown() {
+        unlink ( filename );
+    };
+
+    /**
+     * Écrit #raw en un flux JPEG2000 brut (J2K), sans perte et en tuiles de 128 pixels, pour que les bandes lues soient à cheval sur plusieurs tuiles
+     */
+    bool writeJ2K ( const char* path ) {
+#ifdef KDU_USE
+        siz_params siz;
+        siz.set ( Scomponents, 0, 0, channels );
+        siz.set ( Sdims, 0, 0, height );
+        siz.set ( Sdims, 0, 1, width );
+        siz.set ( Sprecision, 0, 0, 8 );
+        siz.set ( Ssigned, 0, 0, false );
+        siz.parse_string ( "Stiles={128,128}" );
+        kdu_params* sizRef = &siz;
+        sizRef->finalize();
+
+        kdu_simple_file_target target;
+        target.open ( path );
+
+        kdu_codestream codestream;
+        codestream.create ( &siz, &target );
+        codestream.access_siz()->parse_string ( "Creversible=yes" );
+        char clevels[32];
+        sprintf ( clevels, "Clevels=%d", levels );
+        codestream.access_siz()->parse_string ( clevels );
+        codestream.access_siz()->finalize_all();
+
+        // Sans décalages ni pas précisés, les canaux sont entrelacés dans le tampon
+        kdu_stripe_compressor compressor;
+        compressor.start ( codestream );
+        int heights[channels];
+        for ( int s = 0; s < channels; s++ ) heights[s] = height;
+        compressor.push_stripe ( &raw[0], heights );
+        compressor.finish();
+
+        codestream.destroy();
+        target.close();
+        return true;
+#else
+        opj_cparameters_t parameters;
+        opj_set_default_encoder_parameters ( &parameters );
+        parameters.tcp_numlayers = 1;
+        parameters.tcp_rates[0] = 0;
+        parameters.cp_disto_alloc = 1;
+        parameters.numresolution = levels + 1;
+        parameters.tile_size_on = OPJ_TRUE;
+        parameters.cp_tdx = 128;
+        parameters.cp_tdy = 128;
+
+        opj_image_cmptparm_t cmptparms[channels];
+        memset ( cmptparms, 0, sizeof ( cmptparms ) );
+        for ( int s = 0; s < channels; s++ ) {
+            cmptparms[s].dx = cmptparms[s].dy = 1;
+            cmptparms[s].w = width;
+            cmptparms[s].h = height;
+            cmptparms[s].prec = cmptparms[s].bpp = 8;
+            cmptparms[s].sgnd = 0;
+        }
+
+        opj_image_t* image = opj_image_create ( channels, cmptparms, OPJ_CLRSPC_SRGB );
+        if ( ! image ) return false;
+        image->x0 = image->y0 = 0;
+        image->x1 = width;
+        image->y1 = height;
+        for ( int i = 0; i < width * height; i++ )
+            for ( int s = 0; s < channels; s++ )
+                image->comps[s].data[i] = raw[i * channels + s];
+
+        opj_codec_t* codec = opj_create_compress ( OPJ_CODEC_J2K );
+        opj_stream_t* stream = NULL;
+        bool ok = opj_setup_encoder ( codec, &parameters, image );
+        if ( ok ) {
+            stream = opj_stream_create_default_file_stream ( path, OPJ_FALSE );
+            ok = stream && opj_start_compress ( codec, image, stream ) && opj_encode ( codec, stream ) && opj_end_compress ( codec, stream );
+        }
+
+        if ( stream ) opj_stream_destroy ( stream );
+        opj_destroy_codec ( codec );
+        opj_image_destroy ( image );
+        return ok;
+#endif
+    }
+
+    Jpeg2000Image* open() {
+        Jpeg2000ImageFactory factory;
+        Jpeg2000Image* image = factory.createJpeg2000ImageToRead ( filename, BoundingBox<double> ( 0, 0, width, height ), 1., 1. );
+        CPPUNIT_ASSERT_MESSAGE ( "Cannot open JPEG2000 file", image != NULL );
+        return image;
+    }
+
+    /**
+     * Compare la ligne lue aux pixels [col0, col0 + image->getWidth() [ de la ligne row de l'image source
+     */
+    void checkLine ( Jpeg2000Image* image, int line, int row, int col0 ) {
+        std::vector<uint8_t> buffer ( image->getWidth() * channels );
+        CPPUNIT_ASSERT_EQUAL ( image->getWidth() * channels, image->getline ( &buffer[0], line ) );
+        CPPUNIT_ASSERT_MESSAGE ( "Line " + std::to_string ( line ) + " differs from source",
+                                 memcmp ( &buffer[0], &raw[ ( row * width + col0 ) * channels], buffer.size() ) == 0 );
+    }
+
+    void test_full() {
+        Jpeg2000Image* image = open();
+        CPPUNIT_ASSERT_EQUAL ( width, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( height, image->getHeight() );
+        CPPUNIT_ASSERT_EQUAL ( channels, image->getChannels() );
+
+        for ( int l = 0; l < height; l++ ) checkLine ( image, l, l, 0 );
+
+        // Retour en arrière : le décodeur ouvert doit pouvoir redécoder une bande précédente
+        checkLine ( image, 0, 0, 0 );
+        checkLine ( image, height - 1, height - 1, 0 );
+
+        delete image;
+    }
+
+    void test_window() {
+        Jpeg2000Image* image = open();
+
+        // Colonnes 50 à 249, lignes 100 à 499
+        CPPUNIT_ASSERT ( image->restrictReading ( BoundingBox<double> ( 50, 100, 250, 500 ), 1., 1. ) );
+        CPPUNIT_ASSERT_EQUAL ( 200, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( 400, image->getHeight() );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 50., image->getBbox().xmin, 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 500., image->getBbox().ymax, 1e-9 );
+
+        for ( int l = 0; l < image->getHeight(); l++ ) checkLine ( image, l, 100 + l, 50 );
+
+        delete image;
+    }
+
+    void test_reduced_window() {
+        // Référence : image entière décodée au niveau de résolution réduit d'un facteur 2
+        Jpeg2000Image* full = open();
+        CPPUNIT_ASSERT ( full->restrictReading ( BoundingBox<double> ( 0, 0, width, height ), 2., 2. ) );
+        CPPUNIT_ASSERT_EQUAL ( width / 2, full->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( height / 2, full->getHeight() );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2., full->getResX(), 1e-9 );
+
+        std::vector<uint8_t> reduced ( ( width / 2 ) * ( height / 2 ) * channels );
+        for ( int l = 0; l < height / 2; l++ ) {
+            CPPUNIT_ASSERT_EQUAL ( ( width / 2 ) * channels, full->getline ( &reduced[l * ( width / 2 ) * channels], l ) );
+        }
+        delete full;
+
+        // Une résolution de 2.5 demandée ne permet pas de réduire d'un facteur 4 : on lit la réduction d'un facteur 2
+        Jpeg2000Image* image = open();
+        CPPUNIT_ASSERT ( image->restrictReading ( BoundingBox<double> ( 50, 100, 250, 500 ), 2.5, 2.5 ) );
+        CPPUNIT_ASSERT_EQUAL ( 100, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( 200, image->getHeight() );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 2., image->getResX(), 1e-9 );
+
+        std::vector<uint8_t> buffer ( 100 * channels );
+        for ( int l = 0; l < 200; l++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 100 * channels, image->getline ( &buffer[0], l ) );
+            // La fenêtre commence à la ligne 100 et à la colonne 50 pleine résolution, soit 50 et 25 au niveau réduit
+            CPPUNIT_ASSERT_MESSAGE ( "Reduced line " + std::to_string ( l ) + " differs from the full reduced decoding",
+                                     memcmp ( &buffer[0], &reduced[ ( ( 50 + l ) * ( width / 2 ) + 25 ) * channels], buffer.size() ) == 0 );
+        }
+        delete image;
+    }
+
+    void test_restrict_twice() {
+        Jpeg2000Image* image = open();
+        CPPUNIT_ASSERT ( image->restrictReading ( BoundingBox<double> ( 50, 100, 250, 500 ), 1., 1. ) );
+
+        // La seconde restriction est ignorée : la fenêtre et le décalage dans la source restent ceux de la première
+        CPPUNIT_ASSERT ( image->restrictReading ( BoundingBox<double> ( 100, 200, 200, 400 ), 1., 1. ) );
+        CPPUNIT_ASSERT_EQUAL ( 200, image->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( 400, image->getHeight() );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 50., image->getBbox().xmin, 1e-9 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 500., image->getBbox().ymax, 1e-9 );
+
+        for ( int l = 0; l < image->getHeight(); l++ ) checkLine ( image, l, 100 + l, 50 );
+
+        delete image;
+    }
+
+    void test_out_of_range() {
+        Jpeg2000Image* image = open();
+        CPPUNIT_ASSERT ( image->restrictReading ( BoundingBox<double> ( 50, 100, 250, 500 ), 1., 1. ) );
+
+        std::vector<uint8_t> buffer ( width * channels );
+        CPPUNIT_ASSERT_EQUAL ( 0, image->getline ( &buffer[0], -1 ) );
+        CPPUNIT_ASSERT_EQUAL ( 0, image->getline ( &buffer[0], image->getHeight() ) );
+
+        // Une erreur n'empêche pas de lire ensuite les lignes valides
+        checkLine ( image, image->getHeight() - 1, 499, 50 );
+
+        delete image;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitJpeg2000Image );
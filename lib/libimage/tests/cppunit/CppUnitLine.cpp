@@ -0,0 +1,91 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "Line.h"
+#include "LineReference.h"
+#include <cstdlib>
+
+#include <iostream>
+using namespace std;
+using namespace LineReference;
+
+class CppUnitLine : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitLine );
+
+    CPPUNIT_TEST ( test_merge );
+    CPPUNIT_TEST_SUITE_END();
+
+
+public:
+    void setUp() {};
+
+protected:
+
+    RgbaLayers data;
+
+    void test_merge() {
+        Line work ( width, 1 ), above ( width, 1 );
+        StraightLine refWork ( width ), refAbove ( width );
+        uint8_t out[4*width], outRef[4*width];
+
+        for ( int k = 0; k < 20; k++ ) {
+            data.fill();
+            for ( int mode = 0; mode < 3; mode++ ) {
+                // Composition sur du noir : mêmes valeurs, à l'arrondi près
+                data.mergeLine ( work, above, out, mode, 3 );
+                data.mergeLine ( refWork, refAbove, outRef, mode, 3 );
+                for ( int i = 0; i < 3*width; i++ ) CPPUNIT_ASSERT ( abs ( out[i] - outRef[i] ) <= 1 );
+
+                // Avec alpha : les couleurs des pixels transparents ne sont plus conservées
+                data.mergeLine ( work, above, out, mode, 4 );
+                data.mergeLine ( refWork, refAbove, outRef, mode, 4 );
+                for ( int i = 0; i < width; i++ ) {
+                    CPPUNIT_ASSERT ( abs ( out[4*i+3] - outRef[4*i+3] ) <= 1 );
+                    if ( outRef[4*i+3] < 3 ) continue;
+                    // Plus l'alpha est faible, moins la couleur non associée est précise
+                    for ( int c = 0; c < 3; c++ ) CPPUNIT_ASSERT ( abs ( out[4*i+c] - outRef[4*i+c] ) <= 1 + 255 / outRef[4*i+3] );
+                }
+            }
+        }
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitLine );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitLine , "CppUnitLine" );
@@ -0,0 +1,120 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "Utils.h"
+#include "Merge4Reference.h"
+#include <cstdlib>
+
+using namespace Merge4Reference;
+
+
+class CppUnitMerge4 : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitMerge4 );
+
+    CPPUNIT_TEST ( test_merge4_uint8 );
+    CPPUNIT_TEST ( test_merge4_float );
+    CPPUNIT_TEST_SUITE_END();
+
+
+public:
+    void setUp() {
+        initGamma ( gamma );
+    };
+
+protected:
+
+    uint8_t gamma[1024];
+
+    // Masque par plages, comme en bord de données, ou pixel par pixel
+    void randomMask ( uint8_t* mask, int length ) {
+        int mode = rand() %3;
+        for ( int i = 0; i < length; i++ ) {
+            if ( mode == 0 ) mask[i] = 255;
+            else if ( mode == 1 ) mask[i] = ( rand() %4 ) ? 255 : 0;
+            else mask[i] = ( ( i / 37 ) % 2 ) ? 255 : 0;
+        }
+    }
+
+    template<typename T>
+    void compare ( T* data1, T* data2, int length ) {
+        const int width = 300;
+        uint8_t mask1[2*width], mask2[2*width];
+        T out[4*width], outRef[4*width];
+        uint8_t outMask[width], outMaskRef[width];
+
+        for ( int k = 0; k < 1000; k++ ) {
+            int channels = 1 + rand() %4;
+            int w = rand() %width;
+            int d = rand() %4;
+            randomMask ( mask1, 2*width );
+            randomMask ( mask2, 2*width );
+            for ( int i = 0; i < 4*width; i++ ) out[i] = outRef[i] = data1[length - 1 - i];
+            memset ( outMask, 0, width );
+            memset ( outMaskRef, 0, width );
+
+            merge ( out, outMask, data1 + d, mask1, data2 + d, mask2, w, channels, gamma );
+            reference ( outRef, outMaskRef, data1 + d, mask1, data2 + d, mask2, w, channels, gamma );
+
+            CPPUNIT_ASSERT ( memcmp ( out, outRef, 4*width*sizeof ( T ) ) == 0 );
+            CPPUNIT_ASSERT ( memcmp ( outMask, outMaskRef, width ) == 0 );
+        }
+    }
+
+    void test_merge4_uint8() {
+        uint8_t data1[3000], data2[3000];
+        for ( int i = 0; i < 3000; i++ ) {
+            data1[i] = rand() %256;
+            data2[i] = ( i % 5 ) ? 255 : rand() %256;
+        }
+        compare ( data1, data2, 3000 );
+    }
+
+    void test_merge4_float() {
+        float data1[3000], data2[3000];
+        for ( int i = 0; i < 3000; i++ ) {
+            data1[i] = float ( rand() ) / float ( RAND_MAX ) * 4000. - 500.;
+            data2[i] = ( i % 7 ) ? float ( rand() %1000 ) * 0.1 : -0.;
+        }
+        compare ( data1, data2, 3000 );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitMerge4 );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitMerge4 , "CppUnitMerge4" );
@@ -0,0 +1,102 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include "Metrics.h"
+
+class CppUnitMetrics : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitMetrics );
+    CPPUNIT_TEST ( bucketBounds );
+    CPPUNIT_TEST ( registry );
+    CPPUNIT_TEST ( prometheusText );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void bucketBounds();
+    void registry();
+    void prometheusText();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitMetrics );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitMetrics, "CppUnitMetrics" );
+
+void CppUnitMetrics::bucketBounds() {
+    // Chaque durée est strictement inférieure à la borne de son intervalle, et supérieure ou égale à celle du précédent
+    for ( uint64_t us = 0; us < 100000000; us = us * 5 / 4 + 1 ) {
+        int index = MetricsHistogram::getBucketIndex ( us );
+        uint64_t bound = MetricsHistogram::getBucketBound ( index );
+        CPPUNIT_ASSERT ( bound == 0 || us < bound );
+        if ( index > 0 ) CPPUNIT_ASSERT ( us >= MetricsHistogram::getBucketBound ( index - 1 ) );
+    }
+    CPPUNIT_ASSERT_EQUAL ( METRICS_BUCKETS - 1, MetricsHistogram::getBucketIndex ( ( uint64_t ) 1 << 40 ) );
+}
+
+void CppUnitMetrics::registry() {
+    MetricsHistogram* h1 = Metrics::getStage ( "decode", "format", "png" );
+    MetricsHistogram* h2 = Metrics::getStage ( "decode", "format", "png" );
+    MetricsHistogram* h3 = Metrics::getStage ( "decode", "format", "jpeg" );
+
+    CPPUNIT_ASSERT ( h1 != NULL );
+    CPPUNIT_ASSERT ( h1 == h2 );
+    CPPUNIT_ASSERT ( h1 != h3 );
+
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "layer=\"a\\\"b\"" ), Metrics::label ( "layer", "a\"b" ) );
+}
+
+void CppUnitMetrics::prometheusText() {
+    MetricsHistogram* h = Metrics::getHistogram ( "test_duration_seconds", Metrics::label ( "stage", "test" ) );
+    h->record ( 10 );
+    h->record ( 20 );
+    h->record ( 1000 );
+    Metrics::count ( "test_total", Metrics::label ( "backend", "file" ), 3 );
+    MetricsGauge* g = Metrics::getGauge ( "test_in_flight", Metrics::label ( "budget", "layer:a" ) );
+    g->add ( 2 );
+    g->add ( -3 );
+
+    std::string text = Metrics::toPrometheus();
+
+    CPPUNIT_ASSERT ( text.find ( "# TYPE test_duration_seconds histogram\n" ) != std::string::npos );
+    CPPUNIT_ASSERT ( text.find ( "test_duration_seconds_bucket{stage=\"test\",le=\"0.000016\"} 1\n" ) != std::string::npos );
+    CPPUNIT_ASSERT ( text.find ( "test_duration_seconds_bucket{stage=\"test\",le=\"0.000024\"} 2\n" ) != std::string::npos );
+    CPPUNIT_ASSERT ( text.find ( "test_duration_seconds_bucket{stage=\"test\",le=\"+Inf\"} 3\n" ) != std::string::npos );
+    CPPUNIT_ASSERT ( text.find ( "test_duration_seconds_count{stage=\"test\"} 3\n" ) != std::string::npos );
+    CPPUNIT_ASSERT ( text.find ( "test_total{backend=\"file\"} 3\n" ) != std::string::npos );
+    CPPUNIT_ASSERT ( text.find ( "# TYPE test_in_flight gauge\n" ) != std::string::npos );
+    CPPUNIT_ASSERT ( text.find ( "test_in_flight{budget=\"layer:a\"} -1\n" ) != std::string::npos );
+}
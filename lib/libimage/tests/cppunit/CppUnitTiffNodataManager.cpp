@@ -0,0 +1,278 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "TiffNodataManager.h"
+#include "FileImage.h"
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Le traitement par bandes de TiffNodataManager est comparé à l'ancien remplissage par propagation, pixel par pixel, depuis les bords
+ */
+class CppUnitTiffNodataManager : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitTiffNodataManager );
+
+    CPPUNIT_TEST ( test_touching_areas );
+    CPPUNIT_TEST ( test_random_areas );
+    CPPUNIT_TEST ( test_without_edges );
+    CPPUNIT_TEST ( test_float_truncation );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    std::string input, output, mask;
+
+    void setUp() {
+        char prefix[64];
+        sprintf ( prefix, "/tmp/CppUnitTiffNodataManager_%d", getpid() );
+        input = std::string ( prefix ) + "_in.tif";
+        output = std::string ( prefix ) + "_out.tif";
+        mask = std::string ( prefix ) + "_msk.tif";
+    };
+
+    void tearDown() {
+        unlink ( input.c_str() );
+        unlink ( output.c_str() );
+        unlink ( mask.c_str() );
+    };
+
+    /**
+     * Ancienne comparaison à la couleur cible : canaux convertis en entier
+     */
+    template<typename T>
+    bool isTarget ( const T* pix, int channels, int* target, int tolerance ) {
+        for ( int c = 0; c < channels; c++ ) {
+            int v = ( int ) pix[c];
+            if ( v < target[c] - tolerance || v > target[c] + tolerance ) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Ancien algorithme : propagation en 4-connexité depuis les pixels de bord de la couleur cible. Le masque vaut 0 pour le nodata.
+     */
+    template<typename T>
+    std::vector<uint8_t> floodFill ( const std::vector<T>& image, int width, int height, int channels, int* target, int tolerance, bool touchEdges ) {
+        std::vector<uint8_t> msk ( width * height, 255 );
+        std::queue<int> Q;
+
+        for ( int pos = 0; pos < width * height; pos++ ) {
+            int l = pos / width, c = pos % width;
+            bool edge = ( ! touchEdges || l == 0 || l == height - 1 || c == 0 || c == width - 1 );
+            if ( edge && isTarget ( &image[pos * channels], channels, target, tolerance ) ) {
+                msk[pos] = 0;
+                Q.push ( pos );
+            }
+        }
+
+        while ( touchEdges && ! Q.empty() ) {
+            int pos = Q.front();
+            Q.pop();
+            int l = pos / width, c = pos % width;
+            int neighbours[4] = { c > 0 ? pos - 1 : -1, c < width - 1 ? pos + 1 : -1, l > 0 ? pos - width : -1, l < height - 1 ? pos + width : -1 };
+            for ( int n = 0; n < 4; n++ ) {
+                int np = neighbours[n];
+                if ( np >= 0 && msk[np] && isTarget ( &image[np * channels], channels, target, tolerance ) ) {
+                    msk[np] = 0;
+                    Q.push ( np );
+                }
+            }
+        }
+        return msk;
+    }
+
+    template<typename T>
+    void writeInput ( std::vector<T>& image, int width, int height, int channels, SampleFormat::eSampleFormat sf, Photometric::ePhotometric ph ) {
+        FileImageFactory FIF;
+        FileImage* fi = FIF.createImageToWrite ( ( char* ) input.c_str(), BoundingBox<double> ( 0, 0, 0, 0 ), -1, -1, width, height,
+                                                 channels, sf, sizeof ( T ) * 8, ph, Compression::NONE );
+        CPPUNIT_ASSERT ( fi != NULL );
+        CPPUNIT_ASSERT ( fi->writeImage ( &image[0] ) >= 0 );
+        delete fi;
+    }
+
+    template<typename T>
+    std::vector<T> readImage ( const std::string& path, int width, int height, int channels ) {
+        FileImageFactory FIF;
+        FileImage* fi = FIF.createImageToRead ( ( char* ) path.c_str() );
+        CPPUNIT_ASSERT_MESSAGE ( "Cannot read " + path, fi != NULL );
+        CPPUNIT_ASSERT_EQUAL ( width, fi->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( height, fi->getHeight() );
+        std::vector<T> data ( width * height * channels );
+        for ( int l = 0; l < height; l++ ) fi->getline ( &data[l * width * channels], l );
+        delete fi;
+        return data;
+    }
+
+    /**
+     * Traite l'image d'entrée avec la hauteur de bande donnée, et compare image et masque au résultat de l'ancien algorithme
+     */
+    template<typename T>
+    void checkTreatment ( std::vector<T>& image, int width, int height, int channels, int* target, int* data, int* nodata,
+                          int tolerance, bool touchEdges, uint32_t rows ) {
+
+        std::vector<uint8_t> expectedMask = floodFill ( image, width, height, channels, target, tolerance, touchEdges );
+        std::vector<T> expected ( image );
+        bool changeData = touchEdges && memcmp ( target, data, channels * sizeof ( int ) );
+        for ( int pos = 0; pos < width * height; pos++ ) {
+            T* pix = &expected[pos * channels];
+            if ( ! expectedMask[pos] ) {
+                for ( int c = 0; c < channels; c++ ) pix[c] = ( T ) nodata[c];
+            } else if ( changeData && isTarget ( pix, channels, target, tolerance ) ) {
+                for ( int c = 0; c < channels; c++ ) pix[c] = ( T ) data[c];
+            }
+        }
+
+        TiffNodataManager<T> TNM ( channels, target, touchEdges, data, nodata, tolerance );
+        TNM.setBandHeight ( rows );
+        unlink ( mask.c_str() );
+        CPPUNIT_ASSERT ( TNM.treatNodata ( ( char* ) input.c_str(), ( char* ) output.c_str(), ( char* ) mask.c_str() ) );
+
+        std::string context = " (band height " + std::to_string ( rows ) + ")";
+
+        std::vector<T> result = readImage<T> ( output, width, height, channels );
+        CPPUNIT_ASSERT_MESSAGE ( "Image differs from flood fill" + context, memcmp ( &result[0], &expected[0], result.size() * sizeof ( T ) ) == 0 );
+
+        std::vector<uint8_t> resultMask = readImage<uint8_t> ( mask, width, height, 1 );
+        CPPUNIT_ASSERT_MESSAGE ( "Mask differs from flood fill" + context, resultMask == expectedMask );
+    }
+
+    void fill ( std::vector<uint8_t>& image, int width, int l, int c0, int c1, uint8_t v ) {
+        for ( int c = c0; c < c1; c++ )
+            for ( int s = 0; s < 3; s++ ) image[ ( l * width + c ) * 3 + s] = v;
+    }
+
+    void test_touching_areas() {
+        int width = 40, height = 30;
+        std::vector<uint8_t> image ( width * height * 3, 100 );
+
+        // Zone blanche touchant le bord gauche
+        for ( int l = 10; l < 14; l++ ) fill ( image, width, l, 0, 6, 255 );
+        // Lac blanc fermé, ne touchant aucun bord
+        for ( int l = 3; l < 7; l++ ) fill ( image, width, l, 20, 26, 255 );
+        // Serpent qui descend de la ligne 2 à la ligne 25, puis remonte jusqu'au bord droit à la ligne 1 :
+        // ses premières plages ne sont reliées au bord que par des lignes lues bien plus tard
+        for ( int l = 2; l < 26; l++ ) fill ( image, width, l, 10, 11, 255 );
+        fill ( image, width, 25, 10, 16, 255 );
+        for ( int l = 1; l < 26; l++ ) fill ( image, width, l, 15, 16, 255 );
+        fill ( image, width, 1, 15, 40, 255 );
+        // Spirale fermée autour d'un point, sans contact avec les bords
+        for ( int c = 28; c < 37; c++ ) { fill ( image, width, 12, c, c + 1, 255 ); fill ( image, width, 22, c, c + 1, 255 ); }
+        for ( int l = 12; l < 23; l++ ) { fill ( image, width, l, 28, 29, 255 ); fill ( image, width, l, 36, 37, 255 ); }
+        fill ( image, width, 17, 31, 34, 255 );
+        // Pixel presque blanc, dans la tolérance
+        fill ( image, width, 29, 39, 40, 253 );
+        fill ( image, width, 28, 39, 40, 250 );
+
+        writeInput ( image, width, height, 3, SampleFormat::UINT, Photometric::RGB );
+
+        int target[3] = { 255, 255, 255 };
+        int data[3] = { 254, 254, 254 };
+        int nodata[3] = { 0, 0, 0 };
+        uint32_t rows[6] = { 1, 2, 3, 7, 29, 0 };
+        for ( int r = 0; r < 6; r++ ) {
+            checkTreatment ( image, width, height, 3, target, data, nodata, 2, true, rows[r] );
+        }
+    }
+
+    void test_random_areas() {
+        int width = 97, height = 83;
+        std::vector<uint8_t> image ( width * height * 3, 50 );
+
+        // Bruit proche du seuil de percolation : composantes nombreuses et tortueuses
+        uint32_t seed = 12345;
+        for ( int pos = 0; pos < width * height; pos++ ) {
+            seed = seed * 1103515245 + 12345;
+            if ( ( seed >> 16 ) % 100 < 55 ) {
+                for ( int s = 0; s < 3; s++ ) image[pos * 3 + s] = 255;
+            }
+        }
+
+        writeInput ( image, width, height, 3, SampleFormat::UINT, Photometric::RGB );
+
+        int target[3] = { 255, 255, 255 };
+        int data[3] = { 254, 254, 254 };
+        int nodata[3] = { 255, 0, 0 };
+        uint32_t rows[5] = { 1, 4, 10, 64, 0 };
+        for ( int r = 0; r < 5; r++ ) {
+            checkTreatment ( image, width, height, 3, target, data, nodata, 0, true, rows[r] );
+        }
+    }
+
+    void test_without_edges() {
+        int width = 20, height = 15;
+        std::vector<uint8_t> image ( width * height * 3, 10 );
+        for ( int l = 5; l < 8; l++ ) fill ( image, width, l, 5, 9, 255 );
+        fill ( image, width, 0, 0, 3, 255 );
+
+        writeInput ( image, width, height, 3, SampleFormat::UINT, Photometric::RGB );
+
+        int target[3] = { 255, 255, 255 };
+        int nodata[3] = { 0, 0, 0 };
+        checkTreatment ( image, width, height, 3, target, target, nodata, 0, false, 4 );
+    }
+
+    void test_float_truncation() {
+        int width = 16, height = 12;
+        std::vector<float> image ( width * height, 153.2 );
+
+        // Les canaux flottants sont tronqués avant comparaison : -99999.5 et -99999.9 sont de la couleur cible, pas -99998.7
+        for ( int c = 0; c < width; c++ ) image[c] = -99999.5;
+        for ( int l = 0; l < height; l++ ) image[l * width] = -99999.9;
+        for ( int l = 4; l < 8; l++ )
+            for ( int c = 5; c < 9; c++ ) image[l * width + c] = -99999.;
+        image[11 * width + 15] = -99998.7;
+
+        writeInput ( image, width, height, 1, SampleFormat::FLOAT, Photometric::GRAY );
+
+        int target[1] = { -99999 };
+        int data[1] = { -99990 };
+        int nodata[1] = { -1 };
+        uint32_t rows[3] = { 1, 5, 0 };
+        for ( int r = 0; r < 3; r++ ) {
+            checkTreatment ( image, width, height, 1, target, data, nodata, 0, true, rows[r] );
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitTiffNodataManager );
@@ -0,0 +1,143 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#ifndef DECODERREFERENCE_H
+#define DECODERREFERENCE_H
+
+#include <cstdlib>
+#include <vector>
+#include "byteswap.h"
+#include "zlib.h"
+
+/**
+ * Tuiles de test encodées en PNG et en DEFLATE, partagées par les tests des décodeurs et par leur mesure de performance
+ */
+namespace DecoderReference {
+
+    /**
+     * Tuile de test, de texture régulière pour être compressible
+     */
+    static std::vector<uint8_t> pattern ( int width, int height, int channels ) {
+        std::vector<uint8_t> raw ( width * height * channels );
+        for ( int l = 0; l < height; l++ )
+            for ( int c = 0; c < width; c++ )
+                for ( int s = 0; s < channels; s++ )
+                    raw[ ( l * width + c ) * channels + s] = ( ( l / 4 ) * 37 + ( c / 3 ) * 11 + s * 53 + ( ( l * c ) % 7 ) ) % 256;
+        return raw;
+    }
+
+    static void appendChunk ( std::vector<uint8_t>& png, const char* type, const uint8_t* data, size_t size ) {
+        uint32_t v = bswap_32 ( ( uint32_t ) size );
+        png.insert ( png.end(), ( uint8_t* ) &v, ( uint8_t* ) &v + 4 );
+        size_t start = png.size();
+        png.insert ( png.end(), ( const uint8_t* ) type, ( const uint8_t* ) type + 4 );
+        png.insert ( png.end(), data, data + size );
+        v = bswap_32 ( ( uint32_t ) crc32 ( 0, &png[start], size + 4 ) );
+        png.insert ( png.end(), ( uint8_t* ) &v, ( uint8_t* ) &v + 4 );
+    }
+
+    /**
+     * Encode une tuile en PNG, en filtrant la ligne l avec le filtre filters[l % filters.size()].
+     * Les données compressées sont réparties sur deux chunks IDAT.
+     */
+    static std::vector<uint8_t> encodePng ( const std::vector<uint8_t>& raw, int width, int height, int channels, const std::vector<int>& filters ) {
+        int linesize = width * channels;
+        std::vector<uint8_t> filtered ( height * ( linesize + 1 ) );
+        for ( int l = 0; l < height; l++ ) {
+            const uint8_t* cur = &raw[l * linesize];
+            const uint8_t* prior = l ? cur - linesize : 0;
+            uint8_t* out = &filtered[l * ( linesize + 1 )];
+            int filter = filters[l % filters.size()];
+            out[0] = filter;
+            for ( int i = 0; i < linesize; i++ ) {
+                int a = ( i >= channels ) ? cur[i - channels] : 0;
+                int b = prior ? prior[i] : 0;
+                int c = ( prior && i >= channels ) ? prior[i - channels] : 0;
+                int predictor = 0;
+                switch ( filter ) {
+                case 1:
+                    predictor = a;
+                    break;
+                case 2:
+                    predictor = b;
+                    break;
+                case 3:
+                    predictor = ( a + b ) / 2;
+                    break;
+                case 4: {
+                    int p = a + b - c;
+                    int pa = abs ( p - a ), pb = abs ( p - b ), pc = abs ( p - c );
+                    predictor = ( pa <= pb && pa <= pc ) ? a : ( pb <= pc ? b : c );
+                    break;
+                }
+                }
+                out[i + 1] = cur[i] - predictor;
+            }
+        }
+
+        uLongf zsize = compressBound ( filtered.size() );
+        std::vector<uint8_t> zdata ( zsize );
+        compress2 ( &zdata[0], &zsize, &filtered[0], filtered.size(), 6 );
+
+        static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        std::vector<uint8_t> png ( signature, signature + 8 );
+
+        static const uint8_t colorTypes[5] = { 0, 0, 4, 2, 6 };
+        uint8_t ihdr[13];
+        * ( ( uint32_t* ) ihdr ) = bswap_32 ( ( uint32_t ) width );
+        * ( ( uint32_t* ) ( ihdr + 4 ) ) = bswap_32 ( ( uint32_t ) height );
+        ihdr[8] = 8;
+        ihdr[9] = colorTypes[channels];
+        ihdr[10] = ihdr[11] = ihdr[12] = 0;
+        appendChunk ( png, "IHDR", ihdr, 13 );
+        appendChunk ( png, "IDAT", &zdata[0], zsize / 2 );
+        appendChunk ( png, "IDAT", &zdata[zsize / 2], zsize - zsize / 2 );
+        appendChunk ( png, "IEND", 0, 0 );
+        return png;
+    }
+
+    static std::vector<uint8_t> encodeDeflate ( const std::vector<uint8_t>& raw ) {
+        uLongf zsize = compressBound ( raw.size() );
+        std::vector<uint8_t> zdata ( zsize );
+        compress2 ( &zdata[0], &zsize, &raw[0], raw.size(), 6 );
+        zdata.resize ( zsize );
+        return zdata;
+    }
+
+}
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#ifndef LINEREFERENCE_H
+#define LINEREFERENCE_H
+
+#include <cstdlib>
+#include <cstring>
+#include "Line.h"
+
+/**
+ * Version précédente de Line et couches de test, partagées par les tests de Line et par sa mesure de performance
+ */
+namespace LineReference {
+
+    static const int width = 2048;
+    static const int layers = 4;
+
+    /**
+     * Version précédente de Line (alpha non associé, un pixel à la fois), référence des résultats et des performances
+     */
+    class StraightLine {
+    public:
+        float* samples;
+        float* alpha;
+        uint8_t* mask;
+        float coeff;
+        int width;
+
+        StraightLine ( int width ) : coeff ( 255. ), width ( width ) {
+            samples = new float[3*width];
+            alpha = new float[width];
+            mask = new uint8_t[width];
+        }
+        ~StraightLine() {
+            delete[] samples;
+            delete[] alpha;
+            delete[] mask;
+        }
+
+        void store ( uint8_t* imageIn, uint8_t* maskIn, int srcSpp ) {
+            memcpy ( mask, maskIn, width );
+            if ( srcSpp == 3 ) {
+                convert ( samples, imageIn, 3*width );
+                for ( int i = 0; i < width; i++ ) alpha[i] = 1.0;
+            } else {
+                for ( int i = 0; i < width; i++ ) {
+                    convert ( samples+i*3, imageIn+i*4, 3 );
+                    alpha[i] = ( float ) imageIn[i*4+3] / 255.;
+                }
+            }
+        }
+
+        void write ( uint8_t* buffer, int outChannels ) {
+            for ( int i = 0; i < width; i++ ) {
+                if ( outChannels == 3 ) {
+                    for ( int c = 0; c < 3; c++ ) buffer[3*i+c] = ( uint8_t ) ( alpha[i] * samples[3*i+c] );
+                } else {
+                    for ( int c = 0; c < 3; c++ ) buffer[4*i+c] = ( uint8_t ) ( samples[3*i+c] );
+                    buffer[4*i+3] = ( uint8_t ) ( alpha[i]*coeff );
+                }
+            }
+        }
+
+        void alphaBlending ( StraightLine* above ) {
+            float* pix = samples;
+            float* al = alpha;
+            float* pixAb = above->samples;
+            float* alAb = above->alpha;
+            for ( int i = 0; i < width; i++, pix += 3, pixAb += 3, al++, alAb++ ) {
+                if ( *alAb == 0. || ! above->mask[i] ) continue;
+                if ( *al == 0. ) {
+                    *al = *alAb;
+                    memcpy ( pix, pixAb, 3*sizeof ( float ) );
+                    continue;
+                }
+                float a = *alAb + *al * ( 1. - *alAb );
+                pix[0] = ( *alAb * pixAb[0] + *al * pix[0] * ( 1 - *alAb ) ) / a;
+                pix[1] = ( *alAb * pixAb[1] + *al * pix[1] * ( 1 - *alAb ) ) / a;
+                pix[2] = ( *alAb * pixAb[2] + *al * pix[2] * ( 1 - *alAb ) ) / a;
+                *al = a;
+            }
+        }
+
+        void useMask ( StraightLine* above ) {
+            for ( int i = 0; i < width; i++ ) {
+                if ( above->mask[i] ) {
+                    alpha[i] = above->alpha[i];
+                    memcpy ( samples + 3*i, above->samples + 3*i, 3 * sizeof ( float ) );
+                }
+            }
+        }
+
+        void multiply ( StraightLine* above ) {
+            for ( int i = 0; i < width; i++ ) {
+                if ( ! above->mask[i] ) continue;
+                alpha[i] *= above->alpha[i];
+                samples[3*i] = samples[3*i] * above->samples[3*i] / coeff;
+                samples[3*i+1] = samples[3*i+1] * above->samples[3*i+1] / coeff;
+                samples[3*i+2] = samples[3*i+2] * above->samples[3*i+2] / coeff;
+            }
+        }
+    };
+
+    /**
+     * Couches RGBA superposées et ligne de fond, fusionnées par Line ou StraightLine
+     */
+    struct RgbaLayers {
+        uint8_t images[layers][4*width];
+        uint8_t masks[layers][width];
+
+        // Couches RGBA : opaques, transparentes, semi-transparentes, avec des zones sans donnée
+        void fill() {
+            for ( int l = 0; l < layers; l++ ) {
+                for ( int i = 0; i < 4*width; i++ ) images[l][i] = rand() %256;
+                for ( int i = 0; i < width; i++ ) {
+                    int r = rand() %4;
+                    if ( r == 0 ) images[l][4*i+3] = 255;
+                    else if ( r == 1 ) images[l][4*i+3] = 0;
+                    masks[l][i] = ( ( i / 100 + l ) % 5 ) ? 255 : 0;
+                }
+            }
+        }
+
+        // 0 : alpha blending, 1 : multiplication, 2 : masque
+        template<typename L>
+        void mergeLine ( L& work, L& above, uint8_t* out, int mode, int outChannels ) {
+            uint8_t bg[4*width];
+            uint8_t bgMask[width];
+            for ( int i = 0; i < 4*width; i++ ) bg[i] = ( i % 4 == 3 ) ? 100 : 255;
+            memset ( bgMask, 0, width );
+            work.store ( bg, bgMask, 4 );
+            for ( int l = 0; l < layers; l++ ) {
+                above.store ( images[l], masks[l], 4 );
+                if ( mode == 0 ) work.alphaBlending ( &above );
+                else if ( mode == 1 ) work.multiply ( &above );
+                else work.useMask ( &above );
+            }
+            work.write ( out, outChannels );
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#ifndef MERGE4REFERENCE_H
+#define MERGE4REFERENCE_H
+
+#include <cmath>
+#include <cstring>
+#include "Utils.h"
+
+/**
+ * Boucle historique de merge4tiff, référence des résultats de merge4,
+ * partagée par les tests de merge4 et par sa mesure de performance
+ */
+namespace Merge4Reference {
+
+    // Table de correction gamma de merge4tiff
+    inline void initGamma ( uint8_t* gamma ) {
+        for ( int i = 0; i <= 1020; i++ ) gamma[i] = 255 - ( uint8_t ) round ( pow ( double ( 1020 - i ) /1020., 0.8 ) * 255. );
+    }
+
+    template<typename T>
+    void reference ( T* to, uint8_t* toMask, const T* from1, const uint8_t* mask1, const T* from2, const uint8_t* mask2, int width, int channels, const uint8_t* gamma ) {
+        float pix[4];
+        for ( int pixIn = 0, sampleIn = 0; pixIn < 2*width; pixIn += 2, sampleIn += 2*channels ) {
+            memset ( pix,0,channels*sizeof ( float ) );
+            int nbData = 0;
+            if ( mask1[pixIn] ) {
+                nbData++;
+                for ( int c = 0; c < channels; c++ ) pix[c] += from1[sampleIn+c];
+            }
+            if ( mask1[pixIn+1] ) {
+                nbData++;
+                for ( int c = 0; c < channels; c++ ) pix[c] += from1[sampleIn+channels+c];
+            }
+            if ( mask2[pixIn] ) {
+                nbData++;
+                for ( int c = 0; c < channels; c++ ) pix[c] += from2[sampleIn+c];
+            }
+            if ( mask2[pixIn+1] ) {
+                nbData++;
+                for ( int c = 0; c < channels; c++ ) pix[c] += from2[sampleIn+channels+c];
+            }
+            if ( nbData > 1 ) {
+                toMask[pixIn/2] = 255;
+                if ( sizeof ( T ) == 1 ) {
+                    for ( int c = 0; c < channels; c++ ) to[sampleIn/2+c] = gamma[ ( int ) pix[c]*4/nbData];
+                } else {
+                    for ( int c = 0; c < channels; c++ ) to[sampleIn/2+c] = pix[c]/ ( float ) nbData;
+                }
+            }
+        }
+    }
+
+    inline void merge ( uint8_t* to, uint8_t* toMask, const uint8_t* from1, const uint8_t* mask1, const uint8_t* from2, const uint8_t* mask2, int width, int channels, const uint8_t* gamma ) {
+        merge4 ( to, toMask, from1, mask1, from2, mask2, width, channels, gamma );
+    }
+
+    inline void merge ( float* to, uint8_t* toMask, const float* from1, const uint8_t* mask1, const float* from2, const uint8_t* mask2, int width, int channels, const uint8_t* gamma ) {
+        merge4 ( to, toMask, from1, mask1, from2, mask2, width, channels );
+    }
+
+}
+
+#endif
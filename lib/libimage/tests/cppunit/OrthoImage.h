@@ -0,0 +1,84 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#ifndef ORTHOIMAGE_H
+#define ORTHOIMAGE_H
+
+#include "Image.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/**
+ * Image en mémoire imitant une orthophotographie : dégradés, texture et bruit
+ */
+class OrthoImage : public Image {
+private:
+    std::vector<uint8_t> data;
+
+public:
+    OrthoImage ( int width, int height, int channels, int seed ) :
+        Image ( width, height, channels ), data ( width * height * channels ) {
+        srand ( seed );
+        for ( int l = 0; l < height; l++ ) {
+            for ( int c = 0; c < width; c++ ) {
+                double texture = 40. * sin ( c / 7. + seed ) * cos ( l / 11. ) + 20. * sin ( ( c + l ) / 3. );
+                for ( int s = 0; s < channels; s++ ) {
+                    double v = 60. + 30. * s + 0.2 * ( c + l ) + texture + rand() % 16;
+                    data[ ( l * width + c ) * channels + s] = ( uint8_t ) std::max ( 0., std::min ( 255., v ) );
+                }
+            }
+        }
+    }
+
+    int getline ( uint8_t* buffer, int line ) {
+        memcpy ( buffer, &data[line * width * channels], width * channels );
+        return width * channels;
+    }
+    int getline ( uint16_t* buffer, int line ) {
+        for ( int i = 0; i < width * channels; i++ ) buffer[i] = data[line * width * channels + i];
+        return width * channels;
+    }
+    int getline ( float* buffer, int line ) {
+        for ( int i = 0; i < width * channels; i++ ) buffer[i] = data[line * width * channels + i];
+        return width * channels;
+    }
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#ifndef PATTERNIMAGE_H
+#define PATTERNIMAGE_H
+
+#include "Image.h"
+#include <vector>
+
+/**
+ * Image en mémoire, dont les valeurs dépendent de la position du pixel. Sert d'image source, avec lecture échantillonnée directe (comme une image TIFF non compressée), ou de masque.
+ */
+class PatternImage : public Image {
+private:
+    std::vector<uint8_t> data;
+
+    template<typename T>
+    int _getSampledLine ( T* buffer, int line, int offset, int step, int number ) {
+        uint8_t* pix = &data[ ( line * width + offset ) * channels];
+        for ( int i = 0; i < number; i++, pix += step * channels ) {
+            for ( int c = 0; c < channels; c++ ) buffer[i*channels + c] = pix[c];
+        }
+        return number * channels;
+    }
+
+public:
+    PatternImage ( int width, int height, int channels, BoundingBox<double> bbox, bool isMaskPattern, int seed ) :
+        Image ( width, height, channels, 1., 1., bbox ), data ( width * height * channels ) {
+        for ( int l = 0; l < height; l++ ) {
+            for ( int c = 0; c < width; c++ ) {
+                for ( int s = 0; s < channels; s++ ) {
+                    if ( isMaskPattern ) {
+                        data[ ( l * width + c ) * channels + s] = ( ( l / 3 + c / 5 + seed ) % 4 ) ? 255 : 0;
+                    } else {
+                        data[ ( l * width + c ) * channels + s] = ( l * 31 + c * 17 + s * 7 + seed ) % 251;
+                    }
+                }
+            }
+        }
+    }
+
+    int getline ( uint8_t* buffer, int line ) { return _getSampledLine ( buffer, line, 0, 1, width ); }
+    int getline ( uint16_t* buffer, int line ) { return _getSampledLine ( buffer, line, 0, 1, width ); }
+    int getline ( float* buffer, int line ) { return _getSampledLine ( buffer, line, 0, 1, width ); }
+
+    int getSampledLine ( uint8_t* buffer, int line, int offset, int step, int number ) { return _getSampledLine ( buffer, line, offset, step, number ); }
+    int getSampledLine ( uint16_t* buffer, int line, int offset, int step, int number ) { return _getSampledLine ( buffer, line, offset, step, number ); }
+    int getSampledLine ( float* buffer, int line, int offset, int step, int number ) { return _getSampledLine ( buffer, line, offset, step, number ); }
+};
+
+#endif
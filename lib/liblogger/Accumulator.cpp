@@ -39,12 +39,23 @@
 #include <time.h>
 #include <errno.h>
 #include <csignal>
+#include <sched.h>
 #include "sys/time.h"
 
 
+/** Compteur des accumulateurs créés, pour leur attribuer un identifiant unique */
+static unsigned long accumulatorsCount = 0;
+
+/**
+ * Cache de la file du thread courant, pour le dernier accumulateur utilisé.
+ * Evite une recherche par clé pthread à chaque message dans le cas courant où tous les niveaux partagent le même accumulateur.
+ */
+static __thread unsigned long cachedAccumulatorId = 0;
+static __thread void* cachedQueue = 0;
+
 /**
  * Boucle principale d'écriture exécutée par un thread spcifique encapsulé dans la classe.
- * Cette boucle se charge de récuperrer des messages dans le buffer de message et de
+ * Cette boucle se charge de récuperrer des messages dans les files des threads et de
  * les écrire dans le flux de sortie. Ainsi les éventuelles latences d'écriture de fichier
  * sont supportées par ce thread et non par les thread qui initient les écritures de log.
  *
@@ -53,18 +64,81 @@
 void* Accumulator::loop ( void* arg ) {
     Accumulator* A = ( Accumulator* ) arg;
 
-    while ( A->waitMessage() )
-        A->flushFrontMessage();
+    while ( true ) {
+        if ( A->flushMessages() > 0 ) {
+            A->getStream().flush();
+            continue;
+        }
+        if ( __atomic_load_n ( &A->status, __ATOMIC_SEQ_CST ) <= 0 ) {
+            // Plus aucun message ne peut être ajouté, on écrit les derniers
+            A->flushMessages();
+            break;
+        }
+        A->waitMessage();
+    }
 
     A->getStream().flush();
+    return NULL;
 }
 
 /**
- * Attend (et bloque) l'arrivée d'un nouveau message dans le buffer.
+ * Marque la file d'un thread qui se termine comme abandonnée (destructeur de queueKey)
+ */
+void Accumulator::abandonQueue ( void* arg ) {
+    ThreadQueue* q = ( ThreadQueue* ) arg;
+    __atomic_store_n ( &q->abandoned, 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * Renvoie la file du thread appelant, en la créant au premier appel
+ */
+Accumulator::ThreadQueue* Accumulator::getThreadQueue() {
+    if ( cachedAccumulatorId == id ) return ( ThreadQueue* ) cachedQueue;
+
+    ThreadQueue* q = ( ThreadQueue* ) pthread_getspecific ( queueKey );
+    if ( q == 0 ) {
+        q = new ThreadQueue ( capacity );
+        pthread_setspecific ( queueKey, ( void* ) q );
+
+        // Ajout en tête de liste par CAS : le thread d'écriture peut aussi retirer la tête si elle est abandonnée
+        ThreadQueue* first = __atomic_load_n ( &queues, __ATOMIC_ACQUIRE );
+        do {
+            q->next = first;
+        } while ( ! __atomic_compare_exchange_n ( &queues, &first, q, true, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE ) );
+    }
+
+    cachedAccumulatorId = id;
+    cachedQueue = ( void* ) q;
+    return q;
+}
+
+/**
+ * Réveille le thread d'écriture s'il est endormi
+ */
+void Accumulator::wakeUp() {
+    if ( __atomic_load_n ( &sleeping, __ATOMIC_SEQ_CST ) ) {
+        pthread_mutex_lock ( &mutex );
+        pthread_cond_signal ( &cond_get );
+        pthread_mutex_unlock ( &mutex );
+    }
+}
+
+/**
+ * Indique si au moins une file contient un message
+ */
+bool Accumulator::hasMessages() {
+    for ( ThreadQueue* q = __atomic_load_n ( &queues, __ATOMIC_ACQUIRE ); q; q = q->next ) {
+        if ( __atomic_load_n ( &q->tail, __ATOMIC_SEQ_CST ) != q->head ) return true;
+    }
+    return false;
+}
+
+/**
+ * Attend (et bloque) l'arrivée d'un nouveau message dans une des files.
  * Cette fonction est exclusivement utilisée par le thread encapsulé.
- * Cette fonction retourne dès qu'un message est dispoible dans buffer ou lorsque l'objet rentre en phase de destruction
+ * Le flux de sortie est vidé si aucun message n'arrive pendant une seconde.
  */
-bool Accumulator::waitMessage() {
+void Accumulator::waitMessage() {
     // On prépare une timeout à +1s
     timeval tv;
     timespec tsp;
@@ -72,42 +146,72 @@ bool Accumulator::waitMessage() {
     tsp.tv_sec  = tv.tv_sec + 1;
     tsp.tv_nsec = tv.tv_usec * 1000;
 
-    // On attend avec un timeout de 1 seconde
+    bool timeout = false;
+
+    // Les producteurs ne prennent le mutex pour signaler qu'après avoir publié leur message et vu sleeping à 1 :
+    // un message publié après notre vérification nous réveillera forcément.
     pthread_mutex_lock ( &mutex );
-    if ( size == 0 && status > 0 && pthread_cond_timedwait ( &cond_get, &mutex, &tsp ) == ETIMEDOUT ) {
-        pthread_mutex_unlock ( &mutex );
-        getStream().flush(); // Flush hors mutex (car peut prendre du temps)
-        pthread_mutex_lock ( &mutex );
+    __atomic_store_n ( &sleeping, 1, __ATOMIC_SEQ_CST );
+    if ( ! hasMessages() && __atomic_load_n ( &status, __ATOMIC_SEQ_CST ) > 0 ) {
+        timeout = ( pthread_cond_timedwait ( &cond_get, &mutex, &tsp ) == ETIMEDOUT );
     }
-
-    // maintenant on attend qu'il y ait des messages sans timemout
-    while ( size == 0 && status > 0 ) pthread_cond_wait ( &cond_get, &mutex );
+    __atomic_store_n ( &sleeping, 0, __ATOMIC_SEQ_CST );
     pthread_mutex_unlock ( &mutex );
 
-    // Seul le thread interne peut décrémenter size, donc la contidtion size > 0 ne peut changer après la libération du mutex.
-    return ( size > 0 );
+    if ( timeout ) getStream().flush(); // Flush hors mutex (car peut prendre du temps)
 }
 
 /**
- * Retire le premier message du buffer et l'envoie dans flux de sortie.
+ * Écrit dans le flux de sortie tous les messages présents dans les files, et supprime les files abandonnées vides.
  * Cette fonction est exclusivement utilisée par le thread encapsulé.
- * Cette fonction décrémente size et ne doit pas être apellée avec un buffer vide.
+ * @return le nombre de messages écrits
  */
-void Accumulator::flushFrontMessage() {
-    getStream() << buffer[front];
-    //TODO: gérer les cas d'erreur d'écriture du flux.
-
-    getStream().flush();
+int Accumulator::flushMessages() {
+    int written = 0;
+
+    ThreadQueue* previous = 0;
+    ThreadQueue* q = __atomic_load_n ( &queues, __ATOMIC_ACQUIRE );
+
+    while ( q ) {
+        // abandoned est lu avant tail : si la file est abandonnée et vide ici, elle le restera
+        int abandoned = __atomic_load_n ( &q->abandoned, __ATOMIC_ACQUIRE );
+        unsigned long tail = __atomic_load_n ( &q->tail, __ATOMIC_ACQUIRE );
+        unsigned long head = q->head;
+
+        for ( ; head != tail; head++ ) {
+            std::string& message = q->messages[head % q->messages.size()];
+            getStream() << message;
+            //TODO: gérer les cas d'erreur d'écriture du flux.
+            message.clear();
+            written++;
+        }
+        __atomic_store_n ( &q->head, head, __ATOMIC_RELEASE );
+
+        ThreadQueue* next = q->next;
+        if ( abandoned ) {
+            if ( previous == 0 ) {
+                // La tête de liste peut être modifiée à tout moment par les producteurs : on la retire par CAS
+                ThreadQueue* expected = q;
+                if ( ! __atomic_compare_exchange_n ( &queues, &expected, next, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+                    // Des files ont été ajoutées en tête entre temps : q n'est plus la tête, on cherche son prédécesseur.
+                    // Seul ce thread modifie les liens des files déjà publiées, la recherche aboutit forcément.
+                    previous = expected;
+                    while ( previous->next != q ) previous = previous->next;
+                    previous->next = next;
+                }
+            } else {
+                previous->next = next;
+            }
+            delete q;
+        } else {
+            previous = q;
+        }
+        q = next;
+    }
 
-    // On retire le message du buffer en incrémentant front.
-    pthread_mutex_lock ( &mutex );
-    front = ( front+1 ) % buffer.size();
-    size--;
-    pthread_cond_signal ( &cond_add );
-    pthread_mutex_unlock ( &mutex );
+    return written;
 }
 
-
 /**
  * Rentre dans l'état en cours de destruction et attend que le thread encapsulé s'arrêter proprement.
  * Cette fonction doit être apellée par le destructeur de la classe fille.
@@ -118,7 +222,7 @@ void Accumulator::flushFrontMessage() {
 void Accumulator::stop() {
     pthread_mutex_lock ( &mutex );
     // On indique que l'objet est encours de destruction.
-    status = 0;
+    __atomic_store_n ( &status, 0, __ATOMIC_SEQ_CST );
     // On réveille le thread interne si celui-ci était en train de dormir
     pthread_cond_signal ( &cond_get );
     // Attendre la fin du thread interne
@@ -127,34 +231,41 @@ void Accumulator::stop() {
 }
 
 /**
- * Ajoute un message dans la file d'attente des messages à écrire sur le flux de sortie.
- * Cette fonction peut bloquer lorsque le buffer est plein. Dans ce cas le thread apellant attend que le thread encapsulé libère de la place dans le buffer.
- * L'ordre d'enregistrement des messages concurents dépend de la politique de gestion des mutex (ça doit être du FIFO).
+ * Ajoute un message dans la file d'attente du thread appelant.
+ * Aucun verrou n'est pris. Lorsque la file du thread est pleine, le thread apellant attend que le thread encapsulé libère de la place.
+ * L'ordre des messages d'un même thread est conservé, les messages de threads différents sont entrelacés.
  *
  * @param message Le message à écrire, ne pas oublier de rajouter des retours à la ligne si l'on veut écrire des lignes
  * @return true si le message a bien été pris en compte false sinon.
  */
 bool Accumulator::addMessage ( std::string message ) {
     // Ne pas accepter de nouveau message en cours de destruction.
-    if ( status <= 0 ) return false;
+    if ( __atomic_load_n ( &status, __ATOMIC_RELAXED ) <= 0 ) return false;
 
+    ThreadQueue* q = getThreadQueue();
+    unsigned long tail = q->tail;
 
-    pthread_mutex_lock ( &mutex );
-    // On attend qu'il y ait de la place dans le buffer
-    while ( size == buffer.size() ) pthread_cond_wait ( &cond_add, &mutex );
+    // On attend qu'il y ait de la place dans la file
+    while ( tail - __atomic_load_n ( &q->head, __ATOMIC_ACQUIRE ) >= q->messages.size() ) {
+        wakeUp();
+        sched_yield();
+        if ( __atomic_load_n ( &status, __ATOMIC_RELAXED ) <= 0 ) return false;
+    }
 
-    buffer[ ( front + size ) %buffer.size()] = message;
-    size++;
-    pthread_cond_signal ( &cond_get );
-    pthread_mutex_unlock ( &mutex );
+    q->messages[tail % q->messages.size()].swap ( message );
+    __atomic_store_n ( &q->tail, tail + 1, __ATOMIC_SEQ_CST );
+
+    wakeUp();
     return true;
 }
 
-/** Constructeur permettant de définir la capacité du buffer de messages. */
-Accumulator::Accumulator ( int capacity ) : status ( 1 ), buffer ( capacity ), front ( 0 ), size ( 0 ) {
+/** Constructeur permettant de définir la capacité de la file de messages de chaque thread. */
+Accumulator::Accumulator ( int capacity ) : status ( 1 ), sleeping ( 0 ), capacity ( capacity ), queues ( 0 ) {
+    id = __atomic_add_fetch ( &accumulatorsCount, 1, __ATOMIC_RELAXED );
+
     pthread_mutex_init ( &mutex, 0 );
     pthread_cond_init ( &cond_get, 0 );
-    pthread_cond_init ( &cond_add, 0 );
+    pthread_key_create ( &queueKey, Accumulator::abandonQueue );
 
     // On crée et lance le thread interne
     pthread_create ( &threadId, NULL, Accumulator::loop, ( void* ) this );
@@ -168,8 +279,17 @@ Accumulator::~Accumulator() {
 /** Destructeur de certains objets de la classe */
 void Accumulator::destroy() {
     // Note : Le thread interne doit être arrêté par le destructeur de la classe fille en utilisant stop().
+    pthread_key_delete ( queueKey );
+
+    ThreadQueue* q = queues;
+    while ( q ) {
+        ThreadQueue* next = q->next;
+        delete q;
+        q = next;
+    }
+    queues = 0;
+
     pthread_cond_destroy ( &cond_get );
-    pthread_cond_destroy ( &cond_add );
     pthread_mutex_destroy ( &mutex );
 }
 
@@ -44,6 +44,8 @@
 #include <ctime>
 //#include <cstdlib>
 #include <vector>
+#include <string>
+#include <pthread.h>
 
 /**
  * Collecte les messages de logs de plusieurs threads et les écrit dans un flux de sortie.
@@ -52,10 +54,33 @@
  * Un unique thread indépendant encapsulé dans la classe écrit les messages sur un flux de sortie.
  * Une telle architecture permet aux thread apellant de ne pas être bloqués par des latences dues aux I/O.
  * Les accumulateurs seront eux même encapsulés dans des Loggers, plusieurs loggers peuvent utiliser un même accumulateur.
+ *
+ * Chaque thread appelant dispose de sa propre file circulaire de messages (un seul producteur, un seul consommateur) :
+ * l'ajout d'un message ne prend aucun verrou et les threads ne sont pas en concurrence entre eux. Le thread d'écriture
+ * vide toutes les files à tour de rôle. L'ordre des messages d'un même thread est conservé.
  */
 class Accumulator {
 private:
 
+    /**
+     * File de messages propre à un thread appelant.
+     * Seul ce thread fait avancer tail, seul le thread d'écriture fait avancer head.
+     */
+    struct ThreadQueue {
+        /** Buffer circulaire de string contenant les messages */
+        std::vector<std::string> messages;
+        /** Nombre de messages retirés de la file depuis sa création */
+        unsigned long head;
+        /** Nombre de messages ajoutés à la file depuis sa création */
+        unsigned long tail;
+        /** Le thread propriétaire est terminé, la file peut être supprimée une fois vide */
+        int abandoned;
+        /** File suivante dans la liste des files de l'accumulateur */
+        ThreadQueue* next;
+
+        ThreadQueue ( int capacity ) : messages ( capacity ), head ( 0 ), tail ( 0 ), abandoned ( 0 ), next ( 0 ) {}
+    };
+
     /**
      * Etat de la classe utilisé pour la destruction du thread encapsulé.
      * status  > 0 : Etat normal
@@ -63,30 +88,33 @@ private:
      */
     int status;
 
+    /** Identifiant unique de l'accumulateur, pour le cache de file des threads */
+    unsigned long id;
+
     /** Id du thread d'écriture spécifique */
     pthread_t threadId;
 
-    /** mutex pour synchroniser les ajouts et retraits de message du buffer */
+    /** mutex utilisé uniquement pour endormir et réveiller le thread d'écriture */
     pthread_mutex_t mutex;
 
     /** Condition d'attente du thread d'écriture  */
     pthread_cond_t  cond_get;
 
-    /** Condition d'attente des thread d'ajout de message */
-    pthread_cond_t  cond_add;
+    /** Le thread d'écriture est (ou va être) endormi sur cond_get */
+    int sleeping;
 
-    /** Position du plus ancien message présent dans le buffer */
-    int front;
+    /** Capacité de la file de chaque thread */
+    int capacity;
 
-    /** Nombre de messages actuellement bufferisés */
-    int size;
+    /** Liste chaînée des files des threads, les nouvelles files sont ajoutées en tête */
+    ThreadQueue* queues;
 
-    /** Buffer de string contenant les messages */
-    std::vector<std::string> buffer;
+    /** Clé permettant de retrouver la file du thread appelant, et de l'abandonner quand il se termine */
+    pthread_key_t queueKey;
 
     /**
      * Boucle principale d'écriture exécutée par un thread spcifique encapsulé dans la classe.
-     * Cette boucle se charge de récuperrer des messages dans le buffer de message et de
+     * Cette boucle se charge de récuperrer des messages dans les files des threads et de
      * les écrire dans le flux de sortie. Ainsi les éventuelles latences d'écriture de fichier
      * sont supportées par ce thread et non par les thread qui initient les écritures de log.
      *
@@ -94,21 +122,40 @@ private:
      */
     static void* loop ( void* arg );
 
+    /**
+     * Marque la file d'un thread qui se termine comme abandonnée (destructeur de queueKey)
+     */
+    static void abandonQueue ( void* arg );
 
     /**
-     * Attend (et bloque) l'arrivée d'un nouveau message dans le buffer.
+     * Renvoie la file du thread appelant, en la créant au premier appel
+     */
+    ThreadQueue* getThreadQueue();
+
+    /**
+     * Attend (et bloque) l'arrivée d'un nouveau message dans une des files.
      * Cette fonction est exclusivement utilisée par le thread encapsulé.
-     * Cette fonction retourne dès qu'un message est dispoible dans buffer ou lorsque l'objet rentre en phase de destruction
+     * Le flux de sortie est vidé si aucun message n'arrive pendant une seconde.
+     * Cette fonction retourne dès qu'un message est disponible ou lorsque l'objet rentre en phase de destruction
      */
-    bool waitMessage();
+    void waitMessage();
 
     /**
-     * Retire le premier message du buffer et l'envoie dans flux de sortie.
+     * Indique si au moins une file contient un message
+     */
+    bool hasMessages();
+
+    /**
+     * Écrit dans le flux de sortie tous les messages présents dans les files, et supprime les files abandonnées vides.
      * Cette fonction est exclusivement utilisée par le thread encapsulé.
-     * Cette fonction décrémente size et ne doit pas être apellée avec un buffer vide.
+     * @return le nombre de messages écrits
      */
-    void flushFrontMessage();
+    int flushMessages();
 
+    /**
+     * Réveille le thread d'écriture s'il est endormi
+     */
+    void wakeUp();
 
     /** Constructeur de copie privé pour éviter toute copie de l'objet */
     Accumulator ( Accumulator& ) {}
@@ -127,9 +174,9 @@ protected:
 public:
 
     /**
-     * Ajoute un message dans la file d'attente des messages à écrire sur le flux de sortie.
-     * Cette fonction peut bloquer lorsque le buffer est plein. Dans ce cas le thread apellant attend que le thread encapsulé libère de la place dans le buffer.
-     * L'ordre d'enregistrement des messages concurents dépend de la politique de gestion des mutex (ça doit être du FIFO).
+     * Ajoute un message dans la file d'attente du thread appelant.
+     * Aucun verrou n'est pris. Lorsque la file du thread est pleine, le thread apellant attend que le thread encapsulé libère de la place.
+     * L'ordre des messages d'un même thread est conservé, les messages de threads différents sont entrelacés.
      *
      * @param message Le message à écrire, ne pas oublier de rajouter des retours à la ligne si l'on veut écrire des lignes
      */
@@ -163,7 +210,7 @@ public:
      */
     virtual void close() = 0;
 
-    /** Constructeur permettant de définir la capacité du buffer de messages. */
+    /** Constructeur permettant de définir la capacité de la file de messages de chaque thread. */
     Accumulator ( int capacity ) ;
 
     /** Destructeur virtual car nous avons un classe abstraite */
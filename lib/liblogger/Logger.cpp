@@ -42,6 +42,8 @@
 #include "sys/time.h"
 #include "time.h"
 #include <cstdio>
+#include <cstring>
+#include <pthread.h>
 #include <iostream>
 #include <fstream>
 
@@ -70,20 +72,24 @@ int logbuffer::sync() {
 }
 
 Accumulator* Logger::accumulator[nbLogLevel] = {0};
-static pthread_once_t key_once = PTHREAD_ONCE_INIT;
-static pthread_key_t logger_key[nbLogLevel];
 
-static void init_key() {
-    for (int i = 0; i < nbLogLevel; i++) pthread_key_create(&logger_key[i], 0);
-}
+/* Flux de log du thread courant, un par niveau */
+static __thread std::ostream* threadLoggers[nbLogLevel];
 
-void Logger::setAccumulator(LogLevel level, Accumulator* A) {
-    // On ajoute une petite tache d'initialisation qui doit être
-    // effectuée une seule fois. Il faut bien la mettre qqpart car
-    // nous n'avons pas de constructeur ni de condition d'initialisation.
-    pthread_once(&key_once, init_key); // initialize une seule fois logger_key
+/* Date formatée à la seconde près, recalculée uniquement au changement de seconde */
+static __thread time_t cachedSecond = -1;
+static __thread char cachedDate[32];
+
+pid_t Logger::pid = getpid();
 
+void Logger::refreshPid() {
+    pid = getpid();
+}
+
+/* Le processus fils d'un fork doit logger avec son propre pid */
+static int atforkRegistered = pthread_atfork(0, 0, Logger::refreshPid);
 
+void Logger::setAccumulator(LogLevel level, Accumulator* A) {
     Accumulator* prev = accumulator[level];
     accumulator[level] = A;
 
@@ -103,30 +109,44 @@ void Logger::setCurrentAccumulator(LogLevel level, Accumulator* A) {
 
 
 std::ostream& Logger::getLogger(LogLevel level) {
-    std::ostream *L;
-    if ((L = (std::ostream*) pthread_getspecific(logger_key[level])) == 0) {
+    std::ostream *L = threadLoggers[level];
+    if (L == 0) {
         L = new std::ostream(new logbuffer(level));
-        pthread_setspecific(logger_key[level], (void*) L);
+        threadLoggers[level] = L;
     }
 
     timeval tim;
     gettimeofday(&tim, NULL);
-    char date[64];
-    tm *now = localtime(&tim.tv_sec);
-    sprintf(date, "%04d/%02d/%02d %02d:%02d:%02d.%06d\t", now->tm_year+1900, now->tm_mon+1, now->tm_mday, now->tm_hour, now->tm_min, now->tm_sec, (int) (tim.tv_usec));
-    *L << date << "\t";
+    if (tim.tv_sec != cachedSecond) {
+        tm now;
+        localtime_r(&tim.tv_sec, &now);
+        sprintf(cachedDate, "%04d/%02d/%02d %02d:%02d:%02d.", now.tm_year+1900, now.tm_mon+1, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec);
+        cachedSecond = tim.tv_sec;
+    }
+
+    // Seules les microsecondes sont formatées à chaque ligne
+    char date[48];
+    int len = strlen(cachedDate);
+    memcpy(date, cachedDate, len);
+    int usec = (int) tim.tv_usec;
+    for (int i = len + 5; i >= len; i--) {
+        date[i] = '0' + usec % 10;
+        usec /= 10;
+    }
+    memcpy(date + len + 6, "\t\t", 3);
+
+    *L << date;
     return *L;
 }
 
 void Logger::stopLogger()
 {
     for ( int i = 0 ; i < nbLogLevel ; i++ ) {
-        std::ostream *L = (std::ostream*) pthread_getspecific(logger_key[( LogLevel ) i]);
+        std::ostream *L = threadLoggers[i];
         if (L != 0) {
             delete (logbuffer*) L->rdbuf(); // Delete the logbuffer associated with the outputstream
             delete L;
-            pthread_setspecific(logger_key[( LogLevel ) i], (void*) NULL);
+            threadLoggers[i] = 0;
         }
     }
 }
-
@@ -65,6 +65,11 @@ class Logger {
         // TODO: ce serait plus propre d'utiliser des shared_ptr
         static Accumulator* accumulator[nbLogLevel];
         static LogOutput logOutput;
+
+        /**
+         * Identifiant du processus, lu une seule fois (et mis à jour dans le processus fils après un fork)
+         */
+        static pid_t pid;
     public:
         /**
          * Obtient un pointeur vers la sortie du niveau de log.
@@ -106,6 +111,16 @@ class Logger {
          */
         static std::ostream& getLogger(LogLevel level);
 
+        /**
+         * Identifiant du processus courant, utilisé dans chaque ligne de log sans appel système.
+         */
+        inline static pid_t getPid() {return pid;}
+
+        /**
+         * Relit l'identifiant du processus. Appelée automatiquement dans le processus fils après un fork.
+         */
+        static void refreshPid();
+
         inline static void setOutput(LogOutput output) {logOutput=output;}
         inline static LogOutput& getOutput() {return logOutput;}
 
@@ -125,14 +140,19 @@ extern std::ostream nullstream;
 
 //#define LOGGER(x) (Logger::getAccumulator(x)?Logger::getLogger(x):nullstream)
 //#define LOGGER(x) (Logger::getOutput()==ROLLING_FILE?(Logger::getAccumulator(x)?Logger::getLogger(x):nullstream):std::cerr)
-#define LOGGER(x) (Logger::getAccumulator(x)?(Logger::getOutput()==STANDARD_OUTPUT_STREAM_FOR_ERRORS?std::cerr:Logger::getLogger(x)):nullstream)
+#define LOGGER_STREAM(x) (Logger::getOutput()==STANDARD_OUTPUT_STREAM_FOR_ERRORS?std::cerr:Logger::getLogger(x))
+#define LOGGER(x) (Logger::getAccumulator(x)?LOGGER_STREAM(x):nullstream)
 
-#define LOGGER_DEBUG(m) LOGGER(DEBUG)<<"pid="<<getpid()<<" DEBUG : "<<m<<" ("<<__FILE__<<":"<<__LINE__<<" in "<<__FUNCTION__<<")"<<std::endl
+/**
+ * Les niveaux désactivés ne coûtent qu'un test : le message n'est ni évalué ni formaté.
+ */
+#define LOGGER_LINE(x,m) do { if (Logger::getAccumulator(x)) { LOGGER_STREAM(x)<<m<<std::endl; } } while (0)
 
-#define LOGGER_INFO(m) LOGGER(INFO)<<"pid="<<getpid()<<"  INFO : "<<m<<std::endl
-#define LOGGER_WARN(m) LOGGER(WARN)<<"pid="<<getpid()<<"  WARN : "<<m<<std::endl
-#define LOGGER_ERROR(m) LOGGER(ERROR)<<"pid="<<getpid()<<" ERROR : "<<m<<std::endl
-#define LOGGER_FATAL(m) LOGGER(FATAL)<<"pid="<<getpid()<<" FATAL : "<<m<<std::endl
+#define LOGGER_DEBUG(m) LOGGER_LINE(DEBUG, "pid="<<Logger::getPid()<<" DEBUG : "<<m<<" ("<<__FILE__<<":"<<__LINE__<<" in "<<__FUNCTION__<<")")
 
+#define LOGGER_INFO(m) LOGGER_LINE(INFO, "pid="<<Logger::getPid()<<"  INFO : "<<m)
+#define LOGGER_WARN(m) LOGGER_LINE(WARN, "pid="<<Logger::getPid()<<"  WARN : "<<m)
+#define LOGGER_ERROR(m) LOGGER_LINE(ERROR, "pid="<<Logger::getPid()<<" ERROR : "<<m)
+#define LOGGER_FATAL(m) LOGGER_LINE(FATAL, "pid="<<Logger::getPid()<<" FATAL : "<<m)
 
 #endif
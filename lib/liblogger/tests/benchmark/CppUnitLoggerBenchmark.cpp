@@ -0,0 +1,268 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "Logger.h"
+#include <sys/time.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+/**
+ * Accumulateur de référence reprenant l'implémentation précédente : un tampon circulaire unique protégé par un mutex,
+ * vidé message par message par un thread d'écriture. Sert uniquement de point de comparaison pour le débit.
+ */
+class LockedStreamAccumulator {
+private:
+    std::ostream& out;
+    std::vector<std::string> buffer;
+    size_t front;
+    size_t size;
+    int status;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_get;
+    pthread_cond_t cond_add;
+    pthread_t threadId;
+
+    static void* loop ( void* arg ) {
+        LockedStreamAccumulator* A = ( LockedStreamAccumulator* ) arg;
+        while ( true ) {
+            pthread_mutex_lock ( &A->mutex );
+            while ( A->size == 0 && A->status > 0 ) pthread_cond_wait ( &A->cond_get, &A->mutex );
+            if ( A->size == 0 ) {
+                pthread_mutex_unlock ( &A->mutex );
+                break;
+            }
+            pthread_mutex_unlock ( &A->mutex );
+
+            A->out << A->buffer[A->front];
+            A->out.flush();
+
+            pthread_mutex_lock ( &A->mutex );
+            A->front = ( A->front + 1 ) % A->buffer.size();
+            A->size--;
+            pthread_cond_signal ( &A->cond_add );
+            pthread_mutex_unlock ( &A->mutex );
+        }
+        return NULL;
+    }
+
+public:
+    LockedStreamAccumulator ( std::ostream& out, int capacity = 1024 ) : out ( out ), buffer ( capacity ), front ( 0 ), size ( 0 ), status ( 1 ) {
+        pthread_mutex_init ( &mutex, 0 );
+        pthread_cond_init ( &cond_get, 0 );
+        pthread_cond_init ( &cond_add, 0 );
+        pthread_create ( &threadId, NULL, LockedStreamAccumulator::loop, ( void* ) this );
+    }
+
+    ~LockedStreamAccumulator() {
+        pthread_mutex_lock ( &mutex );
+        status = 0;
+        pthread_cond_signal ( &cond_get );
+        pthread_mutex_unlock ( &mutex );
+        pthread_join ( threadId, NULL );
+
+        pthread_cond_destroy ( &cond_get );
+        pthread_cond_destroy ( &cond_add );
+        pthread_mutex_destroy ( &mutex );
+    }
+
+    bool addMessage ( std::string message ) {
+        pthread_mutex_lock ( &mutex );
+        while ( size == buffer.size() ) pthread_cond_wait ( &cond_add, &mutex );
+        buffer[ ( front + size ) % buffer.size()] = message;
+        size++;
+        pthread_cond_signal ( &cond_get );
+        pthread_mutex_unlock ( &mutex );
+        return true;
+    }
+};
+
+/**
+ * Mesure du débit du logger lorsque plusieurs threads écrivent en même temps, comparé à celui de l'accumulateur à mutex unique,
+ * hors de la suite de tests par défaut (variable BENCHMARK). Les débits sont affichés sur la sortie standard.
+ */
+class CppUnitLoggerBenchmark : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitLoggerBenchmark );
+    // enregistrement des methodes de tests à jouer :
+    CPPUNIT_TEST ( test_contended_logging );
+    CPPUNIT_TEST ( test_compare_locked_accumulator );
+    CPPUNIT_TEST ( test_disabled_level );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+protected:
+
+    static const int messagesPerThread = 20000;
+
+    static double now() {
+        timeval tv;
+        gettimeofday ( &tv, NULL );
+        return tv.tv_sec + tv.tv_usec / 1000000.;
+    }
+
+    static void* log_info ( void* arg ) {
+        for ( int i = 0; i < messagesPerThread; i++ ) {
+            LOGGER_INFO ( "message " << i << " from a benchmark thread" );
+        }
+        Logger::stopLogger();
+        return NULL;
+    }
+
+    static int evaluations;
+
+    static int evaluate ( int i ) {
+        __atomic_add_fetch ( &evaluations, 1, __ATOMIC_RELAXED );
+        return i;
+    }
+
+    static void* log_debug ( void* arg ) {
+        for ( int i = 0; i < messagesPerThread; i++ ) {
+            LOGGER_DEBUG ( "message " << evaluate ( i ) << " from a benchmark thread" );
+        }
+        return NULL;
+    }
+
+    /**
+     * Lance threadsCount threads écrivant chacun messagesPerThread lignes, et renvoie le nombre de lignes écrites par seconde
+     */
+    double run ( int threadsCount, void* ( *function ) ( void* ) ) {
+        pthread_t threads[threadsCount];
+
+        double start = now();
+        for ( int i = 0; i < threadsCount; i++ ) pthread_create ( &threads[i], NULL, function, NULL );
+        for ( int i = 0; i < threadsCount; i++ ) pthread_join ( threads[i], NULL );
+        double elapsed = now() - start;
+
+        return ( double ) threadsCount * messagesPerThread / elapsed;
+    }
+
+    static Accumulator* lockFreeAccumulator;
+    static LockedStreamAccumulator* lockedAccumulator;
+
+    static void* add_lock_free ( void* arg ) {
+        for ( int i = 0; i < messagesPerThread; i++ ) {
+            std::ostringstream message;
+            message << "message " << i << " from a benchmark thread" << std::endl;
+            lockFreeAccumulator->addMessage ( message.str() );
+        }
+        return NULL;
+    }
+
+    static void* add_locked ( void* arg ) {
+        for ( int i = 0; i < messagesPerThread; i++ ) {
+            std::ostringstream message;
+            message << "message " << i << " from a benchmark thread" << std::endl;
+            lockedAccumulator->addMessage ( message.str() );
+        }
+        return NULL;
+    }
+
+    static int countLines ( std::stringstream& out ) {
+        std::string line;
+        int lines = 0;
+        while ( std::getline ( out, line ) ) lines++;
+        return lines;
+    }
+
+    void test_contended_logging() {
+        int threadsCounts[] = {1, 4, 16};
+
+        for ( int t = 0; t < 3; t++ ) {
+            std::stringstream out;
+            Accumulator* acc = new StreamAccumulator ( out );
+            Logger::setCurrentAccumulator ( INFO, acc );
+
+            double rate = run ( threadsCounts[t], log_info );
+
+            Logger::setCurrentAccumulator ( INFO, 0 );
+            acc->stop();
+            acc->destroy();
+            delete acc;
+
+            std::cout << std::endl << "INFO enabled, " << threadsCounts[t] << " thread(s) : " << ( long ) rate << " lines/s";
+            CPPUNIT_ASSERT_EQUAL ( threadsCounts[t] * messagesPerThread, countLines ( out ) );
+        }
+    }
+
+    void test_compare_locked_accumulator() {
+        int threadsCounts[] = {1, 4, 16};
+
+        for ( int t = 0; t < 3; t++ ) {
+            std::stringstream lockFreeOut;
+            lockFreeAccumulator = new StreamAccumulator ( lockFreeOut );
+            double lockFreeRate = run ( threadsCounts[t], add_lock_free );
+            lockFreeAccumulator->stop();
+            lockFreeAccumulator->destroy();
+            delete lockFreeAccumulator;
+
+            std::stringstream lockedOut;
+            lockedAccumulator = new LockedStreamAccumulator ( lockedOut );
+            double lockedRate = run ( threadsCounts[t], add_locked );
+            delete lockedAccumulator;
+
+            std::cout << std::endl << threadsCounts[t] << " thread(s) : per-thread queues " << ( long ) lockFreeRate << " lines/s, single mutex "
+                      << ( long ) lockedRate << " lines/s (x" << lockFreeRate / lockedRate << ")";
+
+            CPPUNIT_ASSERT_EQUAL ( threadsCounts[t] * messagesPerThread, countLines ( lockFreeOut ) );
+            CPPUNIT_ASSERT_EQUAL ( threadsCounts[t] * messagesPerThread, countLines ( lockedOut ) );
+        }
+        std::cout << std::endl;
+    }
+
+    void test_disabled_level() {
+        Logger::setCurrentAccumulator ( DEBUG, 0 );
+        evaluations = 0;
+
+        double rate = run ( 16, log_debug );
+
+        std::cout << std::endl << "DEBUG disabled, 16 thread(s) : " << ( long ) rate << " calls/s" << std::endl;
+        // Le message d'un niveau désactivé n'est jamais évalué
+        CPPUNIT_ASSERT_EQUAL ( 0, evaluations );
+    }
+
+};
+
+int CppUnitLoggerBenchmark::evaluations = 0;
+Accumulator* CppUnitLoggerBenchmark::lockFreeAccumulator = 0;
+LockedStreamAccumulator* CppUnitLoggerBenchmark::lockedAccumulator = 0;
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitLoggerBenchmark );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitLoggerBenchmark, "CppUnitLoggerBenchmark" );
@@ -37,6 +37,11 @@
 
 #include <cppunit/extensions/HelperMacros.h>
 #include "Logger.h"
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
 
 //#define LOGGER(x) if(Logger::getAccumulator(x)) Logger::getLogger(x)
 
@@ -45,21 +50,101 @@ class CppUnitLogger : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST_SUITE ( CppUnitLogger );
     // enregistrement des methodes de tests à jouer :
     CPPUNIT_TEST ( test_logger );
+    CPPUNIT_TEST ( test_threads );
+    CPPUNIT_TEST ( test_disabled_level );
     CPPUNIT_TEST_SUITE_END();
 
 public:
     void setUp() {};
 
 protected:
+
+    static const int threadsCount = 8;
+    static const int messagesPerThread = 500;
+
+    static void* log_info ( void* arg ) {
+        long t = ( long ) arg;
+        for ( int i = 0; i < messagesPerThread; i++ ) {
+            LOGGER_INFO ( "thread " << t << " message " << i );
+        }
+        // Comme un thread de traitement qui se termine : sa file est abandonnée puis libérée par le thread d'écriture
+        Logger::stopLogger();
+        return NULL;
+    }
+
+    static int evaluations;
+
+    static int evaluate ( int i ) {
+        __atomic_add_fetch ( &evaluations, 1, __ATOMIC_RELAXED );
+        return i;
+    }
+
+    static void* log_debug ( void* arg ) {
+        for ( int i = 0; i < messagesPerThread; i++ ) {
+            LOGGER_DEBUG ( "message " << evaluate ( i ) );
+        }
+        return NULL;
+    }
+
+    static void runThreads ( long first, void* ( *function ) ( void* ) ) {
+        pthread_t threads[threadsCount];
+        for ( long t = 0; t < threadsCount; t++ ) pthread_create ( &threads[t], NULL, function, ( void* ) ( first + t ) );
+        for ( int t = 0; t < threadsCount; t++ ) pthread_join ( threads[t], NULL );
+    }
+
+    void test_threads() {
+        std::stringstream out;
+        Accumulator* acc = new StreamAccumulator ( out );
+        Logger::setCurrentAccumulator ( INFO, acc );
+
+        // Deux vagues de threads : la seconde écrit pendant que les files de la première sont libérées
+        runThreads ( 0, log_info );
+        runThreads ( threadsCount, log_info );
+
+        Logger::setCurrentAccumulator ( INFO, 0 );
+        acc->stop();
+        acc->destroy();
+        delete acc;
+
+        // Aucune ligne perdue, et les lignes de chaque thread dans l'ordre
+        std::vector<int> next ( 2 * threadsCount, 0 );
+        std::string line;
+        while ( std::getline ( out, line ) ) {
+            size_t pos = line.find ( "thread " );
+            CPPUNIT_ASSERT_MESSAGE ( "Unexpected line : " + line, pos != std::string::npos );
+            int t, i;
+            CPPUNIT_ASSERT_EQUAL ( 2, sscanf ( line.c_str() + pos, "thread %d message %d", &t, &i ) );
+            CPPUNIT_ASSERT ( t >= 0 && t < 2 * threadsCount );
+            CPPUNIT_ASSERT_EQUAL ( next[t], i );
+            next[t]++;
+        }
+        for ( int t = 0; t < 2 * threadsCount; t++ ) CPPUNIT_ASSERT_EQUAL ( messagesPerThread, next[t] );
+    }
+
+    void test_disabled_level() {
+        Logger::setCurrentAccumulator ( DEBUG, 0 );
+        evaluations = 0;
+
+        runThreads ( 0, log_debug );
+
+        // Le message d'un niveau désactivé n'est jamais évalué
+        CPPUNIT_ASSERT_EQUAL ( 0, evaluations );
+    }
+
     void test_logger() {
         std::stringstream out;
         Accumulator* acc = new StreamAccumulator ( out );
         Logger::setAccumulator ( DEBUG, acc );
 
         for ( int i = 0; i < 200; i++ ) LOGGER ( DEBUG ) << i << std::endl;
-        //Logger::setAccumulator ( DEBUG, 0 );
         Logger::stopLogger();
 
+        // Les messages sont écrits par le thread de l'accumulateur : on l'arrête avant de lire la sortie
+        Logger::setCurrentAccumulator ( DEBUG, 0 );
+        acc->stop();
+        acc->destroy();
+        delete acc;
+
         for ( int i = 0; i < 200; i++ ) {
             std::string s1, s2;
             int n;
@@ -70,5 +155,7 @@ protected:
 
 };
 
+int CppUnitLogger::evaluations = 0;
+
 CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitLogger );
 CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitLogger, "CppUnitLogger" );
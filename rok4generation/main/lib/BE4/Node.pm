@@ -606,7 +606,7 @@ sub work2cache {
 =begin nd
 Function: wms2work
 
-Fetch image corresponding to the node thanks to 'wget', in one or more steps at a time. WMS service is described in the current graph's datasource. Use the 'Wms2work' bash function.
+Fetch image corresponding to the node thanks to 'wms2work', in one or more parallel requests. WMS service is described in the current graph's datasource. Use the 'Wms2work' bash function.
 
 Parameters (list):
     harvesting - <COMMON::Harvesting> - To use to harvest image.
@@ -638,15 +638,12 @@ sub wms2work {
 
     # Écriture de la commande
 
-    $this->{workExtension} = $harvesting->getHarvestExtension();
-    if (scalar @bboxes > 1) {
-        $this->{workExtension} = "tif";
-    }
+    # Les images moissonnées sont assemblées et écrites en TIFF par wms2work
+    $this->{workExtension} = "tif";
 
     $this->{script}->write(
-        sprintf "Wms2work \"%s\" \"%s\" \"%s\" \"%s\" \"%s\" \"%s\" \$BBOXES\n",
+        sprintf "Wms2work \"%s\" \"%s\" \"%s\" \"%s\" \$BBOXES\n",
             $this->{workImageBasename},
-            $harvesting->getHarvestExtension(), $this->{workExtension},
             $harvesting->getMinSize(), $harvesting->getHarvestUrl($tms->getSRS(), $width, $height), $grid
     );
     
@@ -570,63 +570,23 @@ FUNCTION
 my $HARVESTFUNCTION = <<'HARVESTFUNCTION';
 Wms2work () {
     local workName=$1
-    local harvestExtension=$2
-    local finalExtension=$3
-    local minSize=$4
-    local url=$5
-    local grid=$6
-    shift 6
+    local minSize=$2
+    local url=$3
+    local grid=$4
+    shift 4
 
     if [[ "${work}" == "0" ]]; then
         return
     fi
 
-    local size=0
-
-    mkdir -p ${TMP_DIR}/harvesting/
-
-    for i in `seq 1 $#`;
-    do
-        nameImg=`printf "${TMP_DIR}/harvesting/img%.5d.$harvestExtension" $i`
-        local count=0; local wait_delay=1
-        while :
-        do
-            let count=count+1
-            wget --no-verbose -O $nameImg "$url&BBOX=$1"
-
-            if [ $? == 0 ] ; then
-                checkWork $nameImg 2>/dev/null
-                if [ $? == 0 ] ; then
-                    break
-                fi
-            fi
-            
-            echo "Failure $count : wait for $wait_delay s"
-            sleep $wait_delay
-            let wait_delay=wait_delay*2
-            if [ 3600 -lt $wait_delay ] ; then 
-                let wait_delay=3600
-            fi
-        done
-        let size=`stat -c "%s" $nameImg`+$size
-
-        shift
-    done
-    
-    if [ "$size" -le "$minSize" ] ; then
-        RM_IMGS["${TMP_DIR}/${workName}.${finalExtension}"]="1"
-        rm -rf ${TMP_DIR}/harvesting/
-        return
-    fi
+    # Aucune image n'est écrite si les réponses sont trop petites
+    rm -f ${TMP_DIR}/${workName}.tif
+    wms2work -u "$url" -g $grid -c zip -m $minSize ${TMP_DIR}/${workName}.tif $@
+    if [ $? != 0 ] ; then echo $0 : Erreur a la ligne $(( $LINENO - 1)) >&2 ; exit 1; fi
 
-    if [ "$grid" != "1 1" ] ; then
-        composeNtiff -g $grid -s ${TMP_DIR}/harvesting/ -c zip ${TMP_DIR}/${workName}.${finalExtension}
-        if [ $? != 0 ] ; then echo $0 : Erreur a la ligne $(( $LINENO - 1)) >&2 ; exit 1; fi
-    else
-        mv ${TMP_DIR}/harvesting/img00001.${harvestExtension} ${TMP_DIR}/${workName}.${finalExtension}
+    if [ ! -f ${TMP_DIR}/${workName}.tif ] ; then
+        RM_IMGS["${TMP_DIR}/${workName}.tif"]="1"
     fi
-
-    rm -rf ${TMP_DIR}/harvesting/
 }
 HARVESTFUNCTION
 
@@ -1054,10 +1014,10 @@ sub getScriptInitialization {
         $pyramid->getImageSpec()->getPixel()->getSampleFormat();
 
     if ($pyramid->getImageSpec()->getCompressionOption() eq 'crop') {
-        $string .= " -crop\"\n";
-    } else {
-        $string .= "\"\n";
+        $string .= " -crop";
     }
+    $string .= $pyramid->getImageSpec()->getWork2cacheJpegOptions();
+    $string .= "\"\n";
 
     if ($pyramid->getTileMatrixSet()->isQTree()) {
         $string .= sprintf "MERGE4TIFF_OPTIONS=\"-c zip -g %s -n %s -s %s -b %s -a %s\"\n",
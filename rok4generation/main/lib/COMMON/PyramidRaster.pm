@@ -369,6 +369,10 @@ sub _load {
 
         $this->{pyrImgSpec} = $ancestor->getImageSpec();
         $this->{pyrImgSpec}->setCompressionOption($params->{compressionoption});
+        if (! $this->{pyrImgSpec}->setJpegOptions($params)) {
+            ERROR ("Can not apply JPEG options to the ancestor's images specification !");
+            return FALSE;
+        }
 
         $this->{nodata} = $ancestor->getNodata();
 
@@ -70,6 +70,10 @@ Attributes:
     compressionoption - string - Precise additionnal actions, to do before compression. Just "crop" is available, with JPEG compression. It's allowed to empty blocs which contain white pixel, to keep pure white, even with JPEG compression.
     interpolation - string - Image could be resampling. Resampling use a kind of interpolation.
     gamma - float - Positive, used by merge4tiff to make dark (between 0 and 1) or light (greater than 1) RGB images. 1 is a neutral value.
+    jpeg_quality - integer - JPEG quality, from 1 to 100. Only with JPEG compression, libjpeg default if undefined.
+    jpeg_subsampling - string - JPEG chroma subsampling : 4:2:0, 4:2:2 or 4:4:4. Only with JPEG compression, libjpeg default if undefined.
+    jpeg_dct - string - JPEG DCT method : islow, ifast or float. Only with JPEG compression, libjpeg default if undefined.
+    jpeg_optimize - boolean - Huffman tables optimisation. Only with JPEG compression.
     formatCode - string - Used in the pyramid's descriptor. Format is : TIFF_<COMPRESSION>_<SAMPLEFORMAT><BITSPERSAMPLE> (TIFF_RAW_INT8).
 =cut
 
@@ -106,6 +110,14 @@ use constant FALSE => 0;
 # Define allowed values for attributes compression options.
 my @COMPRESSIONOPTIONS = ('none','crop');
 
+# Constant: JPEGSUBSAMPLINGS
+# Define allowed values for attribute jpeg_subsampling.
+my @JPEGSUBSAMPLINGS = ('4:2:0','4:2:2','4:4:4');
+
+# Constant: JPEGDCTS
+# Define allowed values for attribute jpeg_dct.
+my @JPEGDCTS = ('islow','ifast','float');
+
 # Constant: COMPRESSIONS
 # Define allowed values for attributes compression
 my @COMPRESSIONS = ('raw','jpg','png','lzw','zip','pkb');
@@ -185,7 +197,7 @@ PyrImageSpec constructor. Bless an instance. Possibilities :
     - bitspersample or samplesperpixel or photometric or sampleformat is not provided by configuration. We try to use those from image source
     - bitspersample and samplesperpixel and photometric and sampleformat is provided by configuration : we use it, with potentially conversion
 
-Gamma, interpolation and compressionoption own default value, but we have to provide it in configuration file if we want special value.
+Gamma, interpolation and compressionoption own default value, but we have to provide it in configuration file if we want special value. JPEG options (jpeg_quality, jpeg_subsampling, jpeg_dct, jpeg_optimize) are only read from the configuration, they are not stored in the pyramid's descriptor.
 
 Parameters (list):
     params - string hash - Pyramid parameters, from configuration file or ancestor's pyramid descriptor
@@ -207,6 +219,10 @@ sub new {
         compressionoption => undef,
         interpolation => undef,
         gamma  => undef,
+        jpeg_quality => undef,
+        jpeg_subsampling => undef,
+        jpeg_dct => undef,
+        jpeg_optimize => FALSE,
         formatCode  => undef
     };
 
@@ -322,6 +338,11 @@ sub _load {
     }
     $this->{gamma} = $params->{gamma};
 
+    ### JPEG options
+    if (! $this->setJpegOptions($params)) {
+        return FALSE;
+    }
+
     ### Format code : TIFF_[COMPRESSION]_[SAMPLEFORMAT][BITSPERSAMPLE]
     $this->{formatCode} = sprintf "TIFF_%s_%s%s",
         uc $this->{compression},
@@ -374,6 +395,86 @@ sub setCompressionOption {
     }
 }
 
+=begin nd
+Function: setJpegOptions
+
+Checks and stores JPEG options (jpeg_quality, jpeg_subsampling, jpeg_dct and jpeg_optimize). They are only allowed with JPEG compression. Undefined options keep the libjpeg default.
+
+Parameters (list):
+    params - string hash - Pyramid parameters, from configuration file
+=cut
+sub setJpegOptions {
+    my $this = shift;
+    my $params = shift;
+
+    my $hasJpegOptions = FALSE;
+    foreach my $option ('jpeg_quality', 'jpeg_subsampling', 'jpeg_dct', 'jpeg_optimize') {
+        if (exists $params->{$option} && defined $params->{$option}) {
+            $hasJpegOptions = TRUE;
+        }
+    }
+    return TRUE if (! $hasJpegOptions);
+
+    if ($this->{compression} ne "jpg") {
+        ERROR (sprintf "JPEG options (jpeg_quality, jpeg_subsampling, jpeg_dct, jpeg_optimize) are reserved for jpg compression, not %s", $this->{compression});
+        return FALSE;
+    }
+
+    if (exists $params->{jpeg_quality} && defined $params->{jpeg_quality}) {
+        if (! COMMON::CheckUtils::isStrictPositiveInt($params->{jpeg_quality}) || $params->{jpeg_quality} > 100) {
+            ERROR (sprintf "jpeg_quality have to be an integer between 1 and 100 : %s", $params->{jpeg_quality});
+            return FALSE;
+        }
+        $this->{jpeg_quality} = $params->{jpeg_quality};
+    }
+
+    if (exists $params->{jpeg_subsampling} && defined $params->{jpeg_subsampling}) {
+        if (! defined COMMON::Array::isInArray($params->{jpeg_subsampling}, @JPEGSUBSAMPLINGS) ) {
+            ERROR (sprintf "Unknown jpeg_subsampling : '%s'", $params->{jpeg_subsampling});
+            return FALSE;
+        }
+        $this->{jpeg_subsampling} = $params->{jpeg_subsampling};
+    }
+
+    if (exists $params->{jpeg_dct} && defined $params->{jpeg_dct}) {
+        if (! defined COMMON::Array::isInArray($params->{jpeg_dct}, @JPEGDCTS) ) {
+            ERROR (sprintf "Unknown jpeg_dct : '%s'", $params->{jpeg_dct});
+            return FALSE;
+        }
+        $this->{jpeg_dct} = $params->{jpeg_dct};
+    }
+
+    if (exists $params->{jpeg_optimize} && defined $params->{jpeg_optimize}) {
+        if (uc($params->{jpeg_optimize}) eq "TRUE") {
+            $this->{jpeg_optimize} = TRUE;
+        } elsif (uc($params->{jpeg_optimize}) eq "FALSE") {
+            $this->{jpeg_optimize} = FALSE;
+        } else {
+            ERROR (sprintf "jpeg_optimize have to be TRUE or FALSE : %s", $params->{jpeg_optimize});
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+=begin nd
+Function: getWork2cacheJpegOptions
+
+Returns the work2cache options for the JPEG options (" -quality 85 -subsampling 4:4:4" for example), an empty string if none is set.
+=cut
+sub getWork2cacheJpegOptions {
+    my $this = shift;
+
+    my $options = "";
+    $options .= sprintf " -quality %s", $this->{jpeg_quality} if (defined $this->{jpeg_quality});
+    $options .= sprintf " -subsampling %s", $this->{jpeg_subsampling} if (defined $this->{jpeg_subsampling});
+    $options .= sprintf " -dct %s", $this->{jpeg_dct} if (defined $this->{jpeg_dct});
+    $options .= " -optimize" if ($this->{jpeg_optimize});
+
+    return $options;
+}
+
 # Function: getFormatCode
 sub getFormatCode {
     my $this = shift;
@@ -403,6 +504,7 @@ Example:
                 - Compression option : none
                 - Interpolation : bicubic
                 - Gamma : 1
+                - JPEG options :
                 - Format code : TIFF_RAW_INT8
          Pixel components :
     Object COMMON::Pixel :
@@ -423,6 +525,7 @@ sub exportForDebug {
     $export .= sprintf "\t\t- Compression option : %s\n", $this->{compressionoption};
     $export .= sprintf "\t\t- Interpolation : %s\n", $this->{interpolation};
     $export .= sprintf "\t\t- Gamma : %s\n", $this->{gamma};
+    $export .= sprintf "\t\t- JPEG options :%s\n", $this->getWork2cacheJpegOptions();
     $export .= sprintf "\t\t- Format code : %s\n", $this->{formatCode};
     
     $export .= sprintf "\t Pixel components : %s\n", $this->{pixel}->exportForDebug();
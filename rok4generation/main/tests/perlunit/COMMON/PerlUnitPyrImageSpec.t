@@ -240,5 +240,65 @@ undef $pis;
 
 ######################################################
 
+# Test on JPEG options
+$pis = COMMON::PyramidRasterSpec->new({
+    samplesperpixel => 3,
+    bitspersample => 8,
+    sampleformat => "uint",
+    photometric => "rgb",
+    compression => "jpg",
+    compressionoption => "crop",
+    jpeg_quality => 85,
+    jpeg_subsampling => "4:4:4",
+    jpeg_dct => "ifast",
+    jpeg_optimize => "TRUE"
+});
+
+is ($pis->getWork2cacheJpegOptions(), " -quality 85 -subsampling 4:4:4 -dct ifast -optimize", "JPEG options are given to work2cache");
+undef $pis;
+
+$pis = COMMON::PyramidRasterSpec->new({
+    samplesperpixel => 3,
+    bitspersample => 8,
+    sampleformat => "uint",
+    photometric => "rgb",
+    compression => "jpg"
+});
+
+is ($pis->getWork2cacheJpegOptions(), "", "No JPEG option by default");
+
+ok ($pis->setJpegOptions({ jpeg_quality => 90 }), "JPEG options can be set after creation (ancestor)");
+is ($pis->getWork2cacheJpegOptions(), " -quality 90", "JPEG option set after creation is given to work2cache");
+ok (! $pis->setJpegOptions({ jpeg_dct => "fast" }), "Incorrect value detected for 'jpeg_dct'");
+undef $pis;
+
+foreach my $wrong ({ jpeg_quality => 0 }, { jpeg_quality => 101 }, { jpeg_quality => "high" }, { jpeg_subsampling => "4:1:1" }, { jpeg_optimize => "yes" }) {
+    $pis = COMMON::PyramidRasterSpec->new({
+        samplesperpixel => 3,
+        bitspersample => 8,
+        sampleformat => "uint",
+        photometric => "rgb",
+        compression => "jpg",
+        %{$wrong}
+    });
+
+    ok (! defined $pis, sprintf "Incorrect value detected for '%s'", (keys %{$wrong})[0]);
+    undef $pis;
+}
+
+$pis = COMMON::PyramidRasterSpec->new({
+    samplesperpixel => 3,
+    bitspersample => 8,
+    sampleformat => "uint",
+    photometric => "rgb",
+    compression => "png",
+    jpeg_quality => 85
+});
+
+ok (! defined $pis, "JPEG options are accepted ONLY for jpeg compression");
+undef $pis;
+
+######################################################
+
 done_testing();
 
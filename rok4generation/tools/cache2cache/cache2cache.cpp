@@ -0,0 +1,577 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file cache2cache.cpp
+ * \author Institut national de l'information géographique et forestière
+ * \~french \brief Copie ou lie une liste de dalles d'un stockage à un autre
+ * \~french \details Les dalles sont transférées par plusieurs flux parallèles, chacun gardant ses connexions aux stockages d'un bout à l'autre du transfert.
+ * Les dalles traitées sont notées dans un fichier de reprise, permettant de relancer le transfert sans refaire ce qui l'a déjà été.
+ * \~english \brief Copy or link a list of slabs from a storage to another one
+ * \~english \details Slabs are transfered with parallel streams, each one keeping its storages' connections along the transfer.
+ * Processed slabs are written in a checkpoint file, allowing to restart the transfer without doing again what is done.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "Logger.h"
+#include "ContextBook.h"
+#include "CurlPool.h"
+#include "../../../rok4version.h"
+
+/** \~french Taille des lectures successives d'une dalle */
+#define READ_CHUNK_SIZE 4194304
+/** \~french Nombre maximal de flux parallèles */
+#define MAX_STREAMS 64
+/** \~french Période minimale en secondes entre deux affichages de la progression */
+#define REPORT_PERIOD 10
+
+/** \~french Message d'usage de la commande cache2cache */
+std::string help = std::string("\ncache2cache version ") + std::string(ROK4_VERSION) + "\n\n"
+
+    "Copy or link ROK4 slabs from a storage to another one\n\n"
+
+    "Usage: cache2cache -i <SLABS LIST> [-dir_src <DIRECTORY>|-pool_src <POOL>|-bucket_src <BUCKET>|-container_src <CONTAINER>] [-dir <DIRECTORY>|-pool <POOL>|-bucket <BUCKET>|-container <CONTAINER>] [-j <VAL>] [-l <VAL>] [-k <CHECKPOINT FILE>] [-d]\n\n"
+
+    "Parameters:\n"
+    "    -i slabs list, one operation per line :\n"
+    "             <SOURCE> <DESTINATION>    copy the source slab to the destination\n"
+    "             LINK <TARGET> <LINK>      make the destination slab LINK a symbolic slab to TARGET\n"
+    "    -dir_src source directory, slabs' names are relative to it. Default : files, names are paths\n"
+    "    -pool_src Ceph pool where source slabs are (ONLY IF OBJECT COMPILATION)\n"
+    "    -bucket_src S3 bucket where source slabs are (ONLY IF OBJECT COMPILATION)\n"
+    "    -container_src Swift container where source slabs are (ONLY IF OBJECT COMPILATION)\n"
+    "    -dir destination directory, slabs' names are relative to it. Default : files, names are paths\n"
+    "    -pool Ceph pool where slabs are written (ONLY IF OBJECT COMPILATION)\n"
+    "    -bucket S3 bucket where slabs are written (ONLY IF OBJECT COMPILATION)\n"
+    "    -container Swift container where slabs are written (ONLY IF OBJECT COMPILATION)\n"
+    "    -j number of parallel streams, each one with its own storages' connections. Default : 1\n"
+    "    -l slabs whose size is lower or equal to this limit (in bytes) are not copied. Default : 0\n"
+    "    -k checkpoint file : processed destinations are appended, and skipped if the command is launched again\n"
+    "    -d debug logger activation\n\n"
+
+    "Example\n"
+    "     cache2cache -i slabs.txt -dir_src /data/PYRAMID/ -pool PYRAMIDS -j 16 -k slabs.done\n";
+
+/**
+ * \~french
+ * \brief Affiche l'utilisation et les différentes options de la commande cache2cache #help
+ * \details L'affichage se fait dans le niveau de logger INFO
+ */
+void usage() {
+    LOGGER_INFO ( help );
+}
+
+/**
+ * \~french
+ * \brief Affiche un message d'erreur, l'utilisation de la commande et sort en erreur
+ * \param[in] message message d'erreur
+ * \param[in] errorCode code de retour
+ */
+void error ( std::string message, int errorCode ) {
+    LOGGER_ERROR ( message );
+    usage();
+    sleep ( 1 );
+    exit ( errorCode );
+}
+
+/**
+ * \~french \brief Opération sur une dalle
+ * \~english \brief Slab's operation
+ */
+struct SlabOperation {
+    /** \~french \brief Création d'une dalle symbolique plutôt que copie */
+    bool link;
+    /** \~french \brief Dalle à copier, ou cible de la dalle symbolique */
+    std::string source;
+    /** \~french \brief Dalle écrite dans le stockage de destination */
+    std::string destination;
+};
+
+/** \~french Résultat du traitement d'une dalle */
+enum SlabResult {
+    COPIED,
+    LINKED,
+    MISSING,
+    SKIPPED,
+    FAILED
+};
+
+/** \~french Stockage des dalles sources */
+ContextType::eContextType sourceType = ContextType::FILECONTEXT;
+std::string sourceTray = "";
+/** \~french Stockage des dalles écrites */
+ContextType::eContextType destinationType = ContextType::FILECONTEXT;
+std::string destinationTray = "";
+
+/** \~french Taille en octets en dessous de laquelle (incluse) une dalle n'est pas copiée */
+long slabLimit = 0;
+
+/** \~french Opérations à réaliser */
+std::vector<SlabOperation> operations;
+
+/** \~french Protège les éléments partagés par les flux : prochaine opération, compteurs et fichier de reprise */
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+size_t nextOperation = 0;
+std::ofstream checkpoint;
+uint64_t counts[FAILED + 1] = { 0, 0, 0, 0, 0 };
+uint64_t transferedBytes = 0;
+double startTime;
+double lastReport;
+/** \~french Un flux n'a pas pu se connecter aux stockages */
+bool connectionError = false;
+
+/**
+ * \~french \brief Instant courant en secondes
+ */
+double now() {
+    struct timespec ts;
+    clock_gettime ( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * \~french \brief Affiche la progression et le débit depuis le début du transfert
+ */
+void report ( double t ) {
+    double elapsed = t - startTime;
+    size_t done = counts[COPIED] + counts[LINKED] + counts[MISSING] + counts[SKIPPED] + counts[FAILED];
+    std::ostringstream oss;
+    oss.setf ( std::ios::fixed, std::ios::floatfield );
+    oss.precision ( 2 );
+    oss << done << "/" << operations.size() << " slabs (" << counts[COPIED] << " copied, " << counts[LINKED] << " linked, "
+        << counts[MISSING] << " missing, " << counts[SKIPPED] << " under limit, " << counts[FAILED] << " failed) - "
+        << transferedBytes / 1048576. << " MB in " << elapsed << " s - "
+        << ( elapsed > 0 ? transferedBytes / 1048576. / elapsed : 0. ) << " MB/s, "
+        << ( elapsed > 0 ? done / elapsed : 0. ) << " slabs/s";
+    LOGGER_INFO ( oss.str() );
+}
+
+/**
+ * \~french \brief Crée les dossiers parents d'un fichier
+ */
+bool createParentDirectories ( std::string path ) {
+    for ( size_t pos = path.find ( '/', 1 ); pos != std::string::npos; pos = path.find ( '/', pos + 1 ) ) {
+        if ( mkdir ( path.substr ( 0, pos ).c_str(), ACCESSPERMS ) != 0 && errno != EEXIST ) {
+            LOGGER_ERROR ( "Cannot create directory " << path.substr ( 0, pos ) << " : " << strerror ( errno ) );
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * \~french
+ * \brief Lit une dalle entière, de taille connue
+ * \details La dalle est lue par blocs de #READ_CHUNK_SIZE. Toute lecture incomplète est une erreur : une dalle tronquée n'est jamais copiée.
+ * \return faux si la dalle n'a pas pu être lue entièrement
+ */
+bool readSlab ( Context* context, std::string name, std::vector<uint8_t>& buffer, long size ) {
+
+    buffer.resize ( size + 1 );
+
+    for ( long offset = 0; offset < size; offset += READ_CHUNK_SIZE ) {
+        int length = std::min ( ( long ) READ_CHUNK_SIZE, size - offset );
+        if ( context->read ( &buffer[offset], offset, length, name ) != length ) return false;
+    }
+    return true;
+}
+
+/**
+ * \~french \brief Écrit une dalle entière dans le stockage de destination
+ */
+bool writeSlab ( Context* context, std::string name, uint8_t* data, long size ) {
+    if ( context->getType() == ContextType::FILECONTEXT && ! createParentDirectories ( context->getTray() + name ) ) return false;
+
+    if ( ! context->openToWrite ( name ) ) {
+        LOGGER_ERROR ( "Cannot open " << name << " to write" );
+        return false;
+    }
+    if ( ! context->writeFull ( data, size, name ) ) {
+        LOGGER_ERROR ( "Cannot write " << name );
+        context->closeToWrite ( name );
+        return false;
+    }
+    if ( ! context->closeToWrite ( name ) ) {
+        LOGGER_ERROR ( "Cannot close " << name );
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \~french
+ * \brief Crée une dalle symbolique
+ * \details Lien symbolique pour un fichier, objet contenant "SYMLINK#" suivi du nom de la cible sinon.
+ */
+SlabResult linkSlab ( Context* destination, SlabOperation& op ) {
+    if ( destination->getType() == ContextType::FILECONTEXT ) {
+        std::string path = destination->getTray() + op.destination;
+        if ( ! createParentDirectories ( path ) ) return FAILED;
+        // Une reprise peut retrouver le lien déjà créé
+        if ( unlink ( path.c_str() ) != 0 && errno != ENOENT ) {
+            LOGGER_ERROR ( "Cannot remove existing " << path << " : " << strerror ( errno ) );
+            return FAILED;
+        }
+        if ( symlink ( op.source.c_str(), path.c_str() ) != 0 ) {
+            LOGGER_ERROR ( "Cannot link " << path << " to " << op.source << " : " << strerror ( errno ) );
+            return FAILED;
+        }
+        return LINKED;
+    }
+
+    std::string content = "SYMLINK#" + op.source;
+    if ( ! writeSlab ( destination, op.destination, ( uint8_t* ) content.data(), content.size() ) ) return FAILED;
+    return LINKED;
+}
+
+/**
+ * \~french \brief Copie une dalle, sauf si elle est absente ou trop petite
+ */
+SlabResult copySlab ( Context* source, Context* destination, SlabOperation& op, std::vector<uint8_t>& buffer, long& size ) {
+    bool exists;
+    if ( ! source->getSize ( op.source, size, exists ) ) {
+        LOGGER_ERROR ( "Cannot get size of " << op.source );
+        size = 0;
+        return FAILED;
+    }
+    if ( ! exists ) {
+        LOGGER_INFO ( op.source << " does not exist, skipped" );
+        size = 0;
+        return MISSING;
+    }
+    if ( size <= slabLimit ) {
+        size = 0;
+        return SKIPPED;
+    }
+    if ( ! readSlab ( source, op.source, buffer, size ) ) {
+        LOGGER_ERROR ( "Cannot read " << size << " bytes of " << op.source );
+        size = 0;
+        return FAILED;
+    }
+    if ( ! writeSlab ( destination, op.destination, &buffer[0], size ) ) return FAILED;
+    return COPIED;
+}
+
+/**
+ * \~french
+ * \brief Flux de transfert
+ * \details Chaque flux se connecte une seule fois aux stockages puis traite les opérations suivantes de la liste jusqu'à son épuisement.
+ */
+void* transferSlabs ( void* arg ) {
+
+    ContextBook book;
+    Context* source = book.addContext ( sourceType, sourceTray );
+    Context* destination = book.addContext ( destinationType, destinationTray );
+    if ( source == NULL || destination == NULL ) {
+        pthread_mutex_lock ( &mutex );
+        connectionError = true;
+        pthread_mutex_unlock ( &mutex );
+        return NULL;
+    }
+    source->setAttempts ( 10 );
+    destination->setAttempts ( 10 );
+
+    std::vector<uint8_t> buffer;
+
+    while ( true ) {
+        pthread_mutex_lock ( &mutex );
+        if ( nextOperation >= operations.size() ) {
+            pthread_mutex_unlock ( &mutex );
+            break;
+        }
+        SlabOperation& op = operations.at ( nextOperation++ );
+        pthread_mutex_unlock ( &mutex );
+
+        long size = 0;
+        SlabResult result;
+        if ( op.link ) {
+            result = linkSlab ( destination, op );
+        } else {
+            result = copySlab ( source, destination, op, buffer, size );
+        }
+
+        pthread_mutex_lock ( &mutex );
+        counts[result]++;
+        if ( result == COPIED ) transferedBytes += size;
+        if ( result != FAILED && checkpoint.is_open() ) {
+            checkpoint << op.destination << std::endl;
+        }
+        double t = now();
+        if ( t - lastReport >= REPORT_PERIOD ) {
+            lastReport = t;
+            report ( t );
+        }
+        pthread_mutex_unlock ( &mutex );
+    }
+
+    return NULL;
+}
+
+/**
+ * \~french \brief Lit une option de stockage, et précise le type et le contenant correspondant
+ * \return vrai si l'argument est une option de stockage
+ */
+bool parseStorage ( int argc, char** argv, int& i, std::string suffix, ContextType::eContextType& type, std::string& tray ) {
+    std::string option = argv[i];
+    ContextType::eContextType optionType;
+
+    if ( option == "-dir" + suffix ) {
+        optionType = ContextType::FILECONTEXT;
+    }
+#if BUILD_OBJECT
+    else if ( option == "-pool" + suffix ) {
+        optionType = ContextType::CEPHCONTEXT;
+    } else if ( option == "-bucket" + suffix ) {
+        optionType = ContextType::S3CONTEXT;
+    } else if ( option == "-container" + suffix ) {
+        optionType = ContextType::SWIFTCONTEXT;
+    }
+#endif
+    else {
+        return false;
+    }
+
+    if ( ++i == argc ) {
+        error ( "Error in " + option + " option", -1 );
+    }
+    type = optionType;
+    tray = argv[i];
+    if ( type == ContextType::FILECONTEXT && tray.size() > 0 && tray[tray.size() - 1] != '/' ) {
+        tray += "/";
+    }
+    return true;
+}
+
+/**
+ ** \~french
+ * \brief Fonction principale de l'outil cache2cache
+ * \param[in] argc nombre de paramètres
+ * \param[in] argv tableau des paramètres
+ * \return code de retour, 0 en cas de succès, 1 si des dalles n'ont pu être transférées, -1 en cas d'erreur
+ ** \~english
+ * \brief Main function for tool cache2cache
+ * \param[in] argc parameters number
+ * \param[in] argv parameters array
+ * \return return code, 0 if success, 1 if some slabs could not be transfered, -1 if error
+ */
+int main ( int argc, char **argv ) {
+
+    char* listPath = 0, *checkpointPath = 0;
+    int streams = 1;
+    bool debugLogger = false;
+
+    /* Initialisation des Loggers */
+    Logger::setOutput ( STANDARD_OUTPUT_STREAM_FOR_ERRORS );
+
+    Accumulator* acc = new StreamAccumulator();
+    Logger::setAccumulator ( INFO , acc );
+    Logger::setAccumulator ( WARN , acc );
+    Logger::setAccumulator ( ERROR, acc );
+    Logger::setAccumulator ( FATAL, acc );
+
+    std::ostream &logw = LOGGER ( WARN );
+    logw.precision ( 16 );
+    logw.setf ( std::ios::fixed,std::ios::floatfield );
+
+    for ( int i = 1; i < argc; i++ ) {
+
+        if ( parseStorage ( argc, argv, i, "_src", sourceType, sourceTray ) ) continue;
+        if ( parseStorage ( argc, argv, i, "", destinationType, destinationTray ) ) continue;
+
+        if ( argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' ) {
+            switch ( argv[i][1] ) {
+            case 'h': // help
+                usage();
+                exit ( 0 );
+            case 'd': // debug logs
+                debugLogger = true;
+                break;
+            case 'i': // liste des dalles
+                if ( ++i == argc ) error ( "Error in -i option", -1 );
+                listPath = argv[i];
+                break;
+            case 'k': // fichier de reprise
+                if ( ++i == argc ) error ( "Error in -k option", -1 );
+                checkpointPath = argv[i];
+                break;
+            case 'j': // flux parallèles
+                if ( ++i == argc ) error ( "Error in -j option", -1 );
+                streams = atoi ( argv[i] );
+                if ( streams < 1 || streams > MAX_STREAMS ) error ( "Streams number (-j) have to be between 1 and 64", -1 );
+                break;
+            case 'l': // taille limite
+                if ( ++i == argc ) error ( "Error in -l option", -1 );
+                slabLimit = atol ( argv[i] );
+                break;
+            default:
+                error ( "Unknown option : " + std::string ( argv[i] ), -1 );
+            }
+        } else {
+            error ( "Unknown option : " + std::string ( argv[i] ), -1 );
+        }
+    }
+
+    if ( debugLogger ) {
+        // le niveau debug du logger est activé
+        Logger::setAccumulator ( DEBUG, acc );
+        std::ostream &logd = LOGGER ( DEBUG );
+        logd.precision ( 16 );
+        logd.setf ( std::ios::fixed,std::ios::floatfield );
+    }
+
+    if ( listPath == 0 ) {
+        error ( "Slabs list (-i) is mandatory", -1 );
+    }
+
+    /********************** Dalles déjà traitées */
+
+    std::set<std::string> done;
+    if ( checkpointPath != 0 ) {
+        std::ifstream previous ( checkpointPath );
+        std::string line;
+        while ( std::getline ( previous, line ) ) {
+            if ( ! line.empty() ) done.insert ( line );
+        }
+        if ( ! done.empty() ) {
+            LOGGER_INFO ( done.size() << " slabs already processed according to " << checkpointPath );
+        }
+    }
+
+    /********************** Lecture de la liste */
+
+    std::ifstream list ( listPath );
+    if ( ! list ) {
+        error ( std::string ( "Cannot open slabs list " ) + listPath, -1 );
+    }
+    std::string line;
+    int lineNumber = 0;
+    while ( std::getline ( list, line ) ) {
+        lineNumber++;
+        std::istringstream fields ( line );
+        std::vector<std::string> words;
+        std::string word;
+        while ( fields >> word ) words.push_back ( word );
+        if ( words.empty() || words.at ( 0 ).at ( 0 ) == '#' ) continue;
+
+        SlabOperation op;
+        if ( words.size() == 2 ) {
+            op.link = false;
+            op.source = words.at ( 0 );
+            op.destination = words.at ( 1 );
+        } else if ( words.size() == 3 && words.at ( 0 ) == "LINK" ) {
+            op.link = true;
+            op.source = words.at ( 1 );
+            op.destination = words.at ( 2 );
+        } else {
+            std::ostringstream oss;
+            oss << "Invalid line " << lineNumber << " in the slabs list : " << line;
+            error ( oss.str(), -1 );
+        }
+
+        if ( done.count ( op.destination ) ) continue;
+        operations.push_back ( op );
+    }
+    list.close();
+
+    LOGGER_INFO ( operations.size() << " slabs to process with " << streams << " stream(s)" );
+
+    if ( checkpointPath != 0 ) {
+        checkpoint.open ( checkpointPath, std::ios_base::app );
+        if ( ! checkpoint ) {
+            error ( std::string ( "Cannot open checkpoint file " ) + checkpointPath, -1 );
+        }
+    }
+
+#if BUILD_OBJECT
+    bool curl = ( sourceType == ContextType::S3CONTEXT || sourceType == ContextType::SWIFTCONTEXT ||
+                  destinationType == ContextType::S3CONTEXT || destinationType == ContextType::SWIFTCONTEXT );
+    if ( curl ) {
+        curl_global_init ( CURL_GLOBAL_ALL );
+    }
+#endif
+
+    /********************** Transfert */
+
+    startTime = now();
+    lastReport = startTime;
+
+    std::vector<pthread_t> threads ( streams );
+    for ( int t = 0; t < streams; t++ ) {
+        pthread_create ( &threads[t], NULL, transferSlabs, NULL );
+    }
+    for ( int t = 0; t < streams; t++ ) {
+        pthread_join ( threads[t], NULL );
+    }
+
+    report ( now() );
+
+    if ( checkpoint.is_open() ) {
+        checkpoint.close();
+    }
+
+#if BUILD_OBJECT
+    if ( curl ) {
+        CurlPool::cleanCurlPool();
+        curl_global_cleanup();
+    }
+#endif
+
+    if ( connectionError ) {
+        LOGGER_ERROR ( "At least one stream could not connect to the storages" );
+        return -1;
+    }
+
+    if ( counts[FAILED] > 0 ) {
+        LOGGER_ERROR ( counts[FAILED] << " slab(s) could not be transfered, launch the command again with the same checkpoint file to retry" );
+        return 1;
+    }
+
+    return 0;
+}
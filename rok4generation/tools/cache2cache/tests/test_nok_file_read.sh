@@ -0,0 +1,18 @@
+#!/bin/bash
+echo "test nok file read"
+rm -rf outputs/test_nok_file_read outputs/test_nok_file_read.done
+# Dalle source illisible (un dossier) et dalle absente
+mkdir -p outputs/test_nok_file_read/DATA/00/01/AB.tif
+echo "DATA/00/01/AB.tif 00/01/AB.tif" > outputs/test_nok_file_read/slabs.txt
+echo "DATA/00/01/AD.tif 00/01/AD.tif" >> outputs/test_nok_file_read/slabs.txt
+cache2cache -i outputs/test_nok_file_read/slabs.txt -dir_src outputs/test_nok_file_read -dir outputs/test_nok_file_read/copy -k outputs/test_nok_file_read.done
+if [ $? != 1 ] ; then 
+    exit 1
+fi
+# La dalle illisible n'est ni écrite ni notée comme traitée, la dalle absente l'est
+[ ! -e outputs/test_nok_file_read/copy/00/01/AB.tif ] && ! grep -q "00/01/AB.tif" outputs/test_nok_file_read.done && grep -q "00/01/AD.tif" outputs/test_nok_file_read.done
+if [ $? != 0 ] ; then 
+    exit 1
+else
+    exit 0
+fi
@@ -0,0 +1,9 @@
+#!/bin/bash
+
+echo "test nok param"
+cache2cache -dir_src inputs -dir outputs -j 0 2>/dev/null
+if [ $? != 0 ] ; then 
+    exit 0
+else
+    exit 1
+fi
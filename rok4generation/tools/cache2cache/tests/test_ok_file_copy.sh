@@ -0,0 +1,18 @@
+#!/bin/bash
+echo "test ok file copy"
+rm -rf outputs/test_ok_file_copy outputs/test_ok_file_copy.done
+cache2cache -i inputs/slabs.txt -dir_src inputs -dir outputs/test_ok_file_copy -j 2 -l 4096 -k outputs/test_ok_file_copy.done
+if [ $? != 0 ] ; then 
+    exit 1
+fi
+cmp -s inputs/DATA/00/01/AB.tif outputs/test_ok_file_copy/00/01/AB.tif && cmp -s inputs/DATA/00/01/AB.tif outputs/test_ok_file_copy/00/02/AB.tif && [ ! -e outputs/test_ok_file_copy/00/01/AC.tif ]
+if [ $? != 0 ] ; then 
+    exit 1
+fi
+# Reprise : tout est déjà traité
+cache2cache -i inputs/slabs.txt -dir_src inputs -dir outputs/test_ok_file_copy -k outputs/test_ok_file_copy.done 2>&1 | grep -q " 0/0 slabs"
+if [ $? != 0 ] ; then 
+    exit 1
+else
+    exit 0
+fi
@@ -48,6 +48,7 @@
 #include "Format.h"
 #include "FileImage.h"
 #include "Logger.h"
+#include "Utils.h"
 #include <cstdlib>
 #include <cmath>
 #include <iostream>
@@ -580,6 +581,26 @@ int fillBgLine ( FileImage* BGI, T* image, uint8_t* mask, int line, T* nodata )
     return 0;
 }
 
+/**
+ * \~french
+ * \brief Moyenne deux lignes de pixels source dans une ligne en sortie (entiers sur 8 bits, avec gamma)
+ * \details Voir merge4 (Utils.h)
+ */
+inline void mergeLine ( uint8_t* image, uint8_t* mask, const uint8_t* image1, const uint8_t* mask1,
+                        const uint8_t* image2, const uint8_t* mask2, int pixels, const uint8_t* gamma ) {
+    merge4 ( image, mask, image1, mask1, image2, mask2, pixels, samplesperpixel, gamma );
+}
+
+/**
+ * \~french
+ * \brief Moyenne deux lignes de pixels source dans une ligne en sortie (flottants, gamma ignoré)
+ * \details Voir merge4 (Utils.h)
+ */
+inline void mergeLine ( float* image, uint8_t* mask, const float* image1, const uint8_t* mask1,
+                        const float* image2, const uint8_t* mask2, int pixels, const uint8_t* gamma ) {
+    merge4 ( image, mask, image1, mask1, image2, mask2, pixels, samplesperpixel );
+}
+
 /**
  * \~french
  * \brief Fusionne les 4 images en entrée et le masque de fond dans l'image de sortie
@@ -602,9 +623,6 @@ int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileIma
     T line_bgI[nbsamples];
     uint8_t line_bgM[width];
 
-    int nbData;
-    float pix[samplesperpixel];
-
     T line_1I[2*nbsamples];
     uint8_t line_1M[2*width];
 
@@ -707,42 +725,9 @@ int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileIma
             }
 
             // ----------------- la moyenne ----------------
-            for ( int pixIn = left, sampleIn = left * samplesperpixel; pixIn < right;
-                    pixIn += 2, sampleIn += 2*samplesperpixel ) {
-
-                memset ( pix,0,samplesperpixel*sizeof ( float ) );
-                nbData = 0;
-
-                if ( line_1M[pixIn] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_1I[sampleIn+c];
-                }
-
-                if ( line_1M[pixIn+1] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_1I[sampleIn+samplesperpixel+c];
-                }
-
-                if ( line_2M[pixIn] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_2I[sampleIn+c];
-                }
-
-                if ( line_2M[pixIn+1] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_2I[sampleIn+samplesperpixel+c];
-                }
-
-                if ( nbData > 1 ) {
-                    line_outM[pixIn/2] = 255;
-                    if ( sizeof ( T ) == 1 ) {
-                        // Cas entier : utilisation d'un gamma
-                        for ( int c = 0; c < samplesperpixel; c++ ) line_outI[sampleIn/2+c] = MERGE[ ( int ) pix[c]*4/nbData];
-                    } else if ( sizeof ( T ) == 4 ) {
-                        for ( int c = 0; c < samplesperpixel; c++ ) line_outI[sampleIn/2+c] = pix[c]/ ( float ) nbData;
-                    }
-                }
-            }
+            mergeLine ( line_outI + left/2 * samplesperpixel, line_outM + left/2,
+                        line_1I + left * samplesperpixel, line_1M + left, line_2I + left * samplesperpixel, line_2M + left,
+                        ( right - left ) / 2, MERGE );
 
             if ( OUTPUTI->writeLine( line_outI, line ) == -1 ) {
                 LOGGER_ERROR ( "Unable to write image" );
@@ -113,12 +113,18 @@ Interpolation::KernelType interpolation = Interpolation::CUBIC;
 /** \~french Activation du niveau de log debug. Faux par défaut */
 bool debugLogger=false;
 
+/** \~french Nombre de threads de calcul de l'image de sortie. 1 par défaut (pas de parallélisation) */
+int threadsCount = 1;
+
+/** \~french Hauteur, en lignes, des bandes de l'image de sortie calculées par les threads. Égale à la hauteur usuelle des tuiles et bandes des images sources, pour qu'elles soient décodées par un seul thread. */
+#define STRIPE_HEIGHT 256
+
 /** \~french Message d'usage de la commande mergeNtiff */
 std::string help = std::string("\nmergeNtiff version ") + std::string(ROK4_VERSION) + "\n\n"
 
     "Create one georeferenced TIFF image from several georeferenced TIFF images.\n\n"
 
-    "Usage: mergeNtiff -f <FILE> [-r <DIR>] -c <VAL> -i <VAL> -n <VAL> [-a <VAL> -s <VAL> -b <VAL>]\n"
+    "Usage: mergeNtiff -f <FILE> [-r <DIR>] -c <VAL> -i <VAL> -n <VAL> [-a <VAL> -s <VAL> -b <VAL>] [-j <VAL>]\n"
 
     "Parameters:\n"
     "    -f configuration file : list of output and source images and masks\n"
@@ -141,6 +147,7 @@ std::string help = std::string("\nmergeNtiff version ") + std::string(ROK4_VERSI
     "    -a sample format : (float or uint)\n"
     "    -b bits per sample : (8 or 32)\n"
     "    -s samples per pixel : (1, 2, 3 or 4)\n"
+    "    -j threads number : output image is computed by horizontal stripes, in parallel. Output is the same as with one thread. Default : 1\n"
     "    -d debug logger activation\n\n"
 
     "If bitspersample, sampleformat or samplesperpixel are not provided, those 3 informations are read from the image sources (all have to own the same). If 3 are provided, conversion may be done.\n\n"
@@ -227,6 +234,17 @@ int parseCommandLine ( int argc, char** argv ) {
                 }
                 strcpy ( strnodata,argv[i] );
                 break;
+            case 'j': // nombre de threads
+                if ( i++ >= argc ) {
+                    LOGGER_ERROR ( "Error in option -j" );
+                    return -1;
+                }
+                threadsCount = atoi ( argv[i] );
+                if ( threadsCount < 1 ) {
+                    LOGGER_ERROR ( "Unvalid value for option -j (have to be a positive integer) : " << argv[i] );
+                    return -1;
+                }
+                break;
             case 'c': // compression
                 if ( i++ >= argc ) {
                     LOGGER_ERROR ( "Error in option -c" );
@@ -404,48 +422,72 @@ bool loadConfiguration (
 
 /**
  * \~french
- * \brief Charge les images en entrée et en sortie depuis le fichier de configuration
- * \details On va récupérer toutes les informations de toutes les images et masques présents dans le fichier de configuration et créer les objets FileImage correspondant. Toutes les images ici manipulées sont de vraies images (physiques) dans ce sens où elles sont des fichiers soit lus, soit qui seront écrits.
- *
- * Le chemin vers le fichier de configuration est stocké dans la variables globale imageListFilename et outImagesRoot va être concaténer au chemin vers les fichiers de sortie.
- * \param[out] ppImageOut image résultante de l'outil
- * \param[out] ppMaskOut masque résultat de l'outil, si demandé
- * \param[out] pImageIn ensemble des images en entrée
- * \return code de retour, 0 si réussi, -1 sinon
+ * \brief Restreint la lecture d'une image en entrée à ce qui est utile pour la sortie
+ * \details La zone utile est l'emprise de sortie, reprojetée dans le système de l'image en entrée si besoin et agrandie de la taille du noyau d'interpolation. La résolution voulue est celle de la sortie, exprimée dans le système de l'entrée. Les formats qui le permettent (JPEG2000) ne décodent alors que cette zone, au niveau de résolution le plus grossier restant au moins aussi fin que la sortie.
+ * \param[in] pImage image en entrée, sans masque
+ * \param[in] outCrs système de coordonnées de la sortie
+ * \param[in] outBbox emprise de la sortie
+ * \param[in] outResx résolution en x de la sortie
+ * \param[in] outResy résolution en y de la sortie
+ * \return true en cas de succès, false si échec
  */
-int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<FileImage*>* pImageIn ) {
+bool restrictInputReading ( FileImage* pImage, CRS outCrs, BoundingBox<double> outBbox, double outResx, double outResy ) {
 
+    BoundingBox<double> area = outBbox;
+    double wantedResx = outResx, wantedResy = outResy;
 
-    std::vector<bool> masks;
-    std::vector<char*> paths;
-    std::vector<std::string> srss;
-    std::vector<BoundingBox<double> > bboxes;
-    std::vector<double> resxs;
-    std::vector<double> resys;
+    if ( pImage->getCRS() != outCrs ) {
+        area = outCrs.cropBBox ( outBbox );
+        double outWidth = ( area.xmax - area.xmin ) / outResx;
+        double outHeight = ( area.ymax - area.ymin ) / outResy;
 
-    if (! loadConfiguration(&masks, &paths, &srss, &bboxes, &resxs, &resys) ) {
-        LOGGER_ERROR ( "Cannot load configuration file " << imageListFilename );
-        return -1;
-    }
+        if ( area.reproject ( outCrs.getProj4Code(), pImage->getCRS().getProj4Code() ) ) {
+            // On ne sait pas déterminer la zone utile : l'image sera lue entièrement
+            LOGGER_DEBUG ( "Cannot reproject output bbox in the input image CRS, no reading restriction" );
+            return true;
+        }
 
-    // On doit avoir au moins deux lignes, trois si on a un masque de sortie
-    if (masks.size() < 2 || (masks.size() == 2 && masks.back()) ) {
-        LOGGER_ERROR ( "We have no input images in configuration file " << imageListFilename );
-        return -1;
+        wantedResx = ( area.xmax - area.xmin ) / outWidth;
+        wantedResy = ( area.ymax - area.ymin ) / outHeight;
     }
 
-    // On va charger les images en entrée en premier pour avoir certaines informations
-    int firstInput = 1;
-    if (masks.at(1)) {
-        // La deuxième ligne est le masque de sortie
-        firstInput = 2;
-    }
+    // Marge pour le noyau d'interpolation, exprimée en pixels à la résolution voulue
+    const Kernel& K = Kernel::getInstance ( interpolation );
+    double margin = K.size() + 2.;
+    area = BoundingBox<double> (
+        area.xmin - margin * wantedResx, area.ymin - margin * wantedResy,
+        area.xmax + margin * wantedResx, area.ymax + margin * wantedResy
+    );
+
+    return pImage->restrictReading ( area, wantedResx, wantedResy );
+}
+
+/**
+ * \~french
+ * \brief Crée les images en entrée à partir de la configuration lue
+ * \details Les images associées à un masque sont créées avec celui-ci. Les chemins des images en entrée sont libérés.
+ * \param[in] masks Indicateurs de présence d'un masque
+ * \param[in] paths Chemins des images
+ * \param[in] srss Systèmes de coordonnées des images
+ * \param[in] bboxes Rectangles englobant des images
+ * \param[in] resxs Résolution en x des images
+ * \param[in] resys Résolution en y des images
+ * \param[in] firstInput indice de la première image en entrée dans la configuration
+ * \param[out] pImageIn ensemble des images en entrée
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+int createInputImages (
+    std::vector<bool>& masks, std::vector<char*>& paths, std::vector<std::string>& srss,
+    std::vector<BoundingBox<double> >& bboxes, std::vector<double>& resxs, std::vector<double>& resys,
+    int firstInput, std::vector<FileImage*>* pImageIn ) {
 
     /****************** LES ENTRÉES : CRÉATION ******************/
 
     FileImageFactory factory;
     int nbImgsIn = 0;
 
+    CRS outCrs ( srss.at(0) );
+
     for ( int i = firstInput; i < masks.size(); i++ ) {
 
         nbImgsIn++;
@@ -470,6 +512,14 @@ int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<File
         }
         pImage->setCRS ( crs );
         delete paths.at(i);
+
+        // Une image associée à un masque doit garder la même géométrie que lui : elle est lue entièrement
+        if ( ! ( i+1 < ( int ) masks.size() && masks.at(i+1) ) ) {
+            if ( ! restrictInputReading ( pImage, outCrs, bboxes.at(0), resxs.at(0), resys.at(0) ) ) {
+                LOGGER_ERROR ( "Cannot restrict reading of the input image " << nbImgsIn );
+                return -1;
+            }
+        }
         
         if ( i+1 < masks.size() && masks.at(i+1) ) {
             
@@ -532,8 +582,165 @@ int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<File
         LOGGER_DEBUG( nbImgsIn << " image(s) en entrée" );
     }
 
+    return 0;
+}
+
+/**
+ * \~french
+ * \brief Description d'une image en entrée, telle que lue dans le fichier de configuration
+ * \details Permet aux threads de calcul de n'ouvrir une image que lorsqu'une bande en a besoin.
+ */
+struct InputDescription {
+    std::string path;
+    /** \~french Chemin du masque associé, vide s'il n'y en a pas */
+    std::string maskPath;
+    std::string srs;
+    BoundingBox<double> bbox;
+    double resx;
+    double resy;
+
+    InputDescription() : bbox ( 0., 0., 0., 0. ), resx ( 0. ), resy ( 0. ) {}
+};
+
+/**
+ * \~french
+ * \brief Lit la description des images en entrée dans le fichier de configuration
+ * \details Les images sont dans le même ordre que celles créées par #loadImages.
+ * \param[out] pInputs descriptions des images en entrée
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+int loadInputDescriptions ( std::vector<InputDescription>* pInputs ) {
+
+    std::vector<bool> masks;
+    std::vector<char*> paths;
+    std::vector<std::string> srss;
+    std::vector<BoundingBox<double> > bboxes;
+    std::vector<double> resxs;
+    std::vector<double> resys;
+
+    if (! loadConfiguration(&masks, &paths, &srss, &bboxes, &resxs, &resys) ) {
+        LOGGER_ERROR ( "Cannot load configuration file " << imageListFilename );
+        return -1;
+    }
+
+    // Les images de sortie ne nous intéressent pas ici
+    int firstInput = ( masks.size() > 1 && masks.at(1) ) ? 2 : 1;
+
+    for ( unsigned int i = firstInput; i < masks.size(); i++ ) {
+        InputDescription input;
+        input.path.assign ( paths.at(i) );
+        input.srs = srss.at(i);
+        input.bbox = bboxes.at(i);
+        input.resx = resxs.at(i);
+        input.resy = resys.at(i);
+        if ( i+1 < masks.size() && masks.at(i+1) ) {
+            i++;
+            input.maskPath.assign ( paths.at(i) );
+        }
+        pInputs->push_back ( input );
+    }
+
+    for ( unsigned int i = 0; i < paths.size(); i++ ) {
+        free ( paths.at(i) );
+    }
+
+    return 0;
+}
+
+/**
+ * \~french
+ * \brief Crée une image en entrée à partir de sa description
+ * \details L'image est créée comme par #createInputImages : avec son masque s'il existe, sinon avec une lecture restreinte à l'emprise de sortie. Sa géométrie est donc exactement celle de l'image utilisée par le traitement mono-thread.
+ * \param[in] input description de l'image
+ * \param[in] pImageOut image de sortie
+ * \return l'image créée, NULL en cas d'erreur
+ */
+FileImage* createInputImage ( const InputDescription& input, FileImage* pImageOut ) {
+
+    FileImageFactory factory;
+
+    CRS crs;
+    crs.setRequestCode ( input.srs );
+
+    FileImage* pImage = factory.createImageToRead ( ( char* ) input.path.c_str(), input.bbox, input.resx, input.resy );
+    if ( pImage == NULL ) {
+        LOGGER_ERROR ( "Impossible de creer une image a partir de " << input.path );
+        return NULL;
+    }
+    pImage->setCRS ( crs );
+
+    if ( input.maskPath.empty() ) {
+        if ( ! restrictInputReading ( pImage, pImageOut->getCRS(), pImageOut->getBbox(), pImageOut->getResX(), pImageOut->getResY() ) ) {
+            LOGGER_ERROR ( "Cannot restrict reading of the input image " << input.path );
+            delete pImage;
+            return NULL;
+        }
+    } else {
+        FileImage* pMask = factory.createImageToRead ( ( char* ) input.maskPath.c_str(), input.bbox, input.resx, input.resy );
+        if ( pMask == NULL ) {
+            LOGGER_ERROR ( "Impossible de creer un masque a partir de " << input.maskPath );
+            delete pImage;
+            return NULL;
+        }
+        pMask->setCRS ( crs );
+        if ( ! pImage->setMask ( pMask ) ) {
+            LOGGER_ERROR ( "Cannot add mask to the input FileImage" );
+            delete pImage;
+            return NULL;
+        }
+    }
+
+    return pImage;
+}
+
+/**
+ * \~french
+ * \brief Charge les images en entrée et en sortie depuis le fichier de configuration
+ * \details On va récupérer toutes les informations de toutes les images et masques présents dans le fichier de configuration et créer les objets FileImage correspondant. Toutes les images ici manipulées sont de vraies images (physiques) dans ce sens où elles sont des fichiers soit lus, soit qui seront écrits.
+ *
+ * Le chemin vers le fichier de configuration est stocké dans la variables globale imageListFilename et outImagesRoot va être concaténer au chemin vers les fichiers de sortie.
+ * \param[out] ppImageOut image résultante de l'outil
+ * \param[out] ppMaskOut masque résultat de l'outil, si demandé
+ * \param[out] pImageIn ensemble des images en entrée
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<FileImage*>* pImageIn ) {
+
+
+    std::vector<bool> masks;
+    std::vector<char*> paths;
+    std::vector<std::string> srss;
+    std::vector<BoundingBox<double> > bboxes;
+    std::vector<double> resxs;
+    std::vector<double> resys;
+
+    if (! loadConfiguration(&masks, &paths, &srss, &bboxes, &resxs, &resys) ) {
+        LOGGER_ERROR ( "Cannot load configuration file " << imageListFilename );
+        return -1;
+    }
+
+    // On doit avoir au moins deux lignes, trois si on a un masque de sortie
+    if (masks.size() < 2 || (masks.size() == 2 && masks.back()) ) {
+        LOGGER_ERROR ( "We have no input images in configuration file " << imageListFilename );
+        return -1;
+    }
+
+    // On va charger les images en entrée en premier pour avoir certaines informations
+    int firstInput = 1;
+    if (masks.at(1)) {
+        // La deuxième ligne est le masque de sortie
+        firstInput = 2;
+    }
+
+    if ( createInputImages ( masks, paths, srss, bboxes, resxs, resys, firstInput, pImageIn ) < 0 ) {
+        return -1;
+    }
+
     /********************** LA SORTIE : CRÉATION *************************/
 
+    FileImageFactory factory;
+    CRS outCrs ( srss.at(0) );
+
     if (samplesperpixel == 1) {
         photometric = Photometric::GRAY;
     } else if (samplesperpixel == 2) {
@@ -542,8 +749,6 @@ int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<File
         photometric = Photometric::RGB;
     }
 
-    CRS outCrs ( srss.at(0) );
-
     // Arrondi a la valeur entiere la plus proche
     int width = lround ( ( bboxes.at(0).xmax - bboxes.at(0).xmin ) / ( resxs.at(0) ) );
     int height = lround ( ( bboxes.at(0).ymax - bboxes.at(0).ymin ) / ( resys.at(0) ) );
@@ -1071,6 +1276,429 @@ int mergeTabImages ( FileImage* pImageOut, // Sortie
     return 0;
 }
 
+/**
+ * \~french
+ * \brief Calcule l'emprise, dans le système de la sortie, des pixels de sortie auxquels contribue chaque paquet d'images
+ * \details L'emprise d'une image est agrandie de la taille du noyau d'interpolation, à la résolution de l'image et à celle de la sortie. Pour une image à reprojeter, l'emprise reprojetée est de plus agrandie de 5 % ; si elle ne peut être reprojetée, le paquet est considéré comme contribuant à toute la sortie.
+ * \param[in] pImageOut image de sortie
+ * \param[in] ImageIn images en entrée
+ * \param[in] TabImageIn images en entrée, triées en paquets compatibles
+ * \param[out] pPacks indices dans ImageIn des images de chaque paquet
+ * \param[out] pFootprints emprise de chaque paquet
+ */
+void computePacksFootprints ( FileImage* pImageOut, std::vector<FileImage*>& ImageIn, std::vector<std::vector<Image*> >& TabImageIn,
+                              std::vector<std::vector<int> >* pPacks, std::vector<BoundingBox<double> >* pFootprints ) {
+
+    const Kernel& K = Kernel::getInstance ( interpolation );
+    double margin = K.size() + 2.;
+    CRS outCrs = pImageOut->getCRS();
+    BoundingBox<double> outBbox = pImageOut->getBbox();
+
+    int index = 0;
+    for ( unsigned int p = 0; p < TabImageIn.size(); p++ ) {
+        std::vector<int> pack;
+        BoundingBox<double> footprint ( 0., 0., 0., 0. );
+
+        for ( unsigned int i = 0; i < TabImageIn.at ( p ).size(); i++, index++ ) {
+            FileImage* pImage = ImageIn.at ( index );
+            pack.push_back ( index );
+
+            BoundingBox<double> bbox = pImage->getBbox();
+            bbox = BoundingBox<double> (
+                bbox.xmin - margin * pImage->getResX(), bbox.ymin - margin * pImage->getResY(),
+                bbox.xmax + margin * pImage->getResX(), bbox.ymax + margin * pImage->getResY()
+            );
+
+            if ( pImage->getCRS() != outCrs ) {
+                if ( bbox.reproject ( pImage->getCRS().getProj4Code(), outCrs.getProj4Code() ) ) {
+                    LOGGER_DEBUG ( "Cannot reproject input bbox in the output CRS, the image is used for every stripe" );
+                    bbox = outBbox;
+                } else {
+                    double dx = ( bbox.xmax - bbox.xmin ) * 0.05;
+                    double dy = ( bbox.ymax - bbox.ymin ) * 0.05;
+                    bbox = BoundingBox<double> ( bbox.xmin - dx, bbox.ymin - dy, bbox.xmax + dx, bbox.ymax + dy );
+                }
+            }
+
+            bbox = BoundingBox<double> (
+                bbox.xmin - margin * pImageOut->getResX(), bbox.ymin - margin * pImageOut->getResY(),
+                bbox.xmax + margin * pImageOut->getResX(), bbox.ymax + margin * pImageOut->getResY()
+            );
+
+            if ( i == 0 ) {
+                footprint = bbox;
+            } else {
+                footprint = BoundingBox<double> (
+                    __min ( footprint.xmin, bbox.xmin ), __min ( footprint.ymin, bbox.ymin ),
+                    __max ( footprint.xmax, bbox.xmax ), __max ( footprint.ymax, bbox.ymax )
+                );
+            }
+        }
+
+        pPacks->push_back ( pack );
+        pFootprints->push_back ( footprint );
+    }
+}
+
+/**
+ * \~french
+ * \brief File de travail partagée entre les threads de calcul et le thread d'écriture
+ * \details Les bandes sont distribuées dans l'ordre. Au plus #slotsCount bandes sont calculées et non écrites en même temps, chacune dans son emplacement (numéro de bande modulo #slotsCount). Le thread principal écrit les bandes dans l'ordre dès qu'elles sont prêtes.
+ *
+ * Les descriptions des images en entrée, leur répartition en paquets et l'emprise de chaque paquet sont partagées en lecture seule : chaque thread n'ouvre que les images des paquets contribuant à la bande qu'il calcule.
+ */
+struct StripesQueue {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    /** \~french Protège la construction et la destruction des chaînes de traitement */
+    pthread_mutex_t chainMutex;
+
+    FileImage* pImageOut;
+    int* nodata;
+    std::vector<InputDescription>* inputs;
+    /** \~french Indices des images en entrée de chaque paquet */
+    std::vector<std::vector<int> >* packs;
+    /** \~french Emprise, dans le système de la sortie, des pixels auxquels contribue chaque paquet */
+    std::vector<BoundingBox<double> >* footprints;
+
+    int width;
+    int height;
+    int stripesCount;
+    /** \~french Taille d'une ligne de l'image, en octets */
+    int lineSize;
+    /** \~french Format des canaux de l'image de sortie */
+    int bitspersample;
+    SampleFormat::eSampleFormat sampleformat;
+    /** \~french Doit-on calculer le masque en plus de l'image */
+    bool withMask;
+
+    /** \~french Prochaine bande à calculer */
+    int nextStripe;
+    /** \~french Prochaine bande à écrire */
+    int nextWritten;
+    /** \~french Une erreur a eu lieu, tout le monde s'arrête */
+    bool failure;
+
+    int slotsCount;
+    std::vector<uint8_t*> images;
+    std::vector<uint8_t*> masks;
+    std::vector<bool> ready;
+};
+
+/**
+ * \~french
+ * \brief Paramètres d'un thread de calcul
+ */
+struct StripesWorker {
+    pthread_t thread;
+    StripesQueue* queue;
+    /** \~french Chaîne de traitement propre au thread, NULL si aucun paquet ne contribue à la bande en cours */
+    ExtendedCompoundImage* pECI;
+    /** \~french Paquets présents dans #pECI */
+    std::vector<bool> chainPacks;
+};
+
+/**
+ * \~french
+ * \brief Prépare la chaîne de traitement d'un thread pour une bande
+ * \details Seuls les paquets dont l'emprise intersecte la bande sont chargés. Chaque paquet garde exactement les images et la géométrie du traitement mono-thread, et les paquets écartés n'ont aucun pixel dans la bande : le résultat est identique quel que soit le nombre de threads. La chaîne est conservée tant que la bande suivante a besoin des mêmes paquets, pour que les images soient lues séquentiellement.
+ * \param[in] worker thread de calcul
+ * \param[in] firstLine première ligne de la bande
+ * \param[in] lastLine ligne suivant la dernière ligne de la bande
+ * \return 0 en cas de succès, -1 en cas d'erreur
+ */
+int prepareStripeChain ( StripesWorker* worker, int firstLine, int lastLine ) {
+
+    StripesQueue* q = worker->queue;
+    BoundingBox<double> outBbox = q->pImageOut->getBbox();
+    double resy = q->pImageOut->getResY();
+    BoundingBox<double> stripeBbox ( outBbox.xmin, outBbox.ymax - lastLine * resy, outBbox.xmax, outBbox.ymax - firstLine * resy );
+
+    std::vector<bool> needed ( q->packs->size(), false );
+    for ( unsigned int p = 0; p < q->packs->size(); p++ ) {
+        needed.at ( p ) = q->footprints->at ( p ).intersects ( stripeBbox );
+    }
+
+    if ( needed == worker->chainPacks ) {
+        return 0;
+    }
+
+    pthread_mutex_lock ( &q->chainMutex );
+
+    delete worker->pECI;
+    worker->pECI = NULL;
+    worker->chainPacks = needed;
+
+    std::vector<std::vector<Image*> > TabImageIn;
+    int ret = 0;
+
+    for ( unsigned int p = 0; p < q->packs->size() && ret == 0; p++ ) {
+        if ( ! needed.at ( p ) ) continue;
+
+        std::vector<FileImage*> packImages;
+        for ( unsigned int i = 0; i < q->packs->at ( p ).size(); i++ ) {
+            FileImage* pImage = createInputImage ( q->inputs->at ( q->packs->at ( p ).at ( i ) ), q->pImageOut );
+            if ( pImage == NULL ) {
+                ret = -1;
+                break;
+            }
+            packImages.push_back ( pImage );
+        }
+
+        if ( ret == 0 && addConverters ( packImages ) < 0 ) {
+            ret = -1;
+        }
+
+        TabImageIn.push_back ( std::vector<Image*> ( packImages.begin(), packImages.end() ) );
+    }
+
+    if ( ret < 0 ) {
+        // Aucune chaîne n'a encore pris possession des images ouvertes : on les libère
+        for ( unsigned int p = 0; p < TabImageIn.size(); p++ ) {
+            for ( unsigned int i = 0; i < TabImageIn.at ( p ).size(); i++ ) {
+                delete TabImageIn.at ( p ).at ( i );
+            }
+        }
+        pthread_mutex_unlock ( &q->chainMutex );
+        return ret;
+    }
+
+    // Les paquets sont donnés tels quels, sans nouveau tri : deux paquets séparés par un paquet écarté ne doivent pas être réunis
+    if ( ret == 0 && ! TabImageIn.empty() && mergeTabImages ( q->pImageOut, TabImageIn, &worker->pECI, q->nodata ) < 0 ) {
+        LOGGER_ERROR ( "Cannot merge images' packs for the stripe " << firstLine / STRIPE_HEIGHT );
+        ret = -1;
+    }
+
+    pthread_mutex_unlock ( &q->chainMutex );
+
+    return ret;
+}
+
+/**
+ * \~french
+ * \brief Remplit les lignes d'une bande avec la valeur de non-donnée, dans le type des canaux de sortie
+ */
+template <typename T>
+void fillNodataStripe ( uint8_t* buffer, int width, int channels, int lines, int* nodata ) {
+    T* pixels = ( T* ) buffer;
+    for ( int i = 0; i < width * lines; i++ ) {
+        for ( int c = 0; c < channels; c++ ) {
+            pixels[i * channels + c] = ( T ) nodata[c];
+        }
+    }
+}
+
+/**
+ * \~french
+ * \brief Lit les lignes d'une bande de l'image, dans le type des canaux de sortie
+ */
+template <typename T>
+int readStripe ( Image* pImage, uint8_t* buffer, int firstLine, int lastLine, int lineSize ) {
+    for ( int l = firstLine; l < lastLine; l++ ) {
+        if ( pImage->getline ( ( T* ) ( buffer + ( l - firstLine ) * lineSize ), l ) == 0 ) {
+            LOGGER_ERROR ( "Cannot read input image line " << l );
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \~french
+ * \brief Fonction d'un thread de calcul
+ * \details Tant qu'il reste des bandes, le thread en réserve une (en attendant qu'un emplacement se libère), prépare sa chaîne pour cette bande, calcule les lignes de l'image et du masque, puis signale au thread d'écriture que la bande est prête.
+ */
+void* computeStripes ( void* arg ) {
+
+    StripesWorker* worker = ( StripesWorker* ) arg;
+    StripesQueue* q = worker->queue;
+
+    while ( true ) {
+
+        pthread_mutex_lock ( &q->mutex );
+        while ( ! q->failure && q->nextStripe < q->stripesCount && q->nextStripe - q->nextWritten >= q->slotsCount ) {
+            pthread_cond_wait ( &q->cond, &q->mutex );
+        }
+        if ( q->failure || q->nextStripe >= q->stripesCount ) {
+            pthread_mutex_unlock ( &q->mutex );
+            break;
+        }
+        int stripe = q->nextStripe++;
+        pthread_mutex_unlock ( &q->mutex );
+
+        int slot = stripe % q->slotsCount;
+        int firstLine = stripe * STRIPE_HEIGHT;
+        int lastLine = __min ( firstLine + STRIPE_HEIGHT, q->height );
+
+        int ret = prepareStripeChain ( worker, firstLine, lastLine );
+        int channels = q->pImageOut->getChannels();
+
+        if ( ret < 0 ) {
+            LOGGER_ERROR ( "Cannot build the processing chain for the stripe " << stripe );
+        } else if ( worker->pECI == NULL ) {
+            // Aucune image ne contribue à la bande
+            if ( q->bitspersample == 32 && q->sampleformat == SampleFormat::FLOAT ) {
+                fillNodataStripe<float> ( q->images.at ( slot ), q->width, channels, lastLine - firstLine, q->nodata );
+            } else if ( q->bitspersample == 16 && q->sampleformat == SampleFormat::UINT ) {
+                fillNodataStripe<uint16_t> ( q->images.at ( slot ), q->width, channels, lastLine - firstLine, q->nodata );
+            } else {
+                fillNodataStripe<uint8_t> ( q->images.at ( slot ), q->width, channels, lastLine - firstLine, q->nodata );
+            }
+            if ( q->withMask ) memset ( q->masks.at ( slot ), 0, ( lastLine - firstLine ) * q->width );
+        } else {
+            if ( q->bitspersample == 32 && q->sampleformat == SampleFormat::FLOAT ) {
+                ret = readStripe<float> ( worker->pECI, q->images.at ( slot ), firstLine, lastLine, q->lineSize );
+            } else if ( q->bitspersample == 16 && q->sampleformat == SampleFormat::UINT ) {
+                ret = readStripe<uint16_t> ( worker->pECI, q->images.at ( slot ), firstLine, lastLine, q->lineSize );
+            } else {
+                ret = readStripe<uint8_t> ( worker->pECI, q->images.at ( slot ), firstLine, lastLine, q->lineSize );
+            }
+
+            if ( ret == 0 && q->withMask ) {
+                ret = readStripe<uint8_t> ( worker->pECI->Image::getMask(), q->masks.at ( slot ), firstLine, lastLine, q->width );
+            }
+        }
+
+        pthread_mutex_lock ( &q->mutex );
+        if ( ret < 0 ) {
+            q->failure = true;
+        } else {
+            q->ready.at ( slot ) = true;
+        }
+        pthread_cond_broadcast ( &q->cond );
+        pthread_mutex_unlock ( &q->mutex );
+
+        if ( ret < 0 ) break;
+    }
+
+    return NULL;
+}
+
+/**
+ * \~french
+ * \brief Écrit une ligne de la sortie, dans le type de ses canaux
+ */
+int writeStripeLine ( FileImage* pImage, StripesQueue* q, uint8_t* buffer, int line ) {
+    if ( q->bitspersample == 32 && q->sampleformat == SampleFormat::FLOAT ) {
+        return pImage->writeLine ( ( float* ) buffer, line );
+    } else if ( q->bitspersample == 16 && q->sampleformat == SampleFormat::UINT ) {
+        return pImage->writeLine ( ( uint16_t* ) buffer, line );
+    } else {
+        return pImage->writeLine ( buffer, line );
+    }
+}
+
+/**
+ * \~french
+ * \brief Calcule et écrit l'image (et le masque) de sortie par bandes, en parallèle
+ * \details Chaque thread de calcul utilise sa propre chaîne de traitement, limitée aux paquets d'images contribuant à la bande qu'il calcule (voir #prepareStripeChain) : un thread n'ouvre et ne lit que les images utiles à ses bandes. Les lignes d'une bande ne dépendent ni de l'ordre dans lequel elles sont demandées, ni des paquets écartés : l'image obtenue est identique à celle calculée par un seul thread. Les marges nécessaires aux noyaux d'interpolation sont comprises dans les emprises des paquets.
+ *
+ * Le thread principal écrit les bandes dans l'ordre, ligne à ligne, au fur et à mesure qu'elles sont prêtes.
+ * \param[in] pImageOut image de sortie
+ * \param[in] pMaskOut masque de sortie, NULL si non voulu
+ * \param[in] inputs descriptions des images en entrée
+ * \param[in] packs indices des images en entrée de chaque paquet
+ * \param[in] footprints emprise de chaque paquet dans le système de la sortie
+ * \param[in] nodata valeur de non-donnée
+ * \return 0 en cas de succès, -1 en cas d'erreur
+ */
+int writeByStripes ( FileImage* pImageOut, FileImage* pMaskOut, std::vector<InputDescription>& inputs,
+                     std::vector<std::vector<int> >& packs, std::vector<BoundingBox<double> >& footprints, int* nodata ) {
+
+    StripesQueue q;
+    pthread_mutex_init ( &q.mutex, NULL );
+    pthread_cond_init ( &q.cond, NULL );
+    pthread_mutex_init ( &q.chainMutex, NULL );
+
+    q.pImageOut = pImageOut;
+    q.nodata = nodata;
+    q.inputs = &inputs;
+    q.packs = &packs;
+    q.footprints = &footprints;
+
+    q.width = pImageOut->getWidth();
+    q.height = pImageOut->getHeight();
+    q.stripesCount = ( q.height + STRIPE_HEIGHT - 1 ) / STRIPE_HEIGHT;
+    q.lineSize = q.width * pImageOut->getPixelSize();
+    q.bitspersample = pImageOut->getBitsPerSample();
+    q.sampleformat = pImageOut->getSampleFormat();
+    q.withMask = ( pMaskOut != NULL );
+    q.nextStripe = 0;
+    q.nextWritten = 0;
+    q.failure = false;
+
+    // Deux bandes par thread : pendant qu'une bande attend d'être écrite, le thread peut calculer la suivante
+    q.slotsCount = 2 * threadsCount;
+    for ( int s = 0; s < q.slotsCount; s++ ) {
+        q.images.push_back ( new uint8_t[STRIPE_HEIGHT * q.lineSize] );
+        q.masks.push_back ( q.withMask ? new uint8_t[STRIPE_HEIGHT * q.width] : NULL );
+        q.ready.push_back ( false );
+    }
+
+    std::vector<StripesWorker> workers ( threadsCount );
+    for ( unsigned int i = 0; i < workers.size(); i++ ) {
+        workers.at ( i ).queue = &q;
+        workers.at ( i ).pECI = NULL;
+        pthread_create ( &( workers.at ( i ).thread ), NULL, computeStripes, ( void* ) &( workers.at ( i ) ) );
+    }
+
+    bool failure = false;
+
+    for ( int stripe = 0; stripe < q.stripesCount; stripe++ ) {
+        int slot = stripe % q.slotsCount;
+
+        pthread_mutex_lock ( &q.mutex );
+        while ( ! q.failure && ! q.ready.at ( slot ) ) {
+            pthread_cond_wait ( &q.cond, &q.mutex );
+        }
+        failure = q.failure;
+        pthread_mutex_unlock ( &q.mutex );
+
+        if ( failure ) break;
+
+        int firstLine = stripe * STRIPE_HEIGHT;
+        int lastLine = __min ( firstLine + STRIPE_HEIGHT, q.height );
+
+        for ( int l = firstLine; l < lastLine && ! failure; l++ ) {
+            if ( writeStripeLine ( pImageOut, &q, q.images.at ( slot ) + ( l - firstLine ) * q.lineSize, l ) < 0 ) {
+                LOGGER_ERROR ( "Cannot write output image line " << l );
+                failure = true;
+            }
+            if ( q.withMask && pMaskOut->writeLine ( q.masks.at ( slot ) + ( l - firstLine ) * q.width, l ) < 0 ) {
+                LOGGER_ERROR ( "Cannot write output mask line " << l );
+                failure = true;
+            }
+        }
+
+        pthread_mutex_lock ( &q.mutex );
+        if ( failure ) {
+            q.failure = true;
+        }
+        q.ready.at ( slot ) = false;
+        q.nextWritten++;
+        pthread_cond_broadcast ( &q.cond );
+        pthread_mutex_unlock ( &q.mutex );
+
+        if ( failure ) break;
+    }
+
+    for ( unsigned int i = 0; i < workers.size(); i++ ) {
+        pthread_join ( workers.at ( i ).thread, NULL );
+        delete workers.at ( i ).pECI;
+    }
+
+    for ( int s = 0; s < q.slotsCount; s++ ) {
+        delete[] q.images.at ( s );
+        delete[] q.masks.at ( s );
+    }
+
+    pthread_cond_destroy ( &q.cond );
+    pthread_mutex_destroy ( &q.mutex );
+    pthread_mutex_destroy ( &q.chainMutex );
+
+    return failure ? -1 : 0;
+}
+
 /**
  ** \~french
  * \brief Fonction principale de l'outil mergeNtiff
@@ -1089,7 +1717,7 @@ int main ( int argc, char **argv ) {
     FileImage* pMaskOut = NULL;
     std::vector<FileImage*> ImageIn;
     std::vector<std::vector<Image*> > TabImageIn;
-    ExtendedCompoundImage* pECI;
+    ExtendedCompoundImage* pECI = NULL;
 
     /* Initialisation des Loggers */
     Logger::setOutput ( STANDARD_OUTPUT_STREAM_FOR_ERRORS );
@@ -1159,23 +1787,47 @@ int main ( int argc, char **argv ) {
         error ( "Echec tri des images",-1 );
     }
 
-    LOGGER_DEBUG ( "Merge" );
-    // Fusion des paquets d images
-    if ( mergeTabImages ( pImageOut, TabImageIn, &pECI, nodata ) < 0 ) {
-        error ( "Echec fusion des paquets d images",-1 );
-    }
+    if ( threadsCount > 1 ) {
 
-    LOGGER_DEBUG ( "Save image" );
-    // Enregistrement de l'image fusionnée
-    if ( pImageOut->writeImage ( pECI ) < 0 ) {
-        error ( "Echec enregistrement de l image finale",-1 );
-    }
+        /* Chaque thread construit sa propre chaîne, bande par bande, avec les seuls paquets utiles : les images chargées ici ne servent
+         * qu'à connaître la répartition en paquets et leurs emprises */
+        std::vector<InputDescription> inputs;
+        std::vector<std::vector<int> > packs;
+        std::vector<BoundingBox<double> > footprints;
+
+        if ( loadInputDescriptions ( &inputs ) < 0 || inputs.size() != ImageIn.size() ) {
+            error ( "Echec lecture de la description des images en entrée",-1 );
+        }
+        computePacksFootprints ( pImageOut, ImageIn, TabImageIn, &packs, &footprints );
+        for ( unsigned int i = 0; i < ImageIn.size(); i++ ) {
+            delete ImageIn.at ( i );
+        }
 
-    if ( pMaskOut != NULL ) {
-        LOGGER_DEBUG ( "Save mask" );
-        // Enregistrement du masque fusionné, si demandé
-        if ( pMaskOut->writeImage ( pECI->Image::getMask() ) < 0 ) {
-            error ( "Echec enregistrement du masque final",-1 );
+        LOGGER_DEBUG ( "Save image and mask by stripes, with " << threadsCount << " threads" );
+        if ( writeByStripes ( pImageOut, pMaskOut, inputs, packs, footprints, nodata ) < 0 ) {
+            error ( "Echec enregistrement de l image finale",-1 );
+        }
+
+    } else {
+
+        LOGGER_DEBUG ( "Merge" );
+        // Fusion des paquets d images
+        if ( mergeTabImages ( pImageOut, TabImageIn, &pECI, nodata ) < 0 ) {
+            error ( "Echec fusion des paquets d images",-1 );
+        }
+
+        LOGGER_DEBUG ( "Save image" );
+        // Enregistrement de l'image fusionnée
+        if ( pImageOut->writeImage ( pECI ) < 0 ) {
+            error ( "Echec enregistrement de l image finale",-1 );
+        }
+
+        if ( pMaskOut != NULL ) {
+            LOGGER_DEBUG ( "Save mask" );
+            // Enregistrement du masque fusionné, si demandé
+            if ( pMaskOut->writeImage ( pECI->Image::getMask() ) < 0 ) {
+                error ( "Echec enregistrement du masque final",-1 );
+            }
         }
     }
 
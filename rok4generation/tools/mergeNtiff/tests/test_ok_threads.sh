@@ -0,0 +1,20 @@
+#!/bin/bash
+echo "test ok threads"
+mergeNtiff -f inputs/conf_threads_1.txt -r ./inputs/ -c zip -i bicubic -n 0,0,255 -j 1
+if [ $? != 0 ] ; then 
+    exit 1
+fi
+mergeNtiff -f inputs/conf_threads_4.txt -r ./inputs/ -c zip -i bicubic -n 0,0,255 -j 4
+if [ $? != 0 ] ; then 
+    exit 1
+fi
+
+# Les images et masques calculés en parallèle doivent être identiques à ceux calculés par un seul thread
+cmp outputs/test_ok_threads_1_i.tif outputs/test_ok_threads_4_i.tif && cmp outputs/test_ok_threads_1_m.tif outputs/test_ok_threads_4_m.tif
+status=$?
+rm -f outputs/test_ok_threads_*.tif
+if [ $status != 0 ] ; then 
+    exit 1
+else
+    exit 0
+fi
@@ -38,13 +38,22 @@
 /**
  * \file pbf2cache.cpp
  * \author Institut national de l'information géographique et forestière
- * \~french \brief Consitution d'une dalle vecteur ROK4 à partir des tuiles PBF
- * \~english \brief Build a vector ROK4 slab from PBD tiles
+ * \~french \brief Consitution de dalles vecteur ROK4 à partir des tuiles PBF
+ * \~english \brief Build vector ROK4 slabs from PBF tiles
  */
 
 #include <cstdlib>
 #include <iostream>
+#include <fstream>
 #include <string.h>
+#include <map>
+#include <set>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "tiffio.h"
 #include "Format.h"
 #include "Logger.h"
@@ -60,22 +69,74 @@
     #include "CephPoolContext.h"
 #endif
 
+/** \~french Nombre maximal de dalles écrites en parallèle */
+#define MAX_THREADS 64
+
 /** \~french Message d'usage de la commande pbf2cache */
 std::string help = std::string("\npbf2cache version ") + std::string(ROK4_VERSION) + "\n\n"
 
     "Make image tiled and compressed, in TIFF format, respecting ROK4 specifications.\n\n"
 
-    "Usage: pbf2cache -r <DIRECTORY> -t <VAL> <VAL> -ultile <VAL> <VAL> <OUTPUT FILE/OBJECT> [-d]\n\n"
+    "Usage: pbf2cache [-r <DIRECTORY>] [-tar <FILE>] -t <VAL> <VAL> (-ultile <VAL> <VAL> <OUTPUT FILE/OBJECT> | -slabs <FILE>) [-j <VAL>] [-z] [-d]\n\n"
 
     "Parameters:\n"
-    "     -r directory containing the PBF tiles : tile I,J is stored to path <DIRECTORY>/I/J.pbf\n"
+    "     -r directory containing the PBF tiles : tile I,J is stored to path <DIRECTORY>/I/J.pbf. With -tar, directory of the tiles in the archive\n"
+    "     -tar uncompressed tar archive containing the PBF tiles (<I>/<J>.pbf entries, in the -r directory if provided)\n"
     "     -t number of tiles in the slab : widthwise and heightwise.\n"
     "     -ultile upper left tile indices\n"
+    "     -slabs file listing the slabs to write, one per line : <UL COLUMN> <UL ROW> <OUTPUT FILE/OBJECT>\n"
+    "     -j number of slabs written in parallel (between 1 and 64). Default : 1\n"
     "     -pool Ceph pool where data is. INPUT FILE is interpreted as a Ceph object (ONLY IF OBJECT COMPILATION)\n"
     "     -container Swift container where data is. Then OUTPUT FILE is interpreted as a Swift object name (ONLY IF OBJECT COMPILATION)\n"
     "     -bucket S3 bucket where data is. Then OUTPUT FILE is interpreted as a S3 object name (ONLY IF OBJECT COMPILATION)\n"
+    "     -z gzip compression of the PBF tiles (already compressed tiles are kept as is), to let the server send them as is\n"
     "     -d debug logger activation\n\n";
 
+/**
+ * \~french \brief Dalle à écrire
+ * \~english \brief Slab to write
+ */
+struct Slab {
+    /** \~french \brief Indices de la tuile en haut à gauche */
+    int ulCol, ulRow;
+    /** \~french \brief Fichier ou objet en sortie */
+    std::string output;
+};
+
+/**
+ * \~french \brief Tuile PBF source : en mémoire (archive projetée) ou dans un fichier
+ * \~english \brief Source PBF tile : in memory (mapped archive) or in a file
+ */
+struct PbfTile {
+    /** \~french \brief Données de la tuile, nul si elle est à lire dans le fichier #path */
+    const uint8_t* data;
+    size_t size;
+    std::string path;
+};
+
+/** \~french Dalles à écrire */
+std::vector<Slab> slabs;
+/** \~french Nombre de tuiles dans une dalle, en largeur et en hauteur */
+int tilePerWidth = 16, tilePerHeight = 16;
+/** \~french Compression gzip des tuiles */
+bool gzipTiles = false;
+
+/** \~french Tuiles PBF disponibles, par indices (colonne, ligne). Une tuile absente ne figure pas dans l'index */
+std::map<std::pair<int, int>, PbfTile> tiles;
+
+/** \~french Contextes de stockage, un par thread */
+std::vector<Context*> contexts;
+
+/** \~french Protège la prochaine dalle à écrire et l'abandon */
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+size_t nextSlab = 0;
+/** \~french Une dalle n'a pas pu être écrite, les autres threads s'arrêtent */
+bool aborted = false;
+
+#if BUILD_OBJECT
+char *pool = 0, *container = 0, *bucket = 0;
+#endif
+
 /**
  * \~french
  * \brief Affiche l'utilisation et les différentes options de la commande pbf2cache #help
@@ -98,31 +159,374 @@ void error ( std::string message, int errorCode ) {
     exit ( errorCode );
 }
 
+/**
+ * \~french
+ * \brief Crée et connecte un contexte de stockage des dalles
+ * \return le contexte, NULL si la connexion échoue
+ */
+Context* createContext() {
+    Context* context;
+
+#if BUILD_OBJECT
+    if ( pool != 0 ) {
+        context = new CephPoolContext(pool);
+    } else if (bucket != 0) {
+        context = new S3Context(bucket);
+    } else if (container != 0) {
+        context = new SwiftContext(container);
+    } else {
+#endif
+        context = new FileContext("");
+#if BUILD_OBJECT
+    }
+#endif
+
+    if (! context->connection()) {
+        delete context;
+        return NULL;
+    }
+    return context;
+}
+
+/**
+ * \~french
+ * \brief Lit un nom de tuile "<I>/<J>.pbf" à la fin d'un chemin
+ * \param[in] path chemin de la tuile, dont on n'utilise que les deux derniers éléments
+ * \param[out] col indice de colonne de la tuile
+ * \param[out] row indice de ligne de la tuile
+ * \param[out] dir partie du chemin précédant la colonne (vide ou terminée par '/')
+ * \return vrai si le chemin est celui d'une tuile PBF
+ */
+bool parseTilePath ( const std::string& path, int& col, int& row, std::string& dir ) {
+    size_t rowStart = path.rfind ( '/' );
+    if ( rowStart == std::string::npos ) return false;
+    size_t colStart = ( rowStart == 0 ? std::string::npos : path.rfind ( '/', rowStart - 1 ) );
+    colStart = ( colStart == std::string::npos ? 0 : colStart + 1 );
+
+    char end[8];
+    if ( sscanf ( path.c_str() + colStart, "%d/%d%7s", &col, &row, end ) != 3 || strcmp ( end, ".pbf" ) ) return false;
+    dir = path.substr ( 0, colStart );
+    return true;
+}
+
+/**
+ * \~french
+ * \brief Indexe les tuiles de l'arborescence, en ne listant qu'une fois chaque dossier de colonne utile
+ * \details Les tuiles absentes ne sont ainsi jamais recherchées une à une
+ * \param[in] rootDirectory dossier contenant les tuiles
+ * \param[in] columns colonnes des tuiles à écrire
+ */
+void indexDirectory ( std::string rootDirectory, const std::set<int>& columns ) {
+    for ( std::set<int>::const_iterator col = columns.begin(); col != columns.end(); col++ ) {
+        char colpath[512];
+        sprintf ( colpath, "%s/%d", rootDirectory.c_str(), *col );
+        DIR* dir = opendir ( colpath );
+        if ( dir == NULL ) {
+            LOGGER_DEBUG ( "No PBF tile in column directory " << colpath );
+            continue;
+        }
+        struct dirent* entry;
+        while ( ( entry = readdir ( dir ) ) != NULL ) {
+            int c, row;
+            std::string d;
+            if ( ! parseTilePath ( std::string ( "0/" ) + entry->d_name, c, row, d ) ) continue;
+            PbfTile tile = { NULL, 0, std::string ( colpath ) + "/" + entry->d_name };
+            tiles[std::make_pair ( *col, row )] = tile;
+        }
+        closedir ( dir );
+    }
+}
+
+/**
+ * \~french
+ * \brief Lit une valeur octale d'un en-tête tar
+ */
+size_t tarOctal ( const char* field, int length ) {
+    size_t value = 0;
+    for ( int i = 0; i < length && field[i] >= '0' && field[i] <= '7'; i++ ) {
+        value = value * 8 + ( field[i] - '0' );
+    }
+    return value;
+}
+
+/**
+ * \~french
+ * \brief Vérifie la somme de contrôle d'un en-tête tar
+ * \details La somme porte sur les 512 octets de l'en-tête, le champ de la somme (octets 148 à 155) comptant pour des espaces. Les sommes d'octets signés, écrites par d'anciennes versions de tar, sont aussi acceptées.
+ */
+bool tarChecksum ( const char* header ) {
+    size_t expected = tarOctal ( header + 148, 8 );
+    size_t unsignedSum = 0;
+    long signedSum = 0;
+    for ( int i = 0; i < 512; i++ ) {
+        char c = ( i >= 148 && i < 156 ) ? ' ' : header[i];
+        unsignedSum += ( unsigned char ) c;
+        signedSum += ( signed char ) c;
+    }
+    return unsignedSum == expected || signedSum == ( long ) expected;
+}
+
+/**
+ * \~french
+ * \brief Indexe les tuiles d'une archive tar non compressée, projetée en mémoire
+ * \details L'archive est parcourue une fois, en ne lisant que les en-têtes des entrées. Les tuiles pointent directement dans la projection, qui reste valide jusqu'à la fin du programme. Les noms longs (GNU et préfixe ustar) sont gérés. Les entrées vides sont indexées : comme un fichier vide en mode dossier, elles font échouer l'écriture de leur dalle.
+ * \param[in] archive chemin de l'archive
+ * \param[in] directory dossier des tuiles dans l'archive, vide pour accepter tous les chemins "<I>/<J>.pbf"
+ * \return faux si l'archive ne peut pas être lue, est tronquée ou a un en-tête invalide ; aucune tuile n'est alors indexée
+ */
+bool indexArchive ( const char* archive, std::string directory ) {
+    int fd = open ( archive, O_RDONLY );
+    if ( fd < 0 ) {
+        LOGGER_ERROR ( "Cannot open archive " << archive );
+        return false;
+    }
+    struct stat st;
+    if ( fstat ( fd, &st ) < 0 ) {
+        LOGGER_ERROR ( "Cannot get size of archive " << archive );
+        close ( fd );
+        return false;
+    }
+    size_t archiveSize = st.st_size;
+    if ( archiveSize == 0 ) {
+        close ( fd );
+        return true;
+    }
+    const char* map = ( const char* ) mmap ( NULL, archiveSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close ( fd );
+    if ( map == MAP_FAILED ) {
+        LOGGER_ERROR ( "Cannot map archive " << archive );
+        return false;
+    }
+    madvise ( ( void* ) map, archiveSize, MADV_SEQUENTIAL );
+
+    while ( directory.size() > 2 && directory.compare ( 0, 2, "./" ) == 0 ) directory.erase ( 0, 2 );
+    if ( ! directory.empty() && directory[directory.size() - 1] != '/' ) directory += "/";
+
+    std::string longName;
+    size_t pos = 0;
+    while ( pos + 512 <= archiveSize ) {
+        const char* header = map + pos;
+        if ( header[0] == '\0' ) break; // Blocs vides de fin d'archive
+
+        if ( ! tarChecksum ( header ) ) {
+            LOGGER_ERROR ( "Invalid archive " << archive );
+            tiles.clear();
+            munmap ( ( void* ) map, archiveSize );
+            return false;
+        }
+
+        size_t size = tarOctal ( header + 124, 12 );
+        char type = header[156];
+        size_t data = pos + 512;
+        pos = data + ( ( size + 511 ) & ~( size_t ) 511 );
+        if ( data + size > archiveSize ) {
+            LOGGER_ERROR ( "Truncated archive " << archive );
+            tiles.clear();
+            munmap ( ( void* ) map, archiveSize );
+            return false;
+        }
+
+        if ( type == 'L' ) {
+            // Nom long GNU de l'entrée suivante
+            longName.assign ( map + data, strnlen ( map + data, size ) );
+            continue;
+        }
+
+        std::string name;
+        if ( ! longName.empty() ) {
+            name.swap ( longName );
+        } else {
+            name.assign ( header, strnlen ( header, 100 ) );
+            if ( ! memcmp ( header + 257, "ustar", 5 ) && header[345] ) {
+                name = std::string ( header + 345, strnlen ( header + 345, 155 ) ) + "/" + name;
+            }
+        }
+
+        if ( type != '0' && type != '\0' ) continue; // Seuls les fichiers réguliers sont des tuiles
+
+        while ( name.size() > 2 && name.compare ( 0, 2, "./" ) == 0 ) name.erase ( 0, 2 );
+
+        int col, row;
+        std::string dir;
+        if ( ! parseTilePath ( name, col, row, dir ) ) continue;
+        if ( ! directory.empty() && dir != directory ) continue;
+
+        PbfTile tile = { ( const uint8_t* ) map + data, size, name };
+        tiles[std::make_pair ( col, row )] = tile;
+    }
+
+    LOGGER_DEBUG ( tiles.size() << " PBF tile(s) in archive " << archive );
+    return true;
+}
+
+/**
+ * \~french
+ * \brief Lit une tuile PBF indexée dans un fichier
+ * \return faux si la tuile ne peut pas être lue ou est vide
+ */
+bool readTileFile ( const std::string& path, std::vector<char>& data ) {
+    std::ifstream ifs ( path.c_str(), std::ios::binary|std::ios::ate );
+    if ( ! ifs.is_open() ) {
+        LOGGER_ERROR ( "Cannot open PBF tile " << path );
+        return false;
+    }
+    std::ifstream::pos_type size = ifs.tellg();
+    if ( ifs.bad() || size <= 0 ) {
+        LOGGER_ERROR ( "Empty or unreadable PBF tile " << path );
+        return false;
+    }
+    data.resize ( size );
+    ifs.seekg ( 0, std::ios::beg );
+    ifs.read ( data.data(), size );
+    if ( ifs.bad() ) {
+        LOGGER_ERROR ( "Error reading PBF tile " << path );
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \~french
+ * \brief Écrit une dalle à partir des tuiles indexées
+ * \param[in] slab dalle à écrire
+ * \param[in] context contexte de stockage propre au thread
+ * \return vrai en cas de succès
+ */
+bool writeSlab ( const Slab& slab, Context* context ) {
+    Rok4ImageFactory R4IF;
+    Rok4Image* rok4Image = R4IF.createRok4ImageToWrite( slab.output, tilePerWidth, tilePerHeight, context );
+
+    if (rok4Image == NULL) {
+        LOGGER_ERROR ( "Cannot create the ROK4 image to write " << slab.output );
+        return false;
+    }
+
+    int tilesNumber = tilePerWidth * tilePerHeight;
+    std::vector<const uint8_t*> data ( tilesNumber, ( const uint8_t* ) NULL );
+    std::vector<size_t> sizes ( tilesNumber, 0 );
+    std::vector<std::vector<char> > files ( tilesNumber );
+
+    for ( int row = 0; row < tilePerHeight; row++ ) {
+        for ( int col = 0; col < tilePerWidth; col++ ) {
+            std::map<std::pair<int, int>, PbfTile>::const_iterator it = tiles.find ( std::make_pair ( slab.ulCol + col, slab.ulRow + row ) );
+            if ( it == tiles.end() ) continue;
+
+            int i = row * tilePerWidth + col;
+            if ( it->second.data ) {
+                if ( it->second.size == 0 ) {
+                    LOGGER_ERROR ( "Empty PBF tile " << it->second.path << " in archive" );
+                    delete rok4Image;
+                    return false;
+                }
+                data[i] = it->second.data;
+                sizes[i] = it->second.size;
+            } else {
+                if ( ! readTileFile ( it->second.path, files[i] ) ) {
+                    delete rok4Image;
+                    return false;
+                }
+                data[i] = ( uint8_t* ) files[i].data();
+                sizes[i] = files[i].size();
+            }
+            LOGGER_DEBUG ( "Slabization of pbf tile " << it->second.path );
+        }
+    }
+
+    bool ok = ( rok4Image->writePbfTiles ( data, sizes, gzipTiles ) == 0 );
+    if ( ! ok ) {
+        LOGGER_ERROR ( "Cannot write ROK4 image " << slab.output << " from PBF tiles" );
+    }
+    delete rok4Image;
+    return ok;
+}
+
+/**
+ * \~french
+ * \brief Thread d'écriture des dalles
+ * \details Chaque thread écrit les dalles suivantes de la liste, avec son propre contexte de stockage, jusqu'à son épuisement ou l'abandon
+ */
+void* writeSlabs ( void* arg ) {
+    Context* context = ( Context* ) arg;
+
+    while ( true ) {
+        pthread_mutex_lock ( &mutex );
+        if ( aborted || nextSlab >= slabs.size() ) {
+            pthread_mutex_unlock ( &mutex );
+            break;
+        }
+        size_t s = nextSlab++;
+        pthread_mutex_unlock ( &mutex );
+
+        LOGGER_DEBUG ( "Write slab " << s + 1 << "/" << slabs.size() << " : " << slabs.at ( s ).output );
+
+        if ( ! writeSlab ( slabs.at ( s ), context ) ) {
+            pthread_mutex_lock ( &mutex );
+            aborted = true;
+            pthread_mutex_unlock ( &mutex );
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * \~french
+ * \brief Lit la liste des dalles à écrire
+ * \details Une dalle par ligne : indices de colonne et de ligne de la tuile en haut à gauche, puis fichier ou objet en sortie. Les lignes vides ou commençant par '#' sont ignorées.
+ * \return faux si le fichier ne peut pas être lu ou contient une ligne invalide
+ */
+bool readSlabsList ( const char* path ) {
+    std::ifstream ifs ( path );
+    if ( ! ifs.is_open() ) {
+        LOGGER_ERROR ( "Cannot open slabs list " << path );
+        return false;
+    }
+    std::string line;
+    int number = 0;
+    while ( std::getline ( ifs, line ) ) {
+        number++;
+        if ( line.empty() || line[0] == '#' ) continue;
+        Slab slab;
+        char output[1024];
+        char end;
+        int n = sscanf ( line.c_str(), "%d %d %1023s %c", &slab.ulCol, &slab.ulRow, output, &end );
+        if ( n == EOF ) continue;
+        if ( n != 3 ) {
+            LOGGER_ERROR ( "Invalid line " << number << " in slabs list " << path << " : " << line );
+            return false;
+        }
+        slab.output = output;
+        slabs.push_back ( slab );
+    }
+    return true;
+}
+
 /**
  ** \~french
  * \brief Fonction principale de l'outil pbf2cache
+ * \details Les tuiles disponibles sont indexées en une passe (dossiers des colonnes utiles ou archive tar), puis les dalles sont écrites en parallèle.
  * \param[in] argc nombre de paramètres
  * \param[in] argv tableau des paramètres
  * \return code de retour, 0 en cas de succès, -1 sinon
  ** \~english
  * \brief Main function for tool pbf2cache
+ * \details Available tiles are indexed in one pass (useful column directories or tar archive), then slabs are written in parallel.
  * \param[in] argc parameters number
  * \param[in] argv parameters array
  * \return return code, 0 if success, -1 otherwise
  */
 int main ( int argc, char **argv ) {
 
-    char* output = 0, *rootDirectory = 0;
-    int tilePerWidth = 16, tilePerHeight = 16;
+    char* output = 0, *rootDirectory = 0, *archive = 0, *slabsList = 0;
     int ulCol = -1;
     int ulRow = -1;
+    int threads = 1;
 
 
     bool debugLogger=false;
 
 #if BUILD_OBJECT
-    char *pool = 0, *container = 0, *bucket = 0;
-    bool onCeph = false;
     bool onSwift = false;
     bool onS3 = false;
 #endif
@@ -172,6 +576,16 @@ int main ( int argc, char **argv ) {
             ulRow = atoi ( argv[++i] );
             continue;
         }
+        if ( !strcmp ( argv[i],"-slabs" ) ) {
+            if ( ++i == argc ) { error("Error in -slabs option", -1 ); }
+            slabsList = argv[i];
+            continue;
+        }
+        if ( !strcmp ( argv[i],"-tar" ) ) {
+            if ( ++i == argc ) { error("Error in -tar option", -1 ); }
+            archive = argv[i];
+            continue;
+        }
 
         if ( argv[i][0] == '-' ) {
             switch ( argv[i][1] ) {
@@ -181,6 +595,9 @@ int main ( int argc, char **argv ) {
                 case 'd': // debug logs
                     debugLogger = true;
                     break;
+                case 'z': // compression gzip des tuiles
+                    gzipTiles = true;
+                    break;
                 case 'r': // root directory
                     if ( i++ >= argc ) {
                         LOGGER_ERROR ( "Error in option -r" );
@@ -193,6 +610,13 @@ int main ( int argc, char **argv ) {
                     tilePerWidth = atoi ( argv[++i] );
                     tilePerHeight = atoi ( argv[++i] );
                     break;
+                case 'j': // dalles écrites en parallèle
+                    if ( ++i == argc ) { error("Error in -j option", -1 ); }
+                    threads = atoi ( argv[i] );
+                    if ( threads < 1 || threads > MAX_THREADS ) {
+                        error("Threads number (-j) have to be between 1 and 64", -1 );
+                    }
+                    break;
 
                 default:
                     error ( "Unknown option : " + std::string(argv[i]) ,-1 );
@@ -211,72 +635,102 @@ int main ( int argc, char **argv ) {
         logd.setf ( std::ios::fixed,std::ios::floatfield );
     }
 
-    if ( rootDirectory == 0 || output == 0 ) {
-        error ("Argument must specify one output file/object and one root directory", -1);
+    if ( rootDirectory == 0 && archive == 0 ) {
+        error ("Argument must specify one root directory or one tar archive", -1);
     }
 
-    LOGGER_DEBUG("Output : " << output);
-    LOGGER_DEBUG("PBF root directory : " << rootDirectory);
+    if ( tilePerWidth <= 0 || tilePerHeight <= 0 ) {
+        error ("Tiles number in a slab (option -t) have to be positive", -1);
+    }
 
-    if ( ulRow == -1 || ulCol == -1 ) {
-        error ("Upper left tile indices have to be provided (with option -ultile)", -1);
+    if ( slabsList != 0 ) {
+        if ( output != 0 || ulRow != -1 || ulCol != -1 ) {
+            error ("With a slabs list, output and upper left tile indices are read in the list", -1);
+        }
+        if ( ! readSlabsList ( slabsList ) ) {
+            error ("Cannot read the slabs list", -1);
+        }
+    } else {
+        if ( output == 0 ) {
+            error ("Argument must specify one output file/object or a slabs list", -1);
+        }
+        if ( ulRow == -1 || ulCol == -1 ) {
+            error ("Upper left tile indices have to be provided (with option -ultile)", -1);
+        }
+        Slab slab = { ulCol, ulRow, output };
+        slabs.push_back ( slab );
     }
 
-    Context* context;
+    LOGGER_DEBUG ( slabs.size() << " slab(s) to write" );
+    if ( archive ) {
+        LOGGER_DEBUG ( "PBF archive : " << archive );
+    } else {
+        LOGGER_DEBUG ( "PBF root directory : " << rootDirectory );
+    }
+
+    // Index des tuiles disponibles, en une passe
+    if ( archive != 0 ) {
+        if ( ! indexArchive ( archive, rootDirectory ? rootDirectory : "" ) ) {
+            error ("Cannot index PBF tiles in the archive", -1);
+        }
+    } else {
+        std::set<int> columns;
+        for ( size_t s = 0; s < slabs.size(); s++ ) {
+            for ( int col = 0; col < tilePerWidth; col++ ) columns.insert ( slabs.at ( s ).ulCol + col );
+        }
+        indexDirectory ( rootDirectory, columns );
+    }
 
 #if BUILD_OBJECT
 
     if ( pool != 0 ) {
-        onCeph = true;
-
         LOGGER_DEBUG( std::string("Output is an object in the Ceph pool ") + pool);
-        context = new CephPoolContext(pool);
-
     } else if (bucket != 0) {
         onS3 = true;
-
         curl_global_init(CURL_GLOBAL_ALL);
-
         LOGGER_DEBUG( std::string("Output is an object in the S3 bucket ") + bucket);
-        context = new S3Context(bucket);
-
     } else if (container != 0) {
         onSwift = true;
-
         curl_global_init(CURL_GLOBAL_ALL);
-
         LOGGER_DEBUG( std::string("Output is an object in the Swift bucket ") + container);
-        context = new SwiftContext(container);
     } else {
 #endif
 
         LOGGER_DEBUG("Output is a file in a file system");
-        context = new FileContext("");
 
 #if BUILD_OBJECT
     }  
 #endif
 
-    if (! context->connection()) {
-        error("Unable to connect context", -1);
+    // Un contexte par thread : les écritures en cours d'une dalle sont propres au contexte
+    threads = std::min ( threads, ( int ) slabs.size() );
+    for ( int t = 0; t < threads; t++ ) {
+        Context* context = createContext();
+        if ( context == NULL ) {
+            error("Unable to connect context", -1);
+        }
+        contexts.push_back ( context );
     }
 
+    LOGGER_DEBUG ( "Write with " << threads << " thread(s)" );
 
-    Rok4ImageFactory R4IF;
-    Rok4Image* rok4Image = R4IF.createRok4ImageToWrite( output, tilePerWidth, tilePerHeight, context );
-    
-    if (rok4Image == NULL) {
-        error("Cannot create the ROK4 image to write", -1);
+    std::vector<pthread_t> workers ( threads );
+    for ( int t = 0; t < threads; t++ ) {
+        pthread_create ( &workers[t], NULL, writeSlabs, contexts[t] );
     }
-
-    if (debugLogger) {
-        rok4Image->print();
+    for ( int t = 0; t < threads; t++ ) {
+        pthread_join ( workers[t], NULL );
     }
 
-    LOGGER_DEBUG ( "Write" );
-
-    if (rok4Image->writePbfTiles(ulCol, ulRow, rootDirectory) < 0) {
-        error("Cannot write ROK4 image from PBF tiles", -1);
+    LOGGER_DEBUG ( "Clean" );
+    // Nettoyage
+    // Suppression du nettoyage du logger jusqu'à sa refonte
+    // Logger::stopLogger();
+    // if ( acc ) {
+    //     delete acc;
+    // }
+    for ( int t = 0; t < threads; t++ ) {
+        delete contexts[t];
     }
 
 #if BUILD_OBJECT
@@ -287,15 +741,9 @@ int main ( int argc, char **argv ) {
     }
 #endif
 
-    LOGGER_DEBUG ( "Clean" );
-    // Nettoyage
-    // Suppression du nettoyage du logger jusqu'à sa refonte
-    // Logger::stopLogger();
-    // if ( acc ) {
-    //     delete acc;
-    // }
-    delete rok4Image;
-    delete context;
+    if ( aborted ) {
+        error("Cannot write ROK4 images from PBF tiles", -1);
+    }
 
     return 0;
 }
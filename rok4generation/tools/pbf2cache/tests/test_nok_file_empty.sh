@@ -0,0 +1,14 @@
+#!/bin/bash
+echo "test nok file empty"
+# Tuile vide, dans un dossier et dans une archive : l'écriture de la dalle échoue dans les deux cas
+rm -rf outputs/empty && cp -r inputs/pbfs outputs/empty && : > outputs/empty/259/176.pbf
+pbf2cache -r outputs/empty/ -t 3 3 -ultile 258 175 outputs/test_nok_file_empty_dir.tif 2>/dev/null
+if [ $? == 0 ] ; then 
+    exit 1
+fi
+tar cf outputs/empty.tar -C outputs empty && pbf2cache -tar outputs/empty.tar -r empty -t 3 3 -ultile 258 175 outputs/test_nok_file_empty_tar.tif 2>/dev/null
+if [ $? == 0 ] ; then 
+    exit 1
+else
+    exit 0
+fi
\ No newline at end of file
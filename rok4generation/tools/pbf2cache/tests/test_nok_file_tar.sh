@@ -0,0 +1,16 @@
+#!/bin/bash
+echo "test nok file tar"
+# En-tête corrompu : la somme de contrôle ne correspond plus
+tar cf outputs/corrupted.tar -C inputs pbfs && printf 'X' | dd of=outputs/corrupted.tar bs=1 seek=3 conv=notrunc 2>/dev/null
+pbf2cache -tar outputs/corrupted.tar -r pbfs -t 3 3 -ultile 258 175 outputs/test_nok_file_tar_corrupted.tif 2>/dev/null
+if [ $? == 0 ] ; then 
+    exit 1
+fi
+# Archive tronquée au milieu d'une tuile
+tar cf outputs/truncated.tar -C inputs pbfs && head -c 1700 outputs/truncated.tar > outputs/truncated_part.tar
+pbf2cache -tar outputs/truncated_part.tar -r pbfs -t 3 3 -ultile 258 175 outputs/test_nok_file_tar_truncated.tif 2>/dev/null
+if [ $? == 0 ] ; then 
+    exit 1
+else
+    exit 0
+fi
\ No newline at end of file
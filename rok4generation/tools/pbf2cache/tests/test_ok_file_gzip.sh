@@ -0,0 +1,8 @@
+#!/bin/bash
+echo "test ok file gzip"
+pbf2cache -r inputs/pbfs/ -t 3 3 -ultile 258 175 -z outputs/test_ok_file_gzip.tif
+if [ $? != 0 ] ; then 
+    exit 1
+else
+    exit 0
+fi
\ No newline at end of file
@@ -0,0 +1,15 @@
+#!/bin/bash
+echo "test ok file slabs"
+pbf2cache -r inputs/pbfs/ -t 2 2 -slabs inputs/slabs.txt -j 2
+if [ $? != 0 ] ; then 
+    exit 1
+fi
+# Chaque dalle de la liste est identique à la même dalle écrite seule
+grep -v "^#" inputs/slabs.txt | while read col row output ; do
+    pbf2cache -r inputs/pbfs/ -t 2 2 -ultile $col $row outputs/test_ok_file_slabs_single.tif && cmp -s $output outputs/test_ok_file_slabs_single.tif || exit 1
+done
+if [ $? != 0 ] ; then 
+    exit 1
+else
+    exit 0
+fi
\ No newline at end of file
@@ -0,0 +1,13 @@
+#!/bin/bash
+echo "test ok file tar"
+tar cf outputs/pbfs.tar -C inputs pbfs && pbf2cache -tar outputs/pbfs.tar -r pbfs -t 3 3 -ultile 258 175 outputs/test_ok_file_tar.tif
+if [ $? != 0 ] ; then 
+    exit 1
+fi
+# La dalle écrite depuis l'archive est identique à celle écrite depuis le dossier
+pbf2cache -r inputs/pbfs/ -t 3 3 -ultile 258 175 outputs/test_ok_file_tar_dir.tif && cmp -s outputs/test_ok_file_tar.tif outputs/test_ok_file_tar_dir.tif && cmp -s outputs/test_ok_file_tar.tif outputs/test_ok_file_full.tif
+if [ $? != 0 ] ; then 
+    exit 1
+else
+    exit 0
+fi
\ No newline at end of file
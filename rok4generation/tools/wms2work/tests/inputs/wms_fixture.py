@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Serveur WMS minimal et lecture des images de travail pour les tests de wms2work
+#
+#   wms_fixture.py serve <PORT FILE> : sert des GetMap PNG sur un port libre, écrit dans PORT FILE
+#       La couleur de la réponse est donnée par le coin bas gauche de la BBOX : (10 * xmin, 10 * ymin, 100).
+#       RESPONSEWIDTH impose une largeur de réponse différente de WIDTH.
+#   wms_fixture.py pixels <TIFF> : affiche la largeur, la hauteur puis chaque pixel (R,G,B) d'une image non compressée
+
+import http.server, socketserver, struct, sys, zlib
+from urllib.parse import urlparse, parse_qs
+
+
+def png(w, h, color):
+    raw = b''.join(b'\x00' + bytes(color) * w for _ in range(h))
+    def chunk(t, d):
+        return struct.pack('>I', len(d)) + t + d + struct.pack('>I', zlib.crc32(t + d) & 0xffffffff)
+    return b'\x89PNG\r\n\x1a\n' + chunk(b'IHDR', struct.pack('>IIBBBBB', w, h, 8, 2, 0, 0, 0)) + \
+        chunk(b'IDAT', zlib.compress(raw)) + chunk(b'IEND', b'')
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    def log_message(self, *args):
+        pass
+
+    def do_GET(self):
+        q = {k.upper(): v[0] for k, v in parse_qs(urlparse(self.path).query).items()}
+        bbox = [float(v) for v in q['BBOX'].split(',')]
+        w = int(q.get('RESPONSEWIDTH', q['WIDTH']))
+        h = int(q['HEIGHT'])
+        body = png(w, h, [int(10 * bbox[0]), int(10 * bbox[1]), 100])
+        self.send_response(200)
+        self.send_header('Content-Type', 'image/png')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+
+def serve(portFile):
+    server = socketserver.TCPServer(('127.0.0.1', 0), Handler)
+    with open(portFile, 'w') as f:
+        f.write(str(server.server_address[1]))
+    server.serve_forever()
+
+
+def pixels(path):
+    data = open(path, 'rb').read()
+    e = '<' if data[:2] == b'II' else '>'
+    ifd = struct.unpack(e + 'I', data[4:8])[0]
+    tags = {}
+    for n in range(struct.unpack(e + 'H', data[ifd:ifd + 2])[0]):
+        tag, typ, count, value = struct.unpack(e + 'HHI4s', data[ifd + 2 + 12 * n:ifd + 14 + 12 * n])
+        fmt = {3: 'H', 4: 'I'}.get(typ)
+        if fmt is None:
+            continue
+        size = struct.calcsize(fmt) * count
+        raw = value[:size] if size <= 4 else data[struct.unpack(e + 'I', value)[0]:][:size]
+        tags[tag] = struct.unpack(e + fmt * count, raw)
+    if tags[259][0] != 1:
+        sys.exit('compressed image')
+    w, h, spp = tags[256][0], tags[257][0], tags[277][0]
+    pixels = b''.join(data[o:o + c] for o, c in zip(tags[273], tags[279]))
+    print(w, h)
+    for p in range(w * h):
+        print(','.join(str(v) for v in pixels[p * spp:(p + 1) * spp]))
+
+
+if __name__ == '__main__':
+    if sys.argv[1] == 'serve':
+        serve(sys.argv[2])
+    else:
+        pixels(sys.argv[2])
@@ -0,0 +1,9 @@
+#!/bin/bash
+
+echo "test nok param"
+wms2work -u "http://127.0.0.1:1/wms?SERVICE=WMS&REQUEST=GetMap&FORMAT=image/png&WIDTH=256&HEIGHT=256" -g 2 1 outputs/test_nok_param.tif 0,0,1,1 2>/dev/null
+if [ $? != 0 ] ; then 
+    exit 0
+else
+    exit 1
+fi
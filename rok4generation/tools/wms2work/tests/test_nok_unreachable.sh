@@ -0,0 +1,10 @@
+#!/bin/bash
+
+echo "test nok unreachable"
+rm -f outputs/test_nok_unreachable.tif
+wms2work -u "http://127.0.0.1:1/wms?SERVICE=WMS&REQUEST=GetMap&FORMAT=image/png&WIDTH=256&HEIGHT=256" -g 1 1 -r 1 -w 1 -t 2 outputs/test_nok_unreachable.tif 0,0,1,1 2>/dev/null
+if [ $? != 0 ] && [ ! -f outputs/test_nok_unreachable.tif ] ; then 
+    exit 0
+else
+    exit 1
+fi
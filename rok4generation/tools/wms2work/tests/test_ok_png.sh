@@ -0,0 +1,54 @@
+#!/bin/bash
+
+echo "test ok png"
+rm -f outputs/test_ok_png*
+
+python3 inputs/wms_fixture.py serve outputs/test_ok_png.port &
+SERVER=$!
+trap "kill $SERVER" EXIT
+for i in $(seq 50); do [ -s outputs/test_ok_png.port ] && break; sleep 0.1; done
+URL="http://127.0.0.1:$(cat outputs/test_ok_png.port)/wms?SERVICE=WMS&REQUEST=GetMap&FORMAT=image/png&WIDTH=2&HEIGHT=2"
+
+# Grille 2x2 : les réponses décodées sont assemblées ligne par ligne, depuis celle en haut à gauche
+wms2work -u "$URL" -g 2 2 -j 2 outputs/test_ok_png.tif 0,2,2,4 2,2,4,4 0,0,2,2 2,0,4,2
+if [ $? != 0 ] ; then 
+    exit 1
+fi
+python3 inputs/wms_fixture.py pixels outputs/test_ok_png.tif > outputs/test_ok_png.txt
+cat > outputs/test_ok_png.expected <<PIXELS
+4 4
+0,20,100
+0,20,100
+20,20,100
+20,20,100
+0,20,100
+0,20,100
+20,20,100
+20,20,100
+0,0,100
+0,0,100
+20,0,100
+20,0,100
+0,0,100
+0,0,100
+20,0,100
+20,0,100
+PIXELS
+cmp -s outputs/test_ok_png.txt outputs/test_ok_png.expected
+if [ $? != 0 ] ; then 
+    exit 1
+fi
+
+# Réponses trop petites : pas d'image de travail, sans erreur
+wms2work -u "$URL" -g 2 1 -m 1000000 outputs/test_ok_png_empty.tif 0,0,2,2 2,0,4,2
+if [ $? != 0 ] || [ -f outputs/test_ok_png_empty.tif ] ; then 
+    exit 1
+fi
+
+# Réponse aux mauvaises dimensions : rejetée, pas d'image de travail
+wms2work -u "$URL&RESPONSEWIDTH=3" -g 1 1 -r 0 outputs/test_ok_png_bad.tif 0,0,2,2 2>/dev/null
+if [ $? != 0 ] && [ ! -f outputs/test_ok_png_bad.tif ] ; then 
+    exit 0
+else
+    exit 1
+fi
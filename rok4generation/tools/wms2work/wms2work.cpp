@@ -0,0 +1,779 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file wms2work.cpp
+ * \author Institut national de l'information géographique et forestière
+ * \~french \brief Moissonnage d'une image de travail auprès d'un service WMS
+ * \~french \details L'image est découpée en une grille de requêtes, envoyées en parallèle avec un nombre limité de connexions simultanées au serveur. Chaque réponse est décodée et contrôlée en mémoire, puis les images sont assemblées et écrites directement dans l'image de travail. Une requête en échec est relancée après une attente bornée et aléatoire, dans la limite d'un nombre de relances total.
+ * \~english \brief Harvest a work image from a WMS service
+ * \~english \details Image is split into a grid of requests, sent in parallel with a limited number of simultaneous connections to the server. Each response is decoded and checked in memory, then images are assembled and directly written into the work image. A failed request is sent again after a bounded and random wait, within a total retries budget.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include "Logger.h"
+#include "WebService.h"
+#include "Decoder.h"
+#include "FileImage.h"
+#include "LibpngImage.h"
+#include "LibtiffImage.h"
+#include "CompoundImage.h"
+#include "CurlPool.h"
+#include "Format.h"
+#include "../../../rok4version.h"
+
+/** \~french Nombre maximal de flux parallèles */
+#define MAX_STREAMS 64
+
+/** \~french Message d'usage de la commande wms2work */
+std::string help = std::string("\nwms2work version ") + std::string(ROK4_VERSION) + "\n\n"
+
+    "Harvest a work image from a WMS service, with a grid of parallel requests\n\n"
+
+    "Usage: wms2work -u <URL> -g <VAL> <VAL> [-c <VAL>] [-m <VAL>] [-j <VAL>] [-H <VAL>] [-r <VAL>] [-b <VAL>] [-w <VAL>] [-t <VAL>] [-d] <OUTPUT FILE> <BBOX> [<BBOX> ...]\n\n"
+
+    "Parameters:\n"
+    "     -u GetMap request without BBOX. WIDTH, HEIGHT and FORMAT (image/png, image/jpeg, image/tiff or image/x-bil) are those of one request\n"
+    "     -g number of requests, widthwise and heightwise, to compose the final image. Bounding boxes are provided row by row, from the top left one\n"
+    "     -c output compression : default value : none\n"
+    "             raw     no compression\n"
+    "             none    no compression\n"
+    "             jpg     Jpeg encoding\n"
+    "             lzw     Lempel-Ziv & Welch encoding\n"
+    "             pkb     PackBits encoding\n"
+    "             zip     Deflate encoding\n"
+    "     -m if the total size of responses is lower or equal to this value (in bytes), no image is written. Default : 0\n"
+    "     -j number of parallel requests and decodings. Default : 4\n"
+    "     -H maximum number of simultaneous connections to the WMS server. Default : 2\n"
+    "     -r maximum number of retries for one request. Default : 8\n"
+    "     -b maximum number of retries for all requests. Default : number of requests plus maximum number of retries for one request\n"
+    "     -w maximum wait between two tries, in seconds. Default : 60\n"
+    "     -t request timeout, in seconds. Default : 60\n"
+    "     -d debug logger activation\n\n"
+
+    "Exit code : 0 if success (output image is not written if responses are too small), other value if error\n\n"
+
+    "Example\n"
+    "     wms2work -u \"http://wms.fr/wms?LAYERS=ORTHO&SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&FORMAT=image/png&CRS=EPSG:2154&WIDTH=2048&HEIGHT=2048&STYLES=\" -g 2 1 -c zip -m 10000 work.tif 0,2048,2048,4096 2048,2048,4096,4096\n\n";
+
+/**
+ * \~french
+ * \brief Affiche l'utilisation et les différentes options de la commande wms2work #help
+ * \details L'affichage se fait dans le niveau de logger INFO
+ */
+void usage() {
+    LOGGER_INFO ( help );
+}
+
+/**
+ * \~french
+ * \brief Affiche un message d'erreur, l'utilisation de la commande et sort en erreur
+ * \param[in] message message d'erreur
+ * \param[in] errorCode code de retour
+ */
+void error ( std::string message, int errorCode ) {
+    LOGGER_ERROR ( message );
+    usage();
+    sleep ( 1 );
+    exit ( errorCode );
+}
+
+/** \~french Formats de réponse gérés */
+enum ResponseFormat {
+    UNKNOWN_RESPONSE,
+    PNG_RESPONSE,
+    JPEG_RESPONSE,
+    TIFF_RESPONSE,
+    BIL_RESPONSE
+};
+
+/**
+ * \~french \brief Image moissonnée, décodée et contrôlée
+ * \~english \brief Harvested image, decoded and checked
+ */
+struct HarvestedImage {
+    /** \~french \brief Image décodée, lue depuis la mémoire */
+    Image* image;
+    /** \~french \brief Taille de la réponse, en octets */
+    size_t size;
+    SampleFormat::eSampleFormat sampleformat;
+    int bitspersample;
+    Photometric::ePhotometric photometric;
+};
+
+/** \~french Requête GetMap, sans la BBOX */
+std::string url = "";
+/** \~french Dimensions et format d'une image moissonnée, lus dans la requête */
+int width = 0, height = 0;
+ResponseFormat format = UNKNOWN_RESPONSE;
+
+/** \~french Nombre d'images dans le sens de la largeur et de la hauteur */
+int widthwiseImage = 0;
+int heightwiseImage = 0;
+
+/** \~french Compression de l'image de sortie */
+Compression::eCompression compression = Compression::NONE;
+
+/** \~french Chemin de l'image en sortie */
+char* outputImage = 0;
+
+/** \~french Emprises des requêtes, ligne par ligne depuis celle en haut à gauche */
+std::vector<std::string> bboxes;
+
+/** \~french Taille totale des réponses en dessous de laquelle (incluse) l'image n'est pas écrite */
+long minSize = 0;
+
+/** \~french Nombre de flux parallèles */
+int streams = 4;
+/** \~french Nombre maximal de connexions simultanées au serveur */
+int connections = 2;
+/** \~french Nombre maximal de relances d'une requête */
+int maxRetries = 8;
+/** \~french Nombre maximal de relances pour l'ensemble des requêtes, négatif pour la valeur par défaut */
+int retryBudget = -1;
+/** \~french Attente maximale entre deux essais, en secondes */
+int maxWait = 60;
+/** \~french Délai d'expiration d'une requête, en secondes */
+int timeout = 60;
+
+/** \~french Activation du niveau de log debug. Faux par défaut */
+bool debugLogger = false;
+
+/** \~french Service interrogé, partagé par les flux (chaque flux a sa propre connexion via le CurlPool) */
+WebService* service = NULL;
+
+/** \~french Limite les connexions simultanées au serveur */
+sem_t serverSlots;
+
+/** \~french Protège les éléments partagés par les flux : prochaine requête, relances restantes et abandon */
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+size_t nextRequest = 0;
+int remainingRetries = 0;
+/** \~french Une requête a définitivement échoué, les autres flux s'arrêtent */
+bool aborted = false;
+
+/** \~french Images moissonnées, dans l'ordre des emprises */
+std::vector<HarvestedImage> harvested;
+
+/**
+ * \~french \brief Lit la valeur d'un paramètre de la requête, sans tenir compte de la casse du nom
+ * \return la valeur, vide si le paramètre est absent
+ */
+std::string getParameter ( std::string request, std::string name ) {
+    size_t query = request.find ( '?' );
+    if ( query == std::string::npos ) return "";
+    std::transform ( name.begin(), name.end(), name.begin(), toupper );
+
+    std::istringstream params ( request.substr ( query + 1 ) );
+    std::string param;
+    while ( std::getline ( params, param, '&' ) ) {
+        size_t equal = param.find ( '=' );
+        if ( equal == std::string::npos ) continue;
+        std::string key = param.substr ( 0, equal );
+        std::transform ( key.begin(), key.end(), key.begin(), toupper );
+        if ( key == name ) return param.substr ( equal + 1 );
+    }
+    return "";
+}
+
+/**
+ * \~french \brief Format de réponse correspondant au paramètre FORMAT de la requête
+ */
+ResponseFormat toResponseFormat ( std::string mime ) {
+    std::transform ( mime.begin(), mime.end(), mime.begin(), tolower );
+    size_t slash = mime.find ( "%2f" );
+    if ( slash != std::string::npos ) mime.replace ( slash, 3, "/" );
+
+    if ( mime == "image/png" ) return PNG_RESPONSE;
+    if ( mime == "image/jpeg" ) return JPEG_RESPONSE;
+    if ( mime == "image/tiff" || mime == "image/geotiff" ) return TIFF_RESPONSE;
+    if ( mime.compare ( 0, 11, "image/x-bil" ) == 0 ) return BIL_RESPONSE;
+    return UNKNOWN_RESPONSE;
+}
+
+/**
+ * \~french
+ * \brief Lit toutes les lignes d'une image dans un tampon
+ * \return faux si une ligne n'a pu être lue
+ */
+template<typename T>
+bool readAllLines ( Image* image, T* buffer ) {
+    int lineSize = image->getWidth() * image->getChannels();
+    for ( int l = 0; l < image->getHeight(); l++ ) {
+        if ( image->getline ( buffer + l * lineSize, l ) != lineSize ) return false;
+    }
+    return true;
+}
+
+/**
+ * \~french
+ * \brief Lit les dimensions et le nombre de canaux dans l'en-tête d'une image JPEG
+ * \details Les segments sont parcourus jusqu'au premier marqueur de début de trame (SOFn).
+ * \return faux si aucun en-tête de trame n'est trouvé
+ */
+bool readJpegHeader ( const uint8_t* data, size_t size, int& w, int& h, int& channels ) {
+    size_t pos = 2;
+    while ( pos + 4 <= size && data[pos] == 0xFF ) {
+        uint8_t marker = data[pos + 1];
+        size_t length = ( data[pos + 2] << 8 ) + data[pos + 3];
+        if ( marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC ) {
+            if ( pos + 10 > size ) return false;
+            h = ( data[pos + 5] << 8 ) + data[pos + 6];
+            w = ( data[pos + 7] << 8 ) + data[pos + 8];
+            channels = data[pos + 9];
+            return true;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+/**
+ * \~french
+ * \brief Décode et contrôle une réponse
+ * \details Le format réel (signature des données) doit être celui demandé, et les dimensions celles de la requête. Une image TIFF est entièrement décodée ici, pour que ses éventuelles erreurs fassent relancer la requête. La réponse est détruite.
+ * \param[in] response réponse du serveur
+ * \param[out] harvest image décodée et ses caractéristiques
+ * \return faux si la réponse n'est pas une image valide
+ */
+bool decodeResponse ( RawDataSource* response, HarvestedImage& harvest ) {
+
+    size_t size;
+    const uint8_t* data = response->getData ( size );
+    harvest.size = size;
+    harvest.image = NULL;
+    harvest.sampleformat = SampleFormat::UINT;
+    harvest.bitspersample = 8;
+
+    ResponseFormat actual = UNKNOWN_RESPONSE;
+    if ( size >= 8 && memcmp ( data, "\x89PNG\r\n\x1a\n", 8 ) == 0 ) actual = PNG_RESPONSE;
+    else if ( size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF ) actual = JPEG_RESPONSE;
+    else if ( size >= 4 && ( memcmp ( data, "II*\0", 4 ) == 0 || memcmp ( data, "MM\0*", 4 ) == 0 ) ) actual = TIFF_RESPONSE;
+    else if ( format == BIL_RESPONSE && response->getType().find ( "xml" ) == std::string::npos && response->getType().find ( "text" ) == std::string::npos ) actual = BIL_RESPONSE;
+
+    if ( actual != format ) {
+        LOGGER_ERROR ( "Response is not the expected image (content type " << response->getType() << ") : "
+            << std::string ( ( const char* ) data, std::min ( size, ( size_t ) 500 ) ) );
+        delete response;
+        return false;
+    }
+
+    switch ( format ) {
+    case PNG_RESPONSE : {
+        RawDataStream stream ( ( uint8_t* ) data, size );
+        delete response;
+        LibpngImageFactory LIF;
+        LibpngImage* png = LIF.createLibpngImageToReadFromBuffer ( &stream, BoundingBox<double> ( 0, 0, 0, 0 ), -1, -1 );
+        if ( png == NULL ) return false;
+        harvest.image = png;
+        harvest.photometric = png->getPhotometric();
+        break;
+    }
+    case JPEG_RESPONSE : {
+        int w, h, channels;
+        if ( ! readJpegHeader ( data, size, w, h, channels ) ) {
+            LOGGER_ERROR ( "Cannot read the JPEG response header" );
+            delete response;
+            return false;
+        }
+        DataSourceDecoder<JpegDecoder>* decoder = new DataSourceDecoder<JpegDecoder> ( response );
+        size_t rawSize;
+        if ( decoder->getData ( rawSize ) == NULL || rawSize != ( size_t ) w * h * channels ) {
+            LOGGER_ERROR ( "Cannot decode the JPEG response" );
+            delete decoder;
+            return false;
+        }
+        harvest.image = new ImageDecoder ( decoder, w, h, channels );
+        harvest.photometric = ( channels == 1 ) ? Photometric::GRAY : Photometric::RGB;
+        break;
+    }
+    case TIFF_RESPONSE : {
+        RawDataStream stream ( ( uint8_t* ) data, size );
+        delete response;
+        LibtiffImageFactory LTIF;
+        LibtiffImage* tiff = LTIF.createLibtiffImageToReadFromBuffer ( &stream, BoundingBox<double> ( 0, 0, 0, 0 ), -1, -1 );
+        if ( tiff == NULL ) return false;
+
+        harvest.sampleformat = tiff->getSampleFormat();
+        harvest.bitspersample = tiff->getBitsPerSample();
+        harvest.photometric = tiff->getPhotometric();
+        int channels = tiff->getChannels();
+        int pixelSize = channels * harvest.bitspersample / 8;
+        size_t rawSize = ( size_t ) tiff->getWidth() * tiff->getHeight() * pixelSize;
+
+        uint8_t* raw = new uint8_t[rawSize];
+        bool ok;
+        if ( harvest.sampleformat == SampleFormat::FLOAT && harvest.bitspersample == 32 ) {
+            ok = readAllLines ( tiff, ( float* ) raw );
+        } else if ( harvest.sampleformat == SampleFormat::UINT && harvest.bitspersample == 8 ) {
+            ok = readAllLines ( tiff, raw );
+        } else {
+            LOGGER_ERROR ( "Not handled sample type in the TIFF response : " << SampleFormat::toString ( harvest.sampleformat ) << " on " << harvest.bitspersample << " bits" );
+            ok = false;
+        }
+
+        if ( ok ) {
+            harvest.image = new ImageDecoder (
+                new RawDataSource ( raw, rawSize ), tiff->getWidth(), tiff->getHeight(), channels,
+                BoundingBox<double> ( 0, 0, 0, 0 ), 0, 0, 0, 0, harvest.bitspersample / 8
+            );
+        } else {
+            LOGGER_ERROR ( "Cannot decode the TIFF response" );
+        }
+        delete[] raw;
+        delete tiff;
+        if ( ! ok ) return false;
+        break;
+    }
+    case BIL_RESPONSE : {
+        if ( size == 0 || size % ( width * height * sizeof ( float ) ) != 0 ) {
+            LOGGER_ERROR ( "BIL response size (" << size << ") is not consistent with the image dimensions" );
+            delete response;
+            return false;
+        }
+        int channels = size / ( width * height * sizeof ( float ) );
+        harvest.image = new ImageDecoder ( response, width, height, channels, BoundingBox<double> ( 0, 0, 0, 0 ), 0, 0, 0, 0, sizeof ( float ) );
+        harvest.sampleformat = SampleFormat::FLOAT;
+        harvest.bitspersample = 32;
+        harvest.photometric = ( channels == 1 ) ? Photometric::GRAY : Photometric::RGB;
+        break;
+    }
+    default :
+        delete response;
+        return false;
+    }
+
+    if ( harvest.image->getWidth() != width || harvest.image->getHeight() != height ) {
+        LOGGER_ERROR ( "Response dimensions (" << harvest.image->getWidth() << "x" << harvest.image->getHeight()
+            << ") are not the requested ones (" << width << "x" << height << ")" );
+        delete harvest.image;
+        harvest.image = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * \~french
+ * \brief Attente avant un nouvel essai
+ * \details L'attente double à chaque essai, à partir d'une seconde et dans la limite de #maxWait. Elle est tirée au hasard entre la moitié et la totalité de cette valeur, pour que les requêtes en échec ne soient pas relancées toutes ensemble.
+ * \return l'attente en millisecondes
+ */
+long backoff ( int attempt, unsigned int* seed ) {
+    long ceiling = 1000L * maxWait;
+    if ( attempt < 31 ) ceiling = std::min ( ceiling, 1000L << ( attempt - 1 ) );
+    return ceiling / 2 + rand_r ( seed ) % ( ceiling / 2 + 1 );
+}
+
+/**
+ * \~french
+ * \brief Flux de moissonnage
+ * \details Chaque flux traite les requêtes suivantes de la grille jusqu'à son épuisement, ou l'abandon du moissonnage. Seul l'envoi de la requête est soumis à la limite de connexions, le décodage se fait en parallèle des autres téléchargements.
+ */
+void* harvestImages ( void* arg ) {
+
+    unsigned int seed = time ( NULL ) ^ ( unsigned int ) pthread_self();
+
+    while ( true ) {
+        pthread_mutex_lock ( &mutex );
+        if ( aborted || nextRequest >= bboxes.size() ) {
+            pthread_mutex_unlock ( &mutex );
+            break;
+        }
+        size_t r = nextRequest++;
+        pthread_mutex_unlock ( &mutex );
+
+        std::string request = url + "&BBOX=" + bboxes.at ( r );
+        LOGGER_DEBUG ( "Request " << r + 1 << "/" << bboxes.size() << " : " << request );
+
+        for ( int attempt = 1; ; attempt++ ) {
+
+            sem_wait ( &serverSlots );
+            RawDataSource* response = service->performRequest ( request );
+            sem_post ( &serverSlots );
+
+            if ( response != NULL && decodeResponse ( response, harvested.at ( r ) ) ) break;
+
+            pthread_mutex_lock ( &mutex );
+            if ( aborted ) {
+                pthread_mutex_unlock ( &mutex );
+                return NULL;
+            }
+            if ( attempt > maxRetries || remainingRetries == 0 ) {
+                LOGGER_ERROR ( "Request " << r + 1 << " failed " << attempt << " time(s), "
+                    << ( remainingRetries == 0 ? "retries budget is exhausted" : "maximum retries number is reached" ) << " : " << request );
+                aborted = true;
+                pthread_mutex_unlock ( &mutex );
+                return NULL;
+            }
+            remainingRetries--;
+            pthread_mutex_unlock ( &mutex );
+
+            long wait = backoff ( attempt, &seed );
+            LOGGER_WARN ( "Failure " << attempt << " for request " << r + 1 << " : wait for " << wait << " ms" );
+            usleep ( wait * 1000 );
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * \~french
+ * \brief Récupère les valeurs passées en paramètres de la commande, et les stocke dans les variables globales
+ * \param[in] argc nombre de paramètres
+ * \param[in] argv tableau des paramètres
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+int parseCommandLine ( int argc, char** argv ) {
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' ) {
+            switch ( argv[i][1] ) {
+            case 'h': // help
+                usage();
+                exit ( 0 );
+            case 'd': // debug logs
+                debugLogger = true;
+                break;
+            case 'u': // requête
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in -u option" );
+                    return -1;
+                }
+                url = argv[i];
+                break;
+            case 'c': // compression
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in -c option" );
+                    return -1;
+                }
+                if ( strncmp ( argv[i], "none",4 ) == 0 || strncmp ( argv[i], "raw",3 ) == 0 ) {
+                    compression = Compression::NONE;
+                } else if ( strncmp ( argv[i], "jpg",3 ) == 0 ) {
+                    compression = Compression::JPEG;
+                } else if ( strncmp ( argv[i], "lzw",3 ) == 0 ) {
+                    compression = Compression::LZW;
+                } else if ( strncmp ( argv[i], "zip",3 ) == 0 ) {
+                    compression = Compression::DEFLATE;
+                } else if ( strncmp ( argv[i], "pkb",3 ) == 0 ) {
+                    compression = Compression::PACKBITS;
+                } else {
+                    LOGGER_ERROR ( "Unknown compression : " << argv[i] );
+                    return -1;
+                }
+                break;
+            case 'g': // grille des requêtes
+                if ( i+2 >= argc ) {
+                    LOGGER_ERROR ( "Error in -g option" );
+                    return -1;
+                }
+                widthwiseImage = atoi ( argv[++i] );
+                heightwiseImage = atoi ( argv[++i] );
+                break;
+            case 'm': // taille minimale
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in -m option" );
+                    return -1;
+                }
+                minSize = atol ( argv[i] );
+                break;
+            case 'j': // flux parallèles
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in -j option" );
+                    return -1;
+                }
+                streams = atoi ( argv[i] );
+                if ( streams < 1 || streams > MAX_STREAMS ) {
+                    LOGGER_ERROR ( "Streams number (-j) have to be between 1 and " << MAX_STREAMS );
+                    return -1;
+                }
+                break;
+            case 'H': // connexions au serveur
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in -H option" );
+                    return -1;
+                }
+                connections = atoi ( argv[i] );
+                if ( connections < 1 ) {
+                    LOGGER_ERROR ( "Connections number (-H) have to be positive" );
+                    return -1;
+                }
+                break;
+            case 'r': // relances d'une requête
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in -r option" );
+                    return -1;
+                }
+                maxRetries = atoi ( argv[i] );
+                break;
+            case 'b': // relances de l'ensemble des requêtes
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in -b option" );
+                    return -1;
+                }
+                retryBudget = atoi ( argv[i] );
+                break;
+            case 'w': // attente maximale
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in -w option" );
+                    return -1;
+                }
+                maxWait = atoi ( argv[i] );
+                if ( maxWait < 1 ) {
+                    LOGGER_ERROR ( "Maximum wait (-w) have to be positive" );
+                    return -1;
+                }
+                break;
+            case 't': // délai d'expiration
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in -t option" );
+                    return -1;
+                }
+                timeout = atoi ( argv[i] );
+                break;
+            default:
+                LOGGER_ERROR ( "Unknown option : " << argv[i] );
+                return -1;
+            }
+        } else if ( outputImage == 0 ) {
+            outputImage = argv[i];
+        } else {
+            bboxes.push_back ( argv[i] );
+        }
+    }
+
+    // Request control
+    if ( url == "" ) {
+        LOGGER_ERROR ( "We need to have a GetMap request (option -u)" );
+        return -1;
+    }
+    width = atoi ( getParameter ( url, "WIDTH" ).c_str() );
+    height = atoi ( getParameter ( url, "HEIGHT" ).c_str() );
+    if ( width <= 0 || height <= 0 ) {
+        LOGGER_ERROR ( "Request have to provide valid WIDTH and HEIGHT parameters" );
+        return -1;
+    }
+    format = toResponseFormat ( getParameter ( url, "FORMAT" ) );
+    if ( format == UNKNOWN_RESPONSE ) {
+        LOGGER_ERROR ( "Request have to provide a handled FORMAT parameter : " << getParameter ( url, "FORMAT" ) );
+        return -1;
+    }
+
+    // Output file control
+    if ( outputImage == 0 ) {
+        LOGGER_ERROR ( "We need to have an output file" );
+        return -1;
+    }
+
+    // Geometry control
+    if ( widthwiseImage <= 0 || heightwiseImage <= 0 ) {
+        LOGGER_ERROR ( "We need to know composition geometry (option -g)" );
+        return -1;
+    }
+    if ( bboxes.size() != ( size_t ) ( widthwiseImage * heightwiseImage ) ) {
+        LOGGER_ERROR ( "We need " << widthwiseImage * heightwiseImage << " bounding boxes, and we have " << bboxes.size() );
+        return -1;
+    }
+
+    if ( retryBudget < 0 ) {
+        retryBudget = bboxes.size() + maxRetries;
+    }
+
+    return 0;
+}
+
+/**
+ * \~french
+ * \brief Assemble les images moissonnées et écrit l'image de travail
+ * \details Toutes les images doivent avoir les mêmes caractéristiques. Elles sont gérées par un objet de la classe #CompoundImage, et l'image en sortie sera une image TIFF.
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+int writeWorkImage() {
+
+    std::vector< std::vector<Image*> > imagesIn ( heightwiseImage, std::vector<Image*> ( widthwiseImage ) );
+    HarvestedImage& first = harvested.at ( 0 );
+
+    for ( unsigned int k = 0; k < harvested.size(); k++ ) {
+        int i = k / widthwiseImage;
+        int j = k % widthwiseImage;
+        HarvestedImage& h = harvested.at ( k );
+
+        if ( h.image->getChannels() != first.image->getChannels() || h.sampleformat != first.sampleformat ||
+             h.bitspersample != first.bitspersample || h.photometric != first.photometric ) {
+            LOGGER_ERROR ( "All harvested images must have same sample type : error for request " << k + 1 );
+            return -1;
+        }
+
+        h.image->setBbox ( BoundingBox<double> ( j * width, ( heightwiseImage - i - 1 ) * height, ( j+1 ) * width, ( heightwiseImage - i ) * height ) );
+        imagesIn[i][j] = h.image;
+    }
+
+    CompoundImage* pCompoundIn = new CompoundImage ( imagesIn );
+
+    FileImageFactory FIF;
+    FileImage* pImageOut = FIF.createImageToWrite (
+        outputImage, BoundingBox<double> ( 0., 0., 0., 0. ), -1., -1., width * widthwiseImage, height * heightwiseImage,
+        first.image->getChannels(), first.sampleformat, first.bitspersample, first.photometric, compression
+    );
+
+    if ( pImageOut == NULL ) {
+        LOGGER_ERROR ( "Impossible de creer l'image de sortie " << outputImage );
+        delete pCompoundIn;
+        return -1;
+    }
+
+    int ret = pImageOut->writeImage ( pCompoundIn );
+    if ( ret < 0 ) {
+        LOGGER_ERROR ( "Cannot write the compound image" );
+    }
+
+    delete pImageOut;
+    delete pCompoundIn;
+
+    return ( ret < 0 ) ? -1 : 0;
+}
+
+/**
+ ** \~french
+ * \brief Fonction principale de l'outil wms2work
+ * \param[in] argc nombre de paramètres
+ * \param[in] argv tableau des paramètres
+ * \return code de retour, 0 si réussi, -1 sinon
+ ** \~english
+ * \brief Main function for tool wms2work
+ * \param[in] argc parameters number
+ * \param[in] argv parameters array
+ * \return 0 if success, -1 otherwise
+ */
+int main ( int argc, char **argv ) {
+
+    /* Initialisation des Loggers */
+    Logger::setOutput ( STANDARD_OUTPUT_STREAM_FOR_ERRORS );
+
+    Accumulator* acc = new StreamAccumulator();
+    Logger::setAccumulator ( INFO , acc );
+    Logger::setAccumulator ( WARN , acc );
+    Logger::setAccumulator ( ERROR, acc );
+    Logger::setAccumulator ( FATAL, acc );
+
+    std::ostream &logw = LOGGER ( WARN );
+    logw.precision ( 16 );
+    logw.setf ( std::ios::fixed,std::ios::floatfield );
+
+    // Lecture des parametres de la ligne de commande
+    if ( parseCommandLine ( argc,argv ) < 0 ) {
+        error ( "Cannot parse command line",-1 );
+    }
+
+    // On sait maintenant si on doit activer le niveau de log DEBUG
+    if ( debugLogger ) {
+        Logger::setAccumulator ( DEBUG, acc );
+        std::ostream &logd = LOGGER ( DEBUG );
+        logd.precision ( 16 );
+        logd.setf ( std::ios::fixed,std::ios::floatfield );
+    }
+
+    /********************** Moissonnage */
+
+    curl_global_init ( CURL_GLOBAL_ALL );
+
+    // Les relances sont gérées ici, pour borner et répartir les attentes
+    service = new WebService ( url, 0, 0, timeout );
+    service->setUserAgent ( std::string ( "ROK4-" ) + ROK4_VERSION + " wms2work" );
+
+    harvested.resize ( bboxes.size() );
+    remainingRetries = retryBudget;
+    sem_init ( &serverSlots, 0, connections );
+
+    int nbThreads = std::min ( streams, ( int ) bboxes.size() );
+    LOGGER_DEBUG ( bboxes.size() << " request(s) with " << nbThreads << " stream(s) and " << connections << " connection(s)" );
+
+    std::vector<pthread_t> threads ( nbThreads );
+    for ( int t = 0; t < nbThreads; t++ ) {
+        pthread_create ( &threads[t], NULL, harvestImages, NULL );
+    }
+    for ( int t = 0; t < nbThreads; t++ ) {
+        pthread_join ( threads[t], NULL );
+    }
+
+    sem_destroy ( &serverSlots );
+    delete service;
+    CurlPool::cleanCurlPool();
+    curl_global_cleanup();
+
+    int ret = 0;
+    long totalSize = 0;
+    for ( unsigned int k = 0; k < harvested.size(); k++ ) {
+        totalSize += harvested.at ( k ).size;
+    }
+
+    if ( aborted ) {
+        LOGGER_ERROR ( "Cannot harvest all images" );
+        ret = -1;
+    } else if ( totalSize <= minSize ) {
+        // Images vides : aucune image de travail n'est écrite
+        LOGGER_INFO ( "Harvested images are too small (" << totalSize << " bytes), no work image is written" );
+    } else {
+        LOGGER_DEBUG ( "Save image" );
+        ret = writeWorkImage();
+    }
+
+    if ( aborted || totalSize <= minSize ) {
+        for ( unsigned int k = 0; k < harvested.size(); k++ ) {
+            delete harvested.at ( k ).image;
+        }
+    }
+
+    // Suppression du nettoyage du logger jusqu'à sa refonte
+    // Logger::stopLogger();
+    // if ( acc ) {
+    //     delete acc;
+    // }
+
+    return ret;
+}
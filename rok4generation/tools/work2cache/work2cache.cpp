@@ -76,7 +76,7 @@ std::string help = std::string("\nwork2cache version ") + std::string(ROK4_VERSI
 
     "Make image tiled and compressed, in TIFF format, respecting ROK4 specifications.\n\n"
 
-    "Usage: work2cache -c <VAL> -t <VAL> <VAL> <INPUT FILE> <OUTPUT FILE> [-crop]\n\n"
+    "Usage: work2cache -c <VAL> -t <VAL> <VAL> <INPUT FILE> <OUTPUT FILE> [-crop] [-quality <VAL>] [-subsampling <VAL>] [-dct <VAL>] [-optimize]\n\n"
 
     "Parameters:\n"
     "     -c output compression :\n"
@@ -92,6 +92,10 @@ std::string help = std::string("\nwork2cache version ") + std::string(ROK4_VERSI
     "     -container Swift container where data is. Then OUTPUT FILE is interpreted as a Swift object name (ONLY IF OBJECT COMPILATION)\n"
     "     -bucket S3 bucket where data is. Then OUTPUT FILE is interpreted as a S3 object name (ONLY IF OBJECT COMPILATION)\n"
     "     -crop : blocks (used by JPEG compression) wich contain a white pixel are filled with white\n"
+    "     -quality : JPEG quality, from 1 to 100 (default 75)\n"
+    "     -subsampling : JPEG chroma subsampling, 4:2:0 (default), 4:2:2 or 4:4:4\n"
+    "     -dct : JPEG DCT method, islow (default), ifast or float\n"
+    "     -optimize : JPEG Huffman tables optimisation\n"
     "     -a sample format : (float or uint)\n"
     "     -b bits per sample : (8 or 32)\n"
     "     -s samples per pixel : (1, 2, 3 or 4)\n"
@@ -155,6 +159,8 @@ int main ( int argc, char **argv ) {
     Photometric::ePhotometric photometric;
 
     bool crop = false;
+    JpegOptions jpegOptions;
+    bool jpegOptionsProvided = false;
     bool debugLogger=false;
 
 #if BUILD_OBJECT
@@ -183,6 +189,32 @@ int main ( int argc, char **argv ) {
             crop = true;
             continue;
         }
+        if ( !strcmp ( argv[i],"-quality" ) ) {
+            if ( ++i == argc || ! jpegOptions.setQuality ( atoi ( argv[i] ) ) ) {
+                error("Error in -quality option (integer between 1 and 100)", -1);
+            }
+            jpegOptionsProvided = true;
+            continue;
+        }
+        if ( !strcmp ( argv[i],"-subsampling" ) ) {
+            if ( ++i == argc || ! jpegOptions.setSubsampling ( argv[i] ) ) {
+                error("Error in -subsampling option (4:2:0, 4:2:2 or 4:4:4)", -1);
+            }
+            jpegOptionsProvided = true;
+            continue;
+        }
+        if ( !strcmp ( argv[i],"-dct" ) ) {
+            if ( ++i == argc || ! jpegOptions.setDct ( argv[i] ) ) {
+                error("Error in -dct option (islow, ifast or float)", -1);
+            }
+            jpegOptionsProvided = true;
+            continue;
+        }
+        if ( !strcmp ( argv[i],"-optimize" ) ) {
+            jpegOptions.setOptimize ( true );
+            jpegOptionsProvided = true;
+            continue;
+        }
 
 #if BUILD_OBJECT
         if ( !strcmp ( argv[i],"-pool" ) ) {
@@ -342,6 +374,10 @@ int main ( int argc, char **argv ) {
         crop = false;
     }
 
+    if (jpegOptionsProvided && compression != Compression::JPEG) {
+        LOGGER_WARN("Quality, subsampling, dct and optimize options are reserved for JPEG compression");
+    }
+
     // For jpeg compression with crop option, we have to remove white pixel, to avoid empty bloc in data
     if ( crop ) {
         LOGGER_DEBUG ( "Open image to read" );
@@ -408,6 +444,10 @@ int main ( int argc, char **argv ) {
     }
 
     rok4Image->setExtraSample(sourceImage->getExtraSample());
+    rok4Image->setJpegOptions(jpegOptions);
+    if (compression == Compression::JPEG) {
+        LOGGER_DEBUG ( "JPEG compression : " << jpegOptions.toString() );
+    }
 
     if (debugLogger) {
         rok4Image->print();
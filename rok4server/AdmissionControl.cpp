@@ -0,0 +1,139 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file AdmissionControl.cpp
+ ** \~french
+ * \brief Implémentation de la classe AdmissionControl
+ ** \~english
+ * \brief Implement class AdmissionControl
+ */
+
+#include "AdmissionControl.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include <errno.h>
+#include <time.h>
+
+AdmissionControl::AdmissionControl() : occupied ( 0 ) {
+    pthread_mutex_init ( &mutex, NULL );
+    pthread_cond_init ( &released, NULL );
+}
+
+AdmissionControl::~AdmissionControl() {
+    pthread_mutex_destroy ( &mutex );
+    pthread_cond_destroy ( &released );
+}
+
+bool AdmissionControl::isAvailable ( std::vector<AdmissionBudget>& budgets ) {
+    for ( unsigned int i = 0; i < budgets.size(); i++ ) {
+        if ( running[budgets.at(i).name] >= budgets.at(i).limit ) return false;
+    }
+    return true;
+}
+
+bool AdmissionControl::admit ( std::vector<AdmissionBudget>& budgets, int maxOccupied, int timeout ) {
+
+    uint64_t start = Metrics::now();
+
+    pthread_mutex_lock ( &mutex );
+
+    // Attendre occuperait un des threads réservés aux tuiles pré-calculées : refus immédiat
+    if ( maxOccupied > 0 && occupied >= maxOccupied ) {
+        pthread_mutex_unlock ( &mutex );
+        Metrics::count ( "rok4_admission_total", Metrics::label ( "result", "rejected_threads" ) );
+        return false;
+    }
+    occupied++;
+
+    timespec deadline;
+    clock_gettime ( CLOCK_REALTIME, &deadline );
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += ( long ) ( timeout % 1000 ) * 1000000;
+    if ( deadline.tv_nsec >= 1000000000 ) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    bool admitted = true;
+    while ( ! isAvailable ( budgets ) ) {
+        if ( pthread_cond_timedwait ( &released, &mutex, &deadline ) == ETIMEDOUT && ! isAvailable ( budgets ) ) {
+            admitted = false;
+            break;
+        }
+    }
+
+    if ( admitted ) {
+        for ( unsigned int i = 0; i < budgets.size(); i++ ) {
+            int n = ++running[budgets.at(i).name];
+            std::string labels = Metrics::label ( "budget", budgets.at(i).name );
+            MetricsGauge* g = Metrics::getGauge ( "rok4_admission_in_flight", labels );
+            if ( g ) g->set ( n );
+            g = Metrics::getGauge ( "rok4_admission_limit", labels );
+            if ( g ) g->set ( budgets.at(i).limit );
+        }
+    } else {
+        occupied--;
+    }
+    MetricsGauge* g = Metrics::getGauge ( "rok4_admission_threads", "" );
+    if ( g ) g->set ( occupied );
+
+    pthread_mutex_unlock ( &mutex );
+
+    MetricsHistogram* h = Metrics::getHistogram ( "rok4_admission_wait_seconds", "" );
+    if ( h ) h->record ( Metrics::now() - start );
+    Metrics::count ( "rok4_admission_total", Metrics::label ( "result", admitted ? "admitted" : "rejected_timeout" ) );
+
+    return admitted;
+}
+
+void AdmissionControl::release ( std::vector<AdmissionBudget>& budgets ) {
+    pthread_mutex_lock ( &mutex );
+
+    for ( unsigned int i = 0; i < budgets.size(); i++ ) {
+        int n = --running[budgets.at(i).name];
+        MetricsGauge* g = Metrics::getGauge ( "rok4_admission_in_flight", Metrics::label ( "budget", budgets.at(i).name ) );
+        if ( g ) g->set ( n );
+    }
+    occupied--;
+    MetricsGauge* g = Metrics::getGauge ( "rok4_admission_threads", "" );
+    if ( g ) g->set ( occupied );
+
+    pthread_cond_broadcast ( &released );
+    pthread_mutex_unlock ( &mutex );
+}
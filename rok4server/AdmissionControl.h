@@ -0,0 +1,157 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file AdmissionControl.h
+ ** \~french
+ * \brief Définition de la classe AdmissionControl
+ ** \~english
+ * \brief Define class AdmissionControl
+ */
+
+#ifndef ADMISSIONCONTROL_H
+#define ADMISSIONCONTROL_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+
+/**
+ * \~french \brief Budget de concurrence : nom (opération ou couche) et nombre maximal de requêtes simultanées
+ * \~english \brief Concurrency budget : name (operation or layer) and maximal number of simultaneous requests
+ */
+struct AdmissionBudget {
+    std::string name;
+    int limit;
+    AdmissionBudget ( std::string n, int l ) : name ( n ), limit ( l ) {}
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Contrôle d'admission des requêtes dans les threads du serveur
+ * \details Une requête coûteuse (GetMap, tuile à la demande...) doit obtenir une place dans chacun de ses budgets (son opération, ses couches) avant d'être traitée. Elle attend au plus le délai configuré qu'une place se libère, sinon elle est refusée.
+ *
+ * Comme une requête en attente occupe un thread, le nombre de threads occupés par les requêtes coûteuses, en attente ou en cours, est lui aussi limité : les threads restants sont réservés aux tuiles pré-calculées, qui ne sont jamais mises en attente. Au delà, le refus est immédiat.
+ *
+ * Le nombre de requêtes en cours et la limite de chaque budget sont exposés dans les métriques.
+ * \~english
+ * \brief Requests admission control in server's threads
+ * \details An expensive request (GetMap, on demand tile...) have to obtain a place in each of its budgets (its operation, its layers) before being processed. It waits at most the configured delay for a place to be freed, otherwise it is rejected.
+ *
+ * As a waiting request uses a thread, the number of threads used by expensive requests, waiting or running, is limited too : remaining threads are reserved to pre-computed tiles, which are never queued. Beyond, rejection is immediate.
+ *
+ * Running requests number and limit of each budget are exposed in metrics.
+ */
+class AdmissionControl {
+
+private:
+
+    /**
+     * \~french \brief Protège les compteurs
+     * \~english \brief Protect counters
+     */
+    pthread_mutex_t mutex;
+
+    /**
+     * \~french \brief Signale la libération d'une place
+     * \~english \brief Signal a freed place
+     */
+    pthread_cond_t released;
+
+    /**
+     * \~french \brief Nombre de requêtes en cours, par budget
+     * \~english \brief Running requests number, by budget
+     */
+    std::map<std::string, int> running;
+
+    /**
+     * \~french \brief Nombre de threads occupés par des requêtes coûteuses, en attente ou en cours
+     * \~english \brief Number of threads used by expensive requests, waiting or running
+     */
+    int occupied;
+
+    /**
+     * \~french \brief Toutes les places des budgets sont-elles disponibles
+     * \~english \brief Are places available in all budgets
+     */
+    bool isAvailable ( std::vector<AdmissionBudget>& budgets );
+
+public:
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    AdmissionControl();
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    ~AdmissionControl();
+
+    /**
+     * \~french
+     * \brief Demande l'admission d'une requête coûteuse
+     * \details En cas de succès, #release doit être appelé avec les mêmes budgets à la fin du traitement
+     * \param[in] budgets budgets dans lesquels la requête doit obtenir une place
+     * \param[in] maxOccupied nombre maximal de threads occupés par des requêtes coûteuses, 0 si pas de limite
+     * \param[in] timeout attente maximale d'une place, en millisecondes
+     * \return true si la requête est admise
+     * \~english
+     * \brief Ask for an expensive request admission
+     * \details If success, #release have to be called with same budgets at the processing end
+     * \param[in] budgets budgets in which request have to obtain a place
+     * \param[in] maxOccupied maximal number of threads used by expensive requests, 0 if no limit
+     * \param[in] timeout maximal wait for a place, in milliseconds
+     * \return true if request is admitted
+     */
+    bool admit ( std::vector<AdmissionBudget>& budgets, int maxOccupied, int timeout );
+
+    /**
+     * \~french
+     * \brief Libère les places d'une requête admise
+     * \~english
+     * \brief Free places of an admitted request
+     */
+    void release ( std::vector<AdmissionBudget>& budgets );
+};
+
+#endif // ADMISSIONCONTROL_H
@@ -0,0 +1,761 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file HttpFrontEnd.cpp
+ ** \~french
+ * \brief Implémentation de la classe HttpFrontEnd
+ ** \~english
+ * \brief Implement class HttpFrontEnd
+ */
+
+#include "HttpFrontEnd.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "intl.h"
+#include "config.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <strings.h>
+#include <time.h>
+
+// Taille du tampon du flux de sortie simulé
+#define HTTP_OUTPUT_BUFFER 65536
+// Taille maximale des en-têtes d'une requête
+#define HTTP_MAX_HEADERS 16384
+// Taille maximale du corps d'une requête (POST)
+#define HTTP_MAX_BODY 1048576
+// Nombre maximal d'événements traités par réveil de la boucle
+#define HTTP_MAX_EVENTS 256
+// Taille maximale de la réponse en attente d'écriture, au delà le thread de calcul attend que le client lise
+#define HTTP_MAX_PENDING_OUTPUT 262144
+// Durée maximale sans lecture par le client de sa réponse, en secondes
+#define HTTP_SEND_TIMEOUT 30
+
+/**
+ * \~french \brief Connexion HTTP d'un client
+ * \details Les champs de la première partie ne sont manipulés que par la boucle d'événements, ceux de la deuxième que par le thread de calcul traitant la requête en cours. La réponse à écrire est partagée et protégée par le mutex.
+ * \~english \brief Client HTTP connection
+ * \details First part fields are only handled by the event loop, second part ones only by the compute thread processing the current request. Response to write is shared and protected by the mutex.
+ */
+struct HttpConnection {
+    HttpFrontEnd* frontEnd;
+
+    // Boucle d'événements
+    int fd;
+    uint32_t events;
+    bool registered;
+    bool reading;
+    bool processing;
+    bool closeAfter;
+    bool closed;
+    time_t lastActivity;
+    std::string input;
+
+    // Thread de calcul
+    std::string body;
+    std::vector<std::string> env;
+    std::vector<char*> envp;
+    bool http11;
+    bool keepAlive;
+    bool headersDone;
+    bool chunked;
+    std::string cgiHeaders;
+    FCGX_Stream in;
+    FCGX_Stream out;
+    FCGX_Stream err;
+    unsigned char outBuffer[HTTP_OUTPUT_BUFFER];
+
+    // Partagé
+    pthread_mutex_t mutex;
+    pthread_cond_t drained;
+    std::string output;
+    size_t outputOffset;
+    bool finished;
+    bool broken;
+    bool queued;
+
+    HttpConnection ( HttpFrontEnd* f, int s ) : frontEnd ( f ), fd ( s ), events ( 0 ), registered ( false ), reading ( true ),
+        processing ( false ), closeAfter ( false ), closed ( false ), lastActivity ( time ( NULL ) ),
+        http11 ( true ), keepAlive ( true ), headersDone ( false ), chunked ( false ),
+        outputOffset ( 0 ), finished ( false ), broken ( false ), queued ( false ) {
+        pthread_mutex_init ( &mutex, NULL );
+        pthread_cond_init ( &drained, NULL );
+    }
+
+    ~HttpConnection() {
+        pthread_mutex_destroy ( &mutex );
+        pthread_cond_destroy ( &drained );
+    }
+};
+
+static const char* reasonPhrase ( int status ) {
+    switch ( status ) {
+    case 400 :
+        return "Bad Request";
+    case 405 :
+        return "Method Not Allowed";
+    case 411 :
+        return "Length Required";
+    case 413 :
+        return "Payload Too Large";
+    case 431 :
+        return "Request Header Fields Too Large";
+    case 505 :
+        return "HTTP Version Not Supported";
+    default :
+        return "Internal Server Error";
+    }
+}
+
+static std::string trim ( const std::string& s ) {
+    size_t b = s.find_first_not_of ( " \t" );
+    if ( b == std::string::npos ) return "";
+    size_t e = s.find_last_not_of ( " \t" );
+    return s.substr ( b, e - b + 1 );
+}
+
+HttpFrontEnd::HttpFrontEnd ( std::string address, int keepAlive ) : address ( address ), keepAlive ( keepAlive ),
+    listenFd ( -1 ), epollFd ( -1 ), wakeFd ( -1 ), stopping ( false ) {
+    pthread_mutex_init ( &jobsMutex, NULL );
+    pthread_cond_init ( &jobsCond, NULL );
+    pthread_mutex_init ( &readyMutex, NULL );
+}
+
+HttpFrontEnd::~HttpFrontEnd() {
+    for ( std::set<HttpConnection*>::iterator it = connections.begin(); it != connections.end(); it++ ) {
+        if ( ( *it )->fd >= 0 ) ::close ( ( *it )->fd );
+        delete *it;
+    }
+    connections.clear();
+    if ( listenFd >= 0 ) ::close ( listenFd );
+    if ( epollFd >= 0 ) ::close ( epollFd );
+    if ( wakeFd >= 0 ) ::close ( wakeFd );
+
+    pthread_mutex_destroy ( &jobsMutex );
+    pthread_cond_destroy ( &jobsCond );
+    pthread_mutex_destroy ( &readyMutex );
+}
+
+bool HttpFrontEnd::open ( int backlog ) {
+    struct sockaddr_in sa;
+    memset ( &sa, 0, sizeof ( sa ) );
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl ( INADDR_ANY );
+
+    size_t colon = address.rfind ( ':' );
+    std::string host = ( colon == std::string::npos ) ? "" : address.substr ( 0, colon );
+    int port = atoi ( address.substr ( colon == std::string::npos ? 0 : colon + 1 ).c_str() );
+    if ( port <= 0 || port > 65535 || ( ! host.empty() && inet_pton ( AF_INET, host.c_str(), &sa.sin_addr ) != 1 ) ) {
+        LOGGER_ERROR ( _ ( "Adresse d'ecoute HTTP invalide : " ) << address );
+        return false;
+    }
+    sa.sin_port = htons ( port );
+
+    listenFd = socket ( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    int on = 1;
+    setsockopt ( listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof ( on ) );
+    if ( listenFd < 0 || bind ( listenFd, ( struct sockaddr* ) &sa, sizeof ( sa ) ) != 0 || listen ( listenFd, backlog > 0 ? backlog : SOMAXCONN ) != 0 ) {
+        LOGGER_ERROR ( _ ( "Impossible d'ecouter en HTTP sur " ) << address << " : " << strerror ( errno ) );
+        return false;
+    }
+
+    epollFd = epoll_create1 ( EPOLL_CLOEXEC );
+    wakeFd = eventfd ( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if ( epollFd < 0 || wakeFd < 0 ) {
+        LOGGER_ERROR ( _ ( "Impossible d'initialiser la boucle d'evenements HTTP : " ) << strerror ( errno ) );
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listenFd;
+    epoll_ctl ( epollFd, EPOLL_CTL_ADD, listenFd, &ev );
+    ev.data.ptr = &wakeFd;
+    epoll_ctl ( epollFd, EPOLL_CTL_ADD, wakeFd, &ev );
+
+    LOGGER_INFO ( _ ( "Listening HTTP on " ) << address );
+    return true;
+}
+
+void HttpFrontEnd::start() {
+    pthread_create ( &loopThread, NULL, HttpFrontEnd::eventLoop, ( void* ) this );
+}
+
+void HttpFrontEnd::stop() {
+    pthread_mutex_lock ( &jobsMutex );
+    stopping = true;
+    pthread_cond_broadcast ( &jobsCond );
+    pthread_mutex_unlock ( &jobsMutex );
+
+    uint64_t one = 1;
+    if ( write ( wakeFd, &one, sizeof ( one ) ) < 0 ) {
+        LOGGER_ERROR ( _ ( "Impossible de reveiller la boucle d'evenements HTTP" ) );
+    }
+    pthread_join ( loopThread, NULL );
+
+    // Les threads de calcul attendant qu'un client lise leur réponse sont libérés
+    for ( std::set<HttpConnection*>::iterator it = connections.begin(); it != connections.end(); it++ ) {
+        pthread_mutex_lock ( & ( *it )->mutex );
+        ( *it )->broken = true;
+        pthread_cond_broadcast ( & ( *it )->drained );
+        pthread_mutex_unlock ( & ( *it )->mutex );
+    }
+}
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ----------------------------------- Boucle d'événements ----------------------------------------- */
+
+void* HttpFrontEnd::eventLoop ( void* arg ) {
+    HttpFrontEnd* fe = ( HttpFrontEnd* ) arg;
+    struct epoll_event events[HTTP_MAX_EVENTS];
+    time_t lastCheck = time ( NULL );
+
+    while ( ! fe->stopping ) {
+        int n = epoll_wait ( fe->epollFd, events, HTTP_MAX_EVENTS, 1000 );
+        if ( n < 0 && errno != EINTR ) {
+            LOGGER_ERROR ( _ ( "Erreur de la boucle d'evenements HTTP : " ) << strerror ( errno ) );
+            break;
+        }
+
+        for ( int i = 0; i < n; i++ ) {
+            if ( events[i].data.ptr == &fe->listenFd ) {
+                fe->acceptConnections();
+            } else if ( events[i].data.ptr == &fe->wakeFd ) {
+                uint64_t count;
+                while ( read ( fe->wakeFd, &count, sizeof ( count ) ) > 0 ) {}
+
+                std::vector<HttpConnection*> signaled;
+                pthread_mutex_lock ( &fe->readyMutex );
+                signaled.swap ( fe->ready );
+                for ( unsigned int j = 0; j < signaled.size(); j++ ) signaled.at ( j )->queued = false;
+                pthread_mutex_unlock ( &fe->readyMutex );
+
+                for ( unsigned int j = 0; j < signaled.size(); j++ ) {
+                    if ( ! signaled.at ( j )->closed ) fe->writeConnection ( signaled.at ( j ) );
+                }
+            } else {
+                HttpConnection* conn = ( HttpConnection* ) events[i].data.ptr;
+                if ( conn->closed ) continue;
+                if ( events[i].events & ( EPOLLERR | EPOLLHUP ) ) {
+                    fe->closeConnection ( conn );
+                    continue;
+                }
+                if ( events[i].events & EPOLLIN ) fe->readConnection ( conn );
+                if ( ( events[i].events & EPOLLOUT ) && ! conn->closed ) fe->writeConnection ( conn );
+            }
+        }
+
+        time_t now = time ( NULL );
+        if ( now != lastCheck ) {
+            fe->closeIdleConnections();
+            lastCheck = now;
+        }
+
+        // Les connexions fermées ne sont détruites qu'une fois tous les événements reçus traités
+        for ( std::set<HttpConnection*>::iterator it = fe->connections.begin(); it != fe->connections.end(); ) {
+            if ( ( *it )->closed ) {
+                delete *it;
+                fe->connections.erase ( it++ );
+            } else {
+                it++;
+            }
+        }
+        MetricsGauge* g = Metrics::getGauge ( "rok4_http_connections", "" );
+        if ( g ) g->set ( fe->connections.size() );
+    }
+
+    LOGGER_DEBUG ( _ ( "Extinction de la boucle d'evenements HTTP" ) );
+    return 0;
+}
+
+void HttpFrontEnd::acceptConnections() {
+    while ( true ) {
+        int fd = accept4 ( listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        if ( fd < 0 ) {
+            if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+                LOGGER_ERROR ( _ ( "Erreur a l'acceptation d'une connexion HTTP : " ) << strerror ( errno ) );
+            }
+            if ( errno == EINTR ) continue;
+            return;
+        }
+        int on = 1;
+        setsockopt ( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof ( on ) );
+
+        HttpConnection* conn = new HttpConnection ( this, fd );
+        connections.insert ( conn );
+        watch ( conn, false );
+    }
+}
+
+void HttpFrontEnd::watch ( HttpConnection* conn, bool writable ) {
+    uint32_t wanted = ( conn->reading ? EPOLLIN : 0 ) | ( writable ? EPOLLOUT : 0 );
+    if ( conn->registered && wanted == conn->events ) return;
+
+    struct epoll_event ev;
+    ev.events = wanted;
+    ev.data.ptr = conn;
+    epoll_ctl ( epollFd, conn->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, conn->fd, &ev );
+    conn->registered = true;
+    conn->events = wanted;
+}
+
+void HttpFrontEnd::readConnection ( HttpConnection* conn ) {
+    char buffer[16384];
+    bool peerClosed = false;
+    while ( true ) {
+        ssize_t n = recv ( conn->fd, buffer, sizeof ( buffer ), 0 );
+        if ( n > 0 ) {
+            conn->input.append ( buffer, n );
+            // Requêtes enchaînées en attente : on cesse de lire, le client attendra
+            if ( conn->input.size() > HTTP_MAX_HEADERS + HTTP_MAX_BODY ) break;
+        } else if ( n == 0 ) {
+            peerClosed = true;
+            break;
+        } else {
+            if ( errno == EINTR ) continue;
+            if ( errno != EAGAIN && errno != EWOULDBLOCK ) peerClosed = true;
+            break;
+        }
+    }
+    conn->lastActivity = time ( NULL );
+
+    if ( peerClosed ) {
+        closeConnection ( conn );
+        return;
+    }
+
+    if ( ! conn->processing ) {
+        dispatchRequest ( conn );
+    } else if ( conn->input.size() > HTTP_MAX_HEADERS + HTTP_MAX_BODY ) {
+        conn->reading = false;
+        watch ( conn, conn->events & EPOLLOUT );
+    }
+}
+
+void HttpFrontEnd::writeConnection ( HttpConnection* conn ) {
+    pthread_mutex_lock ( &conn->mutex );
+    size_t written = conn->outputOffset;
+    while ( ! conn->broken && conn->outputOffset < conn->output.size() ) {
+        ssize_t n = send ( conn->fd, conn->output.data() + conn->outputOffset, conn->output.size() - conn->outputOffset, MSG_NOSIGNAL );
+        if ( n > 0 ) {
+            conn->outputOffset += n;
+        } else if ( n < 0 && errno == EINTR ) {
+            continue;
+        } else {
+            if ( n == 0 || ( errno != EAGAIN && errno != EWOULDBLOCK ) ) conn->broken = true;
+            break;
+        }
+    }
+    bool pending = ! conn->broken && conn->outputOffset < conn->output.size();
+    if ( ! pending ) {
+        conn->output.clear();
+        conn->outputOffset = 0;
+    } else if ( conn->outputOffset > HTTP_MAX_PENDING_OUTPUT ) {
+        conn->output.erase ( 0, conn->outputOffset );
+        conn->outputOffset = 0;
+    }
+    // Le thread de calcul peut reprendre l'écriture de la réponse
+    if ( conn->broken || conn->outputOffset != written || ! pending ) pthread_cond_broadcast ( &conn->drained );
+    bool done = conn->finished && ! pending;
+    bool broken = conn->broken;
+    pthread_mutex_unlock ( &conn->mutex );
+
+    if ( done ) {
+        // Réponse entièrement écrite : la connexion revient à la boucle d'événements
+        conn->processing = false;
+        conn->finished = false;
+        if ( broken || conn->closeAfter ) {
+            closeConnection ( conn );
+            return;
+        }
+        conn->lastActivity = time ( NULL );
+        dispatchRequest ( conn );
+        return;
+    }
+
+    if ( broken ) {
+        closeConnection ( conn );
+        return;
+    }
+
+    if ( conn->registered ) watch ( conn, pending );
+}
+
+void HttpFrontEnd::closeConnection ( HttpConnection* conn ) {
+    if ( conn->registered ) {
+        epoll_ctl ( epollFd, EPOLL_CTL_DEL, conn->fd, NULL );
+        conn->registered = false;
+    }
+
+    if ( conn->processing ) {
+        // Un thread de calcul produit encore la réponse : elle sera ignorée, la connexion est détruite à la fin du traitement
+        pthread_mutex_lock ( &conn->mutex );
+        conn->broken = true;
+        pthread_cond_broadcast ( &conn->drained );
+        pthread_mutex_unlock ( &conn->mutex );
+        conn->closeAfter = true;
+        shutdown ( conn->fd, SHUT_RDWR );
+        return;
+    }
+
+    ::close ( conn->fd );
+    conn->fd = -1;
+    conn->closed = true;
+}
+
+void HttpFrontEnd::closeIdleConnections() {
+    time_t limit = time ( NULL ) - keepAlive;
+    for ( std::set<HttpConnection*>::iterator it = connections.begin(); it != connections.end(); it++ ) {
+        HttpConnection* conn = *it;
+        if ( ! conn->closed && ! conn->processing && conn->lastActivity < limit ) {
+            closeConnection ( conn );
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ------------------------------------- Analyse des requêtes -------------------------------------- */
+
+void HttpFrontEnd::dispatchRequest ( HttpConnection* conn ) {
+    int status = 0;
+    size_t headersEnd = conn->input.find ( "\r\n\r\n" );
+
+    if ( headersEnd == std::string::npos ) {
+        if ( conn->input.size() > HTTP_MAX_HEADERS ) status = 431;
+    }
+
+    std::string method, target, version, host, acceptEncoding;
+    size_t contentLength = 0;
+    bool closeRequested = false;
+
+    if ( status == 0 && headersEnd != std::string::npos ) {
+        std::string head = conn->input.substr ( 0, headersEnd );
+        size_t lineEnd = head.find ( "\r\n" );
+        std::string requestLine = head.substr ( 0, lineEnd );
+
+        size_t sp1 = requestLine.find ( ' ' );
+        size_t sp2 = ( sp1 == std::string::npos ) ? std::string::npos : requestLine.find ( ' ', sp1 + 1 );
+        if ( sp2 == std::string::npos ) {
+            status = 400;
+        } else {
+            method = requestLine.substr ( 0, sp1 );
+            target = requestLine.substr ( sp1 + 1, sp2 - sp1 - 1 );
+            version = requestLine.substr ( sp2 + 1 );
+            if ( version.compare ( 0, 7, "HTTP/1." ) != 0 ) status = 505;
+        }
+
+        while ( status == 0 && lineEnd != std::string::npos ) {
+            size_t next = head.find ( "\r\n", lineEnd + 2 );
+            std::string line = head.substr ( lineEnd + 2, next == std::string::npos ? std::string::npos : next - lineEnd - 2 );
+            lineEnd = next;
+
+            size_t colon = line.find ( ':' );
+            if ( colon == std::string::npos ) {
+                status = 400;
+                break;
+            }
+            std::string name = line.substr ( 0, colon );
+            std::string value = trim ( line.substr ( colon + 1 ) );
+
+            if ( strcasecmp ( name.c_str(), "Host" ) == 0 ) {
+                host = value;
+            } else if ( strcasecmp ( name.c_str(), "Accept-Encoding" ) == 0 ) {
+                acceptEncoding = value;
+            } else if ( strcasecmp ( name.c_str(), "Content-Length" ) == 0 ) {
+                char* endPtr;
+                contentLength = strtoul ( value.c_str(), &endPtr, 10 );
+                if ( value.empty() || *endPtr != '\0' ) status = 400;
+                else if ( contentLength > HTTP_MAX_BODY ) status = 413;
+            } else if ( strcasecmp ( name.c_str(), "Transfer-Encoding" ) == 0 ) {
+                // Corps de requête découpé : non géré
+                status = 411;
+            } else if ( strcasecmp ( name.c_str(), "Connection" ) == 0 ) {
+                closeRequested = ( strcasecmp ( value.c_str(), "close" ) == 0 );
+            }
+        }
+
+        if ( status == 0 && method != "GET" && method != "POST" ) status = 405;
+    }
+
+    if ( status != 0 ) {
+        // Réponse d'erreur directe, la connexion est fermée ensuite
+        char response[256];
+        snprintf ( response, sizeof ( response ), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n%sConnection: close\r\n\r\n",
+                   status, reasonPhrase ( status ), status == 405 ? "Allow: GET, POST\r\n" : "" );
+        conn->input.clear();
+        conn->reading = false;
+        conn->closeAfter = true;
+        conn->processing = true;
+        pthread_mutex_lock ( &conn->mutex );
+        conn->output.append ( response );
+        conn->finished = true;
+        pthread_mutex_unlock ( &conn->mutex );
+        writeConnection ( conn );
+        return;
+    }
+
+    if ( headersEnd == std::string::npos || conn->input.size() < headersEnd + 4 + contentLength ) {
+        // Requête incomplète
+        conn->reading = true;
+        watch ( conn, false );
+        return;
+    }
+
+    conn->body = conn->input.substr ( headersEnd + 4, contentLength );
+    conn->input.erase ( 0, headersEnd + 4 + contentLength );
+
+    // Cible sous forme absolue (mandataire) : seul le chemin est conservé
+    if ( target.compare ( 0, 7, "http://" ) == 0 || target.compare ( 0, 8, "https://" ) == 0 ) {
+        size_t pathStart = target.find ( '/', target.find ( "//" ) + 2 );
+        target = ( pathStart == std::string::npos ) ? "/" : target.substr ( pathStart );
+    }
+    size_t question = target.find ( '?' );
+
+    conn->env.clear();
+    conn->env.push_back ( "REQUEST_METHOD=" + method );
+    conn->env.push_back ( "SCRIPT_NAME=" + target.substr ( 0, question ) );
+    conn->env.push_back ( "QUERY_STRING=" + ( question == std::string::npos ? std::string ( "" ) : target.substr ( question + 1 ) ) );
+    conn->env.push_back ( "SERVER_PROTOCOL=" + version );
+    if ( ! host.empty() ) conn->env.push_back ( "HTTP_HOST=" + host );
+    if ( ! acceptEncoding.empty() ) conn->env.push_back ( "HTTP_ACCEPT_ENCODING=" + acceptEncoding );
+    conn->envp.clear();
+    for ( unsigned int i = 0; i < conn->env.size(); i++ ) conn->envp.push_back ( ( char* ) conn->env.at ( i ).c_str() );
+    conn->envp.push_back ( NULL );
+
+    // HTTP/1.0 : ni connexion persistante ni encodage "chunked", la fin de la réponse est signalée par la fermeture
+    conn->http11 = ( version == "HTTP/1.1" );
+    conn->closeAfter = closeRequested || ! conn->http11;
+    conn->keepAlive = ! conn->closeAfter;
+    conn->headersDone = false;
+    conn->chunked = false;
+    conn->cgiHeaders.clear();
+
+    memset ( &conn->in, 0, sizeof ( FCGX_Stream ) );
+    conn->in.rdNext = conn->in.stopUnget = ( unsigned char* ) conn->body.data();
+    conn->in.stop = conn->in.rdNext + conn->body.size();
+    conn->in.isReader = 1;
+    conn->in.fillBuffProc = HttpFrontEnd::fillInput;
+    conn->in.data = conn;
+
+    memset ( &conn->out, 0, sizeof ( FCGX_Stream ) );
+    conn->out.wrNext = conn->outBuffer;
+    conn->out.stop = conn->outBuffer + HTTP_OUTPUT_BUFFER;
+    conn->out.emptyBuffProc = HttpFrontEnd::emptyOutput;
+    conn->out.data = conn;
+
+    // Flux d'erreur : toute écriture échoue
+    memset ( &conn->err, 0, sizeof ( FCGX_Stream ) );
+    conn->err.isClosed = 1;
+
+    conn->processing = true;
+    // Pas de nouvelle lecture avant la fin de la réponse, sauf pour détecter la fermeture par le client
+    conn->reading = conn->input.size() <= HTTP_MAX_HEADERS + HTTP_MAX_BODY;
+    watch ( conn, false );
+
+    pthread_mutex_lock ( &jobsMutex );
+    jobs.push_back ( conn );
+    pthread_cond_signal ( &jobsCond );
+    pthread_mutex_unlock ( &jobsMutex );
+
+    Metrics::count ( "rok4_http_requests_total", "" );
+}
+
+/* ------------------------------------------------------------------------------------------------ */
+/* --------------------------------------- Threads de calcul --------------------------------------- */
+
+HttpConnection* HttpFrontEnd::nextRequest ( FCGX_Request& fcgxRequest ) {
+    pthread_mutex_lock ( &jobsMutex );
+    while ( jobs.empty() && ! stopping ) {
+        pthread_cond_wait ( &jobsCond, &jobsMutex );
+    }
+    HttpConnection* conn = NULL;
+    if ( ! stopping ) {
+        conn = jobs.front();
+        jobs.pop_front();
+    }
+    pthread_mutex_unlock ( &jobsMutex );
+
+    if ( conn ) {
+        memset ( &fcgxRequest, 0, sizeof ( FCGX_Request ) );
+        fcgxRequest.in = &conn->in;
+        fcgxRequest.out = &conn->out;
+        fcgxRequest.err = &conn->err;
+        fcgxRequest.envp = &conn->envp[0];
+        fcgxRequest.ipcFd = -1;
+        fcgxRequest.listen_sock = -1;
+    }
+    return conn;
+}
+
+void HttpFrontEnd::finishRequest ( HttpConnection* conn ) {
+    emptyOutput ( &conn->out, 1 );
+
+    pthread_mutex_lock ( &conn->mutex );
+    conn->finished = true;
+    pthread_mutex_unlock ( &conn->mutex );
+
+    notify ( conn );
+}
+
+void HttpFrontEnd::notify ( HttpConnection* conn ) {
+    bool wake = false;
+    pthread_mutex_lock ( &readyMutex );
+    if ( ! conn->queued ) {
+        conn->queued = true;
+        wake = ready.empty();
+        ready.push_back ( conn );
+    }
+    pthread_mutex_unlock ( &readyMutex );
+
+    if ( wake ) {
+        uint64_t one = 1;
+        if ( write ( wakeFd, &one, sizeof ( one ) ) < 0 ) {
+            LOGGER_ERROR ( _ ( "Impossible de reveiller la boucle d'evenements HTTP" ) );
+        }
+    }
+}
+
+void HttpFrontEnd::fillInput ( FCGX_Stream* stream ) {
+    stream->isClosed = 1;
+}
+
+void HttpFrontEnd::emptyOutput ( FCGX_Stream* stream, int doClose ) {
+    HttpConnection* conn = ( HttpConnection* ) stream->data;
+    std::string chunk ( ( char* ) conn->outBuffer, stream->wrNext - conn->outBuffer );
+    stream->wrNext = conn->outBuffer;
+
+    std::string bytes;
+    if ( ! conn->headersDone ) {
+        conn->cgiHeaders.append ( chunk );
+        chunk.clear();
+        size_t end = conn->cgiHeaders.find ( "\r\n\r\n" );
+        if ( end == std::string::npos && ! doClose ) return;
+
+        // En-têtes CGI : "Status" devient la ligne de statut, les autres sont recopiés
+        std::string status = "200 OK";
+        std::string headers;
+        bool hasLength = false;
+        std::string cgi = ( end == std::string::npos ) ? "" : conn->cgiHeaders.substr ( 0, end + 2 );
+        size_t pos = 0;
+        while ( pos < cgi.size() ) {
+            size_t eol = cgi.find ( "\r\n", pos );
+            std::string line = cgi.substr ( pos, eol - pos );
+            pos = eol + 2;
+            if ( strncasecmp ( line.c_str(), "Status:", 7 ) == 0 ) {
+                status = trim ( line.substr ( 7 ) );
+                continue;
+            }
+            if ( strncasecmp ( line.c_str(), "Content-Length:", 15 ) == 0 ) hasLength = true;
+            headers.append ( line ).append ( "\r\n" );
+        }
+        if ( end == std::string::npos ) {
+            // Aucune réponse complète produite
+            status = "500 Internal Server Error";
+            headers = "Content-Length: 0\r\n";
+            hasLength = true;
+        } else {
+            chunk = conn->cgiHeaders.substr ( end + 4 );
+        }
+        conn->cgiHeaders.clear();
+
+        conn->chunked = ! hasLength && conn->http11;
+        bytes.append ( conn->http11 ? "HTTP/1.1 " : "HTTP/1.0 " ).append ( status ).append ( "\r\n" ).append ( headers );
+        if ( conn->chunked ) bytes.append ( "Transfer-Encoding: chunked\r\n" );
+        bytes.append ( ( conn->keepAlive && ( hasLength || conn->chunked ) ) ? "Connection: keep-alive\r\n" : "Connection: close\r\n" );
+        bytes.append ( "\r\n" );
+        conn->headersDone = true;
+    }
+
+    if ( ! chunk.empty() ) {
+        if ( conn->chunked ) {
+            char size[32];
+            snprintf ( size, sizeof ( size ), "%lx\r\n", ( unsigned long ) chunk.size() );
+            bytes.append ( size ).append ( chunk ).append ( "\r\n" );
+        } else {
+            bytes.append ( chunk );
+        }
+    }
+    if ( doClose && conn->chunked ) bytes.append ( "0\r\n\r\n" );
+
+    if ( bytes.empty() ) return;
+
+    pthread_mutex_lock ( &conn->mutex );
+    bool broken = conn->broken;
+    if ( ! broken ) conn->output.append ( bytes );
+    pthread_mutex_unlock ( &conn->mutex );
+
+    if ( broken ) {
+        // Le client est parti : inutile de poursuivre la réponse
+        stream->isClosed = 1;
+        return;
+    }
+    if ( doClose ) return;
+
+    conn->frontEnd->notify ( conn );
+
+    // Contre-pression : la réponse n'est pas accumulée en mémoire au delà de HTTP_MAX_PENDING_OUTPUT octets,
+    // on attend que la boucle d'événements en ait écrit une partie
+    pthread_mutex_lock ( &conn->mutex );
+    while ( ! conn->broken && conn->output.size() - conn->outputOffset > HTTP_MAX_PENDING_OUTPUT ) {
+        size_t pending = conn->output.size() - conn->outputOffset;
+        struct timespec deadline;
+        clock_gettime ( CLOCK_REALTIME, &deadline );
+        deadline.tv_sec += HTTP_SEND_TIMEOUT;
+        if ( pthread_cond_timedwait ( &conn->drained, &conn->mutex, &deadline ) == ETIMEDOUT &&
+             conn->output.size() - conn->outputOffset >= pending ) {
+            LOGGER_WARN ( _ ( "Le client HTTP ne lit plus la reponse depuis " ) << HTTP_SEND_TIMEOUT << " s, abandon" );
+            conn->broken = true;
+        }
+    }
+    broken = conn->broken;
+    pthread_mutex_unlock ( &conn->mutex );
+
+    if ( broken ) stream->isClosed = 1;
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file HttpFrontEnd.h
+ ** \~french
+ * \brief Définition de la classe HttpFrontEnd
+ ** \~english
+ * \brief Define class HttpFrontEnd
+ */
+
+#ifndef HTTPFRONTEND_H
+#define HTTPFRONTEND_H
+
+#include <pthread.h>
+#include <string>
+#include <deque>
+#include <set>
+#include <vector>
+#include "fcgiapp.h"
+
+struct HttpConnection;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Frontal HTTP/1.1 piloté par les événements
+ * \details Un unique thread gère toutes les connexions avec epoll : acceptation, lecture et analyse des requêtes, écriture des réponses et conservation des connexions inactives (keep-alive). Les threads de calcul ne reçoivent que des requêtes complètes et la réponse est écrite au fil de sa production : de nombreux clients peuvent ainsi être servis par peu de threads. Un thread de calcul n'attend un client lent que lorsque trop d'octets de sa réponse sont en attente d'écriture, et l'abandonne s'il ne lit plus rien.
+ *
+ * Pour le thread de calcul, une requête se présente comme une requête FastCGI : les variables d'environnement (QUERY_STRING, SCRIPT_NAME, HTTP_HOST, REQUEST_METHOD) et les flux d'entrée et de sortie sont simulés. Les octets écrits sur le flux de sortie sont convertis en réponse HTTP/1.1 (ligne de statut à partir de l'en-tête CGI "Status", encodage "chunked" en l'absence de taille connue) et confiés à la boucle d'événements.
+ *
+ * Une seule requête est traitée à la fois par connexion, les requêtes enchaînées (pipelining) sont conservées jusqu'à la fin de la précédente.
+ * \~english
+ * \brief Event-driven HTTP/1.1 front end
+ * \details A single thread handles all connections with epoll : accept, requests read and parsing, responses write and idle connections keeping (keep-alive). Compute threads receive only complete requests and the response is written as it is produced : many clients can be served with few threads. A compute thread waits for a slow client only when too many bytes of its response are waiting to be written, and gives up if the client stops reading.
+ *
+ * For the compute thread, a request looks like a FastCGI one : environment variables (QUERY_STRING, SCRIPT_NAME, HTTP_HOST, REQUEST_METHOD) and input and output streams are simulated. Bytes written in the output stream are converted into an HTTP/1.1 response (status line from CGI header "Status", "chunked" encoding when size is unknown) and handed to the event loop.
+ *
+ * Only one request is processed at a time for a connection, pipelined requests are kept until the end of the previous one.
+ */
+class HttpFrontEnd {
+
+private:
+
+    /**
+     * \~french \brief Adresse d'écoute, "[ip]:port"
+     * \~english \brief Listening address, "[ip]:port"
+     */
+    std::string address;
+
+    /**
+     * \~french \brief Durée de conservation d'une connexion inactive, en secondes
+     * \~english \brief Idle connection keeping time, in seconds
+     */
+    int keepAlive;
+
+    /**
+     * \~french \brief Socket d'écoute
+     * \~english \brief Listening socket
+     */
+    int listenFd;
+
+    /**
+     * \~french \brief Descripteur epoll
+     * \~english \brief Epoll descriptor
+     */
+    int epollFd;
+
+    /**
+     * \~french \brief Descripteur eventfd réveillant la boucle d'événements
+     * \~english \brief Eventfd descriptor waking up the event loop
+     */
+    int wakeFd;
+
+    /**
+     * \~french \brief Thread de la boucle d'événements
+     * \~english \brief Event loop thread
+     */
+    pthread_t loopThread;
+
+    /**
+     * \~french \brief Demande d'arrêt
+     * \~english \brief Stop request
+     */
+    volatile bool stopping;
+
+    /**
+     * \~french \brief Connexions ouvertes, manipulées par la seule boucle d'événements
+     * \~english \brief Opened connections, handled only by the event loop
+     */
+    std::set<HttpConnection*> connections;
+
+    /**
+     * \~french \brief Protège la file des requêtes à traiter
+     * \~english \brief Protect the queue of requests to process
+     */
+    pthread_mutex_t jobsMutex;
+
+    /**
+     * \~french \brief Signale une requête à traiter ou l'arrêt
+     * \~english \brief Signal a request to process or the stop
+     */
+    pthread_cond_t jobsCond;
+
+    /**
+     * \~french \brief Connexions dont la requête est complète, en attente d'un thread de calcul
+     * \~english \brief Connections with a complete request, waiting for a compute thread
+     */
+    std::deque<HttpConnection*> jobs;
+
+    /**
+     * \~french \brief Protège la liste des connexions ayant une réponse à écrire
+     * \~english \brief Protect the list of connections with a response to write
+     */
+    pthread_mutex_t readyMutex;
+
+    /**
+     * \~french \brief Connexions ayant une réponse à écrire, signalées par les threads de calcul
+     * \~english \brief Connections with a response to write, signaled by compute threads
+     */
+    std::vector<HttpConnection*> ready;
+
+    /**
+     * \~french \brief Boucle d'événements
+     * \~english \brief Event loop
+     */
+    static void* eventLoop ( void* arg );
+
+    void acceptConnections();
+    void readConnection ( HttpConnection* conn );
+    void writeConnection ( HttpConnection* conn );
+    void closeConnection ( HttpConnection* conn );
+    void closeIdleConnections();
+
+    /**
+     * \~french
+     * \brief Analyse la prochaine requête reçue sur la connexion et la confie aux threads de calcul si elle est complète
+     * \details Une requête invalide reçoit directement une réponse d'erreur et la connexion est fermée
+     * \~english
+     * \brief Parse the next request received on the connection and give it to compute threads if it is complete
+     * \details An invalid request directly receives an error response and the connection is closed
+     */
+    void dispatchRequest ( HttpConnection* conn );
+
+    /**
+     * \~french \brief Met à jour les événements surveillés pour la connexion
+     * \~english \brief Update watched events for the connection
+     */
+    void watch ( HttpConnection* conn, bool writable );
+
+    /**
+     * \~french \brief Signale une réponse à écrire à la boucle d'événements, appelé par les threads de calcul
+     * \~english \brief Signal a response to write to the event loop, called by compute threads
+     */
+    void notify ( HttpConnection* conn );
+
+    /**
+     * \~french \brief Vidage du flux de sortie simulé : conversion de la réponse CGI en réponse HTTP
+     * \~english \brief Simulated output stream flush : CGI response conversion to HTTP response
+     */
+    static void emptyOutput ( FCGX_Stream* stream, int doClose );
+
+    /**
+     * \~french \brief Remplissage du flux d'entrée simulé : le corps de la requête est entièrement présent dès le départ
+     * \~english \brief Simulated input stream fill : request body is wholly present from the start
+     */
+    static void fillInput ( FCGX_Stream* stream );
+
+public:
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] address adresse d'écoute, "[ip]:port"
+     * \param[in] keepAlive durée de conservation d'une connexion inactive, en secondes
+     * \~english
+     * \brief Constructor
+     * \param[in] address listening address, "[ip]:port"
+     * \param[in] keepAlive idle connection keeping time, in seconds
+     */
+    HttpFrontEnd ( std::string address, int keepAlive );
+
+    /**
+     * \~french \brief Destructeur, ferme toutes les connexions
+     * \details Les threads de calcul et la boucle d'événements doivent être arrêtés
+     * \~english \brief Destructor, close all connections
+     * \details Compute threads and event loop have to be stopped
+     */
+    ~HttpFrontEnd();
+
+    /**
+     * \~french
+     * \brief Ouvre le socket d'écoute
+     * \param[in] backlog profondeur de la file d'attente du socket
+     * \return false en cas d'échec
+     * \~english
+     * \brief Open the listening socket
+     * \param[in] backlog socket listen queue depth
+     * \return false if failure
+     */
+    bool open ( int backlog );
+
+    /**
+     * \~french \brief Lance la boucle d'événements
+     * \~english \brief Start the event loop
+     */
+    void start();
+
+    /**
+     * \~french \brief Arrête la boucle d'événements et réveille les threads de calcul en attente
+     * \~english \brief Stop the event loop and wake up waiting compute threads
+     */
+    void stop();
+
+    /**
+     * \~french
+     * \brief Attend la prochaine requête à traiter
+     * \details La requête FastCGI simulée reste valide jusqu'à l'appel à #finishRequest
+     * \param[out] fcgxRequest requête FastCGI simulée
+     * \return la connexion de la requête, NULL si le frontal est arrêté
+     * \~english
+     * \brief Wait for the next request to process
+     * \details Simulated FastCGI request stays valid until #finishRequest call
+     * \param[out] fcgxRequest simulated FastCGI request
+     * \return the request's connection, NULL if front end is stopped
+     */
+    HttpConnection* nextRequest ( FCGX_Request& fcgxRequest );
+
+    /**
+     * \~french
+     * \brief Termine la réponse et rend la connexion à la boucle d'événements
+     * \details Ni la requête FastCGI simulée ni la connexion ne doivent être utilisées ensuite
+     * \~english
+     * \brief End the response and give the connection back to the event loop
+     * \details Neither the simulated FastCGI request nor the connection have to be used after
+     */
+    void finishRequest ( HttpConnection* conn );
+};
+
+#endif // HTTPFRONTEND_H
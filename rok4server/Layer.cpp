@@ -46,11 +46,20 @@
 #include "Layer.h"
 #include "Pyramid.h"
 #include "Logger.h"
+#include "config.h"
+#include <algorithm>
 
 GeographicBoundingBoxWMS::GeographicBoundingBoxWMS() {}
 BoundingBoxWMS::BoundingBoxWMS() {}
 
 Layer::Layer ( const LayerXML& l ) {
+    pthread_mutex_init ( &emptyResponsesMutex, NULL );
+    metatileSize = 1;
+    metatileCacheSize = 0;
+    metatileCache = NULL;
+    transcodingCacheSize = 0;
+    transcodingCache = NULL;
+
     this->id = l.id;
     this->title = l.title;
     this->abstract = l.abstract;
@@ -90,14 +99,37 @@ Layer::Layer ( const LayerXML& l ) {
         this->GFIForceEPSG = l.GFIForceEPSG;
         this->resampling = l.resampling;
 
+        this->metatileSize = l.metatileSize;
+        this->metatileCacheSize = l.metatileCacheSize;
+
+        this->transcodingFormats = l.transcodingFormats;
+        this->transcodingCacheSize = l.transcodingCacheSize;
+
+        this->jpegOptions = l.jpegOptions;
+
     } else {
         // Une pyramide vecteur n'est diffusée qu'en WMTS et TMS et le GFI n'est pas possible
         this->WMSAuthorized = false;
         this->getFeatureInfoAvailability = false;
     }
+
+    if ( metatileSize > 1 ) {
+        metatileCache = new TileCache ( metatileCacheSize );
+    }
+    if ( ! transcodingFormats.empty() ) {
+        transcodingCache = new TileCache ( transcodingCacheSize );
+    }
 }
 
 Layer::Layer (Layer* obj, ServerXML* sxml) {
+    // Les réponses sans donnée, les tuiles des métatuiles et les tuiles transcodées ne sont pas reprises : le niveau ou le style a pu changer
+    pthread_mutex_init ( &emptyResponsesMutex, NULL );
+    metatileSize = 1;
+    metatileCacheSize = 0;
+    metatileCache = NULL;
+    transcodingCacheSize = 0;
+    transcodingCache = NULL;
+
     id = obj->id;
     title = obj->title;
     abstract = obj->abstract;
@@ -131,6 +163,20 @@ Layer::Layer (Layer* obj, ServerXML* sxml) {
         WMSCRSList = obj->WMSCRSList;
         resampling = obj->resampling;
 
+        metatileSize = obj->metatileSize;
+        metatileCacheSize = obj->metatileCacheSize;
+        if ( metatileSize > 1 ) {
+            metatileCache = new TileCache ( metatileCacheSize );
+        }
+
+        transcodingFormats = obj->transcodingFormats;
+        transcodingCacheSize = obj->transcodingCacheSize;
+        if ( ! transcodingFormats.empty() ) {
+            transcodingCache = new TileCache ( transcodingCacheSize );
+        }
+
+        jpegOptions = obj->jpegOptions;
+
         getFeatureInfoAvailability = obj->getFeatureInfoAvailability;
         getFeatureInfoType = obj->getFeatureInfoType;
         getFeatureInfoBaseURL = obj->getFeatureInfoBaseURL;
@@ -167,9 +213,56 @@ std::string Layer::getId() {
     return id;
 }
 
+bool Layer::getEmptyResponse ( std::string key, std::string& type, std::string& data ) {
+    pthread_mutex_lock ( &emptyResponsesMutex );
+    std::map<std::string, std::pair<std::string, std::string> >::iterator it = emptyResponses.find ( key );
+    bool found = ( it != emptyResponses.end() );
+    if ( found ) {
+        type = it->second.first;
+        data = it->second.second;
+    }
+    pthread_mutex_unlock ( &emptyResponsesMutex );
+    return found;
+}
+
+void Layer::addEmptyResponse ( std::string key, std::string type, std::string data ) {
+    pthread_mutex_lock ( &emptyResponsesMutex );
+    if ( emptyResponses.size() < MAX_EMPTY_RESPONSES ) {
+        emptyResponses.insert ( std::make_pair ( key, std::make_pair ( type, data ) ) );
+    }
+    pthread_mutex_unlock ( &emptyResponsesMutex );
+}
+
+int Layer::getMetatileSize() {
+    return metatileSize;
+}
+
+TileCache* Layer::getMetatileCache() {
+    return metatileCache;
+}
+
+std::vector<std::string> Layer::getTranscodingFormats() {
+    return transcodingFormats;
+}
+
+bool Layer::isTranscodingFormat ( std::string format ) {
+    return std::find ( transcodingFormats.begin(), transcodingFormats.end(), format ) != transcodingFormats.end();
+}
+
+TileCache* Layer::getTranscodingCache() {
+    return transcodingCache;
+}
+
+JpegOptions Layer::getJpegOptions() {
+    return jpegOptions;
+}
+
 Layer::~Layer() {
 
     delete dataPyramid;
+    delete metatileCache;
+    delete transcodingCache;
+    pthread_mutex_destroy ( &emptyResponsesMutex );
 }
 
 
@@ -50,6 +50,8 @@ class Layer;
 
 #include <vector>
 #include <string>
+#include <map>
+#include <pthread.h>
 #include "Pyramid.h"
 #include "CRS.h"
 #include "Style.h"
@@ -57,6 +59,8 @@ class Layer;
 #include "Interpolation.h"
 #include "Keyword.h"
 #include "BoundingBox.h"
+#include "TileCache.h"
+#include "JpegOptions.h"
 
 #include "LayerXML.h"
 
@@ -116,6 +120,11 @@ class Layer;
  *     <maxRes>209715.2</maxRes>
  *     <authority>IGNF</authority>
  *     <resampling>lanczos_4</resampling>
+ *     <metatile size="4" cacheSize="64"/>
+ *     <transcoding cacheSize="64">
+ *         <format>image/png</format>
+ *     </transcoding>
+ *     <jpeg quality="85" subsampling="4:2:0" dct="ifast" optimize="false"/>
  *     <pyramid>../pyramids/SCAN1000_JPG_LAMB93_FXX.pyr</pyramid>
  * </layer>
  * \endcode
@@ -265,6 +274,60 @@ private:
      */
     bool GFIForceEPSG;
 
+    /**
+     * \~french \brief Réponses encodées des images sans donnée (type MIME et contenu), par clé (style, format, dimensions...)
+     * \~english \brief Encoded responses of images without data (MIME type and content), by key (style, format, dimensions...)
+     */
+    std::map<std::string, std::pair<std::string, std::string> > emptyResponses;
+
+    /**
+     * \~french \brief Protège les réponses sans donnée
+     * \~english \brief Protect responses without data
+     */
+    pthread_mutex_t emptyResponsesMutex;
+
+    /**
+     * \~french \brief Nombre de tuiles par côté des métatuiles calculées pour les niveaux à la demande (1 si désactivé)
+     * \~english \brief Tiles number per side of metatiles computed for on demand levels (1 if disabled)
+     */
+    int metatileSize;
+
+    /**
+     * \~french \brief Taille maximale du cache des tuiles issues des métatuiles, en octets
+     * \~english \brief Maximal size of the cache of tiles from metatiles, in bytes
+     */
+    size_t metatileCacheSize;
+
+    /**
+     * \~french \brief Cache des tuiles issues des métatuiles, NULL si les métatuiles sont désactivées
+     * \~english \brief Cache of tiles from metatiles, NULL if metatiles are disabled
+     */
+    TileCache* metatileCache;
+
+    /**
+     * \~french \brief Formats (type MIME) de diffusion des tuiles en WMTS et TMS, en plus de celui de la pyramide
+     * \~english \brief Tiles' output formats (MIME type) in WMTS and TMS, in addition to the pyramid's one
+     */
+    std::vector<std::string> transcodingFormats;
+
+    /**
+     * \~french \brief Taille maximale du cache des tuiles transcodées, en octets
+     * \~english \brief Maximal size of the cache of transcoded tiles, in bytes
+     */
+    size_t transcodingCacheSize;
+
+    /**
+     * \~french \brief Cache des tuiles transcodées, NULL si aucun format supplémentaire n'est proposé
+     * \~english \brief Cache of transcoded tiles, NULL if no additional format is available
+     */
+    TileCache* transcodingCache;
+
+    /**
+     * \~french \brief Paramètres de la compression des images et tuiles diffusées en JPEG
+     * \~english \brief Compression parameters of images and tiles served in JPEG
+     */
+    JpegOptions jpegOptions;
+
 public:
     /**
     * \~french
@@ -593,6 +656,82 @@ public:
      * \return
      */
     bool getGFIForceEPSG() ;
+
+    /**
+     * \~french
+     * \brief Recherche une réponse sans donnée déjà encodée
+     * \param[in] key clé de la réponse, décrivant tout ce dont dépend son contenu
+     * \param[out] type type MIME de la réponse
+     * \param[out] data contenu de la réponse
+     * \return true si la réponse est connue
+     * \~english
+     * \brief Look for an already encoded response without data
+     * \param[in] key response key, describing everything its content depends on
+     * \param[out] type response MIME type
+     * \param[out] data response content
+     * \return true if response is known
+     */
+    bool getEmptyResponse ( std::string key, std::string& type, std::string& data ) ;
+
+    /**
+     * \~french
+     * \brief Conserve une réponse sans donnée encodée
+     * \details Au delà de MAX_EMPTY_RESPONSES réponses, les nouvelles ne sont plus conservées
+     * \~english
+     * \brief Keep an encoded response without data
+     * \details Beyond MAX_EMPTY_RESPONSES responses, new ones are not kept
+     */
+    void addEmptyResponse ( std::string key, std::string type, std::string data ) ;
+
+    /**
+     * \~french
+     * \brief Retourne le nombre de tuiles par côté des métatuiles (1 si désactivé)
+     * \~english
+     * \brief Return tiles number per side of metatiles (1 if disabled)
+     */
+    int getMetatileSize() ;
+
+    /**
+     * \~french
+     * \brief Retourne le cache des tuiles issues des métatuiles, NULL si les métatuiles sont désactivées
+     * \~english
+     * \brief Return the cache of tiles from metatiles, NULL if metatiles are disabled
+     */
+    TileCache* getMetatileCache() ;
+
+    /**
+     * \~french
+     * \brief Retourne les formats de diffusion des tuiles en plus de celui de la pyramide
+     * \~english
+     * \brief Return tiles' output formats in addition to the pyramid's one
+     */
+    std::vector<std::string> getTranscodingFormats() ;
+
+    /**
+     * \~french
+     * \brief Le format est-il un format de diffusion des tuiles autre que celui de la pyramide
+     * \param[in] format type MIME
+     * \~english
+     * \brief Is the format a tiles' output format other than the pyramid's one
+     * \param[in] format MIME type
+     */
+    bool isTranscodingFormat ( std::string format ) ;
+
+    /**
+     * \~french
+     * \brief Retourne le cache des tuiles transcodées, NULL si aucun format supplémentaire n'est proposé
+     * \~english
+     * \brief Return the cache of transcoded tiles, NULL if no additional format is available
+     */
+    TileCache* getTranscodingCache() ;
+
+    /**
+     * \~french
+     * \brief Retourne les paramètres de la compression des images calculées en JPEG
+     * \~english
+     * \brief Return compression parameters of images computed in JPEG
+     */
+    JpegOptions getJpegOptions() ;
     /**
      * \~french
      * \brief Destructeur par défaut
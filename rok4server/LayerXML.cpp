@@ -38,6 +38,7 @@
 #include "LayerXML.h"
 
 #include <libgen.h>
+#include <algorithm>
 
 LayerXML::LayerXML(std::string path, ServerXML* serverXML, ServicesXML* servicesXML ) : DocumentXML ( path )
 {
@@ -76,6 +77,10 @@ LayerXML::LayerXML(std::string path, ServerXML* serverXML, ServicesXML* services
     GFILayers = "";
     GFIForceEPSG = true;
 
+    metatileSize = 1;
+    metatileCacheSize = ( size_t ) DEFAULT_METATILE_CACHE_SIZE * 1024 * 1024;
+    transcodingCacheSize = ( size_t ) DEFAULT_TRANSCODING_CACHE_SIZE * 1024 * 1024;
+
     /********************** Parse */
 
     TiXmlHandle hDoc ( &doc );
@@ -495,6 +500,75 @@ LayerXML::LayerXML(std::string path, ServerXML* serverXML, ServicesXML* services
             resamplingStr = DocumentXML::getTextStrFromElem(pElem);
         }
         resampling = Interpolation::fromString ( resamplingStr );
+
+        pElem=hRoot.FirstChild ( "metatile" ).Element();
+        if ( pElem ) {
+            if ( pElem->QueryIntAttribute ( "size", &metatileSize ) != TIXML_SUCCESS || metatileSize < 1 || metatileSize > MAX_METATILE_SIZE ) {
+                LOGGER_ERROR ( _ ( "La taille des metatuiles doit etre un entier entre 1 et " ) << MAX_METATILE_SIZE );
+                return;
+            }
+            int cacheSize;
+            if ( pElem->QueryIntAttribute ( "cacheSize", &cacheSize ) == TIXML_SUCCESS ) {
+                if ( cacheSize < 0 ) {
+                    LOGGER_ERROR ( _ ( "La taille du cache des metatuiles (en Mo) doit etre positive" ) );
+                    return;
+                }
+                metatileCacheSize = ( size_t ) cacheSize * 1024 * 1024;
+            }
+            if ( metatileSize > 1 && ! pyramid->getContainOdLevels() ) {
+                LOGGER_WARN ( _ ( "Metatuiles inutiles pour la couche " ) << id << _ ( " : sa pyramide n'a pas de niveau a la demande" ) );
+            }
+        }
+
+        pElem=hRoot.FirstChild ( "transcoding" ).Element();
+        if ( pElem ) {
+            int cacheSize;
+            if ( pElem->QueryIntAttribute ( "cacheSize", &cacheSize ) == TIXML_SUCCESS ) {
+                if ( cacheSize < 0 ) {
+                    LOGGER_ERROR ( _ ( "La taille du cache des tuiles transcodees (en Mo) doit etre positive" ) );
+                    return;
+                }
+                transcodingCacheSize = ( size_t ) cacheSize * 1024 * 1024;
+            }
+            std::string nativeFormat = Rok4Format::toMimeType ( pyramid->getFormat() );
+            for ( TiXmlElement* pFormat = pElem->FirstChildElement ( "format" ); pFormat; pFormat = pFormat->NextSiblingElement ( "format" ) ) {
+                if ( ! ( pFormat->GetText() ) ) continue;
+                std::string format = DocumentXML::getTextStrFromElem ( pFormat );
+                if ( ! servicesXML->isInFormatList ( format ) ) {
+                    LOGGER_ERROR ( _ ( "Le format de transcodage " ) << format << _ ( " n'est pas un format du service" ) );
+                    return;
+                }
+                if ( format == nativeFormat || std::find ( transcodingFormats.begin(), transcodingFormats.end(), format ) != transcodingFormats.end() ) {
+                    LOGGER_WARN ( _ ( "Format de transcodage " ) << format << _ ( " ignore pour la couche " ) << id << _ ( " : deja diffuse" ) );
+                    continue;
+                }
+                transcodingFormats.push_back ( format );
+            }
+        }
+
+        pElem=hRoot.FirstChild ( "jpeg" ).Element();
+        if ( pElem ) {
+            int quality;
+            int queryResult = pElem->QueryIntAttribute ( "quality", &quality );
+            if ( queryResult == TIXML_WRONG_TYPE || ( queryResult == TIXML_SUCCESS && ! jpegOptions.setQuality ( quality ) ) ) {
+                LOGGER_ERROR ( _ ( "La qualite JPEG doit etre un entier entre 1 et 100" ) );
+                return;
+            }
+            const char* subsampling = pElem->Attribute ( "subsampling" );
+            if ( subsampling && ! jpegOptions.setSubsampling ( subsampling ) ) {
+                LOGGER_ERROR ( _ ( "Sous-echantillonnage JPEG inconnu : " ) << subsampling << _ ( " (4:2:0, 4:2:2 ou 4:4:4)" ) );
+                return;
+            }
+            const char* dct = pElem->Attribute ( "dct" );
+            if ( dct && ! jpegOptions.setDct ( dct ) ) {
+                LOGGER_ERROR ( _ ( "Methode de DCT JPEG inconnue : " ) << dct << _ ( " (islow, ifast ou float)" ) );
+                return;
+            }
+            const char* optimize = pElem->Attribute ( "optimize" );
+            if ( optimize ) {
+                jpegOptions.setOptimize ( std::string ( optimize ) == "true" || std::string ( optimize ) == "1" );
+            }
+        }
     }
 
     ok = true;
@@ -51,6 +51,7 @@ class LayerXML;
 #include "BoundingBox.h"
 #include "MetadataURL.h"
 #include "DocumentXML.h"
+#include "JpegOptions.h"
 
 #include "config.h"
 #include "intl.h"
@@ -89,6 +90,11 @@ class LayerXML : public DocumentXML
         std::string authority;
         std::string resamplingStr;
         Interpolation::KernelType resampling;
+        int metatileSize;
+        size_t metatileCacheSize;
+        std::vector<std::string> transcodingFormats;
+        size_t transcodingCacheSize;
+        JpegOptions jpegOptions;
 
         bool getFeatureInfoAvailability;
         std::string getFeatureInfoType;
@@ -57,19 +57,39 @@
 #include "intl.h"
 #include "config.h"
 #include <cstddef>
+#include <climits>
 #include <sys/stat.h>
+#include <list>
+#include <pthread.h>
 
 // GREG
 #include "Message.h"
 #include "Rok4Image.h"
+#include "Metrics.h"
 // GREG
 
 
 #define EPS 1./256. // FIXME: La valeur 256 est liée au nombre de niveau de valeur d'un canal
 //        Il faudra la changer lorsqu'on aura des images non 8bits.
 
+// Tuiles décodées récemment, pour les interrogations ponctuelles successives (GetFeatureInfo) au même endroit
+#define MAX_DECODED_TILES 32
+
+struct DecodedTile {
+    uint64_t level;
+    int x;
+    int y;
+    std::string data;
+};
+
+static std::list<DecodedTile> decodedTiles;
+static pthread_mutex_t decodedTilesMutex = PTHREAD_MUTEX_INITIALIZER;
+// Identifiant unique des niveaux : une adresse peut être réutilisée après un rechargement
+static uint64_t lastLevelSerial = 0;
+
 
 Level::Level ( LevelXML* l, PyramidXML* p ) {
+    serial = __atomic_add_fetch ( &lastLevelSerial, 1, __ATOMIC_RELAXED );
     tm = l->tm;
     format = p->getFormat();
 
@@ -105,6 +125,7 @@ Level::Level ( LevelXML* l, PyramidXML* p ) {
 }
 
 Level::Level ( Level* obj, ServerXML* sxml, TileMatrixSet* tms) {
+    serial = __atomic_add_fetch ( &lastLevelSerial, 1, __ATOMIC_RELAXED );
     // On met bien l'adresse du nouveau TileMatrix, et pas celui dans le Level cloné (issu de l'ancienne liste de TMS)
     tm = tms->getTm(obj->tm->getId());
 
@@ -248,6 +269,15 @@ Image* Level::getbbox ( ServicesXML* servicesConf, BoundingBox< double > bbox, i
         return 0;
     }
 
+    if ( image->isConstant() ) {
+        // Pas de donnée : la reprojection d'une image uniforme est inutile
+        delete image;
+        delete grid;
+        EmptyImage* ei = new EmptyImage ( width, height, channels, nodataValue );
+        ei->setBbox ( bbox );
+        return ei;
+    }
+
     image->setBbox ( BoundingBox<double> ( tm->getX0() + tm->getRes() * bbox_int.xmin, tm->getY0() - tm->getRes() * bbox_int.ymax, tm->getX0() + tm->getRes() * bbox_int.xmax, tm->getY0() - tm->getRes() * bbox_int.ymin ) );
 
     grid->affine_transform ( 1./image->getResX(), -image->getBbox().xmin/image->getResX() - 0.5,
@@ -259,6 +289,8 @@ Image* Level::getbbox ( ServicesXML* servicesConf, BoundingBox< double > bbox, i
 
 Image* Level::getbbox ( ServicesXML* servicesConf, BoundingBox< double > bbox, int width, int height, Interpolation::KernelType interpolation, int& error ) {
 
+    BoundingBox<double> requestBbox = bbox;
+
     // On convertit les coordonnées en nombre de pixels depuis l'origine X0,Y0
     bbox.xmin = ( bbox.xmin - tm->getX0() ) /tm->getRes();
     bbox.xmax = ( bbox.xmax - tm->getX0() ) /tm->getRes();
@@ -300,6 +332,14 @@ Image* Level::getbbox ( ServicesXML* servicesConf, BoundingBox< double > bbox, i
         return 0;
     }
 
+    if ( imageout->isConstant() ) {
+        // Pas de donnée : le réechantillonnage d'une image uniforme est inutile
+        delete imageout;
+        EmptyImage* ei = new EmptyImage ( width, height, channels, nodataValue );
+        ei->setBbox ( requestBbox );
+        return ei;
+    }
+
     // On affecte la bonne bbox à l'image source afin que la classe de réechantillonnage calcule les bonnes valeurs d'offset
     if (! imageout->setDimensions ( bbox_int.xmax - bbox_int.xmin, bbox_int.ymax - bbox_int.ymin, BoundingBox<double> ( bbox_int ), 1.0, 1.0 ) ) {
         LOGGER_DEBUG ( _ ( "Dimensions invalid !" ) );
@@ -364,15 +404,46 @@ Image* Level::getwindow ( ServicesXML* servicesConf, BoundingBox< int64_t > bbox
     memset ( bottom, 0, nby*sizeof ( int ) );
     bottom[nby- 1] = tm->getTileH() - euclideanDivisionRemainder ( bbox.ymax -1,tm->getTileH() ) - 1;
 
+    // Les tuiles sont lues dalle par dalle : un index par dalle et des lectures groupées
+    std::vector<std::vector<DataSource*> > S ( nby, std::vector<DataSource*> ( nbx, ( DataSource* ) 0 ) );
+    {
+        MetricsTimer timer ( Metrics::getStage ( "level_tile", "level", getId() ) );
+        readTiles ( tile_xmin, tile_ymin, nbx, nby, S );
+    }
+
+    int pixel_size=1;
+    if ( format==Rok4Format::TIFF_RAW_FLOAT32 || format == Rok4Format::TIFF_LZW_FLOAT32 || format == Rok4Format::TIFF_ZIP_FLOAT32 || format == Rok4Format::TIFF_PKB_FLOAT32 )
+        pixel_size=4;
+
     std::vector<std::vector<Image*> > T ( nby, std::vector<Image*> ( nbx ) );
     for ( int y = 0; y < nby; y++ ) {
+        // Les lignes sous la fenêtre ne sont pas décodées
+        size_t neededSize = 0;
+        if ( bottom[y] > 0 ) neededSize = ( size_t ) ( tm->getTileH() - bottom[y] ) * tm->getTileW() * channels * pixel_size;
         for ( int x = 0; x < nbx; x++ ) {
-            T[y][x] = getTile ( tile_xmin + x, tile_ymin + y, left[x], top[y], right[x], bottom[y] );
+            T[y][x] = getTileImage ( decodeTile ( S[y][x], neededSize ), tile_xmin + x, tile_ymin + y, left[x], top[y], right[x], bottom[y] );
         }
     }
 
     if ( nbx == 1 && nby == 1 ) return T[0][0];
-    else return new CompoundImage ( T );
+
+    // Aucune tuile présente : une seule image vide remplace la mosaïque
+    bool constant = true;
+    for ( int y = 0; y < nby && constant; y++ ) {
+        for ( int x = 0; x < nbx && constant; x++ ) {
+            constant = T[y][x]->isConstant();
+        }
+    }
+    if ( constant ) {
+        for ( int y = 0; y < nby; y++ ) {
+            for ( int x = 0; x < nbx; x++ ) {
+                delete T[y][x];
+            }
+        }
+        return new EmptyImage ( bbox.xmax - bbox.xmin, bbox.ymax - bbox.ymin, channels, nodataValue );
+    }
+
+    return new CompoundImage ( T );
 }
 
 
@@ -459,30 +530,152 @@ DataSource* Level::getDecodedTile ( int x, int y ) {
         return 0;
     }
 
+    return decodeTile ( encData );
+}
+
+DataSource* Level::decodeTile ( DataSource* encData, size_t neededSize ) {
+
+    if (encData == NULL) return 0;
+
     if ( format==Rok4Format::TIFF_RAW_INT8 || format==Rok4Format::TIFF_RAW_FLOAT32 )
         return encData;
     else if ( format==Rok4Format::TIFF_JPG_INT8 )
-        return new DataSourceDecoder<JpegDecoder> ( encData );
+        return new DataSourceDecoder<JpegDecoder> ( encData, neededSize );
     else if ( format==Rok4Format::TIFF_PNG_INT8 )
-        return new DataSourceDecoder<PngDecoder> ( encData );
+        return new DataSourceDecoder<PngDecoder> ( encData, neededSize );
     else if ( format==Rok4Format::TIFF_LZW_INT8 || format == Rok4Format::TIFF_LZW_FLOAT32 )
-        return new DataSourceDecoder<LzwDecoder> ( encData );
+        return new DataSourceDecoder<LzwDecoder> ( encData, neededSize );
     else if ( format==Rok4Format::TIFF_ZIP_INT8 || format == Rok4Format::TIFF_ZIP_FLOAT32 )
-        return new DataSourceDecoder<DeflateDecoder> ( encData );
+        return new DataSourceDecoder<DeflateDecoder> ( encData, neededSize );
     else if ( format==Rok4Format::TIFF_PKB_INT8 || format == Rok4Format::TIFF_PKB_FLOAT32 )
-        return new DataSourceDecoder<PackBitsDecoder> ( encData );
+        return new DataSourceDecoder<PackBitsDecoder> ( encData, neededSize );
     LOGGER_ERROR ( _ ( "Type d'encodage inconnu : " ) <<format );
+    delete encData;
     return 0;
 }
 
+/*
+ * Lecture des tuiles encodées d'un rectangle, groupée par dalle
+ */
+void Level::readTiles ( int tile_xmin, int tile_ymin, int nbx, int nby, std::vector<std::vector<DataSource*> >& sources ) {
+
+    // il se peut que le contexte ne soit pas connecté, les tuiles sont alors toutes absentes
+    if (! context->isConnected()) return;
+
+    // Les tuiles hors des limites du niveau sont absentes, sans lecture
+    int64_t xmin = std::max ( ( int64_t ) tile_xmin, ( int64_t ) minTileCol ), ymin = std::max ( ( int64_t ) tile_ymin, ( int64_t ) minTileRow );
+    int64_t xmax = std::min ( ( int64_t ) tile_xmin + nbx - 1, ( int64_t ) maxTileCol ), ymax = std::min ( ( int64_t ) tile_ymin + nby - 1, ( int64_t ) maxTileRow );
+    if ( xmin > xmax || ymin > ymax ) return;
+
+    uint32_t nbTiles = tilesPerWidth * tilesPerHeight;
+    uint32_t headerIndexSize = ROK4_IMAGE_HEADER_SIZE + 2 * 4 * nbTiles;
+    std::string mime = Rok4Format::toMimeType ( format );
+    std::string encoding = Rok4Format::toEncoding ( format );
+    uint8_t* indexheader = new uint8_t[headerIndexSize];
+
+    for ( int slabY = ymin / tilesPerHeight; slabY <= ymax / ( int ) tilesPerHeight; slabY++ ) {
+        for ( int slabX = xmin / tilesPerWidth; slabX <= xmax / ( int ) tilesPerWidth; slabX++ ) {
+
+            // Tuiles demandées dans cette dalle
+            int x0 = std::max ( ( int ) xmin, slabX * ( int ) tilesPerWidth );
+            int x1 = std::min ( ( int ) xmax, ( slabX + 1 ) * ( int ) tilesPerWidth - 1 );
+            int y0 = std::max ( ( int ) ymin, slabY * ( int ) tilesPerHeight );
+            int y1 = std::min ( ( int ) ymax, ( slabY + 1 ) * ( int ) tilesPerHeight - 1 );
+
+            MetricsTimer timer ( Metrics::getStage ( "tile_read", "backend", context->getTypeStr() ) );
+
+            std::string path = getPath ( x0, y0 );
+            LOGGER_DEBUG ( path );
+            if ( ! StoreDataSource::readHeaderIndex ( context, path, indexheader, headerIndexSize ) ) continue;
+
+            // Portions à lire, dans l'ordre des tuiles : la lecture les regroupe si elles sont proches dans la dalle
+            std::vector<ContextRange> ranges;
+            std::vector<std::pair<int,int> > positions;
+            for ( int y = y0; y <= y1; y++ ) {
+                for ( int x = x0; x <= x1; x++ ) {
+                    int n = ( y % tilesPerHeight ) * tilesPerWidth + ( x % tilesPerWidth );
+                    uint32_t tileOffset = *( ( uint32_t* ) ( indexheader + ROK4_IMAGE_HEADER_SIZE + 4 * n ) );
+                    uint32_t tileSize = *( ( uint32_t* ) ( indexheader + ROK4_IMAGE_HEADER_SIZE + 4 * nbTiles + 4 * n ) );
+
+                    if ( tileSize == 0 ) {
+                        LOGGER_DEBUG ( "Tuile non présente dans la dalle (taille nulle) " << path );
+                        continue;
+                    }
+                    if ( tileSize > MAX_TILE_SIZE ) {
+                        LOGGER_ERROR ( "Tuile trop volumineuse dans le fichier/objet " << path );
+                        continue;
+                    }
+                    // Une tuile est rangée après l'en-tête et l'index
+                    if ( tileOffset < headerIndexSize || ( uint64_t ) tileOffset + tileSize > INT_MAX ) {
+                        LOGGER_ERROR ( "Position de tuile invalide (" << tileOffset << ") dans le fichier/objet " << path );
+                        continue;
+                    }
+
+                    ranges.push_back ( ContextRange ( tileOffset, tileSize, NULL ) );
+                    positions.push_back ( std::make_pair ( x - tile_xmin, y - tile_ymin ) );
+                }
+            }
+            if ( ranges.empty() ) continue;
+
+            // Les tuiles sont lues dans un unique buffer, dont les sources de données sont des portions
+            SharedBuffer* slab = new SharedBuffer ( context->readSlices ( ranges, path ) );
+
+            size_t readBytes = 0;
+            for ( unsigned int i = 0; i < ranges.size(); i++ ) {
+                ContextRange& r = ranges.at ( i );
+                if ( r.readSize != r.size ) {
+                    LOGGER_ERROR ( "Erreur lors de la lecture de la tuile dans l'objet " << path );
+                } else {
+                    sources[positions.at ( i ).second][positions.at ( i ).first] = new SliceDataSource ( slab, r.data, r.size, mime, encoding );
+                    readBytes += r.size;
+                }
+            }
+            slab->release();
+            Metrics::count ( "rok4_tile_read_bytes_total", Metrics::label ( "backend", context->getTypeStr() ), readBytes );
+        }
+    }
+
+    delete[] indexheader;
+}
+
+DataSource* Level::getTile (int x, int y, bool acceptGzip) {
 
-DataSource* Level::getTile (int x, int y) {
+    MetricsTimer timer ( Metrics::getStage ( "level_tile", "level", getId() ) );
 
     DataSource* source = getEncodedTile ( x, y );
     if (source == NULL) return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
 
     size_t size;
-    if (source->getData ( size ) == NULL) return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
+    const uint8_t* data = source->getData ( size );
+    if (data == NULL) {
+        delete source;
+        return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
+    }
+
+    if ( format == Rok4Format::TIFF_PBF_MVT && GzipDecoder::isGzip ( data, size ) ) {
+        // Tuile vecteur stockée compressée : transmise telle quelle si le client accepte gzip, décompressée sinon
+        DataSource* tile;
+        if ( acceptGzip ) {
+            tile = new RawDataSource ( ( uint8_t* ) data, size, source->getType(), "gzip" );
+            Metrics::count ( "rok4_pbf_tiles_total", Metrics::label ( "encoding", "gzip" ) );
+        } else {
+            size_t rawSize;
+            const uint8_t* raw;
+            {
+                MetricsTimer decodeTimer ( Metrics::getStage ( "decode", "format", GzipDecoder::getName() ) );
+                raw = GzipDecoder::decode ( source, rawSize );
+            }
+            if ( raw == NULL ) {
+                delete source;
+                return new SERDataSource ( new ServiceException ( "", OWS_NOAPPLICABLE_CODE, _ ( "Impossible de repondre a la requete" ), "wmts" ) );
+            }
+            tile = new RawDataSource ( ( uint8_t* ) raw, rawSize, source->getType(), "" );
+            delete[] raw;
+            Metrics::count ( "rok4_pbf_tiles_total", Metrics::label ( "encoding", "identity" ) );
+        }
+        delete source;
+        return tile;
+    }
 
     if ( format == Rok4Format::TIFF_RAW_INT8 || format == Rok4Format::TIFF_LZW_INT8 ||
          format == Rok4Format::TIFF_LZW_FLOAT32 || format == Rok4Format::TIFF_ZIP_INT8 ||
@@ -498,13 +691,34 @@ DataSource* Level::getTile (int x, int y) {
 }
 
 Image* Level::getTile ( int x, int y, int left, int top, int right, int bottom ) {
-    int pixel_size=1;
     LOGGER_DEBUG ( _ ( "GetTile Image" ) );
+
+    DataSource* ds;
+    {
+        // Le décodage lui-même est différé, mesuré par l'étape decode
+        MetricsTimer timer ( Metrics::getStage ( "level_tile", "level", getId() ) );
+        ds = getDecodedTile ( x,y );
+    }
+
+    return getTileImage ( ds, x, y, left, top, right, bottom );
+}
+
+Image* Level::getStoredTile ( int x, int y ) {
+    DataSource* ds;
+    {
+        MetricsTimer timer ( Metrics::getStage ( "level_tile", "level", getId() ) );
+        ds = getDecodedTile ( x, y );
+    }
+
+    if ( ds == 0 ) return 0;
+    return getTileImage ( ds, x, y, 0, 0, 0, 0 );
+}
+
+Image* Level::getTileImage ( DataSource* ds, int x, int y, int left, int top, int right, int bottom ) {
+    int pixel_size=1;
     if ( format==Rok4Format::TIFF_RAW_FLOAT32 || format == Rok4Format::TIFF_LZW_FLOAT32 || format == Rok4Format::TIFF_ZIP_FLOAT32 || format == Rok4Format::TIFF_PKB_FLOAT32 )
         pixel_size=4;
 
-    DataSource* ds = getDecodedTile ( x,y );
-
     BoundingBox<double> bb ( 
         tm->getX0() + x * tm->getTileW() * tm->getRes() + left * tm->getRes(),
         tm->getY0() - ( y+1 ) * tm->getTileH() * tm->getRes() + bottom * tm->getRes(),
@@ -530,6 +744,74 @@ Image* Level::getTile ( int x, int y, int left, int top, int right, int bottom )
     }
 }
 
+void Level::getPixel ( int64_t col, int64_t row, std::vector<float>& values ) {
+    values.assign ( nodataValue, nodataValue + channels );
+
+    if ( col < 0 || row < 0 ) return;
+    int x = col / tm->getTileW();
+    int y = row / tm->getTileH();
+    if ( x < ( int64_t ) minTileCol || x > ( int64_t ) maxTileCol || y < ( int64_t ) minTileRow || y > ( int64_t ) maxTileRow ) return;
+
+    int pixelSize = 1;
+    if ( format==Rok4Format::TIFF_RAW_FLOAT32 || format == Rok4Format::TIFF_LZW_FLOAT32 || format == Rok4Format::TIFF_ZIP_FLOAT32 || format == Rok4Format::TIFF_PKB_FLOAT32 )
+        pixelSize = 4;
+    size_t offset = ( ( row % tm->getTileH() ) * tm->getTileW() + ( col % tm->getTileW() ) ) * channels * pixelSize;
+    size_t length = channels * pixelSize;
+
+    std::string pixel;
+    bool found = false;
+    pthread_mutex_lock ( &decodedTilesMutex );
+    for ( std::list<DecodedTile>::iterator it = decodedTiles.begin(); it != decodedTiles.end(); it++ ) {
+        if ( it->level == serial && it->x == x && it->y == y ) {
+            decodedTiles.splice ( decodedTiles.begin(), decodedTiles, it );
+            if ( offset + length <= it->data.size() ) pixel = it->data.substr ( offset, length );
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock ( &decodedTilesMutex );
+
+    if ( ! found ) {
+        DataSource* ds = getDecodedTile ( x, y );
+        // Tuile absente : non conservée, elle peut apparaître (niveau à la volée)
+        if ( ds == 0 ) return;
+
+        size_t size;
+        const uint8_t* data = ds->getData ( size );
+        if ( data == NULL ) {
+            delete ds;
+            return;
+        }
+
+        DecodedTile tile;
+        tile.level = serial;
+        tile.x = x;
+        tile.y = y;
+        tile.data.assign ( ( const char* ) data, size );
+        delete ds;
+
+        if ( offset + length <= tile.data.size() ) pixel = tile.data.substr ( offset, length );
+
+        pthread_mutex_lock ( &decodedTilesMutex );
+        decodedTiles.push_front ( tile );
+        if ( decodedTiles.size() > MAX_DECODED_TILES ) decodedTiles.pop_back();
+        pthread_mutex_unlock ( &decodedTilesMutex );
+    }
+
+    if ( pixel.empty() ) {
+        LOGGER_ERROR ( _ ( "Tuile decodee trop petite pour le pixel " ) << col << "," << row );
+        return;
+    }
+
+    for ( int c = 0; c < channels; c++ ) {
+        if ( pixelSize == 4 ) {
+            memcpy ( &values[c], pixel.data() + 4 * c, 4 );
+        } else {
+            values[c] = ( uint8_t ) pixel[c];
+        }
+    }
+}
+
 
 BoundingBox<double> Level::tileIndicesToSlabBbox (int tileCol, int tileRow) {
 
@@ -60,6 +60,9 @@ class Level;
  */
 
 class Level {
+#ifdef UNITTEST
+    friend class CppUnitLevel;
+#endif //UNITTEST
 private:
 
     std::string racine;
@@ -88,10 +91,31 @@ private:
 
     int* nodataValue;
 
+    uint64_t serial;   //identifiant unique du niveau, pour les tuiles décodées conservées
+
 
     DataSource* getEncodedTile ( int x, int y );
     DataSource* getDecodedTile ( int x, int y );
 
+    /**
+     * Associe le décodeur du format de la pyramide à la tuile encodée, qui lui est confiée (0 si la tuile est absente).
+     * Si neededSize est non nul, seuls les neededSize premiers octets de la tuile (ses premières lignes) sont décodés.
+     */
+    DataSource* decodeTile ( DataSource* encData, size_t neededSize = 0 );
+
+    /**
+     * Lit les tuiles encodées du rectangle de nbx x nby tuiles dont la première est (tile_xmin, tile_ymin).
+     * L'en-tête et l'index de chaque dalle ne sont lus qu'une fois, et les tuiles d'une même dalle sont lues
+     * ensemble (Context::readRanges), celles proches dans la dalle en une seule lecture.
+     * Les tuiles absentes ou illisibles restent à 0 dans sources[y][x].
+     */
+    void readTiles ( int tile_xmin, int tile_ymin, int nbx, int nby, std::vector<std::vector<DataSource*> >& sources );
+
+    /**
+     * Image de la tuile (x,y), rognée des bords left, top, right et bottom, à partir de sa donnée décodée (image vide si 0).
+     */
+    Image* getTileImage ( DataSource* ds, int x, int y, int left, int top, int right, int bottom );
+
 protected:
     /**
      * Renvoie une image de taille width, height
@@ -140,12 +164,26 @@ public:
      * La tuile contenant la coordonnées (X, Y) dans le srs d'origine a pour indice :
      * x = floor((X - X0) / (tile_width * resolution_x))
      * y = floor((Y - Y0) / (tile_height * resolution_y))
+     *
+     * Une tuile vecteur stockée compressée en gzip est renvoyée telle quelle (encodage "gzip") si acceptGzip est vrai, décompressée sinon.
      */
 
-    DataSource* getTile (int x, int y);
+    DataSource* getTile (int x, int y, bool acceptGzip = false);
 
     Image* getTile ( int x, int y, int left, int top, int right, int bottom );
 
+    /**
+     * Renvoie l'image de la tuile x, y stockée dans la pyramide, 0 si la tuile n'existe pas.
+     */
+    Image* getStoredTile ( int x, int y );
+
+    /**
+     * Renvoie les valeurs du pixel (col, row) numéroté depuis l'origine, celles de non-donnée si la tuile n'existe pas.
+     * Seule la tuile contenant le pixel est lue et décodée, les dernières tuiles décodées sont conservées
+     * pour les interrogations successives au même endroit.
+     */
+    void getPixel ( int64_t col, int64_t row, std::vector<float>& values );
+
     BoundingBox<double> tileIndicesToSlabBbox(int tileCol, int tileRow);
     BoundingBox<double> tileIndicesToTileBbox(int tileCol, int tileRow);
     BoundingBox<double> TMLimitsToBbox();
@@ -306,7 +306,10 @@ Image *Pyramid::createExtendedCompoundImage(std::string l, BoundingBox<double> b
         } else if ( newWidth > 0 && newHeigth > 0 ) {
             tmp = levels[l]->getbbox ( servicesXML, cropBBox, newWidth, newHeigth, tms->getCrs(), dst_crs, interpolation, cropError );
         }
-        if ( tmp != 0 ) {
+        if ( tmp != 0 && tmp->isConstant() ) {
+            // Pas de donnée dans la partie valide : le fond suffit
+            delete tmp;
+        } else if ( tmp != 0 ) {
             LOGGER_DEBUG ( _ ( "Image decoupe valide" ) );
             images.push_back ( tmp );
         }
@@ -51,6 +51,8 @@
 #include <climits>
 #include <vector>
 #include <cstdio>
+#include <cstring>
+#include <strings.h>
 #include "tinyxml.h"
 #include "config.h"
 #include <algorithm>
@@ -153,6 +155,114 @@ void Request::url_decode ( char *src ) {
     *dst = '\0';
 }
 
+/**
+ * \~french
+ * \brief Décode un caractère d'une URL, comme Request::url_decode
+ * \param[in] src position dans l'URL
+ * \param[out] dst caractère décodé
+ * \return position suivante dans l'URL
+ * \~english
+ * \brief Decode one URL character, as Request::url_decode
+ * \param[in] src position in the URL
+ * \param[out] dst decoded character
+ * \return next position in the URL
+ */
+static inline const char* decodeChar ( const char* src, char& dst ) {
+    if ( *src == '+' ) {
+        dst = ' ';
+    } else if ( *src == '%' ) {
+        dst = '%';
+        unsigned char high = hex2int ( * ( src + 1 ) );
+        if ( high != 0xFF ) {
+            unsigned char low = hex2int ( * ( src + 2 ) );
+            if ( low != 0xFF ) {
+                high = ( high << 4 ) | low;
+
+                /* map control-characters out */
+                if ( high < 32 || high == 127 ) high = '_';
+
+                dst = high;
+                src += 2;
+            }
+        }
+    } else {
+        dst = *src;
+    }
+    return src + 1;
+}
+
+void RequestParams::parse ( const char* query ) {
+    // Le décodage ne fait que raccourcir : le buffer ne sera pas réalloué
+    buffer.reserve ( buffer.size() + strlen ( query ) );
+    if ( entries.capacity() < 16 ) entries.reserve ( 16 );
+
+    const char* src = query;
+    while ( *src ) {
+        char c;
+
+        // La clé, jusqu'au premier "=", "&" ou 0, est décodée, mise en minuscule et son empreinte calculée au fil de l'eau
+        uint32_t key = buffer.size();
+        uint32_t h = 2166136261u;
+        while ( *src && *src != '=' && *src != '&' ) {
+            src = decodeChar ( src, c );
+            c = tolower ( c );
+            h = ( h ^ ( uint8_t ) c ) * 16777619u;
+            buffer.push_back ( c );
+        }
+        uint32_t keySize = buffer.size() - key;
+
+        // La valeur, jusqu'au "&" suivant ou 0
+        if ( *src == '=' ) src++;
+        uint32_t value = buffer.size();
+        while ( *src && *src != '&' ) {
+            src = decodeChar ( src, c );
+            buffer.push_back ( c );
+        }
+
+        add ( h, key, keySize, value, buffer.size() - value );
+
+        if ( *src ) src++;
+    }
+}
+
+void RequestParams::add ( uint32_t hash, uint32_t key, uint32_t keySize, uint32_t value, uint32_t valueSize ) {
+    if ( find ( buffer.data() + key, keySize, hash ) ) return;
+    Entry e = { hash, key, keySize, value, valueSize };
+    entries.push_back ( e );
+}
+
+const RequestParams::Entry* RequestParams::find ( const char* key, size_t size, uint32_t hash ) const {
+    for ( size_t i = 0; i < entries.size(); i++ ) {
+        const Entry& e = entries[i];
+        if ( e.hash == hash && e.keySize == size && memcmp ( buffer.data() + e.key, key, size ) == 0 ) {
+            return &e;
+        }
+    }
+    return NULL;
+}
+
+void RequestParams::insert ( const std::pair<std::string, std::string>& param ) {
+    uint32_t h = hash ( param.first.data(), param.first.size() );
+    if ( find ( param.first.data(), param.first.size(), h ) ) return;
+
+    uint32_t key = buffer.size();
+    buffer.append ( param.first );
+    uint32_t value = buffer.size();
+    buffer.append ( param.second );
+    Entry e = { h, key, ( uint32_t ) param.first.size(), value, ( uint32_t ) param.second.size() };
+    entries.push_back ( e );
+}
+
+bool RequestParams::has ( const std::string& key ) const {
+    return find ( key.data(), key.size(), hash ( key.data(), key.size() ) ) != NULL;
+}
+
+std::string RequestParams::get ( const std::string& key ) const {
+    const Entry* e = find ( key.data(), key.size(), hash ( key.data(), key.size() ) );
+    if ( e == NULL ) return "";
+    return buffer.substr ( e->value, e->valueSize );
+}
+
 /**
  * \~french
  * \brief Supprime l'espace de nom (la partie avant :) de la balise XML
@@ -180,7 +290,7 @@ void removeNameSpace ( std::string& elementName ) {
  * \param[in] hGetCap request XML element
  * \param[in,out] parameters associative parameters list
  */
-void parseGetCapabilitiesPost ( TiXmlHandle& hGetCap, std::map< std::string, std::string >& parameters ) {
+void parseGetCapabilitiesPost ( TiXmlHandle& hGetCap, RequestParams& parameters ) {
     LOGGER_DEBUG ( _ ( "Parse GetCapabilities Request" ) );
     std::string version;
     std::string service;
@@ -215,7 +325,7 @@ void parseGetCapabilitiesPost ( TiXmlHandle& hGetCap, std::map< std::string, std
  * \param[in] hGetTile request XML element
  * \param[in,out] parameters associative parameters list
  */
-void parseGetTilePost ( TiXmlHandle& hGetTile, std::map< std::string, std::string >& parameters ) {
+void parseGetTilePost ( TiXmlHandle& hGetTile, RequestParams& parameters ) {
     LOGGER_DEBUG ( _ ( "Parse GetTile Request" ) );
     TiXmlElement* pElem = hGetTile.ToElement();
     std::string version;
@@ -340,7 +450,7 @@ void parseGetTilePost ( TiXmlHandle& hGetTile, std::map< std::string, std::strin
  * \param[in] hGetMap request XML element
  * \param[in,out] parameters associative parameters list
  */
-void parseGetMapPost ( TiXmlHandle& hGetMap, std::map< std::string, std::string >& parameters ) {
+void parseGetMapPost ( TiXmlHandle& hGetMap, RequestParams& parameters ) {
     LOGGER_DEBUG ( _ ( "Parse GetMap Request" ) );
     TiXmlElement* pElem = hGetMap.ToElement();
     std::string version;
@@ -600,7 +710,7 @@ void parseGetMapPost ( TiXmlHandle& hGetMap, std::map< std::string, std::string
  * \todo HTTP POST, KVP style
  * \todo HTTP POST, XML/Soap style
  */
-void parsePostContent ( std::string content, std::map< std::string, std::string >& parameters ) {
+void parsePostContent ( std::string content, RequestParams& parameters ) {
     TiXmlDocument doc ( "request" );
     content.append ( "\n" );
     if ( !doc.Parse ( content.c_str() ) ) {
@@ -630,15 +740,14 @@ void parsePostContent ( std::string content, std::map< std::string, std::string
 void Request::determineServiceAndRequest() {
 
     // SERVICE
-    std::map<std::string, std::string>::iterator it = params.find ( "service" );
-    if ( it == params.end() ) {
+    if ( ! params.has ( "service" ) ) {
         // Dans le cas du TMS, on n'a pas de paramètres.
         // On va donc admettre qu'en l'absence total de paramètres, on est implicitement en TMS
         if (params.size() == 0) {
             service = ServiceType::TMS;
         }
     } else {
-        std::string str_service = it->second;
+        std::string str_service = params.get ( "service" );
         std::transform(str_service.begin(), str_service.end(), str_service.begin(), ::tolower);
         if (str_service == "wms") {
             service = ServiceType::WMS;
@@ -657,57 +766,16 @@ void Request::determineServiceAndRequest() {
 
     // REQUETE
     // On teste également la cohérence de la requête avec le service
-    it = params.find ( "request" );
-    if ( it == params.end() ) {
+    if ( ! params.has ( "request" ) ) {
         // Dans le cas du TMS, on n'a pas de paramètres.
         // On va donc admettre qu'en l'absence total de paramètres, on est implicitement en TMS
         // C'est la profondeur du path à partir de la version 1.0.0 qui va permettre d'identifier
         // le tpye de requête
         if (params.size() == 0 && service == ServiceType::TMS) {
-            std::stringstream ss(path);
-            std::string token;
-            char delim = '/';
-            int tmsVersionPos = -1;
-            std::vector<std::string> pathParts;
-            while (std::getline(ss, token, delim)) {
-                if (token == "1.0.0") {
-                    tmsVersionPos = pathParts.size();
-                }
-                pathParts.push_back(token);
-            }
-
-            if (tmsVersionPos == -1) {
-                // La version n'a pas été rencontrée, on n'est pas dans le cas d'une consultation TMS
-                // On va alors considérer que l'on veut la liste des services disponibles sur ce serveur
-                // On reste en TMS comme service
-                request = RequestType::GETSERVICES;
-            }
-
-            else if (tmsVersionPos == pathParts.size() - 1) {
-                // la version est en dernière position, on veut le "GetCapabilities" TMS
-                request = RequestType::GETCAPABILITIES;
-            }
-
-            else if (tmsVersionPos == pathParts.size() - 2) {
-                // la version est en avant dernière position, on veut le détail de la couche
-                request = RequestType::GETLAYER;
-            }
-
-            else if (tmsVersionPos == pathParts.size() - 3 && pathParts.back() == "metadata.json") {
-                // la version est en avant dernière position, on veut le détail de la couche
-                request = RequestType::GETLAYERMETADATA;
-            }
-
-            else if (tmsVersionPos == pathParts.size() - 5) {
-                // on requête une tuile
-                request = RequestType::GETTILE;
-            } else {
-                // La profondeur de requête ne permet pas de savoir l'action demandée -> ERREUR
-                request = RequestType::REQUEST_UNKNOWN;
-            }
+            routeTms();
         }
     } else {
-        std::string str_request = it->second;
+        std::string str_request = params.get ( "request" );
         std::transform(str_request.begin(), str_request.end(), str_request.begin(), ::tolower);
         if (str_request == "getmap" || str_request == "map") {
             if (service == ServiceType::SERVICE_MISSING || service == ServiceType::WMS) {
@@ -761,8 +829,112 @@ void Request::determineServiceAndRequest() {
     }
 }
 
+void Request::routeTms() {
+
+    // Découpage du chemin en une passe : on repère les éléments et la dernière version 1.0.0, qui termine l'URL du service
+    std::vector<std::pair<size_t, size_t> > parts;
+    parts.reserve ( 16 );
+    int versionPos = -1;
+    size_t baseEnd = std::string::npos;
+
+    size_t start = 0;
+    while ( start < path.size() ) {
+        size_t end = path.find ( '/', start );
+        if ( end == std::string::npos ) end = path.size();
+        if ( end - start == 5 && path.compare ( start, 5, "1.0.0" ) == 0 ) {
+            versionPos = parts.size();
+            baseEnd = end;
+        }
+        parts.push_back ( std::make_pair ( start, end - start ) );
+        start = end + 1;
+    }
+
+    if (versionPos == -1) {
+        // La version n'a pas été rencontrée, on n'est pas dans le cas d'une consultation TMS
+        // On va alors considérer que l'on veut la liste des services disponibles sur ce serveur
+        // On reste en TMS comme service
+        request = RequestType::GETSERVICES;
+        return;
+    }
+
+    tms.depth = parts.size() - 1 - versionPos;
+    tms.base = path.substr ( 0, baseEnd );
+    if ( tms.depth >= 1 ) tms.layer = path.substr ( parts[versionPos + 1].first, parts[versionPos + 1].second );
+
+    if (tms.depth == 0) {
+        // la version est en dernière position, on veut le "GetCapabilities" TMS
+        request = RequestType::GETCAPABILITIES;
+    }
+
+    else if (tms.depth == 1) {
+        // la version est en avant dernière position, on veut le détail de la couche
+        request = RequestType::GETLAYER;
+    }
+
+    else if (tms.depth == 2 && path.compare ( parts.back().first, parts.back().second, "metadata.json" ) == 0) {
+        // la couche est suivie de metadata.json, on veut les métadonnées de la couche
+        request = RequestType::GETLAYERMETADATA;
+    }
+
+    else if (tms.depth == 4) {
+        // on requête une tuile : {z}/{x}/{y}.{ext}
+        request = RequestType::GETTILE;
+        tms.tileMatrix = path.substr ( parts[versionPos + 2].first, parts[versionPos + 2].second );
+        tms.tileCol = path.substr ( parts[versionPos + 3].first, parts[versionPos + 3].second );
+
+        std::string rowWithExtension = path.substr ( parts[versionPos + 4].first, parts[versionPos + 4].second );
+        size_t dot = rowWithExtension.find ( '.' );
+        tms.tileRow = rowWithExtension.substr ( 0, dot );
+        if ( dot != std::string::npos ) {
+            tms.extension = rowWithExtension.substr ( dot + 1, rowWithExtension.find ( '.', dot + 1 ) - dot - 1 );
+        }
+    } else {
+        // La profondeur de requête ne permet pas de savoir l'action demandée -> ERREUR
+        request = RequestType::REQUEST_UNKNOWN;
+    }
+}
+
+bool Request::acceptsEncoding ( const char* header, const char* coding ) {
+    if ( header == NULL ) return false;
+
+    size_t codingSize = strlen ( coding );
+    bool wildcard = false;
+    const char* p = header;
+
+    while ( *p ) {
+        // Un élément de la liste : "codage[;q=poids]"
+        while ( *p == ' ' || *p == '\t' || *p == ',' ) p++;
+        const char* name = p;
+        while ( *p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t' ) p++;
+        size_t nameSize = p - name;
+
+        double q = 1.;
+        while ( *p && *p != ',' ) {
+            if ( *p == ';' ) {
+                p++;
+                while ( *p == ' ' || *p == '\t' ) p++;
+                if ( ( *p == 'q' || *p == 'Q' ) && p[1] == '=' ) {
+                    q = atof ( p + 2 );
+                }
+            } else {
+                p++;
+            }
+        }
+
+        if ( nameSize == codingSize && strncasecmp ( name, coding, codingSize ) == 0 ) {
+            // Une mention explicite prime sur "*"
+            return q > 0.;
+        }
+        if ( nameSize == 1 && *name == '*' ) {
+            wildcard = q > 0.;
+        }
+    }
+
+    return wildcard;
+}
+
 Request::Request ( char* strquery, char* hostName, char* path, char* https ) : 
-    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING)
+    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING), acceptGzip ( false )
 {
     LOGGER_DEBUG ( "QUERY="<<strquery );
     if ( https && (strcmp ( https,"on" ) == 0 || strcmp ( https,"ON" ) ==0) ){
@@ -771,19 +943,7 @@ Request::Request ( char* strquery, char* hostName, char* path, char* https ) :
         scheme = "http://";
     }
 
-    url_decode ( strquery );
-
-    for ( int pos = 0; strquery[pos]; ) {
-        char* key = strquery + pos;
-        for ( ; strquery[pos] && strquery[pos] != '=' && strquery[pos] != '&'; pos++ ); // on trouve le premier "=", "&" ou 0
-        char* value = strquery + pos;
-        for ( ; strquery[pos] && strquery[pos] != '&'; pos++ ); // on trouve le suivant "&" ou 0
-        if ( *value == '=' ) *value++ = 0; // on met un 0 à la place du '=' entre key et value
-        if ( strquery[pos] ) strquery[pos++] = 0; // on met un 0 à la fin du char* value
-
-        toLowerCase ( key );
-        params.insert ( std::pair<std::string, std::string> ( key, value ) );
-    }
+    params.parse ( strquery );
 
     determineServiceAndRequest();
 
@@ -791,7 +951,7 @@ Request::Request ( char* strquery, char* hostName, char* path, char* https ) :
 
 
 Request::Request ( char* strquery, char* hostName, char* path, char* https, std::string postContent ) : 
-    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING)
+    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING), acceptGzip ( false )
 {
     LOGGER_DEBUG ( "QUERY="<<strquery );
     if ( https && (strcmp ( https,"on" ) == 0 || strcmp ( https,"ON" ) ==0) ){
@@ -812,18 +972,9 @@ Request::Request ( char* strquery, char* hostName, char* path, char* https, std:
 Request::~Request() {}
 
 bool Request::hasParam ( std::string paramName ) {
-    std::map<std::string, std::string>::iterator it = params.find ( paramName );
-    if ( it == params.end() ) {
-        return false;
-    }
-    return true;
+    return params.has ( paramName );
 }
 
 std::string Request::getParam ( std::string paramName ) {
-    std::map<std::string, std::string>::iterator it = params.find ( paramName );
-    if ( it == params.end() ) {
-        return "";
-    }
-    return it->second;
+    return params.get ( paramName );
 }
-    
\ No newline at end of file
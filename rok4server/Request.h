@@ -42,6 +42,7 @@ class Request;
 
 #include <map>
 #include <vector>
+#include <stdint.h>
 #include "BoundingBox.h"
 #include "Data.h"
 #include "CRS.h"
@@ -115,6 +116,124 @@ namespace ServiceType {
 }
 
 
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Paramètres d'une requête
+ * \details Les clés (en minuscules) et les valeurs sont rangées à la suite dans un unique buffer, et repérées par une table plate
+ * portant l'empreinte (FNV-1a) de chaque clé : une recherche ne compare que des entiers, puis la clé trouvée. Une requête
+ * n'ayant qu'une dizaine de paramètres, l'analyse d'une requête ne fait que deux allocations.
+ *
+ * Comme pour une std::map, seule la première valeur d'une clé répétée est conservée.
+ * \~english
+ * \brief Request's parameters
+ * \details Keys (lower case) and values are stored one after another in a single buffer, and referenced by a flat table
+ * with each key's hash (FNV-1a) : a search only compares integers, then the found key. A request having about ten
+ * parameters, parsing a request only needs two allocations.
+ *
+ * As for a std::map, only the first value of a repeated key is kept.
+ */
+class RequestParams {
+
+private:
+
+    struct Entry {
+        uint32_t hash;
+        uint32_t key;
+        uint32_t keySize;
+        uint32_t value;
+        uint32_t valueSize;
+    };
+
+    /**
+     * \~french \brief Clés et valeurs, à la suite
+     * \~english \brief Keys and values, one after another
+     */
+    std::string buffer;
+
+    /**
+     * \~french \brief Position des paramètres dans le buffer, dans l'ordre de la requête
+     * \~english \brief Parameters' position in the buffer, in the request order
+     */
+    std::vector<Entry> entries;
+
+    const Entry* find ( const char* key, size_t size, uint32_t hash ) const;
+
+    void add ( uint32_t hash, uint32_t key, uint32_t keySize, uint32_t value, uint32_t valueSize );
+
+public:
+
+    /**
+     * \~french \brief Empreinte d'une clé
+     * \~english \brief Key's hash
+     */
+    static uint32_t hash ( const char* key, size_t size ) {
+        uint32_t h = 2166136261u;
+        for ( size_t i = 0; i < size; i++ ) h = ( h ^ ( uint8_t ) key[i] ) * 16777619u;
+        return h;
+    }
+
+    RequestParams() {}
+
+    /**
+     * \~french
+     * \brief Analyse une chaîne de requête (clé=valeur&...) en une seule passe
+     * \details Chaque clé et chaque valeur est décodée (URL), les clés sont mises en minuscule.
+     * \param[in] query chaîne de requête
+     * \~english
+     * \brief Parse a query string (key=value&...) in one pass
+     * \details Each key and value is URL decoded, keys are translated to lower case.
+     * \param[in] query query string
+     */
+    void parse ( const char* query );
+
+    /**
+     * \~french \brief Ajoute un paramètre, sans effet si la clé est déjà présente
+     * \~english \brief Add a parameter, no effect if the key is already present
+     */
+    void insert ( const std::pair<std::string, std::string>& param );
+
+    bool has ( const std::string& key ) const;
+
+    /**
+     * \~french \brief Valeur d'un paramètre, "" si absent
+     * \~english \brief Parameter's value, "" if missing
+     */
+    std::string get ( const std::string& key ) const;
+
+    size_t size() const {
+        return entries.size();
+    }
+};
+
+/**
+ * \~french
+ * \brief Chemin d'une requête TMS, découpé une seule fois
+ * \details Le chemin est ".../1.0.0[/{layer}[/metadata.json | /{z}/{x}/{y}.{ext}]]" : les éléments sont repérés à partir de la version.
+ * \~english
+ * \brief TMS request's path, split only once
+ * \details Path is ".../1.0.0[/{layer}[/metadata.json | /{z}/{x}/{y}.{ext}]]" : parts are located from the version.
+ */
+struct TmsPath {
+    /**
+     * \~french \brief Nombre d'éléments après la version, -1 si la version est absente
+     * \~english \brief Parts number after the version, -1 if version is missing
+     */
+    int depth;
+    /**
+     * \~french \brief Début du chemin, jusqu'à la version comprise
+     * \~english \brief Path start, until the version included
+     */
+    std::string base;
+    std::string layer;
+    std::string tileMatrix;
+    std::string tileCol;
+    std::string tileRow;
+    std::string extension;
+
+    TmsPath() : depth ( -1 ) {}
+};
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -157,6 +276,14 @@ private:
      */
     void determineServiceAndRequest();
 
+    /**
+     * \~french
+     * \brief Découpage du chemin TMS et identification de la requête selon sa profondeur
+     * \~english
+     * \brief Split TMS path and identify request with its depth
+     */
+    void routeTms();
+
 public:
 
     /**
@@ -201,6 +328,22 @@ public:
      * \return true if present
      */
     bool hasParam ( std::string paramName );
+
+    /**
+     * \~french
+     * \brief Test de l'acceptation d'un encodage de contenu par le client
+     * \details Analyse la valeur de l'en-tête Accept-Encoding : l'encodage est accepté s'il y est cité (ou via "*") sans poids nul (q=0).
+     * \param[in] header valeur de l'en-tête Accept-Encoding, éventuellement NULL
+     * \param[in] coding encodage à tester (en minuscule)
+     * \return true si l'encodage est accepté
+     * \~english
+     * \brief Test whether client accepts a content coding
+     * \details Parse Accept-Encoding header value : coding is accepted if listed (or with "*") without null weight (q=0).
+     * \param[in] header Accept-Encoding header value, possibly NULL
+     * \param[in] coding coding to test (lower case)
+     * \return true if coding is accepted
+     */
+    static bool acceptsEncoding ( const char* header, const char* coding );
     /**
      * \~french
      * \brief Récupération de la valeur d'un paramètre dans la requête
@@ -243,7 +386,19 @@ public:
      * \~french \brief Liste des paramètres de la requête
      * \~english \brief Request parameters list
      */
-    std::map<std::string, std::string> params;
+    RequestParams params;
+
+    /**
+     * \~french \brief Éléments du chemin, pour une requête TMS
+     * \~english \brief Path's parts, for a TMS request
+     */
+    TmsPath tms;
+
+    /**
+     * \~french \brief Le client accepte-t-il une réponse compressée en gzip (faux par défaut)
+     * \~english \brief Does client accept gzip compressed response (false by default)
+     */
+    bool acceptGzip;
 
     void print() {
         LOGGER_INFO("hostName = " << hostName);
@@ -53,6 +53,7 @@
 #include <sstream> // pour les stringstream
 #include "intl.h"
 #include "config.h"
+#include "Metrics.h"
 /**
  * \~french
  * \brief Méthode commune pour générer l'en-tête HTTP en fonction du status code HTTP
@@ -124,7 +125,7 @@ void displayFCGIError ( int error ) {
         LOGGER_ERROR ( _ ( "Erreur inconnue" ) );
 }
 
-int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
+int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request, int retryAfter ) {
     // Creation de l'en-tete
     std::string statusHeader = genStatusHeader ( source->getHttpStatus() );
     std::string filename = genFileName ( source->getType() );
@@ -136,6 +137,10 @@ int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
         FCGX_PutStr ( "\r\nContent-Encoding: ",20,request->out );
         FCGX_PutStr ( source->getEncoding().c_str(), strlen ( source->getEncoding().c_str() ),request->out );
     }
+    if ( source->getType() == "application/x-protobuf" ){
+        // Les tuiles vecteur sont servies compressées ou non selon l'en-tête Accept-Encoding
+        FCGX_PutStr ( "\r\nVary: Accept-Encoding",23,request->out );
+    }
     if ( source->getLength() != 0 ){
         std::stringstream ss;
         ss << source->getLength();
@@ -143,6 +148,13 @@ int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
         FCGX_PutStr ( "\r\nContent-Length: ",18,request->out );
         FCGX_PutStr ( lengthStr.c_str(), strlen ( lengthStr.c_str() ),request->out );
     }
+    if ( retryAfter > 0 ){
+        std::stringstream ss;
+        ss << retryAfter;
+        std::string retryStr = ss.str();
+        FCGX_PutStr ( "\r\nRetry-After: ",15,request->out );
+        FCGX_PutStr ( retryStr.c_str(), strlen ( retryStr.c_str() ),request->out );
+    }
     FCGX_PutStr ( "\r\nContent-Disposition: filename=\"",33,request->out );
     FCGX_PutStr ( filename.data(),filename.size(), request->out );
     FCGX_PutStr ( "\"",1,request->out );
@@ -152,6 +164,8 @@ int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
     size_t buffer_size;
     const uint8_t *buffer = source->getData ( buffer_size );
     int wr = 0;
+
+    MetricsTimer timer ( Metrics::getStage ( "send", "format", source->getType() ) );
     // Ecriture iterative de la source de donnees dans le flux de sortie
     while ( wr < buffer_size ) {
         // Taille ecrite dans le flux de sortie
@@ -194,11 +208,18 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
     size_t size_to_read = 2 << 20;
     int pos = 0;
 
+    // L'encodage (et avec lui la lecture et le calcul de l'image) se fait au fil de la lecture du flux
+    uint64_t encodeTime = 0;
+    uint64_t sendTime = 0;
+    std::string metricsFormat = stream->getType();
+
     // Ecriture progressive du flux d'entree dans le flux de sortie
     while ( true ) {
         // Recuperation d'une portion du flux d'entree
-
+        uint64_t start = Metrics::now();
         size_t read_size = stream->read ( buffer, size_to_read );
+        uint64_t end = Metrics::now();
+        encodeTime += end - start;
         if ( read_size==0 )
             break;
         int wr = 0;
@@ -215,6 +236,7 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
             }
             wr += w;
         }
+        sendTime += Metrics::now() - end;
         if ( wr != read_size ) {
             LOGGER_DEBUG ( _ ( "Nombre incorrect d'octets ecrits dans le flux de sortie" ) );
             delete stream;
@@ -225,6 +247,11 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
         }
         pos += read_size;
     }
+    MetricsHistogram* h = Metrics::getStage ( "encode", "format", metricsFormat );
+    if ( h ) h->record ( encodeTime );
+    h = Metrics::getStage ( "send", "format", metricsFormat );
+    if ( h ) h->record ( sendTime );
+
     if ( stream ) {
         delete stream;
     }
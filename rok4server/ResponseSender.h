@@ -61,12 +61,14 @@ public:
     /**
      * \~french
      * \brief Copie d'une source de données dans le flux de sortie de l'objet request de type FCGX_Request
+     * \param[in] retryAfter délai, en secondes, à indiquer dans l'en-tête Retry-After (aucun en-tête si 0)
      * \return -1 en cas de problème, 0 sinon
      * \~english
      * \brief Copy a data source in the FCGX_Request output stream
+     * \param[in] retryAfter delay, in seconds, for the Retry-After header (no header if 0)
      * \return -1 if error, else 0
      */
-    int sendresponse ( DataSource* response, FCGX_Request* request );
+    int sendresponse ( DataSource* response, FCGX_Request* request, int retryAfter = 0 );
     /**
      * \~french
      * \brief Copie d'un flux d'entree dans le flux de sortie de l'objet request de type FCGX_Request
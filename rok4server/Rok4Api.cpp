@@ -65,6 +65,7 @@
 #endif
 
 #include <cfloat>
+#include <set>
 #include <libintl.h>
 #include "ServerXML.h"
 #include "ServicesXML.h"
@@ -158,9 +159,66 @@ Rok4Server* rok4InitServer ( const char* serverConfigFile ) {
     return new Rok4Server ( serverXML, servicesXML );
 }
 
+/**
+* \brief Une pyramide utilise-t-elle un des TMS ou des styles fournis
+* \details Les pyramides sources des niveaux sont parcourues récursivement
+*/
+static bool pyramidDependsOn ( Pyramid* pyr, std::set<std::string>& tmsIds, std::set<std::string>& styleIds ) {
+    if ( tmsIds.find ( pyr->getTms()->getId() ) != tmsIds.end() ) return true;
+
+    std::map<std::string, Level*>::iterator itLevel;
+    for ( itLevel = pyr->getLevels().begin(); itLevel != pyr->getLevels().end(); itLevel++ ) {
+        std::vector<Source*> sources = itLevel->second->getSources();
+        for ( unsigned int i = 0; i < sources.size(); i++ ) {
+            if ( sources.at(i)->getType() != PYRAMID ) continue;
+            Pyramid* pS = reinterpret_cast<Pyramid*> ( sources.at(i) );
+            if ( pS->getStyle() != NULL && styleIds.find ( pS->getStyle()->getId() ) != styleIds.end() ) return true;
+            if ( pyramidDependsOn ( pS, tmsIds, styleIds ) ) return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+* \brief Une couche utilise-t-elle un des TMS ou des styles fournis
+*/
+static bool layerDependsOn ( Layer* lay, std::set<std::string>& tmsIds, std::set<std::string>& styleIds ) {
+    std::vector<Style*> styles = lay->getStyles();
+    for ( unsigned int i = 0; i < styles.size(); i++ ) {
+        if ( styleIds.find ( styles.at(i)->getId() ) != styleIds.end() ) return true;
+    }
+    return pyramidDependsOn ( lay->getDataPyramid(), tmsIds, styleIds );
+}
+
+/**
+* \brief Abandon d'un rechargement de la configuration
+* \details La nouvelle configuration est détruite sans les objets qu'elle partage avec l'ancienne, qui reste inchangée.
+* \return NULL
+*/
+static Rok4Server* abortReload ( ServerXML* newServerXML, ServicesXML* newServicesXML, ServerXML* oldServerXML ) {
+    newServerXML->giveBack ( oldServerXML );
+    delete newServicesXML;
+    delete newServerXML;
+    sleep ( 1 );    // Pour laisser le temps au logger pour se vider
+    return NULL;
+}
+
+/**
+* \brief Rechargement de la configuration du serveur ROK4
+* \details Seuls les TMS, styles et couches dont les fichiers ont changé (ou qui dépendent d'objets changés) sont reconstruits.
+* Les autres objets et l'annuaire de contextes de stockage (donc les connexions) sont repris tels quels par la nouvelle configuration.
+* Le serveur retourné n'a pas de thread : il est destiné à Rok4Server::switchServer.
+* \param serverConfigFile : nom du fichier de configuration des parametres techniques
+* \param oldServer : serveur répondant actuellement aux requêtes
+* \param lastReload : date du dernier chargement
+* \return : pointeur sur le nouveau serveur ROK4, NULL en cas d'erreur (l'ancien serveur, son annuaire de contextes compris, est inchangé)
+*/
+
 Rok4Server* rok4ReloadServer (const char* serverConfigFile, Rok4Server* oldServer, time_t lastReload ) {
 
     std::string strServerConfigFile = serverConfigFile;
+    ServerXML* oldServerXML = oldServer->getServerConf();
 
     LOGGER_DEBUG("Rechargement de la conf");
     //--- server.conf
@@ -171,43 +229,61 @@ Rok4Server* rok4ReloadServer (const char* serverConfigFile, Rok4Server* oldServe
     ServerXML* newServerXML = ConfLoader::buildServerConf(strServerConfigFile);
     if ( ! newServerXML->isOk() ) {
         std::cerr<<_ ( "ERREUR FATALE : Impossible d'interpreter le fichier de configuration du serveur " ) <<strServerConfigFile<<std::endl;
-        sleep ( 1 );    // Pour laisser le temps au logger pour se vider
-        return NULL;
+        return abortReload ( newServerXML, NULL, oldServerXML );
     }
 
     if (lastModServerConf > lastReload) {
-        //fichier modifié, on recharge particulièrement le logger et on doit vérifier que les fichiers et dossiers
-        //indiqués sont les mêmes qu'avant
         LOGGER_DEBUG("Server.conf modifie");
-        // TODO: Reload du logger si nécessaire
-
+        // Les threads, le socket et le logger sont conservés lors d'un rechargement
+        if ( newServerXML->getNbThreads() != oldServerXML->getNbThreads() ||
+             newServerXML->getSocket() != oldServerXML->getSocket() ||
+             newServerXML->getBacklog() != oldServerXML->getBacklog() ||
+             newServerXML->getHttpListen() != oldServerXML->getHttpListen() ||
+             newServerXML->getHttpKeepAlive() != oldServerXML->getHttpKeepAlive() ||
+             newServerXML->getLogOutput() != oldServerXML->getLogOutput() ||
+             newServerXML->getLogLevel() != oldServerXML->getLogLevel() ||
+             newServerXML->getLogFilePrefix() != oldServerXML->getLogFilePrefix() ) {
+            LOGGER_WARN ( _ ( "Les modifications des threads, du socket et des logs ne sont prises en compte qu'au redemarrage" ) );
+        }
     } else {
         //fichier non modifié, il n'y a rien à faire
         LOGGER_DEBUG("Server.conf non modifie");
-
     }
 
+    // Les contextes de stockage, et leurs connexions, sont conservés : les niveaux reconstruits empruntent ceux de l'ancien annuaire,
+    // qui n'est modifié qu'une fois la nouvelle configuration validée
+    newServerXML->getContextBook()->setPrevious ( oldServerXML->getContextBook() );
+
     //--- service.conf
     LOGGER_DEBUG("Rechargement du service.conf et des fichiers associes (listofequalcrs.txt et restrictedcrslist.txt)");
     // Construction des parametres de service
     ServicesXML* newServicesXML = ConfLoader::buildServicesConf ( newServerXML->getServicesConfigFile() );
     if ( ! newServicesXML->isOk() ) {
         LOGGER_FATAL ( _ ( "Impossible d'interpreter le fichier de conf " ) << newServerXML->getServicesConfigFile() );
-        LOGGER_FATAL ( _ ( "Extinction du serveur ROK4" ) );
-        sleep ( 1 );    // Pour laisser le temps au logger pour se vider
-        return NULL;
+        return abortReload ( newServerXML, newServicesXML, oldServerXML );
     }
 
-
+    // Les styles et les couches sont construits avec les paramètres de service : on les reconstruit tous si ceux ci ont changé
+    bool servicesModified = (
+        newServerXML->getServicesConfigFile() != oldServerXML->getServicesConfigFile() ||
+        ConfLoader::getLastModifiedDate(newServerXML->getServicesConfigFile()) > lastReload
+    );
+    if (servicesModified) {
+        LOGGER_DEBUG("Service.conf modifie, styles et couches seront reconstruits");
+    }
 
     time_t lastMod;
     std::vector<std::string> listOfFile;
     std::string fileName;
 
+    // Identifiants des objets de l'ancienne configuration modifiés ou supprimés
+    std::set<std::string> changedTms;
+    std::set<std::string> changedStyles;
+
     //--- TMS
     LOGGER_DEBUG("Rechargement des TMS");
 
-    if (newServerXML->getTmsDir() != oldServer->getServerConf()->getTmsDir()) {
+    if (newServerXML->getTmsDir() != oldServerXML->getTmsDir()) {
         // Le dossier des TMS a changé
         // on recharge tout comme à l'initialisation
         
@@ -215,74 +291,53 @@ Rok4Server* rok4ReloadServer (const char* serverConfigFile, Rok4Server* oldServe
 
         if ( ! ConfLoader::buildTMSList ( newServerXML ) ) {
             LOGGER_FATAL ( _ ( "Impossible de charger la conf des TileMatrix" ) );
-            LOGGER_FATAL ( _ ( "Extinction du serveur ROK4" ) );
-            sleep ( 1 );    // Pour laisser le temps au logger pour se vider
-            return NULL;
+            return abortReload ( newServerXML, newServicesXML, oldServerXML );
         }
 
     } else {
 
-        //Copie de l'ancien serveur
-        std::map<std::string,TileMatrixSet* >::iterator lv;
+        //Lecture du dossier : on reprend ce qui n'a pas changé et on charge le reste
+        listOfFile = ConfLoader::listFileFromDir(newServerXML->getTmsDir(), ".tms");
 
-        for (lv = oldServer->getTmsList().begin(); lv != oldServer->getTmsList().end(); lv++) {
-            TileMatrixSet* tms = new TileMatrixSet(lv->second);
-            newServerXML->addTMS(tms);
+        if (listOfFile.size() == 0) {
+            //aucun fichier dans le dossier
+            LOGGER_FATAL ( "Aucun fichier .tms dans le dossier " << newServerXML->getTmsDir() );
+            return abortReload ( newServerXML, newServicesXML, oldServerXML );
         }
 
-        //Lecture du dossier et chargement de ce qui a changé
-        listOfFile = ConfLoader::listFileFromDir(newServerXML->getTmsDir(), ".tms");
-        std::vector<std::string> listOfFileNames;
-
-        if (listOfFile.size() != 0) {
-            for (unsigned i=0; i<listOfFile.size(); i++) {
-                lastMod = ConfLoader::getLastModifiedDate(listOfFile[i]);
-                fileName = ConfLoader::getFileName(listOfFile[i],".tms");
-                listOfFileNames.push_back(fileName);
-
-                if (lastMod > lastReload) {
-                    //fichier modifié, on le recharge
-                    TileMatrixSet* tms = ConfLoader::buildTileMatrixSet ( listOfFile[i] );
-
-                    // Que le TMS soit correct ou non, on supprime l'ancien de la liste
-                    newServerXML->removeTMS(fileName);
-
-                    if (tms != NULL) {
-                        newServerXML->addTMS(tms);
-                    } else {
-                        LOGGER_ERROR("Impossible de charger " << listOfFile[i]);
-                    }
-
-                } else {
-                    //fichier non modifié
-                    if (newServerXML->getTMS(fileName) == NULL) {
-                        // mais qui n'était pas là au dernier chargement
-                        // ça peut arriver lors d'une copie ou d'un déplacement du fichier (les dates ne sont pas modifiées)
-                        TileMatrixSet* tms = ConfLoader::buildTileMatrixSet ( listOfFile[i] );
-
-                        if (tms != NULL) {
-                            newServerXML->addTMS(tms);
-                        } else {
-                            LOGGER_ERROR("Impossible de charger " << listOfFile[i]);
-                        }
-                    }
-                }
+        for (unsigned i=0; i<listOfFile.size(); i++) {
+            lastMod = ConfLoader::getLastModifiedDate(listOfFile[i]);
+            fileName = ConfLoader::getFileName(listOfFile[i],".tms");
+
+            TileMatrixSet* oldTms = oldServerXML->getTMS(fileName);
+            if (oldTms != NULL && lastMod <= lastReload) {
+                // fichier non modifié, l'objet est partagé
+                newServerXML->addTMS(oldTms);
+                continue;
+            }
+
+            // fichier modifié, ou absent au dernier chargement (copie ou déplacement, les dates ne sont pas modifiées)
+            if (oldTms != NULL) changedTms.insert(fileName);
+
+            TileMatrixSet* tms = ConfLoader::buildTileMatrixSet ( listOfFile[i] );
+            if (tms != NULL) {
+                newServerXML->addTMS(tms);
+            } else {
+                LOGGER_ERROR("Impossible de charger " << listOfFile[i]);
             }
-        } else {
-            //aucun fichier dans le dossier
-            LOGGER_FATAL ( "Aucun fichier .tms dans le dossier " << newServerXML->getTmsDir() );
-            sleep ( 1 );    // Pour laisser le temps au logger pour se vider
-            return NULL;
         }
+    }
 
-        // On supprime de la liste des TMS tous ceux dont l'id ne se retrouve pas dans la liste des noms de fichiers
-        newServerXML->cleanTMSs(listOfFileNames);
+    // Tous les TMS de l'ancienne configuration qui ne sont pas repris sont considérés comme modifiés
+    std::map<std::string,TileMatrixSet* >::iterator itTms;
+    for (itTms = oldServer->getTmsList().begin(); itTms != oldServer->getTmsList().end(); itTms++) {
+        if (newServerXML->getTMS(itTms->first) != itTms->second) changedTms.insert(itTms->first);
     }
 
     //--- STYLES
     LOGGER_DEBUG("Rechargement des styles");
 
-    if (newServerXML->getStylesDir() != oldServer->getServerConf()->getStylesDir()) {
+    if (newServerXML->getStylesDir() != oldServerXML->getStylesDir()) {
         // Le dossier des styles a changé
         // on recharge tout comme à l'initialisation
         
@@ -290,75 +345,52 @@ Rok4Server* rok4ReloadServer (const char* serverConfigFile, Rok4Server* oldServe
 
         if ( ! ConfLoader::buildStylesList ( newServerXML, newServicesXML ) ) {
             LOGGER_FATAL ( _ ( "Impossible de charger la conf des styles" ) );
-            LOGGER_FATAL ( _ ( "Extinction du serveur ROK4" ) );
-            sleep ( 1 );    // Pour laisser le temps au logger pour se vider
-            return NULL;
+            return abortReload ( newServerXML, newServicesXML, oldServerXML );
         }
 
     } else {
 
-        //Copie de l'ancien serveur
-        std::map<std::string,Style* >::iterator lv;
-
-        for (lv = oldServer->getStylesList().begin(); lv != oldServer->getStylesList().end(); lv++) {
-            Style* sty = new Style(lv->second);
-            newServerXML->addStyle(sty);
-        }
-
-        //Lecture du dossier et chargement de ce qui a changé
+        //Lecture du dossier : on reprend ce qui n'a pas changé et on charge le reste
         listOfFile = ConfLoader::listFileFromDir(newServerXML->getStylesDir(), ".stl");
-        std::vector<std::string> listOfFileNames;
-
-        if (listOfFile.size() != 0) {
-            for (unsigned i=0; i<listOfFile.size(); i++) {
-                lastMod = ConfLoader::getLastModifiedDate(listOfFile[i]);
-                fileName = ConfLoader::getFileName(listOfFile[i],".stl");
-                listOfFileNames.push_back(fileName);
-
-                if (lastMod > lastReload) {
-                    //fichier modifié, on le recharge
-                    Style* sty = ConfLoader::buildStyle ( listOfFile[i], newServicesXML );
-
-                    // Que le style soit correct ou non, on supprime l'ancien de la liste
-                    newServerXML->removeStyle(fileName);
-
-                    if (sty != NULL) {
-                        newServerXML->addStyle(sty);
-                    } else {
-                        LOGGER_ERROR("Impossible de charger " << listOfFile[i]);
-                    }
-
-                } else {
-                    //fichier non modifié
-                    if (newServerXML->getStyle(fileName) == NULL) {
-                        // mais qui n'était pas là au dernier chargement
-                        // ça peut arriver lors d'une copie ou d'un déplacement du fichier (les dates ne sont pas modifiées)
-                        Style* sty = ConfLoader::buildStyle ( listOfFile[i], newServicesXML );
-
-                        if (sty != NULL) {
-                            newServerXML->addStyle(sty);
-                        } else {
-                            LOGGER_ERROR("Impossible de charger " << listOfFile[i]);
-                        }
-                    }
-                }
-            }
-        } else {
+
+        if (listOfFile.size() == 0) {
             //aucun fichier dans le dossier
             LOGGER_FATAL ( "Aucun fichier .stl dans le dossier " << newServerXML->getStylesDir() );
-            sleep ( 1 );    // Pour laisser le temps au logger pour se vider
-            return NULL;
+            return abortReload ( newServerXML, newServicesXML, oldServerXML );
         }
 
-        // On supprime de la liste des styles tous ceux dont l'id ne se retrouve pas dans la liste des noms de fichiers
-        newServerXML->cleanStyles(listOfFileNames);
+        for (unsigned i=0; i<listOfFile.size(); i++) {
+            lastMod = ConfLoader::getLastModifiedDate(listOfFile[i]);
+            fileName = ConfLoader::getFileName(listOfFile[i],".stl");
+
+            Style* oldSty = oldServerXML->getStyle(fileName);
+            if (oldSty != NULL && lastMod <= lastReload && ! servicesModified) {
+                // fichier non modifié, l'objet est partagé
+                newServerXML->addStyle(oldSty);
+                continue;
+            }
+
+            Style* sty = ConfLoader::buildStyle ( listOfFile[i], newServicesXML );
+            if (sty != NULL) {
+                newServerXML->addStyle(sty);
+            } else {
+                LOGGER_ERROR("Impossible de charger " << listOfFile[i]);
+            }
+        }
     }
 
+    // Tous les styles de l'ancienne configuration qui ne sont pas repris sont considérés comme modifiés
+    std::map<std::string,Style* >::iterator itSty;
+    for (itSty = oldServer->getStylesList().begin(); itSty != oldServer->getStylesList().end(); itSty++) {
+        if (newServerXML->getStyle(itSty->first) != itSty->second) changedStyles.insert(itSty->first);
+    }
 
     //--- Layers
     LOGGER_DEBUG("Rechargement des Layers");
 
-    if (newServerXML->getLayersDir() != oldServer->getServerConf()->getLayersDir()) {
+    int nbShared = 0, nbCloned = 0, nbBuilt = 0;
+
+    if (newServerXML->getLayersDir() != oldServerXML->getLayersDir()) {
         // Le dossier des layers a changé
         // on recharge tout comme à l'initialisation
 
@@ -366,101 +398,75 @@ Rok4Server* rok4ReloadServer (const char* serverConfigFile, Rok4Server* oldServe
 
         if ( ! ConfLoader::buildLayersList ( newServerXML, newServicesXML ) ) {
             LOGGER_FATAL ( _ ( "Impossible de charger la conf des Layers" ) );
-            LOGGER_FATAL ( _ ( "Extinction du serveur ROK4" ) );
-            sleep ( 1 );    // Pour laisser le temps au logger pour se vider
-            return NULL;
+            return abortReload ( newServerXML, newServicesXML, oldServerXML );
         }
+        nbBuilt = newServerXML->getNbLayers();
 
     } else {
 
-        LOGGER_DEBUG("Copie des anciens layers");
-        //Copie de l'ancien serveur
-        std::map<std::string,Layer* >::iterator lv;
+        LOGGER_DEBUG("Lecture du dossier");
 
-        for (lv = oldServer->getLayerList().begin(); lv != oldServer->getLayerList().end(); lv++) {
-            Layer* lay = new Layer(lv->second, newServerXML );
-            if (lay->getDataPyramid() == NULL) {
-                LOGGER_ERROR("Impossible de cloner le layer " << lv->first);
-                delete lay;
-            } else {
-                newServerXML->addLayer(lay);
-            }
+        //Lecture du dossier : on reprend ce qui n'a pas changé et on charge le reste
+        listOfFile = ConfLoader::listFileFromDir(newServerXML->getLayersDir(), ".lay");
+
+        if (listOfFile.size() == 0) {
+            //aucun fichier dans le dossier
+            LOGGER_FATAL ( "Aucun fichier .lay dans le dossier " << newServerXML->getLayersDir() );
+            return abortReload ( newServerXML, newServicesXML, oldServerXML );
         }
 
-        LOGGER_DEBUG("Lecture du dossier");
+        for (unsigned i=0; i<listOfFile.size(); i++) {
+            lastMod = ConfLoader::getLastModifiedDate(listOfFile[i]);
+            fileName = ConfLoader::getFileName(listOfFile[i],".lay");
 
-        //Lecture du dossier et chargement de ce qui a changé
-        listOfFile = ConfLoader::listFileFromDir(newServerXML->getLayersDir(), ".lay");
-        std::vector<std::string> listOfFileNames;
-
-        if (listOfFile.size() != 0) {
-            for (unsigned i=0; i<listOfFile.size(); i++) {
-                lastMod = ConfLoader::getLastModifiedDate(listOfFile[i]);
-                fileName = ConfLoader::getFileName(listOfFile[i],".lay");
-                listOfFileNames.push_back(fileName);
-
-                if (lastMod > lastReload) {
-                    //fichier modifié, on le recharge
-                    Layer* lay = ConfLoader::buildLayer ( listOfFile[i], newServerXML, newServicesXML );
-
-                    // Que le layer soit correct ou non, on supprime l'ancien de la liste
-                    newServerXML->removeLayer(fileName);
-
-                    if (lay != NULL) {
-                        newServerXML->addLayer(lay);
-                    } else {
-                        LOGGER_ERROR("Impossible de charger " << listOfFile[i]);
-                    }
-
-                } else {
-                    //fichier non modifié
-                    LOGGER_DEBUG("Fichier layer non modifie");
-                    Layer* lay = newServerXML->getLayer(fileName);
-                    if (lay == NULL) {
-                        // mais qui n'était pas là au dernier chargement
-                        // ça peut arriver lors d'une copie ou d'un déplacement du fichier (les dates ne sont pas modifiées)
-                        Layer* l = ConfLoader::buildLayer ( listOfFile[i], newServerXML, newServicesXML );
-
-                        if (l != NULL) {
-                            newServerXML->addLayer(l);
-                        } else {
-                            LOGGER_ERROR("Impossible de charger " << listOfFile[i]);
-                        }
-                    } else {
-
-                        //on teste si le .pyr a changé
-                        std::string strPyrFile = lay->getDataPyramidFilePath();
-
-                        LOGGER_DEBUG("Verification du fichier pyr" << strPyrFile);
-                        lastMod = ConfLoader::getLastModifiedDate(strPyrFile);
-
-                        if (lastMod > lastReload) {
-                            // fichier modifié
-                            Layer* lay = ConfLoader::buildLayer ( listOfFile[i], newServerXML, newServicesXML );
-
-                            newServerXML->removeLayer(fileName);
-
-                            if (lay != NULL) {
-                                newServerXML->addLayer(lay);
-                            } else {
-                                LOGGER_ERROR("Impossible de charger le layer " << listOfFile[i]);
-                            }
-                        }
-                    }
+            Layer* oldLay = oldServerXML->getLayer(fileName);
+
+            if (oldLay != NULL && lastMod <= lastReload && ! servicesModified &&
+                ConfLoader::getLastModifiedDate(oldLay->getDataPyramidFilePath()) <= lastReload) {
+
+                if ( ! layerDependsOn ( oldLay, changedTms, changedStyles ) ) {
+                    // ni la couche, ni sa pyramide, ni les objets utilisés n'ont changé : l'objet est partagé
+                    newServerXML->addLayer(oldLay);
+                    nbShared++;
+                    continue;
+                }
+
+                // Un TMS ou un style utilisé a changé : on clone la couche pour pointer sur les nouveaux objets
+                LOGGER_DEBUG("Layer " << fileName << " clone, un TMS ou un style utilise a change");
+                Layer* lay = new Layer(oldLay, newServerXML );
+                if (lay->getDataPyramid() != NULL) {
+                    newServerXML->addLayer(lay);
+                    nbCloned++;
+                    continue;
                 }
+                LOGGER_ERROR("Impossible de cloner le layer " << fileName);
+                delete lay;
+            }
 
+            // fichier modifié, ou absent au dernier chargement (copie ou déplacement, les dates ne sont pas modifiées)
+            Layer* lay = ConfLoader::buildLayer ( listOfFile[i], newServerXML, newServicesXML );
+            if (lay != NULL) {
+                newServerXML->addLayer(lay);
+                nbBuilt++;
+            } else {
+                LOGGER_ERROR("Impossible de charger " << listOfFile[i]);
             }
-        } else {
-            //aucun fichier dans le dossier
-            LOGGER_FATAL ( "Aucun fichier .lay dans le dossier " << newServerXML->getLayersDir() );
-            sleep ( 1 );    // Pour laisser le temps au logger pour se vider
-            return NULL;
         }
+    }
 
-        // On supprime de la liste des layers tous ceux dont l'id ne se retrouve pas dans la liste des noms de fichiers
-        newServerXML->cleanLayers(listOfFileNames);
+    LOGGER_INFO ( "Rechargement : " << nbShared << " layers conserves, " << nbCloned << " clones, " << nbBuilt << " charges" );
+
+    // La nouvelle configuration est valide : ses contextes rejoignent l'ancien annuaire, qu'elle reprend
+    ContextBook* book = oldServerXML->getContextBook();
+    newServerXML->getContextBook()->transferTo ( book );
+    newServerXML->setContextBook ( book );
+    if ( newServerXML->getMergingGap() != oldServerXML->getMergingGap() ) {
+        book->setMergingGap ( newServerXML->getMergingGap() );
     }
 
+    // Les objets repris ne seront pas détruits avec l'ancienne configuration
+    newServerXML->takeOwnership ( oldServerXML );
+
     LOGGER_DEBUG("Arret du logger");
     Logger::stopLogger();
     LOGGER_DEBUG("Logger arrete");
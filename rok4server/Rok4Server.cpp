@@ -87,12 +87,14 @@
 #include "ProcessFactory.h"
 #include "Rok4Image.h"
 #include "EmptyImage.h"
+#include "MetatileImage.h"
 #include "FileContext.h"
 #include "PenteImage.h"
 #include "Pente.h"
 #include "AspectImage.h"
 #include "Aspect.h"
 #include "ConvertedChannelsImage.h"
+#include "Metrics.h"
 #include <thread>         // std::this_thread::sleep_for
 #include <chrono>         // std::chrono::second
 
@@ -106,12 +108,34 @@ void hangleSIGALARM(int id) {
 void* Rok4Server::thread_loop ( void* arg ) {
     Rok4Server* server = ( Rok4Server* ) ( arg );
     FCGX_Request fcgxRequest;
+
+    // Le rechargement est traité par le thread principal : l'attente des requêtes ne doit pas être interrompue
+    sigset_t signals;
+    sigemptyset ( &signals );
+    sigaddset ( &signals, SIGHUP );
+    sigaddset ( &signals, SIGUSR1 );
+    pthread_sigmask ( SIG_BLOCK, &signals, NULL );
+
+    if ( server->frontEnd ) {
+        // Frontal HTTP : les connexions sont gérées par la boucle d'événements, le thread ne reçoit que des requêtes complètes
+        while ( server->isRunning() ) {
+            HttpConnection* conn = server->frontEnd->nextRequest ( fcgxRequest );
+            if ( ! conn ) break;
+
+            server->handleRequest ( fcgxRequest );
+            server->frontEnd->finishRequest ( conn );
+        }
+
+        LOGGER_DEBUG ( _ ( "Extinction du thread" ) );
+        Logger::stopLogger();
+        return 0;
+    }
+
     if ( FCGX_InitRequest ( &fcgxRequest, server->sock, FCGI_FAIL_ACCEPT_ON_INTR ) != 0 ) {
         LOGGER_FATAL ( _ ( "Le listener FCGI ne peut etre initialise" ) );
     }
 
     while ( server->isRunning() ) {
-        std::string content;
 
         int rc;
         if ( ( rc=FCGX_Accept_r ( &fcgxRequest ) ) < 0 ) {
@@ -125,64 +149,100 @@ void* Rok4Server::thread_loop ( void* arg ) {
             break;
         }
 
-        LOGGER_DEBUG("Thread " << pthread_self() << " traite une requete");
+        server->handleRequest ( fcgxRequest );
 
-        bool postRequest = false;
-        if (server->servicesConf->isPostEnabled() && strcmp ( FCGX_GetParam ( "REQUEST_METHOD",fcgxRequest.envp ),"POST" ) == 0) {
-            postRequest = true;
-        }
+        FCGX_Finish_r ( &fcgxRequest );
+        FCGX_Free ( &fcgxRequest,1 );
+    }
 
-        Request* request;
-        if ( postRequest ) { // Post Request
-            char* contentBuffer = ( char* ) malloc ( sizeof ( char ) *200 );
-            while ( FCGX_GetLine ( contentBuffer,200,fcgxRequest.in ) ) {
-                content.append ( contentBuffer );
-            }
-            free ( contentBuffer );
-            contentBuffer= NULL;
-            LOGGER_DEBUG ( _ ( "Request Content :" ) << std::endl << content );
-            request = new Request (
-                FCGX_GetParam ( "QUERY_STRING", fcgxRequest.envp ),
-                FCGX_GetParam ( "HTTP_HOST", fcgxRequest.envp ),
-                FCGX_GetParam ( "SCRIPT_NAME", fcgxRequest.envp ),
-                FCGX_GetParam ( "HTTPS", fcgxRequest.envp ),
-                content
-            );
-        } else { // Get Request
-
-            /* On espère récupérer le nom du host tel qu'il est exprimé dans la requete avec HTTP_HOST.
-             * De même, on espère récupérer le path tel qu'exprimé dans la requête avec SCRIPT_NAME.
-             */
-
-            request = new Request ( 
-                FCGX_GetParam ( "QUERY_STRING", fcgxRequest.envp ),
-                FCGX_GetParam ( "HTTP_HOST", fcgxRequest.envp ),
-                FCGX_GetParam ( "SCRIPT_NAME", fcgxRequest.envp ),
-                FCGX_GetParam ( "HTTPS", fcgxRequest.envp )
-            );
-        }
+    LOGGER_DEBUG ( _ ( "Extinction du thread" ) );
+    Logger::stopLogger();
+    return 0;
+}
 
-        server->processRequest ( request, fcgxRequest );
-        delete request;
+void Rok4Server::handleRequest ( FCGX_Request& fcgxRequest ) {
+    std::string content;
 
-        FCGX_Finish_r ( &fcgxRequest );
-        FCGX_Free ( &fcgxRequest,1 );
+    LOGGER_DEBUG("Thread " << pthread_self() << " traite une requete");
+
+    // La configuration utilisée est celle en place à la réception de la requête, jusqu'à sa fin
+    Rok4Server* current = acquireServer();
 
-        LOGGER_DEBUG("Thread " << pthread_self() << " en a fini avec la requete");
+    // Exposition des métriques, en dehors des services
+    std::string metricsPath = current->serverConf->getMetricsPath();
+    const char* scriptName = FCGX_GetParam ( "SCRIPT_NAME", fcgxRequest.envp );
+    if ( ! metricsPath.empty() && scriptName && metricsPath == scriptName ) {
+        S.sendresponse ( new MessageDataStream ( Metrics::toPrometheus(), "text/plain; version=0.0.4" ), &fcgxRequest );
+        releaseServer ( current );
+        return;
+    }
 
-        server->parallelProcess->checkCurrentPid();
+    bool postRequest = false;
+    if (current->servicesConf->isPostEnabled() && strcmp ( FCGX_GetParam ( "REQUEST_METHOD",fcgxRequest.envp ),"POST" ) == 0) {
+        postRequest = true;
+    }
 
+    Request* request;
+    if ( postRequest ) { // Post Request
+        char* contentBuffer = ( char* ) malloc ( sizeof ( char ) *200 );
+        while ( FCGX_GetLine ( contentBuffer,200,fcgxRequest.in ) ) {
+            content.append ( contentBuffer );
+        }
+        free ( contentBuffer );
+        contentBuffer= NULL;
+        LOGGER_DEBUG ( _ ( "Request Content :" ) << std::endl << content );
+        request = new Request (
+            FCGX_GetParam ( "QUERY_STRING", fcgxRequest.envp ),
+            FCGX_GetParam ( "HTTP_HOST", fcgxRequest.envp ),
+            FCGX_GetParam ( "SCRIPT_NAME", fcgxRequest.envp ),
+            FCGX_GetParam ( "HTTPS", fcgxRequest.envp ),
+            content
+        );
+    } else { // Get Request
+
+        /* On espère récupérer le nom du host tel qu'il est exprimé dans la requete avec HTTP_HOST.
+         * De même, on espère récupérer le path tel qu'exprimé dans la requête avec SCRIPT_NAME.
+         */
+
+        request = new Request ( 
+            FCGX_GetParam ( "QUERY_STRING", fcgxRequest.envp ),
+            FCGX_GetParam ( "HTTP_HOST", fcgxRequest.envp ),
+            FCGX_GetParam ( "SCRIPT_NAME", fcgxRequest.envp ),
+            FCGX_GetParam ( "HTTPS", fcgxRequest.envp )
+        );
     }
 
-    LOGGER_DEBUG ( _ ( "Extinction du thread" ) );
-    Logger::stopLogger();
-    return 0;
+    request->acceptGzip = Request::acceptsEncoding ( FCGX_GetParam ( "HTTP_ACCEPT_ENCODING", fcgxRequest.envp ), "gzip" );
+
+    // Les requêtes coûteuses au delà des limites de concurrence sont refusées plutôt que d'occuper tous les threads
+    std::vector<AdmissionBudget> budgets;
+    int maxOccupied = 0;
+    bool controlled = current->getAdmissionBudgets ( request, budgets, maxOccupied );
+
+    if ( controlled && ! admission.admit ( budgets, maxOccupied, current->servicesConf->getQueueTimeout() ) ) {
+        LOGGER_DEBUG ( _ ( "Requete refusee par le controle d'admission" ) );
+        S.sendresponse ( new SERDataSource ( new ServiceException (
+            "", HTTP_SERVICE_UNAVAILABLE, _ ( "Le serveur est trop charge pour traiter cette requete" ),
+            ( request->service == ServiceType::WMS ) ? "wms" : "wmts"
+        ) ), &fcgxRequest, current->servicesConf->getRetryAfter() );
+    } else {
+        current->processRequest ( request, fcgxRequest );
+        if ( controlled ) admission.release ( budgets );
+    }
+
+    delete request;
+    releaseServer ( current );
+
+    LOGGER_DEBUG("Thread " << pthread_self() << " en a fini avec la requete");
+
+    parallelProcess->checkCurrentPid();
 }
 
 Rok4Server::Rok4Server (  ServerXML* serverXML, ServicesXML* servicesXML) {
     
 
     sock = 0;
+    frontEnd = NULL;
     servicesConf = servicesXML;
     serverConf = serverXML;
 
@@ -190,6 +250,11 @@ Rok4Server::Rok4Server (  ServerXML* serverXML, ServicesXML* servicesXML) {
 
     running = false;
 
+    current = this;
+    readers = 0;
+    pthread_mutex_init ( &currentMutex, NULL );
+    pthread_cond_init ( &currentCond, NULL );
+
     if ( serverConf->supportWMS ) {
         LOGGER_DEBUG ( _ ( "Build WMS Capabilities 1.3.0" ) );
         buildWMS130Capabilities();
@@ -218,49 +283,209 @@ Rok4Server::Rok4Server (  ServerXML* serverXML, ServicesXML* servicesXML) {
 
 Rok4Server::~Rok4Server() {
 
+    if ( current != this ) {
+        // Le dernier serveur basculé partage la gestion des processus de celui ci
+        current->parallelProcess = NULL;
+        delete current;
+    }
+
     delete serverConf;
     delete servicesConf;
 
     delete parallelProcess;
     parallelProcess = NULL;
+
+    delete frontEnd;
+
+    pthread_mutex_destroy ( &currentMutex );
+    pthread_cond_destroy ( &currentCond );
 }
 
-void Rok4Server::initFCGI() {
+bool Rok4Server::initFCGI() {
     int init=FCGX_Init();
-    if ( ! serverConf->socket.empty() ) {
+    if ( ! serverConf->getHttpListen().empty() ) {
+        // Les clients sont servis directement en HTTP, sans socket FastCGI : sans écoute HTTP, le serveur ne doit pas démarrer
+        frontEnd = new HttpFrontEnd ( serverConf->getHttpListen(), serverConf->getHttpKeepAlive() );
+        if ( ! frontEnd->open ( serverConf->backlog ) ) {
+            LOGGER_FATAL ( _ ( "Le frontal HTTP ne peut etre initialise" ) );
+            delete frontEnd;
+            frontEnd = NULL;
+            return false;
+        }
+    } else if ( ! serverConf->socket.empty() ) {
         LOGGER_INFO ( _ ( "Listening on " ) << serverConf->socket );
         sock = FCGX_OpenSocket ( serverConf->socket.c_str(), serverConf->backlog );
     }
+    return true;
 }
 
-void Rok4Server::run(sig_atomic_t signal_pending) {
+void Rok4Server::run() {
     running = true;
 
+    if ( frontEnd ) frontEnd->start();
+
     for ( int i = 0; i < threads.size(); i++ ) {
         pthread_create ( & ( threads[i] ), NULL, Rok4Server::thread_loop, ( void* ) this );
     }
-    
-    if (signal_pending != 0 ) {
-        raise( signal_pending );
-    }
-    
-    for ( int i = 0; i < threads.size(); i++ )
-        pthread_join ( threads[i], NULL );
 }
 
 void Rok4Server::terminate() {
     running = false;
 
+    // Arrêt de la boucle d'événements HTTP, les threads en attente de requête sont réveillés
+    if ( frontEnd ) frontEnd->stop();
+
     // Terminate FCGI Thread
     for ( int i = 0; i < threads.size(); i++ ) {
         pthread_kill ( threads[i], SIGQUIT );
     }
 
+    for ( unsigned int i = 0; i < threads.size(); i++ )
+        pthread_join ( threads[i], NULL );
+
+    CurlPool::printNumCurls();
     CurlPool::cleanCurlPool();
 }
 
+Rok4Server* Rok4Server::acquireServer() {
+    pthread_mutex_lock ( &currentMutex );
+    Rok4Server* server = current;
+    server->readers++;
+    pthread_mutex_unlock ( &currentMutex );
+    return server;
+}
+
+void Rok4Server::releaseServer ( Rok4Server* server ) {
+    pthread_mutex_lock ( &currentMutex );
+    server->readers--;
+    if ( server != current && server->readers == 0 ) {
+        pthread_cond_broadcast ( &currentCond );
+    }
+    pthread_mutex_unlock ( &currentMutex );
+}
+
+Rok4Server* Rok4Server::getCurrentServer() {
+    pthread_mutex_lock ( &currentMutex );
+    Rok4Server* server = current;
+    pthread_mutex_unlock ( &currentMutex );
+    return server;
+}
+
+void Rok4Server::switchServer ( Rok4Server* newServer ) {
+
+    // Les processus lancés pour les niveaux à la demande restent gérés par le serveur propriétaire des threads
+    if ( newServer->parallelProcess != parallelProcess ) {
+        delete newServer->parallelProcess;
+        newServer->parallelProcess = parallelProcess;
+    }
+
+    pthread_mutex_lock ( &currentMutex );
+    Rok4Server* old = current;
+    current = newServer;
+    // Les nouvelles requêtes sont déjà traitées par le nouveau serveur, on attend la fin de celles de l'ancien
+    while ( old->readers > 0 ) {
+        pthread_cond_wait ( &currentCond, &currentMutex );
+    }
+    pthread_mutex_unlock ( &currentMutex );
+
+    LOGGER_INFO ( _ ( "Bascule sur la nouvelle configuration terminee" ) );
+
+    if ( old == this ) {
+        // On garde les threads et le socket, seule la configuration initiale est détruite
+        delete serverConf;
+        serverConf = NULL;
+        delete servicesConf;
+        servicesConf = NULL;
+        wmsCapaFrag.clear();
+        wmtsCapaFrag.clear();
+        tmsCapaFrag.clear();
+        tmsLayerFrag.clear();
+        tmsMetadataFrag.clear();
+    } else {
+        old->parallelProcess = NULL;
+        delete old;
+    }
+}
+
+std::string Rok4Server::getMetricsLayer ( Request* request ) {
+    std::string name = request->getParam ( "layer" );
+    if ( name.empty() ) name = request->getParam ( "layers" );
+    if ( name.empty() ) return "";
+    if ( name.find ( ',' ) != std::string::npos ) return "multiple";
+    // Les valeurs libres fournies par les clients ne doivent pas créer de nouvelles métriques
+    if ( serverConf->getLayer ( name ) == NULL ) return "unknown";
+    return name;
+}
+
+bool Rok4Server::getAdmissionBudgets ( Request* request, std::vector<AdmissionBudget>& budgets, int& maxOccupied ) {
+    if ( ! servicesConf->isAdmissionControlled() ) return false;
+
+    if ( request->request != RequestType::GETMAP && request->request != RequestType::GETTILE &&
+         request->request != RequestType::GETFEATUREINFO ) {
+        return false;
+    }
+
+    std::string names;
+    if ( request->service == ServiceType::TMS ) {
+        // .../1.0.0/{layer}/{z}/{x}/{y}.{ext}
+        names = request->tms.layer;
+    } else if ( request->request == RequestType::GETTILE ) {
+        names = request->getParam ( "layer" );
+    } else if ( request->request == RequestType::GETFEATUREINFO ) {
+        names = request->getParam ( "query_layers" );
+        if ( names.empty() ) names = request->getParam ( "layer" );
+    } else {
+        names = request->getParam ( "layers" );
+    }
+
+    std::vector<std::string> layers;
+    std::stringstream ss ( names );
+    std::string name;
+    while ( std::getline ( ss, name, ',' ) ) {
+        if ( serverConf->getLayer ( name ) == NULL ) continue;
+        if ( std::find ( layers.begin(), layers.end(), name ) != layers.end() ) continue;
+        layers.push_back ( name );
+    }
+
+    if ( request->request == RequestType::GETTILE ) {
+        // Une tuile pré-calculée dans le format des données est une simple lecture : voie prioritaire.
+        // Une tuile dans un format de transcodage est décodée puis réencodée, elle est aussi coûteuse qu'une tuile à la demande
+        bool transcoding = false;
+        if ( ! layers.empty() ) {
+            Layer* layer = serverConf->getLayer ( layers.front() );
+            if ( request->service == ServiceType::TMS ) {
+                transcoding = ! getTMSTranscodingFormat ( layer, request->tms.extension ).empty();
+            } else {
+                transcoding = layer->isTranscodingFormat ( request->getParam ( "format" ) );
+            }
+        }
+        if ( layers.empty() || ( ! transcoding && ! serverConf->getLayer ( layers.front() )->getDataPyramid()->getContainOdLevels() ) ) {
+            Metrics::count ( "rok4_admission_total", Metrics::label ( "result", "priority" ) );
+            return false;
+        }
+    }
+
+    std::string operation = RequestType::toString ( request->request );
+    int limit = servicesConf->getOperationConcurrencyLimit ( operation );
+    if ( limit > 0 ) budgets.push_back ( AdmissionBudget ( "operation:" + operation, limit ) );
+
+    for ( unsigned int i = 0; i < layers.size(); i++ ) {
+        limit = servicesConf->getLayerConcurrencyLimit ( layers.at(i) );
+        if ( limit > 0 ) budgets.push_back ( AdmissionBudget ( "layer:" + layers.at(i), limit ) );
+    }
+
+    maxOccupied = 0;
+    if ( servicesConf->getReservedThreads() > 0 ) {
+        maxOccupied = std::max ( 1, serverConf->getNbThreads() - servicesConf->getReservedThreads() );
+    }
+
+    return true;
+}
 
 DataStream* Rok4Server::getMap ( Request* request ) {
+    // Construction de la chaîne de traitement : la lecture, le décodage et l'encodage, différés, sont mesurés lors de l'envoi
+    MetricsTimer timer ( Metrics::getStage ( "getmap_build", "layer", getMetricsLayer ( request ) ) );
+
     std::vector<Layer*> layers;
     BoundingBox<double> bbox ( 0.0, 0.0, 0.0, 0.0 );
     int width, height, dpi;
@@ -280,6 +505,7 @@ DataStream* Rok4Server::getMap ( Request* request ) {
 
     int error;
     Image* image;
+    bool constant = ( layers.size() == 1 );
     for ( int i = 0 ; i < layers.size(); i ++ ) {
 
             Image* curImage = layers.at ( i )->getbbox ( servicesConf, bbox, width, height, crs, dpi, error );
@@ -301,6 +527,7 @@ DataStream* Rok4Server::getMap ( Request* request ) {
 
             curImage->setBbox(bbox);
             curImage->setCRS(crs);
+            constant = constant && curImage->isConstant();
             Rok4Format::eformat_data pyrType = layers.at ( i )->getDataPyramid()->getFormat();
             Style* style = styles.at(i);
             LOGGER_DEBUG ( _ ( "GetMap de Style : " ) << styles.at ( i )->getId() << _ ( " pal size : " ) <<styles.at ( i )->getPalette()->getPalettePNGSize() );
@@ -322,7 +549,17 @@ DataStream* Rok4Server::getMap ( Request* request ) {
 
     image = mergeImages(images, pyrType, style, crs, bbox);
 
-    DataStream * stream = formatImage(image, format, pyrType, format_option, layers.size(), style);
+    if ( constant && isEmptyResponseReusable ( format, style ) ) {
+        // Aucune donnée dans l'emprise : la réponse ne dépend que du style, du format et des dimensions
+        std::ostringstream key;
+        key << "getmap|" << style->getId() << "|" << format << "|" << width << "x" << height;
+        for ( std::map<std::string, std::string>::iterator it = format_option.begin(); it != format_option.end(); it++ ) {
+            key << "|" << it->first << "=" << it->second;
+        }
+        return formatEmptyImage ( layers.at ( 0 ), key.str(), image, format, pyrType, format_option, layers.size(), style );
+    }
+
+    DataStream * stream = formatImage(layers.at ( 0 ), image, format, pyrType, format_option, layers.size(), style);
 
     return stream;
 }
@@ -562,7 +799,7 @@ Image * Rok4Server::mergeImages(std::vector<Image*> images, Rok4Format::eformat_
 
 }
 
-DataStream * Rok4Server::formatImage(Image *image, std::string format, Rok4Format::eformat_data pyrType,
+DataStream * Rok4Server::formatImage(Layer* layer, Image *image, std::string format, Rok4Format::eformat_data pyrType,
                                      std::map <std::string, std::string > format_option,
                                      int size, Style *style) {
 
@@ -625,7 +862,7 @@ DataStream * Rok4Server::formatImage(Image *image, std::string format, Rok4Forma
             return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_RAW_INT8, isGeoTiff );
         }
     } else if ( format == "image/jpeg" ) {
-        return new JPEGEncoder ( image );
+        return new JPEGEncoder ( image, layer->getJpegOptions() );
     } else if ( format == "image/x-bil;bits=32" ) {
         return new BilEncoder ( image );
     } else if ( format == "text/asc" ) {
@@ -643,6 +880,47 @@ DataStream * Rok4Server::formatImage(Image *image, std::string format, Rok4Forma
 
 }
 
+bool Rok4Server::isEmptyResponseReusable ( std::string format, Style* style ) {
+    if ( format != "image/png" && format != "image/jpeg" && format != "image/tiff" && format != "image/x-bil;bits=32" ) {
+        return false;
+    }
+    if ( style && ( style->isEstompage() || style->isPente() || style->isAspect() ) ) {
+        return false;
+    }
+    return true;
+}
+
+DataStream * Rok4Server::formatEmptyImage(Layer* layer, std::string key, Image *image, std::string format, Rok4Format::eformat_data pyrType,
+                                          std::map <std::string, std::string > format_option,
+                                          int size, Style *style) {
+
+    std::string type, data;
+    if ( layer->getEmptyResponse ( key, type, data ) ) {
+        delete image;
+        Metrics::count ( "rok4_empty_responses_total", Metrics::label ( "result", "hit" ) );
+        return new RawDataStream ( ( uint8_t* ) data.data(), data.size(), type, "", data.size() );
+    }
+
+    DataStream* stream = formatImage ( layer, image, format, pyrType, format_option, size, style );
+    if ( stream->getHttpStatus() != 200 ) {
+        return stream;
+    }
+
+    BufferedDataSource encoded ( *stream );
+    delete stream;
+
+    size_t encodedSize;
+    const uint8_t* encodedData = encoded.getData ( encodedSize );
+    if ( encodedSize == 0 ) {
+        return new SERDataStream ( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wms" ) );
+    }
+
+    layer->addEmptyResponse ( key, encoded.getType(), std::string ( ( const char* ) encodedData, encodedSize ) );
+    Metrics::count ( "rok4_empty_responses_total", Metrics::label ( "result", "miss" ) );
+
+    return new RawDataStream ( ( uint8_t* ) encodedData, encodedSize, encoded.getType(), "", encodedSize );
+}
+
 DataSource* Rok4Server::getTile ( Request* request ) {
     Layer* L;
     std::string tileMatrix,format;
@@ -677,14 +955,20 @@ DataSource* Rok4Server::getTile ( Request* request ) {
         return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
     }
 
-    if (level->isOnFly()) {
+    // Seul le format de la pyramide est stocké : dans un format de transcodage, la tuile d'un niveau à la volée est calculée à la demande
+    bool transcoding = L->isTranscodingFormat ( format );
+
+    if (level->isOnFly() && ! transcoding) {
         tileSource = getTileOnFly(L, tileMatrix, tileCol, tileRow, style, format);
     }
-    else if (level->isOnDemand()) {
+    else if (level->isOnDemand() || level->isOnFly()) {
         tileSource = getTileOnDemand(L, tileMatrix, tileCol, tileRow, style, format);
     }
+    else if (transcoding) {
+        tileSource = getTileTranscoded(L, tileMatrix, tileCol, tileRow, style, format);
+    }
     else {
-        tileSource = getTileUsual(L, tileMatrix, tileCol, tileRow, style, format) ;
+        tileSource = getTileUsual(L, tileMatrix, tileCol, tileRow, style, format, request->acceptGzip) ;
     }
 
     return tileSource;
@@ -693,59 +977,115 @@ DataSource* Rok4Server::getTile ( Request* request ) {
 
 
 
-DataSource *Rok4Server::getTileUsual(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style,std::string format) {
+DataSource *Rok4Server::getTileUsual(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style,std::string format, bool acceptGzip) {
 
     DataSource* tileSource;
     // Avoid using unnecessary palette
     if ( format == "image/png" ) {
         tileSource = new PaletteDataSource ( L->getDataPyramid()->getLevel(tileMatrix)->getTile ( tileCol, tileRow ), style->getPalette() );
     } else {
-        tileSource = L->getDataPyramid()->getLevel(tileMatrix)->getTile ( tileCol, tileRow );
+        tileSource = L->getDataPyramid()->getLevel(tileMatrix)->getTile ( tileCol, tileRow, acceptGzip );
     }
     return tileSource;
 
 }
 
-DataSource *Rok4Server::getTileOnDemand(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format) {
-    //On va créer la tuile sur demande
+DataSource *Rok4Server::getTileTranscoded(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format) {
+
+    TileCache* cache = L->getTranscodingCache();
+
+    std::ostringstream key;
+    key << tileMatrix << "|" << tileCol << "," << tileRow << "|" << format << "|" << style->getId();
+
+    // Une tuile en cours de transcodage par un autre thread est attendue plutôt que transcodée à nouveau
+    std::string type, data;
+    while ( true ) {
+        if ( cache->get ( key.str(), type, data ) ) {
+            Metrics::count ( "rok4_transcoded_tiles_total", Metrics::label ( "result", "hit" ) );
+            return new RawDataSource ( ( uint8_t* ) data.data(), data.size(), type, "" );
+        }
+        if ( cache->startRendering ( key.str() ) ) break;
+    }
+    Metrics::count ( "rok4_transcoded_tiles_total", Metrics::label ( "result", "miss" ) );
+
+    DataSource* tile = transcodeTile ( L, tileMatrix, tileCol, tileRow, style, format, key.str() );
+
+    cache->endRendering ( key.str() );
+
+    return tile;
+}
+
+DataSource *Rok4Server::transcodeTile(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format, std::string key) {
+
+    MetricsTimer timer ( Metrics::getStage ( "transcode", "layer", L->getId() ) );
+
+    Pyramid* pyr = L->getDataPyramid();
+    Level* lev = pyr->getLevel(tileMatrix);
+
+    Image* curImage = lev->getStoredTile ( tileCol, tileRow );
+    if ( curImage == NULL ) {
+        return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
+    }
+    CRS crs = pyr->getTms()->getCrs();
+    BoundingBox<double> bbox = curImage->getBbox();
+    curImage->setCRS ( crs );
+
+    // Même chaîne que pour un GetMap d'une seule couche : style, conversion éventuelle du type de pixel puis encodage
+    Rok4Format::eformat_data pyrType = pyr->getFormat();
+    std::map <std::string, std::string > format_option;
+
+    Image* image = styleImage ( curImage, pyrType, style, format, 1, pyr );
+    if ( image == NULL ) {
+        return new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+    }
+
+    std::vector<Image*> images;
+    images.push_back ( image );
+    image = mergeImages ( images, pyrType, style, crs, bbox );
+
+    DataStream* stream = formatImage ( L, image, format, pyrType, format_option, 1, style );
+    if ( stream == NULL ) {
+        LOGGER_ERROR ( "Impossible de transcoder la tuile car l'opération de formattage n'a pas fonctionné" );
+        return new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+    }
+    if ( stream->getHttpStatus() != 200 ) {
+        delete stream;
+        LOGGER_ERROR ( "Impossible de transcoder la tuile car l'opération de formattage n'a pas fonctionné" );
+        return new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+    }
+
+    BufferedDataSource encoded ( *stream );
+    delete stream;
+
+    size_t encodedSize;
+    const uint8_t* encodedData = encoded.getData ( encodedSize );
+    L->getTranscodingCache()->put ( key, encoded.getType(), std::string ( ( const char* ) encodedData, encodedSize ) );
+
+    return new RawDataSource ( ( uint8_t* ) encodedData, encodedSize, encoded.getType(), "" );
+}
+
+Image *Rok4Server::createOnDemandImage(Layer* L, Level* lev, BoundingBox<double> bbox, int width, int height, Style *style, std::string format,
+                                       Rok4Format::eformat_data& pyrType, int& bSize, bool& constant, std::string& usedSources, DataSource*& errorResp) {
 
-    //Variables
     std::vector<Image*> images;
     Image *curImage;
     Image *image;
     Image *mergeImage;
     std::string bLevel;
-    int width, height, error;
-    Rok4Format::eformat_data pyrType = Rok4Format::UNKNOWN;
+    int error = 0;
     Style * bStyle;
-    std::map <std::string, std::string > format_option;
-    int bSize = 0;
     std::vector <Source*> bSources;
+    std::ostringstream usedSourcesStream;
 
-    LOGGER_INFO("GetTileOnDemand");
-
-    //Calcul des paramètres nécessaires
-    LOGGER_DEBUG("Compute parameters");
     Pyramid * pyr = L->getDataPyramid();
     CRS dst_crs = pyr->getTms()->getCrs();
-    error = 0;
     Interpolation::KernelType interpolation = L->getResampling();
-    Level* lev = pyr->getLevel(tileMatrix);
 
-    //--------------------------------------------------------------------------------------------------------
-    //Suite du calcul des paramètres nécessaires
-    //calcul de la bbox
-    LOGGER_DEBUG("Compute BBOX");
-    BoundingBox<double> bbox = lev->tileIndicesToTileBbox(tileCol,tileRow) ;
-    bbox.print();
-    //width and height and channels
-    width = lev->getTm()->getTileW();
-    height = lev->getTm()->getTileH();
-
-    //--------------------------------------------------------------------------------------------------------
+    pyrType = Rok4Format::UNKNOWN;
+    // Les sources n'apportent aucune donnée : l'image ne dépend que du niveau, du style, du format et des sources utilisées
+    constant = true;
+    errorResp = NULL;
 
-    //--------------------------------------------------------------------------------------------------------
-    //CREATION DE L'IMAGE
     LOGGER_DEBUG("Create Image");
 
     bSources = lev->getSources();
@@ -778,12 +1118,16 @@ DataSource *Rok4Server::getTileOnDemand(Layer* L, std::string tileMatrix, int ti
                     curImage = bPyr->createReprojectedImage(bLevel, bbox, dst_crs, servicesConf, width, height, interpolation, error);
 
                     if (curImage != NULL) {
+                        if ( ! curImage->isConstant() || ! isEmptyResponseReusable ( format, bStyle ) ) constant = false;
+                        usedSourcesStream << i << ",";
+
                         //On applique un style à l'image
                         image = styleImage(curImage, pyrType, bStyle, format, bSize, bPyr);
                         images.push_back ( image );
                     } else {
                         LOGGER_ERROR("Impossible de générer la tuile car l'une des basedPyramid du layer "+L->getTitle()+" ne renvoit pas de tuile");
-                        return new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+                        errorResp = new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+                        return NULL;
                     }
 
                 } else {
@@ -808,12 +1152,14 @@ DataSource *Rok4Server::getTileOnDemand(Layer* L, std::string tileMatrix, int ti
 
                 //----traitement de la requete
                 image = wms->createImageFromRequest(width,height,bbox);
+                constant = false;
 
                 if (image) {
                     images.push_back(image);
                 } else {
                     LOGGER_ERROR("Impossible de generer la tuile car l'un des WebServices du layer "+L->getTitle()+" ne renvoit pas de tuile");
-                    return new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+                    errorResp = new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+                    return NULL;
                 }
 
             }
@@ -829,18 +1175,62 @@ DataSource *Rok4Server::getTileOnDemand(Layer* L, std::string tileMatrix, int ti
 
         if (mergeImage == NULL) {
             LOGGER_ERROR("Impossible de générer la tuile car l'opération de merge n'a pas fonctionné");
-            return new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+            errorResp = new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+            return NULL;
         }
 
     } else {
         LOGGER_ERROR("Aucune image n'a été récupérée");
-        return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
+        errorResp = new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
+        return NULL;
     }
 
+    usedSources = usedSourcesStream.str();
+    return mergeImage;
+}
+
+DataSource *Rok4Server::getTileOnDemand(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format) {
+    //On va créer la tuile sur demande
+
+    LOGGER_INFO("GetTileOnDemand");
 
+    if ( L->getMetatileSize() > 1 ) {
+        return getTileFromMetatile(L, tileMatrix, tileCol, tileRow, style, format);
+    }
+
+    //Variables
+    Rok4Format::eformat_data pyrType;
+    std::map <std::string, std::string > format_option;
+    int bSize = 0;
+    bool constant;
+    std::string usedSources;
+    DataSource* errorResp;
+
+    //Calcul des paramètres nécessaires
+    LOGGER_DEBUG("Compute parameters");
+    Level* lev = L->getDataPyramid()->getLevel(tileMatrix);
+
+    //calcul de la bbox
+    LOGGER_DEBUG("Compute BBOX");
+    BoundingBox<double> bbox = lev->tileIndicesToTileBbox(tileCol,tileRow) ;
+    bbox.print();
+
+    //CREATION DE L'IMAGE
+    Image* mergeImage = createOnDemandImage(L, lev, bbox, lev->getTm()->getTileW(), lev->getTm()->getTileH(), style, format,
+                                            pyrType, bSize, constant, usedSources, errorResp);
+    if (mergeImage == NULL) {
+        return errorResp;
+    }
 
     //De cette image mergée, on lui applique un format pour la renvoyer au client
-    DataStream *tileSource = formatImage(mergeImage, format, pyrType, format_option, bSize, style);
+    DataStream *tileSource;
+    if ( constant && isEmptyResponseReusable ( format, style ) ) {
+        std::ostringstream key;
+        key << "tile|" << tileMatrix << "|" << style->getId() << "|" << format << "|" << usedSources;
+        tileSource = formatEmptyImage(L, key.str(), mergeImage, format, pyrType, format_option, bSize, style);
+    } else {
+        tileSource = formatImage(L, mergeImage, format, pyrType, format_option, bSize, style);
+    }
     DataSource *tile;
 
     if (tileSource == NULL) {
@@ -856,6 +1246,126 @@ DataSource *Rok4Server::getTileOnDemand(Layer* L, std::string tileMatrix, int ti
 
 }
 
+DataSource *Rok4Server::getTileFromMetatile(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format) {
+
+    TileCache* cache = L->getMetatileCache();
+    int n = L->getMetatileSize();
+    Level* lev = L->getDataPyramid()->getLevel(tileMatrix);
+
+    // La métatuile est alignée sur les multiples de n et restreinte aux tuiles du niveau
+    int metaCol = tileCol - ( ( tileCol % n ) + n ) % n;
+    int metaRow = tileRow - ( ( tileRow % n ) + n ) % n;
+
+    std::ostringstream prefix;
+    prefix << tileMatrix << "|" << style->getId() << "|" << format << "|";
+    std::ostringstream tileKey;
+    tileKey << prefix.str() << tileCol << "," << tileRow;
+    std::ostringstream metaKey;
+    metaKey << prefix.str() << "meta|" << metaCol << "," << metaRow;
+
+    // Une métatuile en cours de calcul par un autre thread est attendue plutôt que recalculée
+    std::string type, data;
+    while ( true ) {
+        if ( cache->get ( tileKey.str(), type, data ) ) {
+            Metrics::count ( "rok4_metatile_tiles_total", Metrics::label ( "result", "hit" ) );
+            return new RawDataSource ( ( uint8_t* ) data.data(), data.size(), type, "" );
+        }
+        if ( cache->startRendering ( metaKey.str() ) ) break;
+    }
+    Metrics::count ( "rok4_metatile_tiles_total", Metrics::label ( "result", "miss" ) );
+
+    DataSource* tile = renderMetatile ( L, lev, 
+        std::max ( metaCol, ( int ) lev->getMinTileCol() ), std::max ( metaRow, ( int ) lev->getMinTileRow() ),
+        std::min ( metaCol + n - 1, ( int ) lev->getMaxTileCol() ), std::min ( metaRow + n - 1, ( int ) lev->getMaxTileRow() ),
+        tileCol, tileRow, style, format, prefix.str()
+    );
+
+    cache->endRendering ( metaKey.str() );
+
+    return tile;
+}
+
+DataSource *Rok4Server::renderMetatile(Layer* L, Level* lev, int colMin, int rowMin, int colMax, int rowMax, int tileCol, int tileRow,
+                                       Style *style, std::string format, std::string keyPrefix) {
+
+    MetricsTimer timer ( Metrics::getStage ( "metatile", "layer", L->getId() ) );
+
+    Rok4Format::eformat_data pyrType;
+    std::map <std::string, std::string > format_option;
+    int bSize = 0;
+    bool constant;
+    std::string usedSources;
+    DataSource* errorResp;
+
+    int tileW = lev->getTm()->getTileW();
+    int tileH = lev->getTm()->getTileH();
+
+    BoundingBox<double> ulBbox = lev->tileIndicesToTileBbox ( colMin, rowMin );
+    BoundingBox<double> lrBbox = lev->tileIndicesToTileBbox ( colMax, rowMax );
+    BoundingBox<double> bbox ( ulBbox.xmin, lrBbox.ymin, lrBbox.xmax, ulBbox.ymax );
+
+    LOGGER_DEBUG ( "Metatile from tile " << colMin << "," << rowMin << " to tile " << colMax << "," << rowMax );
+
+    Image* mergeImage = createOnDemandImage ( L, lev, bbox, ( colMax - colMin + 1 ) * tileW, ( rowMax - rowMin + 1 ) * tileH, style, format,
+                                              pyrType, bSize, constant, usedSources, errorResp );
+    if ( mergeImage == NULL ) {
+        return errorResp;
+    }
+
+    // L'image est calculée une seule fois, au premier accès, puis découpée en tuiles
+    Metatile metatile ( mergeImage );
+
+    // Sans donnée, toutes les tuiles sont identiques : une seule est encodée
+    bool identical = constant && isEmptyResponseReusable ( format, style );
+
+    DataSource* tile = NULL;
+    std::string type, data;
+
+    for ( int row = rowMin; row <= rowMax; row++ ) {
+        for ( int col = colMin; col <= colMax; col++ ) {
+
+            if ( ! identical || data.empty() ) {
+                MetatileImage* tileImage = new MetatileImage ( &metatile, ( col - colMin ) * tileW, ( row - rowMin ) * tileH, tileW, tileH,
+                                                               lev->tileIndicesToTileBbox ( col, row ) );
+
+                DataStream* stream = formatImage ( L, tileImage, format, pyrType, format_option, bSize, style );
+                if ( stream == NULL ) {
+                    delete tileImage;
+                    LOGGER_ERROR ( "Impossible de générer la tuile car l'opération de formattage n'a pas fonctionné" );
+                    return new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+                }
+                if ( stream->getHttpStatus() != 200 ) {
+                    delete stream;
+                    LOGGER_ERROR ( "Impossible de générer la tuile car l'opération de formattage n'a pas fonctionné" );
+                    return new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
+                }
+
+                BufferedDataSource encoded ( *stream );
+                delete stream;
+
+                size_t encodedSize;
+                const uint8_t* encodedData = encoded.getData ( encodedSize );
+                type = encoded.getType();
+                data.assign ( ( const char* ) encodedData, encodedSize );
+            }
+
+            std::ostringstream key;
+            key << keyPrefix << col << "," << row;
+            L->getMetatileCache()->put ( key.str(), type, data );
+
+            if ( col == tileCol && row == tileRow ) {
+                tile = new RawDataSource ( ( uint8_t* ) data.data(), data.size(), type, "" );
+            }
+        }
+    }
+
+    if ( tile == NULL ) {
+        return new SERDataSource ( new ServiceException ( "", HTTP_NOT_FOUND, _ ( "No data found" ), "wmts" ) );
+    }
+
+    return tile;
+}
+
 DataSource *Rok4Server::getTileOnFly(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format) {
     //On va créer la tuile sur demande et stocker la dalle qui la contient
 
@@ -1175,6 +1685,9 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
         pyr->getSampleFormat(),pyr->getBitsPerSample(),
         pyr->getPhotometric(),pyr->getSampleCompression(),tileW, tileH, fc
     );
+    if (finalImage != NULL) {
+        finalImage->setJpegOptions(L->getJpegOptions());
+    }
 
     LOGGER_DEBUG("Created");
 
@@ -1255,85 +1768,89 @@ DataStream* Rok4Server::WMTSGetFeatureInfo ( Request* request ) {
     // On a déjà vérifié dans getFeatureInfoParamWMTS que la pyramide possédait bien ce niveau
     Level* level = pyr->getLevel(tileMatrix);
 
-    BoundingBox<double> bbox = level->tileIndicesToTileBbox(tileCol,tileRow) ;
     int height = level->getTm()->getTileH();
     int width = level->getTm()->getTileW();
+
+    if ( layer->getGFIType().compare( "PYRAMID" ) == 0 ) {
+        // Le pixel interrogé est directement celui du niveau
+        return PyramidGetFeatureInfo( "wmts", layer, level, ( int64_t ) tileCol * width + X, ( int64_t ) tileRow * height + Y, info_format );
+    }
+
+    BoundingBox<double> bbox = level->tileIndicesToTileBbox(tileCol,tileRow) ;
     CRS crs = pyr->getTms()->getCrs();
     return CommonGetFeatureInfo( "wmts", layer, bbox, width, height, crs, info_format, X, Y, format, 1 );
 }
 
+DataStream* Rok4Server::PyramidGetFeatureInfo ( std::string service, Layer* layer, Level* level, int64_t col, int64_t row, std::string info_format ) {
+
+    std::vector<float> values;
+    level->getPixel ( col, row, values );
+
+    std::vector<std::string> strData;
+    char value[32];
+    switch ( layer->getDataPyramid()->getFormat() ) {
+        case Rok4Format::TIFF_RAW_INT8 :
+        case Rok4Format::TIFF_JPG_INT8 :
+        case Rok4Format::TIFF_PNG_INT8 :
+        case Rok4Format::TIFF_LZW_INT8 :
+        case Rok4Format::TIFF_ZIP_INT8 :
+        case Rok4Format::TIFF_PKB_INT8 :
+            for ( unsigned int i = 0 ; i < values.size(); i ++ ) {
+                snprintf ( value, sizeof ( value ), "%d", ( int ) values.at ( i ) );
+                strData.push_back ( value );
+            }
+            break;
+        case Rok4Format::TIFF_RAW_FLOAT32 :
+        case Rok4Format::TIFF_LZW_FLOAT32 :
+        case Rok4Format::TIFF_ZIP_FLOAT32 :
+        case Rok4Format::TIFF_PKB_FLOAT32 :
+            for ( unsigned int i = 0 ; i < values.size(); i ++ ) {
+                snprintf ( value, sizeof ( value ), "%g", values.at ( i ) );
+                strData.push_back ( value );
+            }
+            break;
+        default:
+            return new SERDataStream ( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Erreur interne."), service ) );
+    }
+
+    GetFeatureInfoEncoder gfiEncoder(strData, info_format);
+    DataStream* responseDS = gfiEncoder.getDataStream();
+    if (responseDS == NULL){
+        return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "Info_format non ") +info_format+ _( " supporté par la couche ") + layer->getId() , service ) );
+    }
+    return responseDS;
+}
+
 DataStream* Rok4Server::CommonGetFeatureInfo ( std::string service, Layer* layer, BoundingBox<double> bbox, int width, int height, CRS crs, std::string info_format , int X, int Y, std::string format, int feature_count){
     std::string getFeatureInfoType = layer->getGFIType();
     if ( getFeatureInfoType.compare( "PYRAMID" ) == 0 ) {
         LOGGER_DEBUG("GFI sur pyramide");
-        
-        BoundingBox<double> pxBbox ( 0.0, 0.0, 0.0, 0.0 );
-        pxBbox.xmin = (bbox.xmax-bbox.xmin)/double (width)*double (X) + bbox.xmin;
-        pxBbox.xmax = (bbox.xmax-bbox.xmin)/double (width) + pxBbox.xmin;
-        pxBbox.ymax = bbox.ymax - (bbox.ymax-bbox.ymin)/double (height)*double (Y);
-        pxBbox.ymin = pxBbox.ymax - (bbox.ymax-bbox.ymin)/double (height);
-        
-        int error;
-        Image* image;
-        image = layer->getbbox ( servicesConf, pxBbox, 1, 1, crs, 0, error );
-        if ( image == 0 ) {
-           switch ( error ) {
-             case 1: {
-               return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "bbox invalide" ), service ) );
-             }
-             case 2: {
-               return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "bbox trop grande" ), service ) );
-             }
-             default : {
-               return new SERDataStream ( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ), service ) );
-             }
-           }
-        }
+        Pyramid* pyr = layer->getDataPyramid();
 
-        std::vector<std::string> strData;
-        Rok4Format::eformat_data pyrType = layer->getDataPyramid()->getFormat();
-        int n = image->getChannels();
-        switch ( pyrType ) {
-            case Rok4Format::TIFF_RAW_INT8 :
-            case Rok4Format::TIFF_JPG_INT8 :
-            case Rok4Format::TIFF_PNG_INT8 :
-            case Rok4Format::TIFF_LZW_INT8 :
-            case Rok4Format::TIFF_ZIP_INT8 :
-            case Rok4Format::TIFF_PKB_INT8 : {
-                uint8_t* intbuffer = new uint8_t[n*sizeof(uint8_t)];
-                image->getline(intbuffer,0);
-                for ( int i = 0 ; i < n; i ++ ) {
-                  std::stringstream ss;
-                  ss << (int) intbuffer[i];
-                  strData.push_back( ss.str() );
-                }
-                break;
-            }
-            case Rok4Format::TIFF_RAW_FLOAT32 :
-            case Rok4Format::TIFF_LZW_FLOAT32 :
-            case Rok4Format::TIFF_ZIP_FLOAT32 :
-            case Rok4Format::TIFF_PKB_FLOAT32 : {
-                float* floatbuffer = new float[n*sizeof(float)];
-                image->getline(floatbuffer,0);
-                for ( int i = 0 ; i < n; i ++ ) {
-                  std::stringstream ss;
-                  ss << (float) floatbuffer[i];
-                  strData.push_back( ss.str() );
-                }
-                delete[] floatbuffer;
-                break;
+        // Emprise du pixel interrogé, dans le système de la pyramide
+        double resX = ( bbox.xmax - bbox.xmin ) / double ( width );
+        double resY = ( bbox.ymax - bbox.ymin ) / double ( height );
+        BoundingBox<double> pxBbox ( bbox.xmin + resX * X, bbox.ymax - resY * ( Y + 1 ), bbox.xmin + resX * ( X + 1 ), bbox.ymax - resY * Y );
+
+        if ( ! ( pyr->getTms()->getCrs() == crs || servicesConf->are_the_two_CRS_equal( pyr->getTms()->getCrs().getProj4Code(), crs.getProj4Code() ) ) ) {
+            if ( pxBbox.reproject ( crs.getProj4Code(), pyr->getTms()->getCrs().getProj4Code(), 2 ) != 0 ||
+                 pxBbox.xmin != pxBbox.xmin || pxBbox.xmax != pxBbox.xmax || pxBbox.ymin != pxBbox.ymin || pxBbox.ymax != pxBbox.ymax ) {
+                return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "bbox invalide" ), service ) );
             }
-            default:
-              return new SERDataStream ( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Erreur interne."), service ) );
         }
-        GetFeatureInfoEncoder gfiEncoder(strData, info_format);
-        DataStream* responseDS = gfiEncoder.getDataStream();
-        if (responseDS == NULL){
-            return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "Info_format non ") +info_format+ _( " supporté par la couche ") + layer->getId() , service ) );
+
+        Level* level = pyr->getLevel ( pyr->best_level ( pxBbox.xmax - pxBbox.xmin, pxBbox.ymax - pxBbox.ymin, false ) );
+        if ( level == NULL ) {
+            return new SERDataStream ( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ), service ) );
         }
-        delete image;
-        return responseDS;
-        
+
+        // Pixel du niveau contenant le centre du pixel interrogé
+        TileMatrix* tm = level->getTm();
+        int64_t col = floor ( ( ( pxBbox.xmin + pxBbox.xmax ) / 2. - tm->getX0() ) / tm->getRes() );
+        int64_t row = floor ( ( tm->getY0() - ( pxBbox.ymin + pxBbox.ymax ) / 2. ) / tm->getRes() );
+
+        return PyramidGetFeatureInfo ( service, layer, level, col, row, info_format );
+
     } else if ( getFeatureInfoType.compare( "EXTERNALWMS" ) == 0 ) {
         LOGGER_DEBUG("GFI sur WMS externe");
         WebService* myWMSV = new WebService(layer->getGFIBaseUrl(),1,1,10);
@@ -1454,6 +1971,12 @@ void Rok4Server::processWMS ( Request* request, FCGX_Request&  fcgxRequest ) {
 
 void Rok4Server::processRequest ( Request * request, FCGX_Request&  fcgxRequest ) {
 
+    MetricsTimer timer ( Metrics::getHistogram ( "rok4_request_duration_seconds",
+        Metrics::label ( "service", ServiceType::toString ( request->service ) ) + "," +
+        Metrics::label ( "operation", RequestType::toString ( request->request ) ) + "," +
+        Metrics::label ( "layer", getMetricsLayer ( request ) )
+    ) );
+
     if ( serverConf->supportWMTS && request->service == ServiceType::WMTS) {
         processWMTS ( request, fcgxRequest );
     }
@@ -58,6 +58,8 @@
 #include "TileMatrixSet.h"
 #include "DocumentXML.h"
 #include "ProcessFactory.h"
+#include "AdmissionControl.h"
+#include "HttpFrontEnd.h"
 #include "fcgiapp.h"
 #include <csignal>
 #include "ServerXML.h"
@@ -78,6 +80,9 @@
  * \brief Handle the main program (event loop) and links
  */
 class Rok4Server {
+#ifdef UNITTEST
+    friend class CppUnitTMSTranscoding;
+#endif //UNITTEST
 private:
     /**
      * \~french \brief Liste des processus léger
@@ -103,6 +108,12 @@ private:
      */
     int sock;
 
+    /**
+     * \~french \brief Frontal HTTP, NULL si les requêtes arrivent en FastCGI
+     * \~english \brief HTTP front end, NULL if requests come with FastCGI
+     */
+    HttpFrontEnd* frontEnd;
+
     /**
      * \~french \brief Configurations globales des services
      * \~english \brief Global services configuration
@@ -130,6 +141,16 @@ private:
      * \~english \brief Invariant GetCapabilities fragments ready to be concatained with request informations
      */
     std::vector<std::string> tmsCapaFrag;
+    /**
+     * \~french \brief Fragments invariants des descriptions TileMap TMS, par couche
+     * \~english \brief Invariant TMS TileMap description fragments, per layer
+     */
+    std::map<std::string,std::vector<std::string> > tmsLayerFrag;
+    /**
+     * \~french \brief Fragments invariants des métadonnées TMS (JSON), par couche
+     * \~english \brief Invariant TMS metadata (JSON) fragments, per layer
+     */
+    std::map<std::string,std::vector<std::string> > tmsMetadataFrag;
 
 
     /**
@@ -138,6 +159,68 @@ private:
      */
     ProcessFactory *parallelProcess;
 
+    /**
+     * \~french \brief Contrôle d'admission des requêtes dans les threads
+     * \~english \brief Requests admission control in threads
+     */
+    AdmissionControl admission;
+
+    /**
+     * \~french \brief Serveur répondant actuellement aux requêtes
+     * \details Seul le serveur propriétaire des threads s'en sert. Il s'agit de lui même au démarrage, puis des serveurs construits à chaque rechargement de la configuration.
+     * \~english \brief Server currently answering requests
+     * \details Only the server owning threads uses it. It's itself at startup, then servers built at each configuration reload.
+     */
+    Rok4Server* current;
+
+    /**
+     * \~french \brief Nombre de requêtes en cours de traitement par ce serveur
+     * \~english \brief Number of requests being processed by this server
+     */
+    int readers;
+
+    /**
+     * \~french \brief Protège le serveur courant et les compteurs de requêtes
+     * \~english \brief Protect current server and requests counters
+     */
+    pthread_mutex_t currentMutex;
+
+    /**
+     * \~french \brief Signale la fin de la dernière requête d'un serveur remplacé
+     * \~english \brief Signal the end of the last request of a replaced server
+     */
+    pthread_cond_t currentCond;
+
+    /**
+     * \~french
+     * \brief Récupère le serveur courant pour le traitement d'une requête
+     * \details Le serveur retourné ne sera pas détruit avant l'appel à #releaseServer
+     * \~english
+     * \brief Get the current server to process a request
+     * \details Returned server will not be destroyed before #releaseServer call
+     */
+    Rok4Server* acquireServer();
+
+    /**
+     * \~french
+     * \brief Libère un serveur obtenu avec #acquireServer
+     * \~english
+     * \brief Release a server obtained with #acquireServer
+     */
+    void releaseServer ( Rok4Server* server );
+
+    /**
+     * \~french
+     * \brief Traite une requête reçue, avec la configuration courante
+     * \details La réponse est écrite sur le flux de sortie de la requête, qui n'est pas terminée
+     * \param[in] fcgxRequest requête FastCGI, réelle ou simulée par le frontal HTTP
+     * \~english
+     * \brief Process a received request, with the current configuration
+     * \details Response is written in the request output stream, which is not finished
+     * \param[in] fcgxRequest FastCGI request, real or simulated by the HTTP front end
+     */
+    void handleRequest ( FCGX_Request& fcgxRequest );
+
     /**
      * \~french
      * \brief Boucle principale exécutée par chaque thread à l'écoute des requêtes des utilisateurs.
@@ -164,6 +247,36 @@ private:
      */
     int GetDecimalPlaces ( double number );
 
+    /**
+     * \~french
+     * \brief Couche d'une requête, telle qu'utilisée comme étiquette des métriques
+     * \details Seules les couches configurées sont conservées, pour borner le nombre de métriques : "multiple" si plusieurs couches sont demandées, "unknown" si la couche n'existe pas
+     * \param[in] request requête
+     * \~english
+     * \brief Request's layer, as used for metrics label
+     * \details Only configured layers are kept, to bound metrics number : "multiple" if several layers are requested, "unknown" if layer doesn't exist
+     * \param[in] request request
+     */
+    std::string getMetricsLayer ( Request* request );
+
+    /**
+     * \~french
+     * \brief Budgets de concurrence d'une requête
+     * \details Les capacités, les tuiles pré-calculées servies dans le format des données et les requêtes sur des couches inconnues passent par la voie prioritaire : elles ne sont jamais mises en attente.
+     * \param[in] request requête
+     * \param[out] budgets places à obtenir : opération et couches limitées
+     * \param[out] maxOccupied nombre de threads pouvant être occupés par les requêtes coûteuses, 0 si pas de limite
+     * \return false si la requête n'est pas soumise au contrôle d'admission
+     * \~english
+     * \brief Concurrency budgets of a request
+     * \details Capabilities, pre-computed tiles served in the data format and requests on unknown layers use the priority lane : they are never queued.
+     * \param[in] request request
+     * \param[out] budgets places to obtain : limited operation and layers
+     * \param[out] maxOccupied number of threads which can be used by expensive requests, 0 if no limit
+     * \return false if request is not subject to admission control
+     */
+    bool getAdmissionBudgets ( Request* request, std::vector<AdmissionBudget>& budgets, int& maxOccupied );
+
     //---- WMS 1.1.1
     /**
      * \~french
@@ -189,11 +302,33 @@ private:
     void buildWMTSCapabilities();
     /**
      * \~french
-     * \brief Construit les fragments invariants du getCapabilities TMS
+     * \brief Construit les fragments invariants du getCapabilities TMS et des descriptions des couches TMS
      * \~english
-     * \brief Build the invariant fragments of the TMS GetCapabilities
+     * \brief Build the invariant fragments of the TMS GetCapabilities and TMS layers' descriptions
      */
     void buildTMSCapabilities();
+    /**
+     * \~french
+     * \brief Construit la description TileMap TMS d'une couche
+     * \param[in] layer couche décrite
+     * \param[in] serviceURL URL du service, jusqu'à la version
+     * \~english
+     * \brief Build the TMS TileMap description of a layer
+     * \param[in] layer described layer
+     * \param[in] serviceURL service URL, until version
+     */
+    std::string buildTMSLayer ( Layer* layer, std::string serviceURL );
+    /**
+     * \~french
+     * \brief Construit les métadonnées TMS (JSON) d'une couche
+     * \param[in] layer couche décrite
+     * \param[in] serviceURL URL du service, jusqu'à la version
+     * \~english
+     * \brief Build the TMS metadata (JSON) of a layer
+     * \param[in] layer described layer
+     * \param[in] serviceURL service URL, until version
+     */
+    std::string buildTMSLayerMetadata ( Layer* layer, std::string serviceURL );
 
     /**
      * \~french
@@ -215,6 +350,32 @@ private:
      */
     DataSource* getTileParamTMS ( Request* request, Layer*& layer, std::string& str_tileMatrix, int& tileCol, int& tileRow, std::string& format, Style*& style);
 
+    /**
+     * \~french
+     * \brief Extension TMS d'un format de transcodage
+     * \param[in] mime type MIME du format
+     * \return extension, vide si le format n'en a pas
+     * \~english
+     * \brief TMS extension of a transcoding format
+     * \param[in] mime format MIME type
+     * \return extension, empty if the format has none
+     */
+    static std::string getTMSTranscodingExtension ( std::string mime );
+
+    /**
+     * \~french
+     * \brief Format de transcodage d'une couche désigné par une extension TMS
+     * \param[in] layer couche demandée
+     * \param[in] extension extension de la requête
+     * \return type MIME du format de transcodage, vide si l'extension est celle des données ou n'est pas diffusée
+     * \~english
+     * \brief Layer's transcoding format designated by a TMS extension
+     * \param[in] layer requested layer
+     * \param[in] extension request extension
+     * \return transcoding format MIME type, empty if the extension is the data one or is not served
+     */
+    static std::string getTMSTranscodingFormat ( Layer* layer, std::string extension );
+
     /**
      * \~french
      * \brief Récuperation et vérifications des paramètres d'une requête GetMap
@@ -318,6 +479,7 @@ private:
     /**
      * \~french
      * \brief Convertie une image dans un format donné
+     * \param[in] layer couche de la requête, précisant les paramètres de compression JPEG
      * \param[in] image image à formater
      * \param[in] format demandé par le client
      * \param[in] pyrType format des tuiles de la pyramide
@@ -327,6 +489,7 @@ private:
      * \return image demandé ou un message d'erreur sous forme de stream
      * \~english
      * \brief Apply a format to an image
+     * \param[in] layer request's layer, giving JPEG compression parameters
      * \param[in] image image to format
      * \param[in] format asked format by the client
      * \param[in] pyrType tile format of the pyramid
@@ -335,7 +498,33 @@ private:
      * \param[in] style asked style by the client
      * \return requested image or an error message by a stream
      */
-    DataStream *formatImage(Image *image, std::string format, Rok4Format::eformat_data pyrType, std::map<std::string, std::string> format_option, int size, Style *style);
+    DataStream *formatImage(Layer* layer, Image *image, std::string format, Rok4Format::eformat_data pyrType, std::map<std::string, std::string> format_option, int size, Style *style);
+
+    /**
+     * \~french
+     * \brief Une image sans donnée dans ce format et avec ce style donne-t-elle toujours la même réponse
+     * \details Les formats géoréférencés et les styles calculés à partir du voisinage (estompage, pente, exposition) sont exclus
+     * \~english
+     * \brief Does an image without data in this format and with this style always give the same response
+     * \details Georeferenced formats and styles computed from neighbourhood (hillshade, slope, aspect) are excluded
+     */
+    bool isEmptyResponseReusable ( std::string format, Style* style );
+
+    /**
+     * \~french
+     * \brief Convertit une image sans donnée dans un format donné, en réutilisant la réponse déjà encodée pour la couche
+     * \details L'image n'est encodée qu'au premier appel pour une clé, la réponse est ensuite conservée par la couche
+     * \param[in] layer couche conservant les réponses
+     * \param[in] key clé de la réponse, décrivant tout ce dont dépend son contenu
+     * \param[in] image image sans donnée, détruite par la fonction
+     * \~english
+     * \brief Apply a format to an image without data, reusing the already encoded response for the layer
+     * \details Image is only encoded at the first call for a key, response is then kept by the layer
+     * \param[in] layer layer keeping responses
+     * \param[in] key response key, describing everything its content depends on
+     * \param[in] image image without data, destroyed by the function
+     */
+    DataStream *formatEmptyImage(Layer* layer, std::string key, Image *image, std::string format, Rok4Format::eformat_data pyrType, std::map<std::string, std::string> format_option, int size, Style *style);
     /**
      * \~french
      * \brief Renvoit une tuile déjà pré-calculée
@@ -346,6 +535,7 @@ private:
      * \param[in] tileMatrix tilematrix de la requête
      * \param[in] errorResp paramètre d'erreur
      * \param[in] style style de la requête
+     * \param[in] acceptGzip le client accepte-t-il une tuile vecteur compressée en gzip
      * \return image demandé ou un message d'erreur
      * \~english
      * \brief Give a tile computed before
@@ -356,9 +546,10 @@ private:
      * \param[in] tileMatrix tilematrix of the request
      * \param[in] errorResp error parameter
      * \param[in] style style of the resquest
+     * \param[in] acceptGzip does client accept gzip compressed vector tile
      * \return requested tile
      */
-    DataSource *getTileUsual(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format);
+    DataSource *getTileUsual(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format, bool acceptGzip = false);
     /**
      * \~french
      * \brief Renvoit une tuile qui vient d'être calculée
@@ -380,6 +571,101 @@ private:
      * \return requested tile
      */
     DataSource *getTileOnDemand(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format);
+    /**
+     * \~french
+     * \brief Calcule l'image à la demande couvrant une emprise, à partir des sources du niveau
+     * \param[in] L couche de la requête
+     * \param[in] lev niveau à la demande
+     * \param[in] bbox emprise de l'image, dans le système de la pyramide
+     * \param[in] width largeur de l'image en pixel
+     * \param[in] height hauteur de l'image en pixel
+     * \param[in] style style de la requête
+     * \param[in] format format de la requête
+     * \param[out] pyrType format des pyramides sources
+     * \param[out] bSize nombre de sources du niveau
+     * \param[out] constant aucune source n'apporte de donnée
+     * \param[out] usedSources indices des sources utilisées
+     * \param[out] errorResp réponse d'erreur si l'image n'a pas pu être calculée
+     * \return image fusionnée, NULL en cas d'erreur
+     * \~english
+     * \brief Compute on demand image covering a bounding box, from level's sources
+     * \param[in] L layer of the request
+     * \param[in] lev on demand level
+     * \param[in] bbox image's bounding box, in pyramid's system
+     * \param[in] width image's width in pixel
+     * \param[in] height image's height in pixel
+     * \param[in] style style of the request
+     * \param[in] format format of the request
+     * \param[out] pyrType source pyramids' format
+     * \param[out] bSize level's sources number
+     * \param[out] constant no source gives data
+     * \param[out] usedSources used sources' indices
+     * \param[out] errorResp error response if image could not be computed
+     * \return merged image, NULL if error
+     */
+    Image *createOnDemandImage(Layer* L, Level* lev, BoundingBox<double> bbox, int width, int height, Style *style, std::string format,
+                               Rok4Format::eformat_data& pyrType, int& bSize, bool& constant, std::string& usedSources, DataSource*& errorResp);
+    /**
+     * \~french
+     * \brief Renvoie une tuile à la demande, issue de la métatuile la contenant
+     * \details La tuile est lue dans le cache de la couche. Sinon, la métatuile est calculée en une fois et toutes ses tuiles sont encodées et mises en cache.
+     * \param[in] L couche de la requête
+     * \param[in] tileMatrix tilematrix de la requête
+     * \param[in] tileCol indice de colonne de la requête
+     * \param[in] tileRow indice de ligne de la requete
+     * \param[in] style style de la requête
+     * \param[in] format format de la requête
+     * \return Tuile demandée
+     * \~english
+     * \brief Give an on demand tile, from the metatile containing it
+     * \details Tile is read from the layer's cache. Otherwise, metatile is computed at once and all its tiles are encoded and cached.
+     * \param[in] L layer of the request
+     * \param[in] tileMatrix tilematrix of the request
+     * \param[in] tileCol column index of the request
+     * \param[in] tileRow row index of the request
+     * \param[in] style style of the resquest
+     * \param[in] format format of the request
+     * \return requested tile
+     */
+    DataSource *getTileFromMetatile(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format);
+    /**
+     * \~french
+     * \brief Calcule une métatuile, met ses tuiles encodées en cache et renvoie la tuile demandée
+     * \~english
+     * \brief Compute a metatile, cache its encoded tiles and give the requested tile
+     */
+    DataSource *renderMetatile(Layer* L, Level* lev, int colMin, int rowMin, int colMax, int rowMax, int tileCol, int tileRow,
+                               Style *style, std::string format, std::string keyPrefix);
+    /**
+     * \~french
+     * \brief Renvoit une tuile stockée dans un autre format que celui de la pyramide
+     * \details La tuile est lue dans le cache de la couche. Sinon, elle est décodée, stylée, encodée dans le format demandé et mise en cache.
+     * \param[in] L couche de la requête
+     * \param[in] tileMatrix tilematrix de la requête
+     * \param[in] tileCol indice de colonne de la requête
+     * \param[in] tileRow indice de ligne de la requete
+     * \param[in] style style de la requête
+     * \param[in] format format de transcodage de la requête
+     * \return Tuile demandée
+     * \~english
+     * \brief Give a stored tile in another format than the pyramid's one
+     * \details Tile is read from the layer's cache. Otherwise, it is decoded, styled, encoded with the requested format and cached.
+     * \param[in] L layer of the request
+     * \param[in] tileMatrix tilematrix of the request
+     * \param[in] tileCol column index of the request
+     * \param[in] tileRow row index of the request
+     * \param[in] style style of the resquest
+     * \param[in] format transcoding format of the request
+     * \return requested tile
+     */
+    DataSource *getTileTranscoded(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format);
+    /**
+     * \~french
+     * \brief Transcode une tuile stockée, la met en cache sous la clé fournie et la renvoie
+     * \~english
+     * \brief Transcode a stored tile, cache it with the provided key and give it
+     */
+    DataSource *transcodeTile(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format, std::string key);
     /**
      * \~french
      * \brief Renvoit une tuile qui vient d'être calculée
@@ -531,6 +817,7 @@ private:
      * \return response stream
      */
     DataStream* WMSGetFeatureInfo ( Request* request );
+
     /**
      * \~french
      * \brief Traitement d'une requête GetFeatureInfo WMTS
@@ -545,6 +832,30 @@ private:
 
     DataStream* CommonGetFeatureInfo ( std::string service, Layer* layer, BoundingBox<double> bbox, int width, int height, CRS crs, std::string info_format , int X, int Y, std::string format, int feature_count);
 
+    /**
+     * \~french
+     * \brief Traitement d'une requête GetFeatureInfo sur la pyramide d'une couche
+     * \details Seule la tuile contenant le pixel est lue et décodée, sans construction d'image
+     * \param[in] service service interrogé ("wms" ou "wmts")
+     * \param[in] layer couche interrogée
+     * \param[in] level niveau de la pyramide interrogé
+     * \param[in] col colonne du pixel dans le niveau, depuis l'origine du TMS
+     * \param[in] row ligne du pixel dans le niveau
+     * \param[in] info_format format de la réponse
+     * \return valeurs du pixel ou un message d'erreur
+     * \~english
+     * \brief Process a GetFeatureInfo request on a layer's pyramid
+     * \details Only the tile containing the pixel is read and decoded, without building an image
+     * \param[in] service requested service ("wms" or "wmts")
+     * \param[in] layer requested layer
+     * \param[in] level requested pyramid level
+     * \param[in] col pixel column in the level, from TMS origin
+     * \param[in] row pixel row in the level
+     * \param[in] info_format response format
+     * \return pixel values or an error message
+     */
+    DataStream* PyramidGetFeatureInfo ( std::string service, Layer* layer, Level* level, int64_t col, int64_t row, std::string info_format );
+
     /**
      * \~french Traite les requêtes de type WMS
      * \~english Process WMS request
@@ -699,14 +1010,16 @@ public:
      * \~english
      * \brief Start server's thread
      */
-    void run(sig_atomic_t signal_pending = 0);
+    void run();
     /**
      * \~french
-     * \brief Initialise le socket FastCGI
+     * \brief Initialise le socket FastCGI, ou le frontal HTTP
+     * \return false si le frontal HTTP configuré ne peut écouter
      * \~english
-     * \brief Initialize the FastCGI Socket
+     * \brief Initialize the FastCGI Socket, or the HTTP front end
+     * \return false if the configured HTTP front end cannot listen
      */
-    void initFCGI();
+    bool initFCGI();
     /**
      * \~french
      * Utilisé pour le rechargement de la configuration du serveur
@@ -732,12 +1045,34 @@ public:
     
      /**
      * \~french
-     * \brief Demande l'arrêt du serveur
+     * \brief Arrête le serveur
+     * \details Les threads sont interrompus et attendus
      * \~english
-     * \brief Ask for server shutdown
+     * \brief Stop the server
+     * \details Threads are interrupted and joined
      */
     void terminate();
 
+    /**
+     * \~french
+     * \brief Bascule les threads de ce serveur sur une nouvelle configuration
+     * \details Les requêtes suivantes sont traitées par le nouveau serveur, sans interrompre les threads ni le socket. L'ancien serveur est détruit une fois ses requêtes en cours terminées, sans les objets repris par le nouveau (voir ServerXML::takeOwnership).
+     * \param[in] newServer serveur construit par le rechargement de la configuration, sans thread
+     * \~english
+     * \brief Switch threads of this server to a new configuration
+     * \details Following requests are processed by the new server, without interrupting threads or socket. Old server is destroyed once its running requests are done, without objects taken by the new one (see ServerXML::takeOwnership).
+     * \param[in] newServer server built by the configuration reload, without thread
+     */
+    void switchServer ( Rok4Server* newServer );
+
+    /**
+     * \~french
+     * \brief Retourne le serveur répondant actuellement aux requêtes
+     * \~english
+     * \brief Return the server currently answering requests
+     */
+    Rok4Server* getCurrentServer();
+
     /**
      * \~french
      * \brief Retourne l'état du serveur
@@ -39,6 +39,8 @@
 
 ServerXML::ServerXML(std::string path ) : DocumentXML(path) {
     ok = false;
+    objectBook = NULL;
+    ownContextBook = true;
 
     std::cout<<_ ( "Chargement des parametres techniques depuis " ) <<filePath<<std::endl;
 
@@ -296,8 +298,41 @@ ServerXML::ServerXML(std::string path ) : DocumentXML(path) {
         backlog = 0;
     }
 
+    pElem=hRoot.FirstChild ( "httpListen" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        httpListen = "";
+    } else {
+        std::clog<<_ ( "Element <httpListen> : le serveur repond directement en HTTP" ) <<std::endl;
+        httpListen = DocumentXML::getTextStrFromElem(pElem);
+    }
+
+    pElem=hRoot.FirstChild ( "httpKeepAlive" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        httpKeepAlive = DEFAULT_HTTP_KEEPALIVE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&httpKeepAlive ) || httpKeepAlive < 0 )  {
+        std::cerr<<_ ( "Le httpKeepAlive [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] n'est pas un entier positif, valeur par defaut : " ) << DEFAULT_HTTP_KEEPALIVE <<std::endl;
+        httpKeepAlive = DEFAULT_HTTP_KEEPALIVE;
+    }
+
+    pElem=hRoot.FirstChild ( "storageMergingGap" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        mergingGap = -1;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&mergingGap ) || mergingGap < 0 )  {
+        std::cerr<<_ ( "Le storageMergingGap [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] n'est pas un entier positif, valeurs par defaut des stockages" ) <<std::endl;
+        mergingGap = -1;
+    }
+
+    pElem=hRoot.FirstChild ( "metricsPath" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <metricsPath> : pas d'exposition des metriques" ) <<std::endl;
+        metricsPath = "";
+    } else {
+        metricsPath = DocumentXML::getTextStrFromElem(pElem);
+    }
+
     //on créé systématiquement le contextbook()
     objectBook = new ContextBook();
+    objectBook->setMergingGap ( mergingGap );
 
 
 #if BUILD_OBJECT
@@ -325,19 +360,19 @@ ServerXML::~ServerXML(){
     // Les TMS
     std::map<std::string, TileMatrixSet*>::iterator itTMS;
     for ( itTMS=tmsList.begin(); itTMS!=tmsList.end(); itTMS++ )
-        delete itTMS->second;
+        if ( givenTms.find ( itTMS->second ) == givenTms.end() ) delete itTMS->second;
 
     // Les styles
     std::map<std::string, Style*>::iterator itSty;
     for ( itSty=stylesList.begin(); itSty!=stylesList.end(); itSty++ )
-        delete itSty->second;
+        if ( givenStyles.find ( itSty->second ) == givenStyles.end() ) delete itSty->second;
 
     // Les couches
     std::map<std::string, Layer*>::iterator itLay;
     for ( itLay=layersList.begin(); itLay!=layersList.end(); itLay++ )
-        delete itLay->second;
+        if ( givenLayers.find ( itLay->second ) == givenLayers.end() ) delete itLay->second;
 
-    if (objectBook != NULL) {
+    if (objectBook != NULL && ownContextBook) {
         delete objectBook;
     }
 
@@ -460,6 +495,52 @@ void ServerXML::cleanLayers(std::vector<std::string> ids) {
 }
 
 ContextBook* ServerXML::getContextBook(){return objectBook;}
+void ServerXML::setContextBook(ContextBook* book) {
+    if (objectBook != NULL && ownContextBook) {
+        delete objectBook;
+    }
+    objectBook = book;
+}
+
+void ServerXML::takeOwnership(ServerXML* previous) {
+
+    std::map<std::string, TileMatrixSet*>::iterator itTms;
+    for ( itTms = tmsList.begin(); itTms != tmsList.end(); itTms++ ) {
+        if ( previous->getTMS ( itTms->first ) == itTms->second ) previous->givenTms.insert ( itTms->second );
+    }
+
+    std::map<std::string, Style*>::iterator itSty;
+    for ( itSty = stylesList.begin(); itSty != stylesList.end(); itSty++ ) {
+        if ( previous->getStyle ( itSty->first ) == itSty->second ) previous->givenStyles.insert ( itSty->second );
+    }
+
+    std::map<std::string, Layer*>::iterator itLay;
+    for ( itLay = layersList.begin(); itLay != layersList.end(); itLay++ ) {
+        if ( previous->getLayer ( itLay->first ) == itLay->second ) previous->givenLayers.insert ( itLay->second );
+    }
+
+    if ( previous->objectBook == objectBook ) previous->ownContextBook = false;
+}
+
+void ServerXML::giveBack(ServerXML* previous) {
+
+    std::map<std::string, TileMatrixSet*>::iterator itTms;
+    for ( itTms = tmsList.begin(); itTms != tmsList.end(); itTms++ ) {
+        if ( previous->getTMS ( itTms->first ) == itTms->second ) givenTms.insert ( itTms->second );
+    }
+
+    std::map<std::string, Style*>::iterator itSty;
+    for ( itSty = stylesList.begin(); itSty != stylesList.end(); itSty++ ) {
+        if ( previous->getStyle ( itSty->first ) == itSty->second ) givenStyles.insert ( itSty->second );
+    }
+
+    std::map<std::string, Layer*>::iterator itLay;
+    for ( itLay = layersList.begin(); itLay != layersList.end(); itLay++ ) {
+        if ( previous->getLayer ( itLay->first ) == itLay->second ) givenLayers.insert ( itLay->second );
+    }
+
+    if ( previous->objectBook == objectBook ) ownContextBook = false;
+}
 #if BUILD_OBJECT
 int ServerXML::getReconnectionFrequency() {return reconnectionFrequency;}
 #endif
@@ -470,5 +551,9 @@ bool ServerXML::getSupportWMTS() {return supportWMTS;}
 bool ServerXML::getSupportTMS() {return supportTMS;}
 bool ServerXML::getSupportWMS() {return supportWMS;}
 int ServerXML::getBacklog() {return backlog;}
+std::string ServerXML::getMetricsPath() {return metricsPath;}
+std::string ServerXML::getHttpListen() {return httpListen;}
+int ServerXML::getHttpKeepAlive() {return httpKeepAlive;}
+int ServerXML::getMergingGap() {return mergingGap;}
 int ServerXML::getTimeKill() {return timeKill;}
 bool ServerXML::getReprojectionCapability() { return reprojectionCapability; }
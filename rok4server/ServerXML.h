@@ -43,6 +43,7 @@ class ServerXML;
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
 #include "TileMatrixSet.h"
 
 #include "DocumentXML.h"
@@ -95,6 +96,31 @@ class ServerXML : public DocumentXML
         Layer* getLayer(std::string id) ;
 
         ContextBook* getContextBook();
+        void setContextBook(ContextBook* book);
+
+        /**
+         * \~french
+         * \brief Récupère la propriété des objets partagés avec une configuration précédente
+         * \details Les TMS, styles, couches et l'annuaire de contextes présents à l'identique (même adresse) dans les deux configurations ne seront plus détruits avec la précédente. Les autres objets de la configuration précédente restent sa propriété.
+         * \param[in] previous configuration remplacée par celle ci
+         * \~english
+         * \brief Take ownership of objects shared with a previous configuration
+         * \details TMS, styles, layers and context book present as is (same address) in both configurations will no longer be destroyed with the previous one. Others objects stay owned by the previous configuration.
+         * \param[in] previous configuration replaced by this one
+         */
+        void takeOwnership(ServerXML* previous);
+
+        /**
+         * \~french
+         * \brief Rend à une configuration précédente les objets partagés avec elle
+         * \details Utilisé lorsqu'un rechargement échoue : les TMS, styles et couches présents à l'identique (même adresse) dans les deux configurations ne seront pas détruits avec celle ci, qui peut alors être supprimée sans toucher à la précédente.
+         * \param[in] previous configuration qui devait être remplacée par celle ci
+         * \~english
+         * \brief Give back to a previous configuration objects shared with it
+         * \details Used when a reload fails : TMS, styles and layers present as is (same address) in both configurations will not be destroyed with this one, which can then be deleted without touching the previous one.
+         * \param[in] previous configuration which was to be replaced by this one
+         */
+        void giveBack(ServerXML* previous);
 #if BUILD_OBJECT
         int getReconnectionFrequency() ;
 #endif
@@ -106,6 +132,10 @@ class ServerXML : public DocumentXML
         bool getSupportWMS() ;
         bool getReprojectionCapability() ;
         int getBacklog() ;
+        std::string getMetricsPath() ;
+        std::string getHttpListen() ;
+        int getHttpKeepAlive() ;
+        int getMergingGap() ;
         int getTimeKill() ;
 
     protected:
@@ -171,6 +201,29 @@ class ServerXML : public DocumentXML
          */
         int backlog;
 
+        /**
+         * \~french \brief Chemin (SCRIPT_NAME) sur lequel les métriques sont exposées au format Prometheus, vide si désactivé
+         * \~english \brief Path (SCRIPT_NAME) exposing metrics with Prometheus format, empty if disabled
+         */
+        std::string metricsPath;
+
+        /**
+         * \~french \brief Adresse d'écoute HTTP ("[ip]:port"), vide si le serveur n'est joignable qu'en FastCGI
+         * \~english \brief HTTP listening address ("[ip]:port"), empty if server is only reachable with FastCGI
+         */
+        std::string httpListen;
+        /**
+         * \~french \brief Durée en secondes de conservation d'une connexion HTTP inactive
+         * \~english \brief Time in seconds an idle HTTP connection is kept
+         */
+        int httpKeepAlive;
+
+        /**
+         * \~french \brief Écart maximal en octets entre deux tuiles d'une dalle lues ensemble, négatif pour garder la valeur par défaut du stockage
+         * \~english \brief Maximal gap in bytes between two slab's tiles read together, negative to keep storage default value
+         */
+        int mergingGap;
+
         int timeKill;
 
 
@@ -180,6 +233,20 @@ class ServerXML : public DocumentXML
          */
         ContextBook* objectBook;
 
+        /**
+         * \~french \brief L'annuaire de contextes est-il détruit avec la configuration
+         * \~english \brief Is the context book destroyed with the configuration
+         */
+        bool ownContextBook;
+
+        /**
+         * \~french \brief Objets repris par une configuration plus récente, à ne pas détruire
+         * \~english \brief Objects taken by a newer configuration, not to destroy
+         */
+        std::set<TileMatrixSet*> givenTms;
+        std::set<Style*> givenStyles;
+        std::set<Layer*> givenLayers;
+
 
 #if BUILD_OBJECT
 
@@ -87,6 +87,8 @@ std::string ServiceException::getCodeAsString ( ExceptionCode code ) {
         return "Not Found" ;
     case GFI_PYRAMID_VALUES:
         return "GFIPyramidValues";
+    case HTTP_SERVICE_UNAVAILABLE:
+        return "Service Unavailable" ;
     default:
         return "" ;
     }
@@ -117,6 +119,8 @@ int ServiceException::getCodeAsStatusCode ( ExceptionCode code ) {
         return 404 ;
     case GFI_PYRAMID_VALUES:
         return 200 ;
+    case HTTP_SERVICE_UNAVAILABLE:
+        return 503 ;
     default:
         return 200 ;
     }
@@ -134,6 +138,8 @@ std::string ServiceException::getStatusCodeAsReasonPhrase ( int statusCode ) {
         return "Internal server error" ;
     case 501 :
         return "Not implemented" ;
+    case 503 :
+        return "Service Unavailable" ;
     default : "No reason"
         ;
     }
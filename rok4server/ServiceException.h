@@ -146,7 +146,12 @@ typedef enum {
      * \~french GFI from pyramid Responses
      * \~english GFI from pyramid Responses
      */
-    GFI_PYRAMID_VALUES = 17
+    GFI_PYRAMID_VALUES = 17,
+    /**
+     * \~french Implémentation de l'erreur HTTP 503 : le serveur est surchargé
+     * \~english HTTP 503 implementation : server is overloaded
+     */
+    HTTP_SERVICE_UNAVAILABLE = 18
 
 } ExceptionCode;
 
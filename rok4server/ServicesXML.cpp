@@ -79,6 +79,13 @@ ServicesXML::ServicesXML (const ServicesXML & obj) {
     addEqualsCRS = obj.addEqualsCRS;
     dowerestrictCRSList = obj.dowerestrictCRSList;
     restrictedCRSList = obj.restrictedCRSList;
+    admissionControl = obj.admissionControl;
+    queueTimeout = obj.queueTimeout;
+    retryAfter = obj.retryAfter;
+    reservedThreads = obj.reservedThreads;
+    defaultLayerConcurrency = obj.defaultLayerConcurrency;
+    operationConcurrency = obj.operationConcurrency;
+    layerConcurrency = obj.layerConcurrency;
     mtdWMS = obj.mtdWMS;
     mtdWMTS = obj.mtdWMTS;
     mtdTMS = obj.mtdTMS;
@@ -115,6 +122,14 @@ ServicesXML::ServicesXML( std::string servicesConfigFile ) {
     doweuselistofequalsCRS = false;
     addEqualsCRS = false;
     dowerestrictCRSList = false;
+    admissionControl = false;
+    queueTimeout = 0;
+    retryAfter = 1;
+    reservedThreads = 0;
+    defaultLayerConcurrency = 0;
+    mtdWMS = NULL;
+    mtdWMTS = NULL;
+    mtdTMS = NULL;
 
     /********************** Parse */
 
@@ -506,6 +521,59 @@ ServicesXML::ServicesXML( std::string servicesConfigFile ) {
         }
     }
 
+    /********************** Contrôle d'admission */
+
+    TiXmlHandle hAdm = hRoot.FirstChild ( "admissionControl" );
+    if ( hAdm.Element() ) {
+        admissionControl = true;
+
+        pElem = hAdm.FirstChild ( "queueTimeout" ).Element();
+        if ( pElem && pElem->GetText() && sscanf ( pElem->GetText(),"%d",&queueTimeout ) != 1 ) {
+            LOGGER_ERROR ( _ ( "queueTimeout invalide : " ) << DocumentXML::getTextStrFromElem(pElem) );
+            return;
+        }
+
+        pElem = hAdm.FirstChild ( "retryAfter" ).Element();
+        if ( pElem && pElem->GetText() && sscanf ( pElem->GetText(),"%d",&retryAfter ) != 1 ) {
+            LOGGER_ERROR ( _ ( "retryAfter invalide : " ) << DocumentXML::getTextStrFromElem(pElem) );
+            return;
+        }
+
+        pElem = hAdm.FirstChild ( "reservedThreads" ).Element();
+        if ( pElem && pElem->GetText() && sscanf ( pElem->GetText(),"%d",&reservedThreads ) != 1 ) {
+            LOGGER_ERROR ( _ ( "reservedThreads invalide : " ) << DocumentXML::getTextStrFromElem(pElem) );
+            return;
+        }
+
+        pElem = hAdm.FirstChild ( "defaultLayerLimit" ).Element();
+        if ( pElem && pElem->GetText() && sscanf ( pElem->GetText(),"%d",&defaultLayerConcurrency ) != 1 ) {
+            LOGGER_ERROR ( _ ( "defaultLayerLimit invalide : " ) << DocumentXML::getTextStrFromElem(pElem) );
+            return;
+        }
+
+        for ( pElem = hAdm.FirstChild ( "operationLimit" ).Element(); pElem; pElem = pElem->NextSiblingElement ( "operationLimit" ) ) {
+            int limit;
+            const char* operation = pElem->Attribute ( "operation" );
+            if ( ! operation || ! pElem->GetText() || sscanf ( pElem->GetText(),"%d",&limit ) != 1 ) {
+                LOGGER_ERROR ( _ ( "operationLimit invalide : un attribut operation et une valeur entiere sont attendus" ) );
+                return;
+            }
+            operationConcurrency[operation] = limit;
+        }
+
+        for ( pElem = hAdm.FirstChild ( "layerLimit" ).Element(); pElem; pElem = pElem->NextSiblingElement ( "layerLimit" ) ) {
+            int limit;
+            const char* layer = pElem->Attribute ( "layer" );
+            if ( ! layer || ! pElem->GetText() || sscanf ( pElem->GetText(),"%d",&limit ) != 1 ) {
+                LOGGER_ERROR ( _ ( "layerLimit invalide : un attribut layer et une valeur entiere sont attendus" ) );
+                return;
+            }
+            layerConcurrency[layer] = limit;
+        }
+
+        LOGGER_INFO ( _ ( "Controle d'admission actif : " ) << operationConcurrency.size() << _ ( " limites d'operation, " ) << layerConcurrency.size() << _ ( " limites de couche" ) );
+    }
+
     mtdWMS = new MetadataURL ( "simple",metadataUrlWMS,metadataMediaTypeWMS );
     mtdWMTS = new MetadataURL ( "simple",metadataUrlWMTS,metadataMediaTypeWMTS );
     mtdTMS = new MetadataURL ( "simple",metadataUrlTMS,metadataMediaTypeTMS );
@@ -618,3 +686,18 @@ bool ServicesXML::getAddEqualsCRS() { return addEqualsCRS; }
 std::vector<std::string> ServicesXML::getListOfEqualsCRS() { return listofequalsCRS; }
 bool ServicesXML::getDoWeRestrictCRSList() { return dowerestrictCRSList; }
 std::vector<std::string> ServicesXML::getRestrictedCRSList() { return restrictedCRSList; }
+// Contrôle d'admission
+bool ServicesXML::isAdmissionControlled() { return admissionControl; }
+int ServicesXML::getQueueTimeout() { return queueTimeout; }
+int ServicesXML::getRetryAfter() { return retryAfter; }
+int ServicesXML::getReservedThreads() { return reservedThreads; }
+int ServicesXML::getOperationConcurrencyLimit( std::string operation ) {
+    std::map<std::string, int>::iterator it = operationConcurrency.find ( operation );
+    if ( it == operationConcurrency.end() ) return 0;
+    return it->second;
+}
+int ServicesXML::getLayerConcurrencyLimit( std::string layer ) {
+    std::map<std::string, int>::iterator it = layerConcurrency.find ( layer );
+    if ( it == layerConcurrency.end() ) return defaultLayerConcurrency;
+    return it->second;
+}
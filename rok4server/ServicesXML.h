@@ -41,6 +41,7 @@ class ServicesXML;
 #define SERVICESXML_H
 
 #include <vector>
+#include <map>
 #include <string>
 
 #include "Keyword.h"
@@ -111,6 +112,13 @@ class ServicesXML
         bool getDoWeRestrictCRSList() ;
         std::vector<std::string> getRestrictedCRSList() ;
         bool are_the_two_CRS_equal( std::string crs1, std::string crs2 );
+        // Contrôle d'admission
+        bool isAdmissionControlled() ;
+        int getQueueTimeout() ;
+        int getRetryAfter() ;
+        int getReservedThreads() ;
+        int getOperationConcurrencyLimit( std::string operation ) ;
+        int getLayerConcurrencyLimit( std::string layer ) ;
 
 
     protected:
@@ -170,6 +178,35 @@ class ServicesXML
         std::vector<std::string> listofequalsCRS;
         std::vector<std::string> restrictedCRSList;
 
+        // Contrôle d'admission
+        /**
+         * \~french \brief Les requêtes sont-elles soumises à des limites de concurrence
+         * \~english \brief Are requests subject to concurrency limits
+         */
+        bool admissionControl;
+        /**
+         * \~french \brief Attente maximale d'une requête avant son traitement, en millisecondes
+         * \~english \brief Request maximal wait before processing, in milliseconds
+         */
+        int queueTimeout;
+        /**
+         * \~french \brief Délai conseillé au client dans l'en-tête Retry-After d'un refus, en secondes
+         * \~english \brief Delay advised to client in the Retry-After header of a rejection, in seconds
+         */
+        int retryAfter;
+        /**
+         * \~french \brief Nombre de threads réservés aux tuiles pré-calculées
+         * \~english \brief Number of threads reserved to pre-computed tiles
+         */
+        int reservedThreads;
+        /**
+         * \~french \brief Limite par défaut du nombre de requêtes simultanées sur une couche, 0 si aucune
+         * \~english \brief Default limit of simultaneous requests on a layer, 0 if none
+         */
+        int defaultLayerConcurrency;
+        std::map<std::string, int> operationConcurrency;
+        std::map<std::string, int> layerConcurrency;
+
         MetadataURL* mtdWMS;
         MetadataURL* mtdWMTS;
         MetadataURL* mtdTMS;
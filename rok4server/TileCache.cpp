@@ -0,0 +1,125 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file TileCache.cpp
+ ** \~french
+ * \brief Implémentation de la classe TileCache
+ ** \~english
+ * \brief Implement class TileCache
+ */
+
+#include "TileCache.h"
+
+TileCache::TileCache ( size_t maxSize ) : size ( 0 ), maxSize ( maxSize ) {
+    pthread_mutex_init ( &mutex, NULL );
+    pthread_cond_init ( &renderingDone, NULL );
+}
+
+void TileCache::remove ( std::map<std::string, Entry>::iterator it ) {
+    size -= it->second.data.size();
+    usage.erase ( it->second.usage );
+    entries.erase ( it );
+}
+
+bool TileCache::get ( const std::string& key, std::string& type, std::string& data ) {
+    pthread_mutex_lock ( &mutex );
+    std::map<std::string, Entry>::iterator it = entries.find ( key );
+    bool found = ( it != entries.end() );
+    if ( found ) {
+        type = it->second.type;
+        data = it->second.data;
+        // La tuile devient la plus récemment utilisée
+        usage.splice ( usage.begin(), usage, it->second.usage );
+    }
+    pthread_mutex_unlock ( &mutex );
+    return found;
+}
+
+void TileCache::put ( const std::string& key, const std::string& type, const std::string& data ) {
+    if ( data.size() > maxSize ) return;
+
+    pthread_mutex_lock ( &mutex );
+
+    std::map<std::string, Entry>::iterator it = entries.find ( key );
+    if ( it != entries.end() ) remove ( it );
+
+    // Suppression des tuiles les moins récemment utilisées
+    while ( size + data.size() > maxSize ) {
+        remove ( entries.find ( usage.back() ) );
+    }
+
+    usage.push_front ( key );
+    Entry& entry = entries[key];
+    entry.type = type;
+    entry.data = data;
+    entry.usage = usage.begin();
+    size += data.size();
+
+    pthread_mutex_unlock ( &mutex );
+}
+
+bool TileCache::startRendering ( const std::string& key ) {
+    pthread_mutex_lock ( &mutex );
+    bool waited = false;
+    while ( rendering.count ( key ) ) {
+        waited = true;
+        pthread_cond_wait ( &renderingDone, &mutex );
+    }
+    if ( ! waited ) rendering.insert ( key );
+    pthread_mutex_unlock ( &mutex );
+    return ! waited;
+}
+
+void TileCache::endRendering ( const std::string& key ) {
+    pthread_mutex_lock ( &mutex );
+    rendering.erase ( key );
+    pthread_cond_broadcast ( &renderingDone );
+    pthread_mutex_unlock ( &mutex );
+}
+
+size_t TileCache::getSize() {
+    pthread_mutex_lock ( &mutex );
+    size_t s = size;
+    pthread_mutex_unlock ( &mutex );
+    return s;
+}
+
+TileCache::~TileCache() {
+    pthread_mutex_destroy ( &mutex );
+    pthread_cond_destroy ( &renderingDone );
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright © (2011-2013) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+
+/**
+ * \file TileCache.h
+ ** \~french
+ * \brief Définition de la classe TileCache
+ ** \~english
+ * \brief Define class TileCache
+ */
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <pthread.h>
+#include <string>
+#include <map>
+#include <set>
+#include <list>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Cache mémoire borné de tuiles encodées
+ * \details Les tuiles issues d'une métatuile sont gardées par clé (niveau, style, format, indices) jusqu'à une taille totale maximale. Au delà, les tuiles les moins récemment utilisées sont supprimées.
+ *
+ * Le cache permet aussi de ne calculer qu'une fois une métatuile demandée simultanément par plusieurs threads : le premier la calcule, les autres attendent la fin de ce calcul pour lire leur tuile dans le cache.
+ * \~english
+ * \brief Bounded memory cache of encoded tiles
+ * \details Tiles from a metatile are kept by key (level, style, format, indices) up to a maximal total size. Beyond, least recently used tiles are removed.
+ *
+ * Cache allows too to compute only once a metatile requested simultaneously by several threads : the first one computes it, others wait for the end of this computation to read their tile in the cache.
+ */
+class TileCache {
+
+private:
+
+    /**
+     * \~french \brief Tuile encodée : type MIME, contenu et position dans la liste d'utilisation
+     * \~english \brief Encoded tile : MIME type, content and position in usage list
+     */
+    struct Entry {
+        std::string type;
+        std::string data;
+        std::list<std::string>::iterator usage;
+    };
+
+    /**
+     * \~french \brief Tuiles encodées, par clé
+     * \~english \brief Encoded tiles, by key
+     */
+    std::map<std::string, Entry> entries;
+
+    /**
+     * \~french \brief Clés des tuiles, de la plus récemment utilisée à la plus ancienne
+     * \~english \brief Tiles' keys, from the most recently used to the oldest one
+     */
+    std::list<std::string> usage;
+
+    /**
+     * \~french \brief Taille totale des tuiles en cache et taille maximale, en octets
+     * \~english \brief Total size of cached tiles and maximal size, in bytes
+     */
+    size_t size, maxSize;
+
+    /**
+     * \~french \brief Métatuiles en cours de calcul
+     * \~english \brief Metatiles being computed
+     */
+    std::set<std::string> rendering;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t renderingDone;
+
+    void remove ( std::map<std::string, Entry>::iterator it );
+
+public:
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] maxSize taille totale maximale des tuiles gardées, en octets
+     * \~english
+     * \brief Constructor
+     * \param[in] maxSize maximal total size of kept tiles, in bytes
+     */
+    TileCache ( size_t maxSize );
+
+    /**
+     * \~french
+     * \brief Lecture d'une tuile du cache
+     * \param[in] key clé de la tuile
+     * \param[out] type type MIME de la tuile
+     * \param[out] data contenu de la tuile
+     * \return true si la tuile est en cache
+     * \~english
+     * \brief Read a tile from the cache
+     * \param[in] key tile's key
+     * \param[out] type tile's MIME type
+     * \param[out] data tile's content
+     * \return true if tile is cached
+     */
+    bool get ( const std::string& key, std::string& type, std::string& data );
+
+    /**
+     * \~french
+     * \brief Ajout d'une tuile dans le cache
+     * \details Une tuile plus grande que la taille maximale du cache n'est pas gardée.
+     * \param[in] key clé de la tuile
+     * \param[in] type type MIME de la tuile
+     * \param[in] data contenu de la tuile
+     * \~english
+     * \brief Add a tile in the cache
+     * \details A tile bigger than the cache maximal size is not kept.
+     * \param[in] key tile's key
+     * \param[in] type tile's MIME type
+     * \param[in] data tile's content
+     */
+    void put ( const std::string& key, const std::string& type, const std::string& data );
+
+    /**
+     * \~french
+     * \brief Réservation du calcul d'une métatuile
+     * \details Si la métatuile est déjà en cours de calcul par un autre thread, on attend la fin de ce calcul.
+     * \param[in] key clé de la métatuile
+     * \return true si l'appelant doit calculer la métatuile (et appeler #endRendering), false si elle vient d'être calculée par un autre thread
+     * \~english
+     * \brief Reserve a metatile computation
+     * \details If the metatile is already being computed by another thread, we wait for the end of this computation.
+     * \param[in] key metatile's key
+     * \return true if caller have to compute the metatile (and call #endRendering), false if it's just been computed by another thread
+     */
+    bool startRendering ( const std::string& key );
+
+    /**
+     * \~french
+     * \brief Fin du calcul d'une métatuile, les threads en attente sont réveillés
+     * \param[in] key clé de la métatuile
+     * \~english
+     * \brief End of a metatile computation, waiting threads are woken up
+     * \param[in] key metatile's key
+     */
+    void endRendering ( const std::string& key );
+
+    size_t getSize();
+
+    ~TileCache();
+};
+
+#endif // TILECACHE_H
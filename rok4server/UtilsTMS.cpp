@@ -58,44 +58,53 @@
 #include "intl.h"
 #include "config.h"
 
+std::string Rok4Server::getTMSTranscodingExtension ( std::string mime ) {
+    // Mêmes extensions que les formats natifs, pour qu'un client passe d'un format à l'autre sans changer d'URL
+    if ( mime == "image/jpeg" ) return "jpg";
+    if ( mime == "image/png" ) return "png";
+    if ( mime == "image/tiff" ) return "tif";
+    if ( mime.compare ( 0, 11, "image/x-bil" ) == 0 ) return "bil";
+    return "";
+}
 
-DataSource* Rok4Server::getTileParamTMS ( Request* request, Layer*& layer, std::string& str_tileMatrix, int& tileCol, int& tileRow, std::string& format, Style*& style) {
-    
-    // On cherche la version 1.0.0 dans le path pour savoir où trouver les informations
-    
-    std::stringstream ss(request->path);
-    std::string token;
-    char delim = '/';
-    int tmsVersionPos = -1;
-    
-    std::vector<std::string> pathParts;
-    while (std::getline(ss, token, delim)) {
-        if (token == "1.0.0") {
-            tmsVersionPos = pathParts.size();
+std::string Rok4Server::getTMSTranscodingFormat ( Layer* layer, std::string extension ) {
+    if ( extension == Rok4Format::toExtension ( layer->getDataPyramid()->getFormat() ) ) return "";
+
+    std::vector<std::string> transcodingFormats = layer->getTranscodingFormats();
+    for ( unsigned int i = 0; i < transcodingFormats.size(); i++ ) {
+        if ( extension == getTMSTranscodingExtension ( transcodingFormats.at ( i ) ) ) {
+            return transcodingFormats.at ( i );
         }
-        pathParts.push_back(token);
     }
+    return "";
+}
 
-    if (tmsVersionPos == -1) {
+
+DataSource* Rok4Server::getTileParamTMS ( Request* request, Layer*& layer, std::string& str_tileMatrix, int& tileCol, int& tileRow, std::string& format, Style*& style) {
+    
+    // Le chemin a été découpé à partir de la version 1.0.0 lors de l'analyse de la requête
+    int depth = request->tms.depth;
+
+    if (depth == -1) {
         // La version n'a pas été rencontrée
         return new SERDataSource ( new ServiceException ( "",OWS_MISSING_PARAMETER_VALUE,_ ( "Parametre VERSION absent." ),"tms" ) );
     }
 
-    if (tmsVersionPos == pathParts.size() - 1) {
+    if (depth == 0) {
         return new SERDataSource ( new ServiceException ( "",OWS_MISSING_PARAMETER_VALUE,_ ( "Parametre LAYER absent." ),"tms" ) );
     }
-    if (tmsVersionPos == pathParts.size() - 2) {
+    if (depth == 1) {
         return new SERDataSource ( new ServiceException ( "",OWS_MISSING_PARAMETER_VALUE,_ ( "Parametre Z absent." ),"tms" ) );
     }
-    if (tmsVersionPos == pathParts.size() - 3) {
+    if (depth == 2) {
         return new SERDataSource ( new ServiceException ( "",OWS_MISSING_PARAMETER_VALUE,_ ( "Parametre X absent." ),"tms" ) );
     }
-    if (tmsVersionPos == pathParts.size() - 4) {
+    if (depth == 3) {
         return new SERDataSource ( new ServiceException ( "",OWS_MISSING_PARAMETER_VALUE,_ ( "Parametre Y absent." ),"tms" ) );
     }
 
     // La couche
-    std::string str_layer = pathParts.at(tmsVersionPos + 1);
+    std::string str_layer = request->tms.layer;
 
     if ( Request::containForbiddenChars(str_layer)) {
         LOGGER_WARN("Forbidden char detected in TMS layer: " << str_layer);
@@ -111,7 +120,7 @@ DataSource* Rok4Server::getTileParamTMS ( Request* request, Layer*& layer, std::
     // Le niveau
     TileMatrixSet* tms = layer->getDataPyramid()->getTms();
 
-    str_tileMatrix = pathParts.at(tmsVersionPos + 2);
+    str_tileMatrix = request->tms.tileMatrix;
 
     if ( Request::containForbiddenChars(str_tileMatrix)) {
         LOGGER_WARN("Forbidden char detected in TMS tileMatrix: " << str_tileMatrix);
@@ -123,18 +132,13 @@ DataSource* Rok4Server::getTileParamTMS ( Request* request, Layer*& layer, std::
 
 
     // La colonne
-    std::string str_TileCol = pathParts.at(tmsVersionPos + 3);
+    std::string str_TileCol = request->tms.tileCol;
     if ( sscanf ( str_TileCol.c_str(),"%d",&tileCol ) != 1 )
         return new SERDataSource ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "La valeur du parametre TILECOL est incorrecte." ),"tms" ) );
 
     // La ligne        
-    std::string tileRowWithExtension = pathParts.at(tmsVersionPos + 4);
-    std::string str_TileRow;
-    std::string extension;
-    delim = '.';
-    ss = std::stringstream(tileRowWithExtension);
-    std::getline(ss, str_TileRow, delim);
-    std::getline(ss, extension, delim);
+    std::string str_TileRow = request->tms.tileRow;
+    std::string extension = request->tms.extension;
 
     if ( sscanf ( str_TileRow.c_str(),"%d",&tileRow ) != 1 )
         return new SERDataSource ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "La valeur du parametre TILEROW est incorrecte." ),"tms" ) );
@@ -152,55 +156,37 @@ DataSource* Rok4Server::getTileParamTMS ( Request* request, Layer*& layer, std::
         return new SERDataSource ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "L'extension n'est pas gere pour la couche " ) +str_layer,"tms" ) );
     }
 
-    if ( extension.compare ( Rok4Format::toExtension ( ( layer->getDataPyramid()->getFormat() ) ) ) != 0 ) {
-        return new SERDataSource ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "L'extension " ) +extension+_ ( " n'est pas gere pour la couche " ) +str_layer,"tms" ) );
+    if ( extension.compare ( Rok4Format::toExtension ( ( layer->getDataPyramid()->getFormat() ) ) ) == 0 ) {
+        format = Rok4Format::toMimeType ( ( layer->getDataPyramid()->getFormat() ) );
+        return NULL;
     }
 
-    format = Rok4Format::toMimeType ( ( layer->getDataPyramid()->getFormat() ) );
+    // Sinon, l'extension doit être celle d'un format de transcodage de la couche
+    format = getTMSTranscodingFormat ( layer, extension );
+    if ( ! format.empty() ) {
+        return NULL;
+    }
 
-    return NULL;
+    return new SERDataSource ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "L'extension " ) +extension+_ ( " n'est pas gere pour la couche " ) +str_layer,"tms" ) );
 }
 
 
 DataStream* Rok4Server::getLayerParamTMS ( Request* request, Layer*& layer, std::string& url ) {
-    // On cherche la version 1.0.0 dans le path pour savoir où trouver les informations
-    
-    std::stringstream ss(request->path);
-    std::string token;
-    char delim = '/';
-    int tmsVersionPos = -1;
-
-    url = request->scheme + request->hostName;
-
-    
-    std::vector<std::string> pathParts;
-    while (std::getline(ss, token, delim)) {
-        if (tmsVersionPos == -1) {
-            // On n'a pas encore rencontré la version (c'est peut-être ce morceau là)
-            // On ajoute donc à notre URL
-            url += token + "/";
-        }
-        if (token == "1.0.0") {
-            tmsVersionPos = pathParts.size();
-        }
-        pathParts.push_back(token);
-    }
-
-
-    if (tmsVersionPos == -1) {
+    // Le chemin a été découpé à partir de la version 1.0.0 lors de l'analyse de la requête
+    if (request->tms.depth == -1) {
         // La version n'a pas été rencontrée
         return new SERDataStream ( new ServiceException ( "",OWS_MISSING_PARAMETER_VALUE,_ ( "Parametre VERSION absent." ),"tms" ) );
     }
-    
-    // On enlève le dernier slash de trop
-    url.pop_back();
 
-    if (tmsVersionPos == pathParts.size() - 1) {
+    // URL du service, jusqu'à la version
+    url = request->scheme + request->hostName + request->tms.base;
+
+    if (request->tms.depth == 0) {
         return new SERDataStream ( new ServiceException ( "",OWS_MISSING_PARAMETER_VALUE,_ ( "Parametre LAYER absent." ),"tms" ) );
     }
 
     // La couche
-    std::string str_layer = pathParts.at(tmsVersionPos + 1);
+    std::string str_layer = request->tms.layer;
 
     if ( Request::containForbiddenChars(str_layer)) {
         LOGGER_WARN("Forbidden char detected in TMS layer: " << str_layer);
@@ -217,6 +203,29 @@ DataStream* Rok4Server::getLayerParamTMS ( Request* request, Layer*& layer, std:
     return NULL;
 }
 
+/* Découpage d'un document sur un tag, remplacé à la réponse par une partie variable */
+static void splitOnTag ( const std::string& document, const std::string& tag, std::vector<std::string>& fragments ) {
+    fragments.clear();
+    size_t beginPos = 0;
+    size_t endPos = document.find ( tag );
+    while ( endPos != std::string::npos ) {
+        fragments.push_back ( document.substr ( beginPos, endPos - beginPos ) );
+        beginPos = endPos + tag.length();
+        endPos = document.find ( tag, beginPos );
+    }
+    fragments.push_back ( document.substr ( beginPos ) );
+}
+
+/* Concaténation des fragments en intercalant la partie variable */
+static std::string joinFragments ( const std::vector<std::string>& fragments, const std::string& value ) {
+    std::string document = fragments.front();
+    for ( int i = 1; i < fragments.size(); i++ ) {
+        document += value;
+        document += fragments.at ( i );
+    }
+    return document;
+}
+
 DataStream* Rok4Server::TMSGetLayer ( Request* request ) {
 
     Layer* layer;
@@ -226,8 +235,16 @@ DataStream* Rok4Server::TMSGetLayer ( Request* request ) {
     if ( errorResp ) {
         return errorResp;
     }
-    errorResp = NULL;
 
+    std::map<std::string, std::vector<std::string> >::iterator it = tmsLayerFrag.find ( layer->getId() );
+    if ( it == tmsLayerFrag.end() ) {
+        return new MessageDataStream ( buildTMSLayer ( layer, serviceURL ),"application/xml" );
+    }
+
+    return new MessageDataStream ( joinFragments ( it->second, serviceURL ),"application/xml" );
+}
+
+std::string Rok4Server::buildTMSLayer ( Layer* layer, std::string serviceURL ) {
 
     std::ostringstream res;
     res << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n";
@@ -250,6 +267,17 @@ DataStream* Rok4Server::TMSGetLayer ( Request* request ) {
         "\" mime-type=\"" << Rok4Format::toMimeType ( ( layer->getDataPyramid()->getFormat() ) ) << 
         "\" extension=\"" << Rok4Format::toExtension ( ( layer->getDataPyramid()->getFormat() ) ) << "\" />\n";
 
+    // Les formats de transcodage sont servis sur les mêmes TileSets, avec leur propre extension
+    std::vector<std::string> transcodingFormats = layer->getTranscodingFormats();
+    for ( unsigned int i = 0; i < transcodingFormats.size(); i++ ) {
+        std::string extension = getTMSTranscodingExtension ( transcodingFormats.at ( i ) );
+        if ( extension.empty() ) continue;
+        res << "  <TileFormat width=\"" << tm->getTileW() <<
+            "\" height=\"" << tm->getTileH() <<
+            "\" mime-type=\"" << transcodingFormats.at ( i ) <<
+            "\" extension=\"" << extension << "\" />\n";
+    }
+
     res << "  <TileSets profile=\"none\">\n";
 
     int order = 0;
@@ -269,7 +297,7 @@ DataStream* Rok4Server::TMSGetLayer ( Request* request ) {
     res << "  </TileSets>\n";
     res << "</TileMap>\n";
 
-    return new MessageDataStream ( res.str(),"application/xml" );
+    return res.str();
 }
 
 DataStream* Rok4Server::TMSGetLayerMetadata ( Request* request ) {
@@ -281,8 +309,16 @@ DataStream* Rok4Server::TMSGetLayerMetadata ( Request* request ) {
     if ( errorResp ) {
         return errorResp;
     }
-    errorResp = NULL;
 
+    std::map<std::string, std::vector<std::string> >::iterator it = tmsMetadataFrag.find ( layer->getId() );
+    if ( it == tmsMetadataFrag.end() ) {
+        return new MessageDataStream ( buildTMSLayerMetadata ( layer, serviceURL ),"application/json" );
+    }
+
+    return new MessageDataStream ( joinFragments ( it->second, serviceURL ),"application/json" );
+}
+
+std::string Rok4Server::buildTMSLayerMetadata ( Layer* layer, std::string serviceURL ) {
 
     std::set<std::pair<std::string, Level*>, ComparatorLevel> orderedLevels = layer->getDataPyramid()->getOrderedLevels(true);
 
@@ -345,6 +381,23 @@ DataStream* Rok4Server::TMSGetLayerMetadata ( Request* request ) {
     res << "  \"format\": \"" << Rok4Format::toExtension ( ( layer->getDataPyramid()->getFormat() ) ) << "\",\n";
     res << "  \"tiles\":[\"" << serviceURL << "/" << layer->getId() << "/{z}/{x}/{y}." << Rok4Format::toExtension ( ( layer->getDataPyramid()->getFormat() ) ) << "\"]";
 
+    std::vector<std::string> transcodingFormats = layer->getTranscodingFormats();
+    std::vector<std::string> extensions;
+    for ( unsigned int i = 0; i < transcodingFormats.size(); i++ ) {
+        std::string extension = getTMSTranscodingExtension ( transcodingFormats.at ( i ) );
+        if ( ! extension.empty() ) extensions.push_back ( extension );
+    }
+    if ( ! extensions.empty() ) {
+        // Formats de transcodage, chacun avec son propre modèle d'URL
+        res << ",\n  \"transcoding\": [\n";
+        for ( unsigned int i = 0; i < extensions.size(); i++ ) {
+            if ( i != 0 ) res << ",\n";
+            res << "      {\"format\": \"" << extensions.at ( i ) << "\", \"tiles\":[\"" <<
+                serviceURL << "/" << layer->getId() << "/{z}/{x}/{y}." << extensions.at ( i ) << "\"]}";
+        }
+        res << "\n  ]";
+    }
+
 
     if (! Rok4Format::isRaster(layer->getDataPyramid()->getFormat())) {
         res << ",\n  \"vector_layers\": [\n";
@@ -356,7 +409,7 @@ DataStream* Rok4Server::TMSGetLayerMetadata ( Request* request ) {
     }
     res << "\n}\n";
 
-    return new MessageDataStream ( res.str(),"application/json" );
+    return res.str();
 }
 
 DataStream* Rok4Server::TMSGetCapabilities ( Request* request ) {
@@ -427,6 +480,10 @@ void Rok4Server::buildTMSCapabilities() {
         Layer* lay = itLay->second;
 
         if (lay->getTMSAuthorized()) {
+            // Descriptions de la couche (TileMap et métadonnées), ne dépendant de la requête que par l'URL du service
+            splitOnTag ( buildTMSLayer ( lay, pathTag ), pathTag, tmsLayerFrag[lay->getId()] );
+            splitOnTag ( buildTMSLayerMetadata ( lay, pathTag ), pathTag, tmsMetadataFrag[lay->getId()] );
+
             tmsCapaTemplate += "    <TileMap\n";
             tmsCapaTemplate += "      title=\"" + lay->getTitle() + "\" \n";
             tmsCapaTemplate += "      srs=\"" + lay->getDataPyramid()->getTms()->getCrs().getRequestCode() + "\" \n";
@@ -441,14 +498,5 @@ void Rok4Server::buildTMSCapabilities() {
     tmsCapaTemplate += "</TileMapService>\n";
 
     // Découpage en fragments constants.
-    size_t beginPos;
-    size_t endPos;
-    beginPos= 0;
-    endPos  = tmsCapaTemplate.find ( pathTag );
-    while ( endPos != std::string::npos ) {
-        tmsCapaFrag.push_back ( tmsCapaTemplate.substr ( beginPos,endPos-beginPos ) );
-        beginPos = endPos + pathTag.length();
-        endPos=tmsCapaTemplate.find ( pathTag,beginPos );
-    }
-    tmsCapaFrag.push_back ( tmsCapaTemplate.substr ( beginPos ) );
+    splitOnTag ( tmsCapaTemplate, pathTag, tmsCapaFrag );
 }
\ No newline at end of file
@@ -137,7 +137,7 @@ DataSource* Rok4Server::getTileParamWMTS ( Request* request, Layer*& layer, std:
         return new SERDataSource ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "Le format n'est pas gere pour la couche " ) +str_layer,"wmts" ) );
     }
 
-    if ( format.compare ( Rok4Format::toMimeType ( ( layer->getDataPyramid()->getFormat() ) ) ) !=0 )
+    if ( format.compare ( Rok4Format::toMimeType ( ( layer->getDataPyramid()->getFormat() ) ) ) !=0 && ! layer->isTranscodingFormat ( format ) )
         return new SERDataSource ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "Le format " ) +format+_ ( " n'est pas gere pour la couche " ) +str_layer,"wmts" ) );
 
     //Style
@@ -492,8 +492,13 @@ void Rok4Server::buildWMTSCapabilities() {
                 }
             }
 
-            // Contrainte : 1 layer = 1 pyramide = 1 format
+            // Contrainte : 1 layer = 1 pyramide = 1 format natif, éventuellement complété de formats de transcodage
             layerEl->LinkEndChild ( DocumentXML::buildTextNode ( "Format",Rok4Format::toMimeType ( ( layer->getDataPyramid()->getFormat() ) ) ) );
+            // Formats obtenus par transcodage des tuiles de la pyramide
+            std::vector<std::string> transcodingFormats = layer->getTranscodingFormats();
+            for ( unsigned int i = 0; i < transcodingFormats.size(); i++ ) {
+                layerEl->LinkEndChild ( DocumentXML::buildTextNode ( "Format", transcodingFormats.at ( i ) ) );
+            }
             if (layer->isGetFeatureInfoAvailable()){
                 for ( unsigned int i=0; i<servicesConf->getInfoFormatList()->size(); i++ ) {
                     layerEl->LinkEndChild ( DocumentXML::buildTextNode ( "InfoFormat",servicesConf->getInfoFormatList()->at ( i ) ) );
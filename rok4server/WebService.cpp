@@ -133,6 +133,7 @@ RawDataSource * WebService::performRequest(std::string request) {
             LOGGER_DEBUG("Perform the request => (" << nbPerformed << "/" << retry+1 << ") time");
             /* Perform the request, res will get the return code */
             res = curl_easy_perform(curl);
+            CurlPool::countRequest(curl);
 
             LOGGER_DEBUG("Checking for errors");
             /* Check for errors */
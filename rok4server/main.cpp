@@ -47,7 +47,7 @@
  *  - le chemin vers le fichier de configuration du serveur
  *
  * Signaux écoutés :
- *  - \b SIGHUP réinitialise la configuration du serveur
+ *  - \b SIGHUP recharge la configuration du serveur, sans interrompre les threads ni les requêtes en cours
  *  - \b SIGQUIT & \b SIGUSR1 éteint le serveur
  * \brief Exécutable du serveur ROK4
  * \~english
@@ -59,7 +59,7 @@
  *  - path to the server configuration file
  *
  * Listened Signal :
- *  - \b SIGHUP reinitialise the server configuration
+ *  - \b SIGHUP reloads the server configuration, without interrupting threads or running requests
  *  - \b SIGQUIT & \b SIGUSR1 shut the server down
  * \brief ROK4 Server executable
  */
@@ -77,23 +77,20 @@
 #include "config.h"
 #include "curl/curl.h"
 #include <time.h>
+#include <semaphore.h>
+#include <errno.h>
 /* Usage de la ligne de commande */
 
 Rok4Server* W;
-Rok4Server* Wtmp;
-bool reload;
 
 std::string serverConfigFile;
 time_t lastReload;
 
-// Minimum time between two signal to be defered.
-// Earlier signal would be ignored.
-// in microseconds
-static const double signal_defering_min_time = 1000000LL;
-
-volatile sig_atomic_t signal_pending = 0;
-volatile sig_atomic_t defer_signal;
-volatile timeval signal_timestamp;
+// Les gestionnaires de signaux se contentent de lever un drapeau et de réveiller le thread principal,
+// qui effectue le rechargement ou l'extinction hors du contexte du signal
+volatile sig_atomic_t reload_pending = 0;
+volatile sig_atomic_t shutdown_pending = 0;
+sem_t signal_semaphore;
 
 /**
  * \~french
@@ -112,31 +109,8 @@ void usage() {
  * \brief Force configuration reload
  */
 void reloadConfig ( int signum ) {
-    if ( defer_signal ) {
-        timeval now;
-        gettimeofday ( &now, NULL );
-        double delta = ( now.tv_sec - signal_timestamp.tv_sec ) *1000000LL + ( now.tv_usec - signal_timestamp.tv_usec );
-        if ( delta > signal_defering_min_time ) {
-            signal_pending = signum;
-        }
-    } else {
-        defer_signal++;
-        signal_pending = 0;
-        timeval begin;
-        gettimeofday ( &begin, NULL );
-        signal_timestamp.tv_sec = begin.tv_sec;
-        signal_timestamp.tv_usec = begin.tv_usec;
-        reload = true;
-        std::cout<< _ ( "Rechargement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
-        time_t tmpTime = time(NULL);
-        Wtmp = rok4ReloadServer ( serverConfigFile.c_str(), W, lastReload );
-        if ( !Wtmp ){
-            std::cout<< _ ( "Erreur lors du rechargement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
-            return;
-        }
-        lastReload = tmpTime;
-        W->terminate();
-    }
+    reload_pending = 1;
+    sem_post ( &signal_semaphore );
 }
 /**
  * \~french
@@ -145,13 +119,8 @@ void reloadConfig ( int signum ) {
  * \brief Force server shutdown
  */
 void shutdownServer ( int signum ) {
-    if ( defer_signal ) {
-        // Do nothing because rok4 is going to shutdown...
-    } else {
-        defer_signal++;
-        reload = false;
-        W->terminate();
-    }
+    shutdown_pending = 1;
+    sem_post ( &signal_semaphore );
 }
 
 /**
@@ -183,10 +152,7 @@ std::string getlocalepath() {
  */
 int main ( int argc, char** argv ) {
 
-    bool firstStart = true;
-    int sock = 0;
-    reload = true;
-    defer_signal = 1;
+    sem_init ( &signal_semaphore, 0, 0 );
     /* install Signal Handler for Conf Reloadind and Server Shutdown*/
     struct sigaction sa;
     sigemptyset ( &sa.sa_mask );
@@ -241,46 +207,54 @@ int main ( int argc, char** argv ) {
     }
 
     // Demarrage du serveur
-    while ( reload ) {
-        reload = false;
-        std::cout<< _ ( "Lancement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
-       
-        if ( firstStart ) {
-            lastReload = time(NULL);
-            W = rok4InitServer ( serverConfigFile.c_str() );
-            if ( !W ) {
-                return 1;
-            }
-            W->initFCGI();
-            firstStart = false;
-        } else {
-            std::cout<< _ ( "Mise a jour de la configuration" ) << "["<< getpid() <<"]" <<std::endl;
-            if ( Wtmp ) {
-                std::cout<< _ ( "Bascule des serveurs" ) << "["<< getpid() <<"]" <<std::endl;
-                W = Wtmp;
-                Wtmp = 0;
-            }
-            W->setFCGISocket ( sock );
+    std::cout<< _ ( "Lancement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
+    lastReload = time(NULL);
+    W = rok4InitServer ( serverConfigFile.c_str() );
+    if ( !W ) {
+        return 1;
+    }
+    if ( ! W->initFCGI() ) {
+        std::cerr<< _ ( "Impossible d'ecouter sur l'adresse HTTP configuree" ) <<std::endl;
+        rok4KillServer ( W );
+        return 1;
+    }
+    W->run();
+
+    // Traitement des signaux reçus
+    while ( ! shutdown_pending ) {
+        if ( sem_wait ( &signal_semaphore ) != 0 ) {
+            // Interruption par un signal : son gestionnaire a posté le sémaphore
+            continue;
         }
 
-        // Remove Event Lock
-        defer_signal--;
-        
-        W->run(signal_pending);
+        if ( shutdown_pending ) break;
 
-        if ( reload ) {
-            // Rechargement du serveur
+        if ( reload_pending ) {
+            reload_pending = 0;
+            std::cout<< _ ( "Rechargement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
             LOGGER_INFO ( _ ( "Rechargement de la configuration" ) );
-            sock = W->getFCGISocket();
-        } else {
-            // Extinction du serveur
-            LOGGER_INFO ( _ ( "Extinction du serveur ROK4" ) );
-        }
 
-        rok4KillServer ( W );
-        rok4ReloadLogger();
+            time_t tmpTime = time(NULL);
+            Rok4Server* Wtmp = rok4ReloadServer ( serverConfigFile.c_str(), W->getCurrentServer(), lastReload );
+            if ( !Wtmp ){
+                // Le serveur continue avec la configuration précédente
+                std::cout<< _ ( "Erreur lors du rechargement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
+                continue;
+            }
+            lastReload = tmpTime;
+
+            std::cout<< _ ( "Bascule des serveurs" ) << "["<< getpid() <<"]" <<std::endl;
+            W->switchServer ( Wtmp );
+            rok4ReloadLogger();
+        }
     }
 
+    // Extinction du serveur
+    LOGGER_INFO ( _ ( "Extinction du serveur ROK4" ) );
+    W->terminate();
+    rok4KillServer ( W );
+    sem_destroy ( &signal_semaphore );
+
     //CURL clean - one time for the whole program
     curl_global_cleanup();
 
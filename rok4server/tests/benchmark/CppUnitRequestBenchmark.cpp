@@ -0,0 +1,137 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sys/time.h>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Request.h"
+#include "../cppunit/RequestReference.h"
+
+using namespace RequestReference;
+
+/**
+ * Mesure de l'analyse des requêtes sur un mélange enregistré, hors de la suite de tests par défaut (variable BENCHMARK).
+ * L'analyse précédente (décodage de toute la chaîne puis std::map) sert de référence, les débits sont affichés sur la sortie standard.
+ */
+class CppUnitRequestBenchmark : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitRequestBenchmark );
+    // enregistrement des methodes de tests à jouer :
+    CPPUNIT_TEST ( test_request_mix );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+protected:
+
+    static const int iterations = 20000;
+
+    static double now() {
+        timeval tv;
+        gettimeofday ( &tv, NULL );
+        return tv.tv_sec + tv.tv_usec / 1000000.;
+    }
+
+    /**
+     * Paramètres lus par le serveur pour chaque requête, de l'identification jusqu'au calcul de la réponse
+     */
+    static const char* lookedUp[];
+
+    void test_request_mix() {
+        int total = 0;
+        for ( int i = 0; i < mixSize; i++ ) total += mix[i].weight;
+
+        // Référence : décodage, std::map et découpage du chemin TMS à chaque lecture
+        double start = now();
+        long found = 0;
+        for ( int n = 0; n < iterations; n++ ) {
+            for ( int i = 0; i < mixSize; i++ ) {
+                for ( int w = 0; w < mix[i].weight; w++ ) {
+                    std::vector<char> query ( mix[i].query, mix[i].query + strlen ( mix[i].query ) + 1 );
+                    std::map<std::string, std::string> params;
+                    referenceParse ( &query[0], params );
+                    for ( int k = 0; lookedUp[k]; k++ ) {
+                        if ( params.find ( lookedUp[k] ) != params.end() ) found++;
+                    }
+                    if ( params.empty() ) {
+                        std::stringstream ss ( mix[i].path );
+                        std::string token;
+                        std::vector<std::string> parts;
+                        while ( std::getline ( ss, token, '/' ) ) parts.push_back ( token );
+                        found += parts.size();
+                    }
+                }
+            }
+        }
+        double reference = ( double ) iterations * total / ( now() - start );
+
+        start = now();
+        long found2 = 0;
+        for ( int n = 0; n < iterations; n++ ) {
+            for ( int i = 0; i < mixSize; i++ ) {
+                for ( int w = 0; w < mix[i].weight; w++ ) {
+                    Request* request = build ( mix[i].path, mix[i].query );
+                    for ( int k = 0; lookedUp[k]; k++ ) {
+                        if ( request->hasParam ( lookedUp[k] ) ) found2++;
+                    }
+                    delete request;
+                }
+            }
+        }
+        double rate = ( double ) iterations * total / ( now() - start );
+
+        std::cout << std::endl << "Reference parsing : " << ( long ) reference << " requests/s";
+        std::cout << std::endl << "Request parsing and routing : " << ( long ) rate << " requests/s" << std::endl;
+        CPPUNIT_ASSERT ( found > 0 && found2 > 0 );
+    }
+
+};
+
+const char* CppUnitRequestBenchmark::lookedUp[] = {
+    "service", "request", "version", "wmtver", "layer", "layers", "style", "styles", "format", "tilematrixset", "tilematrix",
+    "tilerow", "tilecol", "crs", "srs", "bbox", "width", "height", "dpi", "format_options", "exception", NULL
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRequestBenchmark );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitRequestBenchmark, "CppUnitRequestBenchmark" );
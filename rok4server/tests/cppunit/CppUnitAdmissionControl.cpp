@@ -0,0 +1,102 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include "AdmissionControl.h"
+
+class CppUnitAdmissionControl : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitAdmissionControl );
+
+    CPPUNIT_TEST ( budgets );
+    CPPUNIT_TEST ( reservedThreads );
+
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void budgets();
+    void reservedThreads();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitAdmissionControl );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitAdmissionControl, "CppUnitAdmissionControl" );
+
+void CppUnitAdmissionControl::budgets() {
+    AdmissionControl ac;
+
+    std::vector<AdmissionBudget> getmapA;
+    getmapA.push_back ( AdmissionBudget ( "operation:GetMap", 2 ) );
+    getmapA.push_back ( AdmissionBudget ( "layer:A", 1 ) );
+
+    std::vector<AdmissionBudget> getmapB;
+    getmapB.push_back ( AdmissionBudget ( "operation:GetMap", 2 ) );
+    getmapB.push_back ( AdmissionBudget ( "layer:B", 1 ) );
+
+    CPPUNIT_ASSERT ( ac.admit ( getmapA, 0, 10 ) );
+    // Couche A pleine : refus à l'échéance
+    CPPUNIT_ASSERT ( ! ac.admit ( getmapA, 0, 10 ) );
+    CPPUNIT_ASSERT ( ac.admit ( getmapB, 0, 10 ) );
+    // Opération pleine
+    std::vector<AdmissionBudget> getmapC;
+    getmapC.push_back ( AdmissionBudget ( "operation:GetMap", 2 ) );
+    CPPUNIT_ASSERT ( ! ac.admit ( getmapC, 0, 10 ) );
+
+    ac.release ( getmapA );
+    CPPUNIT_ASSERT ( ac.admit ( getmapA, 0, 10 ) );
+
+    ac.release ( getmapA );
+    ac.release ( getmapB );
+}
+
+void CppUnitAdmissionControl::reservedThreads() {
+    AdmissionControl ac;
+    std::vector<AdmissionBudget> none;
+
+    CPPUNIT_ASSERT ( ac.admit ( none, 2, 1000 ) );
+    CPPUNIT_ASSERT ( ac.admit ( none, 2, 1000 ) );
+    // Les threads restants sont réservés : refus sans attente
+    CPPUNIT_ASSERT ( ! ac.admit ( none, 2, 1000 ) );
+
+    ac.release ( none );
+    CPPUNIT_ASSERT ( ac.admit ( none, 2, 1000 ) );
+
+    ac.release ( none );
+    ac.release ( none );
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "HttpFrontEnd.h"
+
+/**
+ * Frontal HTTP : des clients réels se connectent en local, deux threads de calcul répondent en renvoyant les paramètres de la requête.
+ * La requête "size=N" produit une réponse de N octets, écrite par blocs de 4 ko.
+ */
+class CppUnitHttpFrontEnd : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitHttpFrontEnd );
+    CPPUNIT_TEST ( test_parsing );
+    CPPUNIT_TEST ( test_invalid_requests );
+    CPPUNIT_TEST ( test_keep_alive );
+    CPPUNIT_TEST ( test_pipelining );
+    CPPUNIT_TEST ( test_slow_client );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    HttpFrontEnd* frontEnd;
+    int port;
+    pthread_t workers[2];
+    // Octets de corps de réponse produits par les threads de calcul
+    volatile long produced;
+
+    static void* work ( void* arg ) {
+        CppUnitHttpFrontEnd* self = ( CppUnitHttpFrontEnd* ) arg;
+        FCGX_Request request;
+        HttpConnection* conn;
+        while ( ( conn = self->frontEnd->nextRequest ( request ) ) != NULL ) {
+            std::string query = FCGX_GetParam ( "QUERY_STRING", request.envp );
+            char* host = FCGX_GetParam ( "HTTP_HOST", request.envp );
+
+            std::string headers = "Status: 200 OK\r\nContent-Type: text/plain\r\n\r\n";
+            FCGX_PutStr ( headers.data(), headers.size(), request.out );
+
+            if ( query.compare ( 0, 5, "size=" ) == 0 ) {
+                long size = atol ( query.substr ( 5 ).c_str() );
+                std::string block ( 4096, 'x' );
+                for ( long done = 0; done < size; done += block.size() ) {
+                    if ( FCGX_PutStr ( block.data(), block.size(), request.out ) < 0 ) break;
+                    __sync_fetch_and_add ( &self->produced, ( long ) block.size() );
+                }
+            } else {
+                char body[1024];
+                int length = FCGX_GetStr ( body, sizeof ( body ), request.in );
+                std::string answer = std::string ( FCGX_GetParam ( "REQUEST_METHOD", request.envp ) ) +
+                                     " " + FCGX_GetParam ( "SCRIPT_NAME", request.envp ) + " " + query +
+                                     " " + ( host ? host : "-" ) + " " + std::string ( body, length > 0 ? length : 0 );
+                FCGX_PutStr ( answer.data(), answer.size(), request.out );
+            }
+            self->frontEnd->finishRequest ( conn );
+        }
+        return 0;
+    }
+
+    int connectClient ( int receiveBuffer = 0 ) {
+        int fd = socket ( AF_INET, SOCK_STREAM, 0 );
+        if ( receiveBuffer > 0 ) setsockopt ( fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof ( receiveBuffer ) );
+        struct sockaddr_in sa;
+        memset ( &sa, 0, sizeof ( sa ) );
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons ( port );
+        sa.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+        CPPUNIT_ASSERT ( connect ( fd, ( struct sockaddr* ) &sa, sizeof ( sa ) ) == 0 );
+        struct timeval tv = { 5, 0 };
+        setsockopt ( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof ( tv ) );
+        return fd;
+    }
+
+    static void sendAll ( int fd, const std::string& data ) {
+        size_t sent = 0;
+        while ( sent < data.size() ) {
+            ssize_t n = send ( fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL );
+            CPPUNIT_ASSERT ( n > 0 );
+            sent += n;
+        }
+    }
+
+    // Lit au moins un octet de plus dans le tampon, false si la connexion est fermée
+    static bool receive ( int fd, std::string& buffer ) {
+        char chunk[65536];
+        ssize_t n = recv ( fd, chunk, sizeof ( chunk ), 0 );
+        if ( n <= 0 ) return false;
+        buffer.append ( chunk, n );
+        return true;
+    }
+
+    /**
+     * Lit la prochaine réponse du tampon (complété depuis le socket), corps "chunked", de taille connue ou délimité par la fermeture
+     * Retourne le code de statut, 0 si la connexion est fermée avant toute réponse
+     */
+    static int readResponse ( int fd, std::string& buffer, std::string& headers, std::string& body ) {
+        size_t end;
+        while ( ( end = buffer.find ( "\r\n\r\n" ) ) == std::string::npos ) {
+            if ( ! receive ( fd, buffer ) ) return 0;
+        }
+        headers = buffer.substr ( 0, end + 2 );
+        buffer.erase ( 0, end + 4 );
+        int status = atoi ( headers.substr ( 9, 3 ).c_str() );
+        body.clear();
+
+        size_t lengthPos = headers.find ( "Content-Length: " );
+        if ( headers.find ( "Transfer-Encoding: chunked" ) != std::string::npos ) {
+            while ( true ) {
+                size_t eol;
+                while ( ( eol = buffer.find ( "\r\n" ) ) == std::string::npos ) CPPUNIT_ASSERT ( receive ( fd, buffer ) );
+                size_t size = strtoul ( buffer.c_str(), NULL, 16 );
+                while ( buffer.size() < eol + 2 + size + 2 ) CPPUNIT_ASSERT ( receive ( fd, buffer ) );
+                body.append ( buffer, eol + 2, size );
+                buffer.erase ( 0, eol + 2 + size + 2 );
+                if ( size == 0 ) break;
+            }
+        } else if ( lengthPos != std::string::npos ) {
+            size_t size = atol ( headers.c_str() + lengthPos + 16 );
+            while ( buffer.size() < size ) CPPUNIT_ASSERT ( receive ( fd, buffer ) );
+            body = buffer.substr ( 0, size );
+            buffer.erase ( 0, size );
+        } else {
+            while ( receive ( fd, buffer ) ) {}
+            body.swap ( buffer );
+            buffer.clear();
+        }
+        return status;
+    }
+
+    // Requête unique sur une nouvelle connexion
+    int query ( const std::string& request, std::string& headers, std::string& body ) {
+        int fd = connectClient();
+        sendAll ( fd, request );
+        std::string buffer;
+        int status = readResponse ( fd, buffer, headers, body );
+        close ( fd );
+        return status;
+    }
+
+    static bool closedByServer ( int fd ) {
+        char c;
+        return recv ( fd, &c, 1, 0 ) == 0;
+    }
+
+public:
+
+    void setUp() {
+        // Port libre choisi par le système
+        int fd = socket ( AF_INET, SOCK_STREAM, 0 );
+        struct sockaddr_in sa;
+        memset ( &sa, 0, sizeof ( sa ) );
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+        bind ( fd, ( struct sockaddr* ) &sa, sizeof ( sa ) );
+        socklen_t length = sizeof ( sa );
+        getsockname ( fd, ( struct sockaddr* ) &sa, &length );
+        port = ntohs ( sa.sin_port );
+        close ( fd );
+
+        std::ostringstream address;
+        address << "127.0.0.1:" << port;
+        frontEnd = new HttpFrontEnd ( address.str(), 5 );
+        CPPUNIT_ASSERT ( frontEnd->open ( 16 ) );
+        frontEnd->start();
+
+        produced = 0;
+        for ( int i = 0; i < 2; i++ ) pthread_create ( &workers[i], NULL, CppUnitHttpFrontEnd::work, ( void* ) this );
+    }
+
+    void tearDown() {
+        frontEnd->stop();
+        for ( int i = 0; i < 2; i++ ) pthread_join ( workers[i], NULL );
+        delete frontEnd;
+    }
+
+    void test_parsing() {
+        std::string headers, body;
+
+        CPPUNIT_ASSERT_EQUAL ( 200, query ( "GET /wmts?SERVICE=WMTS&REQUEST=GetCapabilities HTTP/1.1\r\nHost: rok4.test\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "GET /wmts SERVICE=WMTS&REQUEST=GetCapabilities rok4.test " ), body );
+        CPPUNIT_ASSERT ( headers.find ( "Content-Type: text/plain\r\n" ) != std::string::npos );
+        CPPUNIT_ASSERT ( headers.find ( "Transfer-Encoding: chunked\r\n" ) != std::string::npos );
+
+        // Cible absolue, en-têtes insensibles à la casse et espaces autour des valeurs
+        CPPUNIT_ASSERT_EQUAL ( 200, query ( "GET http://proxy.test:8080/tms/1.0.0/?x=1 HTTP/1.1\r\nhOsT:   rok4.test  \r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "GET /tms/1.0.0/ x=1 rok4.test " ), body );
+
+        // Corps de requête POST
+        CPPUNIT_ASSERT_EQUAL ( 200, query ( "POST /wms HTTP/1.1\r\nContent-Length: 11\r\n\r\n<GetMap/>\r\n", headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "POST /wms  - <GetMap/>\r\n" ), body );
+
+        // HTTP/1.0 : pas d'encodage "chunked", fin de réponse à la fermeture
+        CPPUNIT_ASSERT_EQUAL ( 200, query ( "GET /wms?a=b HTTP/1.0\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT ( headers.compare ( 0, 9, "HTTP/1.0 " ) == 0 );
+        CPPUNIT_ASSERT ( headers.find ( "Connection: close\r\n" ) != std::string::npos );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "GET /wms a=b - " ), body );
+    }
+
+    void test_invalid_requests() {
+        std::string headers, body;
+        CPPUNIT_ASSERT_EQUAL ( 400, query ( "GET\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( 400, query ( "GET / HTTP/1.1\r\nsans deux points\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( 400, query ( "POST / HTTP/1.1\r\nContent-Length: 12a\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( 405, query ( "DELETE / HTTP/1.1\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT ( headers.find ( "Allow: GET, POST\r\n" ) != std::string::npos );
+        CPPUNIT_ASSERT_EQUAL ( 411, query ( "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( 413, query ( "POST / HTTP/1.1\r\nContent-Length: 100000000\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( 431, query ( "GET / HTTP/1.1\r\nX-Long: " + std::string ( 20000, 'a' ), headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( 505, query ( "GET / HTTP/2.0\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT ( headers.find ( "Connection: close\r\n" ) != std::string::npos );
+    }
+
+    void test_keep_alive() {
+        std::string buffer, headers, body;
+        int fd = connectClient();
+
+        // Plusieurs requêtes successives sur la même connexion
+        for ( int i = 0; i < 3; i++ ) {
+            std::ostringstream request;
+            request << "GET /wmts?i=" << i << " HTTP/1.1\r\nHost: rok4.test\r\n\r\n";
+            sendAll ( fd, request.str() );
+            CPPUNIT_ASSERT_EQUAL ( 200, readResponse ( fd, buffer, headers, body ) );
+            CPPUNIT_ASSERT ( headers.find ( "Connection: keep-alive\r\n" ) != std::string::npos );
+            std::ostringstream expected;
+            expected << "GET /wmts i=" << i << " rok4.test ";
+            CPPUNIT_ASSERT_EQUAL ( expected.str(), body );
+        }
+
+        // "Connection: close" : la connexion est fermée après la réponse
+        sendAll ( fd, "GET /last HTTP/1.1\r\nConnection: close\r\n\r\n" );
+        CPPUNIT_ASSERT_EQUAL ( 200, readResponse ( fd, buffer, headers, body ) );
+        CPPUNIT_ASSERT ( headers.find ( "Connection: close\r\n" ) != std::string::npos );
+        CPPUNIT_ASSERT ( buffer.empty() && closedByServer ( fd ) );
+        close ( fd );
+    }
+
+    void test_pipelining() {
+        std::string buffer, headers, body;
+        int fd = connectClient();
+
+        // Trois requêtes envoyées d'un bloc, la dernière en deux morceaux : les réponses arrivent dans l'ordre
+        sendAll ( fd, "GET /a HTTP/1.1\r\n\r\nPOST /b HTTP/1.1\r\nContent-Length: 4\r\n\r\nbodyGET /c?size=100000 HTTP/1.1\r\n" );
+        usleep ( 100000 );
+        sendAll ( fd, "Host: rok4.test\r\n\r\n" );
+
+        CPPUNIT_ASSERT_EQUAL ( 200, readResponse ( fd, buffer, headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "GET /a  - " ), body );
+        CPPUNIT_ASSERT_EQUAL ( 200, readResponse ( fd, buffer, headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "POST /b  - body" ), body );
+        CPPUNIT_ASSERT_EQUAL ( 200, readResponse ( fd, buffer, headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 102400, body.size() );
+        CPPUNIT_ASSERT ( buffer.empty() );
+        close ( fd );
+    }
+
+    void test_slow_client() {
+        std::string buffer, headers, body;
+
+        // Requête envoyée octet par octet
+        int slow = connectClient ( 16384 );
+        std::string request = "GET /slow?size=16777216 HTTP/1.1\r\nHost: rok4.test\r\n\r\n";
+        for ( size_t i = 0; i < request.size(); i++ ) sendAll ( slow, request.substr ( i, 1 ) );
+
+        // Le client ne lit pas : la production de la réponse est suspendue, bien avant ses 16 Mo
+        usleep ( 500000 );
+        long stalled = produced;
+        usleep ( 200000 );
+        CPPUNIT_ASSERT_EQUAL ( stalled, ( long ) produced );
+        CPPUNIT_ASSERT ( stalled < 16777216 );
+
+        // Pendant ce temps, les autres clients sont servis
+        CPPUNIT_ASSERT_EQUAL ( 200, query ( "GET /other HTTP/1.1\r\n\r\n", headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "GET /other  - " ), body );
+
+        // Le client lit enfin : la réponse est complète
+        CPPUNIT_ASSERT_EQUAL ( 200, readResponse ( slow, buffer, headers, body ) );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 16777216, body.size() );
+        CPPUNIT_ASSERT ( body.find_first_not_of ( 'x' ) == std::string::npos );
+        close ( slow );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitHttpFrontEnd );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitHttpFrontEnd, "CppUnitHttpFrontEnd" );
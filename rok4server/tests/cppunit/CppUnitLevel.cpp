@@ -0,0 +1,235 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "Rok4Api.h"
+#include "Rok4Server.h"
+#include "Level.h"
+#include "Rok4Image.h"
+#include "StoreDataSource.h"
+
+/**
+ * Lecture groupée des tuiles d'un niveau (Level::readTiles) dans des dalles écrites pour le test :
+ * 4x2 tuiles par dalle, dans un niveau de 8x2 tuiles dont seules les 4 premières colonnes sont dans les limites.
+ */
+class CppUnitLevel : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitLevel );
+    CPPUNIT_TEST ( test_read_tiles );
+    CPPUNIT_TEST ( test_read_tiles_window );
+    CPPUNIT_TEST ( test_truncated_index );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    std::string dir;
+    Rok4Server* server;
+    Level* level;
+
+    static void writeFile ( std::string path, std::string content ) {
+        std::ofstream out ( path.c_str(), std::ios::binary );
+        out << content;
+    }
+
+    /**
+     * Écrit une dalle : en-tête, index puis données, chaque tuile étant donnée par sa position, sa taille et son contenu
+     */
+    void writeSlab ( int x, int y, const uint32_t* offsets, const uint32_t* sizes, const std::vector<std::string>& contents, size_t slabSize ) {
+        std::string slab ( slabSize, '\0' );
+        for ( int n = 0; n < 8; n++ ) {
+            memcpy ( &slab[ROK4_IMAGE_HEADER_SIZE + 4 * n], &offsets[n], 4 );
+            memcpy ( &slab[ROK4_IMAGE_HEADER_SIZE + 32 + 4 * n], &sizes[n], 4 );
+            if ( ! contents.at ( n ).empty() ) slab.replace ( offsets[n], contents.at ( n ).size(), contents.at ( n ) );
+        }
+        std::string mkdir = "mkdir -p " + level->getDirPath ( x, y );
+        CPPUNIT_ASSERT_EQUAL ( 0, system ( mkdir.c_str() ) );
+        writeFile ( level->getPath ( x, y ), slab );
+    }
+
+    static std::string tileContent ( DataSource* source ) {
+        size_t size;
+        const uint8_t* data = source->getData ( size );
+        return std::string ( ( const char* ) data, size );
+    }
+
+    static void clearSources ( std::vector<std::vector<DataSource*> >& sources ) {
+        for ( unsigned int y = 0; y < sources.size(); y++ ) {
+            for ( unsigned int x = 0; x < sources.at ( y ).size(); x++ ) delete sources.at ( y ).at ( x );
+        }
+    }
+
+    // Dalle de référence : tuiles fusionnées, éloignées, absentes ou invalides
+    void writeReferenceSlab ( int x, int y ) {
+        uint32_t hi = ROK4_IMAGE_HEADER_SIZE + 2 * 4 * 8;
+        // 0, 1 et 6 proches (fusionnées), 2 éloignée, 3 absente, 4 dans l'index, 5 au delà de la dalle, 7 trop volumineuse
+        uint32_t offsets[8] = { hi, hi + 12, 4000, 0, 100, 4100, hi + 24, 5000 };
+        uint32_t sizes[8] = { 10, 10, 10, 0, 10, 50, 6, MAX_TILE_SIZE + 1 };
+        std::vector<std::string> contents ( 8 );
+        contents[0] = std::string ( 10, 'a' );
+        contents[1] = std::string ( 10, 'b' );
+        contents[2] = std::string ( 10, 'c' );
+        contents[6] = std::string ( 6, 'd' );
+        writeSlab ( x, y, offsets, sizes, contents, 4110 );
+    }
+
+public:
+
+    void setUp() {
+        char tmpl[] = "/tmp/CppUnitLevelXXXXXX";
+        dir = std::string ( mkdtemp ( tmpl ) );
+
+        mkdir ( ( dir + "/layers" ).c_str(), 0755 );
+        mkdir ( ( dir + "/styles" ).c_str(), 0755 );
+        mkdir ( ( dir + "/tms" ).c_str(), 0755 );
+        mkdir ( ( dir + "/proj" ).c_str(), 0755 );
+
+        writeFile ( dir + "/server.conf",
+            "<serverConf><logOutput>standard_output_stream_for_errors</logOutput><logLevel>fatal</logLevel>"
+            "<nbThread>1</nbThread><WMTSSupport>true</WMTSSupport><TMSSupport>false</TMSSupport><WMSSupport>false</WMSSupport>"
+            "<servicesConfigFile>" + dir + "/services.conf</servicesConfigFile>"
+            "<layerDir>" + dir + "/layers</layerDir><styleDir>" + dir + "/styles</styleDir>"
+            "<tileMatrixSetDir>" + dir + "/tms</tileMatrixSetDir><projConfigDir>" + dir + "/proj</projConfigDir>"
+            "<storageMergingGap>16</storageMergingGap></serverConf>" );
+        writeFile ( dir + "/services.conf", "<servicesConf><title>Level</title></servicesConf>" );
+        writeFile ( dir + "/proj/epsg",
+            "<3857> +proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0 +k=1.0 +units=m +nadgrids=@null +wktext +no_defs <>\n" );
+        writeFile ( dir + "/tms/PM.tms",
+            "<tileMatrixSet><crs>EPSG:3857</crs>"
+            "<tileMatrix><id>0</id><resolution>1</resolution><topLeftCornerX>0</topLeftCornerX><topLeftCornerY>0</topLeftCornerY>"
+            "<tileWidth>256</tileWidth><tileHeight>256</tileHeight><matrixWidth>8</matrixWidth><matrixHeight>2</matrixHeight></tileMatrix>"
+            "</tileMatrixSet>" );
+        writeFile ( dir + "/styles/normal.stl",
+            "<style><Identifier>normal</Identifier><Title>Normal</Title><Abstract>Données brutes</Abstract></style>" );
+        writeFile ( dir + "/ORTHO.pyr",
+            "<Pyramid><tileMatrixSet>PM</tileMatrixSet><format>TIFF_RAW_INT8</format>"
+            "<photometric>rgb</photometric><channels>3</channels><nodataValue>255,255,255</nodataValue>"
+            "<level><tileMatrix>0</tileMatrix><baseDir>" + dir + "/data</baseDir><pathDepth>1</pathDepth>"
+            "<tilesPerWidth>4</tilesPerWidth><tilesPerHeight>2</tilesPerHeight>"
+            "<TMSLimits><minTileRow>0</minTileRow><maxTileRow>1</maxTileRow><minTileCol>0</minTileCol><maxTileCol>3</maxTileCol></TMSLimits>"
+            "</level></Pyramid>" );
+        writeFile ( dir + "/layers/ORTHO.lay",
+            "<layer><title>Ortho</title><abstract>Ortho</abstract><style>normal</style>"
+            "<EX_GeographicBoundingBox><westBoundLongitude>0</westBoundLongitude><eastBoundLongitude>1</eastBoundLongitude>"
+            "<southBoundLatitude>-1</southBoundLatitude><northBoundLatitude>0</northBoundLatitude></EX_GeographicBoundingBox>"
+            "<boundingBox CRS=\"EPSG:3857\" minx=\"0\" miny=\"-512\" maxx=\"2048\" maxy=\"0\"/>"
+            "<resampling>nn</resampling><pyramid>" + dir + "/ORTHO.pyr</pyramid></layer>" );
+
+        server = rok4InitServer ( ( dir + "/server.conf" ).c_str() );
+        CPPUNIT_ASSERT ( server != NULL );
+        level = server->getLayerList() ["ORTHO"]->getDataPyramid()->getLevels() ["0"];
+        CPPUNIT_ASSERT ( level != NULL );
+        CPPUNIT_ASSERT_EQUAL ( 16, level->getContext()->getMergingGap() );
+    }
+
+    void tearDown() {
+        rok4KillServer ( server );
+        std::string command = "rm -rf " + dir;
+        system ( command.c_str() );
+    }
+
+    void test_read_tiles() {
+        writeReferenceSlab ( 0, 0 );
+        // Dalle hors des limites du niveau : jamais lue
+        writeReferenceSlab ( 4, 0 );
+
+        std::vector<std::vector<DataSource*> > sources ( 2, std::vector<DataSource*> ( 8, ( DataSource* ) 0 ) );
+        level->readTiles ( 0, 0, 8, 2, sources );
+
+        CPPUNIT_ASSERT ( sources[0][0] && sources[0][1] && sources[0][2] && sources[1][2] );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( 10, 'a' ), tileContent ( sources[0][0] ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( 10, 'b' ), tileContent ( sources[0][1] ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( 10, 'c' ), tileContent ( sources[0][2] ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( 6, 'd' ), tileContent ( sources[1][2] ) );
+
+        // Tuiles absentes, invalides, tronquées, trop volumineuses ou hors limites
+        CPPUNIT_ASSERT ( sources[0][3] == NULL );
+        CPPUNIT_ASSERT ( sources[1][0] == NULL );
+        CPPUNIT_ASSERT ( sources[1][1] == NULL );
+        CPPUNIT_ASSERT ( sources[1][3] == NULL );
+        for ( int x = 4; x < 8; x++ ) CPPUNIT_ASSERT ( sources[0][x] == NULL && sources[1][x] == NULL );
+
+        // Les tuiles fusionnées sont des portions de la même lecture, sans recopie
+        size_t size;
+        const uint8_t* first = sources[0][0]->getData ( size );
+        CPPUNIT_ASSERT ( sources[0][1]->getData ( size ) == first + 12 );
+        CPPUNIT_ASSERT ( sources[1][2]->getData ( size ) == first + 24 );
+
+        // Le buffer commun reste valide tant qu'une portion existe
+        delete sources[0][0];
+        sources[0][0] = NULL;
+        CPPUNIT_ASSERT_EQUAL ( std::string ( 6, 'd' ), tileContent ( sources[1][2] ) );
+
+        clearSources ( sources );
+    }
+
+    void test_read_tiles_window() {
+        writeReferenceSlab ( 0, 0 );
+
+        // Fenêtre débordant à gauche de la pyramide
+        std::vector<std::vector<DataSource*> > sources ( 1, std::vector<DataSource*> ( 3, ( DataSource* ) 0 ) );
+        level->readTiles ( -1, 0, 3, 1, sources );
+
+        CPPUNIT_ASSERT ( sources[0][0] == NULL );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( 10, 'a' ), tileContent ( sources[0][1] ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( 10, 'b' ), tileContent ( sources[0][2] ) );
+
+        clearSources ( sources );
+    }
+
+    void test_truncated_index() {
+        // L'index de la dalle est tronqué, les tailles des tuiles manquent : aucune tuile n'est lue
+        writeReferenceSlab ( 0, 0 );
+        std::string path = level->getPath ( 0, 0 );
+        CPPUNIT_ASSERT_EQUAL ( 0, truncate ( path.c_str(), ROK4_IMAGE_HEADER_SIZE + 20 ) );
+
+        std::vector<std::vector<DataSource*> > sources ( 2, std::vector<DataSource*> ( 4, ( DataSource* ) 0 ) );
+        level->readTiles ( 0, 0, 4, 2, sources );
+        for ( int y = 0; y < 2; y++ ) {
+            for ( int x = 0; x < 4; x++ ) CPPUNIT_ASSERT ( sources[y][x] == NULL );
+        }
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitLevel );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitLevel, "CppUnitLevel" );
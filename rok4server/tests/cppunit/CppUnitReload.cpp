@@ -0,0 +1,203 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include "Rok4Api.h"
+#include "Rok4Server.h"
+#include "ContextBook.h"
+
+/**
+ * Rechargement de la configuration : un rechargement en échec laisse le serveur courant intact,
+ * un rechargement réussi reprend les objets non modifiés et l'annuaire de contextes.
+ * La configuration (serveur, services, TMS, style, pyramide et couche) est écrite dans un dossier temporaire.
+ */
+class CppUnitReload : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitReload );
+    CPPUNIT_TEST ( test_failed_reload );
+    CPPUNIT_TEST ( test_successful_reload );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    std::string dir;
+    std::string serverConf;
+
+    static void writeFile ( std::string path, std::string content ) {
+        std::ofstream out ( path.c_str() );
+        out << content;
+    }
+
+    void writeServerConf ( int mergingGap ) {
+        std::ostringstream oss;
+        oss << "<serverConf>"
+            << "<logOutput>standard_output_stream_for_errors</logOutput>"
+            << "<logLevel>fatal</logLevel>"
+            << "<nbThread>1</nbThread>"
+            << "<WMTSSupport>true</WMTSSupport>"
+            << "<TMSSupport>false</TMSSupport>"
+            << "<WMSSupport>false</WMSSupport>"
+            << "<servicesConfigFile>" << dir << "/services.conf</servicesConfigFile>"
+            << "<layerDir>" << dir << "/layers</layerDir>"
+            << "<styleDir>" << dir << "/styles</styleDir>"
+            << "<tileMatrixSetDir>" << dir << "/tms</tileMatrixSetDir>"
+            << "<projConfigDir>" << dir << "/proj</projConfigDir>"
+            << "<storageMergingGap>" << mergingGap << "</storageMergingGap>"
+            << "</serverConf>";
+        writeFile ( serverConf, oss.str() );
+    }
+
+public:
+
+    void setUp() {
+        char tmpl[] = "/tmp/CppUnitReloadXXXXXX";
+        dir = std::string ( mkdtemp ( tmpl ) );
+        serverConf = dir + "/server.conf";
+
+        mkdir ( ( dir + "/layers" ).c_str(), 0755 );
+        mkdir ( ( dir + "/styles" ).c_str(), 0755 );
+        mkdir ( ( dir + "/tms" ).c_str(), 0755 );
+        mkdir ( ( dir + "/proj" ).c_str(), 0755 );
+        mkdir ( ( dir + "/pyramid" ).c_str(), 0755 );
+
+        writeServerConf ( 1024 );
+
+        writeFile ( dir + "/services.conf", "<servicesConf><title>Reload</title></servicesConf>" );
+
+        writeFile ( dir + "/proj/epsg",
+            "<3857> +proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0 +k=1.0 +units=m +nadgrids=@null +wktext +no_defs <>\n" );
+
+        writeFile ( dir + "/tms/PM.tms",
+            "<tileMatrixSet><crs>EPSG:3857</crs>"
+            "<tileMatrix><id>0</id><resolution>156543.0339280410</resolution>"
+            "<topLeftCornerX>-20037508.3427892480</topLeftCornerX><topLeftCornerY>20037508.3427892480</topLeftCornerY>"
+            "<tileWidth>256</tileWidth><tileHeight>256</tileHeight><matrixWidth>1</matrixWidth><matrixHeight>1</matrixHeight></tileMatrix>"
+            "</tileMatrixSet>" );
+
+        writeFile ( dir + "/styles/normal.stl",
+            "<style><Identifier>normal</Identifier><Title>Normal</Title><Abstract>Données brutes</Abstract></style>" );
+
+        writeFile ( dir + "/pyramid/ORTHO.pyr",
+            "<Pyramid><tileMatrixSet>PM</tileMatrixSet><format>TIFF_RAW_INT8</format>"
+            "<photometric>rgb</photometric><channels>3</channels><nodataValue>255,255,255</nodataValue>"
+            "<level><tileMatrix>0</tileMatrix><baseDir>" + dir + "/pyramid/data</baseDir><pathDepth>2</pathDepth>"
+            "<tilesPerWidth>1</tilesPerWidth><tilesPerHeight>1</tilesPerHeight>"
+            "<TMSLimits><minTileRow>0</minTileRow><maxTileRow>0</maxTileRow><minTileCol>0</minTileCol><maxTileCol>0</maxTileCol></TMSLimits>"
+            "</level></Pyramid>" );
+
+        writeFile ( dir + "/layers/ORTHO.lay",
+            "<layer><title>Ortho</title><abstract>Ortho</abstract><style>normal</style>"
+            "<EX_GeographicBoundingBox><westBoundLongitude>-180</westBoundLongitude><eastBoundLongitude>180</eastBoundLongitude>"
+            "<southBoundLatitude>-85</southBoundLatitude><northBoundLatitude>85</northBoundLatitude></EX_GeographicBoundingBox>"
+            "<boundingBox CRS=\"EPSG:3857\" minx=\"-20037508\" miny=\"-20037508\" maxx=\"20037508\" maxy=\"20037508\"/>"
+            "<resampling>nn</resampling><pyramid>" + dir + "/pyramid/ORTHO.pyr</pyramid></layer>" );
+    }
+
+    void tearDown() {
+        std::string command = "rm -rf " + dir;
+        system ( command.c_str() );
+    }
+
+    void test_failed_reload() {
+        Rok4Server* server = rok4InitServer ( serverConf.c_str() );
+        CPPUNIT_ASSERT ( server != NULL );
+
+        ContextBook* book = server->getObjectBook();
+        Context* context = book->getContext ( ContextType::FILECONTEXT, "" );
+        CPPUNIT_ASSERT ( context != NULL );
+        CPPUNIT_ASSERT_EQUAL ( 1024, context->getMergingGap() );
+        Layer* layer = server->getLayerList() ["ORTHO"];
+        CPPUNIT_ASSERT ( layer != NULL );
+
+        // Nouvel écart de fusion, mais plus aucune couche : le rechargement échoue
+        writeServerConf ( 4096 );
+        rename ( ( dir + "/layers/ORTHO.lay" ).c_str(), ( dir + "/layers/ORTHO.bak" ).c_str() );
+
+        CPPUNIT_ASSERT ( rok4ReloadServer ( serverConf.c_str(), server, time ( NULL ) ) == NULL );
+
+        // Le serveur courant et son annuaire sont intacts
+        CPPUNIT_ASSERT ( server->getObjectBook() == book );
+        CPPUNIT_ASSERT_EQUAL ( 1, book->size() );
+        CPPUNIT_ASSERT_EQUAL ( 1024, context->getMergingGap() );
+        CPPUNIT_ASSERT ( server->getLayerList() ["ORTHO"] == layer );
+        CPPUNIT_ASSERT ( layer->getDataPyramid() != NULL );
+
+        rok4KillServer ( server );
+    }
+
+    void test_successful_reload() {
+        Rok4Server* server = rok4InitServer ( serverConf.c_str() );
+        CPPUNIT_ASSERT ( server != NULL );
+
+        ContextBook* book = server->getObjectBook();
+        Context* context = book->getContext ( ContextType::FILECONTEXT, "" );
+        Layer* layer = server->getLayerList() ["ORTHO"];
+        TileMatrixSet* tms = server->getTmsList() ["PM"];
+        Style* style = server->getStylesList() ["normal"];
+        CPPUNIT_ASSERT ( layer != NULL && tms != NULL && style != NULL );
+
+        writeServerConf ( 4096 );
+
+        // Aucun fichier de TMS, style ou couche n'a changé depuis ce "dernier chargement"
+        Rok4Server* newServer = rok4ReloadServer ( serverConf.c_str(), server, time ( NULL ) + 1 );
+        CPPUNIT_ASSERT ( newServer != NULL );
+
+        // Les objets non modifiés et l'annuaire sont repris, le nouvel écart de fusion est appliqué
+        CPPUNIT_ASSERT ( newServer->getLayerList() ["ORTHO"] == layer );
+        CPPUNIT_ASSERT ( newServer->getTmsList() ["PM"] == tms );
+        CPPUNIT_ASSERT ( newServer->getStylesList() ["normal"] == style );
+        CPPUNIT_ASSERT ( newServer->getObjectBook() == book );
+        CPPUNIT_ASSERT ( book->getContext ( ContextType::FILECONTEXT, "" ) == context );
+        CPPUNIT_ASSERT_EQUAL ( 4096, context->getMergingGap() );
+
+        // L'ancienne configuration est détruite sans les objets repris
+        rok4KillServer ( server );
+        CPPUNIT_ASSERT ( layer->getDataPyramid() != NULL );
+        CPPUNIT_ASSERT_EQUAL ( 1, book->size() );
+
+        rok4KillServer ( newServer );
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitReload );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitReload, "CppUnitReload" );
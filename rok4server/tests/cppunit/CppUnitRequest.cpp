@@ -46,6 +46,7 @@
 #include "Request.cpp"
 #include "ConfLoader.h"
 #include "ConfLoader.cpp"
+#include "RequestReference.h"
 
 
 class CppUnitRequest : public CPPUNIT_NS::TestFixture {
@@ -55,11 +56,14 @@ class CppUnitRequest : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST ( testsplit );
     CPPUNIT_TEST ( testurl_decode );
     CPPUNIT_TEST ( testtoLowerCase );
+    CPPUNIT_TEST ( testacceptsEncoding );
     CPPUNIT_TEST ( testremoveNameSpace );
     CPPUNIT_TEST ( testhasParam );
     CPPUNIT_TEST ( testgetParam );
     CPPUNIT_TEST ( testgetCapWMSParam );
     CPPUNIT_TEST ( testgetCapWMTSParam );
+    CPPUNIT_TEST ( testsameParams );
+    CPPUNIT_TEST ( testtmsRoute );
     CPPUNIT_TEST_SUITE_END();
 
 protected:
@@ -123,11 +127,14 @@ protected:
     void testsplit();
     void testurl_decode();
     void testtoLowerCase();
+    void testacceptsEncoding();
     void testremoveNameSpace();
     void testhasParam();
     void testgetParam();
     void testgetCapWMSParam();
     void testgetCapWMTSParam();
+    void testsameParams();
+    void testtmsRoute();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRequest );
@@ -225,6 +232,17 @@ void CppUnitRequest::testtoLowerCase() {
     delete myword4;
 }
 
+void CppUnitRequest::testacceptsEncoding() {
+    CPPUNIT_ASSERT_MESSAGE ( "no header", ! Request::acceptsEncoding ( NULL, "gzip" ) );
+    CPPUNIT_ASSERT_MESSAGE ( "simple list", Request::acceptsEncoding ( "deflate, gzip, br", "gzip" ) );
+    CPPUNIT_ASSERT_MESSAGE ( "case insensitive", Request::acceptsEncoding ( "GZip;q=0.5", "gzip" ) );
+    CPPUNIT_ASSERT_MESSAGE ( "prefix only", ! Request::acceptsEncoding ( "gzipx, x-gzip", "gzip" ) );
+    CPPUNIT_ASSERT_MESSAGE ( "null weight", ! Request::acceptsEncoding ( "gzip;q=0, deflate", "gzip" ) );
+    CPPUNIT_ASSERT_MESSAGE ( "wildcard", Request::acceptsEncoding ( "br, *;q=0.1", "gzip" ) );
+    CPPUNIT_ASSERT_MESSAGE ( "explicit refusal over wildcard", ! Request::acceptsEncoding ( "*, gzip;q=0", "gzip" ) );
+    CPPUNIT_ASSERT_MESSAGE ( "identity only", ! Request::acceptsEncoding ( "identity", "gzip" ) );
+}
+
 void CppUnitRequest::testremoveNameSpace() {
     std::string balise ( "" );
     std::string result ( "" );
@@ -437,6 +455,64 @@ void CppUnitRequest::testgetCapWMTSParam() {
     delete marequete2;
 }
 
+void CppUnitRequest::testsameParams() {
+    // L'analyse en une passe donne les mêmes paramètres que l'analyse de référence
+    for ( int i = 0; i < RequestReference::mixSize; i++ ) {
+        const RequestReference::RecordedRequest& recorded = RequestReference::mix[i];
+        std::vector<char> query ( recorded.query, recorded.query + strlen ( recorded.query ) + 1 );
+        std::map<std::string, std::string> reference;
+        RequestReference::referenceParse ( &query[0], reference );
+
+        Request* request = RequestReference::build ( recorded.path, recorded.query );
+        CPPUNIT_ASSERT_EQUAL ( reference.size(), request->params.size() );
+        for ( std::map<std::string, std::string>::iterator it = reference.begin(); it != reference.end(); it++ ) {
+            CPPUNIT_ASSERT ( request->hasParam ( it->first ) );
+            CPPUNIT_ASSERT_EQUAL ( it->second, request->getParam ( it->first ) );
+        }
+        delete request;
+    }
+}
+
+void CppUnitRequest::testtmsRoute() {
+    Request* request = RequestReference::build ( "/rok4/tms/1.0.0/ORTHO/12/2075/1409.jpg", "" );
+    CPPUNIT_ASSERT ( request->service == ServiceType::TMS );
+    CPPUNIT_ASSERT ( request->request == RequestType::GETTILE );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "/rok4/tms/1.0.0" ), request->tms.base );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "ORTHO" ), request->tms.layer );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "12" ), request->tms.tileMatrix );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "2075" ), request->tms.tileCol );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "1409" ), request->tms.tileRow );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "jpg" ), request->tms.extension );
+    delete request;
+
+    // Plusieurs éléments "1.0.0" : la base du service et la couche sont relatives au dernier
+    request = RequestReference::build ( "/rok4/1.0.0/tms/1.0.0/ORTHO/12/2075/1409.png", "" );
+    CPPUNIT_ASSERT ( request->request == RequestType::GETTILE );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "/rok4/1.0.0/tms/1.0.0" ), request->tms.base );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "ORTHO" ), request->tms.layer );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "12" ), request->tms.tileMatrix );
+    delete request;
+
+    request = RequestReference::build ( "/rok4/1.0.0/tms/1.0.0", "" );
+    CPPUNIT_ASSERT ( request->request == RequestType::GETCAPABILITIES );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "/rok4/1.0.0/tms/1.0.0" ), request->tms.base );
+    CPPUNIT_ASSERT_EQUAL ( 0, request->tms.depth );
+    delete request;
+
+    request = RequestReference::build ( "/rok4/tms/1.0.0/ORTHO/metadata.json", "" );
+    CPPUNIT_ASSERT ( request->request == RequestType::GETLAYERMETADATA );
+    delete request;
+
+    request = RequestReference::build ( "/rok4/tms/1.0.0/ORTHO/", "" );
+    CPPUNIT_ASSERT ( request->request == RequestType::GETLAYER );
+    delete request;
+
+    request = RequestReference::build ( "/rok4/tms", "" );
+    CPPUNIT_ASSERT ( request->request == RequestType::GETSERVICES );
+    CPPUNIT_ASSERT_EQUAL ( -1, request->tms.depth );
+    delete request;
+}
+
 void CppUnitRequest::tearDown() {
     delete services_conf;
 }
@@ -0,0 +1,271 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "Rok4Api.h"
+#include "Rok4Server.h"
+#include "Level.h"
+#include "Rok4Image.h"
+#include "RequestReference.h"
+
+/**
+ * Tuiles TMS dans un format de transcodage : résolution de l'extension, documents de la couche,
+ * transcodage d'une tuile stockée et contrôle d'admission.
+ * La couche ORTHO (TIFF brut, extension "tif") est transcodée en JPEG et en PNG.
+ */
+class CppUnitTMSTranscoding : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitTMSTranscoding );
+    CPPUNIT_TEST ( test_extensions );
+    CPPUNIT_TEST ( test_routing );
+    CPPUNIT_TEST ( test_layer_documents );
+    CPPUNIT_TEST ( test_transcoding );
+    CPPUNIT_TEST ( test_admission );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    std::string dir;
+    Rok4Server* server;
+    Layer* layer;
+
+    static void writeFile ( std::string path, std::string content ) {
+        std::ofstream out ( path.c_str(), std::ios::binary );
+        out << content;
+    }
+
+    // Dalle d'une seule tuile brute 256x256 RGB, de couleur uniforme
+    void writeSlab() {
+        Level* level = layer->getDataPyramid()->getLevel ( "0" );
+        uint32_t offset = ROK4_IMAGE_HEADER_SIZE + 8;
+        uint32_t size = 256 * 256 * 3;
+        std::string slab ( offset, '\0' );
+        memcpy ( &slab[ROK4_IMAGE_HEADER_SIZE], &offset, 4 );
+        memcpy ( &slab[ROK4_IMAGE_HEADER_SIZE + 4], &size, 4 );
+        slab += std::string ( size, ( char ) 100 );
+
+        std::string mkdir = "mkdir -p " + level->getDirPath ( 0, 0 );
+        CPPUNIT_ASSERT_EQUAL ( 0, system ( mkdir.c_str() ) );
+        writeFile ( level->getPath ( 0, 0 ), slab );
+    }
+
+    static std::string tileContent ( DataSource* source ) {
+        size_t size;
+        const uint8_t* data = source->getData ( size );
+        return std::string ( ( const char* ) data, size );
+    }
+
+    DataSource* getTile ( const char* path ) {
+        Request* request = RequestReference::build ( path, "" );
+        DataSource* tile = server->getTile ( request );
+        delete request;
+        return tile;
+    }
+
+public:
+
+    void setUp() {
+        char tmpl[] = "/tmp/CppUnitTMSTranscodingXXXXXX";
+        dir = std::string ( mkdtemp ( tmpl ) );
+
+        mkdir ( ( dir + "/layers" ).c_str(), 0755 );
+        mkdir ( ( dir + "/styles" ).c_str(), 0755 );
+        mkdir ( ( dir + "/tms" ).c_str(), 0755 );
+        mkdir ( ( dir + "/proj" ).c_str(), 0755 );
+        mkdir ( ( dir + "/pyramid" ).c_str(), 0755 );
+
+        writeFile ( dir + "/server.conf",
+            "<serverConf><logOutput>standard_output_stream_for_errors</logOutput><logLevel>fatal</logLevel>"
+            "<nbThread>2</nbThread><WMTSSupport>true</WMTSSupport><TMSSupport>true</TMSSupport><WMSSupport>false</WMSSupport>"
+            "<servicesConfigFile>" + dir + "/services.conf</servicesConfigFile>"
+            "<layerDir>" + dir + "/layers</layerDir><styleDir>" + dir + "/styles</styleDir>"
+            "<tileMatrixSetDir>" + dir + "/tms</tileMatrixSetDir><projConfigDir>" + dir + "/proj</projConfigDir>"
+            "</serverConf>" );
+
+        writeFile ( dir + "/services.conf",
+            "<servicesConf><title>TMS</title>"
+            "<formatList><format>image/tiff</format><format>image/jpeg</format><format>image/png</format></formatList>"
+            "<admissionControl><operationLimit operation=\"GetTile\">1</operationLimit></admissionControl>"
+            "</servicesConf>" );
+
+        writeFile ( dir + "/proj/epsg",
+            "<3857> +proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0 +k=1.0 +units=m +nadgrids=@null +wktext +no_defs <>\n" );
+
+        writeFile ( dir + "/tms/PM.tms",
+            "<tileMatrixSet><crs>EPSG:3857</crs>"
+            "<tileMatrix><id>0</id><resolution>156543.0339280410</resolution>"
+            "<topLeftCornerX>-20037508.3427892480</topLeftCornerX><topLeftCornerY>20037508.3427892480</topLeftCornerY>"
+            "<tileWidth>256</tileWidth><tileHeight>256</tileHeight><matrixWidth>1</matrixWidth><matrixHeight>1</matrixHeight></tileMatrix>"
+            "</tileMatrixSet>" );
+
+        writeFile ( dir + "/styles/normal.stl",
+            "<style><Identifier>normal</Identifier><Title>Normal</Title><Abstract>Données brutes</Abstract></style>" );
+
+        writeFile ( dir + "/pyramid/ORTHO.pyr",
+            "<Pyramid><tileMatrixSet>PM</tileMatrixSet><format>TIFF_RAW_INT8</format>"
+            "<photometric>rgb</photometric><channels>3</channels><nodataValue>255,255,255</nodataValue>"
+            "<level><tileMatrix>0</tileMatrix><baseDir>" + dir + "/pyramid/data</baseDir><pathDepth>2</pathDepth>"
+            "<tilesPerWidth>1</tilesPerWidth><tilesPerHeight>1</tilesPerHeight>"
+            "<TMSLimits><minTileRow>0</minTileRow><maxTileRow>0</maxTileRow><minTileCol>0</minTileCol><maxTileCol>0</maxTileCol></TMSLimits>"
+            "</level></Pyramid>" );
+
+        writeFile ( dir + "/layers/ORTHO.lay",
+            "<layer><title>Ortho</title><abstract>Ortho</abstract><style>normal</style>"
+            "<EX_GeographicBoundingBox><westBoundLongitude>-180</westBoundLongitude><eastBoundLongitude>180</eastBoundLongitude>"
+            "<southBoundLatitude>-85</southBoundLatitude><northBoundLatitude>85</northBoundLatitude></EX_GeographicBoundingBox>"
+            "<boundingBox CRS=\"EPSG:3857\" minx=\"-20037508\" miny=\"-20037508\" maxx=\"20037508\" maxy=\"20037508\"/>"
+            "<resampling>nn</resampling>"
+            "<transcoding cacheSize=\"1\"><format>image/jpeg</format><format>image/png</format></transcoding>"
+            "<pyramid>" + dir + "/pyramid/ORTHO.pyr</pyramid></layer>" );
+
+        server = rok4InitServer ( ( dir + "/server.conf" ).c_str() );
+        CPPUNIT_ASSERT ( server != NULL );
+        layer = server->getLayerList() ["ORTHO"];
+        CPPUNIT_ASSERT ( layer != NULL );
+    }
+
+    void tearDown() {
+        rok4KillServer ( server );
+        std::string command = "rm -rf " + dir;
+        system ( command.c_str() );
+    }
+
+    void test_extensions() {
+        // Mêmes extensions que les pyramides natives
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "jpg" ), Rok4Server::getTMSTranscodingExtension ( "image/jpeg" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "png" ), Rok4Server::getTMSTranscodingExtension ( "image/png" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "tif" ), Rok4Server::getTMSTranscodingExtension ( "image/tiff" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "bil" ), Rok4Server::getTMSTranscodingExtension ( "image/x-bil;bits=32" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "" ), Rok4Server::getTMSTranscodingExtension ( "text/plain" ) );
+    }
+
+    void test_routing() {
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "image/jpeg" ), Rok4Server::getTMSTranscodingFormat ( layer, "jpg" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "image/png" ), Rok4Server::getTMSTranscodingFormat ( layer, "png" ) );
+        // Extension des données : pas de transcodage
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "" ), Rok4Server::getTMSTranscodingFormat ( layer, "tif" ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "" ), Rok4Server::getTMSTranscodingFormat ( layer, "jpeg" ) );
+
+        const char* paths[4] = { "/rok4/1.0.0/ORTHO/0/0/0.tif", "/rok4/1.0.0/ORTHO/0/0/0.jpg", "/rok4/1.0.0/ORTHO/0/0/0.png", "/rok4/1.0.0/ORTHO/0/0/0.jpeg" };
+        const char* formats[4] = { "image/tiff", "image/jpeg", "image/png", NULL };
+        for ( int i = 0; i < 4; i++ ) {
+            Request* request = RequestReference::build ( paths[i], "" );
+            Layer* L;
+            std::string tileMatrix, format;
+            int tileCol, tileRow;
+            Style* style;
+            DataSource* error = server->getTileParamTMS ( request, L, tileMatrix, tileCol, tileRow, format, style );
+            if ( formats[i] ) {
+                CPPUNIT_ASSERT ( error == NULL );
+                CPPUNIT_ASSERT_EQUAL ( std::string ( formats[i] ), format );
+            } else {
+                CPPUNIT_ASSERT ( error != NULL );
+                delete error;
+            }
+            delete request;
+        }
+    }
+
+    void test_layer_documents() {
+        std::string tileMap = server->buildTMSLayer ( layer, "http://localhost/rok4/1.0.0" );
+        CPPUNIT_ASSERT ( tileMap.find ( "mime-type=\"image/tiff\" extension=\"tif\"" ) != std::string::npos );
+        CPPUNIT_ASSERT ( tileMap.find ( "mime-type=\"image/jpeg\" extension=\"jpg\"" ) != std::string::npos );
+        CPPUNIT_ASSERT ( tileMap.find ( "mime-type=\"image/png\" extension=\"png\"" ) != std::string::npos );
+
+        std::string metadata = server->buildTMSLayerMetadata ( layer, "http://localhost/rok4/1.0.0" );
+        CPPUNIT_ASSERT ( metadata.find ( "\"format\": \"tif\"" ) != std::string::npos );
+        CPPUNIT_ASSERT ( metadata.find ( "\"format\": \"jpg\", \"tiles\":[\"http://localhost/rok4/1.0.0/ORTHO/{z}/{x}/{y}.jpg\"]" ) != std::string::npos );
+        CPPUNIT_ASSERT ( metadata.find ( "\"format\": \"png\", \"tiles\":[\"http://localhost/rok4/1.0.0/ORTHO/{z}/{x}/{y}.png\"]" ) != std::string::npos );
+    }
+
+    void test_transcoding() {
+        writeSlab();
+
+        DataSource* tile = getTile ( "/rok4/1.0.0/ORTHO/0/0/0.jpg" );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "image/jpeg" ), tile->getType() );
+        std::string jpeg = tileContent ( tile );
+        CPPUNIT_ASSERT ( jpeg.size() > 2 && jpeg.compare ( 0, 2, "\xFF\xD8" ) == 0 );
+        delete tile;
+
+        // Seconde demande : la tuile vient du cache de transcodage, à l'identique
+        tile = getTile ( "/rok4/1.0.0/ORTHO/0/0/0.jpg" );
+        CPPUNIT_ASSERT_EQUAL ( jpeg, tileContent ( tile ) );
+        delete tile;
+
+        tile = getTile ( "/rok4/1.0.0/ORTHO/0/0/0.png" );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "image/png" ), tile->getType() );
+        CPPUNIT_ASSERT ( tileContent ( tile ).compare ( 0, 4, "\x89PNG" ) == 0 );
+        delete tile;
+    }
+
+    void test_admission() {
+        std::vector<AdmissionBudget> budgets;
+        int maxOccupied;
+
+        // Tuile stockée dans le format des données : voie prioritaire
+        Request* request = RequestReference::build ( "/rok4/1.0.0/ORTHO/0/0/0.tif", "" );
+        CPPUNIT_ASSERT ( ! server->getAdmissionBudgets ( request, budgets, maxOccupied ) );
+        delete request;
+
+        // Tuile transcodée, en TMS comme en WMTS : soumise aux limites
+        request = RequestReference::build ( "/rok4/1.0.0/ORTHO/0/0/0.jpg", "" );
+        CPPUNIT_ASSERT ( server->getAdmissionBudgets ( request, budgets, maxOccupied ) );
+        CPPUNIT_ASSERT_EQUAL ( 1, ( int ) budgets.size() );
+        delete request;
+
+        budgets.clear();
+        request = RequestReference::build ( "/rok4",
+            "SERVICE=WMTS&VERSION=1.0.0&REQUEST=GetTile&LAYER=ORTHO&STYLE=normal&FORMAT=image/png&TILEMATRIXSET=PM&TILEMATRIX=0&TILECOL=0&TILEROW=0" );
+        CPPUNIT_ASSERT ( server->getAdmissionBudgets ( request, budgets, maxOccupied ) );
+        delete request;
+
+        budgets.clear();
+        request = RequestReference::build ( "/rok4",
+            "SERVICE=WMTS&VERSION=1.0.0&REQUEST=GetTile&LAYER=ORTHO&STYLE=normal&FORMAT=image/tiff&TILEMATRIXSET=PM&TILEMATRIX=0&TILECOL=0&TILEROW=0" );
+        CPPUNIT_ASSERT ( ! server->getAdmissionBudgets ( request, budgets, maxOccupied ) );
+        delete request;
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitTMSTranscoding );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitTMSTranscoding, "CppUnitTMSTranscoding" );
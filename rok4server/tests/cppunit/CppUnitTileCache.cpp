@@ -0,0 +1,116 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <pthread.h>
+#include <string>
+
+#include "TileCache.h"
+
+class CppUnitTileCache : public CPPUNIT_NS::TestFixture {
+
+    CPPUNIT_TEST_SUITE ( CppUnitTileCache );
+
+    CPPUNIT_TEST ( leastRecentlyUsed );
+    CPPUNIT_TEST ( rendering );
+
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void leastRecentlyUsed();
+    void rendering();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitTileCache );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitTileCache, "CppUnitTileCache" );
+
+void CppUnitTileCache::leastRecentlyUsed() {
+    TileCache cache ( 10 );
+    std::string type, data;
+
+    cache.put ( "a", "image/png", "aaaa" );
+    cache.put ( "b", "image/png", "bbbb" );
+    // "a" devient la plus récemment utilisée
+    CPPUNIT_ASSERT ( cache.get ( "a", type, data ) );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "aaaa" ), data );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "image/png" ), type );
+
+    // Plus de place : "b" est supprimée
+    cache.put ( "c", "image/png", "cccc" );
+    CPPUNIT_ASSERT ( ! cache.get ( "b", type, data ) );
+    CPPUNIT_ASSERT ( cache.get ( "a", type, data ) );
+    CPPUNIT_ASSERT ( cache.get ( "c", type, data ) );
+    CPPUNIT_ASSERT_EQUAL ( ( size_t ) 8, cache.getSize() );
+
+    // Remplacement et tuile trop grande
+    cache.put ( "a", "image/jpeg", "a" );
+    CPPUNIT_ASSERT_EQUAL ( ( size_t ) 5, cache.getSize() );
+    cache.put ( "d", "image/png", "ddddddddddd" );
+    CPPUNIT_ASSERT ( ! cache.get ( "d", type, data ) );
+    CPPUNIT_ASSERT ( cache.get ( "a", type, data ) );
+    CPPUNIT_ASSERT_EQUAL ( std::string ( "image/jpeg" ), type );
+}
+
+static void* waitRendering ( void* arg ) {
+    TileCache* cache = ( TileCache* ) arg;
+    // La métatuile est calculée par le thread principal : on attend sans la calculer
+    bool render = cache->startRendering ( "meta" );
+    std::string type, data;
+    bool found = cache->get ( "tile", type, data );
+    return ( void* ) ( ! render && found );
+}
+
+void CppUnitTileCache::rendering() {
+    TileCache cache ( 100 );
+
+    CPPUNIT_ASSERT ( cache.startRendering ( "meta" ) );
+
+    pthread_t thread;
+    pthread_create ( &thread, NULL, waitRendering, &cache );
+
+    cache.put ( "tile", "image/png", "data" );
+    cache.endRendering ( "meta" );
+
+    void* ok;
+    pthread_join ( thread, &ok );
+    CPPUNIT_ASSERT ( ok != NULL );
+
+    // Plus de calcul en cours
+    CPPUNIT_ASSERT ( cache.startRendering ( "meta" ) );
+    cache.endRendering ( "meta" );
+}
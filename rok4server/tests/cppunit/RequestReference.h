@@ -0,0 +1,119 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <contact.geoservices@ign.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#ifndef REQUESTREFERENCE_H
+#define REQUESTREFERENCE_H
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "Request.h"
+
+/**
+ * Requêtes enregistrées (tuiles WMTS et TMS majoritaires, GetMap, GetFeatureInfo, GetCapabilities) et analyse de référence,
+ * partagées par les tests de l'analyse des requêtes et par sa mesure de performance
+ */
+namespace RequestReference {
+
+    struct RecordedRequest {
+        const char* path;
+        const char* query;
+        // Poids de la requête dans le mélange
+        int weight;
+    };
+
+    static const RecordedRequest mix[] = {
+        { "/rok4/wmts", "SERVICE=WMTS&REQUEST=GetTile&VERSION=1.0.0&LAYER=ORTHOIMAGERY.ORTHOPHOTOS&STYLE=normal&TILEMATRIXSET=PM&TILEMATRIX=16&TILEROW=22548&TILECOL=33187&FORMAT=image%2Fjpeg", 40 },
+        { "/rok4/wmts", "layer=GEOGRAPHICALGRIDSYSTEMS.PLANIGNV2&style=normal&tilematrixset=PM&Service=WMTS&Request=GetTile&Version=1.0.0&Format=image%2Fpng&TileMatrix=12&TileCol=2075&TileRow=1409", 20 },
+        { "/rok4/tms/1.0.0/ORTHOIMAGERY.ORTHOPHOTOS/16/33187/22548.jpg", "", 20 },
+        { "/rok4/wms", "SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=ORTHOIMAGERY.ORTHOPHOTOS%2CCADASTRALPARCELS.PARCELS&STYLES=%2C&CRS=EPSG%3A2154&BBOX=651000%2C6860000%2C652000%2C6861000&WIDTH=1024&HEIGHT=1024&FORMAT=image%2Fpng&TRANSPARENT=true&DPI=96", 10 },
+        { "/rok4/wms", "service=WMS&version=1.1.1&request=GetMap&layers=ELEVATION.SLOPES&styles=&srs=EPSG:4326&bbox=2.2,48.8,2.4,48.9&width=512&height=256&format=image/tiff&format_options=compression:deflate", 4 },
+        { "/rok4/wms", "SERVICE=WMS&VERSION=1.3.0&REQUEST=GetFeatureInfo&LAYERS=ELEVATION.SLOPES&QUERY_LAYERS=ELEVATION.SLOPES&STYLES=&CRS=EPSG%3A4326&BBOX=48.8%2C2.2%2C48.9%2C2.4&WIDTH=101&HEIGHT=101&I=50&J=50&INFO_FORMAT=text%2Fplain&FEATURE_COUNT=1", 3 },
+        { "/rok4/wmts", "SERVICE=WMTS&REQUEST=GetCapabilities&VERSION=1.0.0", 2 },
+        { "/rok4/tms/1.0.0/ORTHOIMAGERY.ORTHOPHOTOS", "", 1 }
+    };
+
+    static const int mixSize = sizeof ( mix ) / sizeof ( RecordedRequest );
+
+    inline int hex ( char c ) {
+        if ( c >= '0' && c <= '9' ) return c - '0';
+        if ( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+        if ( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+        return -1;
+    }
+
+    /**
+     * Analyse de référence, telle que faite avant l'analyse en une passe : décodage de toute la chaîne, puis découpage
+     */
+    inline void referenceParse ( char* strquery, std::map<std::string, std::string>& params ) {
+        char* dst = strquery;
+        for ( char* src = strquery; *src; src++, dst++ ) {
+            if ( *src == '+' ) {
+                *dst = ' ';
+            } else if ( *src == '%' && hex ( src[1] ) >= 0 && hex ( src[2] ) >= 0 ) {
+                unsigned char c = hex ( src[1] ) * 16 + hex ( src[2] );
+                *dst = ( c < 32 || c == 127 ) ? '_' : c;
+                src += 2;
+            } else {
+                *dst = *src;
+            }
+        }
+        *dst = '\0';
+
+        for ( int pos = 0; strquery[pos]; ) {
+            char* key = strquery + pos;
+            for ( ; strquery[pos] && strquery[pos] != '=' && strquery[pos] != '&'; pos++ );
+            char* value = strquery + pos;
+            for ( ; strquery[pos] && strquery[pos] != '&'; pos++ );
+            if ( *value == '=' ) *value++ = 0;
+            if ( strquery[pos] ) strquery[pos++] = 0;
+
+            Request::toLowerCase ( key );
+            params.insert ( std::pair<std::string, std::string> ( key, value ) );
+        }
+    }
+
+    inline Request* build ( const char* recordedPath, const char* recordedQuery ) {
+        std::vector<char> query ( recordedQuery, recordedQuery + strlen ( recordedQuery ) + 1 );
+        std::vector<char> path ( recordedPath, recordedPath + strlen ( recordedPath ) + 1 );
+        char host[] = "localhost";
+        return new Request ( &query[0], host, &path[0], NULL );
+    }
+}
+
+#endif // REQUESTREFERENCE_H